@@ -77,7 +77,8 @@ static bool gensec_gssapi_check_oid(const DATA_BLOB *blob, const char *oid)
 
 	if (!data) return false;
 
-	if (!asn1_load(data, *blob)) goto err;
+	/* parse-only, no need to copy the payload */
+	asn1_load_nocopy(data, blob->data, blob->length);
 	if (!asn1_start_tag(data, ASN1_APPLICATION(0))) goto err;
 	if (!asn1_check_OID(data, oid)) goto err;
 
@@ -78,6 +78,44 @@ krb5_error_code check_pac_checksum(DATA_BLOB pac_data,
 	return ret;
 }
 
+/*
+ * Zero a PAC signature value directly inside a copy of the wire blob.
+ *
+ * The buffer headers on the wire are cBuffers and Version followed by
+ * 16 bytes per buffer: ulType, cbBufferSize and a 64-bit Offset. A
+ * signature buffer body is the 4 byte checksum type followed by the
+ * signature value, which is the part the checksum algorithm requires
+ * to be zero.
+ */
+static NTSTATUS kerberos_zero_pac_signature(DATA_BLOB *pac_blob,
+					    uint32_t idx)
+{
+	uint32_t ofs;
+	uint32_t size;
+
+	if ((pac_blob->length < 8) ||
+	    (((pac_blob->length - 8) / 16) <= idx)) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	size = IVAL(pac_blob->data, 8 + idx * 16 + 4);
+	ofs  = IVAL(pac_blob->data, 8 + idx * 16 + 8);
+
+	if (IVAL(pac_blob->data, 8 + idx * 16 + 12) != 0) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	if (size < 4) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+	if ((ofs > pac_blob->length) || (size > pac_blob->length - ofs)) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	memset(pac_blob->data + ofs + 4, '\0', size - 4);
+	return NT_STATUS_OK;
+}
+
 /**
 * @brief Decode a blob containing a NDR encoded PAC structure
 *
@@ -110,15 +148,12 @@ NTSTATUS kerberos_decode_pac(TALLOC_CTX *mem_ctx,
 
 	struct PAC_SIGNATURE_DATA *srv_sig_ptr = NULL;
 	struct PAC_SIGNATURE_DATA *kdc_sig_ptr = NULL;
-	struct PAC_SIGNATURE_DATA *srv_sig_wipe = NULL;
-	struct PAC_SIGNATURE_DATA *kdc_sig_wipe = NULL;
 	struct PAC_LOGON_NAME *logon_name = NULL;
 	struct PAC_LOGON_INFO *logon_info = NULL;
 	struct PAC_DATA *pac_data = NULL;
-	struct PAC_DATA_RAW *pac_data_raw = NULL;
 
-	DATA_BLOB *srv_sig_blob = NULL;
-	DATA_BLOB *kdc_sig_blob = NULL;
+	int srv_sig_idx = -1;
+	int kdc_sig_idx = -1;
 
 	bool bool_ret;
 
@@ -132,10 +167,7 @@ NTSTATUS kerberos_decode_pac(TALLOC_CTX *mem_ctx,
 	}
 
 	pac_data = talloc(tmp_ctx, struct PAC_DATA);
-	pac_data_raw = talloc(tmp_ctx, struct PAC_DATA_RAW);
-	kdc_sig_wipe = talloc(tmp_ctx, struct PAC_SIGNATURE_DATA);
-	srv_sig_wipe = talloc(tmp_ctx, struct PAC_SIGNATURE_DATA);
-	if (!pac_data_raw || !pac_data || !kdc_sig_wipe || !srv_sig_wipe) {
+	if (!pac_data) {
 		talloc_free(tmp_ctx);
 		return NT_STATUS_NO_MEMORY;
 	}
@@ -157,44 +189,9 @@ NTSTATUS kerberos_decode_pac(TALLOC_CTX *mem_ctx,
 		return NT_STATUS_INVALID_PARAMETER;
 	}
 
-	ndr_err = ndr_pull_struct_blob(
-				&pac_data_blob, pac_data_raw, pac_data_raw,
-				(ndr_pull_flags_fn_t)ndr_pull_PAC_DATA_RAW);
-	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
-		status = ndr_map_error2ntstatus(ndr_err);
-		DEBUG(0,("can't parse the PAC: %s\n",
-			nt_errstr(status)));
-		talloc_free(tmp_ctx);
-		return status;
-	}
-
-	if (pac_data_raw->num_buffers < 4) {
-		/* we need logon_ingo, service_key and kdc_key */
-		DEBUG(0,("less than 4 PAC buffers\n"));
-		talloc_free(tmp_ctx);
-		return NT_STATUS_INVALID_PARAMETER;
-	}
-
-	if (pac_data->num_buffers != pac_data_raw->num_buffers) {
-		/* we need logon_ingo, service_key and kdc_key */
-		DEBUG(0, ("misparse! PAC_DATA has %d buffers while "
-			  "PAC_DATA_RAW has %d\n", pac_data->num_buffers,
-			  pac_data_raw->num_buffers));
-		talloc_free(tmp_ctx);
-		return NT_STATUS_INVALID_PARAMETER;
-	}
-
 	for (i=0; i < pac_data->num_buffers; i++) {
 		struct PAC_BUFFER *data_buf = &pac_data->buffers[i];
-		struct PAC_BUFFER_RAW *raw_buf = &pac_data_raw->buffers[i];
 
-		if (data_buf->type != raw_buf->type) {
-			DEBUG(0, ("misparse! PAC_DATA buffer %d has type "
-				  "%d while PAC_DATA_RAW has %d\n", i,
-				  data_buf->type, raw_buf->type));
-			talloc_free(tmp_ctx);
-			return NT_STATUS_INVALID_PARAMETER;
-		}
 		switch (data_buf->type) {
 		case PAC_TYPE_LOGON_INFO:
 			if (!data_buf->info) {
@@ -207,14 +204,14 @@ NTSTATUS kerberos_decode_pac(TALLOC_CTX *mem_ctx,
 				break;
 			}
 			srv_sig_ptr = &data_buf->info->srv_cksum;
-			srv_sig_blob = &raw_buf->info->remaining;
+			srv_sig_idx = i;
 			break;
 		case PAC_TYPE_KDC_CHECKSUM:
 			if (!data_buf->info) {
 				break;
 			}
 			kdc_sig_ptr = &data_buf->info->kdc_cksum;
-			kdc_sig_blob = &raw_buf->info->remaining;
+			kdc_sig_idx = i;
 			break;
 		case PAC_TYPE_LOGON_NAME:
 			logon_name = &data_buf->info->logon_name;
@@ -236,13 +233,13 @@ NTSTATUS kerberos_decode_pac(TALLOC_CTX *mem_ctx,
 		return NT_STATUS_INVALID_PARAMETER;
 	}
 
-	if (!srv_sig_ptr || !srv_sig_blob) {
+	if (!srv_sig_ptr || (srv_sig_idx < 0)) {
 		DEBUG(0,("PAC no srv_key\n"));
 		talloc_free(tmp_ctx);
 		return NT_STATUS_INVALID_PARAMETER;
 	}
 
-	if (!kdc_sig_ptr || !kdc_sig_blob) {
+	if (!kdc_sig_ptr || (kdc_sig_idx < 0)) {
 		DEBUG(0,("PAC no kdc_key\n"));
 		talloc_free(tmp_ctx);
 		return NT_STATUS_INVALID_PARAMETER;
@@ -251,65 +248,30 @@ NTSTATUS kerberos_decode_pac(TALLOC_CTX *mem_ctx,
 	/* Find and zero out the signatures,
 	 * as required by the signing algorithm */
 
-	/* We find the data blobs above,
-	 * now we parse them to get at the exact portion we should zero */
-	ndr_err = ndr_pull_struct_blob(
-			kdc_sig_blob, kdc_sig_wipe, kdc_sig_wipe,
-			(ndr_pull_flags_fn_t)ndr_pull_PAC_SIGNATURE_DATA);
-	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
-		status = ndr_map_error2ntstatus(ndr_err);
-		DEBUG(0,("can't parse the KDC signature: %s\n",
-			nt_errstr(status)));
+	/*
+	 * The checksums cover the original wire bytes with the two
+	 * signature values zeroed, so work on a plain copy of the blob
+	 * instead of decoding and re-encoding the whole structure.
+	 */
+	modified_pac_blob = data_blob_talloc(tmp_ctx,
+					     pac_data_blob.data,
+					     pac_data_blob.length);
+	if (modified_pac_blob.data == NULL) {
 		talloc_free(tmp_ctx);
-		return status;
-	}
-
-	ndr_err = ndr_pull_struct_blob(
-			srv_sig_blob, srv_sig_wipe, srv_sig_wipe,
-			(ndr_pull_flags_fn_t)ndr_pull_PAC_SIGNATURE_DATA);
-	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
-		status = ndr_map_error2ntstatus(ndr_err);
-		DEBUG(0,("can't parse the SRV signature: %s\n",
-			nt_errstr(status)));
-		talloc_free(tmp_ctx);
-		return status;
+		return NT_STATUS_NO_MEMORY;
 	}
 
-	/* Now zero the decoded structure */
-	memset(kdc_sig_wipe->signature.data,
-		'\0', kdc_sig_wipe->signature.length);
-	memset(srv_sig_wipe->signature.data,
-		'\0', srv_sig_wipe->signature.length);
-
-	/* and reencode, back into the same place it came from */
-	ndr_err = ndr_push_struct_blob(
-			kdc_sig_blob, pac_data_raw, kdc_sig_wipe,
-			(ndr_push_flags_fn_t)ndr_push_PAC_SIGNATURE_DATA);
-	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
-		status = ndr_map_error2ntstatus(ndr_err);
-		DEBUG(0,("can't repack the KDC signature: %s\n",
-			nt_errstr(status)));
-		talloc_free(tmp_ctx);
-		return status;
-	}
-	ndr_err = ndr_push_struct_blob(
-			srv_sig_blob, pac_data_raw, srv_sig_wipe,
-			(ndr_push_flags_fn_t)ndr_push_PAC_SIGNATURE_DATA);
-	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
-		status = ndr_map_error2ntstatus(ndr_err);
-		DEBUG(0,("can't repack the SRV signature: %s\n",
+	status = kerberos_zero_pac_signature(&modified_pac_blob, kdc_sig_idx);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(0,("can't zero the KDC signature: %s\n",
 			nt_errstr(status)));
 		talloc_free(tmp_ctx);
 		return status;
 	}
 
-	/* push out the whole structure, but now with zero'ed signatures */
-	ndr_err = ndr_push_struct_blob(
-			&modified_pac_blob, pac_data_raw, pac_data_raw,
-			(ndr_push_flags_fn_t)ndr_push_PAC_DATA_RAW);
-	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
-		status = ndr_map_error2ntstatus(ndr_err);
-		DEBUG(0,("can't repack the RAW PAC: %s\n",
+	status = kerberos_zero_pac_signature(&modified_pac_blob, srv_sig_idx);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(0,("can't zero the SRV signature: %s\n",
 			nt_errstr(status)));
 		talloc_free(tmp_ctx);
 		return status;
@@ -1295,6 +1295,16 @@ int ctdb_ctrl_dbstatistics(struct ctdb_context *ctdb, uint32_t destnode, uint32_
 		memcpy(s->hot_keys[i].key.dptr, ptr, s->hot_keys[i].key.dsize);
 		ptr += wire->hot_keys[i].key.dsize;
 	}
+	for (i=0; i<wire->num_migrated_keys; i++) {
+		s->migrated_keys[i].key.dptr = talloc_size(mem_ctx, s->migrated_keys[i].key.dsize);
+		if (s->migrated_keys[i].key.dptr == NULL) {
+			talloc_free(outdata.dptr);
+			CTDB_NO_MEMORY(ctdb, s->migrated_keys[i].key.dptr);
+		}
+
+		memcpy(s->migrated_keys[i].key.dptr, ptr, s->migrated_keys[i].key.dsize);
+		ptr += wire->migrated_keys[i].key.dsize;
+	}
 
 	talloc_free(outdata.dptr);
 	*dbstat = s;
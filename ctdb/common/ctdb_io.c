@@ -69,77 +69,75 @@ int ctdb_queue_length(struct ctdb_queue *queue)
 	return queue->out_queue_length;
 }
 
-static void queue_process(struct ctdb_queue *queue);
-
-static void queue_process_event(struct tevent_context *ev, struct tevent_immediate *im,
-				void *private_data)
-{
-	struct ctdb_queue *queue = talloc_get_type(private_data, struct ctdb_queue);
-
-	queue_process(queue);
-}
-
 /*
  * This function is used to process data in queue buffer.
  *
- * Queue callback function can end up freeing the queue, there should not be a
- * loop processing packets from queue buffer.  Instead set up a timed event for
- * immediate run to process remaining packets from buffer.
+ * All complete packets in the buffer are dispatched in one pass. The
+ * queue callback function can end up freeing the queue, so the
+ * destroyed pointer is hooked up for the duration of the loop to
+ * detect that and bail out.
  */
 static void queue_process(struct ctdb_queue *queue)
 {
 	uint32_t pkt_size;
 	uint8_t *data;
+	bool destroyed = false;
+	bool *destroyed_prev = queue->destroyed;
 
-	if (queue->buffer.length < sizeof(pkt_size)) {
-		return;
-	}
+	queue->destroyed = &destroyed;
 
-	pkt_size = *(uint32_t *)queue->buffer.data;
-	if (pkt_size == 0) {
-		DEBUG(DEBUG_CRIT, ("Invalid packet of length 0\n"));
-		goto failed;
-	}
+	while (queue->buffer.length >= sizeof(pkt_size)) {
 
-	if (queue->buffer.length < pkt_size) {
-		if (pkt_size > QUEUE_BUFFER_SIZE) {
-			queue->buffer.extend = pkt_size;
+		pkt_size = *(uint32_t *)queue->buffer.data;
+		if (pkt_size == 0) {
+			DEBUG(DEBUG_CRIT, ("Invalid packet of length 0\n"));
+			goto failed;
 		}
-		return;
-	}
 
-	/* Extract complete packet */
-	data = talloc_size(queue, pkt_size);
-	if (data == NULL) {
-		DEBUG(DEBUG_ERR, ("read error alloc failed for %u\n", pkt_size));
-		return;
-	}
-	memcpy(data, queue->buffer.data, pkt_size);
+		if (queue->buffer.length < pkt_size) {
+			if (pkt_size > queue->buffer.size) {
+				queue->buffer.extend = pkt_size;
+			}
+			break;
+		}
 
-	/* Shift packet out from buffer */
-	if (queue->buffer.length > pkt_size) {
-		memmove(queue->buffer.data,
-			queue->buffer.data + pkt_size,
-			queue->buffer.length - pkt_size);
-	}
-	queue->buffer.length -= pkt_size;
+		/* Extract complete packet */
+		data = talloc_size(queue, pkt_size);
+		if (data == NULL) {
+			DEBUG(DEBUG_ERR, ("read error alloc failed for %u\n", pkt_size));
+			break;
+		}
+		memcpy(data, queue->buffer.data, pkt_size);
 
-	if (queue->buffer.length > 0) {
-		/* There is more data to be processed, schedule an event */
-		tevent_schedule_immediate(queue->im, queue->ctdb->ev,
-					  queue_process_event, queue);
-	} else {
-		if (queue->buffer.size > QUEUE_BUFFER_SIZE) {
-			TALLOC_FREE(queue->buffer.data);
-			queue->buffer.size = 0;
+		/* Shift packet out from buffer */
+		if (queue->buffer.length > pkt_size) {
+			memmove(queue->buffer.data,
+				queue->buffer.data + pkt_size,
+				queue->buffer.length - pkt_size);
+		}
+		queue->buffer.length -= pkt_size;
+
+		/* It is the responsibility of the callback to free 'data' */
+		queue->callback(data, pkt_size, queue->private_data);
+		if (destroyed) {
+			if (destroyed_prev != NULL) {
+				*destroyed_prev = true;
+			}
+			return;
 		}
 	}
 
-	/* It is the responsibility of the callback to free 'data' */
-	queue->callback(data, pkt_size, queue->private_data);
+	queue->destroyed = destroyed_prev;
+
+	if (queue->buffer.length == 0 &&
+	    queue->buffer.size > QUEUE_BUFFER_SIZE) {
+		TALLOC_FREE(queue->buffer.data);
+		queue->buffer.size = 0;
+	}
 	return;
 
 failed:
+	queue->destroyed = destroyed_prev;
 	queue->callback(NULL, 0, queue->private_data);
 
 }
@@ -192,7 +190,18 @@ static void queue_io_read(struct ctdb_queue *queue)
 
 	navail = queue->buffer.size - queue->buffer.length;
 	if (num_ready > navail) {
-		num_ready = navail;
+		/* grow the buffer to drain the socket in one read, so
+		   that all the packets the kernel has for us can be
+		   dispatched in a single pass */
+		data = talloc_realloc_size(queue, queue->buffer.data,
+					   queue->buffer.length + num_ready);
+		if (data != NULL) {
+			queue->buffer.data = data;
+			queue->buffer.size = queue->buffer.length + num_ready;
+			navail = num_ready;
+		} else {
+			num_ready = navail;
+		}
 	}
 
 	if (num_ready > 0) {
@@ -223,6 +232,9 @@ static void queue_dead(struct event_context *ev, struct tevent_immediate *im,
 }
 
 
+/* maximum number of queued packets batched into one writev */
+#define QUEUE_SEND_IOV_MAX 16
+
 /*
   called when an incoming connection is writeable
 */
@@ -230,11 +242,25 @@ static void queue_io_write(struct ctdb_queue *queue)
 {
 	while (queue->out_queue) {
 		struct ctdb_queue_pkt *pkt = queue->out_queue;
+		struct iovec iov[QUEUE_SEND_IOV_MAX];
 		ssize_t n;
+
 		if (queue->ctdb->flags & CTDB_FLAG_TORTURE) {
 			n = write(queue->fd, pkt->data, 1);
 		} else {
-			n = write(queue->fd, pkt->data, pkt->length);
+			/* gather as many queued packets as fit into
+			   one writev */
+			struct ctdb_queue_pkt *p;
+			int num_iov = 0;
+
+			for (p = pkt;
+			     p != NULL && num_iov < QUEUE_SEND_IOV_MAX;
+			     p = p->next) {
+				iov[num_iov].iov_base = p->data;
+				iov[num_iov].iov_len = p->length;
+				num_iov++;
+			}
+			n = writev(queue->fd, iov, num_iov);
 		}
 
 		if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
@@ -252,16 +278,22 @@ static void queue_io_write(struct ctdb_queue *queue)
 			return;
 		}
 		if (n <= 0) return;
-		
-		if (n != pkt->length) {
-			pkt->length -= n;
-			pkt->data += n;
-			return;
-		}
 
-		DLIST_REMOVE(queue->out_queue, pkt);
-		queue->out_queue_length--;
-		talloc_free(pkt);
+		/* retire all packets the kernel accepted. Only the
+		   head of the queue can end up partially sent */
+		while (n > 0) {
+			pkt = queue->out_queue;
+			if ((uint32_t)n < pkt->length) {
+				pkt->length -= n;
+				pkt->data += n;
+				return;
+			}
+
+			n -= pkt->length;
+			DLIST_REMOVE(queue->out_queue, pkt);
+			queue->out_queue_length--;
+			talloc_free(pkt);
+		}
 	}
 
 	EVENT_FD_NOT_WRITEABLE(queue->fde);
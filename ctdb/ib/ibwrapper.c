@@ -50,6 +50,9 @@ static char ibw_lasterr[IBW_LASTERR_BUFSIZE];
 #define IBW_MAX_RECV_WR 1024
 #define IBW_RECV_BUFSIZE 256
 #define IBW_RECV_THRESHOLD (1 * 1024 * 1024)
+#define IBW_MAX_INLINE_DATA 256
+#define IBW_SEND_THRESHOLD (1 * 1024 * 1024)
+#define IBW_WC_BATCH 16
 
 static void ibw_event_handler_verbs(struct event_context *ev,
 	struct fd_event *fde, uint16_t flags, void *private_data);
@@ -298,11 +301,19 @@ static int ibw_setup_cq_qp(struct ibw_conn *conn)
 	init_attr.cap.max_recv_wr = pctx->opts.max_recv_wr;
 	init_attr.cap.max_recv_sge = 1;
 	init_attr.cap.max_send_sge = 1;
+	init_attr.cap.max_inline_data = pctx->opts.max_inline_data;
 	init_attr.qp_type = IBV_QPT_RC;
 	init_attr.send_cq = pconn->cq;
 	init_attr.recv_cq = pconn->cq;
 
 	rc = rdma_create_qp(pconn->cm_id, pconn->pd, &init_attr);
+	if (rc && pctx->opts.max_inline_data) {
+		/* not all hcas support inline data - retry without */
+		DEBUG(DEBUG_INFO, ("rdma_create_qp failed with %d, "
+			"retrying without inline data\n", rc));
+		init_attr.cap.max_inline_data = 0;
+		rc = rdma_create_qp(pconn->cm_id, pconn->pd, &init_attr);
+	}
 	if (rc) {
 		sprintf(ibw_lasterr, "rdma_create_qp failed with %d\n", rc);
 		return rc;
@@ -315,6 +326,9 @@ static int ibw_setup_cq_qp(struct ibw_conn *conn)
 		return rc;
 	}
 
+	/* the hca may round the inline capability up or down */
+	pconn->max_inline_data = init_attr.cap.max_inline_data;
+
 	return ibw_fill_cq(conn);
 }
 
@@ -588,8 +602,8 @@ static void ibw_event_handler_verbs(struct event_context *ev,
 	struct ibw_conn_priv *pconn = talloc_get_type(conn->internal, struct ibw_conn_priv);
 	struct ibw_ctx_priv *pctx = talloc_get_type(conn->ctx->internal, struct ibw_ctx_priv);
 
-	struct ibv_wc wc;
-	int rc;
+	struct ibv_wc wcs[IBW_WC_BATCH];
+	int rc, i;
 	struct ibv_cq *ev_cq;
 	void          *ev_ctx;
 
@@ -611,37 +625,42 @@ static void ibw_event_handler_verbs(struct event_context *ev,
 		goto error;
 	}
 
-	while((rc=ibv_poll_cq(pconn->cq, 1, &wc))==1) {
-		if (wc.status) {
-			sprintf(ibw_lasterr, "cq completion failed status=%d, opcode=%d, rc=%d\n",
-				wc.status, wc.opcode, rc);
-			goto error;
-		}
+	/* poll the completions in batches instead of one by one */
+	while((rc=ibv_poll_cq(pconn->cq, IBW_WC_BATCH, wcs))>0) {
+		for(i=0; i<rc; i++) {
+			struct ibv_wc *wc = &wcs[i];
 
-		switch(wc.opcode) {
-		case IBV_WC_SEND:
-			DEBUG(DEBUG_DEBUG, ("send completion\n"));
-			if (ibw_wc_send(conn, &wc))
+			if (wc->status) {
+				sprintf(ibw_lasterr, "cq completion failed status=%d, opcode=%d, rc=%d\n",
+					wc->status, wc->opcode, rc);
 				goto error;
-			break;
+			}
 
-		case IBV_WC_RDMA_WRITE:
-			DEBUG(DEBUG_DEBUG, ("rdma write completion\n"));
-			break;
-	
-		case IBV_WC_RDMA_READ:
-			DEBUG(DEBUG_DEBUG, ("rdma read completion\n"));
-			break;
+			switch(wc->opcode) {
+			case IBV_WC_SEND:
+				DEBUG(DEBUG_DEBUG, ("send completion\n"));
+				if (ibw_wc_send(conn, wc))
+					goto error;
+				break;
 
-		case IBV_WC_RECV:
-			DEBUG(DEBUG_DEBUG, ("recv completion\n"));
-			if (ibw_wc_recv(conn, &wc))
-				goto error;
-			break;
+			case IBV_WC_RDMA_WRITE:
+				DEBUG(DEBUG_DEBUG, ("rdma write completion\n"));
+				break;
 
-		default:
-			sprintf(ibw_lasterr, "unknown completion %d\n", wc.opcode);
-			goto error;
+			case IBV_WC_RDMA_READ:
+				DEBUG(DEBUG_DEBUG, ("rdma read completion\n"));
+				break;
+
+			case IBV_WC_RECV:
+				DEBUG(DEBUG_DEBUG, ("recv completion\n"));
+				if (ibw_wc_recv(conn, wc))
+					goto error;
+				break;
+
+			default:
+				sprintf(ibw_lasterr, "unknown completion %d\n", wc->opcode);
+				goto error;
+			}
 		}
 	}
 	if (rc!=0) {
@@ -720,12 +739,18 @@ static int ibw_wc_send(struct ibw_conn *conn, struct ibv_wc *wc)
 	if (send_index < pctx->opts.max_send_wr) {
 		DEBUG(DEBUG_DEBUG, ("ibw_wc_send#1 %u\n", (int)wc->wr_id));
 		p = pconn->wr_index[send_index];
-		if (p->buf_large!=NULL) {
+		if (p->send_large) {
 			if (p->ref_cnt) {
 				/* awaiting more of it... */
 				p->ref_cnt--;
 			} else {
-				ibw_free_mr(&p->buf_large, &p->mr_large);
+				/* keep the registration cached for reuse
+				 * unless it is unreasonably large */
+				if (p->large_size > pctx->opts.send_threshold) {
+					ibw_free_mr(&p->buf_large, &p->mr_large);
+					p->large_size = 0;
+				}
+				p->send_large = 0;
 				DLIST_REMOVE(pconn->wr_list_used, p);
 				DLIST_ADD(pconn->wr_list_avail, p);
 			}
@@ -746,6 +771,8 @@ static int ibw_wc_send(struct ibw_conn *conn, struct ibv_wc *wc)
 			p->ref_cnt--;
 		} else {
 			ibw_free_mr(&p->buf_large, &p->mr_large);
+			p->large_size = 0;
+			p->send_large = 0;
 			DLIST_REMOVE(pconn->extra_sent, p);
 			DLIST_ADD(pconn->extra_avail, p);
 		}
@@ -912,6 +939,8 @@ static int ibw_process_init_attrs(struct ibw_initattr *attr, int nattr, struct i
 	opts->max_recv_wr = IBW_MAX_RECV_WR;
 	opts->recv_bufsize = IBW_RECV_BUFSIZE;
 	opts->recv_threshold = IBW_RECV_THRESHOLD;
+	opts->max_inline_data = IBW_MAX_INLINE_DATA;
+	opts->send_threshold = IBW_SEND_THRESHOLD;
 
 	for(i=0; i<nattr; i++) {
 		name = attr[i].name;
@@ -926,6 +955,10 @@ static int ibw_process_init_attrs(struct ibw_initattr *attr, int nattr, struct i
 			opts->recv_bufsize = atoi(value);
 		else if (strcmp(name, "recv_threshold")==0)
 			opts->recv_threshold = atoi(value);
+		else if (strcmp(name, "max_inline_data")==0)
+			opts->max_inline_data = atoi(value);
+		else if (strcmp(name, "send_threshold")==0)
+			opts->send_threshold = atoi(value);
 		else {
 			sprintf(ibw_lasterr, "ibw_init: unknown name %s\n", name);
 			return -1;
@@ -1172,13 +1205,23 @@ int ibw_alloc_send_buf(struct ibw_conn *conn, void **buf, void **key, uint32_t l
 
 		if (len <= pctx->opts.recv_bufsize) {
 			*buf = (void *)p->buf;
+			p->send_large = 0;
 		} else {
-			p->buf_large = ibw_alloc_mr(pctx, pconn, len, &p->mr_large);
+			/* reuse the cached registration when it is big enough */
+			if (p->buf_large!=NULL && p->large_size<len) {
+				ibw_free_mr(&p->buf_large, &p->mr_large);
+				p->large_size = 0;
+			}
 			if (p->buf_large==NULL) {
-				sprintf(ibw_lasterr, "ibw_alloc_mr#1 failed\n");
-				goto error;
+				p->buf_large = ibw_alloc_mr(pctx, pconn, len, &p->mr_large);
+				if (p->buf_large==NULL) {
+					sprintf(ibw_lasterr, "ibw_alloc_mr#1 failed\n");
+					goto error;
+				}
+				p->large_size = len;
 			}
 			*buf = (void *)p->buf_large;
+			p->send_large = 1;
 		}
 		/* p->wr_id is already filled in ibw_init_memory */
 	} else {
@@ -1208,6 +1251,8 @@ int ibw_alloc_send_buf(struct ibw_conn *conn, void **buf, void **key, uint32_t l
 			sprintf(ibw_lasterr, "ibw_alloc_mr#2 failed\n");
 			goto error;
 		}
+		p->large_size = len;
+		p->send_large = 1;
 		*buf = (void *)p->buf_large;
 
 		DLIST_REMOVE(pconn->extra_avail, p);
@@ -1247,7 +1292,7 @@ static int ibw_send_packet(struct ibw_conn *conn, void *buf, struct ibw_wr *p, u
 			.send_flags = IBV_SEND_SIGNALED,
 		};
 
-		if (p->buf_large==NULL) {
+		if (!p->send_large) {
 			DEBUG(DEBUG_DEBUG, ("ibw_send#normal(cmid: %p, wrid: %u, n: %d)\n",
 				pconn->cm_id, (uint32_t)wr.wr_id, len));
 		} else {
@@ -1256,6 +1301,11 @@ static int ibw_send_packet(struct ibw_conn *conn, void *buf, struct ibw_wr *p, u
 			list.lkey = p->mr_large->lkey;
 		}
 
+		/* the hca copies inline data at post time,
+		 * saving a dma per small packet */
+		if (len <= pconn->max_inline_data)
+			wr.send_flags |= IBV_SEND_INLINE;
+
 		rc = ibv_post_send(pconn->cm_id->qp, &wr, &bad_wr);
 		if (rc) {
 			sprintf(ibw_lasterr, "ibv_post_send error %d (%d)\n",
@@ -1340,16 +1390,19 @@ int ibw_cancel_send_buf(struct ibw_conn *conn, void *buf, void *key)
 	assert(buf!=NULL);
 	assert(conn!=NULL);
 
-	if (p->buf_large!=NULL)
-		ibw_free_mr(&p->buf_large, &p->mr_large);
-
 	/* parallel case */
 	if (p->wr_id < pctx->opts.max_send_wr) {
 		DEBUG(DEBUG_DEBUG, ("ibw_cancel_send_buf#1 %u", (int)p->wr_id));
+		p->send_large = 0; /* the cached registration is kept */
 		DLIST_REMOVE(pconn->wr_list_used, p);
 		DLIST_ADD(pconn->wr_list_avail, p);
 	} else { /* "extra" packet */
 		DEBUG(DEBUG_DEBUG, ("ibw_cancel_send_buf#2 %u", (int)p->wr_id));
+		if (p->buf_large!=NULL) {
+			ibw_free_mr(&p->buf_large, &p->mr_large);
+			p->large_size = 0;
+		}
+		p->send_large = 0;
 		DLIST_REMOVE(pconn->extra_sent, p);
 		DLIST_ADD(pconn->extra_avail, p);
 	}
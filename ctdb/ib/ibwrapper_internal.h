@@ -25,6 +25,8 @@ struct ibw_opts {
 	uint32_t	max_recv_wr;
 	uint32_t	recv_bufsize;
 	uint32_t	recv_threshold;
+	uint32_t	max_inline_data; /* requested at qp creation */
+	uint32_t	send_threshold; /* max size of a cached "large" send mr */
 };
 
 struct ibw_wr {
@@ -33,6 +35,8 @@ struct ibw_wr {
 
 	char	*buf_large; /* allocated specially for "large" message */
 	struct ibv_mr *mr_large;
+	uint32_t	large_size; /* registered size of buf_large - kept cached */
+	int	send_large; /* the send in progress uses buf_large */
 	int	ref_cnt; /* reference count for ibw_wc_send to know when to release */
 
 	char	*queued_msg; /* set at ibw_send - can be different than above */
@@ -76,6 +80,7 @@ struct ibw_conn_priv {
 	int	is_accepted;
 
 	struct ibv_cq	*cq; /* qp is in cm_id */
+	uint32_t	max_inline_data; /* granted by the hca at qp creation */
 
 	char *buf_send; /* max_send_wr * avg_send_size */
 	struct ibv_mr *mr_send;
@@ -113,9 +113,13 @@ struct ctdb_tunable {
 	uint32_t lcp2_public_ip_assignment;
 	uint32_t allow_client_db_attach;
 	uint32_t recover_pdb_by_seqnum;
+	uint32_t persistent_commit_window;
+	uint32_t recover_parallel_dbs;
 	uint32_t deferred_rebalance_on_node_add;
 	uint32_t fetch_collapse;
 	uint32_t hopcount_make_sticky;
+	uint32_t migrations_make_sticky;
+	uint32_t hot_keys_decay_interval;
 	uint32_t sticky_duration;
 	uint32_t sticky_pindown;
 	uint32_t no_ip_takeover;
@@ -127,6 +131,8 @@ struct ctdb_tunable {
 	uint32_t samba3_hack;
 	uint32_t mutex_enabled;
 	uint32_t lock_processes_per_db;
+	uint32_t lock_helper_pool_size;
+	uint32_t traverse_window_size;
 };
 
 /*
@@ -566,6 +572,8 @@ struct ctdb_db_context {
 	int pending_requests;
 	struct revokechild_handle *revokechild_active;
 	struct ctdb_persistent_state *persistent_state;
+	struct ctdb_persistent_commit *pending_commits;
+	struct timed_event *commit_window_te;
 	struct trbt_tree *delete_queue;
 	struct trbt_tree *sticky_records; 
 	int (*ctdb_ltdb_store_fn)(struct ctdb_db_context *ctdb_db,
@@ -580,6 +588,9 @@ struct ctdb_db_context {
 	struct trbt_tree *defer_dmaster;
 
 	struct ctdb_db_statistics statistics;
+	/* last time the hot key counters were aged, see
+	   ctdb_db_statistics_decay_hot_keys() */
+	struct timeval statistics_decay_time;
 
 	struct lock_context *lock_current;
 	struct lock_context *lock_pending;
@@ -967,7 +978,7 @@ int32_t ctdb_control_traverse_start(struct ctdb_context *ctdb, TDB_DATA indata,
 				    TDB_DATA *outdata, uint32_t srcnode, uint32_t client_id);
 int32_t ctdb_control_traverse_all(struct ctdb_context *ctdb, TDB_DATA data, TDB_DATA *outdata);
 int32_t ctdb_control_traverse_all_ext(struct ctdb_context *ctdb, TDB_DATA data, TDB_DATA *outdata);
-int32_t ctdb_control_traverse_data(struct ctdb_context *ctdb, TDB_DATA data, TDB_DATA *outdata);
+int32_t ctdb_control_traverse_data(struct ctdb_context *ctdb, TDB_DATA data, TDB_DATA *outdata, uint32_t srcnode);
 int32_t ctdb_control_traverse_kill(struct ctdb_context *ctdb, TDB_DATA indata, 
 				    TDB_DATA *outdata, uint32_t srcnode);
 
@@ -1271,6 +1282,9 @@ int32_t ctdb_control_trans3_commit(struct ctdb_context *ctdb,
 
 void ctdb_persistent_finish_trans3_commits(struct ctdb_context *ctdb);
 
+void ctdb_persistent_drop_client_commits(struct ctdb_db_context *ctdb_db,
+					 struct ctdb_client *client);
+
 int32_t ctdb_control_transaction_start(struct ctdb_context *ctdb, uint32_t id);
 int32_t ctdb_control_transaction_commit(struct ctdb_context *ctdb, uint32_t id);
 int32_t ctdb_control_transaction_cancel(struct ctdb_context *ctdb);
@@ -1453,6 +1467,8 @@ int32_t ctdb_control_get_db_statistics(struct ctdb_context *ctdb,
 				uint32_t db_id,
 				TDB_DATA *outdata);
 
+void ctdb_db_statistics_decay_hot_keys(struct ctdb_db_context *ctdb_db);
+
 int ctdb_set_db_sticky(struct ctdb_context *ctdb, struct ctdb_db_context *ctdb_db);
 
 /*
@@ -1497,6 +1513,8 @@ struct lock_request *ctdb_lock_alldb(TALLOC_CTX *mem_ctx,
 				     void (*callback)(void *, bool),
 				     void *private_data);
 
+void ctdb_lock_helper_pool_drop_db(struct ctdb_db_context *ctdb_db);
+
 int mkdir_p(const char *dir, int mode);
 void mkdir_p_or_die(const char *dir, int mode);
 
@@ -203,6 +203,9 @@ struct ctdb_call_info {
 /* Range of ports reserved for traversals */
 #define CTDB_SRVID_TRAVERSE_RANGE  0xBE00000000000000LL
 
+/* Range of ports reserved for traverse flow control acks */
+#define CTDB_SRVID_TRAVERSE_ACK_RANGE  0xBD00000000000000LL
+
 /* used on the domain socket, send a pdu to the local daemon */
 #define CTDB_CURRENT_NODE     0xF0000001
 /* send a broadcast to all nodes in the cluster, active or not */
@@ -728,12 +731,19 @@ struct ctdb_db_statistics {
 	} vacuum;
 	uint32_t db_ro_delegations;
 	uint32_t db_ro_revokes;
+	uint32_t db_migrations;
+	uint32_t db_sticky_promotions;
 	uint32_t hop_count_bucket[MAX_COUNT_BUCKETS];
 	uint32_t num_hot_keys;
 	struct {
 		uint32_t count;
 		TDB_DATA key;
 	} hot_keys[MAX_HOT_KEYS];
+	uint32_t num_migrated_keys;
+	struct {
+		uint32_t count;
+		TDB_DATA key;
+	} migrated_keys[MAX_HOT_KEYS];
 	char hot_keys_wire[1];
 };
 
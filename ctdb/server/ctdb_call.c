@@ -702,6 +702,8 @@ ctdb_make_record_sticky(struct ctdb_context *ctdb, struct ctdb_db_context *ctdb_
 
 	event_add_timed(ctdb->ev, sr, timeval_current_ofs(ctdb->tunable.sticky_duration, 0), ctdb_sticky_record_timeout, sr);
 
+	CTDB_INCREMENT_DB_STAT(ctdb_db, db_sticky_promotions);
+
 	talloc_free(tmp_ctx);
 	return 0;
 }
@@ -843,6 +845,136 @@ sort_keys:
 	}
 }
 
+/*
+  age the hot key counters so that they reflect the current workload
+  and not ancient history. Every HotKeysDecayInterval seconds all
+  counts are halved; a record that has stopped migrating falls out of
+  the heavy hitter list after a few intervals. The aging is done
+  lazily from the update and inspection paths, so an idle database
+  pays nothing.
+*/
+void ctdb_db_statistics_decay_hot_keys(struct ctdb_db_context *ctdb_db)
+{
+	struct ctdb_context *ctdb = ctdb_db->ctdb;
+	uint32_t interval = ctdb->tunable.hot_keys_decay_interval;
+	double elapsed;
+	uint32_t n;
+	int i;
+
+	if (interval == 0) {
+		return;
+	}
+
+	if (timeval_is_zero(&ctdb_db->statistics_decay_time)) {
+		ctdb_db->statistics_decay_time = timeval_current();
+		return;
+	}
+
+	elapsed = timeval_elapsed(&ctdb_db->statistics_decay_time);
+	if (elapsed < interval) {
+		return;
+	}
+	if (elapsed >= 32.0 * interval) {
+		n = 32;
+	} else {
+		n = elapsed / interval;
+	}
+
+	for (i = 0; i < MAX_HOT_KEYS; i++) {
+		if (n >= 32) {
+			ctdb_db->statistics.hot_keys[i].count = 0;
+			ctdb_db->statistics.migrated_keys[i].count = 0;
+		} else {
+			ctdb_db->statistics.hot_keys[i].count >>= n;
+			ctdb_db->statistics.migrated_keys[i].count >>= n;
+		}
+	}
+
+	ctdb_db->statistics_decay_time = timeval_current();
+}
+
+/*
+  track how often individual records migrate away from this node. The
+  hop count based hot keys do not show a record that ping-pongs
+  between two nodes, because every request finds it within a hop or
+  two; what hurts there is the constant migration itself.
+*/
+static void
+ctdb_update_db_stat_migrations(struct ctdb_db_context *ctdb_db, TDB_DATA key)
+{
+	struct ctdb_context *ctdb = ctdb_db->ctdb;
+	uint32_t count;
+	TDB_DATA tmp_key;
+	int i, id;
+
+	CTDB_INCREMENT_DB_STAT(ctdb_db, db_migrations);
+
+	ctdb_db_statistics_decay_hot_keys(ctdb_db);
+
+	/* see if we already track this key */
+	for (i = 0; i < MAX_HOT_KEYS; i++) {
+		if (key.dsize != ctdb_db->statistics.migrated_keys[i].key.dsize) {
+			continue;
+		}
+		if (memcmp(key.dptr, ctdb_db->statistics.migrated_keys[i].key.dptr, key.dsize)) {
+			continue;
+		}
+		ctdb_db->statistics.migrated_keys[i].count++;
+
+		/* promote records that keep migrating to sticky. The
+		   decay gives this hysteresis: once the sticky flag
+		   expires after StickyDuration seconds the record is
+		   only promoted again if it is still migrating often
+		   enough to keep the decaying counter above the
+		   threshold.
+		*/
+		if (ctdb_db->sticky &&
+		    ctdb->tunable.migrations_make_sticky > 0 &&
+		    ctdb_db->statistics.migrated_keys[i].count >=
+		    ctdb->tunable.migrations_make_sticky) {
+			ctdb_make_record_sticky(ctdb, ctdb_db, key);
+		}
+		goto sort_keys;
+	}
+
+	/* smallest value is always at index 0. Give a new key a slot
+	   as long as the smallest tracked key has not proven itself
+	   with repeat migrations */
+	if (ctdb_db->statistics.migrated_keys[0].count > 1) {
+		return;
+	}
+
+	if (ctdb_db->statistics.num_migrated_keys < MAX_HOT_KEYS) {
+		id = ctdb_db->statistics.num_migrated_keys;
+		ctdb_db->statistics.num_migrated_keys++;
+	} else {
+		id = 0;
+	}
+
+	if (ctdb_db->statistics.migrated_keys[id].key.dptr != NULL) {
+		talloc_free(ctdb_db->statistics.migrated_keys[id].key.dptr);
+	}
+	ctdb_db->statistics.migrated_keys[id].key.dsize = key.dsize;
+	ctdb_db->statistics.migrated_keys[id].key.dptr  = talloc_memdup(ctdb_db, key.dptr, key.dsize);
+	ctdb_db->statistics.migrated_keys[id].count = 1;
+
+sort_keys:
+	for (i = 1; i < MAX_HOT_KEYS; i++) {
+		if (ctdb_db->statistics.migrated_keys[i].count == 0) {
+			continue;
+		}
+		if (ctdb_db->statistics.migrated_keys[i].count < ctdb_db->statistics.migrated_keys[0].count) {
+			count = ctdb_db->statistics.migrated_keys[i].count;
+			ctdb_db->statistics.migrated_keys[i].count = ctdb_db->statistics.migrated_keys[0].count;
+			ctdb_db->statistics.migrated_keys[0].count = count;
+
+			tmp_key = ctdb_db->statistics.migrated_keys[i].key;
+			ctdb_db->statistics.migrated_keys[i].key = ctdb_db->statistics.migrated_keys[0].key;
+			ctdb_db->statistics.migrated_keys[0].key = tmp_key;
+		}
+	}
+}
+
 /*
   called when a CTDB_REQ_CALL packet comes in
 */
@@ -1076,9 +1208,25 @@ void ctdb_request_call(struct ctdb_context *ctdb, struct ctdb_req_header *hdr)
 			DEBUG(DEBUG_INFO, (__location__ " refusing migration"
 			      " of key %s while transaction is active\n",
 			      (char *)call->key.dptr));
+			talloc_free(call);
+			return;
+		}
+		if ((c->flags & CTDB_WANT_READONLY)
+		&&  (header.flags & CTDB_REC_RO_HAVE_DELEGATIONS)) {
+			/* A record with outstanding read-only
+			   delegations is serving a stable-read
+			   workload. Keep the dmaster role and the
+			   delegations where they are and answer the
+			   read here; migrating the record would force
+			   a bulk revoke just to move it to yet
+			   another reader.
+			*/
+			DEBUG(DEBUG_DEBUG,("pnn %u answering read for delegated record %08x locally\n",
+				 ctdb->pnn, ctdb_hash(&(call->key))));
 		} else {
 			DEBUG(DEBUG_DEBUG,("pnn %u starting migration of %08x to %u\n",
 				 ctdb->pnn, ctdb_hash(&(call->key)), c->hdr.srcnode));
+			ctdb_update_db_stat_migrations(ctdb_db, call->key);
 			ctdb_call_send_dmaster(ctdb_db, c, &header, &(call->key), &data);
 			talloc_free(data.dptr);
 
@@ -1086,9 +1234,9 @@ void ctdb_request_call(struct ctdb_context *ctdb, struct ctdb_req_header *hdr)
 			if (ret != 0) {
 				DEBUG(DEBUG_ERR,(__location__ " ctdb_ltdb_unlock() failed with error %d\n", ret));
 			}
+			talloc_free(call);
+			return;
 		}
-		talloc_free(call);
-		return;
 	}
 
 	ret = ctdb_call_local(ctdb_db, call, &header, hdr, &data, true);
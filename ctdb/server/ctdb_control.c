@@ -288,7 +288,7 @@ static int32_t ctdb_control_dispatch(struct ctdb_context *ctdb,
 		return ctdb_control_traverse_all_ext(ctdb, indata, outdata);
 
 	case CTDB_CONTROL_TRAVERSE_DATA:
-		return ctdb_control_traverse_data(ctdb, indata, outdata);
+		return ctdb_control_traverse_data(ctdb, indata, outdata, srcnode);
 
 	case CTDB_CONTROL_TRAVERSE_KILL:
 		CHECK_CONTROL_DATA_SIZE(sizeof(struct ctdb_traverse_start));
@@ -244,9 +244,11 @@ static int ctdb_client_destructor(struct ctdb_client *client)
 		/*
 		 * trans3 transaction state:
 		 *
-		 * The destructor sets the pointer to NULL.
+		 * Drop the commits of this client; commits batched
+		 * with them from other clients are finished by the
+		 * recovery.
 		 */
-		talloc_free(ctdb_db->persistent_state);
+		ctdb_persistent_drop_client_commits(ctdb_db, client);
 	}
 
 	return 0;
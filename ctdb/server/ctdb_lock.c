@@ -35,6 +35,14 @@
  * 4. If the child process cannot get locks within certain time,
  *    execute an external script to debug.
  *
+ * Record locks are served by a pool of long-lived helper processes
+ * (bounded by the LockHelperPoolSize tunable) which receive work over
+ * a command pipe and release locks on command, instead of forking one
+ * helper per lock request.  Each helper keeps the database from its
+ * last request open, so repeated locks on the same database avoid the
+ * re-open cost.  The locks are still taken in a separate process, so
+ * the main daemon can never block on a contended lock.
+ *
  * ctdb_lock_record()      - get a lock on a record
  * ctdb_lock_db()          - get a lock on a DB
  * ctdb_lock_alldb_prio()  - get a lock on all DBs with given priority
@@ -62,6 +70,7 @@ static const char * const lock_type_str[] = {
 };
 
 struct lock_request;
+struct lock_helper;
 
 /* lock_context is the common part for a lock request */
 struct lock_context {
@@ -73,6 +82,7 @@ struct lock_context {
 	uint32_t priority;
 	bool auto_mark;
 	struct lock_request *request;
+	struct lock_helper *helper;
 	pid_t child;
 	int fd[2];
 	struct tevent_fd *tfd;
@@ -89,6 +99,32 @@ struct lock_request {
 	void *private_data;
 };
 
+/*
+ * A long-lived helper process from the lock helper pool.
+ *
+ * Each helper serves one record lock request at a time.  A helper
+ * keeps the database from its last request open, so the scheduler
+ * prefers the helper whose open database matches the request
+ * (per-database affinity).  A granted lock is released by sending an
+ * UNLOCK command; a helper that is still blocked waiting for a lock
+ * can only be stopped by killing it.
+ */
+struct lock_helper {
+	struct lock_helper *prev, *next;
+	struct ctdb_context *ctdb;
+	struct ctdb_db_context *ctdb_db;
+	struct lock_context *lock_ctx;
+	pid_t pid;
+	int cmd_fd;
+	int result_fd;
+	struct tevent_fd *tfd;
+	bool result_received;
+	bool granted;
+};
+
+static struct lock_helper *lock_helper_pool;
+static int lock_helper_count;
+
 
 /*
  * Support samba 3.6.x (and older) versions which do not set db priority.
@@ -276,11 +312,38 @@ static void ctdb_lock_schedule(struct ctdb_context *ctdb);
  */
 static int ctdb_lock_context_destructor(struct lock_context *lock_ctx)
 {
+	bool scheduled = false;
+
 	if (lock_ctx->request) {
 		lock_ctx->request->lctx = NULL;
 	}
-	if (lock_ctx->child > 0) {
-		ctdb_kill(lock_ctx->ctdb, lock_ctx->child, SIGKILL);
+	if (lock_ctx->helper != NULL) {
+		struct lock_helper *helper = lock_ctx->helper;
+
+		lock_ctx->helper = NULL;
+		helper->lock_ctx = NULL;
+		if (!helper->result_received) {
+			/* The helper is still blocked waiting for the lock;
+			 * the only way to abandon the request is to kill it.
+			 */
+			talloc_free(helper);
+		} else if (helper->granted) {
+			if (sys_write(helper->cmd_fd, "UNLOCK\n", 7) != 7) {
+				DEBUG(DEBUG_ERR, ("Failed to send unlock to "
+						  "lock helper %d\n",
+						  helper->pid));
+				talloc_free(helper);
+			}
+		} else if (helper->pid == -1) {
+			/* The helper exited while serving this request */
+			talloc_free(helper);
+		}
+		scheduled = true;
+	}
+	if (lock_ctx->child > 0 || scheduled) {
+		if (lock_ctx->child > 0) {
+			ctdb_kill(lock_ctx->ctdb, lock_ctx->child, SIGKILL);
+		}
 		if (lock_ctx->type == LOCK_RECORD) {
 			DLIST_REMOVE(lock_ctx->ctdb_db->lock_current, lock_ctx);
 		} else {
@@ -430,35 +493,19 @@ static int lock_bucket_id(double t)
 }
 
 /*
- * Callback routine when the required locks are obtained.
- * Called from parent context
+ * Update statistics and process callbacks for a completed lock request
  */
-static void ctdb_lock_handler(struct tevent_context *ev,
-			    struct tevent_fd *tfd,
-			    uint16_t flags,
-			    void *private_data)
+static void ctdb_lock_process_result(struct lock_context *lock_ctx, bool locked)
 {
-	struct lock_context *lock_ctx;
-	char c;
-	bool locked;
 	double t;
 	int id;
 
-	lock_ctx = talloc_get_type_abort(private_data, struct lock_context);
-
 	/* cancel the timeout event */
 	TALLOC_FREE(lock_ctx->ttimer);
 
 	t = timeval_elapsed(&lock_ctx->start_time);
 	id = lock_bucket_id(t);
 
-	/* Read the status from the child process */
-	if (sys_read(lock_ctx->fd[0], &c, 1) != 1) {
-		locked = false;
-	} else {
-		locked = (c == 0 ? true : false);
-	}
-
 	/* Update statistics */
 	CTDB_INCREMENT_STAT(lock_ctx->ctdb, locks.num_calls);
 	if (lock_ctx->ctdb_db) {
@@ -486,6 +533,32 @@ static void ctdb_lock_handler(struct tevent_context *ev,
 }
 
 
+/*
+ * Callback routine when the required locks are obtained.
+ * Called from parent context
+ */
+static void ctdb_lock_handler(struct tevent_context *ev,
+			    struct tevent_fd *tfd,
+			    uint16_t flags,
+			    void *private_data)
+{
+	struct lock_context *lock_ctx;
+	char c;
+	bool locked;
+
+	lock_ctx = talloc_get_type_abort(private_data, struct lock_context);
+
+	/* Read the status from the child process */
+	if (sys_read(lock_ctx->fd[0], &c, 1) != 1) {
+		locked = false;
+	} else {
+		locked = (c == 0 ? true : false);
+	}
+
+	ctdb_lock_process_result(lock_ctx, locked);
+}
+
+
 /*
  * Callback routine when required locks are not obtained within timeout
  * Called from parent context
@@ -693,6 +766,313 @@ static bool lock_helper_args(TALLOC_CTX *mem_ctx,
 	return true;
 }
 
+/*
+ * Destructor to remove a helper process from the pool
+ */
+static int ctdb_lock_helper_destructor(struct lock_helper *helper)
+{
+	DLIST_REMOVE(lock_helper_pool, helper);
+	lock_helper_count--;
+
+	if (helper->lock_ctx != NULL) {
+		helper->lock_ctx->helper = NULL;
+		helper->lock_ctx = NULL;
+	}
+
+	if (helper->pid > 0) {
+		ctdb_kill(helper->ctdb, helper->pid, SIGKILL);
+	}
+	if (helper->cmd_fd != -1) {
+		close(helper->cmd_fd);
+	}
+
+	return 0;
+}
+
+/*
+ * Callback routine when a pool helper reports a locking result or exits.
+ * Called from parent context
+ */
+static void ctdb_lock_helper_result_handler(struct tevent_context *ev,
+					    struct tevent_fd *tfd,
+					    uint16_t flags,
+					    void *private_data)
+{
+	struct lock_helper *helper;
+	struct lock_context *lock_ctx;
+	char c;
+
+	helper = talloc_get_type_abort(private_data, struct lock_helper);
+	lock_ctx = helper->lock_ctx;
+
+	if (sys_read(helper->result_fd, &c, 1) != 1) {
+		DEBUG(DEBUG_ERR, ("Lock helper %d exited unexpectedly\n",
+				  helper->pid));
+		helper->pid = -1;
+		helper->result_received = true;
+		helper->granted = false;
+		TALLOC_FREE(helper->tfd);
+		close(helper->cmd_fd);
+		helper->cmd_fd = -1;
+
+		if (lock_ctx == NULL) {
+			talloc_free(helper);
+			return;
+		}
+
+		/* Fail the in-flight request.  If the lock context survives
+		 * the callbacks, its destructor frees the helper when it
+		 * lets go of it.
+		 */
+		ctdb_lock_process_result(lock_ctx, false);
+		return;
+	}
+
+	if (lock_ctx == NULL) {
+		DEBUG(DEBUG_WARNING, ("Unexpected result from idle lock "
+				      "helper %d\n", helper->pid));
+		return;
+	}
+
+	helper->result_received = true;
+	helper->granted = (c == 0 ? true : false);
+
+	ctdb_lock_process_result(lock_ctx, helper->granted);
+}
+
+/*
+ * Start a new long-lived helper process for the pool
+ */
+static struct lock_helper *ctdb_lock_helper_start(struct ctdb_context *ctdb,
+						  const char *prog)
+{
+	struct lock_helper *helper;
+	const char **args;
+	int cmd_pipe[2] = { -1, -1 };
+	int result_pipe[2] = { -1, -1 };
+	int i;
+
+	helper = talloc_zero(ctdb, struct lock_helper);
+	if (helper == NULL) {
+		DEBUG(DEBUG_ERR, ("Failed to allocate lock helper\n"));
+		return NULL;
+	}
+	helper->ctdb = ctdb;
+	helper->pid = -1;
+	helper->cmd_fd = -1;
+	helper->result_fd = -1;
+
+	if (pipe(cmd_pipe) != 0 || pipe(result_pipe) != 0) {
+		DEBUG(DEBUG_ERR, ("Failed to create pipes for lock helper\n"));
+		goto fail;
+	}
+
+	set_close_on_exec(cmd_pipe[1]);
+	set_close_on_exec(result_pipe[0]);
+
+	args = talloc_array(helper, const char *, 5);
+	if (args == NULL) {
+		goto fail;
+	}
+
+	args[0] = talloc_asprintf(args, "%d", getpid());
+	args[1] = talloc_asprintf(args, "%d", result_pipe[1]);
+	args[2] = talloc_strdup(args, "POOL");
+	args[3] = talloc_asprintf(args, "%d", cmd_pipe[0]);
+	args[4] = NULL;
+
+	for (i=0; i<4; i++) {
+		if (args[i] == NULL) {
+			goto fail;
+		}
+	}
+
+	if (!ctdb_vfork_with_logging(helper, ctdb, "lock_helper",
+				     prog, 5, args, NULL, NULL,
+				     &helper->pid)) {
+		DEBUG(DEBUG_ERR, ("Failed to start pool lock helper\n"));
+		goto fail;
+	}
+
+	close(cmd_pipe[0]);
+	close(result_pipe[1]);
+	helper->cmd_fd = cmd_pipe[1];
+	helper->result_fd = result_pipe[0];
+
+	helper->tfd = tevent_add_fd(ctdb->ev,
+				    helper,
+				    helper->result_fd,
+				    EVENT_FD_READ,
+				    ctdb_lock_helper_result_handler,
+				    (void *)helper);
+	if (helper->tfd == NULL) {
+		ctdb_kill(ctdb, helper->pid, SIGKILL);
+		close(helper->cmd_fd);
+		close(helper->result_fd);
+		talloc_free(helper);
+		return NULL;
+	}
+	tevent_fd_set_auto_close(helper->tfd);
+
+	DLIST_ADD(lock_helper_pool, helper);
+	lock_helper_count++;
+	talloc_set_destructor(helper, ctdb_lock_helper_destructor);
+
+	DEBUG(DEBUG_INFO, ("Started lock helper %d (%d in pool)\n",
+			   helper->pid, lock_helper_count));
+
+	return helper;
+
+fail:
+	if (cmd_pipe[0] != -1) {
+		close(cmd_pipe[0]);
+		close(cmd_pipe[1]);
+	}
+	if (result_pipe[0] != -1) {
+		close(result_pipe[0]);
+		close(result_pipe[1]);
+	}
+	talloc_free(helper);
+	return NULL;
+}
+
+/*
+ * Send a record lock request to a pool helper
+ */
+static int ctdb_lock_helper_assign(struct lock_helper *helper,
+				   struct lock_context *lock_ctx)
+{
+	char *cmd;
+	char *keyhex = NULL;
+	size_t len;
+
+	if (lock_ctx->key.dsize > 0) {
+		keyhex = hex_encode_talloc(lock_ctx, lock_ctx->key.dptr,
+					   lock_ctx->key.dsize);
+		if (keyhex == NULL) {
+			return -1;
+		}
+	}
+
+	/* The database path goes last, so that it may contain spaces */
+	cmd = talloc_asprintf(lock_ctx, "LOCK 0x%x %s %s\n",
+			      db_flags(lock_ctx->ctdb_db),
+			      (keyhex != NULL ? keyhex : "NULL"),
+			      lock_ctx->ctdb_db->db_path);
+	TALLOC_FREE(keyhex);
+	if (cmd == NULL) {
+		return -1;
+	}
+
+	len = strlen(cmd);
+	if (sys_write(helper->cmd_fd, cmd, len) != (ssize_t)len) {
+		DEBUG(DEBUG_ERR, ("Failed to send lock request to helper %d\n",
+				  helper->pid));
+		talloc_free(cmd);
+		return -1;
+	}
+	talloc_free(cmd);
+
+	helper->ctdb_db = lock_ctx->ctdb_db;
+	helper->lock_ctx = lock_ctx;
+	helper->result_received = false;
+	helper->granted = false;
+	lock_ctx->helper = helper;
+	lock_ctx->child = -1;
+
+	return 0;
+}
+
+/*
+ * Schedule a record lock request on a pool helper
+ *
+ * Returns 0 if the request was handed to a helper, a positive value if
+ * all helpers are busy and the request should stay queued, and -1 if
+ * the pool could not be used at all.
+ */
+static int ctdb_lock_schedule_on_helper(struct ctdb_context *ctdb,
+					struct lock_context *lock_ctx,
+					const char *prog)
+{
+	struct lock_helper *helper;
+	struct lock_helper *idle = NULL;
+
+	/* Prefer an idle helper that already has this database open */
+	for (helper = lock_helper_pool; helper != NULL; helper = helper->next) {
+		if (helper->lock_ctx != NULL) {
+			continue;
+		}
+		if (helper->ctdb_db == lock_ctx->ctdb_db) {
+			idle = helper;
+			break;
+		}
+		if (idle == NULL) {
+			idle = helper;
+		}
+	}
+
+	if (idle == NULL) {
+		if (lock_helper_count >=
+		    ctdb->tunable.lock_helper_pool_size) {
+			/* All helpers are busy; leave the request queued
+			 * until one of them finishes.
+			 */
+			return 1;
+		}
+		idle = ctdb_lock_helper_start(ctdb, prog);
+		if (idle == NULL) {
+			return -1;
+		}
+	}
+
+	if (ctdb_lock_helper_assign(idle, lock_ctx) != 0) {
+		talloc_free(idle);
+		return -1;
+	}
+
+	/* Set up timeout handler */
+	lock_ctx->ttimer = tevent_add_timer(ctdb->ev,
+					    lock_ctx,
+					    timeval_current_ofs(10, 0),
+					    ctdb_lock_timeout_handler,
+					    (void *)lock_ctx);
+	if (lock_ctx->ttimer == NULL) {
+		/* The lock request is already on its way to the helper,
+		 * so the helper has to go as well.
+		 */
+		lock_ctx->helper = NULL;
+		idle->lock_ctx = NULL;
+		talloc_free(idle);
+		return -1;
+	}
+
+	/* Move the context from pending to current */
+	DLIST_REMOVE(lock_ctx->ctdb_db->lock_pending, lock_ctx);
+	DLIST_ADD_END(lock_ctx->ctdb_db->lock_current, lock_ctx, NULL);
+	CTDB_DECREMENT_STAT(ctdb, locks.num_pending);
+	CTDB_INCREMENT_STAT(ctdb, locks.num_current);
+	lock_ctx->ctdb_db->lock_num_current++;
+	CTDB_DECREMENT_DB_STAT(lock_ctx->ctdb_db, locks.num_pending);
+	CTDB_INCREMENT_DB_STAT(lock_ctx->ctdb_db, locks.num_current);
+
+	return 0;
+}
+
+/*
+ * Drop pool helpers serving a database that is going away
+ */
+void ctdb_lock_helper_pool_drop_db(struct ctdb_db_context *ctdb_db)
+{
+	struct lock_helper *helper, *next;
+
+	for (helper = lock_helper_pool; helper != NULL; helper = next) {
+		next = helper->next;
+		if (helper->ctdb_db == ctdb_db) {
+			talloc_free(helper);
+		}
+	}
+}
+
 /*
  * Find a lock request that can be scheduled
  */
@@ -778,6 +1158,16 @@ static void ctdb_lock_schedule(struct ctdb_context *ctdb)
 		return;
 	}
 
+	/* Record locks are served by the helper pool */
+	if (lock_ctx->type == LOCK_RECORD &&
+	    ctdb->tunable.lock_helper_pool_size > 0) {
+		ret = ctdb_lock_schedule_on_helper(ctdb, lock_ctx, prog);
+		if (ret >= 0) {
+			return;
+		}
+		/* Could not use the pool, fall back to a one-shot child */
+	}
+
 	lock_ctx->child = -1;
 	ret = pipe(lock_ctx->fd);
 	if (ret != 0) {
@@ -40,6 +40,8 @@ static void usage(void)
 		progname);
 	fprintf(stderr, "       %s <log-fd> <ctdbd-pid> <output-fd> DB <db1-path> <db1-flags> [<db2-path> <db2-flags>...]\n",
 		progname);
+	fprintf(stderr, "       %s <log-fd> <ctdbd-pid> <output-fd> POOL <cmd-fd>\n",
+		progname);
 }
 
 static uint8_t *hex_decode_talloc(TALLOC_CTX *mem_ctx,
@@ -117,6 +119,131 @@ static int lock_db(const char *dbpath, const char *dbflags)
 }
 
 
+/*
+ * Pool mode - serve a stream of record lock commands from ctdbd
+ *
+ * Commands are newline terminated:
+ *
+ *   LOCK <db-flags> <db-key> <db-path>
+ *   UNLOCK
+ *
+ * Only one lock is held at a time.  The database from the previous
+ * request is kept open, so consecutive requests for the same database
+ * avoid the re-open cost; the daemon exploits this by preferring a
+ * helper that already serves a database.  EOF on the command pipe
+ * means the daemon has gone away or dropped this helper; exiting
+ * releases any lock still held.
+ */
+static int lock_pool(int cmd_fd, int write_fd)
+{
+	struct tdb_context *tdb = NULL;
+	TDB_DATA key;
+	char dbpath[PATH_MAX+1] = "";
+	char line[PATH_MAX+1024];
+	bool held = false;
+	FILE *cmd;
+
+	key.dptr = NULL;
+	key.dsize = 0;
+
+	cmd = fdopen(cmd_fd, "r");
+	if (cmd == NULL) {
+		fprintf(stderr, "%s: Failed to open command pipe\n", progname);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), cmd) != NULL) {
+		char *flags, *hexkey, *path, *eol;
+		char result = 0;
+
+		eol = strchr(line, '\n');
+		if (eol != NULL) {
+			*eol = '\0';
+		}
+
+		if (strcmp(line, "UNLOCK") == 0) {
+			if (held) {
+				tdb_chainunlock(tdb, key);
+				held = false;
+			}
+			talloc_free(key.dptr);
+			key.dptr = NULL;
+			key.dsize = 0;
+			continue;
+		}
+
+		if (strncmp(line, "LOCK ", 5) != 0) {
+			fprintf(stderr, "%s: Invalid pool command '%s'\n",
+				progname, line);
+			continue;
+		}
+
+		flags = line + 5;
+		hexkey = strchr(flags, ' ');
+		path = (hexkey != NULL ? strchr(hexkey+1, ' ') : NULL);
+		if (path == NULL) {
+			fprintf(stderr, "%s: Invalid LOCK command '%s'\n",
+				progname, line);
+			result = 1;
+			sys_write(write_fd, &result, 1);
+			continue;
+		}
+		*hexkey++ = '\0';
+		*path++ = '\0';
+
+		if (held) {
+			/* Should not happen - the daemon sends one request
+			 * at a time */
+			tdb_chainunlock(tdb, key);
+			held = false;
+		}
+		talloc_free(key.dptr);
+		key.dptr = NULL;
+		key.dsize = 0;
+
+		if (tdb != NULL && strcmp(path, dbpath) != 0) {
+			tdb_close(tdb);
+			tdb = NULL;
+		}
+
+		if (tdb == NULL) {
+			int tdb_flags;
+
+			/* No error checking since CTDB always passes sane
+			 * values */
+			tdb_flags = strtol(flags, NULL, 0);
+
+			tdb = tdb_open(path, 0, tdb_flags, O_RDWR, 0600);
+			if (tdb == NULL) {
+				fprintf(stderr,
+					"%s: Error opening database %s\n",
+					progname, path);
+				result = 1;
+				sys_write(write_fd, &result, 1);
+				continue;
+			}
+			strncpy(dbpath, path, sizeof(dbpath)-1);
+			dbpath[sizeof(dbpath)-1] = '\0';
+		}
+
+		if (strcmp(hexkey, "NULL") != 0) {
+			key.dptr = hex_decode_talloc(NULL, hexkey, &key.dsize);
+		}
+
+		if (tdb_chainlock(tdb, key) < 0) {
+			fprintf(stderr, "%s: Error getting record lock (%s)\n",
+				progname, tdb_errorstr(tdb));
+			result = 1;
+		} else {
+			held = true;
+		}
+		sys_write(write_fd, &result, 1);
+	}
+
+	return 0;
+}
+
+
 int main(int argc, char *argv[])
 {
 	int write_fd, log_fd;
@@ -169,6 +296,15 @@ int main(int argc, char *argv[])
 			}
 		}
 
+	} else if (strcmp(lock_type, "POOL") == 0) {
+		if (argc != 6) {
+			fprintf(stderr, "%s: Invalid number of arguments (%d)\n",
+				progname, argc);
+			usage();
+			exit(1);
+		}
+		return lock_pool(atoi(argv[5]), write_fd);
+
 	} else {
 		fprintf(stderr, "%s: Invalid lock-type '%s'\n", progname, lock_type);
 		usage();
@@ -1277,6 +1277,9 @@ int32_t ctdb_control_db_detach(struct ctdb_context *ctdb, TDB_DATA indata,
 		talloc_free(ctdb_db->rottdb);
 	}
 
+	/* Drop lock helpers serving this database */
+	ctdb_lock_helper_pool_drop_db(ctdb_db);
+
 	DLIST_REMOVE(ctdb->db_list, ctdb_db);
 
 	DEBUG(DEBUG_NOTICE, ("Detached from database '%s'\n",
@@ -1616,9 +1619,13 @@ int32_t ctdb_control_get_db_statistics(struct ctdb_context *ctdb,
 		return -1;
 	}
 
+	/* age the hot key counters so we report current heat */
+	ctdb_db_statistics_decay_hot_keys(ctdb_db);
+
 	len = offsetof(struct ctdb_db_statistics, hot_keys_wire);
 	for (i = 0; i < MAX_HOT_KEYS; i++) {
 		len += ctdb_db->statistics.hot_keys[i].key.dsize;
+		len += ctdb_db->statistics.migrated_keys[i].key.dsize;
 	}
 
 	stats = talloc_size(outdata, len);
@@ -1631,6 +1638,7 @@ int32_t ctdb_control_get_db_statistics(struct ctdb_context *ctdb,
 	       offsetof(struct ctdb_db_statistics, hot_keys_wire));
 
 	stats->num_hot_keys = MAX_HOT_KEYS;
+	stats->num_migrated_keys = MAX_HOT_KEYS;
 
 	ptr = &stats->hot_keys_wire[0];
 	for (i = 0; i < MAX_HOT_KEYS; i++) {
@@ -1638,6 +1646,11 @@ int32_t ctdb_control_get_db_statistics(struct ctdb_context *ctdb,
 		       ctdb_db->statistics.hot_keys[i].key.dsize);
 		ptr += ctdb_db->statistics.hot_keys[i].key.dsize;
 	}
+	for (i = 0; i < MAX_HOT_KEYS; i++) {
+		memcpy(ptr, ctdb_db->statistics.migrated_keys[i].key.dptr,
+		       ctdb_db->statistics.migrated_keys[i].key.dsize);
+		ptr += ctdb_db->statistics.migrated_keys[i].key.dsize;
+	}
 
 	outdata->dptr  = (uint8_t *)stats;
 	outdata->dsize = len;
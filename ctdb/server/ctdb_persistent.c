@@ -25,17 +25,51 @@
 #include "tdb.h"
 #include "../include/ctdb_private.h"
 
+/*
+  one trans3_commit control queued for replication. Commits arriving
+  while an update round is in flight, or within the
+  PersistentCommitWindow gathering delay, are queued on the database
+  and rolled out together in a single round.
+ */
+struct ctdb_persistent_commit {
+	struct ctdb_persistent_commit *next, *prev;
+	struct ctdb_client *client;
+	struct ctdb_req_control *c;
+	TDB_DATA recdata;
+};
+
 struct ctdb_persistent_state {
 	struct ctdb_context *ctdb;
 	struct ctdb_db_context *ctdb_db; /* used by trans3_commit */
-	struct ctdb_client *client; /* used by trans3_commit */
-	struct ctdb_req_control *c;
+	struct ctdb_persistent_commit *commits; /* replied to when the round completes */
 	const char *errormsg;
 	uint32_t num_pending;
 	int32_t status;
 	uint32_t num_failed, num_sent;
 };
 
+static int ctdb_persistent_send_commit_round(struct ctdb_db_context *ctdb_db);
+
+/*
+  send the reply for every trans3_commit control that is part of this
+  commit round and release the queued commits
+ */
+static void ctdb_persistent_reply_commits(struct ctdb_persistent_state *state,
+					  int32_t status, const char *errormsg)
+{
+	struct ctdb_persistent_commit *commit;
+
+	while ((commit = state->commits) != NULL) {
+		DLIST_REMOVE(state->commits, commit);
+		ctdb_request_control_reply(state->ctdb, commit->c, NULL,
+					   status, errormsg);
+		if (commit->client != NULL) {
+			commit->client->db_id = 0;
+		}
+		talloc_free(commit);
+	}
+}
+
 /*
   1) all nodes fail, and all nodes reply
   2) some nodes fail, all nodes reply
@@ -47,12 +81,13 @@ struct ctdb_persistent_state {
   called when a node has acknowledged a ctdb_control_update_record call
  */
 static void ctdb_persistent_callback(struct ctdb_context *ctdb,
-				     int32_t status, TDB_DATA data, 
+				     int32_t status, TDB_DATA data,
 				     const char *errormsg,
 				     void *private_data)
 {
-	struct ctdb_persistent_state *state = talloc_get_type(private_data, 
+	struct ctdb_persistent_state *state = talloc_get_type(private_data,
 							      struct ctdb_persistent_state);
+	struct ctdb_db_context *ctdb_db;
 
 	if (ctdb->recovery_mode != CTDB_RECOVERY_NORMAL) {
 		DEBUG(DEBUG_INFO, ("ctdb_persistent_callback: ignoring reply "
@@ -84,17 +119,24 @@ static void ctdb_persistent_callback(struct ctdb_context *ctdb,
 		return;
 	}
 
-	ctdb_request_control_reply(state->ctdb, state->c, NULL, 0, state->errormsg);
+	ctdb_db = state->ctdb_db;
+
+	ctdb_persistent_reply_commits(state, 0, state->errormsg);
 	talloc_free(state);
+
+	/* roll out commits that were queued up while this round was in
+	   flight */
+	ctdb_persistent_send_commit_round(ctdb_db);
 }
 
 /*
   called if persistent store times out
  */
-static void ctdb_persistent_store_timeout(struct event_context *ev, struct timed_event *te, 
+static void ctdb_persistent_store_timeout(struct event_context *ev, struct timed_event *te,
 					 struct timeval t, void *private_data)
 {
 	struct ctdb_persistent_state *state = talloc_get_type(private_data, struct ctdb_persistent_state);
+	struct ctdb_db_context *ctdb_db = state->ctdb_db;
 
 	if (state->ctdb->recovery_mode != CTDB_RECOVERY_NORMAL) {
 		DEBUG(DEBUG_INFO, ("ctdb_persistent_store_timeout: ignoring "
@@ -102,10 +144,12 @@ static void ctdb_persistent_store_timeout(struct event_context *ev, struct timed
 		return;
 	}
 
-	ctdb_request_control_reply(state->ctdb, state->c, NULL, 1,
-				   "timeout in ctdb_persistent_state");
+	ctdb_persistent_reply_commits(state, 1,
+				      "timeout in ctdb_persistent_state");
 
 	talloc_free(state);
+
+	ctdb_persistent_send_commit_round(ctdb_db);
 }
 
 /**
@@ -128,26 +172,64 @@ void ctdb_persistent_finish_trans3_commits(struct ctdb_context *ctdb)
 	for (ctdb_db = ctdb->db_list; ctdb_db; ctdb_db = ctdb_db->next) {
 		struct ctdb_persistent_state *state;
 
-		if (ctdb_db->persistent_state == NULL) {
+		state = ctdb_db->persistent_state;
+		if (state != NULL) {
+			ctdb_persistent_reply_commits(state, 2,
+					"trans3 commit ended by recovery");
+
+			/* The destructor sets ctdb_db->persistent_state
+			 * to NULL. */
+			talloc_free(state);
+		}
+
+		/* roll out commits that were queued up while the
+		   recovery was running */
+		ctdb_persistent_send_commit_round(ctdb_db);
+	}
+}
+
+/**
+ * A client disconnected while its trans3 commit was queued or in
+ * flight. Throw away its commits, there is no client left to reply
+ * to. Commits from other clients stay queued; the recovery that the
+ * caller triggers finishes them.
+ */
+void ctdb_persistent_drop_client_commits(struct ctdb_db_context *ctdb_db,
+					 struct ctdb_client *client)
+{
+	struct ctdb_persistent_state *state = ctdb_db->persistent_state;
+	struct ctdb_persistent_commit *commit, *next;
+
+	for (commit = ctdb_db->pending_commits; commit != NULL; commit = next) {
+		next = commit->next;
+		if (commit->client != client) {
 			continue;
 		}
+		DLIST_REMOVE(ctdb_db->pending_commits, commit);
+		talloc_free(commit);
+	}
 
-		state = ctdb_db->persistent_state;
+	if (state == NULL) {
+		return;
+	}
 
-		ctdb_request_control_reply(ctdb, state->c, NULL, 2,
-					   "trans3 commit ended by recovery");
+	for (commit = state->commits; commit != NULL; commit = next) {
+		next = commit->next;
+		if (commit->client != client) {
+			continue;
+		}
+		DLIST_REMOVE(state->commits, commit);
+		talloc_free(commit);
+	}
 
-		/* The destructor sets ctdb_db->persistent_state to NULL. */
+	if (state->commits == NULL) {
+		/* nothing left to reply to when the round completes */
 		talloc_free(state);
 	}
 }
 
 static int ctdb_persistent_state_destructor(struct ctdb_persistent_state *state)
 {
-	if (state->client != NULL) {
-		state->client->db_id = 0;
-	}
-
 	if (state->ctdb_db != NULL) {
 		state->ctdb_db->persistent_state = NULL;
 	}
@@ -156,68 +238,110 @@ static int ctdb_persistent_state_destructor(struct ctdb_persistent_state *state)
 }
 
 /*
- * Store a set of persistent records.
- * This is used to roll out a transaction to all nodes.
+  append the records of one marshall buffer to another. Used to merge
+  the record sets of the queued commits into one update round.
  */
-int32_t ctdb_control_trans3_commit(struct ctdb_context *ctdb,
-				   struct ctdb_req_control *c,
-				   TDB_DATA recdata, bool *async_reply)
+static struct ctdb_marshall_buffer *ctdb_persistent_marshall_merge(
+					TALLOC_CTX *mem_ctx,
+					struct ctdb_marshall_buffer *m,
+					struct ctdb_marshall_buffer *m2,
+					size_t m2_size)
 {
-	struct ctdb_client *client;
-	struct ctdb_persistent_state *state;
-	int i;
-	struct ctdb_marshall_buffer *m = (struct ctdb_marshall_buffer *)recdata.dptr;
-	struct ctdb_db_context *ctdb_db;
-
-	if (ctdb->recovery_mode != CTDB_RECOVERY_NORMAL) {
-		DEBUG(DEBUG_INFO,("rejecting ctdb_control_trans3_commit when recovery active\n"));
-		return -1;
+	struct ctdb_marshall_buffer *m3;
+	size_t offset;
+	size_t reclen = m2_size - offsetof(struct ctdb_marshall_buffer, data);
+
+	if (m == NULL) {
+		offset = offsetof(struct ctdb_marshall_buffer, data);
+		m3 = talloc_zero_size(mem_ctx, offset + reclen);
+	} else {
+		offset = talloc_get_size(m);
+		m3 = talloc_realloc_size(mem_ctx, m, offset + reclen);
+	}
+	if (m3 == NULL) {
+		TALLOC_FREE(m);
+		return NULL;
 	}
 
-	client = ctdb_reqid_find(ctdb, c->client_id, struct ctdb_client);
-	if (client == NULL) {
-		DEBUG(DEBUG_ERR,(__location__ " can not match persistent_store "
-				 "to a client. Returning error\n"));
-		return -1;
+	if (m == NULL) {
+		m3->db_id = m2->db_id;
 	}
 
-	if (client->db_id != 0) {
-		DEBUG(DEBUG_ERR,(__location__ " ERROR: trans3_commit: "
-				 "client-db_id[0x%08x] != 0 "
-				 "(client_id[0x%08x]): trans3_commit active?\n",
-				 client->db_id, client->client_id));
-		return -1;
+	memcpy((uint8_t *)m3 + offset, &m2->data[0], reclen);
+	m3->count += m2->count;
+
+	return m3;
+}
+
+/*
+  roll out all queued commits for this database to all active nodes as
+  a single CTDB_CONTROL_UPDATE_RECORD round. The records of the
+  queued commits are merged in arrival order, so one cluster-wide
+  round trip and one local tdb transaction per node covers the whole
+  burst.
+ */
+static int ctdb_persistent_send_commit_round(struct ctdb_db_context *ctdb_db)
+{
+	struct ctdb_context *ctdb = ctdb_db->ctdb;
+	struct ctdb_persistent_state *state;
+	struct ctdb_persistent_commit *commit;
+	struct ctdb_marshall_buffer *m = NULL;
+	TDB_DATA recdata;
+	uint32_t num_commits = 0;
+	int i;
+
+	if (ctdb_db->pending_commits == NULL) {
+		return 0;
 	}
 
-	ctdb_db = find_ctdb_db(ctdb, m->db_id);
-	if (ctdb_db == NULL) {
-		DEBUG(DEBUG_ERR,(__location__ " ctdb_control_trans3_commit: "
-				 "Unknown database db_id[0x%08x]\n", m->db_id));
-		return -1;
+	if (ctdb->recovery_mode != CTDB_RECOVERY_NORMAL) {
+		/* the queue is flushed when the recovery has finished */
+		return 0;
 	}
 
 	if (ctdb_db->persistent_state != NULL) {
-		DEBUG(DEBUG_ERR, (__location__ " Error: "
-				  "ctdb_control_trans3_commit "
-				  "called while a transaction commit is "
-				  "active. db_id[0x%08x]\n", m->db_id));
-		return -1;
+		/* joined to the next round when the current one completes */
+		return 0;
 	}
 
-	ctdb_db->persistent_state = talloc_zero(ctdb_db,
-						struct ctdb_persistent_state);
-	CTDB_NO_MEMORY(ctdb, ctdb_db->persistent_state);
-
-	client->db_id = m->db_id;
+	state = talloc_zero(ctdb_db, struct ctdb_persistent_state);
+	CTDB_NO_MEMORY(ctdb, state);
 
-	state = ctdb_db->persistent_state;
 	state->ctdb = ctdb;
 	state->ctdb_db = ctdb_db;
-	state->c    = c;
-	state->client = client;
 
 	talloc_set_destructor(state, ctdb_persistent_state_destructor);
 
+	while ((commit = ctdb_db->pending_commits) != NULL) {
+		DLIST_REMOVE(ctdb_db->pending_commits, commit);
+		DLIST_ADD_END(state->commits, commit, NULL);
+		talloc_steal(state, commit);
+		num_commits++;
+
+		m = ctdb_persistent_marshall_merge(state, m,
+				(struct ctdb_marshall_buffer *)commit->recdata.dptr,
+				commit->recdata.dsize);
+		if (m == NULL) {
+			DEBUG(DEBUG_ERR,(__location__ " Failed to merge "
+					 "commit records for db_id[0x%08x]\n",
+					 ctdb_db->db_id));
+			ctdb_persistent_reply_commits(state, -1,
+					"out of memory merging commits");
+			talloc_free(state);
+			return -1;
+		}
+	}
+
+	if (num_commits > 1) {
+		DEBUG(DEBUG_INFO,("Group commit of %u trans3 commits with %u "
+				  "records on db %s\n",
+				  num_commits, m->count, ctdb_db->db_name));
+	}
+
+	recdata = ctdb_marshall_finish(m);
+
+	ctdb_db->persistent_state = state;
+
 	for (i = 0; i < ctdb->vnn_map->size; i++) {
 		struct ctdb_node *node = ctdb->nodes[ctdb->vnn_map->map[i]];
 		int ret;
@@ -229,13 +353,16 @@ int32_t ctdb_control_trans3_commit(struct ctdb_context *ctdb,
 
 		ret = ctdb_daemon_send_control(ctdb, node->pnn, 0,
 					       CTDB_CONTROL_UPDATE_RECORD,
-					       c->client_id, 0, recdata,
+					       state->commits->c->client_id,
+					       0, recdata,
 					       ctdb_persistent_callback,
 					       state);
 		if (ret == -1) {
 			DEBUG(DEBUG_ERR,("Unable to send "
 					 "CTDB_CONTROL_UPDATE_RECORD "
 					 "to pnn %u\n", node->pnn));
+			ctdb_persistent_reply_commits(state, -1,
+					"failed to send update_record control");
 			talloc_free(state);
 			return -1;
 		}
@@ -245,16 +372,11 @@ int32_t ctdb_control_trans3_commit(struct ctdb_context *ctdb,
 	}
 
 	if (state->num_pending == 0) {
+		ctdb_persistent_reply_commits(state, 0, NULL);
 		talloc_free(state);
 		return 0;
 	}
 
-	/* we need to wait for the replies */
-	*async_reply = true;
-
-	/* need to keep the control structure around */
-	talloc_steal(state, c);
-
 	/* but we won't wait forever */
 	event_add_timed(ctdb->ev, state,
 			timeval_current_ofs(ctdb->tunable.control_timeout, 0),
@@ -263,6 +385,110 @@ int32_t ctdb_control_trans3_commit(struct ctdb_context *ctdb,
 	return 0;
 }
 
+/*
+  the PersistentCommitWindow gathering delay has passed, send out
+  whatever has accumulated
+ */
+static void ctdb_persistent_commit_window_handler(struct event_context *ev,
+						  struct timed_event *te,
+						  struct timeval t,
+						  void *private_data)
+{
+	struct ctdb_db_context *ctdb_db = talloc_get_type(private_data,
+						struct ctdb_db_context);
+
+	ctdb_db->commit_window_te = NULL;
+
+	ctdb_persistent_send_commit_round(ctdb_db);
+}
+
+/*
+ * Store a set of persistent records.
+ * This is used to roll out a transaction to all nodes.
+ */
+int32_t ctdb_control_trans3_commit(struct ctdb_context *ctdb,
+				   struct ctdb_req_control *c,
+				   TDB_DATA recdata, bool *async_reply)
+{
+	struct ctdb_client *client;
+	struct ctdb_persistent_commit *commit;
+	struct ctdb_marshall_buffer *m = (struct ctdb_marshall_buffer *)recdata.dptr;
+	struct ctdb_db_context *ctdb_db;
+
+	if (ctdb->recovery_mode != CTDB_RECOVERY_NORMAL) {
+		DEBUG(DEBUG_INFO,("rejecting ctdb_control_trans3_commit when recovery active\n"));
+		return -1;
+	}
+
+	client = ctdb_reqid_find(ctdb, c->client_id, struct ctdb_client);
+	if (client == NULL) {
+		DEBUG(DEBUG_ERR,(__location__ " can not match persistent_store "
+				 "to a client. Returning error\n"));
+		return -1;
+	}
+
+	if (client->db_id != 0) {
+		DEBUG(DEBUG_ERR,(__location__ " ERROR: trans3_commit: "
+				 "client-db_id[0x%08x] != 0 "
+				 "(client_id[0x%08x]): trans3_commit active?\n",
+				 client->db_id, client->client_id));
+		return -1;
+	}
+
+	ctdb_db = find_ctdb_db(ctdb, m->db_id);
+	if (ctdb_db == NULL) {
+		DEBUG(DEBUG_ERR,(__location__ " ctdb_control_trans3_commit: "
+				 "Unknown database db_id[0x%08x]\n", m->db_id));
+		return -1;
+	}
+
+	/* commits arriving while another commit round is in flight are
+	   queued and rolled out together in the next round, amortizing
+	   the cluster-wide commit cost over the whole burst */
+	commit = talloc_zero(ctdb_db, struct ctdb_persistent_commit);
+	CTDB_NO_MEMORY(ctdb, commit);
+
+	commit->client  = client;
+	commit->c       = c;
+	commit->recdata = recdata;
+
+	client->db_id = m->db_id;
+
+	DLIST_ADD_END(ctdb_db->pending_commits, commit, NULL);
+
+	/* we need to wait for the replies */
+	*async_reply = true;
+
+	/* need to keep the control structure around */
+	talloc_steal(commit, c);
+
+	if (ctdb_db->persistent_state != NULL) {
+		/* merged into the next round when the current one
+		   completes */
+		return 0;
+	}
+
+	if (ctdb->tunable.persistent_commit_window != 0) {
+		uint32_t msecs = ctdb->tunable.persistent_commit_window;
+
+		/* wait a short while for more commits to arrive */
+		if (ctdb_db->commit_window_te == NULL) {
+			ctdb_db->commit_window_te = event_add_timed(ctdb->ev,
+					ctdb_db,
+					timeval_current_ofs(msecs / 1000,
+						(msecs % 1000) * 1000),
+					ctdb_persistent_commit_window_handler,
+					ctdb_db);
+		}
+		if (ctdb_db->commit_window_te != NULL) {
+			return 0;
+		}
+		/* could not set up the timer, commit immediately */
+	}
+
+	return ctdb_persistent_send_commit_round(ctdb_db);
+}
+
 
 /*
   backwards compatibility:
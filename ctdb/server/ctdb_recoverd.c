@@ -712,29 +712,23 @@ static int create_missing_local_databases(struct ctdb_context *ctdb, struct ctdb
 /*
   pull the remote database contents from one node into the recdb
  */
-static int pull_one_remote_database(struct ctdb_context *ctdb, uint32_t srcnode,
-				    struct tdb_wrap *recdb, uint32_t dbid)
+/*
+  merge a marshalled database buffer, as returned by PULL_DB, into the
+  recdb. The merge is based on the rsn
+ */
+static int pull_merge_remote_database(struct ctdb_context *ctdb,
+				      uint32_t srcnode,
+				      struct tdb_wrap *recdb,
+				      TDB_DATA outdata)
 {
-	int ret;
-	TDB_DATA outdata;
 	struct ctdb_marshall_buffer *reply;
 	struct ctdb_rec_data *recdata;
 	int i;
-	TALLOC_CTX *tmp_ctx = talloc_new(recdb);
-
-	ret = ctdb_ctrl_pulldb(ctdb, srcnode, dbid, CTDB_LMASTER_ANY, tmp_ctx,
-			       CONTROL_TIMEOUT(), &outdata);
-	if (ret != 0) {
-		DEBUG(DEBUG_ERR,(__location__ " Unable to copy db from node %u\n", srcnode));
-		talloc_free(tmp_ctx);
-		return -1;
-	}
 
 	reply = (struct ctdb_marshall_buffer *)outdata.dptr;
 
 	if (outdata.dsize < offsetof(struct ctdb_marshall_buffer, data)) {
 		DEBUG(DEBUG_ERR,(__location__ " invalid data in pulldb reply\n"));
-		talloc_free(tmp_ctx);
 		return -1;
 	}
 
@@ -756,7 +750,6 @@ static int pull_one_remote_database(struct ctdb_context *ctdb, uint32_t srcnode,
 
 		if (data.dsize < sizeof(struct ctdb_ltdb_header)) {
 			DEBUG(DEBUG_CRIT,(__location__ " bad ltdb record\n"));
-			talloc_free(tmp_ctx);
 			return -1;
 		}
 
@@ -769,7 +762,6 @@ static int pull_one_remote_database(struct ctdb_context *ctdb, uint32_t srcnode,
 				DEBUG(DEBUG_CRIT,(__location__ " Bad record size %u from node %u\n",
 					 (unsigned)existing.dsize, srcnode));
 				free(existing.dptr);
-				talloc_free(tmp_ctx);
 				return -1;
 			}
 			header = *(struct ctdb_ltdb_header *)existing.dptr;
@@ -783,14 +775,33 @@ static int pull_one_remote_database(struct ctdb_context *ctdb, uint32_t srcnode,
 
 		if (tdb_store(recdb->tdb, key, data, TDB_REPLACE) != 0) {
 			DEBUG(DEBUG_CRIT,(__location__ " Failed to store record\n"));
-			talloc_free(tmp_ctx);
 			return -1;
 		}
 	}
 
+	return 0;
+}
+
+static int pull_one_remote_database(struct ctdb_context *ctdb, uint32_t srcnode,
+				    struct tdb_wrap *recdb, uint32_t dbid)
+{
+	int ret;
+	TDB_DATA outdata;
+	TALLOC_CTX *tmp_ctx = talloc_new(recdb);
+
+	ret = ctdb_ctrl_pulldb(ctdb, srcnode, dbid, CTDB_LMASTER_ANY, tmp_ctx,
+			       CONTROL_TIMEOUT(), &outdata);
+	if (ret != 0) {
+		DEBUG(DEBUG_ERR,(__location__ " Unable to copy db from node %u\n", srcnode));
+		talloc_free(tmp_ctx);
+		return -1;
+	}
+
+	ret = pull_merge_remote_database(ctdb, srcnode, recdb, outdata);
+
 	talloc_free(tmp_ctx);
 
-	return 0;
+	return ret;
 }
 
 
@@ -908,40 +919,133 @@ static int pull_highest_seqnum_pdb(struct ctdb_context *ctdb,
 
 
 /*
-  pull all the remote database contents into the recdb
+  state for an in-flight pull of one database from all nodes
  */
-static int pull_remote_database(struct ctdb_context *ctdb,
-				struct ctdb_recoverd *rec, 
-				struct ctdb_node_map *nodemap, 
-				struct tdb_wrap *recdb, uint32_t dbid,
-				bool persistent)
+struct pull_db_state {
+	struct ctdb_context *ctdb;
+	struct ctdb_recoverd *rec;
+	struct ctdb_node_map *nodemap;
+	struct tdb_wrap *recdb;
+	uint32_t dbid;
+	bool persistent;
+	/* one entry per nodemap slot, NULL for inactive nodes or when
+	   the database was already pulled by sequence number */
+	struct ctdb_client_control_state **node_states;
+};
+
+/*
+  start pulling the remote database contents from all nodes. Several
+  of these can be in flight at the same time; the transfers then all
+  proceed in parallel and are collected by pull_remote_database_recv
+ */
+static struct pull_db_state *pull_remote_database_send(struct ctdb_context *ctdb,
+						       struct ctdb_recoverd *rec,
+						       TALLOC_CTX *mem_ctx,
+						       struct ctdb_node_map *nodemap,
+						       struct tdb_wrap *recdb,
+						       uint32_t dbid,
+						       bool persistent)
 {
+	struct pull_db_state *state;
 	int j;
 
+	state = talloc_zero(mem_ctx, struct pull_db_state);
+	if (state == NULL) {
+		return NULL;
+	}
+	state->ctdb       = ctdb;
+	state->rec        = rec;
+	state->nodemap    = nodemap;
+	state->recdb      = recdb;
+	state->dbid       = dbid;
+	state->persistent = persistent;
+
 	if (persistent && ctdb->tunable.recover_pdb_by_seqnum != 0) {
 		int ret;
 		ret = pull_highest_seqnum_pdb(ctdb, rec, nodemap, recdb, dbid);
 		if (ret == 0) {
-			return 0;
+			/* already complete, nothing to collect */
+			return state;
 		}
 	}
 
-	/* pull all records from all other nodes across onto this node
-	   (this merges based on rsn)
-	*/
+	state->node_states = talloc_zero_array(state,
+					       struct ctdb_client_control_state *,
+					       nodemap->num);
+	if (state->node_states == NULL) {
+		talloc_free(state);
+		return NULL;
+	}
+
 	for (j=0; j<nodemap->num; j++) {
 		/* dont merge from nodes that are unavailable */
 		if (nodemap->nodes[j].flags & NODE_FLAGS_INACTIVE) {
 			continue;
 		}
-		if (pull_one_remote_database(ctdb, nodemap->nodes[j].pnn, recdb, dbid) != 0) {
-			DEBUG(DEBUG_ERR,(__location__ " Failed to pull remote database from node %u\n", 
+		state->node_states[j] = ctdb_ctrl_pulldb_send(
+			ctdb, nodemap->nodes[j].pnn, dbid, CTDB_LMASTER_ANY,
+			state->node_states, CONTROL_TIMEOUT());
+		if (state->node_states[j] == NULL) {
+			DEBUG(DEBUG_ERR,(__location__ " Failed to start pull of remote database from node %u\n",
 				 nodemap->nodes[j].pnn));
 			ctdb_set_culprit_count(rec, nodemap->nodes[j].pnn, nodemap->num);
+			talloc_free(state);
+			return NULL;
+		}
+	}
+
+	return state;
+}
+
+/*
+  collect the pulled database contents and merge them into the recdb
+  (this merges based on rsn). While we wait for one reply the event
+  loop keeps receiving the replies for all the other in-flight pulls
+ */
+static int pull_remote_database_recv(struct pull_db_state *state)
+{
+	struct ctdb_context *ctdb = state->ctdb;
+	struct ctdb_node_map *nodemap = state->nodemap;
+	int j;
+
+	if (state->node_states == NULL) {
+		/* pulled by sequence number in the send step */
+		return 0;
+	}
+
+	for (j=0; j<nodemap->num; j++) {
+		TDB_DATA outdata;
+		TALLOC_CTX *tmp_ctx;
+		int ret;
+
+		if (state->node_states[j] == NULL) {
+			continue;
+		}
+
+		tmp_ctx = talloc_new(state);
+		if (tmp_ctx == NULL) {
+			return -1;
+		}
+
+		ret = ctdb_ctrl_pulldb_recv(ctdb, tmp_ctx,
+					    state->node_states[j], &outdata);
+		state->node_states[j] = NULL;
+		if (ret != 0) {
+			DEBUG(DEBUG_ERR,(__location__ " Failed to pull remote database from node %u\n",
+				 nodemap->nodes[j].pnn));
+			ctdb_set_culprit_count(state->rec, nodemap->nodes[j].pnn, nodemap->num);
+			talloc_free(tmp_ctx);
+			return -1;
+		}
+
+		ret = pull_merge_remote_database(ctdb, nodemap->nodes[j].pnn,
+						 state->recdb, outdata);
+		talloc_free(tmp_ctx);
+		if (ret != 0) {
 			return -1;
 		}
 	}
-	
+
 	return 0;
 }
 
@@ -1476,32 +1580,57 @@ static int push_recdb_database(struct ctdb_context *ctdb, uint32_t dbid,
 
 
 /*
-  go through a full recovery on one database 
+  start a recovery of one database: create the recdb and kick off the
+  parallel pull of the remote contents
  */
-static int recover_database(struct ctdb_recoverd *rec, 
-			    TALLOC_CTX *mem_ctx,
-			    uint32_t dbid,
-			    bool persistent,
-			    uint32_t pnn, 
-			    struct ctdb_node_map *nodemap,
-			    uint32_t transaction_id)
+static struct pull_db_state *recover_database_send(struct ctdb_recoverd *rec,
+						   TALLOC_CTX *mem_ctx,
+						   uint32_t dbid,
+						   bool persistent,
+						   struct ctdb_node_map *nodemap)
 {
+	struct ctdb_context *ctdb = rec->ctdb;
 	struct tdb_wrap *recdb;
+	struct pull_db_state *state;
+
+	recdb = create_recdb(ctdb, mem_ctx);
+	if (recdb == NULL) {
+		return NULL;
+	}
+
+	state = pull_remote_database_send(ctdb, rec, mem_ctx, nodemap,
+					  recdb, dbid, persistent);
+	if (state == NULL) {
+		DEBUG(DEBUG_ERR, (__location__ " Unable to pull remote database 0x%x\n", dbid));
+		talloc_free(recdb);
+		return NULL;
+	}
+
+	return state;
+}
+
+/*
+  finish the recovery of one database: collect the pulled contents,
+  wipe the database on all nodes and push out the merged result
+ */
+static int recover_database_recv(struct ctdb_recoverd *rec,
+				 struct pull_db_state *state,
+				 struct ctdb_node_map *nodemap,
+				 uint32_t transaction_id)
+{
 	int ret;
 	struct ctdb_context *ctdb = rec->ctdb;
+	struct tdb_wrap *recdb = state->recdb;
+	uint32_t dbid = state->dbid;
 	TDB_DATA data;
 	struct ctdb_control_wipe_database w;
 	uint32_t *nodes;
+	struct timeval t_start = timeval_current();
 
-	recdb = create_recdb(ctdb, mem_ctx);
-	if (recdb == NULL) {
-		return -1;
-	}
-
-	/* pull all remote databases onto the recdb */
-	ret = pull_remote_database(ctdb, rec, nodemap, recdb, dbid, persistent);
+	ret = pull_remote_database_recv(state);
 	if (ret != 0) {
 		DEBUG(DEBUG_ERR, (__location__ " Unable to pull remote database 0x%x\n", dbid));
+		talloc_free(recdb);
 		return -1;
 	}
 
@@ -1524,17 +1653,21 @@ static int recover_database(struct ctdb_recoverd *rec,
 		talloc_free(recdb);
 		return -1;
 	}
-	
-	/* push out the correct database. This sets the dmaster and skips 
+
+	/* push out the correct database. This sets the dmaster and skips
 	   the empty records */
-	ret = push_recdb_database(ctdb, dbid, persistent, recdb, nodemap);
+	ret = push_recdb_database(ctdb, dbid, state->persistent, recdb, nodemap);
 	if (ret != 0) {
 		talloc_free(recdb);
 		return -1;
 	}
 
+	DEBUG(DEBUG_NOTICE, ("Recovery - database 0x%x wiped and pushed in %.1f seconds\n",
+			     dbid, timeval_elapsed(&t_start)));
+
 	/* all done with this database */
 	talloc_free(recdb);
+	talloc_free(state);
 
 	return 0;
 }
@@ -1984,15 +2117,54 @@ static int do_recovery(struct ctdb_recoverd *rec,
 
 	DEBUG(DEBUG_NOTICE,(__location__ " started transactions on all nodes\n"));
 
-	for (i=0;i<dbmap->num;i++) {
-		ret = recover_database(rec, mem_ctx,
-				       dbmap->dbs[i].dbid,
-				       dbmap->dbs[i].flags & CTDB_DB_FLAGS_PERSISTENT,
-				       pnn, nodemap, generation);
-		if (ret != 0) {
-			DEBUG(DEBUG_ERR, (__location__ " Failed to recover database 0x%x\n", dbmap->dbs[i].dbid));
+	/* recover the databases in waves of RecoverParallelDBs. The
+	   pulls for all databases of a wave are in flight at the same
+	   time, so the blackout is governed by the largest database in
+	   the wave, not the sum of all of them. The wave size bounds
+	   how many complete marshalled databases we hold in memory at
+	   once
+	*/
+	i = 0;
+	while (i < dbmap->num) {
+		uint32_t max_parallel = ctdb->tunable.recover_parallel_dbs;
+		uint32_t wave, k;
+		struct pull_db_state **pulls;
+
+		if (max_parallel < 1) {
+			max_parallel = 1;
+		}
+		wave = MIN(max_parallel, dbmap->num - i);
+
+		pulls = talloc_zero_array(mem_ctx, struct pull_db_state *,
+					  wave);
+		if (pulls == NULL) {
 			goto fail;
 		}
+
+		for (k=0; k<wave; k++) {
+			pulls[k] = recover_database_send(rec, pulls,
+				dbmap->dbs[i+k].dbid,
+				dbmap->dbs[i+k].flags & CTDB_DB_FLAGS_PERSISTENT,
+				nodemap);
+			if (pulls[k] == NULL) {
+				DEBUG(DEBUG_ERR, (__location__ " Failed to recover database 0x%x\n", dbmap->dbs[i+k].dbid));
+				talloc_free(pulls);
+				goto fail;
+			}
+		}
+
+		for (k=0; k<wave; k++) {
+			ret = recover_database_recv(rec, pulls[k], nodemap,
+						    generation);
+			if (ret != 0) {
+				DEBUG(DEBUG_ERR, (__location__ " Failed to recover database 0x%x\n", dbmap->dbs[i+k].dbid));
+				talloc_free(pulls);
+				goto fail;
+			}
+		}
+
+		talloc_free(pulls);
+		i += wave;
 	}
 
 	DEBUG(DEBUG_NOTICE, (__location__ " Recovery - starting database commits\n"));
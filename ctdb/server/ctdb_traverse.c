@@ -46,6 +46,8 @@ struct ctdb_traverse_local_handle {
 	struct tevent_fd *fde;
 	int records_failed;
 	int records_sent;
+	int records_acked;
+	bool flow_control;
 };
 
 /*
@@ -90,6 +92,29 @@ static int traverse_local_destructor(struct ctdb_traverse_local_handle *h)
 	return 0;
 }
 
+/*
+ * called in the traverse child when the destination node acknowledges
+ * a batch of records
+ */
+static void ctdb_traverse_ack_handler(struct ctdb_context *ctdb, uint64_t srvid,
+				      TDB_DATA data, void *private_data)
+{
+	struct ctdb_traverse_local_handle *h = talloc_get_type(private_data,
+							struct ctdb_traverse_local_handle);
+	uint32_t count;
+
+	if (data.dsize != sizeof(uint32_t)) {
+		DEBUG(DEBUG_ERR, (__location__ " Invalid traverse ack size %u\n",
+				  (unsigned)data.dsize));
+		return;
+	}
+
+	count = *(uint32_t *)data.dptr;
+	if ((int)count > h->records_acked) {
+		h->records_acked = count;
+	}
+}
+
 /*
   callback from tdb_traverse_read()
  */
@@ -136,6 +161,20 @@ static int ctdb_traverse_local_fn(struct tdb_context *tdb, TDB_DATA key, TDB_DAT
 	}
 
 	h->records_sent++;
+
+	/* Flow control: wait until the destination node has acknowledged
+	 * the records sent so far before reading further ahead in the
+	 * database, so that a slow consumer does not make the records
+	 * pile up in the daemons on the way.
+	 */
+	if (h->flow_control) {
+		int window = h->ctdb_db->ctdb->tunable.traverse_window_size;
+
+		while (h->records_sent - h->records_acked >= window) {
+			tevent_loop_once(h->ctdb_db->ctdb->ev);
+		}
+	}
+
 	return 0;
 }
 
@@ -210,6 +249,20 @@ static struct ctdb_traverse_local_handle *ctdb_traverse_local(struct ctdb_db_con
 			_exit(0);
 		}
 
+		if (ctdb->tunable.traverse_window_size > 0) {
+			ret = ctdb_client_set_message_handler(ctdb,
+					CTDB_SRVID_TRAVERSE_ACK_RANGE | h->reqid,
+					ctdb_traverse_ack_handler, h);
+			if (ret == 0) {
+				h->flow_control = true;
+			} else {
+				/* carry on without flow control */
+				DEBUG(DEBUG_ERR, ("Failed to register traverse "
+						  "ack handler for db %s\n",
+						  ctdb_db->db_name));
+			}
+		}
+
 		d = ctdb_marshall_record(h, h->reqid, tdb_null, NULL, tdb_null);
 		if (d == NULL) {
 			res = 0;
@@ -279,6 +332,11 @@ struct ctdb_traverse_all_handle {
 	void *private_data;
 	uint32_t null_count;
 	bool timedout;
+	/* flow control - per source node record counts */
+	uint32_t *recv_count;
+	uint32_t *ack_count;
+	struct ctdb_client *client;
+	struct timed_event *ack_te;
 };
 
 /*
@@ -324,6 +382,7 @@ static void ctdb_traverse_all_timeout(struct event_context *ev, struct timed_eve
 struct traverse_start_state {
 	struct ctdb_context *ctdb;
 	struct ctdb_traverse_all_handle *h;
+	struct ctdb_client *client;
 	uint32_t srcnode;
 	uint32_t reqid;
 	uint32_t db_id;
@@ -333,6 +392,74 @@ struct traverse_start_state {
 };
 
 
+static void ctdb_traverse_ack_timeout(struct event_context *ev,
+				      struct timed_event *te,
+				      struct timeval t, void *private_data);
+
+/*
+ * Acknowledge the records received so far to the traverse children on
+ * the source nodes, so that they read ahead only a bounded amount.
+ *
+ * While the client this traverse is destined for is not keeping up
+ * with the record stream, the acks are held back, which stalls the
+ * children once they have used up their window.
+ */
+static void ctdb_traverse_send_acks(struct ctdb_traverse_all_handle *state)
+{
+	struct ctdb_context *ctdb = state->ctdb;
+	uint32_t window = ctdb->tunable.traverse_window_size;
+	uint32_t i;
+
+	if (window == 0 || state->recv_count == NULL) {
+		return;
+	}
+
+	if (state->client != NULL &&
+	    ctdb_queue_length(state->client->queue) > (int)window) {
+		if (state->ack_te == NULL) {
+			state->ack_te = event_add_timed(ctdb->ev, state,
+					timeval_current_ofs(0, 100*1000),
+					ctdb_traverse_ack_timeout, state);
+		}
+		return;
+	}
+
+	for (i=0; i<ctdb->num_nodes; i++) {
+		TDB_DATA data;
+
+		if (state->recv_count[i] - state->ack_count[i] < window/2) {
+			continue;
+		}
+
+		data.dptr = (uint8_t *)&state->recv_count[i];
+		data.dsize = sizeof(uint32_t);
+
+		if (ctdb_daemon_send_message(ctdb, ctdb->nodes[i]->pnn,
+				CTDB_SRVID_TRAVERSE_ACK_RANGE | state->reqid,
+				data) != 0) {
+			DEBUG(DEBUG_ERR, (__location__ " Failed to send "
+					  "traverse ack to node %u\n", i));
+			continue;
+		}
+		state->ack_count[i] = state->recv_count[i];
+	}
+}
+
+/*
+ * retry the held back acks, hopefully the client has caught up
+ */
+static void ctdb_traverse_ack_timeout(struct event_context *ev,
+				      struct timed_event *te,
+				      struct timeval t, void *private_data)
+{
+	struct ctdb_traverse_all_handle *state = talloc_get_type(private_data,
+						struct ctdb_traverse_all_handle);
+
+	state->ack_te = NULL;
+	ctdb_traverse_send_acks(state);
+}
+
+
 /*
   setup a cluster-wide non-blocking traverse of a ctdb. The
   callback function will be called on every record in the local
@@ -365,9 +492,19 @@ static struct ctdb_traverse_all_handle *ctdb_daemon_traverse_all(struct ctdb_db_
 	state->private_data = start_state;
 	state->null_count   = 0;
 	state->timedout     = false;
-	
+	state->client       = start_state->client;
+	state->ack_te       = NULL;
+
 	talloc_set_destructor(state, ctdb_traverse_all_destructor);
 
+	/* per source node counters for the flow control acks */
+	state->recv_count = talloc_zero_array(state, uint32_t, ctdb->num_nodes);
+	state->ack_count  = talloc_zero_array(state, uint32_t, ctdb->num_nodes);
+	if (state->recv_count == NULL || state->ack_count == NULL) {
+		talloc_free(state);
+		return NULL;
+	}
+
 	if (start_state->withemptyrecords) {
 		r_ext.db_id = ctdb_db->db_id;
 		r_ext.reqid = state->reqid;
@@ -561,7 +698,7 @@ int32_t ctdb_control_traverse_all(struct ctdb_context *ctdb, TDB_DATA data, TDB_
   called when a CTDB_CONTROL_TRAVERSE_DATA control comes in. We then
   call the traverse_all callback with the record
  */
-int32_t ctdb_control_traverse_data(struct ctdb_context *ctdb, TDB_DATA data, TDB_DATA *outdata)
+int32_t ctdb_control_traverse_data(struct ctdb_context *ctdb, TDB_DATA data, TDB_DATA *outdata, uint32_t srcnode)
 {
 	struct ctdb_rec_data *d = (struct ctdb_rec_data *)data.dptr;
 	struct ctdb_traverse_all_handle *state;
@@ -595,14 +732,28 @@ int32_t ctdb_control_traverse_data(struct ctdb_context *ctdb, TDB_DATA data, TDB
 				return 0;
 			}
 		}
+
+		callback = state->callback;
+		private_data = state->private_data;
+
+		callback(private_data, key, data);
+		return 0;
+	}
+
+	if (state->recv_count != NULL && srcnode < ctdb->num_nodes) {
+		state->recv_count[srcnode]++;
 	}
 
 	callback = state->callback;
 	private_data = state->private_data;
 
 	callback(private_data, key, data);
+
+	/* let the source node read ahead again */
+	ctdb_traverse_send_acks(state);
+
 	return 0;
-}	
+}
 
 /*
   kill a in-progress traverse, used when a client disconnects
@@ -744,6 +895,7 @@ int32_t ctdb_control_traverse_start_ext(struct ctdb_context *ctdb,
 	state->srvid = d->srvid;
 	state->db_id = d->db_id;
 	state->ctdb = ctdb;
+	state->client = client;
 	state->withemptyrecords = d->withemptyrecords;
 	state->num_records = 0;
 
@@ -29,6 +29,7 @@ static const struct {
 	{ "SeqnumInterval",      1000,  offsetof(struct ctdb_tunable, seqnum_interval), false },
 	{ "ControlTimeout",      60, offsetof(struct ctdb_tunable, control_timeout), false },
 	{ "TraverseTimeout",     20, offsetof(struct ctdb_tunable, traverse_timeout), false },
+	{ "TraverseWindowSize", 1000, offsetof(struct ctdb_tunable, traverse_window_size), false },
 	{ "KeepaliveInterval",    5,  offsetof(struct ctdb_tunable, keepalive_interval), false },
 	{ "KeepaliveLimit",       5,  offsetof(struct ctdb_tunable, keepalive_limit), false },
 	{ "RecoverTimeout",     120,  offsetof(struct ctdb_tunable, recover_timeout), false },
@@ -69,9 +70,13 @@ static const struct {
 	{ "DeferredAttachTO",  120,  offsetof(struct ctdb_tunable, deferred_attach_timeout), false },
 	{ "AllowClientDBAttach", 1, offsetof(struct ctdb_tunable, allow_client_db_attach), false },
 	{ "RecoverPDBBySeqNum",  1, offsetof(struct ctdb_tunable, recover_pdb_by_seqnum), false },
+	{ "PersistentCommitWindow", 0, offsetof(struct ctdb_tunable, persistent_commit_window), false },
+	{ "RecoverParallelDBs",  4, offsetof(struct ctdb_tunable, recover_parallel_dbs), false },
 	{ "DeferredRebalanceOnNodeAdd", 300, offsetof(struct ctdb_tunable, deferred_rebalance_on_node_add) },
 	{ "FetchCollapse",       1, offsetof(struct ctdb_tunable, fetch_collapse) },
 	{ "HopcountMakeSticky",   50,  offsetof(struct ctdb_tunable, hopcount_make_sticky) },
+	{ "MigrationsMakeSticky", 10,  offsetof(struct ctdb_tunable, migrations_make_sticky) },
+	{ "HotKeysDecayInterval", 60,  offsetof(struct ctdb_tunable, hot_keys_decay_interval) },
 	{ "StickyDuration",      600,  offsetof(struct ctdb_tunable, sticky_duration) },
 	{ "StickyPindown",       200,  offsetof(struct ctdb_tunable, sticky_pindown) },
 	{ "NoIPTakeover",         0,  offsetof(struct ctdb_tunable, no_ip_takeover), false },
@@ -83,6 +88,7 @@ static const struct {
 	{ "Samba3AvoidDeadlocks", 0, offsetof(struct ctdb_tunable, samba3_hack), false },
 	{ "TDBMutexEnabled", 0, offsetof(struct ctdb_tunable, mutex_enabled), false },
 	{ "LockProcessesPerDB", 200, offsetof(struct ctdb_tunable, lock_processes_per_db), false },
+	{ "LockHelperPoolSize", 16, offsetof(struct ctdb_tunable, lock_helper_pool_size), false },
 };
 
 /*
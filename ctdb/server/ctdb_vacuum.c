@@ -42,12 +42,15 @@ struct ctdb_vacuum_child_context {
 	pid_t child_pid;
 	enum vacuum_child_status status;
 	struct timeval start_time;
+	bool full_vacuum_run;
 };
 
 struct ctdb_vacuum_handle {
 	struct ctdb_db_context *ctdb_db;
 	struct ctdb_vacuum_child_context *child_ctx;
 	uint32_t fast_path_count;
+	uint32_t generation;
+	bool full_scan_needed;
 };
 
 
@@ -1220,7 +1223,9 @@ fail:
  *  - Only if explicitly requested, the database is traversed
  *    in order to use the traditional heuristics on empty records
  *    to trigger deletion.
- *    This is done only every VacuumFastPathCount'th vacuuming run.
+ *    This is done at most every VacuumFastPathCount'th vacuuming
+ *    run, and only while a full scan is pending (after attach,
+ *    after a recovery or after an incomplete vacuuming run).
  *
  * The traverse runs fill two lists:
  *
@@ -1242,10 +1247,16 @@ fail:
  *   The lmaster then migrates all these records to itelf
  *   so that they can be vacuumed there.
  *
+ * On return, *leftovers tells the caller whether some scheduled
+ * records could not be processed in this run.  These records would be
+ * lost to the queue-driven fast path, so the caller uses this to
+ * request a database scan on a later run.
+ *
  * This executes in the child context.
  */
 static int ctdb_vacuum_db(struct ctdb_db_context *ctdb_db,
-			  bool full_vacuum_run)
+			  bool full_vacuum_run,
+			  bool *leftovers)
 {
 	struct ctdb_context *ctdb = ctdb_db->ctdb;
 	int ret, pnn;
@@ -1293,6 +1304,11 @@ static int ctdb_vacuum_db(struct ctdb_db_context *ctdb_db,
 
 	ctdb_process_delete_list(ctdb_db, vdata);
 
+	*leftovers = (vdata->traverse_error ||
+		      vdata->count.db_traverse.error > 0 ||
+		      vdata->count.delete_queue.error > 0 ||
+		      vdata->count.delete_list.left > 0);
+
 	talloc_free(tmp_ctx);
 
 	/* this ensures we run our event queue */
@@ -1306,14 +1322,15 @@ static int ctdb_vacuum_db(struct ctdb_db_context *ctdb_db,
  * called from the child context
  */
 static int ctdb_vacuum_and_repack_db(struct ctdb_db_context *ctdb_db,
-				     bool full_vacuum_run)
+				     bool full_vacuum_run,
+				     bool *leftovers)
 {
 	uint32_t repack_limit = ctdb_db->ctdb->tunable.repack_limit;
 	const char *name = ctdb_db->db_name;
 	int freelist_size = 0;
 	int ret;
 
-	if (ctdb_vacuum_db(ctdb_db, full_vacuum_run) != 0) {
+	if (ctdb_vacuum_db(ctdb_db, full_vacuum_run, leftovers) != 0) {
 		DEBUG(DEBUG_ERR,(__location__ " Failed to vacuum '%s'\n", name));
 	}
 
@@ -1366,6 +1383,14 @@ static int vacuum_child_destructor(struct ctdb_vacuum_child_context *child_ctx)
 		child_ctx->vacuum_handle->fast_path_count++;
 	}
 
+	if (child_ctx->status != VACUUM_OK) {
+		/* The run was aborted, so records scheduled for deletion
+		 * may have been lost from the delete queue.  Make the next
+		 * eligible run scan the database for them.
+		 */
+		child_ctx->vacuum_handle->full_scan_needed = true;
+	}
+
 	DLIST_REMOVE(ctdb->vacuumers, child_ctx);
 
 	event_add_timed(ctdb->ev, child_ctx->vacuum_handle,
@@ -1398,18 +1423,29 @@ static void vacuum_child_handler(struct event_context *ev, struct fd_event *fde,
 			     uint16_t flags, void *private_data)
 {
 	struct ctdb_vacuum_child_context *child_ctx = talloc_get_type(private_data, struct ctdb_vacuum_child_context);
-	char c = 0;
+	char res[2] = { 0, 1 };
 	int ret;
 
 	DEBUG(DEBUG_INFO,("Vacuuming child process %d finished for db %s\n", child_ctx->child_pid, child_ctx->vacuum_handle->ctdb_db->db_name));
 	child_ctx->child_pid = -1;
 
-	ret = sys_read(child_ctx->fd[0], &c, 1);
-	if (ret != 1 || c != 0) {
+	ret = sys_read(child_ctx->fd[0], res, 2);
+	if (ret != 2 || res[0] != 0) {
 		child_ctx->status = VACUUM_ERROR;
-		DEBUG(DEBUG_ERR, ("A vacuum child process failed with an error for database %s. ret=%d c=%d\n", child_ctx->vacuum_handle->ctdb_db->db_name, ret, c));
+		DEBUG(DEBUG_ERR, ("A vacuum child process failed with an error for database %s. ret=%d c=%d\n", child_ctx->vacuum_handle->ctdb_db->db_name, ret, res[0]));
 	} else {
 		child_ctx->status = VACUUM_OK;
+
+		if (res[1] != 0) {
+			/* Some scheduled records could not be processed */
+			child_ctx->vacuum_handle->full_scan_needed = true;
+		} else if (child_ctx->full_vacuum_run) {
+			/* A clean full scan - from now on the delete queue
+			 * alone drives vacuuming, until the next recovery
+			 * or aborted run.
+			 */
+			child_ctx->vacuum_handle->full_scan_needed = false;
+		}
 	}
 
 	talloc_free(child_ctx);
@@ -1475,6 +1511,24 @@ ctdb_vacuum_event(struct event_context *ev, struct timed_event *te,
 		vacuum_handle->fast_path_count = 0;
 	}
 
+	/* Every recovery can leave empty records behind that are no
+	 * longer in any delete queue, so it invalidates the steady state.
+	 */
+	if (ctdb->vnn_map != NULL &&
+	    vacuum_handle->generation != ctdb->vnn_map->generation) {
+		vacuum_handle->generation = ctdb->vnn_map->generation;
+		vacuum_handle->full_scan_needed = true;
+	}
+
+	/* In the steady state all deletable records are fed through the
+	 * delete queue as they are emptied, so the database is only
+	 * scanned while a full scan is pending.
+	 */
+	child_ctx->full_vacuum_run =
+		(ctdb->tunable.vacuum_fast_path_count > 0 &&
+		 vacuum_handle->fast_path_count == 0 &&
+		 vacuum_handle->full_scan_needed);
+
 	child_ctx->child_pid = ctdb_fork(ctdb);
 	if (child_ctx->child_pid == (pid_t)-1) {
 		close(child_ctx->fd[0]);
@@ -1489,8 +1543,8 @@ ctdb_vacuum_event(struct event_context *ev, struct timed_event *te,
 
 
 	if (child_ctx->child_pid == 0) {
-		char cc = 0;
-		bool full_vacuum_run = false;
+		char res[2] = { 0, 0 };
+		bool leftovers = false;
 		close(child_ctx->fd[0]);
 
 		DEBUG(DEBUG_INFO,("Vacuuming child process %d for db %s started\n", getpid(), ctdb_db->db_name));
@@ -1500,14 +1554,14 @@ ctdb_vacuum_event(struct event_context *ev, struct timed_event *te,
 			_exit(1);
 		}
 
-		if ((ctdb->tunable.vacuum_fast_path_count > 0) &&
-		    (vacuum_handle->fast_path_count == 0))
-		{
-			full_vacuum_run = true;
+		res[0] = ctdb_vacuum_and_repack_db(ctdb_db,
+						   child_ctx->full_vacuum_run,
+						   &leftovers);
+		if (leftovers) {
+			res[1] = 1;
 		}
-		cc = ctdb_vacuum_and_repack_db(ctdb_db, full_vacuum_run);
 
-		sys_write(child_ctx->fd[1], &cc, 1);
+		sys_write(child_ctx->fd[1], res, 2);
 		_exit(0);
 	}
 
@@ -1572,6 +1626,12 @@ int ctdb_vacuum_init(struct ctdb_db_context *ctdb_db)
 
 	ctdb_db->vacuum_handle->ctdb_db         = ctdb_db;
 	ctdb_db->vacuum_handle->fast_path_count = 0;
+	ctdb_db->vacuum_handle->generation      = 0;
+
+	/* The delete queue starts out empty, so scan the database once
+	 * to pick up records that were emptied before this node attached.
+	 */
+	ctdb_db->vacuum_handle->full_scan_needed = true;
 
 	event_add_timed(ctdb_db->ctdb->ev, ctdb_db->vacuum_handle, 
 			timeval_current_ofs(get_vacuum_interval(ctdb_db), 0), 
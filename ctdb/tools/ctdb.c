@@ -744,6 +744,10 @@ static int control_dbstatistics(struct ctdb_context *ctdb, int argc, const char
 		dbstat->db_ro_delegations);
 	printf(" %*s%-22s%*s%10u\n", 0, "", "ro_revokes", 4, "",
 		dbstat->db_ro_delegations);
+	printf(" %*s%-22s%*s%10u\n", 0, "", "migrations", 4, "",
+		dbstat->db_migrations);
+	printf(" %*s%-22s%*s%10u\n", 0, "", "sticky_promotions", 4, "",
+		dbstat->db_sticky_promotions);
 	printf(" %s\n", "locks");
 	printf(" %*s%-22s%*s%10u\n", 4, "", "total", 0, "",
 		dbstat->locks.num_calls);
@@ -796,6 +800,23 @@ static int control_dbstatistics(struct ctdb_context *ctdb, int argc, const char
 		}
 		printf("\n");
 	}
+	num_hot_keys = 0;
+	for (i=0; i<dbstat->num_migrated_keys; i++) {
+		if (dbstat->migrated_keys[i].count > 0) {
+			num_hot_keys++;
+		}
+	}
+	dbstat->num_migrated_keys = num_hot_keys;
+
+	printf(" Num Migrated Keys:%d\n", dbstat->num_migrated_keys);
+	for (i = 0; i < dbstat->num_migrated_keys; i++) {
+		int j;
+		printf("     Migrations:%d Key:", dbstat->migrated_keys[i].count);
+		for (j = 0; j < dbstat->migrated_keys[i].key.dsize; j++) {
+			printf("%02x", dbstat->migrated_keys[i].key.dptr[j]&0xff);
+		}
+		printf("\n");
+	}
 
 	talloc_free(tmp_ctx);
 	return 0;
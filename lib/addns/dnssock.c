@@ -29,6 +29,16 @@
 #include "system/select.h"
 #include "../lib/util/debug.h"
 
+/*
+ * Bound the time a dead or filtered name server can cost us. read_all()
+ * already gives up after 10 seconds; use the same limit for connect()
+ * instead of the kernel's SYN retry window, which can exceed two
+ * minutes per address. Callers iterate over all name servers of the
+ * zone, so without this the total registration time is the sum of
+ * those windows.
+ */
+#define DNS_CONNECT_TIMEOUT 10000 /* milliseconds */
+
 static int destroy_dns_connection(struct dns_connection *conn)
 {
 	return close(conn->s);
@@ -37,6 +47,69 @@ static int destroy_dns_connection(struct dns_connection *conn)
 /********************************************************************
 ********************************************************************/
 
+static int connect_with_timeout(int fd,
+				const struct sockaddr *addr,
+				socklen_t addrlen)
+{
+	int flags, ret, error;
+	socklen_t errlen = sizeof(error);
+	struct pollfd pfd;
+
+	flags = fcntl(fd, F_GETFL, 0);
+	if (flags == -1) {
+		return -1;
+	}
+	if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		return -1;
+	}
+
+	do {
+		ret = connect(fd, addr, addrlen);
+	} while ((ret == -1) && (errno == EINTR));
+
+	if ((ret == -1) && (errno == EINPROGRESS)) {
+		ZERO_STRUCT(pfd);
+		pfd.fd = fd;
+		pfd.events = POLLOUT;
+
+		do {
+			ret = poll(&pfd, 1, DNS_CONNECT_TIMEOUT);
+		} while ((ret == -1) && (errno == EINTR));
+
+		if (ret == 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		if (ret == -1) {
+			return -1;
+		}
+
+		if (getsockopt(fd, SOL_SOCKET, SO_ERROR,
+			       (void *)&error, &errlen) == -1) {
+			return -1;
+		}
+		if (error != 0) {
+			errno = error;
+			return -1;
+		}
+		ret = 0;
+	}
+
+	if (ret == -1) {
+		return -1;
+	}
+
+	/* the rest of this file expects a blocking socket */
+	if (fcntl(fd, F_SETFL, flags) == -1) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/********************************************************************
+********************************************************************/
+
 static DNS_ERROR dns_tcp_open( const char *nameserver,
 			       TALLOC_CTX *mem_ctx,
 			       struct dns_connection **result )
@@ -74,10 +147,9 @@ static DNS_ERROR dns_tcp_open( const char *nameserver,
 		if (conn->s == -1) {
 			continue;
 		}
-		do {
-			ret = connect(conn->s, rp->ai_addr, rp->ai_addrlen);
-		} while ((ret == -1) && (errno == EINTR));
-		if (ret != -1) {
+		ret = connect_with_timeout(conn->s, rp->ai_addr,
+					   rp->ai_addrlen);
+		if (ret == 0) {
 			/* Successful connect */
 			break;
 		}
@@ -57,14 +57,45 @@
 ))
 #endif
 
-ssize_t lzxpress_compress(const uint8_t *uncompressed,
-			  uint32_t uncompressed_size,
-			  uint8_t *compressed,
-			  uint32_t max_compressed_size)
+/*
+ * Match finder: instead of scanning the whole 8k window for every
+ * position, previous positions are kept in hash chains keyed by their
+ * first three bytes (the minimum match length). A chain is walked
+ * from the most recent position backwards, so the first longest match
+ * found is also the one with the smallest offset, exactly as with the
+ * full window scan. Walking a chain to its end (level 9) therefore
+ * produces bit identical output to the old exhaustive search; lower
+ * levels bound the walk and trade a little compression for speed.
+ */
+
+#define XPRESS_HASH_BITS 13
+#define XPRESS_HASH_SIZE (1 << XPRESS_HASH_BITS)
+#define XPRESS_HASH_EMPTY UINT32_MAX
+
+/* hash chain walk depth per effort level 1..9 */
+static const uint32_t xpress_match_depth[9] = {
+	4, 8, 16, 32, 64, 128, 512, 2048, UINT32_MAX
+};
+
+static uint32_t xpress_hash3(const uint8_t *data)
+{
+	uint32_t v;
+
+	v = ((uint32_t)data[0]) |
+	    (((uint32_t)data[1]) << 8) |
+	    (((uint32_t)data[2]) << 16);
+
+	return (v * 0x9E3779B1U) >> (32 - XPRESS_HASH_BITS);
+}
+
+ssize_t lzxpress_compress_level(const uint8_t *uncompressed,
+				uint32_t uncompressed_size,
+				uint8_t *compressed,
+				uint32_t max_compressed_size,
+				int level)
 {
 	uint32_t uncompressed_pos, compressed_pos, byte_left;
 	uint32_t max_offset, best_offset;
-	int32_t offset;
 	uint32_t max_len, len, best_len;
 	const uint8_t *str1, *str2;
 	uint32_t indic;
@@ -75,10 +106,28 @@ ssize_t lzxpress_compress(const uint8_t *uncompressed,
 	uint16_t metadata;
 	uint16_t *dest;
 
+	uint32_t *heads, *chain;
+	uint32_t hash_pos, max_depth;
+	uint32_t i;
+
 	if (!uncompressed_size) {
 		return 0;
 	}
 
+	level = MAX(1, MIN(level, 9));
+	max_depth = xpress_match_depth[level - 1];
+
+	heads = malloc((XPRESS_HASH_SIZE + uncompressed_size) *
+		       sizeof(uint32_t));
+	if (heads == NULL) {
+		return -1;
+	}
+	chain = heads + XPRESS_HASH_SIZE;
+
+	for (i = 0; i < XPRESS_HASH_SIZE; i++) {
+		heads[i] = XPRESS_HASH_EMPTY;
+	}
+
 	uncompressed_pos = 0;
 	indic = 0;
 	*(uint32_t *)compressed = 0;
@@ -88,39 +137,70 @@ ssize_t lzxpress_compress(const uint8_t *uncompressed,
 	byte_left = uncompressed_size;
 	indic_bit = 0;
 	nibble_index = 0;
-
-	if (uncompressed_pos > XPRESS_BLOCK_SIZE)
-		return 0;
+	hash_pos = 0;
 
 	do {
 		bool found = false;
 
-		max_offset = uncompressed_pos;
-
 		str1 = &uncompressed[uncompressed_pos];
 
 		best_len = 2;
 		best_offset = 0;
 
-		max_offset = MIN(0x1FFF, max_offset);
+		max_offset = MIN(0x1FFF, uncompressed_pos);
+
+		/* maximum len we can encode into metadata */
+		max_len = MIN((255 + 15 + 7 + 3), byte_left);
+
+		/*
+		 * Enter all positions since the last search into the
+		 * hash chains, including the interior of emitted
+		 * matches, so that later matches can start inside
+		 * earlier ones just like with a full window scan.
+		 */
+		for (; hash_pos < uncompressed_pos; hash_pos++) {
+			uint32_t h;
+
+			if (hash_pos + 3 > uncompressed_size) {
+				break;
+			}
+			h = xpress_hash3(&uncompressed[hash_pos]);
+			chain[hash_pos] = heads[h];
+			heads[h] = hash_pos;
+		}
 
 		/* search for the longest match in the window for the lookahead buffer */
-		for (offset = 1; (uint32_t)offset <= max_offset; offset++) {
-			str2 = &str1[-offset];
-
-			/* maximum len we can encode into metadata */
-			max_len = MIN((255 + 15 + 7 + 3), byte_left);
-
-			for (len = 0; (len < max_len) && (str1[len] == str2[len]); len++);
-
-			/*
-			 * We check if len is better than the value found before, including the
-			 * sequence of identical bytes
-			 */
-			if (len > best_len) {
-				found = true;
-				best_len = len;
-				best_offset = offset;
+		if ((max_offset > 0) &&
+		    (uncompressed_pos + 3 <= uncompressed_size)) {
+			uint32_t candidate;
+			uint32_t depth = max_depth;
+
+			candidate = heads[xpress_hash3(str1)];
+
+			while ((candidate != XPRESS_HASH_EMPTY) &&
+			       ((uncompressed_pos - candidate) <= max_offset)) {
+				str2 = &uncompressed[candidate];
+
+				for (len = 0; (len < max_len) && (str1[len] == str2[len]); len++);
+
+				/*
+				 * We check if len is better than the value found before, including the
+				 * sequence of identical bytes
+				 */
+				if (len > best_len) {
+					found = true;
+					best_len = len;
+					best_offset = uncompressed_pos - candidate;
+
+					if (best_len == max_len) {
+						break;
+					}
+				}
+
+				if (--depth == 0) {
+					break;
+				}
+				candidate = chain[candidate];
 			}
 		}
 
@@ -230,9 +310,23 @@ ssize_t lzxpress_compress(const uint8_t *uncompressed,
 		compressed_pos += sizeof(uint32_t);
 	}
 
+	free(heads);
+
 	return compressed_pos;
 }
 
+ssize_t lzxpress_compress(const uint8_t *uncompressed,
+			  uint32_t uncompressed_size,
+			  uint8_t *compressed,
+			  uint32_t max_compressed_size)
+{
+	return lzxpress_compress_level(uncompressed,
+				       uncompressed_size,
+				       compressed,
+				       max_compressed_size,
+				       9);
+}
+
 ssize_t lzxpress_decompress(const uint8_t *input,
 			    uint32_t input_size,
 			    uint8_t *output,
@@ -300,14 +394,34 @@ ssize_t lzxpress_decompress(const uint8_t *input,
 
 			length += 3;
 
-			do {
-				if ((output_index >= max_output_size) || ((offset + 1) > output_index)) break;
-
-				output[output_index] = output[output_index - offset - 1];
-
-				output_index += sizeof(uint8_t);
-				length -= sizeof(uint8_t);
-			} while (length != 0);
+			if ((output_index < max_output_size) &&
+			    ((offset + 1) <= output_index)) {
+				uint32_t copy_len =
+					MIN(length,
+					    max_output_size - output_index);
+				uint8_t *dst = &output[output_index];
+				const uint8_t *src = dst - offset - 1;
+
+				if ((offset + 1) >= copy_len) {
+					/*
+					 * Source and destination don't
+					 * overlap; memcpy compiles to
+					 * wide vector moves.
+					 */
+					memcpy(dst, src, copy_len);
+				} else {
+					/*
+					 * Self-referencing run, replicate
+					 * the pattern byte by byte.
+					 */
+					uint32_t j;
+
+					for (j = 0; j < copy_len; j++) {
+						dst[j] = src[j];
+					}
+				}
+				output_index += copy_len;
+			}
 		}
 	} while ((output_index < max_output_size) && (input_index < (input_size)));
 
@@ -42,6 +42,20 @@ ssize_t lzxpress_compress(const uint8_t *uncompressed,
 			  uint8_t *compressed,
 			  uint32_t max_compressed_size);
 
+/*
+ * As lzxpress_compress(), but with an explicit match finder effort
+ * level between 1 (fastest) and 9 (exhaustive). Level 9 is what
+ * lzxpress_compress() uses and produces the same output as the
+ * original full window scan; lower levels bound the hash chain walk
+ * and trade a little compression ratio for speed. All levels emit
+ * valid LZXpress data.
+ */
+ssize_t lzxpress_compress_level(const uint8_t *uncompressed,
+				uint32_t uncompressed_size,
+				uint8_t *compressed,
+				uint32_t max_compressed_size,
+				int level);
+
 ssize_t lzxpress_decompress(const uint8_t *input,
 			    uint32_t input_size,
 			    uint8_t *output,
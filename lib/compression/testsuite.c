@@ -64,12 +64,114 @@ static bool test_lzxpress(struct torture_context *test)
 	return true;
 }
 
+/*
+ * Round-trip throughput measurement over two synthetic corpora: a
+ * record-like text corpus that compresses well and a pseudo random
+ * one that does not. Compression runs at effort levels 1, 5 and 9
+ * (9 matches what lzxpress_compress() uses); each result is
+ * decompressed again and verified, so this doubles as a round-trip
+ * test for the hash chain match finder. Look at the printed rates
+ * for the actual benchmark numbers.
+ */
+static bool test_lzxpress_bench(struct torture_context *test)
+{
+	TALLOC_CTX *tmp_ctx = talloc_new(test);
+	const size_t block = XPRESS_BLOCK_SIZE;
+	const size_t total = 4 * 1024 * 1024;
+	const int levels[] = { 1, 5, 9 };
+	const char *names[] = { "text", "random" };
+	uint8_t *plain, *comp, *out;
+	uint32_t seed = 0x53414d42;
+	size_t ofs;
+	int corpus;
+	int l;
+
+	plain = talloc_array(tmp_ctx, uint8_t, total);
+	comp = talloc_array(tmp_ctx, uint8_t, 2 * block);
+	out = talloc_array(tmp_ctx, uint8_t, block);
+	torture_assert(test, plain && comp && out, "out of memory");
+
+	for (corpus = 0; corpus < 2; corpus++) {
+		if (corpus == 0) {
+			char record[64];
+			size_t record_len;
+
+			for (ofs = 0; ofs < total; ofs += record_len) {
+				record_len = snprintf(
+					record, sizeof(record),
+					"user%u: home=/home/user%u shell=%s; ",
+					(unsigned)(ofs % 997),
+					(unsigned)(ofs % 997),
+					(ofs % 5) ? "/bin/bash" : "/bin/false");
+				record_len = MIN(record_len, total - ofs);
+				memcpy(&plain[ofs], record, record_len);
+			}
+		} else {
+			for (ofs = 0; ofs < total; ofs++) {
+				seed = seed * 1103515245 + 12345;
+				plain[ofs] = (uint8_t)(seed >> 16);
+			}
+		}
+
+		for (l = 0; l < ARRAY_SIZE(levels); l++) {
+			struct timeval start;
+			double c_elapsed = 0.0;
+			double d_elapsed = 0.0;
+			size_t c_total = 0;
+
+			for (ofs = 0; ofs < total; ofs += block) {
+				size_t n = MIN(block, total - ofs);
+				ssize_t c_size;
+				ssize_t p_size;
+
+				start = timeval_current();
+				c_size = lzxpress_compress_level(
+					&plain[ofs], n,
+					comp, 2 * block,
+					levels[l]);
+				c_elapsed += timeval_elapsed(&start);
+
+				torture_assert(test, c_size >= 0,
+					       "lzxpress_compress_level");
+				c_total += c_size;
+
+				start = timeval_current();
+				p_size = lzxpress_decompress(
+					comp, c_size, out, n);
+				d_elapsed += timeval_elapsed(&start);
+
+				torture_assert_int_equal(
+					test, p_size, n,
+					"round trip size");
+				torture_assert_mem_equal(
+					test, out, &plain[ofs], n,
+					"round trip data");
+			}
+
+			torture_comment(test,
+				"%-6s level %d: ratio %.2f, "
+				"compress %6.1f MB/s, "
+				"decompress %6.1f MB/s\n",
+				names[corpus], levels[l],
+				(double)c_total / total,
+				(total / MAX(c_elapsed, 1e-9)) /
+					(1024 * 1024),
+				(total / MAX(d_elapsed, 1e-9)) /
+					(1024 * 1024));
+		}
+	}
+
+	talloc_free(tmp_ctx);
+	return true;
+}
 
 struct torture_suite *torture_local_compression(TALLOC_CTX *mem_ctx)
 {
 	struct torture_suite *suite = torture_suite_create(mem_ctx, "compression");
 
 	torture_suite_add_simple_test(suite, "lzxpress", test_lzxpress);
+	torture_suite_add_simple_test(suite, "lzxpress_bench",
+				      test_lzxpress_bench);
 
 	return suite;
 }
@@ -36,10 +36,18 @@
 
 #ifdef SAMBA_RIJNDAEL
 #include "rijndael-alg-fst.h"
+#ifdef HAVE_AESNI
+#include "aesni.h"
+#endif
 
 int
 AES_set_encrypt_key(const unsigned char *userkey, const int bits, AES_KEY *key)
 {
+#ifdef HAVE_AESNI
+    if (aesni_set_encrypt_key(userkey, bits, key) == 0)
+	return 0;
+#endif
+    key->use_aesni = 0;
     key->rounds = rijndaelKeySetupEnc(key->key, userkey, bits);
     if (key->rounds == 0)
 	return -1;
@@ -49,6 +57,11 @@ AES_set_encrypt_key(const unsigned char *userkey, const int bits, AES_KEY *key)
 int
 AES_set_decrypt_key(const unsigned char *userkey, const int bits, AES_KEY *key)
 {
+#ifdef HAVE_AESNI
+    if (aesni_set_decrypt_key(userkey, bits, key) == 0)
+	return 0;
+#endif
+    key->use_aesni = 0;
     key->rounds = rijndaelKeySetupDec(key->key, userkey, bits);
     if (key->rounds == 0)
 	return -1;
@@ -58,12 +71,24 @@ AES_set_decrypt_key(const unsigned char *userkey, const int bits, AES_KEY *key)
 void
 AES_encrypt(const unsigned char *in, unsigned char *out, const AES_KEY *key)
 {
+#ifdef HAVE_AESNI
+    if (key->use_aesni) {
+	aesni_encrypt(in, out, key);
+	return;
+    }
+#endif
     rijndaelEncrypt(key->key, key->rounds, in, out);
 }
 
 void
 AES_decrypt(const unsigned char *in, unsigned char *out, const AES_KEY *key)
 {
+#ifdef HAVE_AESNI
+    if (key->use_aesni) {
+	aesni_decrypt(in, out, key);
+	return;
+    }
+#endif
     rijndaelDecrypt(key->key, key->rounds, in, out);
 }
 #endif /* SAMBA_RIJNDAEL */
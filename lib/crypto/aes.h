@@ -62,6 +62,8 @@
 typedef struct aes_key {
     uint32_t key[(AES_MAXNR+1)*4];
     int rounds;
+    /* nonzero if key[] holds an AES-NI schedule, see aesni.c */
+    int use_aesni;
 } AES_KEY;
 
 #ifdef __cplusplus
@@ -20,6 +20,9 @@
 #include "replace.h"
 #include "../lib/crypto/crypto.h"
 #include "lib/util/byteorder.h"
+#ifdef HAVE_AESNI
+#include "../lib/crypto/aesni.h"
+#endif
 
 static inline void aes_gcm_128_inc32(uint8_t inout[AES_BLOCK_SIZE])
 {
@@ -67,6 +70,12 @@ static inline void aes_gcm_128_ghash_block(struct aes_gcm_128_context *ctx,
 					   const uint8_t in[AES_BLOCK_SIZE])
 {
 	aes_block_xor(ctx->Y, in, ctx->y.block);
+#ifdef HAVE_AESNI
+	if (ctx->pclmul) {
+		aesni_ghash_mul(ctx->y.block, ctx->H, ctx->Y);
+		return;
+	}
+#endif
 	aes_gcm_128_mul(ctx->y.block, ctx->H, ctx->v.block, ctx->Y);
 }
 
@@ -76,6 +85,10 @@ void aes_gcm_128_init(struct aes_gcm_128_context *ctx,
 {
 	ZERO_STRUCTP(ctx);
 
+#ifdef HAVE_AESNI
+	ctx->pclmul = aesni_pclmul_available();
+#endif
+
 	AES_set_encrypt_key(K, 128, &ctx->aes_key);
 
 	/*
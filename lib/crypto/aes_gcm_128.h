@@ -25,6 +25,9 @@
 struct aes_gcm_128_context {
 	AES_KEY aes_key;
 
+	/* true if the GHASH multiplications go via PCLMULQDQ */
+	bool pclmul;
+
 	uint64_t __align;
 
 	struct aes_gcm_128_tmp {
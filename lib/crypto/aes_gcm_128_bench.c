@@ -0,0 +1,83 @@
+/*
+   AES-GCM-128 throughput benchmark
+
+   Copyright (C) The Samba Team 2016
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "replace.h"
+#include "../lib/util/samba_util.h"
+#include "../lib/crypto/crypto.h"
+#ifdef HAVE_AESNI
+#include "../lib/crypto/aesni.h"
+#endif
+
+struct torture_context;
+bool torture_local_crypto_aes_gcm_128_bench(struct torture_context *tctx);
+
+/*
+ * Not a correctness test (that's aes_gcm_128_test.c), just a
+ * throughput measurement of the whole encrypt+GHASH path in 64k
+ * chunks, the way smb2_signing drives it. Always passes, look at the
+ * printed rate.
+ */
+bool torture_local_crypto_aes_gcm_128_bench(struct torture_context *tctx)
+{
+	const size_t chunk_size = 64 * 1024;
+	const size_t total = 16 * 1024 * 1024;
+	const uint8_t K[AES_BLOCK_SIZE] = {
+		0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+		0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+	};
+	const uint8_t N[AES_GCM_128_IV_SIZE] = {
+		0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad,
+		0xde, 0xca, 0xf8, 0x88,
+	};
+	uint8_t T[AES_BLOCK_SIZE];
+	struct aes_gcm_128_context ctx;
+	struct timeval start;
+	double elapsed;
+	uint8_t *buf;
+	size_t ofs;
+
+	buf = talloc_zero_array(tctx, uint8_t, chunk_size);
+	if (buf == NULL) {
+		return false;
+	}
+
+#ifdef HAVE_AESNI
+	printf("aes_gcm_128: aesni[%s] pclmul[%s]\n",
+	       aesni_available() ? "yes" : "no",
+	       aesni_pclmul_available() ? "yes" : "no");
+#else
+	printf("aes_gcm_128: built without AES-NI support\n");
+#endif
+
+	start = timeval_current();
+
+	aes_gcm_128_init(&ctx, K, N);
+	for (ofs = 0; ofs < total; ofs += chunk_size) {
+		aes_gcm_128_updateC(&ctx, buf, chunk_size);
+		aes_gcm_128_crypt(&ctx, buf, chunk_size);
+	}
+	aes_gcm_128_digest(&ctx, T);
+
+	elapsed = timeval_elapsed(&start);
+
+	printf("aes_gcm_128: %zu bytes in %.3f seconds, %.1f MBytes/sec\n",
+	       total, elapsed, (total / elapsed) / (1024 * 1024));
+
+	talloc_free(buf);
+	return true;
+}
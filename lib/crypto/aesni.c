@@ -0,0 +1,384 @@
+/*
+   AES-NI/PCLMULQDQ accelerated AES primitives
+
+   Copyright (C) The Samba Team 2016
+
+   The key expansion and GF(2^128) multiplication follow the code
+   samples in Intel's "AES New Instructions Set" and "Carry-Less
+   Multiplication and Its Usage for Computing the GCM Mode" white
+   papers.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replace.h"
+#include "aes.h"
+#include "aesni.h"
+
+#ifdef HAVE_AESNI
+
+#include <cpuid.h>
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+
+/*
+ * The functions below carry per-function target attributes, so this
+ * file can be compiled without -maes and linked into binaries that
+ * still run on CPUs without the instructions. Nothing here may be
+ * called unless the matching runtime check returned true.
+ */
+#define TARGET_AES __attribute__((target("aes,sse2")))
+#define TARGET_PCLMUL __attribute__((target("pclmul,ssse3")))
+
+#define AESNI_CPUID_ECX_PCLMUL	(1U << 1)
+#define AESNI_CPUID_ECX_SSSE3	(1U << 9)
+#define AESNI_CPUID_ECX_AES	(1U << 25)
+
+static uint32_t aesni_cpu_flags(void)
+{
+	/*
+	 * A racing initialization is harmless, all writers store the
+	 * same values.
+	 */
+	static bool initialized;
+	static uint32_t flags;
+
+	if (!initialized) {
+		unsigned int eax, ebx, ecx, edx;
+
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+			flags = ecx;
+		}
+		initialized = true;
+	}
+
+	return flags;
+}
+
+bool aesni_available(void)
+{
+	return (aesni_cpu_flags() & AESNI_CPUID_ECX_AES) != 0;
+}
+
+bool aesni_pclmul_available(void)
+{
+	const uint32_t need = AESNI_CPUID_ECX_PCLMUL | AESNI_CPUID_ECX_SSSE3;
+
+	return (aesni_cpu_flags() & need) == need;
+}
+
+/*
+ * The round keys are stored in AES_KEY.key as the raw byte sequence
+ * of the standard schedule, 16 bytes per round key. That layout is
+ * private to this backend, the table code keeps its own word order,
+ * which is why AES_KEY.use_aesni records who expanded the key.
+ */
+
+TARGET_AES
+static __m128i aesni_key128_assist(__m128i temp1, __m128i temp2)
+{
+	__m128i temp3;
+
+	temp2 = _mm_shuffle_epi32(temp2, 0xff);
+	temp3 = _mm_slli_si128(temp1, 0x4);
+	temp1 = _mm_xor_si128(temp1, temp3);
+	temp3 = _mm_slli_si128(temp3, 0x4);
+	temp1 = _mm_xor_si128(temp1, temp3);
+	temp3 = _mm_slli_si128(temp3, 0x4);
+	temp1 = _mm_xor_si128(temp1, temp3);
+	temp1 = _mm_xor_si128(temp1, temp2);
+
+	return temp1;
+}
+
+TARGET_AES
+static void aesni_expand_key128(const unsigned char *userkey, AES_KEY *key)
+{
+	uint8_t *out = (uint8_t *)key->key;
+	__m128i temp1, temp2;
+
+	temp1 = _mm_loadu_si128((const __m128i *)userkey);
+	_mm_storeu_si128((__m128i *)(out + 0*16), temp1);
+
+#define AESNI_EXPAND128_ROUND(idx, rcon) do { \
+	temp2 = _mm_aeskeygenassist_si128(temp1, rcon); \
+	temp1 = aesni_key128_assist(temp1, temp2); \
+	_mm_storeu_si128((__m128i *)(out + (idx)*16), temp1); \
+} while (0)
+
+	AESNI_EXPAND128_ROUND(1, 0x01);
+	AESNI_EXPAND128_ROUND(2, 0x02);
+	AESNI_EXPAND128_ROUND(3, 0x04);
+	AESNI_EXPAND128_ROUND(4, 0x08);
+	AESNI_EXPAND128_ROUND(5, 0x10);
+	AESNI_EXPAND128_ROUND(6, 0x20);
+	AESNI_EXPAND128_ROUND(7, 0x40);
+	AESNI_EXPAND128_ROUND(8, 0x80);
+	AESNI_EXPAND128_ROUND(9, 0x1b);
+	AESNI_EXPAND128_ROUND(10, 0x36);
+
+#undef AESNI_EXPAND128_ROUND
+
+	key->rounds = 10;
+}
+
+TARGET_AES
+static void aesni_key256_assist_1(__m128i *temp1, __m128i temp2)
+{
+	__m128i temp4;
+
+	temp2 = _mm_shuffle_epi32(temp2, 0xff);
+	temp4 = _mm_slli_si128(*temp1, 0x4);
+	*temp1 = _mm_xor_si128(*temp1, temp4);
+	temp4 = _mm_slli_si128(temp4, 0x4);
+	*temp1 = _mm_xor_si128(*temp1, temp4);
+	temp4 = _mm_slli_si128(temp4, 0x4);
+	*temp1 = _mm_xor_si128(*temp1, temp4);
+	*temp1 = _mm_xor_si128(*temp1, temp2);
+}
+
+TARGET_AES
+static void aesni_key256_assist_2(__m128i temp1, __m128i *temp3)
+{
+	__m128i temp2, temp4;
+
+	temp4 = _mm_aeskeygenassist_si128(temp1, 0x0);
+	temp2 = _mm_shuffle_epi32(temp4, 0xaa);
+	temp4 = _mm_slli_si128(*temp3, 0x4);
+	*temp3 = _mm_xor_si128(*temp3, temp4);
+	temp4 = _mm_slli_si128(temp4, 0x4);
+	*temp3 = _mm_xor_si128(*temp3, temp4);
+	temp4 = _mm_slli_si128(temp4, 0x4);
+	*temp3 = _mm_xor_si128(*temp3, temp4);
+	*temp3 = _mm_xor_si128(*temp3, temp2);
+}
+
+TARGET_AES
+static void aesni_expand_key256(const unsigned char *userkey, AES_KEY *key)
+{
+	uint8_t *out = (uint8_t *)key->key;
+	__m128i temp1, temp2, temp3;
+
+	temp1 = _mm_loadu_si128((const __m128i *)userkey);
+	temp3 = _mm_loadu_si128((const __m128i *)(userkey + 16));
+	_mm_storeu_si128((__m128i *)(out + 0*16), temp1);
+	_mm_storeu_si128((__m128i *)(out + 1*16), temp3);
+
+#define AESNI_EXPAND256_ROUND(idx, rcon) do { \
+	temp2 = _mm_aeskeygenassist_si128(temp3, rcon); \
+	aesni_key256_assist_1(&temp1, temp2); \
+	_mm_storeu_si128((__m128i *)(out + (idx)*16), temp1); \
+	aesni_key256_assist_2(temp1, &temp3); \
+	_mm_storeu_si128((__m128i *)(out + ((idx)+1)*16), temp3); \
+} while (0)
+
+	AESNI_EXPAND256_ROUND(2, 0x01);
+	AESNI_EXPAND256_ROUND(4, 0x02);
+	AESNI_EXPAND256_ROUND(6, 0x04);
+	AESNI_EXPAND256_ROUND(8, 0x08);
+	AESNI_EXPAND256_ROUND(10, 0x10);
+	AESNI_EXPAND256_ROUND(12, 0x20);
+
+#undef AESNI_EXPAND256_ROUND
+
+	temp2 = _mm_aeskeygenassist_si128(temp3, 0x40);
+	aesni_key256_assist_1(&temp1, temp2);
+	_mm_storeu_si128((__m128i *)(out + 14*16), temp1);
+
+	key->rounds = 14;
+}
+
+TARGET_AES
+static void aesni_invert_key(const AES_KEY *ek, AES_KEY *dk)
+{
+	const uint8_t *in = (const uint8_t *)ek->key;
+	uint8_t *out = (uint8_t *)dk->key;
+	int i;
+
+	_mm_storeu_si128((__m128i *)(out + 0*16),
+		_mm_loadu_si128((const __m128i *)(in + ek->rounds*16)));
+
+	for (i = 1; i < ek->rounds; i++) {
+		_mm_storeu_si128((__m128i *)(out + i*16),
+			_mm_aesimc_si128(_mm_loadu_si128(
+				(const __m128i *)(in + (ek->rounds - i)*16))));
+	}
+
+	_mm_storeu_si128((__m128i *)(out + ek->rounds*16),
+		_mm_loadu_si128((const __m128i *)(in + 0*16)));
+}
+
+int aesni_set_encrypt_key(const unsigned char *userkey, const int bits,
+			  AES_KEY *key)
+{
+	if (!aesni_available()) {
+		return -1;
+	}
+
+	switch (bits) {
+	case 128:
+		aesni_expand_key128(userkey, key);
+		break;
+	case 256:
+		aesni_expand_key256(userkey, key);
+		break;
+	default:
+		/*
+		 * Nothing in the tree uses 192-bit keys, the odd
+		 * schedule is not worth the trouble. The caller falls
+		 * back to the table code.
+		 */
+		return -1;
+	}
+
+	key->use_aesni = 1;
+	return 0;
+}
+
+int aesni_set_decrypt_key(const unsigned char *userkey, const int bits,
+			  AES_KEY *key)
+{
+	AES_KEY ek;
+
+	if (aesni_set_encrypt_key(userkey, bits, &ek) != 0) {
+		return -1;
+	}
+
+	aesni_invert_key(&ek, key);
+
+	key->rounds = ek.rounds;
+	key->use_aesni = 1;
+
+	ZERO_STRUCT(ek);
+	return 0;
+}
+
+TARGET_AES
+void aesni_encrypt(const unsigned char *in, unsigned char *out,
+		   const AES_KEY *key)
+{
+	const uint8_t *rk = (const uint8_t *)key->key;
+	__m128i block;
+	int i;
+
+	block = _mm_loadu_si128((const __m128i *)in);
+	block = _mm_xor_si128(block,
+		_mm_loadu_si128((const __m128i *)(rk + 0*16)));
+
+	for (i = 1; i < key->rounds; i++) {
+		block = _mm_aesenc_si128(block,
+			_mm_loadu_si128((const __m128i *)(rk + i*16)));
+	}
+
+	block = _mm_aesenclast_si128(block,
+		_mm_loadu_si128((const __m128i *)(rk + key->rounds*16)));
+	_mm_storeu_si128((__m128i *)out, block);
+}
+
+TARGET_AES
+void aesni_decrypt(const unsigned char *in, unsigned char *out,
+		   const AES_KEY *key)
+{
+	const uint8_t *rk = (const uint8_t *)key->key;
+	__m128i block;
+	int i;
+
+	block = _mm_loadu_si128((const __m128i *)in);
+	block = _mm_xor_si128(block,
+		_mm_loadu_si128((const __m128i *)(rk + 0*16)));
+
+	for (i = 1; i < key->rounds; i++) {
+		block = _mm_aesdec_si128(block,
+			_mm_loadu_si128((const __m128i *)(rk + i*16)));
+	}
+
+	block = _mm_aesdeclast_si128(block,
+		_mm_loadu_si128((const __m128i *)(rk + key->rounds*16)));
+	_mm_storeu_si128((__m128i *)out, block);
+}
+
+/*
+ * Carry-less 128x128 bit multiplication followed by the reduction
+ * modulo x^128 + x^7 + x^2 + x + 1. Inputs and output are in the
+ * bit-reflected representation the caller prepares via byte swap.
+ */
+TARGET_PCLMUL
+static __m128i aesni_gf128_mul(__m128i a, __m128i b)
+{
+	__m128i tmp2, tmp3, tmp4, tmp5, tmp6, tmp7, tmp8, tmp9;
+
+	tmp3 = _mm_clmulepi64_si128(a, b, 0x00);
+	tmp4 = _mm_clmulepi64_si128(a, b, 0x10);
+	tmp5 = _mm_clmulepi64_si128(a, b, 0x01);
+	tmp6 = _mm_clmulepi64_si128(a, b, 0x11);
+
+	tmp4 = _mm_xor_si128(tmp4, tmp5);
+	tmp5 = _mm_slli_si128(tmp4, 8);
+	tmp4 = _mm_srli_si128(tmp4, 8);
+	tmp3 = _mm_xor_si128(tmp3, tmp5);
+	tmp6 = _mm_xor_si128(tmp6, tmp4);
+
+	tmp7 = _mm_srli_epi32(tmp3, 31);
+	tmp8 = _mm_srli_epi32(tmp6, 31);
+	tmp3 = _mm_slli_epi32(tmp3, 1);
+	tmp6 = _mm_slli_epi32(tmp6, 1);
+
+	tmp9 = _mm_srli_si128(tmp7, 12);
+	tmp8 = _mm_slli_si128(tmp8, 4);
+	tmp7 = _mm_slli_si128(tmp7, 4);
+	tmp3 = _mm_or_si128(tmp3, tmp7);
+	tmp6 = _mm_or_si128(tmp6, tmp8);
+	tmp6 = _mm_or_si128(tmp6, tmp9);
+
+	tmp7 = _mm_slli_epi32(tmp3, 31);
+	tmp8 = _mm_slli_epi32(tmp3, 30);
+	tmp9 = _mm_slli_epi32(tmp3, 25);
+
+	tmp7 = _mm_xor_si128(tmp7, tmp8);
+	tmp7 = _mm_xor_si128(tmp7, tmp9);
+	tmp8 = _mm_srli_si128(tmp7, 4);
+	tmp7 = _mm_slli_si128(tmp7, 12);
+	tmp3 = _mm_xor_si128(tmp3, tmp7);
+
+	tmp2 = _mm_srli_epi32(tmp3, 1);
+	tmp4 = _mm_srli_epi32(tmp3, 2);
+	tmp5 = _mm_srli_epi32(tmp3, 7);
+	tmp2 = _mm_xor_si128(tmp2, tmp4);
+	tmp2 = _mm_xor_si128(tmp2, tmp5);
+	tmp2 = _mm_xor_si128(tmp2, tmp8);
+	tmp3 = _mm_xor_si128(tmp3, tmp2);
+	tmp6 = _mm_xor_si128(tmp6, tmp3);
+
+	return tmp6;
+}
+
+TARGET_PCLMUL
+void aesni_ghash_mul(const uint8_t x[AES_BLOCK_SIZE],
+		     const uint8_t h[AES_BLOCK_SIZE],
+		     uint8_t z[AES_BLOCK_SIZE])
+{
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+					   8, 9, 10, 11, 12, 13, 14, 15);
+	__m128i a, b;
+
+	a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)x), bswap);
+	b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)h), bswap);
+
+	a = aesni_gf128_mul(a, b);
+
+	a = _mm_shuffle_epi8(a, bswap);
+	_mm_storeu_si128((__m128i *)z, a);
+}
+
+#endif /* HAVE_AESNI */
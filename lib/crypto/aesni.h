@@ -0,0 +1,59 @@
+/*
+   AES-NI/PCLMULQDQ accelerated AES primitives
+
+   Copyright (C) The Samba Team 2016
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIB_CRYPTO_AESNI_H
+#define LIB_CRYPTO_AESNI_H 1
+
+#ifdef HAVE_AESNI
+
+/*
+ * Hardware accelerated backends for the AES_* and aes_gcm_128_*
+ * primitives. Everything in here is selected twice: at build time via
+ * the HAVE_AESNI configure probe (intrinsics plus per-function target
+ * attributes, so the rest of the tree compiles without -maes), and at
+ * runtime via CPUID, falling back to the portable table code on CPUs
+ * without the instructions. Further backends (e.g. ARMv8 crypto
+ * extensions) can hook in the same way behind their own configure
+ * probe and runtime check.
+ */
+
+bool aesni_available(void);
+bool aesni_pclmul_available(void);
+
+int aesni_set_encrypt_key(const unsigned char *userkey, const int bits,
+			  AES_KEY *key);
+int aesni_set_decrypt_key(const unsigned char *userkey, const int bits,
+			  AES_KEY *key);
+
+void aesni_encrypt(const unsigned char *in, unsigned char *out,
+		   const AES_KEY *key);
+void aesni_decrypt(const unsigned char *in, unsigned char *out,
+		   const AES_KEY *key);
+
+/*
+ * z = (x * h) in GF(2^128) with the GCM bit ordering, using
+ * PCLMULQDQ. Only valid if aesni_pclmul_available() returned true.
+ */
+void aesni_ghash_mul(const uint8_t x[AES_BLOCK_SIZE],
+		     const uint8_t h[AES_BLOCK_SIZE],
+		     uint8_t z[AES_BLOCK_SIZE]);
+
+#endif /* HAVE_AESNI */
+
+#endif /* LIB_CRYPTO_AESNI_H */
@@ -89,14 +89,80 @@ static const uint32_t crc32_tab[] = {
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+/*
+ * Slice-by-8: process eight input bytes per step with eight derived
+ * tables instead of one byte per step. crc32_tab8[0] is the classic
+ * table above; entry k is entry k-1 advanced by one zero byte, so a
+ * single table pass covers eight bytes at once. The result is bit
+ * identical to the byte loop for any input.
+ *
+ * The SSE4.2 crc32 instruction is no use here: it implements the
+ * Castagnoli polynomial 0x82F63B78, not our 0xEDB88320, and would
+ * change the output of every existing checksum.
+ *
+ * The derived tables are built on first use. As with the other lazy
+ * one-time setups in this directory the race on the init flag is
+ * benign: concurrent callers compute the same values.
+ */
+static uint32_t crc32_tab8[8][256];
+static bool crc32_tab8_initialized;
+
+static void crc32_tab8_init(void)
+{
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		crc32_tab8[0][i] = crc32_tab[i];
+	}
+	for (k = 1; k < 8; k++) {
+		for (i = 0; i < 256; i++) {
+			uint32_t c = crc32_tab8[k-1][i];
+			crc32_tab8[k][i] = crc32_tab[c & 0xFF] ^ (c >> 8);
+		}
+	}
+
+	crc32_tab8_initialized = true;
+}
+
 uint32_t crc32_calc_buffer(const uint8_t *buf, size_t size)
 {
 	const uint8_t *p;
 	uint32_t crc;
 
+	if (!crc32_tab8_initialized) {
+		crc32_tab8_init();
+	}
+
 	p = buf;
 	crc = ~0U;
 
+	while (size >= 8) {
+		uint32_t lo, hi;
+
+		/* explicit little endian loads, host endian neutral */
+		lo = ((uint32_t)p[0]) |
+		     (((uint32_t)p[1]) << 8) |
+		     (((uint32_t)p[2]) << 16) |
+		     (((uint32_t)p[3]) << 24);
+		hi = ((uint32_t)p[4]) |
+		     (((uint32_t)p[5]) << 8) |
+		     (((uint32_t)p[6]) << 16) |
+		     (((uint32_t)p[7]) << 24);
+		lo ^= crc;
+
+		crc = crc32_tab8[7][lo & 0xFF] ^
+		      crc32_tab8[6][(lo >> 8) & 0xFF] ^
+		      crc32_tab8[5][(lo >> 16) & 0xFF] ^
+		      crc32_tab8[4][lo >> 24] ^
+		      crc32_tab8[3][hi & 0xFF] ^
+		      crc32_tab8[2][(hi >> 8) & 0xFF] ^
+		      crc32_tab8[1][(hi >> 16) & 0xFF] ^
+		      crc32_tab8[0][hi >> 24];
+
+		p += 8;
+		size -= 8;
+	}
+
 	while (size--)
 		crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
 
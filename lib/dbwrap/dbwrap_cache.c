@@ -17,6 +17,22 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+/*
+ * This layer caches reads only. Writes go straight to the backing db
+ * via the fetch_locked passthrough, and the seqnum check in
+ * dbwrap_cache_validate() then drops the whole cache.
+ *
+ * A write-behind mode (coalescing repeated stores to the same key and
+ * flushing on a timer) has been considered and rejected: the only
+ * coherency signal we have is the backing db's global seqnum, so other
+ * processes have no way to see a pending write or to know that their
+ * cache is stale short of us flushing. Every current consumer of the
+ * dbwrap API relies on a completed store being immediately visible
+ * process-wide (share modes, session and tcon state). If a db ever
+ * justifies delayed durability, that has to be a property of the
+ * backing store, not silently bolted on here.
+ */
+
 #include "replace.h"
 #include "lib/param/loadparm.h"
 #include "lib/dbwrap/dbwrap_cache.h"
@@ -31,6 +31,16 @@ struct db_rbt_ctx {
 	struct db_rbt_node *nodes;
 	size_t traverse_read;
 	struct db_rbt_node **traverse_nextp;
+	/*
+	 * Optional talloc pool the record nodes are allocated
+	 * from. Carving nodes out of one large chunk avoids the
+	 * per-record malloc overhead and keeps tree walks on few
+	 * pages. Allocations beyond the pool size transparently fall
+	 * back to the heap, everything goes away in one piece with
+	 * the db.
+	 */
+	TALLOC_CTX *node_pool;
+	size_t pool_size;
 };
 
 struct db_rbt_rec {
@@ -163,7 +173,10 @@ static NTSTATUS db_rbt_store(struct db_record *rec, TDB_DATA data, int flag)
 		return NT_STATUS_INSUFFICIENT_RESOURCES;
 	}
 
-	node = talloc_zero_size(db_ctx, reclen);
+	node = talloc_zero_size(
+		(db_ctx->node_pool != NULL) ? db_ctx->node_pool
+					    : (TALLOC_CTX *)db_ctx,
+		reclen);
 	if (node == NULL) {
 		return NT_STATUS_NO_MEMORY;
 	}
@@ -374,11 +387,29 @@ static int db_rbt_exists(struct db_context *db, TDB_DATA key)
 	return db_rbt_search_internal(db, key, NULL);
 }
 
+static struct db_rbt_ctx *db_rbt_ctx_init(TALLOC_CTX *mem_ctx,
+					  size_t pool_size)
+{
+	struct db_rbt_ctx *ctx = talloc_zero(mem_ctx, struct db_rbt_ctx);
+	if (ctx == NULL) {
+		return NULL;
+	}
+	ctx->pool_size = pool_size;
+	if (pool_size != 0) {
+		ctx->node_pool = talloc_pool(ctx, pool_size);
+		if (ctx->node_pool == NULL) {
+			TALLOC_FREE(ctx);
+			return NULL;
+		}
+	}
+	return ctx;
+}
+
 static int db_rbt_wipe(struct db_context *db)
 {
 	struct db_rbt_ctx *old_ctx = talloc_get_type_abort(
 		db->private_data, struct db_rbt_ctx);
-	struct db_rbt_ctx *new_ctx = talloc_zero(db, struct db_rbt_ctx);
+	struct db_rbt_ctx *new_ctx = db_rbt_ctx_init(db, old_ctx->pool_size);
 	if (new_ctx == NULL) {
 		return -1;
 	}
@@ -520,7 +551,7 @@ static void db_rbt_id(struct db_context *db, const uint8_t **id, size_t *idlen)
 	*idlen = sizeof(struct db_context *);
 }
 
-struct db_context *db_open_rbt(TALLOC_CTX *mem_ctx)
+struct db_context *db_open_rbt_pool(TALLOC_CTX *mem_ctx, size_t pool_size)
 {
 	struct db_context *result;
 
@@ -530,7 +561,7 @@ struct db_context *db_open_rbt(TALLOC_CTX *mem_ctx)
 		return NULL;
 	}
 
-	result->private_data = talloc_zero(result, struct db_rbt_ctx);
+	result->private_data = db_rbt_ctx_init(result, pool_size);
 
 	if (result->private_data == NULL) {
 		TALLOC_FREE(result);
@@ -552,3 +583,8 @@ struct db_context *db_open_rbt(TALLOC_CTX *mem_ctx)
 
 	return result;
 }
+
+struct db_context *db_open_rbt(TALLOC_CTX *mem_ctx)
+{
+	return db_open_rbt_pool(mem_ctx, 0);
+}
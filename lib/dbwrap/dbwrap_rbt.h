@@ -26,4 +26,11 @@ struct db_context;
 
 struct db_context *db_open_rbt(TALLOC_CTX *mem_ctx);
 
+/*
+ * Variant allocating record nodes from a talloc pool of "pool_size"
+ * bytes, for dbs expected to hold many records. Allocations beyond
+ * the pool fall back to the heap.
+ */
+struct db_context *db_open_rbt_pool(TALLOC_CTX *mem_ctx, size_t pool_size);
+
 #endif /* __DBWRAP_RBT_H__ */
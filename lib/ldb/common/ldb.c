@@ -1595,6 +1595,238 @@ done:
 	return ret;
 }
 
+/*
+  a prepared search statement: the parsed filter plus the value slots
+  in it that correspond to "$n" placeholders, so repeated executions
+  skip the filter parser completely
+*/
+struct ldb_search_stmt {
+	struct ldb_context *ldb;
+	struct ldb_dn *base;
+	enum ldb_scope scope;
+	const char **attrs;
+	struct ldb_parse_tree *tree;
+	unsigned int num_params;
+	struct ldb_val **params;
+};
+
+/*
+  return the parameter number of a placeholder value of the form
+  "$<digits>", or 0 if the value is not a placeholder
+*/
+static unsigned int ldb_stmt_param_num(const struct ldb_val *v)
+{
+	unsigned int num = 0;
+	size_t i;
+
+	if (v->length < 2 || v->data[0] != '$') {
+		return 0;
+	}
+	for (i = 1; i < v->length; i++) {
+		if (!isdigit(v->data[i])) {
+			return 0;
+		}
+		num = num * 10 + (v->data[i] - '0');
+	}
+	return num;
+}
+
+/*
+  walk the parse tree recording a pointer to the value slot of every
+  placeholder, indexed by its parameter number
+*/
+static int ldb_stmt_find_params(struct ldb_search_stmt *stmt,
+				struct ldb_parse_tree *tree)
+{
+	struct ldb_val *slot = NULL;
+	unsigned int num, i;
+	int ret;
+
+	switch (tree->operation) {
+	case LDB_OP_AND:
+	case LDB_OP_OR:
+		for (i = 0; i < tree->u.list.num_elements; i++) {
+			ret = ldb_stmt_find_params(stmt,
+						   tree->u.list.elements[i]);
+			if (ret != LDB_SUCCESS) {
+				return ret;
+			}
+		}
+		return LDB_SUCCESS;
+	case LDB_OP_NOT:
+		return ldb_stmt_find_params(stmt, tree->u.isnot.child);
+	case LDB_OP_EQUALITY:
+		slot = &tree->u.equality.value;
+		break;
+	case LDB_OP_GREATER:
+	case LDB_OP_LESS:
+	case LDB_OP_APPROX:
+		slot = &tree->u.comparison.value;
+		break;
+	case LDB_OP_EXTENDED:
+		slot = &tree->u.extended.value;
+		break;
+	case LDB_OP_SUBSTRING:
+	case LDB_OP_PRESENT:
+		return LDB_SUCCESS;
+	}
+
+	num = ldb_stmt_param_num(slot);
+	if (num == 0) {
+		return LDB_SUCCESS;
+	}
+
+	if (num > stmt->num_params) {
+		stmt->params = talloc_realloc(stmt, stmt->params,
+					      struct ldb_val *, num);
+		if (stmt->params == NULL) {
+			return ldb_oom(stmt->ldb);
+		}
+		for (i = stmt->num_params; i < num; i++) {
+			stmt->params[i] = NULL;
+		}
+		stmt->num_params = num;
+	}
+	if (stmt->params[num-1] != NULL) {
+		ldb_asprintf_errstring(stmt->ldb,
+				       "duplicate placeholder $%u", num);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+	stmt->params[num-1] = slot;
+
+	return LDB_SUCCESS;
+}
+
+int ldb_search_stmt_prepare(struct ldb_context *ldb, TALLOC_CTX *mem_ctx,
+			    struct ldb_dn *base, enum ldb_scope scope,
+			    const char *expression,
+			    const char * const *attrs,
+			    struct ldb_search_stmt **stmt)
+{
+	struct ldb_search_stmt *s;
+	unsigned int i;
+	int ret;
+
+	*stmt = NULL;
+
+	s = talloc_zero(mem_ctx, struct ldb_search_stmt);
+	if (s == NULL) {
+		return ldb_oom(ldb);
+	}
+	s->ldb = ldb;
+	s->scope = scope;
+
+	if (base != NULL) {
+		s->base = ldb_dn_copy(s, base);
+		if (s->base == NULL) {
+			talloc_free(s);
+			return ldb_oom(ldb);
+		}
+	}
+
+	if (attrs != NULL) {
+		s->attrs = ldb_attr_list_copy(s, attrs);
+		if (s->attrs == NULL) {
+			talloc_free(s);
+			return ldb_oom(ldb);
+		}
+	}
+
+	s->tree = ldb_parse_tree(s, expression);
+	if (s->tree == NULL) {
+		ldb_asprintf_errstring(ldb, "Unable to parse search expression");
+		talloc_free(s);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	ret = ldb_stmt_find_params(s, s->tree);
+	if (ret != LDB_SUCCESS) {
+		talloc_free(s);
+		return ret;
+	}
+
+	/* the placeholders must be numbered 1..num_params */
+	for (i = 0; i < s->num_params; i++) {
+		if (s->params[i] == NULL) {
+			ldb_asprintf_errstring(ldb,
+					       "missing placeholder $%u", i+1);
+			talloc_free(s);
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+	}
+
+	*stmt = s;
+	return LDB_SUCCESS;
+}
+
+unsigned int ldb_search_stmt_num_params(const struct ldb_search_stmt *stmt)
+{
+	return stmt->num_params;
+}
+
+int ldb_search_stmt_exec(struct ldb_search_stmt *stmt, TALLOC_CTX *mem_ctx,
+			 const struct ldb_val *values,
+			 unsigned int num_values,
+			 struct ldb_result **result)
+{
+	struct ldb_context *ldb = stmt->ldb;
+	struct ldb_request *req;
+	struct ldb_result *res;
+	unsigned int i;
+	int ret;
+
+	*result = NULL;
+	req = NULL;
+
+	if (num_values != stmt->num_params) {
+		ldb_asprintf_errstring(ldb,
+				       "%u values bound, statement has %u placeholders",
+				       num_values, stmt->num_params);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	/* bind the values; they are borrowed from the caller for the
+	 * duration of this call only */
+	for (i = 0; i < stmt->num_params; i++) {
+		*stmt->params[i] = values[i];
+	}
+
+	res = talloc_zero(mem_ctx, struct ldb_result);
+	if (!res) {
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	ret = ldb_build_search_req_ex(&req, ldb, mem_ctx,
+				      stmt->base?stmt->base:ldb_get_default_basedn(ldb),
+				      stmt->scope,
+				      stmt->tree,
+				      stmt->attrs,
+				      NULL,
+				      res,
+				      ldb_search_default_callback,
+				      NULL);
+	ldb_req_set_location(req, "ldb_search_stmt_exec");
+
+	if (ret != LDB_SUCCESS) goto done;
+
+	ret = ldb_request(ldb, req);
+
+	if (ret == LDB_SUCCESS) {
+		ret = ldb_wait(req->handle, LDB_WAIT_ALL);
+	}
+
+done:
+	if (ret != LDB_SUCCESS) {
+		talloc_free(res);
+		res = NULL;
+	}
+
+	talloc_free(req);
+
+	*result = res;
+	return ret;
+}
+
 /*
   add a record to the database. Will fail if a record with the given class
   and key already exists
@@ -98,6 +98,9 @@ int ldb_schema_attribute_add_with_syntax(struct ldb_context *ldb,
 		}
 	}
 
+	/* cached DN casefolds may have used the old handlers */
+	ldb_dn_cache_flush(ldb);
+
 	return 0;
 }
 
@@ -208,11 +211,14 @@ void ldb_schema_attribute_remove(struct ldb_context *ldb, const char *name)
 
 	i = a - ldb->schema.attributes;
 	if (i < ldb->schema.num_attributes - 1) {
-		memmove(&ldb->schema.attributes[i], 
+		memmove(&ldb->schema.attributes[i],
 			a+1, sizeof(*a) * (ldb->schema.num_attributes-(i+1)));
 	}
 
 	ldb->schema.num_attributes--;
+
+	/* cached DN casefolds may have used the removed handler */
+	ldb_dn_cache_flush(ldb);
 }
 
 /*
@@ -314,4 +320,7 @@ void ldb_schema_attribute_set_override_handler(struct ldb_context *ldb,
 {
 	ldb->schema.attribute_handler_override_private = private_data;
 	ldb->schema.attribute_handler_override = override;
+
+	/* cached DN casefolds may have used the old handlers */
+	ldb_dn_cache_flush(ldb);
 }
@@ -85,6 +85,168 @@ static void ldb_dn_mark_invalid(struct ldb_dn *dn)
 	dn->invalid = true;
 }
 
+/*
+  cache of recently exploded and casefolded DNs, kept at the
+  ldb_context level. The same DN strings (base DNs in particular) are
+  exploded over and over again, and canonicalising every component
+  through the attribute handlers is by far the most expensive part of
+  that. The cache keeps a private snapshot of the parsed components
+  per linearized string in a small direct mapped table; a hit copies
+  the components instead of re-parsing and re-canonicalising.
+
+  The cache has to be flushed when the schema attributes or the utf8
+  functions change, as both change the canonical form of a DN.
+*/
+
+#define LDB_DN_CACHE_SIZE 128
+
+struct ldb_dn_cache_entry {
+	char *linearized;
+	char *casefold;
+	unsigned int comp_num;
+	struct ldb_dn_component *components;
+};
+
+struct ldb_dn_cache {
+	struct ldb_dn_cache_entry *entries[LDB_DN_CACHE_SIZE];
+};
+
+static unsigned int ldb_dn_cache_hash(const char *s)
+{
+	/* FNV-1a */
+	unsigned int h = 2166136261u;
+	while (*s) {
+		h ^= (unsigned char)*s++;
+		h *= 16777619u;
+	}
+	return h % LDB_DN_CACHE_SIZE;
+}
+
+static struct ldb_dn_component ldb_dn_copy_component(
+						TALLOC_CTX *mem_ctx,
+						struct ldb_dn_component *src);
+
+/*
+  fill in dn->components and the casefold data from a cached copy of
+  the same linearized DN, if there is one. Returns false if the DN is
+  not in the cache
+*/
+static bool ldb_dn_cache_lookup(struct ldb_dn *dn)
+{
+	struct ldb_dn_cache *cache = dn->ldb->dn_cache;
+	struct ldb_dn_cache_entry *e;
+	unsigned int i;
+
+	if (cache == NULL || dn->linearized == NULL) {
+		return false;
+	}
+
+	e = cache->entries[ldb_dn_cache_hash(dn->linearized)];
+	if (e == NULL || strcmp(e->linearized, dn->linearized) != 0) {
+		return false;
+	}
+
+	dn->components = talloc_zero_array(dn, struct ldb_dn_component,
+					   e->comp_num);
+	if (dn->components == NULL) {
+		return false;
+	}
+
+	for (i = 0; i < e->comp_num; i++) {
+		dn->components[i] = ldb_dn_copy_component(dn->components,
+							  &e->components[i]);
+		if (dn->components[i].value.data == NULL) {
+			LDB_FREE(dn->components);
+			return false;
+		}
+	}
+	dn->comp_num = e->comp_num;
+
+	dn->casefold = talloc_strdup(dn, e->casefold);
+	if (dn->casefold == NULL) {
+		LDB_FREE(dn->components);
+		dn->comp_num = 0;
+		return false;
+	}
+	dn->valid_case = true;
+
+	return true;
+}
+
+/*
+  remember a fully casefolded DN so later explodes of the same string
+  can skip the parse and the canonicalisation
+*/
+static void ldb_dn_cache_store(struct ldb_dn *dn)
+{
+	struct ldb_dn_cache *cache;
+	struct ldb_dn_cache_entry *e;
+	unsigned int i, h;
+
+	if (dn->special || dn->invalid) {
+		return;
+	}
+	if (!dn->valid_case || dn->casefold == NULL) {
+		return;
+	}
+	if (dn->comp_num == 0 || dn->linearized == NULL) {
+		return;
+	}
+
+	if (dn->ldb->dn_cache == NULL) {
+		dn->ldb->dn_cache = talloc_zero(dn->ldb, struct ldb_dn_cache);
+		if (dn->ldb->dn_cache == NULL) {
+			return;
+		}
+	}
+	cache = dn->ldb->dn_cache;
+
+	h = ldb_dn_cache_hash(dn->linearized);
+	if (cache->entries[h] != NULL) {
+		if (strcmp(cache->entries[h]->linearized,
+			   dn->linearized) == 0) {
+			/* already cached */
+			return;
+		}
+		/* evict the previous occupant of the slot */
+		LDB_FREE(cache->entries[h]);
+	}
+
+	e = talloc_zero(cache, struct ldb_dn_cache_entry);
+	if (e == NULL) {
+		return;
+	}
+	e->linearized = talloc_strdup(e, dn->linearized);
+	e->casefold = talloc_strdup(e, dn->casefold);
+	e->components = talloc_zero_array(e, struct ldb_dn_component,
+					  dn->comp_num);
+	if (e->linearized == NULL || e->casefold == NULL ||
+	    e->components == NULL) {
+		talloc_free(e);
+		return;
+	}
+	for (i = 0; i < dn->comp_num; i++) {
+		e->components[i] = ldb_dn_copy_component(e->components,
+							 &dn->components[i]);
+		if (e->components[i].value.data == NULL) {
+			talloc_free(e);
+			return;
+		}
+	}
+	e->comp_num = dn->comp_num;
+
+	cache->entries[h] = e;
+}
+
+/*
+  drop all cached DNs. Called whenever the schema attributes or utf8
+  functions change, as the cached canonical forms depend on them
+*/
+void ldb_dn_cache_flush(struct ldb_context *ldb)
+{
+	LDB_FREE(ldb->dn_cache);
+}
+
 /* strdn may be NULL */
 struct ldb_dn *ldb_dn_from_ldb_val(TALLOC_CTX *mem_ctx,
                                    struct ldb_context *ldb,
@@ -325,6 +487,13 @@ static bool ldb_dn_explode(struct ldb_dn *dn)
 		return true;
 	}
 
+	/* a previously casefolded copy of the same DN may be cached.
+	   This only works when parsing the plain linearized form, as a
+	   cache hit does not fill in any extended components */
+	if (dn->ext_linearized == NULL && ldb_dn_cache_lookup(dn)) {
+		return true;
+	}
+
 	/* make sure we free this if allocated previously before replacing */
 	LDB_FREE(dn->components);
 	dn->comp_num = 0;
@@ -1011,6 +1180,10 @@ const char *ldb_dn_get_casefold(struct ldb_dn *dn)
 	dn->casefold = talloc_realloc(dn, dn->casefold,
 				      char, strlen(dn->casefold) + 1);
 
+	if (dn->casefold != NULL) {
+		ldb_dn_cache_store(dn);
+	}
+
 	return dn->casefold;
 }
 
@@ -38,10 +38,10 @@
 /*
   check if the scope matches in a search result
 */
-static int ldb_match_scope(struct ldb_context *ldb,
-			   struct ldb_dn *base,
-			   struct ldb_dn *dn,
-			   enum ldb_scope scope)
+_PRIVATE_ int ldb_match_scope(struct ldb_context *ldb,
+			      struct ldb_dn *base,
+			      struct ldb_dn *dn,
+			      enum ldb_scope scope)
 {
 	int ret = 0;
 
@@ -78,13 +78,17 @@ static int ldb_match_scope(struct ldb_context *ldb,
 
 /*
   match if node is present
+
+  the attribute handlers may be passed in by the caller (from a
+  compiled filter), or NULL to look them up here
 */
-static int ldb_match_present(struct ldb_context *ldb, 
+static int ldb_match_present(struct ldb_context *ldb,
 			     const struct ldb_message *msg,
 			     const struct ldb_parse_tree *tree,
-			     enum ldb_scope scope, bool *matched)
+			     enum ldb_scope scope,
+			     const struct ldb_schema_attribute *a,
+			     bool *matched)
 {
-	const struct ldb_schema_attribute *a;
 	struct ldb_message_element *el;
 
 	if (ldb_attr_dn(tree->u.present.attr) == 0) {
@@ -98,7 +102,9 @@ static int ldb_match_present(struct ldb_context *ldb,
 		return LDB_SUCCESS;
 	}
 
-	a = ldb_schema_attribute_by_name(ldb, el->name);
+	if (a == NULL) {
+		a = ldb_schema_attribute_by_name(ldb, el->name);
+	}
 	if (!a) {
 		return LDB_ERR_INVALID_ATTRIBUTE_SYNTAX;
 	}
@@ -118,15 +124,16 @@ static int ldb_match_present(struct ldb_context *ldb,
 	return LDB_SUCCESS;
 }
 
-static int ldb_match_comparison(struct ldb_context *ldb, 
+static int ldb_match_comparison(struct ldb_context *ldb,
 				const struct ldb_message *msg,
 				const struct ldb_parse_tree *tree,
 				enum ldb_scope scope,
-				enum ldb_parse_op comp_op, bool *matched)
+				enum ldb_parse_op comp_op,
+				const struct ldb_schema_attribute *a,
+				bool *matched)
 {
 	unsigned int i;
 	struct ldb_message_element *el;
-	const struct ldb_schema_attribute *a;
 
 	/* FIXME: APPROX comparison not handled yet */
 	if (comp_op == LDB_OP_APPROX) {
@@ -139,7 +146,9 @@ static int ldb_match_comparison(struct ldb_context *ldb,
 		return LDB_SUCCESS;
 	}
 
-	a = ldb_schema_attribute_by_name(ldb, el->name);
+	if (a == NULL) {
+		a = ldb_schema_attribute_by_name(ldb, el->name);
+	}
 	if (!a) {
 		return LDB_ERR_INVALID_ATTRIBUTE_SYNTAX;
 	}
@@ -175,15 +184,15 @@ static int ldb_match_comparison(struct ldb_context *ldb,
 /*
   match a simple leaf node
 */
-static int ldb_match_equality(struct ldb_context *ldb, 
+static int ldb_match_equality(struct ldb_context *ldb,
 			      const struct ldb_message *msg,
 			      const struct ldb_parse_tree *tree,
 			      enum ldb_scope scope,
+			      const struct ldb_schema_attribute *a,
 			      bool *matched)
 {
 	unsigned int i;
 	struct ldb_message_element *el;
-	const struct ldb_schema_attribute *a;
 	struct ldb_dn *valuedn;
 	int ret;
 
@@ -209,7 +218,9 @@ static int ldb_match_equality(struct ldb_context *ldb,
 		return LDB_SUCCESS;
 	}
 
-	a = ldb_schema_attribute_by_name(ldb, el->name);
+	if (a == NULL) {
+		a = ldb_schema_attribute_by_name(ldb, el->name);
+	}
 	if (a == NULL) {
 		return LDB_ERR_INVALID_ATTRIBUTE_SYNTAX;
 	}
@@ -562,22 +573,22 @@ static int ldb_match_message(struct ldb_context *ldb,
 		return LDB_SUCCESS;
 
 	case LDB_OP_EQUALITY:
-		return ldb_match_equality(ldb, msg, tree, scope, matched);
+		return ldb_match_equality(ldb, msg, tree, scope, NULL, matched);
 
 	case LDB_OP_SUBSTRING:
 		return ldb_match_substring(ldb, msg, tree, scope, matched);
 
 	case LDB_OP_GREATER:
-		return ldb_match_comparison(ldb, msg, tree, scope, LDB_OP_GREATER, matched);
+		return ldb_match_comparison(ldb, msg, tree, scope, LDB_OP_GREATER, NULL, matched);
 
 	case LDB_OP_LESS:
-		return ldb_match_comparison(ldb, msg, tree, scope, LDB_OP_LESS, matched);
+		return ldb_match_comparison(ldb, msg, tree, scope, LDB_OP_LESS, NULL, matched);
 
 	case LDB_OP_PRESENT:
-		return ldb_match_present(ldb, msg, tree, scope, matched);
+		return ldb_match_present(ldb, msg, tree, scope, NULL, matched);
 
 	case LDB_OP_APPROX:
-		return ldb_match_comparison(ldb, msg, tree, scope, LDB_OP_APPROX, matched);
+		return ldb_match_comparison(ldb, msg, tree, scope, LDB_OP_APPROX, NULL, matched);
 
 	case LDB_OP_EXTENDED:
 		return ldb_match_extended(ldb, msg, tree, scope, matched);
@@ -623,6 +634,254 @@ int ldb_match_msg_error(struct ldb_context *ldb,
 	return ldb_match_message(ldb, msg, tree, scope, matched);
 }
 
+/*
+  Compiled filters flatten the parse tree into a linear instruction
+  sequence with explicit short-circuit jumps, resolving the attribute
+  handlers of each leaf once instead of per candidate message. They
+  are a pure evaluation-speed cache for one search: the attribute
+  handler pointers are only valid as long as the schema of the ldb
+  context does not change, so a compiled filter must not outlive the
+  search it was compiled for.
+*/
+
+enum ldb_filter_instr_op {
+	LDB_FILTER_INSTR_LEAF,	/* evaluate the leaf node in 'tree' */
+	LDB_FILTER_INSTR_JMPF,	/* jump to 'target' if not matched */
+	LDB_FILTER_INSTR_JMPT,	/* jump to 'target' if matched */
+	LDB_FILTER_INSTR_NOT	/* invert the current match state */
+};
+
+struct ldb_filter_instr {
+	enum ldb_filter_instr_op op;
+	unsigned int target;
+	const struct ldb_parse_tree *tree;
+	const struct ldb_schema_attribute *a;
+};
+
+struct ldb_filter_compiled {
+	unsigned int num_instrs;
+	struct ldb_filter_instr *instrs;
+};
+
+/* append an instruction, returning its index or -1 on failure */
+static int ldb_filter_emit(struct ldb_filter_compiled *prog,
+			   enum ldb_filter_instr_op op)
+{
+	struct ldb_filter_instr *instrs;
+
+	instrs = talloc_realloc(prog, prog->instrs,
+				struct ldb_filter_instr,
+				prog->num_instrs + 1);
+	if (instrs == NULL) {
+		return -1;
+	}
+	prog->instrs = instrs;
+
+	memset(&instrs[prog->num_instrs], 0, sizeof(instrs[0]));
+	instrs[prog->num_instrs].op = op;
+
+	return prog->num_instrs++;
+}
+
+/*
+  compile one tree node; returns false if the node uses a construct
+  the compiled form does not handle, in which case the caller falls
+  back to the recursive interpreter
+*/
+static bool ldb_filter_compile_node(struct ldb_context *ldb,
+				    struct ldb_filter_compiled *prog,
+				    const struct ldb_parse_tree *tree)
+{
+	const char *attr = NULL;
+	unsigned int i;
+	int idx;
+
+	switch (tree->operation) {
+	case LDB_OP_AND:
+	case LDB_OP_OR: {
+		unsigned int *jumps;
+		unsigned int num_jumps = 0;
+
+		if (tree->u.list.num_elements == 0) {
+			return false;
+		}
+
+		jumps = talloc_array(prog, unsigned int,
+				     tree->u.list.num_elements);
+		if (jumps == NULL) {
+			return false;
+		}
+
+		for (i = 0; i < tree->u.list.num_elements; i++) {
+			if (!ldb_filter_compile_node(ldb, prog,
+						     tree->u.list.elements[i])) {
+				talloc_free(jumps);
+				return false;
+			}
+			if (i == tree->u.list.num_elements - 1) {
+				break;
+			}
+			idx = ldb_filter_emit(prog,
+					      tree->operation == LDB_OP_AND ?
+					      LDB_FILTER_INSTR_JMPF :
+					      LDB_FILTER_INSTR_JMPT);
+			if (idx == -1) {
+				talloc_free(jumps);
+				return false;
+			}
+			jumps[num_jumps++] = idx;
+		}
+
+		/* the short-circuit jumps land after the last element */
+		for (i = 0; i < num_jumps; i++) {
+			prog->instrs[jumps[i]].target = prog->num_instrs;
+		}
+		talloc_free(jumps);
+		return true;
+	}
+
+	case LDB_OP_NOT:
+		if (!ldb_filter_compile_node(ldb, prog, tree->u.isnot.child)) {
+			return false;
+		}
+		return ldb_filter_emit(prog, LDB_FILTER_INSTR_NOT) != -1;
+
+	case LDB_OP_EQUALITY:
+		attr = tree->u.equality.attr;
+		break;
+	case LDB_OP_GREATER:
+	case LDB_OP_LESS:
+		attr = tree->u.comparison.attr;
+		break;
+	case LDB_OP_PRESENT:
+		attr = tree->u.present.attr;
+		break;
+	case LDB_OP_SUBSTRING:
+		/* the wildcard match resolves its handlers itself */
+		break;
+
+	case LDB_OP_APPROX:
+	case LDB_OP_EXTENDED:
+		/* rarely hot, keep using the interpreter */
+		return false;
+	}
+
+	/* DN pseudo attributes take a different codepath entirely */
+	if (attr != NULL && ldb_attr_dn(attr) == 0) {
+		return false;
+	}
+
+	idx = ldb_filter_emit(prog, LDB_FILTER_INSTR_LEAF);
+	if (idx == -1) {
+		return false;
+	}
+	prog->instrs[idx].tree = tree;
+	if (attr != NULL) {
+		prog->instrs[idx].a = ldb_schema_attribute_by_name(ldb, attr);
+	}
+
+	return true;
+}
+
+/*
+  compile a parse tree for repeated matching; returns NULL if the
+  tree contains nodes the compiled form does not support, the caller
+  then just keeps using ldb_match_msg_error()
+*/
+_PRIVATE_ struct ldb_filter_compiled *ldb_filter_compile(struct ldb_context *ldb,
+							 TALLOC_CTX *mem_ctx,
+							 const struct ldb_parse_tree *tree)
+{
+	struct ldb_filter_compiled *prog;
+
+	prog = talloc_zero(mem_ctx, struct ldb_filter_compiled);
+	if (prog == NULL) {
+		return NULL;
+	}
+
+	if (!ldb_filter_compile_node(ldb, prog, tree)) {
+		talloc_free(prog);
+		return NULL;
+	}
+
+	return prog;
+}
+
+/*
+  as ldb_match_msg_error(), but evaluating a compiled filter
+*/
+_PRIVATE_ int ldb_match_msg_compiled(struct ldb_context *ldb,
+				     const struct ldb_message *msg,
+				     const struct ldb_filter_compiled *prog,
+				     struct ldb_dn *base,
+				     enum ldb_scope scope,
+				     bool *matched)
+{
+	unsigned int pc;
+	bool m = false;
+	int ret;
+
+	*matched = false;
+
+	if ( ! ldb_match_scope(ldb, base, msg->dn, scope) ) {
+		return LDB_SUCCESS;
+	}
+
+	if (scope != LDB_SCOPE_BASE && ldb_dn_is_special(msg->dn)) {
+		/* don't match special records except on base searches */
+		return LDB_SUCCESS;
+	}
+
+	for (pc = 0; pc < prog->num_instrs; ) {
+		const struct ldb_filter_instr *instr = &prog->instrs[pc];
+
+		switch (instr->op) {
+		case LDB_FILTER_INSTR_JMPF:
+			pc = m ? pc + 1 : instr->target;
+			continue;
+		case LDB_FILTER_INSTR_JMPT:
+			pc = m ? instr->target : pc + 1;
+			continue;
+		case LDB_FILTER_INSTR_NOT:
+			m = !m;
+			pc++;
+			continue;
+		case LDB_FILTER_INSTR_LEAF:
+			break;
+		}
+
+		switch (instr->tree->operation) {
+		case LDB_OP_EQUALITY:
+			ret = ldb_match_equality(ldb, msg, instr->tree, scope,
+						 instr->a, &m);
+			break;
+		case LDB_OP_GREATER:
+		case LDB_OP_LESS:
+			ret = ldb_match_comparison(ldb, msg, instr->tree, scope,
+						   instr->tree->operation,
+						   instr->a, &m);
+			break;
+		case LDB_OP_PRESENT:
+			ret = ldb_match_present(ldb, msg, instr->tree, scope,
+						instr->a, &m);
+			break;
+		case LDB_OP_SUBSTRING:
+			ret = ldb_match_substring(ldb, msg, instr->tree, scope,
+						  &m);
+			break;
+		default:
+			return LDB_ERR_INAPPROPRIATE_MATCHING;
+		}
+		if (ret != LDB_SUCCESS) {
+			return ret;
+		}
+		pc++;
+	}
+
+	*matched = m;
+	return LDB_SUCCESS;
+}
+
 int ldb_match_msg_objectclass(const struct ldb_message *msg,
 			      const char *objectclass)
 {
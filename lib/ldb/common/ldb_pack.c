@@ -149,14 +149,26 @@ int ldb_pack_data(struct ldb_context *ldb,
 /*
   unpack a ldb message from a linear buffer in ldb_val
 
+  if a non-empty list is given, only the elements with a name on the
+  list are decoded; the others are skipped over without allocating
+  anything. This lets search callers avoid materialising attributes
+  that neither the filter nor the caller asked for.
+  nb_elements_in_db, if non-NULL, receives the total number of
+  elements stored in the record
+
   Free with ldb_unpack_data_free()
 */
-int ldb_unpack_data(struct ldb_context *ldb,
-		    const struct ldb_val *data,
-		    struct ldb_message *message)
+int ldb_unpack_data_only_attr_list(struct ldb_context *ldb,
+				   const struct ldb_val *data,
+				   struct ldb_message *message,
+				   const char * const *list,
+				   unsigned int list_size,
+				   unsigned int *nb_elements_in_db)
 {
 	uint8_t *p;
 	unsigned int remaining;
+	unsigned int num_elements_in_db;
+	unsigned int nelem = 0;
 	unsigned int i, j;
 	unsigned format;
 	size_t len;
@@ -170,7 +182,11 @@ int ldb_unpack_data(struct ldb_context *ldb,
 	}
 
 	format = pull_uint32(p, 0);
-	message->num_elements = pull_uint32(p, 4);
+	num_elements_in_db = pull_uint32(p, 4);
+	message->num_elements = num_elements_in_db;
+	if (nb_elements_in_db) {
+		*nb_elements_in_db = num_elements_in_db;
+	}
 	p += 8;
 
 	remaining = data->length - 8;
@@ -218,7 +234,11 @@ int ldb_unpack_data(struct ldb_context *ldb,
 	memset(message->elements, 0,
 	       message->num_elements * sizeof(struct ldb_message_element));
 
-	for (i=0;i<message->num_elements;i++) {
+	for (i=0;i<num_elements_in_db;i++) {
+		const char *name;
+		unsigned int num_values;
+		bool keep;
+
 		if (remaining < 10) {
 			errno = EIO;
 			goto failed;
@@ -232,46 +252,92 @@ int ldb_unpack_data(struct ldb_context *ldb,
 			errno = EIO;
 			goto failed;
 		}
-		message->elements[i].flags = 0;
-		message->elements[i].name = talloc_strndup(message->elements, (char *)p, len);
-		if (message->elements[i].name == NULL) {
-			errno = ENOMEM;
-			goto failed;
-		}
+		/* the name is NUL terminated in the packed format */
+		name = (const char *)p;
 		remaining -= len + 1;
 		p += len + 1;
-		message->elements[i].num_values = pull_uint32(p, 0);
-		message->elements[i].values = NULL;
-		if (message->elements[i].num_values != 0) {
-			message->elements[i].values = talloc_array(message->elements,
-								     struct ldb_val,
-								     message->elements[i].num_values);
-			if (!message->elements[i].values) {
-				errno = ENOMEM;
-				goto failed;
+
+		/* if a list was given, skip over elements that are
+		   not on it without allocating anything */
+		if (list_size == 0) {
+			keep = true;
+		} else {
+			unsigned int k;
+			keep = false;
+			for (k = 0; k < list_size; k++) {
+				if (ldb_attr_cmp(list[k], name) == 0) {
+					keep = true;
+					break;
+				}
 			}
 		}
+
+		num_values = pull_uint32(p, 0);
 		p += 4;
 		remaining -= 4;
-		for (j=0;j<message->elements[i].num_values;j++) {
+
+		if (keep) {
+			message->elements[nelem].flags = 0;
+			message->elements[nelem].name = talloc_strndup(message->elements, name, len);
+			if (message->elements[nelem].name == NULL) {
+				errno = ENOMEM;
+				goto failed;
+			}
+			message->elements[nelem].num_values = num_values;
+			message->elements[nelem].values = NULL;
+			if (num_values != 0) {
+				message->elements[nelem].values = talloc_array(message->elements,
+									       struct ldb_val,
+									       num_values);
+				if (!message->elements[nelem].values) {
+					errno = ENOMEM;
+					goto failed;
+				}
+			}
+		}
+		for (j=0;j<num_values;j++) {
 			len = pull_uint32(p, 0);
 			if (len > remaining-5) {
 				errno = EIO;
 				goto failed;
 			}
 
-			message->elements[i].values[j].length = len;
-			message->elements[i].values[j].data = talloc_size(message->elements[i].values, len+1);
-			if (message->elements[i].values[j].data == NULL) {
-				errno = ENOMEM;
-				goto failed;
+			if (keep) {
+				message->elements[nelem].values[j].length = len;
+				message->elements[nelem].values[j].data =
+					talloc_size(message->elements[nelem].values, len+1);
+				if (message->elements[nelem].values[j].data == NULL) {
+					errno = ENOMEM;
+					goto failed;
+				}
+				memcpy(message->elements[nelem].values[j].data, p+4, len);
+				message->elements[nelem].values[j].data[len] = 0;
 			}
-			memcpy(message->elements[i].values[j].data, p+4, len);
-			message->elements[i].values[j].data[len] = 0;
 
 			remaining -= len+4+1;
 			p += len+4+1;
 		}
+		if (keep) {
+			nelem++;
+		}
+	}
+
+	message->num_elements = nelem;
+	if (nelem < num_elements_in_db) {
+		/* shrink the array to the elements we actually kept */
+		if (nelem == 0) {
+			talloc_free(message->elements);
+			message->elements = NULL;
+		} else {
+			message->elements = talloc_realloc(message,
+							   message->elements,
+							   struct ldb_message_element,
+							   nelem);
+			if (message->elements == NULL) {
+				errno = ENOMEM;
+				goto failed;
+			}
+		}
 	}
 
 	if (remaining != 0) {
@@ -283,5 +349,19 @@ int ldb_unpack_data(struct ldb_context *ldb,
 
 failed:
 	talloc_free(message->elements);
+	message->elements = NULL;
+	message->num_elements = 0;
 	return -1;
 }
+
+/*
+  unpack a ldb message from a linear buffer in ldb_val
+
+  Free with ldb_unpack_data_free()
+*/
+int ldb_unpack_data(struct ldb_context *ldb,
+		    const struct ldb_val *data,
+		    struct ldb_message *message)
+{
+	return ldb_unpack_data_only_attr_list(ldb, data, message, NULL, 0, NULL);
+}
@@ -1330,6 +1330,63 @@ int ldb_search(struct ldb_context *ldb, TALLOC_CTX *mem_ctx,
 	       enum ldb_scope scope, const char * const *attrs,
 	       const char *exp_fmt, ...) PRINTF_ATTRIBUTE(7,8);
 
+/**
+   a prepared search statement, see ldb_search_stmt_prepare()
+*/
+struct ldb_search_stmt;
+
+/**
+  Prepare a search statement for repeated execution
+
+  This parses the search expression once, so that hot recurring
+  queries can skip the filter parser on every execution. The
+  expression may contain placeholder values of the form "$1", "$2",
+  ... which are bound to concrete values by ldb_search_stmt_exec().
+
+  \param ldb the context associated with the database (from ldb_init())
+  \param mem_ctx the memory context the statement is allocated on
+  \param base the Base Distinguished Name for the query (pass NULL to use
+         the defaultNamingContext at execution time)
+  \param scope the search scope for the query
+  \param expression the search expression, with optional "$n" placeholders
+  \param attrs the search attributes for the query (pass NULL if none required)
+  \param stmt the returned prepared statement
+
+  \return result code (LDB_SUCCESS on success, or a failure code)
+
+  \note use talloc_free() to free the returned statement
+*/
+int ldb_search_stmt_prepare(struct ldb_context *ldb, TALLOC_CTX *mem_ctx,
+			    struct ldb_dn *base, enum ldb_scope scope,
+			    const char *expression,
+			    const char * const *attrs,
+			    struct ldb_search_stmt **stmt);
+
+/**
+  Return the number of "$n" placeholders in a prepared statement
+*/
+unsigned int ldb_search_stmt_num_params(const struct ldb_search_stmt *stmt);
+
+/**
+  Execute a prepared search statement
+
+  \param stmt the statement from ldb_search_stmt_prepare()
+  \param mem_ctx the memory context to use for the results
+  \param values the values bound to the "$n" placeholders, in order;
+         they only need to stay valid for the duration of this call
+  \param num_values number of bound values, must match
+         ldb_search_stmt_num_params()
+  \param result the return result
+
+  \return result code (LDB_SUCCESS on success, or a failure code)
+
+  \note use talloc_free() to free the ldb_result returned
+*/
+int ldb_search_stmt_exec(struct ldb_search_stmt *stmt, TALLOC_CTX *mem_ctx,
+			 const struct ldb_val *values,
+			 unsigned int num_values,
+			 struct ldb_result **result);
+
 /**
   Add a record to the database.
 
@@ -45,6 +45,8 @@
 
 struct ldb_context;
 
+struct ldb_dn_cache;
+
 struct ldb_module_ops;
 
 struct ldb_backend_ops;
@@ -118,6 +120,9 @@ struct ldb_context {
 
 	struct ldb_schema schema;
 
+	/* cache of exploded and casefolded DNs, see ldb_dn.c */
+	struct ldb_dn_cache *dn_cache;
+
 	char *err_string;
 
 	int transaction_active;
@@ -197,9 +202,41 @@ struct ldif_read_file_state {
 struct ldb_ldif *ldb_ldif_read_file_state(struct ldb_context *ldb, 
 					  struct ldif_read_file_state *state);
 
-char *ldb_ldif_write_redacted_trace_string(struct ldb_context *ldb, TALLOC_CTX *mem_ctx, 
+char *ldb_ldif_write_redacted_trace_string(struct ldb_context *ldb, TALLOC_CTX *mem_ctx,
 					   const struct ldb_ldif *ldif);
 
+/*
+ * drop the cached exploded DNs; must be called whenever the schema
+ * attributes or the utf8 functions of the context change
+ */
+void ldb_dn_cache_flush(struct ldb_context *ldb);
+
+/* The following definitions come from lib/ldb/common/ldb_match.c */
+
+struct ldb_filter_compiled;
+
+/* check whether dn falls under base for the given search scope */
+int ldb_match_scope(struct ldb_context *ldb,
+		    struct ldb_dn *base,
+		    struct ldb_dn *dn,
+		    enum ldb_scope scope);
+
+/*
+ * compile a parse tree into a linear form for repeated matching;
+ * returns NULL for unsupported trees (fall back to
+ * ldb_match_msg_error). The compiled filter caches attribute handler
+ * pointers and must not outlive the search it was compiled for
+ */
+struct ldb_filter_compiled *ldb_filter_compile(struct ldb_context *ldb,
+					       TALLOC_CTX *mem_ctx,
+					       const struct ldb_parse_tree *tree);
+int ldb_match_msg_compiled(struct ldb_context *ldb,
+			   const struct ldb_message *msg,
+			   const struct ldb_filter_compiled *prog,
+			   struct ldb_dn *base,
+			   enum ldb_scope scope,
+			   bool *matched);
+
 /*
  * these pack/unpack functions are exposed in the library for use by
  * ldb tools like ldbdump, but are not part of the public API
@@ -210,5 +247,16 @@ int ldb_pack_data(struct ldb_context *ldb,
 int ldb_unpack_data(struct ldb_context *ldb,
 		    const struct ldb_val *data,
 		    struct ldb_message *message);
+/*
+ * as ldb_unpack_data(), but only decodes the elements named in the
+ * list, skipping over the rest without allocation. An empty list
+ * decodes all elements
+ */
+int ldb_unpack_data_only_attr_list(struct ldb_context *ldb,
+				   const struct ldb_val *data,
+				   struct ldb_message *message,
+				   const char * const *list,
+				   unsigned int list_size,
+				   unsigned int *nb_elements_in_db);
 
 #endif
@@ -489,6 +489,133 @@ int ltdb_increase_sequence_number(struct ldb_module *module)
 	return ret;
 }
 
+/*
+  A small cache of recently fetched records, keyed by the tdb key (ie.
+  the casefolded DN). It is validated against tdb_get_seqnum(), which
+  moves on every write by this or any other process, so a hit is
+  always transaction-consistent with the database. This serves flows
+  like a bind followed by token construction, which fetch the same
+  objects several times in a row, from process memory instead of
+  taking a chainlock on the tdb every time.
+*/
+
+#define LTDB_REC_CACHE_SIZE 64
+/* don't let single huge records occupy the cache */
+#define LTDB_REC_CACHE_MAX_RECORD (64*1024)
+
+struct ltdb_rec_cache_entry {
+	TDB_DATA key;
+	TDB_DATA data;
+};
+
+struct ltdb_rec_cache {
+	int tdb_seqnum;
+	struct ltdb_rec_cache_entry *entries[LTDB_REC_CACHE_SIZE];
+};
+
+/* FNV-1a on the tdb key */
+static unsigned int ltdb_rec_cache_hash(TDB_DATA key)
+{
+	unsigned int h = 0x811c9dc5;
+	size_t i;
+
+	for (i = 0; i < key.dsize; i++) {
+		h ^= key.dptr[i];
+		h *= 0x01000193;
+	}
+	return h % LTDB_REC_CACHE_SIZE;
+}
+
+/* throw away all cached records */
+static void ltdb_rec_cache_flush(struct ltdb_rec_cache *rc)
+{
+	unsigned int i;
+
+	for (i = 0; i < LTDB_REC_CACHE_SIZE; i++) {
+		TALLOC_FREE(rc->entries[i]);
+	}
+}
+
+/*
+  look up a record in the cache; the returned data is borrowed from
+  the cache and only valid until the next database write. A miss
+  returns tdb_null.
+*/
+TDB_DATA ltdb_rec_cache_find(struct ltdb_private *ltdb, TDB_DATA key)
+{
+	struct ltdb_rec_cache *rc = ltdb->rec_cache;
+	struct ltdb_rec_cache_entry *e;
+
+	if (rc == NULL) {
+		return tdb_null;
+	}
+
+	if (tdb_get_seqnum(ltdb->tdb) != rc->tdb_seqnum) {
+		ltdb_rec_cache_flush(rc);
+		rc->tdb_seqnum = tdb_get_seqnum(ltdb->tdb);
+		return tdb_null;
+	}
+
+	e = rc->entries[ltdb_rec_cache_hash(key)];
+	if (e == NULL ||
+	    e->key.dsize != key.dsize ||
+	    memcmp(e->key.dptr, key.dptr, key.dsize) != 0) {
+		return tdb_null;
+	}
+
+	return e->data;
+}
+
+/*
+  remember a record just fetched from the database; failures just
+  mean the record is not cached
+*/
+void ltdb_rec_cache_store(struct ltdb_private *ltdb, TDB_DATA key, TDB_DATA data)
+{
+	struct ltdb_rec_cache *rc = ltdb->rec_cache;
+	struct ltdb_rec_cache_entry *e;
+	unsigned int slot;
+
+	if (data.dsize > LTDB_REC_CACHE_MAX_RECORD) {
+		return;
+	}
+
+	/* the special @ records have their own cache above and must
+	   never be served stale */
+	if (key.dsize >= 4 && memcmp(key.dptr, "DN=@", 4) == 0) {
+		return;
+	}
+
+	if (rc == NULL) {
+		rc = talloc_zero(ltdb, struct ltdb_rec_cache);
+		if (rc == NULL) {
+			return;
+		}
+		rc->tdb_seqnum = tdb_get_seqnum(ltdb->tdb);
+		ltdb->rec_cache = rc;
+	} else if (tdb_get_seqnum(ltdb->tdb) != rc->tdb_seqnum) {
+		ltdb_rec_cache_flush(rc);
+		rc->tdb_seqnum = tdb_get_seqnum(ltdb->tdb);
+	}
+
+	e = talloc(rc, struct ltdb_rec_cache_entry);
+	if (e == NULL) {
+		return;
+	}
+	e->key.dptr = talloc_memdup(e, key.dptr, key.dsize);
+	e->data.dptr = talloc_memdup(e, data.dptr, data.dsize);
+	if (e->key.dptr == NULL || e->data.dptr == NULL) {
+		talloc_free(e);
+		return;
+	}
+	e->key.dsize = key.dsize;
+	e->data.dsize = data.dsize;
+
+	slot = ltdb_rec_cache_hash(key);
+	TALLOC_FREE(rc->entries[slot]);
+	rc->entries[slot] = e;
+}
+
 int ltdb_check_at_attributes_values(const struct ldb_val *value)
 {
 	unsigned int i;
@@ -37,6 +37,9 @@
 struct dn_list {
 	unsigned int count;
 	struct ldb_val *dn;
+	/* only meaningful for lists held in ltdb->idxptr: the list has
+	   been modified and must be written back on commit */
+	bool dirty;
 };
 
 struct ltdb_idxptr {
@@ -49,6 +52,12 @@ struct ltdb_idxptr {
 */
 #define LTDB_INDEXING_VERSION 2
 
+/* from this version onwards the index lists are kept sorted by
+   dn_list_cmp(), which allows them to be binary searched in place and
+   intersected with a linear merge. Older records are sorted in memory
+   on first load and rewritten in sorted form on their next update */
+#define LTDB_SORTED_INDEXING_VERSION 3
+
 /* enable the idxptr mode when transactions start */
 int ltdb_index_transaction_start(struct ldb_module *module)
 {
@@ -71,17 +80,45 @@ static int dn_list_cmp(const struct ldb_val *v1, const struct ldb_val *v2)
 }
 
 
+/*
+  binary search a sorted dn_list for a value, returning the index of
+  the match or -1 if it is not present. If insert_pos is non-NULL it
+  always receives the position at which the value would have to be
+  inserted to keep the list sorted
+ */
+static int ltdb_dn_list_search(const struct dn_list *list, const struct ldb_val *v,
+			       unsigned int *insert_pos)
+{
+	unsigned int lo = 0, hi = list->count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo)/2;
+		int cmp = dn_list_cmp(&list->dn[mid], v);
+		if (cmp == 0) {
+			if (insert_pos != NULL) {
+				*insert_pos = mid;
+			}
+			return mid;
+		}
+		if (cmp < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (insert_pos != NULL) {
+		*insert_pos = lo;
+	}
+	return -1;
+}
+
 /*
   find a entry in a dn_list, using a ldb_val. Uses a case sensitive
   comparison with the dn returns -1 if not found
  */
 static int ltdb_dn_list_find_val(const struct dn_list *list, const struct ldb_val *v)
 {
-	unsigned int i;
-	for (i=0; i<list->count; i++) {
-		if (dn_list_cmp(&list->dn[i], v) == 0) return i;
-	}
-	return -1;
+	return ltdb_dn_list_search(list, v, NULL);
 }
 
 /*
@@ -129,8 +166,11 @@ static struct dn_list *ltdb_index_idxptr(struct ldb_module *module, TDB_DATA rec
 	return list;
 }
 
+static int ltdb_dn_list_cache(struct ldb_module *module, struct ldb_dn *dn,
+			      struct dn_list *list, bool dirty);
+
 /*
-  return the @IDX list in an index entry for a dn as a 
+  return the @IDX list in an index entry for a dn as a
   struct dn_list
  */
 static int ltdb_dn_list_load(struct ldb_module *module,
@@ -184,8 +224,6 @@ normal_index:
 		return ret;
 	}
 
-	/* TODO: check indexing version number */
-
 	el = ldb_msg_find_element(msg, LTDB_IDX);
 	if (!el) {
 		talloc_free(msg);
@@ -196,6 +234,25 @@ normal_index:
 	list->dn = talloc_steal(list, el->values);
 	list->count = el->num_values;
 
+	/* records written before we kept the lists sorted need a one
+	   time in-memory sort. They are rewritten in sorted form with
+	   the new version number on their next update */
+	if (ldb_msg_find_attr_as_int(msg, LTDB_IDXVERSION, 0) <
+	    LTDB_SORTED_INDEXING_VERSION) {
+		TYPESAFE_QSORT(list->dn, list->count, dn_list_cmp);
+	}
+
+	/* inside a transaction, hold the loaded list in memory so that
+	   further loads and updates of the same index record within the
+	   transaction work on this copy instead of re-reading the
+	   database */
+	if (ltdb->idxptr != NULL) {
+		ret = ltdb_dn_list_cache(module, dn, list, false);
+		if (ret != LDB_SUCCESS) {
+			return ret;
+		}
+	}
+
 	return LDB_SUCCESS;
 }
 
@@ -222,7 +279,7 @@ static int ltdb_dn_list_store_full(struct ldb_module *module, struct ldb_dn *dn,
 		return ldb_module_oom(module);
 	}
 
-	ret = ldb_msg_add_fmt(msg, LTDB_IDXVERSION, "%u", LTDB_INDEXING_VERSION);
+	ret = ldb_msg_add_fmt(msg, LTDB_IDXVERSION, "%u", LTDB_SORTED_INDEXING_VERSION);
 	if (ret != LDB_SUCCESS) {
 		talloc_free(msg);
 		return ldb_module_oom(module);
@@ -247,20 +304,20 @@ static int ltdb_dn_list_store_full(struct ldb_module *module, struct ldb_dn *dn,
 }
 
 /*
-  save a dn_list into the database, in either @IDX or internal format
+  hold a dn_list in the in-memory index cache, replacing any existing
+  entry for the same index record. The caller's list is left pointing
+  at the cached copy. Entries marked dirty are written back to the
+  database when the transaction commits; entries cached on load stay
+  clean until they are modified
  */
-static int ltdb_dn_list_store(struct ldb_module *module, struct ldb_dn *dn, 
-			      struct dn_list *list)
+static int ltdb_dn_list_cache(struct ldb_module *module, struct ldb_dn *dn,
+			      struct dn_list *list, bool dirty)
 {
 	struct ltdb_private *ltdb = talloc_get_type(ldb_module_get_private(module), struct ltdb_private);
 	TDB_DATA rec, key;
 	int ret;
 	struct dn_list *list2;
 
-	if (ltdb->idxptr == NULL) {
-		return ltdb_dn_list_store_full(module, dn, list);
-	}
-
 	if (ltdb->idxptr->itdb == NULL) {
 		ltdb->idxptr->itdb = tdb_open(NULL, 1000, TDB_INTERNAL, O_RDWR, 0);
 		if (ltdb->idxptr->itdb == NULL) {
@@ -281,6 +338,7 @@ static int ltdb_dn_list_store(struct ldb_module *module, struct ldb_dn *dn,
 		free(rec.dptr);
 		list2->dn = talloc_steal(list2, list->dn);
 		list2->count = list->count;
+		list2->dirty |= dirty;
 		return LDB_SUCCESS;
 	}
 
@@ -290,6 +348,7 @@ static int ltdb_dn_list_store(struct ldb_module *module, struct ldb_dn *dn,
 	}
 	list2->dn = talloc_steal(list2, list->dn);
 	list2->count = list->count;
+	list2->dirty = dirty;
 
 	rec.dptr = (uint8_t *)&list2;
 	rec.dsize = sizeof(void *);
@@ -301,6 +360,21 @@ static int ltdb_dn_list_store(struct ldb_module *module, struct ldb_dn *dn,
 	return LDB_SUCCESS;
 }
 
+/*
+  save a dn_list into the database, in either @IDX or internal format
+ */
+static int ltdb_dn_list_store(struct ldb_module *module, struct ldb_dn *dn,
+			      struct dn_list *list)
+{
+	struct ltdb_private *ltdb = talloc_get_type(ldb_module_get_private(module), struct ltdb_private);
+
+	if (ltdb->idxptr == NULL) {
+		return ltdb_dn_list_store_full(module, dn, list);
+	}
+
+	return ltdb_dn_list_cache(module, dn, list, true);
+}
+
 /*
   traverse function for storing the in-memory index entries on disk
  */
@@ -319,6 +393,12 @@ static int ltdb_index_traverse_store(struct tdb_context *tdb, TDB_DATA key, TDB_
 		return -1;
 	}
 
+	/* entries that were only loaded for reading are unchanged on
+	   disk and don't need to be written back */
+	if (!list->dirty) {
+		return 0;
+	}
+
 	v.data = key.dptr;
 	v.length = strnlen((char *)key.dptr, key.dsize);
 
@@ -535,14 +615,15 @@ static int ltdb_index_dn_leaf(struct ldb_module *module,
 
 
 /*
-  list intersection
+  list intersection. Both lists are sorted by dn_list_cmp(), so this
+  is a single linear merge pass rather than a search per element
   list = list & list2
 */
 static bool list_intersect(struct ldb_context *ldb,
 			   struct dn_list *list, const struct dn_list *list2)
 {
 	struct dn_list *list3;
-	unsigned int i;
+	unsigned int i, j;
 
 	if (list->count == 0) {
 		/* 0 & X == 0 */
@@ -585,10 +666,17 @@ static bool list_intersect(struct ldb_context *ldb,
 	}
 	list3->count = 0;
 
-	for (i=0;i<list->count;i++) {
-		if (ltdb_dn_list_find_val(list2, &list->dn[i]) != -1) {
+	for (i=0, j=0; i<list->count && j<list2->count; ) {
+		int cmp = dn_list_cmp(&list->dn[i], &list2->dn[j]);
+		if (cmp == 0) {
 			list3->dn[list3->count] = list->dn[i];
 			list3->count++;
+			i++;
+			j++;
+		} else if (cmp < 0) {
+			i++;
+		} else {
+			j++;
 		}
 	}
 
@@ -601,13 +689,15 @@ static bool list_intersect(struct ldb_context *ldb,
 
 
 /*
-  list union
+  list union. Both lists are sorted by dn_list_cmp(), so merge them
+  keeping the result sorted and free of duplicates
   list = list | list2
 */
 static bool list_union(struct ldb_context *ldb,
 		       struct dn_list *list, const struct dn_list *list2)
 {
 	struct ldb_val *dn3;
+	unsigned int i, j, count;
 
 	if (list2->count == 0) {
 		/* X | 0 == X */
@@ -632,12 +722,27 @@ static bool list_union(struct ldb_context *ldb,
 		return false;
 	}
 
-	/* we allow for duplicates here, and get rid of them later */
-	memcpy(dn3, list->dn, sizeof(list->dn[0])*list->count);
-	memcpy(dn3+list->count, list2->dn, sizeof(list2->dn[0])*list2->count);
+	for (i=0, j=0, count=0; i<list->count || j<list2->count; ) {
+		int cmp;
+		if (i == list->count) {
+			cmp = 1;
+		} else if (j == list2->count) {
+			cmp = -1;
+		} else {
+			cmp = dn_list_cmp(&list->dn[i], &list2->dn[j]);
+		}
+		if (cmp < 0) {
+			dn3[count++] = list->dn[i++];
+		} else if (cmp > 0) {
+			dn3[count++] = list2->dn[j++];
+		} else {
+			dn3[count++] = list->dn[i++];
+			j++;
+		}
+	}
 
 	list->dn = dn3;
-	list->count += list2->count;
+	list->count = count;
 
 	return true;
 }
@@ -941,7 +1046,8 @@ static int ltdb_index_filter(const struct dn_list *dn_list,
 			return LDB_ERR_OPERATIONS_ERROR;
 		}
 
-		ret = ltdb_search_dn1(ac->module, dn, msg);
+		ret = ltdb_search_dn1_attrs(ac->module, dn, msg,
+					    ac->unpack_attrs);
 		talloc_free(dn);
 		if (ret == LDB_ERR_NO_SUCH_OBJECT) {
 			/* the record has disappeared? yes, this can happen */
@@ -955,8 +1061,16 @@ static int ltdb_index_filter(const struct dn_list *dn_list,
 			return LDB_ERR_OPERATIONS_ERROR;
 		}
 
-		ret = ldb_match_msg_error(ldb, msg,
-					  ac->tree, ac->base, ac->scope, &matched);
+		if (ac->filter_compiled != NULL) {
+			ret = ldb_match_msg_compiled(ldb, msg,
+						     ac->filter_compiled,
+						     ac->base, ac->scope,
+						     &matched);
+		} else {
+			ret = ldb_match_msg_error(ldb, msg,
+						  ac->tree, ac->base,
+						  ac->scope, &matched);
+		}
 		if (ret != LDB_SUCCESS) {
 			talloc_free(msg);
 			return ret;
@@ -1000,7 +1114,14 @@ static void ltdb_dn_list_remove_duplicates(struct dn_list *list)
 		return;
 	}
 
-	TYPESAFE_QSORT(list->dn, list->count, dn_list_cmp);
+	/* the index operations keep their results sorted, so a full
+	   sort is only needed if something violated that */
+	for (i=1; i<list->count; i++) {
+		if (dn_list_cmp(&list->dn[i-1], &list->dn[i]) > 0) {
+			TYPESAFE_QSORT(list->dn, list->count, dn_list_cmp);
+			break;
+		}
+	}
 
 	new_count = 1;
 	for (i=1; i<list->count; i++) {
@@ -1116,6 +1237,8 @@ static int ltdb_index_add1(struct ldb_module *module, const char *dn,
 	const struct ldb_schema_attribute *a;
 	struct dn_list *list;
 	unsigned alloc_len;
+	unsigned int pos;
+	struct ldb_val v;
 
 	ldb = ldb_module_get_ctx(module);
 
@@ -1137,7 +1260,10 @@ static int ltdb_index_add1(struct ldb_module *module, const char *dn,
 		return ret;
 	}
 
-	if (ltdb_dn_list_find_str(list, dn) != -1) {
+	v.data = discard_const_p(unsigned char, dn);
+	v.length = strlen(dn);
+
+	if (ltdb_dn_list_search(list, &v, &pos) != -1) {
 		talloc_free(list);
 		return LDB_SUCCESS;
 	}
@@ -1147,19 +1273,25 @@ static int ltdb_index_add1(struct ldb_module *module, const char *dn,
 		talloc_free(list);
 		ldb_asprintf_errstring(ldb, __location__ ": unique index violation on %s in %s",
 				       el->name, dn);
-		return LDB_ERR_ENTRY_ALREADY_EXISTS;		
+		return LDB_ERR_ENTRY_ALREADY_EXISTS;
 	}
 
 	/* overallocate the list a bit, to reduce the number of
-	 * realloc trigered copies */	 
+	 * realloc trigered copies */
 	alloc_len = ((list->count+1)+7) & ~7;
 	list->dn = talloc_realloc(list, list->dn, struct ldb_val, alloc_len);
 	if (list->dn == NULL) {
 		talloc_free(list);
 		return LDB_ERR_OPERATIONS_ERROR;
 	}
-	list->dn[list->count].data = (uint8_t *)talloc_strdup(list->dn, dn);
-	list->dn[list->count].length = strlen(dn);
+
+	/* insert at the position that keeps the list sorted */
+	if (pos != list->count) {
+		memmove(&list->dn[pos+1], &list->dn[pos],
+			sizeof(list->dn[0])*(list->count - pos));
+	}
+	list->dn[pos].data = (uint8_t *)talloc_strdup(list->dn, dn);
+	list->dn[pos].length = strlen(dn);
 	list->count++;
 
 	ret = ltdb_dn_list_store(module, dn_key, list);
@@ -235,9 +235,21 @@ static int ltdb_search_base(struct ldb_module *module, struct ldb_dn *dn)
 	return LDB_ERR_NO_SUCH_OBJECT;
 }
 
+/* count the entries in a NULL terminated attribute list */
+static unsigned int attr_list_length(const char * const *attrs)
+{
+	unsigned int i;
+	for (i = 0; attrs != NULL && attrs[i] != NULL; i++) /* noop */ ;
+	return i;
+}
+
 struct ltdb_parse_data_unpack_ctx {
 	struct ldb_message *msg;
 	struct ldb_module *module;
+	const char * const *attrs;
+	/* when non-NULL the record is remembered in the ltdb record
+	   cache after a successful unpack */
+	struct ltdb_private *ltdb;
 };
 
 static int ltdb_parse_data_unpack(TDB_DATA key, TDB_DATA data,
@@ -246,31 +258,43 @@ static int ltdb_parse_data_unpack(TDB_DATA key, TDB_DATA data,
 	struct ltdb_parse_data_unpack_ctx *ctx = private_data;
 
 	struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
-	int ret = ldb_unpack_data(ldb, (struct ldb_val *)&data, ctx->msg);
+	int ret = ldb_unpack_data_only_attr_list(ldb, (struct ldb_val *)&data,
+						 ctx->msg,
+						 ctx->attrs,
+						 attr_list_length(ctx->attrs),
+						 NULL);
 	if (ret == -1) {
 		ldb_debug(ldb, LDB_DEBUG_ERROR, "Invalid data for index %*.*s\n",
 			  (int)key.dsize, (int)key.dsize, key.dptr);
-		return LDB_ERR_OPERATIONS_ERROR;		
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+	if (ctx->ltdb != NULL) {
+		ltdb_rec_cache_store(ctx->ltdb, key, data);
 	}
 	return ret;
 }
 
 /*
-  search the database for a single simple dn, returning all attributes
-  in a single message
+  search the database for a single simple dn, returning the attributes
+  on the given list in a single message. A NULL list returns all
+  attributes
 
   return LDB_ERR_NO_SUCH_OBJECT on record-not-found
   and LDB_SUCCESS on success
 */
-int ltdb_search_dn1(struct ldb_module *module, struct ldb_dn *dn, struct ldb_message *msg)
+int ltdb_search_dn1_attrs(struct ldb_module *module, struct ldb_dn *dn,
+			  struct ldb_message *msg,
+			  const char * const *attrs)
 {
 	void *data = ldb_module_get_private(module);
 	struct ltdb_private *ltdb = talloc_get_type(data, struct ltdb_private);
 	int ret;
-	TDB_DATA tdb_key;
+	TDB_DATA tdb_key, cached;
 	struct ltdb_parse_data_unpack_ctx ctx = {
 		.msg = msg,
-		.module = module
+		.module = module,
+		.attrs = attrs,
+		.ltdb = ltdb
 	};
 
 	/* form the key */
@@ -284,8 +308,20 @@ int ltdb_search_dn1(struct ldb_module *module, struct ldb_dn *dn, struct ldb_mes
 	msg->num_elements = 0;
 	msg->elements = NULL;
 
-	ret = tdb_parse_record(ltdb->tdb, tdb_key, 
-			       ltdb_parse_data_unpack, &ctx); 
+	cached = ltdb_rec_cache_find(ltdb, tdb_key);
+	if (cached.dptr != NULL) {
+		/* no point re-storing a record served from the cache */
+		ctx.ltdb = NULL;
+		ret = ltdb_parse_data_unpack(tdb_key, cached, &ctx);
+		talloc_free(tdb_key.dptr);
+		if (ret != LDB_SUCCESS) {
+			return ret;
+		}
+		goto unpacked;
+	}
+
+	ret = tdb_parse_record(ltdb->tdb, tdb_key,
+			       ltdb_parse_data_unpack, &ctx);
 	talloc_free(tdb_key.dptr);
 	
 	if (ret == -1) {
@@ -296,7 +332,8 @@ int ltdb_search_dn1(struct ldb_module *module, struct ldb_dn *dn, struct ldb_mes
 	} else if (ret != LDB_SUCCESS) {
 		return ret;
 	}
-	
+
+unpacked:
 	if (!msg->dn) {
 		msg->dn = ldb_dn_copy(msg, dn);
 	}
@@ -307,6 +344,18 @@ int ltdb_search_dn1(struct ldb_module *module, struct ldb_dn *dn, struct ldb_mes
 	return LDB_SUCCESS;
 }
 
+/*
+  search the database for a single simple dn, returning all attributes
+  in a single message
+
+  return LDB_ERR_NO_SUCH_OBJECT on record-not-found
+  and LDB_SUCCESS on success
+*/
+int ltdb_search_dn1(struct ldb_module *module, struct ldb_dn *dn, struct ldb_message *msg)
+{
+	return ltdb_search_dn1_attrs(module, dn, msg, NULL);
+}
+
 /*
   add a set of attributes from a record to a set of results
   return 0 on success, -1 on failure
@@ -440,8 +489,32 @@ static int search_func(struct tdb_context *tdb, TDB_DATA key, TDB_DATA data, voi
 		return -1;
 	}
 
-	/* unpack the record */
-	ret = ldb_unpack_data(ldb, (struct ldb_val *)&data, msg);
+	/* for BASE and ONELEVEL scans the scope eliminates almost
+	   every record, and it can be checked from the DN in the
+	   record key alone, before paying for the unpack. SUBTREE
+	   scans are not prechecked as most records pass the scope
+	   there and the check would be paid twice */
+	if (ac->base != NULL &&
+	    (ac->scope == LDB_SCOPE_BASE || ac->scope == LDB_SCOPE_ONELEVEL)) {
+		struct ldb_dn *key_dn = ldb_dn_new(msg, ldb,
+						   (char *)key.dptr + 3);
+		if (key_dn == NULL) {
+			talloc_free(msg);
+			return -1;
+		}
+		if (!ldb_match_scope(ldb, ac->base, key_dn, ac->scope)) {
+			talloc_free(msg);
+			return 0;
+		}
+		talloc_free(key_dn);
+	}
+
+	/* unpack the record, decoding only the attributes the filter
+	   and the caller need when that set could be worked out */
+	ret = ldb_unpack_data_only_attr_list(ldb, (struct ldb_val *)&data, msg,
+					     ac->unpack_attrs,
+					     attr_list_length(ac->unpack_attrs),
+					     NULL);
 	if (ret == -1) {
 		talloc_free(msg);
 		return -1;
@@ -457,8 +530,13 @@ static int search_func(struct tdb_context *tdb, TDB_DATA key, TDB_DATA data, voi
 	}
 
 	/* see if it matches the given expression */
-	ret = ldb_match_msg_error(ldb, msg,
-				  ac->tree, ac->base, ac->scope, &matched);
+	if (ac->filter_compiled != NULL) {
+		ret = ldb_match_msg_compiled(ldb, msg, ac->filter_compiled,
+					     ac->base, ac->scope, &matched);
+	} else {
+		ret = ldb_match_msg_error(ldb, msg,
+					  ac->tree, ac->base, ac->scope, &matched);
+	}
 	if (ret != LDB_SUCCESS) {
 		talloc_free(msg);
 		return -1;
@@ -510,6 +588,100 @@ static int ltdb_search_full(struct ltdb_context *ctx)
 	return LDB_SUCCESS;
 }
 
+/*
+  collect the attribute names a parse tree can touch into *attrs.
+  returns false if the set cannot be worked out, in which case all
+  attributes have to be unpacked
+*/
+static bool ltdb_tree_collect_attrs(TALLOC_CTX *mem_ctx,
+				    const struct ldb_parse_tree *tree,
+				    const char ***attrs)
+{
+	unsigned int i;
+	const char *attr = NULL;
+
+	switch (tree->operation) {
+	case LDB_OP_AND:
+	case LDB_OP_OR:
+		for (i = 0; i < tree->u.list.num_elements; i++) {
+			if (!ltdb_tree_collect_attrs(mem_ctx,
+						     tree->u.list.elements[i],
+						     attrs)) {
+				return false;
+			}
+		}
+		return true;
+
+	case LDB_OP_NOT:
+		return ltdb_tree_collect_attrs(mem_ctx, tree->u.isnot.child,
+					       attrs);
+
+	case LDB_OP_EQUALITY:
+		attr = tree->u.equality.attr;
+		break;
+
+	case LDB_OP_GREATER:
+	case LDB_OP_LESS:
+	case LDB_OP_APPROX:
+		attr = tree->u.comparison.attr;
+		break;
+
+	case LDB_OP_SUBSTRING:
+		attr = tree->u.substring.attr;
+		break;
+
+	case LDB_OP_PRESENT:
+		attr = tree->u.present.attr;
+		break;
+
+	case LDB_OP_EXTENDED:
+		/* an extended match rule may look at the whole record */
+		return false;
+	}
+
+	if (attr == NULL) {
+		return false;
+	}
+
+	*attrs = ldb_attr_list_copy_add(mem_ctx, *attrs, attr);
+	if (*attrs == NULL) {
+		return false;
+	}
+
+	return true;
+}
+
+/*
+  work out the set of attributes the search has to unpack from each
+  candidate record, ie. the attributes the filter looks at plus the
+  attributes the caller asked for. Returns NULL if all attributes are
+  needed
+*/
+static const char * const *ltdb_unpack_attrs(struct ltdb_context *ctx)
+{
+	const char **attrs;
+
+	if (ctx->attrs == NULL) {
+		/* the caller wants all attributes */
+		return NULL;
+	}
+	if (ldb_attr_in_list(ctx->attrs, "*")) {
+		return NULL;
+	}
+
+	attrs = ldb_attr_list_copy(ctx, ctx->attrs);
+	if (attrs == NULL) {
+		return NULL;
+	}
+
+	if (!ltdb_tree_collect_attrs(ctx, ctx->tree, &attrs)) {
+		talloc_free(attrs);
+		return NULL;
+	}
+
+	return attrs;
+}
+
 /*
   search the database with a LDAP-like expression.
   choses a search method
@@ -587,6 +759,8 @@ int ltdb_search(struct ltdb_context *ctx)
 	ctx->scope = req->op.search.scope;
 	ctx->base = req->op.search.base;
 	ctx->attrs = req->op.search.attrs;
+	ctx->unpack_attrs = ltdb_unpack_attrs(ctx);
+	ctx->filter_compiled = ldb_filter_compile(ldb, ctx, ctx->tree);
 
 	if (ret == LDB_SUCCESS) {
 		uint32_t match_count = 0;
@@ -23,6 +23,10 @@ struct ltdb_private {
 		bool attribute_indexes;
 	} *cache;
 
+	/* cache of recently fetched records, validated against the
+	   tdb seqnum so any write drops the stale copies */
+	struct ltdb_rec_cache *rec_cache;
+
 	int in_transaction;
 
 	bool check_base;
@@ -47,6 +51,13 @@ struct ltdb_context {
 	struct ldb_dn *base;
 	enum ldb_scope scope;
 	const char * const *attrs;
+	/* the attributes worth unpacking from candidate records, ie.
+	   the union of the filter and requested attributes. NULL means
+	   all of them */
+	const char * const *unpack_attrs;
+	/* the compiled form of the filter, NULL when the tree has to
+	   be interpreted by ldb_match_msg_error() */
+	struct ldb_filter_compiled *filter_compiled;
 	struct tevent_timer *timeout_event;
 };
 
@@ -74,6 +85,8 @@ int ltdb_cache_reload(struct ldb_module *module);
 int ltdb_cache_load(struct ldb_module *module);
 int ltdb_increase_sequence_number(struct ldb_module *module);
 int ltdb_check_at_attributes_values(const struct ldb_val *value);
+TDB_DATA ltdb_rec_cache_find(struct ltdb_private *ltdb, TDB_DATA key);
+void ltdb_rec_cache_store(struct ltdb_private *ltdb, TDB_DATA key, TDB_DATA data);
 
 /* The following definitions come from lib/ldb/ldb_tdb/ldb_index.c  */
 
@@ -99,6 +112,9 @@ int ltdb_has_wildcard(struct ldb_module *module, const char *attr_name,
 		      const struct ldb_val *val);
 void ltdb_search_dn1_free(struct ldb_module *module, struct ldb_message *msg);
 int ltdb_search_dn1(struct ldb_module *module, struct ldb_dn *dn, struct ldb_message *msg);
+int ltdb_search_dn1_attrs(struct ldb_module *module, struct ldb_dn *dn,
+			  struct ldb_message *msg,
+			  const char * const *attrs);
 int ltdb_add_attr_results(struct ldb_module *module,
  			  TALLOC_CTX *mem_ctx, 
 			  struct ldb_message *msg,
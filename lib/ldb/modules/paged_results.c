@@ -60,6 +60,24 @@ struct results_store {
 	struct message_store *last;
 	int num_entries;
 
+	/*
+	 * Instead of keeping every complete message around until the
+	 * client has fetched the last page, we normally store just the
+	 * DNs and re-fetch each entry when its page is sent, keeping
+	 * the memory per paged search proportional to the number of
+	 * entries, not their size. This only works when the paged
+	 * control is the sole control on the request, because the
+	 * original controls cannot be replayed on the per-entry
+	 * searches; otherwise the old full materialization is used
+	 * and use_dn_list stays false.
+	 */
+	bool use_dn_list;
+	struct ldb_dn **dns;
+	unsigned int num_dns;
+	unsigned int next_dn;
+	const char **attrs;
+	char *expr;
+
 	struct message_store *first_ref;
 	struct message_store *last_ref;
 
@@ -117,6 +135,12 @@ static struct results_store *new_store(struct private_data *priv)
 
 	newr->first = NULL;
 	newr->num_entries = 0;
+	newr->use_dn_list = false;
+	newr->dns = NULL;
+	newr->num_dns = 0;
+	newr->next_dn = 0;
+	newr->attrs = NULL;
+	newr->expr = NULL;
 	newr->first_ref = NULL;
 	newr->controls = NULL;
 
@@ -137,6 +161,54 @@ struct paged_context {
 	struct ldb_control **controls;
 };
 
+/* amortize the cost of growing the stored dn array */
+#define PAGED_DN_ALLOC_BLOCK 1024
+
+/* fetch a single stored entry again, base scope with the original
+ * filter and attribute list. Entries that have been deleted or that
+ * stopped matching since the search started simply come back empty
+ * and are skipped, which RFC 2696 allows. */
+static int paged_fetch_dn(struct paged_context *ac,
+			  TALLOC_CTX *mem_ctx,
+			  struct ldb_parse_tree *tree,
+			  struct ldb_dn *dn,
+			  struct ldb_message **_msg)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(ac->module);
+	struct ldb_result *res;
+	struct ldb_request *req;
+	int ret;
+
+	*_msg = NULL;
+
+	res = talloc_zero(mem_ctx, struct ldb_result);
+	if (res == NULL) {
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	ret = ldb_build_search_req_ex(&req, ldb, mem_ctx,
+					dn, LDB_SCOPE_BASE, tree,
+					ac->store->attrs, NULL,
+					res, ldb_search_default_callback,
+					ac->req);
+	if (ret != LDB_SUCCESS) {
+		return ret;
+	}
+
+	ret = ldb_next_request(ac->module, req);
+	if (ret == LDB_SUCCESS) {
+		ret = ldb_wait(req->handle, LDB_WAIT_ALL);
+	}
+	talloc_free(req);
+	if (ret != LDB_SUCCESS || res->count != 1) {
+		/* entry gone or changed since the search started */
+		return LDB_SUCCESS;
+	}
+
+	*_msg = res->msgs[0];
+	return LDB_SUCCESS;
+}
+
 static int paged_results(struct paged_context *ac)
 {
 	struct ldb_paged_control *paged;
@@ -148,6 +220,62 @@ static int paged_results(struct paged_context *ac)
 		return LDB_ERR_OPERATIONS_ERROR;
 	}
 
+	if (ac->store->use_dn_list) {
+		struct ldb_context *ldb = ldb_module_get_ctx(ac->module);
+		struct ldb_parse_tree *tree;
+		TALLOC_CTX *tmp_ctx;
+
+		tmp_ctx = talloc_new(ac);
+		if (tmp_ctx == NULL) {
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+
+		tree = ldb_parse_tree(tmp_ctx, ac->store->expr);
+		if (tree == NULL) {
+			talloc_free(tmp_ctx);
+			ldb_set_errstring(ldb, "Out of Memory");
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+
+		while (ac->store->next_dn < ac->store->num_dns &&
+		       ac->size > 0) {
+			struct ldb_message *fetched = NULL;
+			TALLOC_CTX *msg_ctx;
+
+			msg_ctx = talloc_new(tmp_ctx);
+			if (msg_ctx == NULL) {
+				talloc_free(tmp_ctx);
+				return LDB_ERR_OPERATIONS_ERROR;
+			}
+
+			ret = paged_fetch_dn(ac, msg_ctx, tree,
+					     ac->store->dns[ac->store->next_dn],
+					     &fetched);
+			if (ret != LDB_SUCCESS) {
+				talloc_free(tmp_ctx);
+				return ret;
+			}
+			talloc_free(ac->store->dns[ac->store->next_dn]);
+			ac->store->dns[ac->store->next_dn] = NULL;
+			ac->store->next_dn++;
+
+			if (fetched == NULL) {
+				talloc_free(msg_ctx);
+				continue;
+			}
+
+			ret = ldb_module_send_entry(ac->req, fetched, NULL);
+			if (ret != LDB_SUCCESS) {
+				talloc_free(tmp_ctx);
+				return ret;
+			}
+			talloc_free(msg_ctx);
+			ac->size--;
+		}
+
+		talloc_free(tmp_ctx);
+	}
+
 	while (ac->store->num_entries > 0 && ac->size > 0) {
 		msg = ac->store->first;
 		ret = ldb_module_send_entry(ac->req, msg->r->message, msg->r->controls);
@@ -217,7 +345,11 @@ static int paged_results(struct paged_context *ac)
 		paged->cookie = NULL;
 		paged->cookie_len = 0;
 	} else {
-		paged->size = ac->store->num_entries;
+		if (ac->store->use_dn_list) {
+			paged->size = ac->store->num_dns - ac->store->next_dn;
+		} else {
+			paged->size = ac->store->num_entries;
+		}
 		paged->cookie = talloc_strdup(paged, ac->store->cookie);
 		paged->cookie_len = strlen(paged->cookie) + 1;
 	}
@@ -244,6 +376,38 @@ static int paged_search_callback(struct ldb_request *req, struct ldb_reply *ares
 
 	switch (ares->type) {
 	case LDB_REPLY_ENTRY:
+		if (ac->store->use_dn_list) {
+			/* only remember the dn, the entry is fetched
+			 * again when its page goes out */
+			if ((ac->store->num_dns % PAGED_DN_ALLOC_BLOCK) == 0) {
+				struct ldb_dn **dns;
+
+				dns = talloc_realloc(ac->store,
+						ac->store->dns,
+						struct ldb_dn *,
+						ac->store->num_dns
+						+ PAGED_DN_ALLOC_BLOCK);
+				if (dns == NULL) {
+					return ldb_module_done(ac->req,
+						NULL, NULL,
+						LDB_ERR_OPERATIONS_ERROR);
+				}
+				ac->store->dns = dns;
+			}
+
+			ac->store->dns[ac->store->num_dns] =
+				ldb_dn_copy(ac->store->dns,
+					    ares->message->dn);
+			if (ac->store->dns[ac->store->num_dns] == NULL) {
+				return ldb_module_done(ac->req, NULL, NULL,
+							LDB_ERR_OPERATIONS_ERROR);
+			}
+			ac->store->num_dns++;
+
+			talloc_free(ares);
+			break;
+		}
+
 		msg_store = talloc(ac->store, struct message_store);
 		if (msg_store == NULL) {
 			return ldb_module_done(ac->req, NULL, NULL,
@@ -300,6 +464,7 @@ static int paged_search(struct ldb_module *module, struct ldb_request *req)
 	struct ldb_control **saved_controls;
 	struct ldb_request *search_req;
 	struct paged_context *ac;
+	unsigned int i;
 	int ret;
 
 	ldb = ldb_module_get_ctx(module);
@@ -345,6 +510,33 @@ static int paged_search(struct ldb_module *module, struct ldb_request *req)
 			return LDB_ERR_OPERATIONS_ERROR;
 		}
 
+		/* count the controls on the request */
+		for (i = 0; req->controls && req->controls[i]; i++) /* noop */;
+
+		/*
+		 * If the paged control is the only one we can replay
+		 * the search per entry later and need to store just
+		 * the dns. With any other control present we cannot
+		 * reproduce the original semantics on the per-entry
+		 * searches, so keep the complete messages as before.
+		 */
+		if (i == 1) {
+			ac->store->expr = ldb_filter_from_tree(ac->store,
+							req->op.search.tree);
+			if (ac->store->expr == NULL) {
+				return LDB_ERR_OPERATIONS_ERROR;
+			}
+			if (req->op.search.attrs != NULL) {
+				ac->store->attrs =
+					ldb_attr_list_copy(ac->store,
+							req->op.search.attrs);
+				if (ac->store->attrs == NULL) {
+					return LDB_ERR_OPERATIONS_ERROR;
+				}
+			}
+			ac->store->use_dn_list = true;
+		}
+
 		ret = ldb_build_search_req_ex(&search_req, ldb, ac,
 						req->op.search.base,
 						req->op.search.scope,
@@ -3696,6 +3696,14 @@ struct parm_struct parm_table[] = {
 		.special	= NULL,
 		.enum_list	= NULL,
 	},
+	{
+		.label		= "winbind cache stale time",
+		.type		= P_INTEGER,
+		.p_class	= P_GLOBAL,
+		.offset		= GLOBAL_VAR(winbind_cache_stale_time),
+		.special	= NULL,
+		.enum_list	= NULL,
+	},
 	{
 		.label		= "winbind reconnect delay",
 		.type		= P_INTEGER,
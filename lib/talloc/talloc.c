@@ -125,6 +125,129 @@ static struct {
 
 #define TALLOC_FILL_ENV "TALLOC_FREE_FILL"
 
+/*
+ * Opt-in sampling heap profiler. When TALLOC_PROFILE is set to a
+ * sample interval N, every allocation is counted and every Nth named
+ * allocation records its callsite; the result is printed to stderr at
+ * exit. This is cheap enough to use on production processes where
+ * valgrind/massif are not an option.
+ */
+#define TALLOC_PROFILE_ENV "TALLOC_PROFILE"
+#define TALLOC_PROFILE_SITES 512 /* must be a power of two */
+#define TALLOC_PROFILE_PROBES 8
+#define TALLOC_PROFILE_TOP 20
+
+static struct {
+	bool initialised;
+	bool enabled;
+	unsigned int interval;
+	unsigned int countdown;
+	uint64_t total_allocs;
+	uint64_t total_bytes;
+	uint64_t missed_samples;
+	time_t start_time;
+	struct {
+		const char *name;
+		uint64_t count;
+	} sites[TALLOC_PROFILE_SITES];
+} talloc_profile;
+
+static void talloc_profile_report(void)
+{
+	time_t elapsed = time(NULL) - talloc_profile.start_time;
+	unsigned int i, j;
+
+	if (elapsed < 1) {
+		elapsed = 1;
+	}
+
+	fprintf(stderr, "talloc profile (pid %u): %llu allocations, "
+		"%llu bytes, %llu allocations/sec over %llu seconds\n",
+		(unsigned)getpid(),
+		(unsigned long long)talloc_profile.total_allocs,
+		(unsigned long long)talloc_profile.total_bytes,
+		(unsigned long long)(talloc_profile.total_allocs / elapsed),
+		(unsigned long long)elapsed);
+	fprintf(stderr, "hot callsites (sampled every %u allocations, "
+		"counts scaled back up):\n", talloc_profile.interval);
+
+	for (i = 0; i < TALLOC_PROFILE_TOP; i++) {
+		unsigned int best = TALLOC_PROFILE_SITES;
+		uint64_t best_count = 0;
+
+		for (j = 0; j < TALLOC_PROFILE_SITES; j++) {
+			if (talloc_profile.sites[j].count > best_count) {
+				best = j;
+				best_count = talloc_profile.sites[j].count;
+			}
+		}
+		if (best == TALLOC_PROFILE_SITES) {
+			break;
+		}
+		fprintf(stderr, "  %12llu  %s\n",
+			(unsigned long long)(best_count *
+					     talloc_profile.interval),
+			talloc_profile.sites[best].name);
+		talloc_profile.sites[best].count = 0;
+	}
+
+	if (talloc_profile.missed_samples != 0) {
+		fprintf(stderr, "  %llu samples dropped (site table full)\n",
+			(unsigned long long)talloc_profile.missed_samples);
+	}
+}
+
+static void talloc_profile_init(void)
+{
+	const char *interval = getenv(TALLOC_PROFILE_ENV);
+
+	talloc_profile.initialised = true;
+
+	if (interval == NULL) {
+		return;
+	}
+	talloc_profile.interval = strtoul(interval, NULL, 0);
+	if (talloc_profile.interval == 0) {
+		return;
+	}
+	talloc_profile.countdown = talloc_profile.interval;
+	talloc_profile.start_time = time(NULL);
+	talloc_profile.enabled = true;
+	atexit(talloc_profile_report);
+}
+
+static inline void talloc_profile_sample_name(const char *name)
+{
+	unsigned int hash, i;
+
+	if (likely(--talloc_profile.countdown != 0)) {
+		return;
+	}
+	talloc_profile.countdown = talloc_profile.interval;
+
+	/*
+	 * Callsite names are almost always __location__ or type name
+	 * string literals, so pointer identity is a good enough key.
+	 * The same header callsite may appear once per object file,
+	 * but that only splits its count, it never misattributes it.
+	 */
+	hash = (unsigned int)(((size_t)name) >> 4);
+	for (i = 0; i < TALLOC_PROFILE_PROBES; i++) {
+		unsigned int slot = (hash + i) & (TALLOC_PROFILE_SITES - 1);
+
+		if (talloc_profile.sites[slot].name == name) {
+			talloc_profile.sites[slot].count++;
+			return;
+		}
+		if (talloc_profile.sites[slot].name == NULL) {
+			talloc_profile.sites[slot].name = name;
+			talloc_profile.sites[slot].count = 1;
+			return;
+		}
+	}
+	talloc_profile.missed_samples++;
+}
+
 /*
  * do not wipe the header, to allow the
  * double-free logic to still work
@@ -579,6 +702,15 @@ static inline void *__talloc_with_prefix(const void *context, size_t size,
 	struct talloc_memlimit *limit = NULL;
 	size_t total_len = TC_HDR_SIZE + size + prefix_len;
 
+	/* possibly initialise the allocation profiler */
+	if (unlikely(!talloc_profile.initialised)) {
+		talloc_profile_init();
+	}
+	if (unlikely(talloc_profile.enabled)) {
+		talloc_profile.total_allocs++;
+		talloc_profile.total_bytes += size;
+	}
+
 	if (unlikely(context == NULL)) {
 		context = null_context;
 	}
@@ -800,6 +932,9 @@ static inline void _talloc_set_name_const(const void *ptr, const char *name)
 {
 	struct talloc_chunk *tc = talloc_chunk_from_ptr(ptr);
 	tc->name = name;
+	if (unlikely(talloc_profile.enabled)) {
+		talloc_profile_sample_name(name);
+	}
 }
 
 /*
@@ -624,9 +624,19 @@ tdb_off_t tdb_allocate(struct tdb_context *tdb, int hash, tdb_len_t length,
 	 * Be aware that we do nonblocking locks on the other hash chains as
 	 * well and fail gracefully. This way we avoid deadlocks (we block two
 	 * hash chains, something which is pretty bad normally)
+	 *
+	 * The scan is bounded: when many processes allocate at the same
+	 * time and few chains carry stealable dead records (e.g. a burst
+	 * of fresh stores right after startup), walking all of hash_size
+	 * chains means tens of thousands of nonblocking lock attempts per
+	 * allocation, which only adds to the contention we're trying to
+	 * avoid. After a handful of failed steals, queueing for the
+	 * freelist lock is cheaper.
 	 */
 
-	for (i=0; i<tdb->hash_size; i++) {
+#define TDB_FREELIST_STEAL_LIMIT 16
+
+	for (i=0; i<tdb->hash_size && i<TDB_FREELIST_STEAL_LIMIT; i++) {
 
 		int list;
 
@@ -661,6 +671,13 @@ blocking_freelist_allocate:
 	if (tdb_lock(tdb, -1, F_WRLCK) == -1) {
 		return 0;
 	}
+	/*
+	 * Since we have the freelist lock anyway, give back our dead
+	 * records just as the nonblocking path above does.
+	 */
+	if (tdb->max_dead_records != 0) {
+		tdb_purge_dead(tdb, hash);
+	}
 	ret = tdb_allocate_from_freelist(tdb, length, rec);
 	tdb_unlock(tdb, -1, F_WRLCK);
 	return ret;
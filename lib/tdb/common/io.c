@@ -75,6 +75,17 @@ static int tdb_ftruncate(struct tdb_context *tdb, off_t length)
 	return ftruncate(tdb->fd, length);
 }
 
+#ifdef HAVE_POSIX_FALLOCATE
+static int tdb_posix_fallocate(struct tdb_context *tdb, off_t offset,
+			       off_t len)
+{
+	if (!tdb_adjust_offset(tdb, &offset)) {
+		return EINVAL;
+	}
+	return posix_fallocate(tdb->fd, offset, len);
+}
+#endif
+
 static int tdb_fstat(struct tdb_context *tdb, struct stat *buf)
 {
 	int ret;
@@ -373,6 +384,33 @@ static int tdb_expand_file(struct tdb_context *tdb, tdb_off_t size, tdb_off_t ad
 		return -1;
 	}
 
+#ifdef HAVE_POSIX_FALLOCATE
+	{
+		int ret = tdb_posix_fallocate(tdb, size, addition);
+		if (ret == 0) {
+			return 0;
+		}
+		if (ret == ENOSPC) {
+			/*
+			 * The disk is just full. posix_fallocate does
+			 * not leave a grown file behind in this case.
+			 */
+			tdb->ecode = TDB_ERR_OOM;
+			errno = ENOSPC;
+			return -1;
+		}
+		/*
+		 * Any other error (EINTR, or EOPNOTSUPP from a file
+		 * system without preallocation support): take the
+		 * ftruncate/write path below. That path grows and
+		 * fills the file in 8k chunks, which can stall every
+		 * other writer for a long time on a big database, so
+		 * preallocating in one syscall is very much
+		 * preferred.
+		 */
+	}
+#endif
+
 	if (tdb_ftruncate(tdb, new_size) == -1) {
 		char b = 0;
 		ssize_t written = tdb_pwrite(tdb, &b, 1, new_size - 1);
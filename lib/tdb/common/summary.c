@@ -35,8 +35,13 @@
 	"Smallest/average/largest hash chains: %zu/%zu/%zu\n" \
 	"Number of uncoalesced records: %zu\n" \
 	"Smallest/average/largest uncoalesced runs: %zu/%zu/%zu\n" \
+	"Hash chains of length 0/1/2/3/4/5-8/9-16/>16: %zu/%zu/%zu/%zu/%zu/%zu/%zu/%zu\n" \
+	"Free records of size <64/<256/<1k/<4k/<16k/<64k/>=64k: %zu/%zu/%zu/%zu/%zu/%zu/%zu\n" \
 	"Percentage keys/data/padding/free/dead/rechdrs&tailers/hashes: %.0f/%.0f/%.0f/%.0f/%.0f/%.0f/%.0f\n"
 
+#define CHAIN_HIST_BUCKETS 8
+#define FREE_HIST_BUCKETS 7
+
 /* We don't use tally module, to keep upstream happy. */
 struct tally {
 	size_t min, max, total;
@@ -69,6 +74,31 @@ static size_t tally_mean(const struct tally *tally)
 	return tally->total / tally->num;
 }
 
+/* buckets: 0,1,2,3,4,5-8,9-16,>16 */
+static unsigned int chain_hist_bucket(size_t len)
+{
+	if (len <= 4)
+		return len;
+	if (len <= 8)
+		return 5;
+	if (len <= 16)
+		return 6;
+	return CHAIN_HIST_BUCKETS - 1;
+}
+
+/* buckets: <64,<256,<1k,<4k,<16k,<64k,>=64k */
+static unsigned int free_hist_bucket(size_t len)
+{
+	size_t limit = 64;
+	unsigned int bucket = 0;
+
+	while (bucket < FREE_HIST_BUCKETS - 1 && len >= limit) {
+		limit <<= 2;
+		bucket++;
+	}
+	return bucket;
+}
+
 static size_t get_hash_length(struct tdb_context *tdb, unsigned int i)
 {
 	tdb_off_t rec_ptr;
@@ -93,6 +123,8 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 	off_t file_size;
 	tdb_off_t off, rec_off;
 	struct tally freet, keys, data, dead, extra, hashval, uncoal;
+	size_t chain_hist[CHAIN_HIST_BUCKETS];
+	size_t free_hist[FREE_HIST_BUCKETS];
 	struct tdb_record rec;
 	char *ret = NULL;
 	bool locked;
@@ -121,6 +153,8 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 	tally_init(&extra);
 	tally_init(&hashval);
 	tally_init(&uncoal);
+	memset(chain_hist, 0, sizeof(chain_hist));
+	memset(free_hist, 0, sizeof(free_hist));
 
 	for (off = TDB_DATA_START(tdb->hash_size);
 	     off < tdb->map_size - 1;
@@ -140,6 +174,7 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 			break;
 		case TDB_FREE_MAGIC:
 			tally_add(&freet, rec.rec_len);
+			free_hist[free_hist_bucket(rec.rec_len)]++;
 			unc++;
 			break;
 		/* If we crash after ftruncate, we can get zeroes or fill. */
@@ -165,8 +200,11 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 	if (unc > 1)
 		tally_add(&uncoal, unc - 1);
 
-	for (off = 0; off < tdb->hash_size; off++)
-		tally_add(&hashval, get_hash_length(tdb, off));
+	for (off = 0; off < tdb->hash_size; off++) {
+		size_t hash_length = get_hash_length(tdb, off);
+		tally_add(&hashval, hash_length);
+		chain_hist[chain_hist_bucket(hash_length)]++;
+	}
 
 	file_size = tdb->hdr_ofs + tdb->map_size;
 
@@ -188,6 +226,10 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 		 hashval.min, tally_mean(&hashval), hashval.max,
 		 uncoal.total,
 		 uncoal.min, tally_mean(&uncoal), uncoal.max,
+		 chain_hist[0], chain_hist[1], chain_hist[2], chain_hist[3],
+		 chain_hist[4], chain_hist[5], chain_hist[6], chain_hist[7],
+		 free_hist[0], free_hist[1], free_hist[2], free_hist[3],
+		 free_hist[4], free_hist[5], free_hist[6],
 		 keys.total * 100.0 / file_size,
 		 data.total * 100.0 / file_size,
 		 extra.total * 100.0 / file_size,
@@ -1060,6 +1060,7 @@ static bool repack_worthwhile(struct tdb_context *tdb)
 _PUBLIC_ int tdb_transaction_commit(struct tdb_context *tdb)
 {
 	const struct tdb_methods *methods;
+	tdb_len_t dirty_top = 0;
 	int i;
 	bool need_repack = false;
 
@@ -1127,6 +1128,8 @@ _PUBLIC_ int tdb_transaction_commit(struct tdb_context *tdb)
 			return -1;
 		}
 		SAFE_FREE(tdb->transaction->blocks[i]);
+
+		dirty_top = offset + length;
 	}
 
 	/* Do this before we drop lock or blocks. */
@@ -1137,8 +1140,13 @@ _PUBLIC_ int tdb_transaction_commit(struct tdb_context *tdb)
 	SAFE_FREE(tdb->transaction->blocks);
 	tdb->transaction->num_blocks = 0;
 
-	/* ensure the new data is on disk */
-	if (transaction_sync(tdb, 0, tdb->map_size) == -1) {
+	/*
+	 * Ensure the new data is on disk. All changes lie below the
+	 * end of the last touched block, so it is enough to msync up
+	 * to there instead of the whole mapping - a small transaction
+	 * on a big database otherwise pays for a scan of the full map.
+	 */
+	if (transaction_sync(tdb, 0, dirty_top) == -1) {
 		return -1;
 	}
 
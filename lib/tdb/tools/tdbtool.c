@@ -59,6 +59,7 @@ enum commands {
 	CMD_INFO,
 	CMD_MMAP,
 	CMD_SPEED,
+	CMD_LOCKWAIT,
 	CMD_FIRST,
 	CMD_NEXT,
 	CMD_SYSTEM,
@@ -93,6 +94,7 @@ COMMAND_TABLE cmd_table[] = {
 	{"freelist_size",	CMD_FREELIST_SIZE},
 	{"info",	CMD_INFO},
 	{"speed",	CMD_SPEED},
+	{"lockwait",	CMD_LOCKWAIT},
 	{"mmap",	CMD_MMAP},
 	{"first",	CMD_FIRST},
 	{"1",		CMD_FIRST},
@@ -238,6 +240,7 @@ static void help(void)
 "  check                : check the integrity of an opened database\n"
 "  repack               : repack the database\n"
 "  speed                : perform speed tests on the database\n"
+"  lockwait  [samples]  : profile chain lock wait times\n"
 "  ! command            : execute system command\n"
 "  1 | first            : print the first record\n"
 "  n | next             : print the next record\n"
@@ -542,6 +545,119 @@ static void speed_tdb(const char *tlimit)
 	printf("%10.3f ops/sec\n", ops/t);
 }
 
+struct lockwait_sample_state {
+	unsigned int stride;
+	unsigned int seen;
+	unsigned int num_keys;
+	unsigned int max_keys;
+	TDB_DATA *keys;
+};
+
+static int lockwait_sample_fn(TDB_CONTEXT *the_tdb, TDB_DATA key,
+			      TDB_DATA dbuf, void *state)
+{
+	struct lockwait_sample_state *s =
+		(struct lockwait_sample_state *)state;
+	unsigned char *p;
+
+	if ((s->seen++ % s->stride) != 0) {
+		return 0;
+	}
+	if (s->num_keys >= s->max_keys) {
+		return 0;
+	}
+
+	p = (unsigned char *)malloc(key.dsize);
+	if (!p) {
+		return 1;
+	}
+	memcpy(p, key.dptr, key.dsize);
+	s->keys[s->num_keys].dptr = p;
+	s->keys[s->num_keys].dsize = key.dsize;
+	s->num_keys++;
+	return 0;
+}
+
+/* Measure how long it takes to win the chain lock for a sample of the
+   keys in the database. On a database opened with mutexes this contends
+   on the real in-file mutexes, so the result reflects what other
+   processes currently attached to the database are doing. */
+static void lockwait_tdb(const char *arg)
+{
+	unsigned int max_samples = arg?atoi(arg):0;
+	unsigned int hist[6]; /* <1us <10us <100us <1ms <10ms >=10ms */
+	struct lockwait_sample_state s;
+	double total = 0.0, max_wait = 0.0;
+	unsigned int i;
+	int nrecs;
+
+	if (max_samples == 0) {
+		max_samples = 1000;
+	}
+
+	nrecs = tdb_traverse(tdb, NULL, NULL);
+	if (nrecs <= 0) {
+		printf("database has no records\n");
+		return;
+	}
+
+	memset(&s, 0, sizeof(s));
+	s.max_keys = max_samples;
+	if ((unsigned int)nrecs < s.max_keys) {
+		s.max_keys = nrecs;
+	}
+	s.stride = nrecs / s.max_keys;
+	s.keys = (TDB_DATA *)calloc(s.max_keys, sizeof(TDB_DATA));
+	if (!s.keys) {
+		terror("calloc failed");
+		return;
+	}
+
+	if (tdb_traverse(tdb, lockwait_sample_fn, &s) < 0) {
+		terror("traverse failed");
+	}
+
+	memset(hist, 0, sizeof(hist));
+	for (i = 0; i < s.num_keys; i++) {
+		double t, limit;
+		unsigned int bucket;
+
+		_start_timer();
+		if (tdb_chainlock(tdb, s.keys[i]) != 0) {
+			terror("chainlock failed");
+			break;
+		}
+		t = _end_timer();
+		tdb_chainunlock(tdb, s.keys[i]);
+
+		total += t;
+		if (t > max_wait) {
+			max_wait = t;
+		}
+		limit = 1.0e-6;
+		for (bucket = 0; bucket < 5; bucket++) {
+			if (t < limit) {
+				break;
+			}
+			limit *= 10.0;
+		}
+		hist[bucket]++;
+	}
+
+	if (i > 0) {
+		printf("%u chain locks sampled, avg/max wait %.1f/%.1f usec\n",
+		       i, total * 1.0e6 / i, max_wait * 1.0e6);
+		printf("wait <1us:%u <10us:%u <100us:%u "
+		       "<1ms:%u <10ms:%u >=10ms:%u\n",
+		       hist[0], hist[1], hist[2], hist[3], hist[4], hist[5]);
+	}
+
+	for (i = 0; i < s.num_keys; i++) {
+		free(s.keys[i].dptr);
+	}
+	free(s.keys);
+}
+
 static void toggle_mmap(void)
 {
 	disable_mmap = !disable_mmap;
@@ -731,6 +847,9 @@ static int do_command(void)
 		case CMD_SPEED:
 			speed_tdb(arg1);
 			return 0;
+		case CMD_LOCKWAIT:
+			lockwait_tdb(arg1);
+			return 0;
 		case CMD_MMAP:
 			toggle_mmap();
 			return 0;
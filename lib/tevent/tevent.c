@@ -359,6 +359,16 @@ void tevent_fd_set_flags(struct tevent_fd *fde, uint16_t flags)
 	fde->event_ctx->ops->set_fd_flags(fde, flags);
 }
 
+/*
+  set the fd event dispatch priority
+*/
+void tevent_fd_set_priority(struct tevent_fd *fde,
+			    enum tevent_priority priority)
+{
+	if (!fde) return;
+	fde->priority = priority;
+}
+
 bool tevent_signal_support(struct tevent_context *ev)
 {
 	if (ev->ops->add_signal) {
@@ -422,12 +432,20 @@ struct tevent_immediate *_tevent_create_immediate(TALLOC_CTX *mem_ctx,
 	im->private_data	= NULL;
 	im->handler_name	= NULL;
 	im->schedule_location	= NULL;
+	im->priority		= TEVENT_PRIORITY_NORMAL;
 	im->cancel_fn		= NULL;
 	im->additional_data	= NULL;
 
 	return im;
 }
 
+void tevent_immediate_set_priority(struct tevent_immediate *im,
+				   enum tevent_priority priority)
+{
+	if (!im) return;
+	im->priority = priority;
+}
+
 /*
   schedule an immediate event
 */
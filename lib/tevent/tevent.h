@@ -250,6 +250,23 @@ struct tevent_timer *_tevent_add_timer(struct tevent_context *ev,
 			  #handler, __location__)
 #endif
 
+/**
+ * Dispatch priority of fd and immediate events.
+ *
+ * Events of a higher priority (lower value) are dispatched before
+ * ready events of a lower priority. Within one priority events keep
+ * their FIFO order, and the dispatcher bounds how often lower
+ * priorities can be overtaken, so bulk events still make progress
+ * under a flood of high priority work.
+ *
+ * @note Available as of tevent 0.9.26
+ */
+enum tevent_priority {
+	TEVENT_PRIORITY_HIGH	= 0,
+	TEVENT_PRIORITY_NORMAL	= 1,
+	TEVENT_PRIORITY_BULK	= 2
+};
+
 #ifdef DOXYGEN
 /**
  * Initialize an immediate event object
@@ -300,6 +317,21 @@ void _tevent_schedule_immediate(struct tevent_immediate *im,
 				   #handler, __location__);
 #endif
 
+/**
+ * Set the dispatch priority of an immediate event object
+ *
+ * The priority sticks to the object across reuse, set it once after
+ * tevent_create_immediate. The default is TEVENT_PRIORITY_NORMAL,
+ * which behaves exactly as before priorities existed.
+ *
+ * @param[in] im       The tevent_immediate object
+ * @param[in] priority The priority class to dispatch it under
+ *
+ * @note Available as of tevent 0.9.26
+ */
+void tevent_immediate_set_priority(struct tevent_immediate *im,
+				   enum tevent_priority priority);
+
 #ifdef DOXYGEN
 /**
  * @brief Add a tevent signal handler
@@ -430,6 +462,21 @@ void tevent_fd_set_close_fn(struct tevent_fd *fde,
  */
 void tevent_fd_set_auto_close(struct tevent_fd *fde);
 
+/**
+ * Set the dispatch priority of a file descriptor event
+ *
+ * When several fds are ready at the same time, higher priority fdes
+ * get their handlers called first. The default is
+ * TEVENT_PRIORITY_NORMAL.
+ *
+ * @param[in] fde      File descriptor event to prioritize
+ * @param[in] priority The priority class to dispatch it under
+ *
+ * @note Available as of tevent 0.9.26
+ */
+void tevent_fd_set_priority(struct tevent_fd *fde,
+			    enum tevent_priority priority);
+
 /**
  * Return the flags set on this file descriptor event
  *
@@ -1648,6 +1695,72 @@ void tevent_queue_stop(struct tevent_queue *queue);
  */
 size_t tevent_queue_length(struct tevent_queue *queue);
 
+/**
+ * @brief Account payload bytes for a queue entry
+ *
+ * A queue by itself only counts entries. Callers queueing I/O can
+ * additionally report how many payload bytes an entry represents, so
+ * that watermark callbacks can be based on the amount of buffered
+ * data instead of the entry count. The bytes are subtracted again
+ * when the entry leaves the queue.
+ *
+ * @param[in]  entry    The queue entry as returned by
+ *                      tevent_queue_add_entry().
+ *
+ * @param[in]  bytes    The number of payload bytes of this entry.
+ *
+ * @see tevent_queue_set_watermarks()
+ */
+void tevent_queue_entry_set_bytes(struct tevent_queue_entry *entry,
+				  size_t bytes);
+
+/**
+ * @brief Get the number of accounted payload bytes in a queue
+ *
+ * @param[in]  queue    The queue.
+ *
+ * @return              The sum of the bytes reported via
+ *                      tevent_queue_entry_set_bytes() for all pending
+ *                      entries.
+ */
+size_t tevent_queue_bytes(struct tevent_queue *queue);
+
+typedef void (*tevent_queue_watermark_fn_t)(struct tevent_queue *queue,
+					    bool above_high,
+					    void *private_data);
+
+/**
+ * @brief Install low/high watermark callbacks on a queue
+ *
+ * The callback is invoked with above_high=true when the accounted
+ * bytes of the queue grow to the high watermark or beyond, and with
+ * above_high=false when they have drained back to the low watermark
+ * or below. A transport can use this to stop reading from a fast
+ * producer while a slow consumer has too much data queued.
+ *
+ * Note that the above_high=false call may happen from within a talloc
+ * destructor of a queue entry.
+ *
+ * Passing fn=NULL removes the watermark callbacks again.
+ *
+ * @param[in]  queue        The queue.
+ *
+ * @param[in]  low_bytes    Drain threshold for the above_high=false call.
+ *
+ * @param[in]  high_bytes   Growth threshold for the above_high=true call.
+ *
+ * @param[in]  fn           The callback to invoke on both crossings.
+ *
+ * @param[in]  private_data Pointer handed to the callback.
+ *
+ * @see tevent_queue_entry_set_bytes()
+ */
+void tevent_queue_set_watermarks(struct tevent_queue *queue,
+				 size_t low_bytes,
+				 size_t high_bytes,
+				 tevent_queue_watermark_fn_t fn,
+				 void *private_data);
+
 /**
  * @brief Is the tevent queue running.
  *
@@ -1722,6 +1835,66 @@ int tevent_re_initialise(struct tevent_context *ev);
 
 /* @} */
 
+/**
+ * @defgroup tevent_profile Handler dispatch profiling
+ * @ingroup tevent
+ *
+ * When profiling is enabled on a tevent context, the run time of
+ * every fd, timer and immediate handler is recorded into a log2
+ * histogram, together with the slowest handler seen. This makes it
+ * cheap to spot what stalls an event loop in production without
+ * attaching a debugger.
+ *
+ * @note Available as of tevent 0.9.26
+ * @{
+ */
+
+/*
+ * Bucket i counts handler invocations that ran for less than
+ * 2^i microseconds, the last bucket counts everything slower.
+ */
+#define TEVENT_PROFILE_NUM_BUCKETS 21
+
+struct tevent_profile {
+	/* number of handler invocations recorded */
+	uint64_t num_events;
+	/* log2 histogram over handler run times in microseconds */
+	uint64_t buckets[TEVENT_PROFILE_NUM_BUCKETS];
+	/* the slowest handler seen since enable/reset */
+	const char *max_handler_name;
+	const char *max_handler_location;
+	uint64_t max_usec;
+};
+
+/**
+ * Enable or disable handler profiling on an event context
+ *
+ * Disabled contexts don't pay for the two gettimeofday calls per
+ * handler. Enabling implicitly resets the collected statistics.
+ *
+ * @param[in] ev      The event context
+ * @param[in] enable  Whether to collect dispatch statistics
+ */
+void tevent_set_profiling(struct tevent_context *ev, bool enable);
+
+/**
+ * Fetch a copy of the collected dispatch statistics
+ *
+ * @param[in]  ev       The event context
+ * @param[out] profile  Gets the statistics collected so far
+ */
+void tevent_get_profile(struct tevent_context *ev,
+			struct tevent_profile *profile);
+
+/**
+ * Zero the collected dispatch statistics, keep collecting
+ *
+ * @param[in] ev  The event context
+ */
+void tevent_reset_profile(struct tevent_context *ev);
+
+/* @} */
+
 /**
  * @defgroup tevent_ops The tevent operation functions
  * @ingroup tevent
@@ -32,6 +32,8 @@
 #include "tevent_internal.h"
 #include "tevent_util.h"
 
+#define EPOLL_BATCH_SIZE 64
+
 struct epoll_event_context {
 	/* a pointer back to the generic event_context */
 	struct tevent_context *ev;
@@ -44,6 +46,19 @@ struct epoll_event_context {
 	bool panic_force_replay;
 	bool *panic_state;
 	bool (*panic_fallback)(struct tevent_context *ev, bool replay);
+
+	/*
+	 * Events reaped from the kernel but not yet dispatched. We
+	 * pull up to EPOLL_BATCH_SIZE events out of one epoll_wait()
+	 * call and hand out one handler invocation per loop pass, so
+	 * under load we pay one syscall per batch instead of one per
+	 * ready fd. Queued entries are re-validated against the fde
+	 * flags before dispatch and cleared when their fde is
+	 * destroyed, as handlers may change both behind our back.
+	 */
+	struct epoll_event batch[EPOLL_BATCH_SIZE];
+	unsigned int batch_count;
+	unsigned int batch_idx;
 };
 
 #define EPOLL_ADDITIONAL_FD_FLAG_HAS_EVENT	(1<<0)
@@ -229,6 +244,13 @@ static void epoll_check_reopen(struct epoll_event_context *epoll_ev)
 		return;
 	}
 
+	/*
+	 * The events we reaped belong to the parent's connections,
+	 * drop them.
+	 */
+	epoll_ev->batch_count = 0;
+	epoll_ev->batch_idx = 0;
+
 	close(epoll_ev->epoll_fd);
 	epoll_ev->epoll_fd = epoll_create(64);
 	if (epoll_ev->epoll_fd == -1) {
@@ -617,14 +639,153 @@ static bool epoll_handle_hup_or_err(struct epoll_event_context *epoll_ev,
 	return false;
 }
 
+/*
+  dispatch a single reaped epoll event. Returns -1 on panic, 1 if a
+  handler was called and 0 if the event turned out to be a no-op.
+*/
+static int epoll_event_dispatch(struct epoll_event_context *epoll_ev,
+				struct epoll_event *event)
+{
+	struct tevent_fd *fde = talloc_get_type(event->data.ptr,
+					       struct tevent_fd);
+	uint16_t flags = 0;
+	struct tevent_fd *mpx_fde = NULL;
+
+	if (fde == NULL) {
+		epoll_panic(epoll_ev, "epoll_wait() gave bad data", true);
+		return -1;
+	}
+	if (fde->additional_flags & EPOLL_ADDITIONAL_FD_FLAG_HAS_MPX) {
+		/*
+		 * Save off the multiplexed event in case we need
+		 * to use it to call the handler function.
+		 */
+		mpx_fde = talloc_get_type_abort(fde->additional_data,
+						struct tevent_fd);
+	}
+	if (event->events & (EPOLLHUP|EPOLLERR)) {
+		bool handled_fde = epoll_handle_hup_or_err(epoll_ev, fde);
+		bool handled_mpx = epoll_handle_hup_or_err(epoll_ev, mpx_fde);
+
+		if (handled_fde && handled_mpx) {
+			epoll_update_event(epoll_ev, fde);
+			return 0;
+		}
+
+		if (!handled_mpx) {
+			/*
+			 * If the mpx event was the one that needs
+			 * further handling, it's the TEVENT_FD_READ
+			 * event so switch over and call that handler.
+			 */
+			fde = mpx_fde;
+			mpx_fde = NULL;
+		}
+		flags |= TEVENT_FD_READ;
+	}
+	if (event->events & EPOLLIN) flags |= TEVENT_FD_READ;
+	if (event->events & EPOLLOUT) flags |= TEVENT_FD_WRITE;
+
+	if (flags & TEVENT_FD_WRITE) {
+		if (fde->flags & TEVENT_FD_WRITE) {
+			mpx_fde = NULL;
+		}
+		if (mpx_fde && mpx_fde->flags & TEVENT_FD_WRITE) {
+			fde = mpx_fde;
+			mpx_fde = NULL;
+		}
+	}
+
+	if (mpx_fde) {
+		/* Ensure we got the right fde. */
+		if ((flags & fde->flags) == 0) {
+			fde = mpx_fde;
+			mpx_fde = NULL;
+		}
+	}
+
+	/*
+	 * make sure we only pass the flags
+	 * the handler is expecting.
+	 */
+	flags &= fde->flags;
+	if (flags) {
+		/* the handler may free fde, capture the debug info now */
+		const char *handler_name = fde->handler_name;
+		const char *location = fde->location;
+		struct timeval start;
+
+		tevent_common_profile_start(epoll_ev->ev, &start);
+		fde->handler(epoll_ev->ev, fde, flags, fde->private_data);
+		tevent_common_profile_end(epoll_ev->ev, &start,
+					  handler_name, location);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+  dispatch the next usable event reaped earlier. Higher priority fdes
+  go first, within one priority entries keep epoll_wait() return
+  order. The batch is fully drained before the next epoll_wait(), so
+  a flood of high priority events cannot starve the rest of its
+  batch.
+*/
+static int epoll_event_drain(struct epoll_event_context *epoll_ev)
+{
+	while (epoll_ev->batch_idx < epoll_ev->batch_count) {
+		struct epoll_event *event =
+			&epoll_ev->batch[epoll_ev->batch_idx];
+		unsigned int i, best = epoll_ev->batch_idx;
+		uint8_t best_prio = UINT8_MAX;
+		int ret;
+
+		/* pick the best priority entry still pending */
+		for (i = epoll_ev->batch_idx;
+		     i < epoll_ev->batch_count;
+		     i++) {
+			struct tevent_fd *fde = talloc_get_type(
+				epoll_ev->batch[i].data.ptr,
+				struct tevent_fd);
+
+			if (fde == NULL) {
+				continue;
+			}
+			if (fde->priority < best_prio) {
+				best = i;
+				best_prio = fde->priority;
+			}
+		}
+
+		if (best != epoll_ev->batch_idx) {
+			struct epoll_event tmp = *event;
+			*event = epoll_ev->batch[best];
+			epoll_ev->batch[best] = tmp;
+		}
+
+		epoll_ev->batch_idx += 1;
+
+		if (event->data.ptr == NULL) {
+			/* fde went away since we reaped the event */
+			continue;
+		}
+
+		ret = epoll_event_dispatch(epoll_ev, event);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
 /*
   event loop handling using epoll
 */
 static int epoll_event_loop(struct epoll_event_context *epoll_ev, struct timeval *tvalp)
 {
-	int ret, i;
-#define MAXEVENTS 1
-	struct epoll_event events[MAXEVENTS];
+	int ret;
 	int timeout = -1;
 	int wait_errno;
 
@@ -638,8 +799,18 @@ static int epoll_event_loop(struct epoll_event_context *epoll_ev, struct timeval
 		return 0;
 	}
 
+	/*
+	 * Work down events we already have from the kernel before
+	 * doing another syscall.
+	 */
+	ret = epoll_event_drain(epoll_ev);
+	if (ret != 0) {
+		return (ret < 0) ? -1 : 0;
+	}
+
 	tevent_trace_point_callback(epoll_ev->ev, TEVENT_TRACE_BEFORE_WAIT);
-	ret = epoll_wait(epoll_ev->epoll_fd, events, MAXEVENTS, timeout);
+	ret = epoll_wait(epoll_ev->epoll_fd, epoll_ev->batch,
+			 EPOLL_BATCH_SIZE, timeout);
 	wait_errno = errno;
 	tevent_trace_point_callback(epoll_ev->ev, TEVENT_TRACE_AFTER_WAIT);
 
@@ -660,74 +831,14 @@ static int epoll_event_loop(struct epoll_event_context *epoll_ev, struct timeval
 		return 0;
 	}
 
-	for (i=0;i<ret;i++) {
-		struct tevent_fd *fde = talloc_get_type(events[i].data.ptr, 
-						       struct tevent_fd);
-		uint16_t flags = 0;
-		struct tevent_fd *mpx_fde = NULL;
+	if (ret > 0) {
+		epoll_ev->batch_count = ret;
+		epoll_ev->batch_idx = 0;
 
-		if (fde == NULL) {
-			epoll_panic(epoll_ev, "epoll_wait() gave bad data", true);
+		ret = epoll_event_drain(epoll_ev);
+		if (ret < 0) {
 			return -1;
 		}
-		if (fde->additional_flags & EPOLL_ADDITIONAL_FD_FLAG_HAS_MPX) {
-			/*
-			 * Save off the multiplexed event in case we need
-			 * to use it to call the handler function.
-			 */
-			mpx_fde = talloc_get_type_abort(fde->additional_data,
-							struct tevent_fd);
-		}
-		if (events[i].events & (EPOLLHUP|EPOLLERR)) {
-			bool handled_fde = epoll_handle_hup_or_err(epoll_ev, fde);
-			bool handled_mpx = epoll_handle_hup_or_err(epoll_ev, mpx_fde);
-
-			if (handled_fde && handled_mpx) {
-				epoll_update_event(epoll_ev, fde);
-				continue;
-			}
-
-			if (!handled_mpx) {
-				/*
-				 * If the mpx event was the one that needs
-				 * further handling, it's the TEVENT_FD_READ
-				 * event so switch over and call that handler.
-				 */
-				fde = mpx_fde;
-				mpx_fde = NULL;
-			}
-			flags |= TEVENT_FD_READ;
-		}
-		if (events[i].events & EPOLLIN) flags |= TEVENT_FD_READ;
-		if (events[i].events & EPOLLOUT) flags |= TEVENT_FD_WRITE;
-
-		if (flags & TEVENT_FD_WRITE) {
-			if (fde->flags & TEVENT_FD_WRITE) {
-				mpx_fde = NULL;
-			}
-			if (mpx_fde && mpx_fde->flags & TEVENT_FD_WRITE) {
-				fde = mpx_fde;
-				mpx_fde = NULL;
-			}
-		}
-
-		if (mpx_fde) {
-			/* Ensure we got the right fde. */
-			if ((flags & fde->flags) == 0) {
-				fde = mpx_fde;
-				mpx_fde = NULL;
-			}
-		}
-
-		/*
-		 * make sure we only pass the flags
-		 * the handler is expecting.
-		 */
-		flags &= fde->flags;
-		if (flags) {
-			fde->handler(epoll_ev->ev, fde, flags, fde->private_data);
-			break;
-		}
 	}
 
 	return 0;
@@ -772,6 +883,7 @@ static int epoll_event_fd_destructor(struct tevent_fd *fde)
 	bool panic_triggered = false;
 	struct tevent_fd *mpx_fde = NULL;
 	int flags = fde->flags;
+	unsigned int i;
 
 	if (ev == NULL) {
 		return tevent_common_fd_destructor(fde);
@@ -787,6 +899,16 @@ static int epoll_event_fd_destructor(struct tevent_fd *fde)
 	 */
 	DLIST_REMOVE(ev->fd_events, fde);
 
+	/*
+	 * Invalidate reaped but not yet dispatched events pointing at
+	 * this fde, they would dereference freed memory.
+	 */
+	for (i = epoll_ev->batch_idx; i < epoll_ev->batch_count; i++) {
+		if (epoll_ev->batch[i].data.ptr == fde) {
+			epoll_ev->batch[i].data.ptr = NULL;
+		}
+	}
+
 	if (fde->additional_flags & EPOLL_ADDITIONAL_FD_FLAG_HAS_MPX) {
 		mpx_fde = talloc_get_type_abort(fde->additional_data,
 						struct tevent_fd);
@@ -68,6 +68,7 @@ struct tevent_fd *tevent_common_add_fd(struct tevent_context *ev, TALLOC_CTX *me
 	fde->private_data	= private_data;
 	fde->handler_name	= handler_name;
 	fde->location		= location;
+	fde->priority		= TEVENT_PRIORITY_NORMAL;
 	fde->additional_flags	= 0;
 	fde->additional_data	= NULL;
 
@@ -97,7 +97,13 @@ void tevent_common_schedule_immediate(struct tevent_immediate *im,
 }
 
 /*
-  trigger the first immediate event and return true
+ * How often the head of the queue may be overtaken by higher
+ * priority events before it gets dispatched regardless.
+ */
+#define TEVENT_IMMEDIATE_MAX_SKIPS 16
+
+/*
+  trigger the next immediate event and return true
   if no event was triggered return false
 */
 bool tevent_common_loop_immediate(struct tevent_context *ev)
@@ -105,11 +111,35 @@ bool tevent_common_loop_immediate(struct tevent_context *ev)
 	struct tevent_immediate *im = ev->immediate_events;
 	tevent_immediate_handler_t handler;
 	void *private_data;
+	const char *handler_name;
+	const char *schedule_location;
+	struct timeval start;
 
 	if (!im) {
 		return false;
 	}
 
+	/*
+	 * Dispatch the oldest event of the best priority class
+	 * present. The skip counter makes sure a steady stream of
+	 * high priority events cannot starve the rest of the queue.
+	 */
+	if (ev->immediate_skips < TEVENT_IMMEDIATE_MAX_SKIPS) {
+		struct tevent_immediate *cur;
+
+		for (cur = im->next; cur != NULL; cur = cur->next) {
+			if (cur->priority < im->priority) {
+				im = cur;
+			}
+		}
+	}
+
+	if (im != ev->immediate_events) {
+		ev->immediate_skips += 1;
+	} else {
+		ev->immediate_skips = 0;
+	}
+
 	tevent_debug(ev, TEVENT_DEBUG_TRACE,
 		     "Run immediate event \"%s\": %p\n",
 		     im->handler_name, im);
@@ -120,6 +150,8 @@ bool tevent_common_loop_immediate(struct tevent_context *ev)
 	 */
 	handler = im->handler;
 	private_data = im->private_data;
+	handler_name = im->handler_name;
+	schedule_location = im->schedule_location;
 
 	DLIST_REMOVE(im->event_ctx->immediate_events, im);
 	im->event_ctx		= NULL;
@@ -132,7 +164,10 @@ bool tevent_common_loop_immediate(struct tevent_context *ev)
 
 	talloc_set_destructor(im, NULL);
 
+	tevent_common_profile_start(ev, &start);
 	handler(ev, im, private_data);
+	tevent_common_profile_end(ev, &start, handler_name,
+				  schedule_location);
 
 	return true;
 }
@@ -179,6 +179,8 @@ struct tevent_fd {
 	/* this is for debugging only! */
 	const char *handler_name;
 	const char *location;
+	/* dispatch preference, see enum tevent_priority */
+	uint8_t priority;
 	/* this is private for the events_ops implementation */
 	uint64_t additional_flags;
 	void *additional_data;
@@ -208,6 +210,8 @@ struct tevent_immediate {
 	const char *handler_name;
 	const char *create_location;
 	const char *schedule_location;
+	/* dispatch preference, see enum tevent_priority */
+	uint8_t priority;
 	/* this is private for the events_ops implementation */
 	void (*cancel_fn)(struct tevent_immediate *im);
 	void *additional_data;
@@ -250,6 +254,12 @@ struct tevent_context {
 	/* list of immediate events - used by common code */
 	struct tevent_immediate *immediate_events;
 
+	/*
+	 * how often a high priority immediate has jumped the queue,
+	 * bounded to avoid starving lower priorities
+	 */
+	unsigned int immediate_skips;
+
 	/* list of signal events - used by common code */
 	struct tevent_signal *signal_events;
 
@@ -276,6 +286,12 @@ struct tevent_context {
 		void *private_data;
 	} tracing;
 
+	/* handler dispatch statistics, see tevent_set_profiling() */
+	struct {
+		bool enabled;
+		struct tevent_profile stats;
+	} profile;
+
 	/*
 	 * an optimization pointer into timer_events
 	 * used by used by common code via
@@ -328,6 +344,13 @@ void tevent_common_schedule_immediate(struct tevent_immediate *im,
 				      const char *location);
 bool tevent_common_loop_immediate(struct tevent_context *ev);
 
+void tevent_common_profile_start(struct tevent_context *ev,
+				 struct timeval *start);
+void tevent_common_profile_end(struct tevent_context *ev,
+			       const struct timeval *start,
+			       const char *handler_name,
+			       const char *location);
+
 struct tevent_signal *tevent_common_add_signal(struct tevent_context *ev,
 					       TALLOC_CTX *mem_ctx,
 					       int signum,
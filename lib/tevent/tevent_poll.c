@@ -598,8 +598,16 @@ static int poll_event_loop_poll(struct tevent_context *ev,
 		 */
 		flags &= fde->flags;
 		if (flags != 0) {
+			/* the handler may free fde */
+			const char *handler_name = fde->handler_name;
+			const char *location = fde->location;
+			struct timeval start;
+
 			DLIST_DEMOTE(ev->fd_events, fde, struct tevent_fd);
+			tevent_common_profile_start(ev, &start);
 			fde->handler(ev, fde, flags, fde->private_data);
+			tevent_common_profile_end(ev, &start,
+						  handler_name, location);
 			return 0;
 		}
 	}
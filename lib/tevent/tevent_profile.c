@@ -0,0 +1,96 @@
+/*
+   Unix SMB/CIFS implementation.
+
+   handler dispatch profiling for the tevent library
+
+   Copyright (C) Volker Lendecke 2015
+
+     ** NOTE! The following LGPL license applies to the tevent
+     ** library. This does NOT imply that all of Samba is released
+     ** under the LGPL
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replace.h"
+#include "tevent.h"
+#include "tevent_internal.h"
+#include "tevent_util.h"
+
+void tevent_set_profiling(struct tevent_context *ev, bool enable)
+{
+	if (enable && !ev->profile.enabled) {
+		ZERO_STRUCT(ev->profile.stats);
+	}
+	ev->profile.enabled = enable;
+}
+
+void tevent_get_profile(struct tevent_context *ev,
+			struct tevent_profile *profile)
+{
+	*profile = ev->profile.stats;
+}
+
+void tevent_reset_profile(struct tevent_context *ev)
+{
+	ZERO_STRUCT(ev->profile.stats);
+}
+
+void tevent_common_profile_start(struct tevent_context *ev,
+				 struct timeval *start)
+{
+	if (!ev->profile.enabled) {
+		return;
+	}
+	*start = tevent_timeval_current();
+}
+
+void tevent_common_profile_end(struct tevent_context *ev,
+			       const struct timeval *start,
+			       const char *handler_name,
+			       const char *location)
+{
+	struct tevent_profile *stats = &ev->profile.stats;
+	struct timeval diff;
+	uint64_t usec;
+	size_t idx;
+
+	if (!ev->profile.enabled) {
+		return;
+	}
+
+	diff = tevent_timeval_current();
+	if (tevent_timeval_compare(&diff, start) < 0) {
+		/* wall clock stepped backwards under us */
+		usec = 0;
+	} else {
+		usec = (uint64_t)(diff.tv_sec - start->tv_sec) * 1000000 +
+			(diff.tv_usec - start->tv_usec);
+	}
+
+	idx = 0;
+	while ((idx < (TEVENT_PROFILE_NUM_BUCKETS-1)) &&
+	       (usec >= (UINT64_C(1) << idx))) {
+		idx += 1;
+	}
+
+	stats->num_events += 1;
+	stats->buckets[idx] += 1;
+
+	if (usec > stats->max_usec) {
+		stats->max_usec = usec;
+		stats->max_handler_name = handler_name;
+		stats->max_handler_location = location;
+	}
+}
@@ -38,6 +38,8 @@ struct tevent_queue_entry {
 
 	tevent_queue_trigger_fn_t trigger;
 	void *private_data;
+
+	size_t bytes;
 };
 
 struct tevent_queue {
@@ -49,8 +51,38 @@ struct tevent_queue {
 
 	size_t length;
 	struct tevent_queue_entry *list;
+
+	size_t num_bytes;
+
+	struct {
+		size_t low;
+		size_t high;
+		bool above_high;
+		tevent_queue_watermark_fn_t fn;
+		void *private_data;
+	} watermark;
 };
 
+static void tevent_queue_watermark_check(struct tevent_queue *q)
+{
+	if (q->watermark.fn == NULL) {
+		return;
+	}
+
+	if (!q->watermark.above_high &&
+	    (q->num_bytes >= q->watermark.high)) {
+		q->watermark.above_high = true;
+		q->watermark.fn(q, true, q->watermark.private_data);
+		return;
+	}
+
+	if (q->watermark.above_high &&
+	    (q->num_bytes <= q->watermark.low)) {
+		q->watermark.above_high = false;
+		q->watermark.fn(q, false, q->watermark.private_data);
+	}
+}
+
 static void tevent_queue_immediate_trigger(struct tevent_context *ev,
 					   struct tevent_immediate *im,
 					   void *private_data);
@@ -65,6 +97,9 @@ static int tevent_queue_entry_destructor(struct tevent_queue_entry *e)
 
 	DLIST_REMOVE(q->list, e);
 	q->length--;
+	q->num_bytes -= e->bytes;
+
+	tevent_queue_watermark_check(q);
 
 	if (!q->running) {
 		return 0;
@@ -299,6 +334,42 @@ size_t tevent_queue_length(struct tevent_queue *queue)
 	return queue->length;
 }
 
+void tevent_queue_entry_set_bytes(struct tevent_queue_entry *entry,
+				  size_t bytes)
+{
+	struct tevent_queue *q = entry->queue;
+
+	if (q == NULL) {
+		return;
+	}
+
+	q->num_bytes -= entry->bytes;
+	q->num_bytes += bytes;
+	entry->bytes = bytes;
+
+	tevent_queue_watermark_check(q);
+}
+
+size_t tevent_queue_bytes(struct tevent_queue *queue)
+{
+	return queue->num_bytes;
+}
+
+void tevent_queue_set_watermarks(struct tevent_queue *queue,
+				 size_t low_bytes,
+				 size_t high_bytes,
+				 tevent_queue_watermark_fn_t fn,
+				 void *private_data)
+{
+	queue->watermark.low = low_bytes;
+	queue->watermark.high = high_bytes;
+	queue->watermark.above_high = false;
+	queue->watermark.fn = fn;
+	queue->watermark.private_data = private_data;
+
+	tevent_queue_watermark_check(queue);
+}
+
 bool tevent_queue_running(struct tevent_queue *queue)
 {
 	return queue->running;
@@ -63,6 +63,18 @@ struct tevent_req *_tevent_req_create(TALLOC_CTX *mem_ctx,
 	void **ppdata = (void **)pdata;
 	void *data;
 
+	/*
+	 * The req, its trigger immediate and the caller's state
+	 * struct are carved out of one pooled chunk, so creating a
+	 * request costs a single malloc no matter how deeply the
+	 * *_send calls nest. Recycling these chunks across requests
+	 * via a freelist does not work under talloc: the caller owns
+	 * the req through its mem_ctx hierarchy, may steal or
+	 * reparent it, and frees it whenever the hierarchy goes, so
+	 * there is no point where we could safely reclaim the memory
+	 * ourselves. Same-sized chunks get recycled by the system
+	 * allocator's fast bins anyway.
+	 */
 	req = talloc_pooled_object(
 		mem_ctx, struct tevent_req, 2,
 		sizeof(struct tevent_immediate) + data_size);
@@ -219,8 +219,19 @@ static int select_event_loop_select(struct select_event_context *select_ev, stru
 				flags |= TEVENT_FD_WRITE;
 			}
 			if (flags) {
+				/* the handler may free fde */
+				const char *handler_name = fde->handler_name;
+				const char *location = fde->location;
+				struct timeval start;
+
 				DLIST_DEMOTE(select_ev->ev->fd_events, fde, struct tevent_fd);
+				tevent_common_profile_start(select_ev->ev,
+							    &start);
 				fde->handler(select_ev->ev, fde, flags, fde->private_data);
+				tevent_common_profile_end(select_ev->ev,
+							  &start,
+							  handler_name,
+							  location);
 				break;
 			}
 		}
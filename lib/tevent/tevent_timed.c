@@ -338,7 +338,14 @@ struct timeval tevent_common_loop_timer_delay(struct tevent_context *ev)
 	 *
 	 * otherwise we pass the current time
 	 */
-	te->handler(ev, te, current_time, te->private_data);
+	{
+		struct timeval profile_start;
+
+		tevent_common_profile_start(ev, &profile_start);
+		te->handler(ev, te, current_time, te->private_data);
+		tevent_common_profile_end(ev, &profile_start,
+					  te->handler_name, te->location);
+	}
 
 	/* The destructor isn't necessary anymore, we've already removed the
 	 * event from the list. */
@@ -1740,10 +1740,18 @@ static ssize_t tstream_bsd_pending_bytes(struct tstream_context *stream)
 	return ret;
 }
 
+/*
+ * Almost all callers pass only very few iovec elements, so keep a
+ * small inline array in the state and only talloc a copy for the
+ * rare larger vectors. This saves an allocation per readv/writev.
+ */
+#define TSTREAM_BSD_SMALL_IOV 8
+
 struct tstream_bsd_readv_state {
 	struct tstream_context *stream;
 
 	struct iovec *vector;
+	struct iovec small_vector[TSTREAM_BSD_SMALL_IOV];
 	size_t count;
 
 	int ret;
@@ -1780,9 +1788,13 @@ static struct tevent_req *tstream_bsd_readv_send(TALLOC_CTX *mem_ctx,
 
 	state->stream	= stream;
 	/* we make a copy of the vector so that we can modify it */
-	state->vector	= talloc_array(state, struct iovec, count);
-	if (tevent_req_nomem(state->vector, req)) {
-		goto post;
+	if (count <= ARRAY_SIZE(state->small_vector)) {
+		state->vector = state->small_vector;
+	} else {
+		state->vector = talloc_array(state, struct iovec, count);
+		if (tevent_req_nomem(state->vector, req)) {
+			goto post;
+		}
 	}
 	memcpy(state->vector, vector, sizeof(struct iovec)*count);
 	state->count	= count;
@@ -1897,6 +1909,7 @@ struct tstream_bsd_writev_state {
 	struct tstream_context *stream;
 
 	struct iovec *vector;
+	struct iovec small_vector[TSTREAM_BSD_SMALL_IOV];
 	size_t count;
 
 	int ret;
@@ -1933,9 +1946,13 @@ static struct tevent_req *tstream_bsd_writev_send(TALLOC_CTX *mem_ctx,
 
 	state->stream	= stream;
 	/* we make a copy of the vector so that we can modify it */
-	state->vector	= talloc_array(state, struct iovec, count);
-	if (tevent_req_nomem(state->vector, req)) {
-		goto post;
+	if (count <= ARRAY_SIZE(state->small_vector)) {
+		state->vector = state->small_vector;
+	} else {
+		state->vector = talloc_array(state, struct iovec, count);
+		if (tevent_req_nomem(state->vector, req)) {
+			goto post;
+		}
 	}
 	memcpy(state->vector, vector, sizeof(struct iovec)*count);
 	state->count	= count;
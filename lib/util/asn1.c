@@ -27,14 +27,42 @@ struct nesting {
 };
 
 
+/*
+ * The tokens we care about (SPNEGO, GSS-API, LDAP) only ever nest a
+ * handful of levels deep, so keep a few nesting records embedded in
+ * the asn1 structure itself. This makes tag descent allocation-free
+ * for the common case; only pathologically deep packets fall back to
+ * talloc.
+ */
+#define ASN1_INLINE_NESTING 8
+
 struct asn1_data {
 	uint8_t *data;
 	size_t length;
 	off_t ofs;
 	struct nesting *nesting;
 	bool has_error;
+	unsigned int depth;
+	struct nesting inline_nesting[ASN1_INLINE_NESTING];
 };
 
+static struct nesting *asn1_nesting_alloc(struct asn1_data *data)
+{
+	if (data->depth < ASN1_INLINE_NESTING) {
+		return &data->inline_nesting[data->depth];
+	}
+	return talloc(data, struct nesting);
+}
+
+static void asn1_nesting_free(struct asn1_data *data, struct nesting *nesting)
+{
+	if ((nesting >= &data->inline_nesting[0]) &&
+	    (nesting < &data->inline_nesting[ASN1_INLINE_NESTING])) {
+		return;
+	}
+	talloc_free(nesting);
+}
+
 /* allocate an asn1 structure */
 struct asn1_data *asn1_init(TALLOC_CTX *mem_ctx)
 {
@@ -110,7 +138,7 @@ bool asn1_push_tag(struct asn1_data *data, uint8_t tag)
 	if (!asn1_write_uint8(data, tag)) {
 		return false;
 	}
-	nesting = talloc(data, struct nesting);
+	nesting = asn1_nesting_alloc(data);
 	if (!nesting) {
 		data->has_error = true;
 		return false;
@@ -119,6 +147,7 @@ bool asn1_push_tag(struct asn1_data *data, uint8_t tag)
 	nesting->start = data->ofs;
 	nesting->next = data->nesting;
 	data->nesting = nesting;
+	data->depth++;
 	return asn1_write_uint8(data, 0xff);
 }
 
@@ -179,7 +208,8 @@ bool asn1_pop_tag(struct asn1_data *data)
 	}
 
 	data->nesting = nesting->next;
-	talloc_free(nesting);
+	data->depth--;
+	asn1_nesting_free(data, nesting);
 	return true;
 }
 
@@ -621,7 +651,7 @@ bool asn1_start_tag(struct asn1_data *data, uint8_t tag)
 		data->has_error = true;
 		return false;
 	}
-	nesting = talloc(data, struct nesting);
+	nesting = asn1_nesting_alloc(data);
 	if (!nesting) {
 		data->has_error = true;
 		return false;
@@ -648,6 +678,7 @@ bool asn1_start_tag(struct asn1_data *data, uint8_t tag)
 	nesting->start = data->ofs;
 	nesting->next = data->nesting;
 	data->nesting = nesting;
+	data->depth++;
 	if (asn1_tag_remaining(data) == -1) {
 		return false;
 	}
@@ -673,7 +704,8 @@ bool asn1_end_tag(struct asn1_data *data)
 	}
 
 	data->nesting = nesting->next;
-	talloc_free(nesting);
+	data->depth--;
+	asn1_nesting_free(data, nesting);
 	return true;
 }
 
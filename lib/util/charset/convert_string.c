@@ -139,6 +139,29 @@ bool convert_string_error_handle(struct smb_iconv_handle *ic,
 		unsigned char lastp = '\0';
 		size_t retval = 0;
 
+		/*
+		 * Bulk classification of 8 bytes at a time. A word with
+		 * neither a high bit nor a zero byte is pure ASCII and can
+		 * be copied wholesale; anything else drops to the byte
+		 * loop below. Compilers vectorize this into wide loads on
+		 * their own.
+		 */
+		while ((slen != (size_t)-1) && (slen >= 8) && (dlen >= 8)) {
+			uint64_t v;
+			memcpy(&v, p, 8);
+			if (((v & 0x8080808080808080ULL) != 0) ||
+			    ((((v - 0x0101010101010101ULL) & ~v) &
+			      0x8080808080808080ULL) != 0)) {
+				break;
+			}
+			memcpy(q, &v, 8);
+			p += 8;
+			q += 8;
+			slen -= 8;
+			dlen -= 8;
+			retval += 8;
+		}
+
 		/* If all characters are ascii, fast path here. */
 		while (slen && dlen) {
 			if ((lastp = *p) <= 0x7f) {
@@ -195,6 +218,32 @@ bool convert_string_error_handle(struct smb_iconv_handle *ic,
 			}
 			if (lastp != 0) goto slow_path;
 		} else {
+			/*
+			 * Bulk classification of 4 UTF16 units at a time.
+			 * The mask passes only units of the form
+			 * 0x0000-0x007f, which pack to single bytes.
+			 */
+#ifdef WORDS_BIGENDIAN
+			const uint64_t non_ascii_mask = 0x80ff80ff80ff80ffULL;
+#else
+			const uint64_t non_ascii_mask = 0xff80ff80ff80ff80ULL;
+#endif
+			while ((slen >= 8) && (dlen >= 4)) {
+				uint64_t v;
+				memcpy(&v, p, 8);
+				if ((v & non_ascii_mask) != 0) {
+					break;
+				}
+				q[0] = p[0];
+				q[1] = p[2];
+				q[2] = p[4];
+				q[3] = p[6];
+				q += 4;
+				p += 8;
+				slen -= 8;
+				dlen -= 4;
+				retval += 4;
+			}
 			while (slen >= 2 && dlen &&
 			       (*p <= 0x7f) && (p[1] == 0)) {
 				*q++ = *p;
@@ -238,6 +287,33 @@ bool convert_string_error_handle(struct smb_iconv_handle *ic,
 		size_t dlen = destlen;
 		unsigned char lastp = '\0';
 
+		/*
+		 * Bulk classification of 4 bytes at a time; every word
+		 * free of high bits and zero bytes widens to 4 ASCII
+		 * UTF16 units.
+		 */
+		while ((slen != (size_t)-1) && (slen >= 4) && (dlen >= 8)) {
+			uint32_t v;
+			memcpy(&v, p, 4);
+			if (((v & 0x80808080) != 0) ||
+			    ((((v - 0x01010101) & ~v) & 0x80808080) != 0)) {
+				break;
+			}
+			q[0] = p[0];
+			q[1] = '\0';
+			q[2] = p[1];
+			q[3] = '\0';
+			q[4] = p[2];
+			q[5] = '\0';
+			q[6] = p[3];
+			q[7] = '\0';
+			q += 8;
+			p += 4;
+			slen -= 4;
+			dlen -= 8;
+			retval += 8;
+		}
+
 		/* If all characters are ascii, fast path here. */
 		while (slen && (dlen >= 1)) {
 			if (dlen >=2 && (lastp = *p) <= 0x7F) {
@@ -29,6 +29,31 @@
 #undef strcasecmp
 #endif
 
+/*
+ * Precomputed case folding for the ASCII range, so the comparison hot
+ * loops below need neither a codepoint walk nor a locale aware
+ * toupper() call per character. Anything with the high bit set drops
+ * to the full codepoint loop.
+ */
+static const unsigned char upcase_ascii[128] = {
+	0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
+	0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f,
+	0x10,0x11,0x12,0x13,0x14,0x15,0x16,0x17,
+	0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x1e,0x1f,
+	0x20,0x21,0x22,0x23,0x24,0x25,0x26,0x27,
+	0x28,0x29,0x2a,0x2b,0x2c,0x2d,0x2e,0x2f,
+	0x30,0x31,0x32,0x33,0x34,0x35,0x36,0x37,
+	0x38,0x39,0x3a,0x3b,0x3c,0x3d,0x3e,0x3f,
+	0x40,0x41,0x42,0x43,0x44,0x45,0x46,0x47,
+	0x48,0x49,0x4a,0x4b,0x4c,0x4d,0x4e,0x4f,
+	0x50,0x51,0x52,0x53,0x54,0x55,0x56,0x57,
+	0x58,0x59,0x5a,0x5b,0x5c,0x5d,0x5e,0x5f,
+	0x60,0x41,0x42,0x43,0x44,0x45,0x46,0x47,
+	0x48,0x49,0x4a,0x4b,0x4c,0x4d,0x4e,0x4f,
+	0x50,0x51,0x52,0x53,0x54,0x55,0x56,0x57,
+	0x58,0x59,0x5a,0x7b,0x7c,0x7d,0x7e,0x7f
+};
+
 /**
  Case insensitive string compararison, handle specified for testing
 **/
@@ -43,6 +68,20 @@ _PUBLIC_ int strcasecmp_m_handle(struct smb_iconv_handle *iconv_handle,
 	if (s1 == NULL) return -1;
 	if (s2 == NULL) return 1;
 
+	/* fast path while both strings stay in the ASCII range */
+	while ((((unsigned char)*s1) < 0x80) &&
+	       (((unsigned char)*s2) < 0x80)) {
+		if (upcase_ascii[(unsigned char)*s1] !=
+		    upcase_ascii[(unsigned char)*s2]) {
+			return (unsigned char)*s1 - (unsigned char)*s2;
+		}
+		if (*s1 == '\0') {
+			return 0;
+		}
+		s1++;
+		s2++;
+	}
+
 	while (*s1 && *s2) {
 		c1 = next_codepoint_handle(iconv_handle, s1, &size1);
 		c2 = next_codepoint_handle(iconv_handle, s2, &size2);
@@ -90,6 +129,21 @@ _PUBLIC_ int strncasecmp_m_handle(struct smb_iconv_handle *iconv_handle,
 	if (s1 == NULL) return -1;
 	if (s2 == NULL) return 1;
 
+	/* fast path while both strings stay in the ASCII range */
+	while (n && (((unsigned char)*s1) < 0x80) &&
+	       (((unsigned char)*s2) < 0x80)) {
+		if (upcase_ascii[(unsigned char)*s1] !=
+		    upcase_ascii[(unsigned char)*s2]) {
+			return (unsigned char)*s1 - (unsigned char)*s2;
+		}
+		if (*s1 == '\0') {
+			return 0;
+		}
+		n--;
+		s1++;
+		s2++;
+	}
+
 	while (*s1 && *s2 && n) {
 		n--;
 
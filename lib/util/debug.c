@@ -143,9 +143,102 @@ static void debug_file_log(int msg_level,
 	write(state.fd, msg, strlen(msg));
 }
 
+/*
+ * Log to an in-memory ring buffer instead of doing I/O per message.
+ * This decouples the cost of verbose diagnostic levels from the file
+ * write path; the accumulated messages are dumped from smb_panic() so
+ * a crash still carries the recent history.
+ */
+#define RINGBUF_SIZE (1024 * 1024)
+
+static char *debug_ringbuf;
+static size_t debug_ringbuf_size;
+static size_t debug_ringbuf_ofs;
+static unsigned int debug_ringbuf_wraps;
+static unsigned int debug_ringbuf_drops;
+
+static void debug_ringbuf_reload(bool enabled, bool previously_enabled,
+				 const char *prog_name, char *option)
+{
+	size_t buf_size = RINGBUF_SIZE;
+
+	debug_ringbuf_size = 0;
+	debug_ringbuf_ofs = 0;
+	debug_ringbuf_wraps = 0;
+	debug_ringbuf_drops = 0;
+	SAFE_FREE(debug_ringbuf);
+
+	if (!enabled) {
+		return;
+	}
+
+	if (option != NULL) {
+		size_t opt_size;
+
+		if (sscanf(option, "size=%zu", &opt_size) == 1) {
+			buf_size = opt_size;
+		}
+	}
+
+	debug_ringbuf = calloc(buf_size, sizeof(char));
+	if (debug_ringbuf == NULL) {
+		return;
+	}
+	debug_ringbuf_size = buf_size;
+}
+
+static void debug_ringbuf_log(int msg_level, const char *msg,
+			      const char *msg_no_nl)
+{
+	size_t allowed_size;
+	size_t msglen = strlen(msg);
+
+	if (debug_ringbuf == NULL) {
+		return;
+	}
+
+	/* Ensure the buffer is always NUL terminated */
+	allowed_size = debug_ringbuf_size - 1;
+
+	if (msglen > allowed_size) {
+		debug_ringbuf_drops += 1;
+		return;
+	}
+
+	if ((debug_ringbuf_ofs + msglen) > allowed_size) {
+		/* wrap and overwrite the oldest messages */
+		memset(debug_ringbuf, '\0', debug_ringbuf_size);
+		debug_ringbuf_ofs = 0;
+		debug_ringbuf_wraps += 1;
+	}
+
+	memcpy(debug_ringbuf + debug_ringbuf_ofs, msg, msglen);
+	debug_ringbuf_ofs += msglen;
+}
+
+char *debug_get_ringbuf(void)
+{
+	return debug_ringbuf;
+}
+
+size_t debug_get_ringbuf_size(void)
+{
+	return debug_ringbuf_size;
+}
+
+unsigned int debug_get_ringbuf_wraps(void)
+{
+	return debug_ringbuf_wraps;
+}
+
+unsigned int debug_get_ringbuf_drops(void)
+{
+	return debug_ringbuf_drops;
+}
+
 #ifdef WITH_SYSLOG
 static void debug_syslog_reload(bool enabled, bool previously_enabled,
-				const char *prog_name)
+				const char *prog_name, char *option)
 {
 	if (enabled && !previously_enabled) {
 #ifdef LOG_DAEMON
@@ -203,7 +296,7 @@ static void debug_lttng_log(int msg_level,
 #ifdef HAVE_GPFS
 #include "gpfswrap.h"
 static void debug_gpfs_reload(bool enabled, bool previously_enabled,
-			      const char *prog_name)
+			      const char *prog_name, char *option)
 {
 	gpfswrap_init();
 
@@ -236,13 +329,20 @@ static struct debug_backend {
 	const char *name;
 	int log_level;
 	int new_log_level;
-	void (*reload)(bool enabled, bool prev_enabled, const char *prog_name);
+	void (*reload)(bool enabled, bool prev_enabled, const char *prog_name,
+		       char *option);
 	void (*log)(int msg_level, const char *msg, const char *msg_no_nl);
+	char *option;
 } debug_backends[] = {
 	{
 		.name = "file",
 		.log = debug_file_log,
 	},
+	{
+		.name = "ringbuf",
+		.log = debug_ringbuf_log,
+		.reload = debug_ringbuf_reload,
+	},
 #ifdef WITH_SYSLOG
 	{
 		.name = "syslog",
@@ -293,6 +393,7 @@ static struct debug_backend *debug_find_backend(const char *name)
 static void debug_backend_parse_token(char *tok)
 {
 	char *backend_name_option, *backend_name,*backend_level, *saveptr;
+	char *backend_option;
 	struct debug_backend *b;
 
 	/*
@@ -313,12 +414,7 @@ static void debug_backend_parse_token(char *tok)
 		return;
 	}
 
-	/*
-	 * No backend is using the option yet.
-	 */
-#if 0
 	backend_option = strtok_r(NULL, "\0", &saveptr);
-#endif
 
 	/*
 	 * Find and update backend
@@ -333,6 +429,14 @@ static void debug_backend_parse_token(char *tok)
 	} else {
 		b->new_log_level = atoi(backend_level);
 	}
+
+	if (backend_option != NULL) {
+		SAFE_FREE(b->option);
+		b->option = strdup(backend_option);
+		if (b->option == NULL) {
+			return;
+		}
+	}
 }
 
 /*
@@ -376,7 +480,8 @@ static void debug_set_backends(const char *param)
 			bool enabled = b->new_log_level > -1;
 			bool previously_enabled = b->log_level > -1;
 
-			b->reload(enabled, previously_enabled, state.prog_name);
+			b->reload(enabled, previously_enabled, state.prog_name,
+				  b->option);
 		}
 		b->log_level = b->new_log_level;
 	}
@@ -266,6 +266,12 @@ bool debug_get_output_is_stdout(void);
 void debug_schedule_reopen_logs(void);
 char *debug_list_class_names_and_levels(void);
 
+/* the "ringbuf" logging backend, dumped from smb_panic() */
+char *debug_get_ringbuf(void);
+size_t debug_get_ringbuf_size(void);
+unsigned int debug_get_ringbuf_wraps(void);
+unsigned int debug_get_ringbuf_drops(void);
+
 typedef void (*debug_callback_fn)(void *private_ptr, int level, const char *msg);
 
 /**
@@ -123,6 +123,8 @@ _PUBLIC_ const char *panic_action = NULL;
 static void smb_panic_default(const char *why) _NORETURN_;
 static void smb_panic_default(const char *why)
 {
+	char *ringbuf = debug_get_ringbuf();
+
 #if defined(HAVE_PRCTL) && defined(PR_SET_PTRACER)
 	/*
 	 * Make sure all children can attach a debugger.
@@ -150,6 +152,19 @@ static void smb_panic_default(const char *why)
 	}
 	DEBUG(0,("PANIC: %s\n", why));
 
+	if (ringbuf != NULL) {
+		/*
+		 * With the "ringbuf" logging backend the diagnostic
+		 * messages never hit the disk; write them out now so
+		 * the crash carries the recent history.
+		 */
+		DEBUG(0,("PANIC: log ring buffer dump "
+			 "(%u wraps, %u oversized messages dropped):\n",
+			 debug_get_ringbuf_wraps(),
+			 debug_get_ringbuf_drops()));
+		dbgtext("%s", ringbuf);
+	}
+
 #ifdef SIGABRT
 	CatchSignal(SIGABRT, SIG_DFL);
 #endif
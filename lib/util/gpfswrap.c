@@ -35,6 +35,10 @@ static int (*gpfs_get_winattrs_fn)(int fd, struct gpfs_winattr *attrs);
 static int (*gpfs_prealloc_fn)(int fd, gpfs_off64_t start, gpfs_off64_t bytes);
 static int (*gpfs_ftruncate_fn)(int fd, gpfs_off64_t length);
 static int (*gpfs_lib_init_fn)(int flags);
+static int (*gpfs_statlite_fn)(const char *pathname, unsigned int *litemask,
+			       struct stat64 *buf);
+static int (*gpfs_lstatlite_fn)(const char *pathname, unsigned int *litemask,
+				struct stat64 *buf);
 static int (*gpfs_set_times_path_fn)(char *pathname, int flags,
 				     gpfs_timestruc_t times[4]);
 static int (*gpfs_quotactl_fn)(char *pathname, int cmd, int id, void *bufp);
@@ -68,6 +72,8 @@ int gpfswrap_init(void)
 	gpfs_prealloc_fn	      = dlsym(l, "gpfs_prealloc");
 	gpfs_ftruncate_fn	      = dlsym(l, "gpfs_ftruncate");
 	gpfs_lib_init_fn	      = dlsym(l, "gpfs_lib_init");
+	gpfs_statlite_fn	      = dlsym(l, "gpfs_statlite");
+	gpfs_lstatlite_fn	      = dlsym(l, "gpfs_lstatlite");
 	gpfs_set_times_path_fn	      = dlsym(l, "gpfs_set_times_path");
 	gpfs_quotactl_fn	      = dlsym(l, "gpfs_quotactl");
 	gpfs_getfilesetid_fn	      = dlsym(l, "gpfs_getfilesetid");
@@ -190,6 +196,28 @@ int gpfswrap_lib_init(int flags)
 	return gpfs_lib_init_fn(flags);
 }
 
+int gpfswrap_statlite(const char *pathname, unsigned int *litemask,
+		      struct stat64 *buf)
+{
+	if (gpfs_statlite_fn == NULL) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	return gpfs_statlite_fn(pathname, litemask, buf);
+}
+
+int gpfswrap_lstatlite(const char *pathname, unsigned int *litemask,
+		       struct stat64 *buf)
+{
+	if (gpfs_lstatlite_fn == NULL) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	return gpfs_lstatlite_fn(pathname, litemask, buf);
+}
+
 int gpfswrap_set_times_path(char *pathname, int flags,
 			    gpfs_timestruc_t times[4])
 {
@@ -39,6 +39,10 @@ int gpfswrap_get_winattrs(int fd, struct gpfs_winattr *attrs);
 int gpfswrap_prealloc(int fd, gpfs_off64_t start, gpfs_off64_t bytes);
 int gpfswrap_ftruncate(int fd, gpfs_off64_t length);
 int gpfswrap_lib_init(int flags);
+int gpfswrap_statlite(const char *pathname, unsigned int *litemask,
+		      struct stat64 *buf);
+int gpfswrap_lstatlite(const char *pathname, unsigned int *litemask,
+		       struct stat64 *buf);
 int gpfswrap_set_times_path(char *pathname, int flags,
 			    gpfs_timestruc_t times[4]);
 int gpfswrap_quotactl(char *pathname, int cmd, int id, void *bufp);
@@ -40,6 +40,7 @@ struct memcache {
 	struct rb_root tree;
 	size_t size;
 	size_t max_size;
+	struct memcache_class_stats stats[MEMCACHE_NUM_CLASSES];
 };
 
 static void memcache_element_parse(struct memcache_element *e,
@@ -163,8 +164,10 @@ bool memcache_lookup(struct memcache *cache, enum memcache_number n,
 
 	e = memcache_find(cache, n, key);
 	if (e == NULL) {
+		cache->stats[n].misses += 1;
 		return false;
 	}
+	cache->stats[n].hits += 1;
 
 	if (cache->size != 0) {
 		DLIST_PROMOTE(cache->mru, e);
@@ -211,6 +214,9 @@ static void memcache_delete_element(struct memcache *cache,
 	}
 
 	cache->size -= memcache_element_size(e->keylength, e->valuelength);
+	cache->stats[e->n].bytes -=
+		memcache_element_size(e->keylength, e->valuelength);
+	cache->stats[e->n].elements -= 1;
 
 	TALLOC_FREE(e);
 }
@@ -266,6 +272,8 @@ void memcache_add(struct memcache *cache, enum memcache_number n,
 		return;
 	}
 
+	cache->stats[n].adds += 1;
+
 	e = memcache_find(cache, n, key);
 
 	if (e != NULL) {
@@ -326,6 +334,8 @@ void memcache_add(struct memcache *cache, enum memcache_number n,
 	DLIST_ADD(cache->mru, e);
 
 	cache->size += element_size;
+	cache->stats[n].bytes += element_size;
+	cache->stats[n].elements += 1;
 	memcache_trim(cache);
 }
 
@@ -346,6 +356,65 @@ void memcache_add_talloc(struct memcache *cache, enum memcache_number n,
 	memcache_add(cache, n, key, data_blob_const(&p, sizeof(p)));
 }
 
+void memcache_get_stats(struct memcache *cache, enum memcache_number n,
+			struct memcache_class_stats *stats)
+{
+	if (cache == NULL) {
+		cache = global_cache;
+	}
+	if ((cache == NULL) || (n >= MEMCACHE_NUM_CLASSES)) {
+		ZERO_STRUCTP(stats);
+		return;
+	}
+	*stats = cache->stats[n];
+}
+
+const char *memcache_class_name(enum memcache_number n)
+{
+	static const char *names[MEMCACHE_NUM_CLASSES] = {
+		"STAT_CACHE",
+		"GENCACHE_RAM",
+		"GETWD_CACHE",
+		"GETPWNAM_CACHE",
+		"MANGLE_HASH2_CACHE",
+		"PDB_GETPWSID_CACHE",
+		"PDB_GETPWNAM_CACHE",
+		"SINGLETON_CACHE_TALLOC",
+		"SINGLETON_CACHE",
+		"SMB1_SEARCH_OFFSET_MAP",
+		"SHARE_MODE_LOCK_CACHE",
+		"GETREALFILENAME_CACHE",
+		"SERVERID_DEAD_CACHE",
+	};
+
+	if (n >= MEMCACHE_NUM_CLASSES) {
+		return "unknown";
+	}
+	return names[n];
+}
+
+size_t memcache_size(struct memcache *cache)
+{
+	if (cache == NULL) {
+		cache = global_cache;
+	}
+	if (cache == NULL) {
+		return 0;
+	}
+	return cache->size;
+}
+
+size_t memcache_max_size(struct memcache *cache)
+{
+	if (cache == NULL) {
+		cache = global_cache;
+	}
+	if (cache == NULL) {
+		return 0;
+	}
+	return cache->max_size;
+}
+
 void memcache_flush(struct memcache *cache, enum memcache_number n)
 {
 	struct rb_node *node;
@@ -38,10 +38,27 @@ enum memcache_number {
 	GETPWNAM_CACHE,		/* talloc */
 	MANGLE_HASH2_CACHE,
 	PDB_GETPWSID_CACHE,	/* talloc */
+	PDB_GETPWNAM_CACHE,
 	SINGLETON_CACHE_TALLOC,	/* talloc */
 	SINGLETON_CACHE,
 	SMB1_SEARCH_OFFSET_MAP,
-	SHARE_MODE_LOCK_CACHE	/* talloc */
+	SHARE_MODE_LOCK_CACHE,	/* talloc */
+	GETREALFILENAME_CACHE,
+	SERVERID_DEAD_CACHE,
+	MEMCACHE_NUM_CLASSES	/* keep last */
+};
+
+/*
+ * Per-class usage counters, maintained since cache creation. "bytes"
+ * and "elements" reflect what currently lives in the cache, the other
+ * counters only ever grow.
+ */
+struct memcache_class_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t adds;
+	uint64_t elements;
+	uint64_t bytes;
 };
 
 /*
@@ -109,4 +126,24 @@ void *memcache_lookup_talloc(struct memcache *cache, enum memcache_number n,
 
 void memcache_flush(struct memcache *cache, enum memcache_number n);
 
+/*
+ * Copy out the usage counters of one cache class.
+ */
+
+void memcache_get_stats(struct memcache *cache, enum memcache_number n,
+			struct memcache_class_stats *stats);
+
+/*
+ * The human-readable name of a cache class, for stats reporting.
+ */
+
+const char *memcache_class_name(enum memcache_number n);
+
+/*
+ * Current and maximum size of the whole cache in bytes.
+ */
+
+size_t memcache_size(struct memcache *cache);
+size_t memcache_max_size(struct memcache *cache);
+
 #endif
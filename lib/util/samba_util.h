@@ -655,6 +655,12 @@ _PUBLIC_ void dump_data_pw(const char *msg, const uint8_t * data, size_t len);
  */
 _PUBLIC_ bool all_zero(const uint8_t *ptr, size_t size);
 
+/**
+ * Compare two memory ranges in time depending only on the length, not
+ * the contents. Use for MAC and password hash verification.
+ */
+_PUBLIC_ bool mem_equal_const_time(const void *s1, const void *s2, size_t n);
+
 /**
   realloc an array, checking for integer overflow in the array size
 */
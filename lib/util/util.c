@@ -740,6 +740,38 @@ _PUBLIC_ bool all_zero(const uint8_t *ptr, size_t size)
 	return true;
 }
 
+/**
+ * Compare two memory ranges without leaking where they differ. Unlike
+ * memcmp() the run time depends only on the length, never on the
+ * contents, so this is safe for MAC and password hash verification.
+ * Works a word at a time; the memcpy loads compile to plain unaligned
+ * word loads on the platforms we care about.
+ */
+_PUBLIC_ bool mem_equal_const_time(const void *s1, const void *s2, size_t n)
+{
+	const uint8_t *p1 = (const uint8_t *)s1;
+	const uint8_t *p2 = (const uint8_t *)s2;
+	uint64_t diff = 0;
+
+	while (n >= 8) {
+		uint64_t v1, v2;
+
+		memcpy(&v1, p1, 8);
+		memcpy(&v2, p2, 8);
+		diff |= (v1 ^ v2);
+
+		p1 += 8;
+		p2 += 8;
+		n -= 8;
+	}
+
+	while (n--) {
+		diff |= (uint64_t)(*p1++ ^ *p2++);
+	}
+
+	return (diff == 0);
+}
+
 /**
   realloc an array, checking for integer overflow in the array size
 */
@@ -67,7 +67,7 @@ static bool smb_pwd_check_ntlmv1(TALLOC_CTX *mem_ctx,
 	DEBUGADD(100,("Value from encryption was |\n"));
 	dump_data(100, p24, 24);
 #endif
-	if (memcmp(p24, nt_response->data, 24) == 0) {
+	if (mem_equal_const_time(p24, nt_response->data, 24)) {
 		if (user_sess_key != NULL) {
 			*user_sess_key = data_blob_talloc(mem_ctx, NULL, 16);
 			SMBsesskeygen_ntv1(part_passwd, user_sess_key->data);
@@ -140,7 +140,8 @@ static bool smb_pwd_check_ntlmv2(TALLOC_CTX *mem_ctx,
 	dump_data(100, value_from_encryption, 16);
 #endif
 	data_blob_clear_free(&client_key_data);
-	if (memcmp(value_from_encryption, ntv2_response->data, 16) == 0) { 
+	if (mem_equal_const_time(value_from_encryption, ntv2_response->data,
+				 16)) {
 		if (user_sess_key != NULL) {
 			*user_sess_key = data_blob_talloc(mem_ctx, NULL, 16);
 			SMBsesskeygen_ntv2(kr, value_from_encryption, user_sess_key->data);
@@ -229,7 +230,8 @@ NTSTATUS hash_password_check(TALLOC_CTX *mem_ctx,
 	}
 
 	if (client_nt && stored_nt) {
-		if (memcmp(client_nt->hash, stored_nt->hash, sizeof(stored_nt->hash)) == 0) {
+		if (mem_equal_const_time(client_nt->hash, stored_nt->hash,
+					 sizeof(stored_nt->hash))) {
 			return NT_STATUS_OK;
 		} else {
 			DEBUG(3,("ntlm_password_check: Interactive logon: NT password check failed for user %s\n",
@@ -247,7 +249,8 @@ NTSTATUS hash_password_check(TALLOC_CTX *mem_ctx,
 			return NT_STATUS_NOT_FOUND;
 		}
 
-		if (memcmp(client_lanman->hash, stored_lanman->hash, sizeof(stored_lanman->hash)) == 0) {
+		if (mem_equal_const_time(client_lanman->hash, stored_lanman->hash,
+					 sizeof(stored_lanman->hash))) {
 			return NT_STATUS_OK;
 		} else {
 			DEBUG(3,("ntlm_password_check: Interactive logon: LANMAN password check failed for user %s\n",
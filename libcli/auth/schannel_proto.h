@@ -27,5 +27,6 @@ struct schannel_state;
 
 struct db_context *open_schannel_session_store(TALLOC_CTX *mem_ctx,
 					       struct loadparm_context *lp_ctx);
+void schannel_store_cache_stats(uint64_t *phits, uint64_t *pmisses);
 
 #endif
@@ -32,9 +32,32 @@
 
 #define SECRETS_SCHANNEL_STATE "SECRETS/SCHANNEL"
 
+/*
+ * Process local cache of the open session store, so that the thousands
+ * of netlogon-secured binds a busy print server handles don't open and
+ * close the tdb once per authenticator check. The handle is keyed on
+ * the database path: a config reload that moves the private dir simply
+ * causes a reopen on the next use.
+ */
+static struct db_context *schannel_store_db;
+static char *schannel_store_fname;
+static uint64_t schannel_store_hits;
+static uint64_t schannel_store_misses;
+
+/******************************************************************************
+ Report hit/miss counters for the cached session store handle.
+*******************************************************************************/
+
+void schannel_store_cache_stats(uint64_t *phits, uint64_t *pmisses)
+{
+	*phits = schannel_store_hits;
+	*pmisses = schannel_store_misses;
+}
+
 /******************************************************************************
  Open or create the schannel session store tdb.  Non-static so it can
- be called from parent processes to corectly handle TDB_CLEAR_IF_FIRST
+ be called from parent processes to corectly handle TDB_CLEAR_IF_FIRST.
+ The returned handle is owned by the cache above, not by mem_ctx.
 *******************************************************************************/
 
 struct db_context *open_schannel_session_store(TALLOC_CTX *mem_ctx,
@@ -47,7 +70,18 @@ struct db_context *open_schannel_session_store(TALLOC_CTX *mem_ctx,
 		return NULL;
 	}
 
-	db_sc = dbwrap_local_open(mem_ctx, lp_ctx, fname, 0,
+	if ((schannel_store_db != NULL) &&
+	    (strcmp(schannel_store_fname, fname) == 0)) {
+		schannel_store_hits++;
+		TALLOC_FREE(fname);
+		return schannel_store_db;
+	}
+	schannel_store_misses++;
+
+	TALLOC_FREE(schannel_store_db);
+	TALLOC_FREE(schannel_store_fname);
+
+	db_sc = dbwrap_local_open(NULL, lp_ctx, fname, 0,
 				  TDB_CLEAR_IF_FIRST|TDB_NOSYNC, O_RDWR|O_CREAT,
 				  0600, DBWRAP_LOCK_ORDER_NONE,
 				  DBWRAP_FLAG_NONE);
@@ -59,7 +93,8 @@ struct db_context *open_schannel_session_store(TALLOC_CTX *mem_ctx,
 		return NULL;
 	}
 
-	TALLOC_FREE(fname);
+	schannel_store_db = db_sc;
+	schannel_store_fname = talloc_move(NULL, &fname);
 
 	return db_sc;
 }
@@ -302,7 +302,11 @@ ssize_t spnego_read_data(TALLOC_CTX *mem_ctx, DATA_BLOB data, struct spnego_data
 		return -1;
 	}
 
-	if (!asn1_load(asn1, data)) goto err;
+	/*
+	 * We only parse here, so don't copy the input blob. The read
+	 * helpers pull anything they keep onto mem_ctx themselves.
+	 */
+	asn1_load_nocopy(asn1, data.data, data.length);
 
 	if (!asn1_peek_uint8(asn1, &context)) {
 		asn1_set_error(asn1);
@@ -303,11 +303,23 @@ int sid_compare_domain(const struct dom_sid *sid1, const struct dom_sid *sid2)
 NTSTATUS add_sid_to_array(TALLOC_CTX *mem_ctx, const struct dom_sid *sid,
 			  struct dom_sid **sids, uint32_t *num)
 {
-	*sids = talloc_realloc(mem_ctx, *sids, struct dom_sid,
-			       (*num)+1);
-	if (*sids == NULL) {
-		*num = 0;
-		return NT_STATUS_NO_MEMORY;
+	size_t capacity = talloc_array_length(*sids);
+
+	/*
+	 * Tokens are built by appending one SID at a time. Growing the
+	 * array geometrically instead of by a single element keeps n
+	 * appends at O(n) copied bytes instead of O(n^2). Callers only
+	 * look at *num, the spare capacity is invisible to them.
+	 */
+	if ((size_t)(*num) >= capacity) {
+		size_t new_capacity = MAX(capacity * 2, 16);
+
+		*sids = talloc_realloc(mem_ctx, *sids, struct dom_sid,
+				       new_capacity);
+		if (*sids == NULL) {
+			*num = 0;
+			return NT_STATUS_NO_MEMORY;
+		}
 	}
 
 	sid_copy(&((*sids)[*num]), sid);
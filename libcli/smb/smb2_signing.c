@@ -23,6 +23,58 @@
 #include "../libcli/smb/smb_common.h"
 #include "../lib/crypto/crypto.h"
 
+/*
+ * Per PDU we used to pay the full keying cost: two SHA256 compressions
+ * over the 64 byte pads for HMAC-SHA256, resp. the AES key expansion
+ * plus CMAC subkey derivation for AES-CMAC. For the typical small
+ * signed PDU that is about half of the crypto work. Cache the keyed
+ * intermediate state per signing key and start each PDU from a copy.
+ * Both pads and CMAC subkeys only depend on the key zero-padded to 16
+ * bytes, so that is the cache tag. smbd forks per connection and this
+ * code runs single-threaded, a small process-local cache recycled
+ * round-robin is good enough.
+ */
+#define SMB2_SIGNING_KEY_CACHE_SIZE 4
+
+struct smb2_signing_key_state {
+	uint8_t key[16];
+	bool cmac_valid;
+	bool hmac_valid;
+	struct aes_cmac_128_context cmac;
+	struct HMACSHA256Context hmac;
+};
+
+static struct smb2_signing_key_state
+smb2_signing_key_cache[SMB2_SIGNING_KEY_CACHE_SIZE];
+static size_t smb2_signing_key_cache_next;
+
+static struct smb2_signing_key_state *smb2_signing_key_cache_lookup(
+	const uint8_t key[16])
+{
+	struct smb2_signing_key_state *s;
+	size_t i;
+
+	for (i = 0; i < SMB2_SIGNING_KEY_CACHE_SIZE; i++) {
+		s = &smb2_signing_key_cache[i];
+
+		if (!s->cmac_valid && !s->hmac_valid) {
+			continue;
+		}
+		if (mem_equal_const_time(s->key, key, 16)) {
+			return s;
+		}
+	}
+
+	i = smb2_signing_key_cache_next;
+	smb2_signing_key_cache_next =
+		(i + 1) % SMB2_SIGNING_KEY_CACHE_SIZE;
+
+	s = &smb2_signing_key_cache[i];
+	ZERO_STRUCTP(s);
+	memcpy(s->key, key, 16);
+	return s;
+}
+
 NTSTATUS smb2_signing_sign_pdu(DATA_BLOB signing_key,
 			       enum protocol_types protocol,
 			       struct iovec *vector,
@@ -63,13 +115,19 @@ NTSTATUS smb2_signing_sign_pdu(DATA_BLOB signing_key,
 	SIVAL(hdr, SMB2_HDR_FLAGS, IVAL(hdr, SMB2_HDR_FLAGS) | SMB2_HDR_FLAG_SIGNED);
 
 	if (protocol >= PROTOCOL_SMB2_24) {
+		struct smb2_signing_key_state *cache;
 		struct aes_cmac_128_context ctx;
 		uint8_t key[AES_BLOCK_SIZE];
 
 		ZERO_STRUCT(key);
 		memcpy(key, signing_key.data, MIN(signing_key.length, 16));
 
-		aes_cmac_128_init(&ctx, key);
+		cache = smb2_signing_key_cache_lookup(key);
+		if (!cache->cmac_valid) {
+			aes_cmac_128_init(&cache->cmac, key);
+			cache->cmac_valid = true;
+		}
+		ctx = cache->cmac;
 		for (i=0; i < count; i++) {
 			aes_cmac_128_update(&ctx,
 					(const uint8_t *)vector[i].iov_base,
@@ -77,11 +135,20 @@ NTSTATUS smb2_signing_sign_pdu(DATA_BLOB signing_key,
 		}
 		aes_cmac_128_final(&ctx, res);
 	} else {
+		struct smb2_signing_key_state *cache;
 		struct HMACSHA256Context m;
+		uint8_t key[16];
 		uint8_t digest[SHA256_DIGEST_LENGTH];
 
-		ZERO_STRUCT(m);
-		hmac_sha256_init(signing_key.data, MIN(signing_key.length, 16), &m);
+		ZERO_STRUCT(key);
+		memcpy(key, signing_key.data, MIN(signing_key.length, 16));
+
+		cache = smb2_signing_key_cache_lookup(key);
+		if (!cache->hmac_valid) {
+			hmac_sha256_init(key, sizeof(key), &cache->hmac);
+			cache->hmac_valid = true;
+		}
+		m = cache->hmac;
 		for (i=0; i < count; i++) {
 			hmac_sha256_update((const uint8_t *)vector[i].iov_base,
 					   vector[i].iov_len, &m);
@@ -135,13 +202,19 @@ NTSTATUS smb2_signing_check_pdu(DATA_BLOB signing_key,
 	sig = hdr+SMB2_HDR_SIGNATURE;
 
 	if (protocol >= PROTOCOL_SMB2_24) {
+		struct smb2_signing_key_state *cache;
 		struct aes_cmac_128_context ctx;
 		uint8_t key[AES_BLOCK_SIZE];
 
 		ZERO_STRUCT(key);
 		memcpy(key, signing_key.data, MIN(signing_key.length, 16));
 
-		aes_cmac_128_init(&ctx, key);
+		cache = smb2_signing_key_cache_lookup(key);
+		if (!cache->cmac_valid) {
+			aes_cmac_128_init(&cache->cmac, key);
+			cache->cmac_valid = true;
+		}
+		ctx = cache->cmac;
 		aes_cmac_128_update(&ctx, hdr, SMB2_HDR_SIGNATURE);
 		aes_cmac_128_update(&ctx, zero_sig, 16);
 		for (i=1; i < count; i++) {
@@ -151,11 +224,20 @@ NTSTATUS smb2_signing_check_pdu(DATA_BLOB signing_key,
 		}
 		aes_cmac_128_final(&ctx, res);
 	} else {
+		struct smb2_signing_key_state *cache;
 		struct HMACSHA256Context m;
+		uint8_t key[16];
 		uint8_t digest[SHA256_DIGEST_LENGTH];
 
-		ZERO_STRUCT(m);
-		hmac_sha256_init(signing_key.data, MIN(signing_key.length, 16), &m);
+		ZERO_STRUCT(key);
+		memcpy(key, signing_key.data, MIN(signing_key.length, 16));
+
+		cache = smb2_signing_key_cache_lookup(key);
+		if (!cache->hmac_valid) {
+			hmac_sha256_init(key, sizeof(key), &cache->hmac);
+			cache->hmac_valid = true;
+		}
+		m = cache->hmac;
 		hmac_sha256_update(hdr, SMB2_HDR_SIGNATURE, &m);
 		hmac_sha256_update(zero_sig, 16, &m);
 		for (i=1; i < count; i++) {
@@ -166,7 +248,7 @@ NTSTATUS smb2_signing_check_pdu(DATA_BLOB signing_key,
 		memcpy(res, digest, 16);
 	}
 
-	if (memcmp(res, sig, 16) != 0) {
+	if (!mem_equal_const_time(res, sig, 16)) {
 		DEBUG(0,("Bad SMB2 signature for message\n"));
 		dump_data(0, sig, 16);
 		dump_data(0, res, 16);
@@ -393,7 +475,7 @@ NTSTATUS smb2_signing_decrypt_pdu(DATA_BLOB decryption_key,
 	ZERO_STRUCT(key);
 
 	sig_ptr = tf + SMB2_TF_SIGNATURE;
-	if (memcmp(sig_ptr, sig, 16) != 0) {
+	if (!mem_equal_const_time(sig_ptr, sig, 16)) {
 		return NT_STATUS_ACCESS_DENIED;
 	}
 
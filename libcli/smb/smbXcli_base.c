@@ -50,8 +50,27 @@ struct smbXcli_conn {
 	const char *remote_name;
 
 	struct tevent_queue *outgoing;
+	/*
+	 * conn->pending is an unordered array of in-flight requests,
+	 * the first conn->num_pending slots are valid. Beyond that
+	 * the array just keeps its capacity, we only free it when
+	 * the last request goes away. Each request remembers its
+	 * slot in smbXcli_req_state->pending_idx, so insert and
+	 * remove are O(1) even with hundreds of requests in flight.
+	 */
 	struct tevent_req **pending;
+	size_t num_pending;
 	struct tevent_req *read_smb_req;
+	/*
+	 * Talloc pool feeding the receive path. Every inbound PDU
+	 * including its read_smb/read_packet machinery is allocated
+	 * from here, so in steady state the per-packet buffers just
+	 * recycle pool memory instead of hitting the allocator. Once
+	 * the last consumer of an inbuf is freed the pool space is
+	 * available again; oversized PDUs or a deep pipeline simply
+	 * fall back to plain heap allocations.
+	 */
+	TALLOC_CTX *inbuf_pool;
 	struct tevent_req *suicide_req;
 
 	enum protocol_types min_protocol;
@@ -224,6 +243,12 @@ struct smbXcli_req_state {
 
 	struct tevent_req *write_req;
 
+	/*
+	 * Our slot in conn->pending, maintained by
+	 * smbXcli_req_set_pending()/smbXcli_req_unset_pending().
+	 */
+	size_t pending_idx;
+
 	struct {
 		/* Space for the header including the wct */
 		uint8_t hdr[HDR_VWV];
@@ -357,6 +382,7 @@ struct smbXcli_conn *smbXcli_conn_create(TALLOC_CTX *mem_ctx,
 		goto error;
 	}
 	conn->pending = NULL;
+	conn->num_pending = 0;
 
 	conn->min_protocol = PROTOCOL_NONE;
 	conn->max_protocol = PROTOCOL_NONE;
@@ -675,7 +701,7 @@ uint32_t smb1cli_conn_max_xmit(struct smbXcli_conn *conn)
 
 bool smb1cli_conn_req_possible(struct smbXcli_conn *conn)
 {
-	size_t pending = talloc_array_length(conn->pending);
+	size_t pending = conn->num_pending;
 	uint16_t possible = conn->smb1.server.max_mux;
 
 	if (pending >= possible) {
@@ -807,7 +833,7 @@ bool smb1cli_is_andx_req(uint8_t cmd)
 
 static uint16_t smb1cli_alloc_mid(struct smbXcli_conn *conn)
 {
-	size_t num_pending = talloc_array_length(conn->pending);
+	size_t num_pending = conn->num_pending;
 	uint16_t result;
 
 	if (conn->protocol == PROTOCOL_NONE) {
@@ -844,7 +870,7 @@ void smbXcli_req_unset_pending(struct tevent_req *req)
 		tevent_req_data(req,
 		struct smbXcli_req_state);
 	struct smbXcli_conn *conn = state->conn;
-	size_t num_pending = talloc_array_length(conn->pending);
+	size_t num_pending = conn->num_pending;
 	size_t i;
 
 	TALLOC_FREE(state->write_req);
@@ -859,23 +885,8 @@ void smbXcli_req_unset_pending(struct tevent_req *req)
 
 	tevent_req_set_cleanup_fn(req, NULL);
 
-	if (num_pending == 1) {
-		/*
-		 * The pending read_smb tevent_req is a child of
-		 * conn->pending. So if nothing is pending anymore, we need to
-		 * delete the socket read fde.
-		 */
-		TALLOC_FREE(conn->pending);
-		conn->read_smb_req = NULL;
-		return;
-	}
-
-	for (i=0; i<num_pending; i++) {
-		if (req == conn->pending[i]) {
-			break;
-		}
-	}
-	if (i == num_pending) {
+	i = state->pending_idx;
+	if ((i >= num_pending) || (conn->pending[i] != req)) {
 		/*
 		 * Something's seriously broken. Just returning here is the
 		 * right thing nevertheless, the point of this routine is to
@@ -884,19 +895,30 @@ void smbXcli_req_unset_pending(struct tevent_req *req)
 		return;
 	}
 
-	/*
-	 * Remove ourselves from the conn->pending array
-	 */
-	for (; i < (num_pending - 1); i++) {
-		conn->pending[i] = conn->pending[i+1];
+	if (num_pending == 1) {
+		/*
+		 * If nothing is pending anymore, we need to delete the
+		 * socket read fde. The pending read_smb tevent_req lives
+		 * off conn->inbuf_pool (or conn->pending as fallback), so
+		 * free it explicitly.
+		 */
+		TALLOC_FREE(conn->read_smb_req);
+		TALLOC_FREE(conn->pending);
+		conn->num_pending = 0;
+		return;
 	}
 
 	/*
-	 * No NULL check here, we're shrinking by sizeof(void *), and
-	 * talloc_realloc just adjusts the size for this.
+	 * Move the last entry into the hole we leave behind,
+	 * conn->pending is unordered anyway. This way removal
+	 * is O(1) no matter how deep the pipeline is.
 	 */
-	conn->pending = talloc_realloc(NULL, conn->pending, struct tevent_req *,
-				       num_pending - 1);
+	conn->pending[i] = conn->pending[num_pending-1];
+	state = tevent_req_data(conn->pending[i],
+				struct smbXcli_req_state);
+	state->pending_idx = i;
+	conn->pending[num_pending-1] = NULL;
+	conn->num_pending -= 1;
 	return;
 }
 
@@ -964,15 +986,25 @@ bool smbXcli_req_set_pending(struct tevent_req *req)
 		return false;
 	}
 
-	num_pending = talloc_array_length(conn->pending);
+	num_pending = conn->num_pending;
 
-	pending = talloc_realloc(conn, conn->pending, struct tevent_req *,
-				 num_pending+1);
-	if (pending == NULL) {
-		return false;
+	if (num_pending == talloc_array_length(conn->pending)) {
+		/*
+		 * We only grow the array, it is released as a whole
+		 * once the last pending request goes away. Growing
+		 * in powers of two keeps the realloc traffic low.
+		 */
+		pending = talloc_realloc(conn, conn->pending,
+					 struct tevent_req *,
+					 MAX(num_pending * 2, 16));
+		if (pending == NULL) {
+			return false;
+		}
+		conn->pending = pending;
 	}
-	pending[num_pending] = req;
-	conn->pending = pending;
+	conn->pending[num_pending] = req;
+	state->pending_idx = num_pending;
+	conn->num_pending = num_pending + 1;
 	tevent_req_set_cleanup_fn(req, smbXcli_req_cleanup);
 	tevent_req_set_cancel_fn(req, smbXcli_req_cancel);
 
@@ -995,7 +1027,7 @@ static void smbXcli_conn_received(struct tevent_req *subreq);
 
 static bool smbXcli_conn_receive_next(struct smbXcli_conn *conn)
 {
-	size_t num_pending = talloc_array_length(conn->pending);
+	size_t num_pending = conn->num_pending;
 	struct tevent_req *req;
 	struct smbXcli_req_state *state;
 
@@ -1021,11 +1053,26 @@ static bool smbXcli_conn_receive_next(struct smbXcli_conn *conn)
 	req = conn->pending[0];
 	state = tevent_req_data(req, struct smbXcli_req_state);
 
+	if (conn->inbuf_pool == NULL) {
+		/*
+		 * Large enough for the request states plus a max_xmit
+		 * sized PDU; anything bigger transparently falls back
+		 * to the heap.
+		 */
+		conn->inbuf_pool = talloc_pool(conn, 0x20000);
+		/*
+		 * If the pool allocation failed we can still limp
+		 * along with conn->pending as parent.
+		 */
+	}
+
 	/*
 	 * We're the first ones, add the read_smb request that waits for the
 	 * answer from the server
 	 */
-	conn->read_smb_req = read_smb_send(conn->pending,
+	conn->read_smb_req = read_smb_send(conn->inbuf_pool != NULL ?
+					   conn->inbuf_pool :
+					   (TALLOC_CTX *)conn->pending,
 					   state->ev,
 					   conn->sock_fd);
 	if (conn->read_smb_req == NULL) {
@@ -1045,7 +1092,7 @@ void smbXcli_conn_disconnect(struct smbXcli_conn *conn, NTSTATUS status)
 	conn->sock_fd = -1;
 
 	session = conn->sessions;
-	if (talloc_array_length(conn->pending) == 0) {
+	if (conn->num_pending == 0) {
 		/*
 		 * if we do not have pending requests
 		 * there is no need to update the channel_sequence
@@ -1072,7 +1119,7 @@ void smbXcli_conn_disconnect(struct smbXcli_conn *conn, NTSTATUS status)
 	 * conn->pending because that array changes in
 	 * smbXcli_req_unset_pending.
 	 */
-	while (talloc_array_length(conn->pending) > 0) {
+	while (conn->num_pending > 0) {
 		struct tevent_req *req;
 		struct smbXcli_req_state *state;
 		struct tevent_req **chain;
@@ -1586,29 +1633,28 @@ static NTSTATUS smb1cli_req_writev_submit(struct tevent_req *req,
 	 * here we'd look up based on tid.
 	 */
 	if (common_encryption_on(state->conn->smb1.trans_enc)) {
-		char *buf, *enc_buf;
+		char *buf;
+		int enc_iov_count = 0;
 
 		buf = (char *)smbXcli_iov_concat(talloc_tos(), iov, iov_count);
 		if (buf == NULL) {
 			return NT_STATUS_NO_MEMORY;
 		}
+		/*
+		 * The encrypted packet is handed back as header plus
+		 * wrapped payload iovecs for the writev below, saving
+		 * a copy into yet another buffer.
+		 */
 		status = common_encrypt_buffer(state->conn->smb1.trans_enc,
-					       (char *)buf, &enc_buf);
+					       state, buf, iov,
+					       &enc_iov_count);
 		TALLOC_FREE(buf);
 		if (!NT_STATUS_IS_OK(status)) {
 			DEBUG(0, ("Error in encrypting client message: %s\n",
 				  nt_errstr(status)));
 			return status;
 		}
-		buf = (char *)talloc_memdup(state, enc_buf,
-					    smb_len_nbt(enc_buf)+4);
-		SAFE_FREE(enc_buf);
-		if (buf == NULL) {
-			return NT_STATUS_NO_MEMORY;
-		}
-		iov[0].iov_base = (void *)buf;
-		iov[0].iov_len = talloc_get_size(buf);
-		iov_count = 1;
+		iov_count = enc_iov_count;
 	}
 
 	if (state->conn->dispatch_incoming == NULL) {
@@ -2082,7 +2128,7 @@ static NTSTATUS smb1cli_conn_dispatch_incoming(struct smbXcli_conn *conn,
 	}
 
 	mid = SVAL(inhdr, HDR_MID);
-	num_pending = talloc_array_length(conn->pending);
+	num_pending = conn->num_pending;
 
 	for (i=0; i<num_pending; i++) {
 		if (mid == smb1cli_req_mid(conn->pending[i])) {
@@ -2173,7 +2219,7 @@ static NTSTATUS smb1cli_conn_dispatch_incoming(struct smbXcli_conn *conn,
 		state->smb1.recv_iov[1] = iov[1];
 		state->smb1.recv_iov[2] = iov[2];
 
-		if (talloc_array_length(conn->pending) == 0) {
+		if (conn->num_pending == 0) {
 			tevent_req_done(req);
 			return NT_STATUS_OK;
 		}
@@ -2583,7 +2629,12 @@ NTSTATUS smb1cli_req_chain_submit(struct tevent_req **reqs, int num_reqs)
 bool smbXcli_conn_has_async_calls(struct smbXcli_conn *conn)
 {
 	return ((tevent_queue_length(conn->outgoing) != 0)
-		|| (talloc_array_length(conn->pending) != 0));
+		|| (conn->num_pending != 0));
+}
+
+size_t smbXcli_conn_pending_reqs(struct smbXcli_conn *conn)
+{
+	return conn->num_pending;
 }
 
 bool smbXcli_conn_dfs_supported(struct smbXcli_conn *conn)
@@ -3470,7 +3521,7 @@ inval:
 static struct tevent_req *smb2cli_conn_find_pending(struct smbXcli_conn *conn,
 						    uint64_t mid)
 {
-	size_t num_pending = talloc_array_length(conn->pending);
+	size_t num_pending = conn->num_pending;
 	size_t i;
 
 	for (i=0; i<num_pending; i++) {
@@ -3761,7 +3812,7 @@ static NTSTATUS smb2cli_conn_dispatch_incoming(struct smbXcli_conn *conn,
 		 * There might be more than one response
 		 * we need to defer the notifications
 		 */
-		if ((num_iov == 5) && (talloc_array_length(conn->pending) == 0)) {
+		if ((num_iov == 5) && (conn->num_pending == 0)) {
 			defer = false;
 		}
 
@@ -4925,7 +4976,7 @@ static NTSTATUS smbXcli_negprot_dispatch_incoming(struct smbXcli_conn *conn,
 						  TALLOC_CTX *tmp_mem,
 						  uint8_t *inbuf)
 {
-	size_t num_pending = talloc_array_length(conn->pending);
+	size_t num_pending = conn->num_pending;
 	struct tevent_req *subreq;
 	struct smbXcli_req_state *substate;
 	struct tevent_req *req;
@@ -531,6 +531,11 @@ enum csc_policy {
 #define FSCTL_SET_INTEGRITY_INFORMATION (FSCTL_FILESYSTEM | FSCTL_ACCESS_READ \
 							  | FSCTL_ACCESS_WRITE | 0x0280 | FSCTL_METHOD_BUFFERED)
 #define FSCTL_DUP_EXTENTS_TO_FILE	(FSCTL_FILESYSTEM | FSCTL_ACCESS_WRITE | 0x0344 | FSCTL_METHOD_BUFFERED)
+/*
+ * Samba private: server side SHA-512 of a file range, function code
+ * 0x800 is in the vendor reserved range. See smb2_ioctl_filesys.c.
+ */
+#define FSCTL_SAMBA_FILE_SHA512		(FSCTL_FILESYSTEM | FSCTL_ACCESS_READ | 0x2000 | FSCTL_METHOD_BUFFERED)
 #define FSCTL_SVHDX_SYNC_TUNNEL_REQUEST	(FSCTL_FILESYSTEM | FSCTL_ACCESS_ANY | 0x0304 | FSCTL_METHOD_BUFFERED)
 #define FSCTL_QUERY_SHARED_VIRTUAL_DISK_SUPPORT	(FSCTL_FILESYSTEM | FSCTL_ACCESS_ANY | 0x0300 | FSCTL_METHOD_BUFFERED)
 
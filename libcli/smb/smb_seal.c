@@ -25,8 +25,6 @@
 #include "auth/gensec/gensec.h"
 #include "libcli/smb/smb_seal.h"
 
-#undef malloc
-
 /******************************************************************************
  Pull out the encryption context for this packet. 0 means global context.
 ******************************************************************************/
@@ -123,21 +121,23 @@ static NTSTATUS common_gensec_decrypt_buffer(struct gensec_security *gensec,
 
 /******************************************************************************
  Generic code for client and server.
- NTLM encrypt an outgoing buffer. Return the encrypted pointer in ppbuf_out.
+ NTLM encrypt an outgoing buffer. Return header and wrapped payload as
+ two iovec entries for a gather write, avoiding a copy of the whole PDU
+ into a fresh buffer just to put 8 bytes in front of it.
 ******************************************************************************/
 
 static NTSTATUS common_gensec_encrypt_buffer(struct gensec_security *gensec,
 				      uint16_t enc_ctx_num,
+				      TALLOC_CTX *mem_ctx,
 				      char *buf,
-				      char **ppbuf_out)
+				      struct iovec iov_out[2])
 {
 	NTSTATUS status;
 	DATA_BLOB in_buf, out_buf;
 	size_t buf_len = smb_len_nbt(buf) + 4; /* Don't forget the 4 length bytes. */
+	char *hdr;
 	TALLOC_CTX *frame;
 
-	*ppbuf_out = NULL;
-
 	if (buf_len < 8) {
 		return NT_STATUS_BUFFER_TOO_SMALL;
 	}
@@ -153,14 +153,17 @@ static NTSTATUS common_gensec_encrypt_buffer(struct gensec_security *gensec,
 		return status;
 	}
 
-	*ppbuf_out = (char *)malloc(out_buf.length + 8); /* We know this can't wrap. */
-	if (!*ppbuf_out) {
+	hdr = talloc_array(mem_ctx, char, 8);
+	if (hdr == NULL) {
 		TALLOC_FREE(frame);
 		return NT_STATUS_NO_MEMORY;
 	}
+	smb_set_enclen(hdr, out_buf.length + 4, enc_ctx_num);
 
-	memcpy(*ppbuf_out+8, out_buf.data, out_buf.length);
-	smb_set_enclen(*ppbuf_out, out_buf.length + 4, enc_ctx_num);
+	iov_out[0].iov_base = hdr;
+	iov_out[0].iov_len = 8;
+	iov_out[1].iov_base = talloc_move(mem_ctx, &out_buf.data);
+	iov_out[1].iov_len = out_buf.length;
 
 	TALLOC_FREE(frame);
 
@@ -169,18 +172,35 @@ static NTSTATUS common_gensec_encrypt_buffer(struct gensec_security *gensec,
 
 /******************************************************************************
  Generic code for client and server.
- Encrypt an outgoing buffer. Return the alloced encrypted pointer in buf_out.
+ Encrypt an outgoing buffer. On return iov_out holds *iov_count entries,
+ allocated off mem_ctx, which together form the wire packet. If
+ encryption is off a single entry points at the caller's buffer.
 ******************************************************************************/
 
-NTSTATUS common_encrypt_buffer(struct smb_trans_enc_state *es, char *buffer, char **buf_out)
+NTSTATUS common_encrypt_buffer(struct smb_trans_enc_state *es,
+			       TALLOC_CTX *mem_ctx,
+			       char *buffer,
+			       struct iovec iov_out[2],
+			       int *iov_count)
 {
+	NTSTATUS status;
+
 	if (!common_encryption_on(es)) {
 		/* Not encrypting. */
-		*buf_out = buffer;
+		iov_out[0].iov_base = buffer;
+		iov_out[0].iov_len = smb_len_tcp(buffer) + 4;
+		*iov_count = 1;
 		return NT_STATUS_OK;
 	}
 
-	return common_gensec_encrypt_buffer(es->gensec_security, es->enc_ctx_num, buffer, buf_out);
+	status = common_gensec_encrypt_buffer(es->gensec_security,
+					      es->enc_ctx_num,
+					      mem_ctx, buffer, iov_out);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+	*iov_count = 2;
+	return NT_STATUS_OK;
 }
 
 /******************************************************************************
@@ -198,23 +218,3 @@ NTSTATUS common_decrypt_buffer(struct smb_trans_enc_state *es, char *buf)
 
 	return common_gensec_decrypt_buffer(es->gensec_security, buf);
 }
-
-/******************************************************************************
- Free an encryption-allocated buffer.
-******************************************************************************/
-
-void common_free_enc_buffer(struct smb_trans_enc_state *es, char *buf)
-{
-	uint16_t enc_ctx_num;
-
-	if (!common_encryption_on(es)) {
-		return;
-	}
-
-	if (!NT_STATUS_IS_OK(get_enc_ctx_num((const uint8_t *)buf,
-			&enc_ctx_num))) {
-		return;
-	}
-
-	SAFE_FREE(buf);
-}
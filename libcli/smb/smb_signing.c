@@ -300,7 +300,7 @@ bool smb_signing_check_pdu(struct smb_signing_state *si,
 			seqnum, calc_md5_mac);
 
 	reply_sent_mac = &inhdr[HDR_SS_FIELD];
-	good = (memcmp(reply_sent_mac, calc_md5_mac, 8) == 0);
+	good = mem_equal_const_time(reply_sent_mac, calc_md5_mac, 8);
 
 	if (!good) {
 		int i;
@@ -315,7 +315,7 @@ bool smb_signing_check_pdu(struct smb_signing_state *si,
 		for (i = -sign_range; i < sign_range; i++) {
 			smb_signing_md5(&si->mac_key, inhdr, len,
 					seqnum+i, calc_md5_mac);
-			if (memcmp(reply_sent_mac, calc_md5_mac, 8) == 0) {
+			if (mem_equal_const_time(reply_sent_mac, calc_md5_mac, 8)) {
 				DEBUG(0,("smb_signing_check_pdu: "
 					 "out of seq. seq num %u matches. "
 					 "We were expecting seq %u\n",
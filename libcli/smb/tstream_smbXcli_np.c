@@ -70,6 +70,14 @@ struct tstream_smbXcli_np {
 		size_t left;
 		uint8_t *buf;
 	} read, write;
+
+	/*
+	 * The negotiated maximum payload per transport call. With
+	 * SMB >= 2.0 this is typically much larger than a single
+	 * DCERPC fragment, so a multi-fragment writev goes out in
+	 * one SMB2 WRITE instead of one call per 4280 bytes.
+	 */
+	uint32_t max_data;
 };
 
 struct tstream_smbXcli_np_ref {
@@ -359,6 +367,27 @@ NTSTATUS _tstream_smbXcli_np_open_recv(struct tevent_req *req,
 	cli_nps->fid_persistent = state->fid_persistent;
 	cli_nps->fid_volatile = state->fid_volatile;
 
+	/*
+	 * With SMB1 we're limited by the wire format of SMBtrans,
+	 * see bug #8195, so stay with the old fixed buffer size.
+	 *
+	 * With SMB2 we can fill whatever the server offered during
+	 * negprot, but never go below the old fixed value in case
+	 * the server negotiated something tiny.
+	 */
+	cli_nps->max_data = TSTREAM_SMBXCLI_NP_MAX_BUF_SIZE;
+	if (!cli_nps->is_smb1) {
+		uint32_t max_data;
+
+		max_data = smb2cli_conn_max_trans_size(cli_nps->conn);
+		max_data = MIN(max_data,
+			       smb2cli_conn_max_read_size(cli_nps->conn));
+		max_data = MIN(max_data,
+			       smb2cli_conn_max_write_size(cli_nps->conn));
+
+		cli_nps->max_data = MAX(cli_nps->max_data, max_data);
+	}
+
 	talloc_set_destructor(cli_nps, tstream_smbXcli_np_destructor);
 	talloc_set_destructor(cli_nps->conn_ref,
 			      tstream_smbXcli_np_ref_destructor);
@@ -536,7 +565,7 @@ static void tstream_smbXcli_np_writev_write_next(struct tevent_req *req)
 	}
 
 	cli_nps->write.ofs = 0;
-	cli_nps->write.left = MIN(left, TSTREAM_SMBXCLI_NP_MAX_BUF_SIZE);
+	cli_nps->write.left = MIN(left, cli_nps->max_data);
 	cli_nps->write.buf = talloc_realloc(cli_nps, cli_nps->write.buf,
 					    uint8_t, cli_nps->write.left);
 	if (tevent_req_nomem(cli_nps->write.buf, req)) {
@@ -858,14 +887,14 @@ static void tstream_smbXcli_np_readv_read_next(struct tevent_req *req)
 					    cli_nps->session,
 					    cli_nps->fnum,
 					    0, /* offset */
-					    TSTREAM_SMBXCLI_NP_MAX_BUF_SIZE);
+					    cli_nps->max_data);
 	} else {
 		subreq = smb2cli_read_send(state, state->ev,
 					   cli_nps->conn,
 					   cli_nps->timeout,
 					   cli_nps->session,
 					   cli_nps->tcon,
-					   TSTREAM_SMBXCLI_NP_MAX_BUF_SIZE, /* length */
+					   cli_nps->max_data, /* length */
 					   0, /* offset */
 					   cli_nps->fid_persistent,
 					   cli_nps->fid_volatile,
@@ -913,7 +942,7 @@ static void tstream_smbXcli_np_readv_trans_start(struct tevent_req *req)
 					    NULL, 0, 0,
 					    cli_nps->write.buf,
 					    cli_nps->write.ofs,
-					    TSTREAM_SMBXCLI_NP_MAX_BUF_SIZE);
+					    cli_nps->max_data);
 	} else {
 		DATA_BLOB in_input_buffer = data_blob_null;
 		DATA_BLOB in_output_buffer = data_blob_null;
@@ -932,7 +961,7 @@ static void tstream_smbXcli_np_readv_trans_start(struct tevent_req *req)
 					    0, /* in_max_input_length */
 					    &in_input_buffer,
 					    /* in_max_output_length */
-					    TSTREAM_SMBXCLI_NP_MAX_BUF_SIZE,
+					    cli_nps->max_data,
 					    &in_output_buffer,
 					    SMB2_IOCTL_FLAG_IS_FSCTL);
 	}
@@ -988,7 +1017,7 @@ static void tstream_smbXcli_np_readv_trans_done(struct tevent_req *subreq)
 		return;
 	}
 
-	if (received > TSTREAM_SMBXCLI_NP_MAX_BUF_SIZE) {
+	if (received > cli_nps->max_data) {
 		tstream_smbXcli_np_readv_disconnect_now(req, EIO, __location__);
 		return;
 	}
@@ -1072,7 +1101,7 @@ static void tstream_smbXcli_np_readv_read_done(struct tevent_req *subreq)
 		return;
 	}
 
-	if (received > TSTREAM_SMBXCLI_NP_MAX_BUF_SIZE) {
+	if (received > cli_nps->max_data) {
 		TALLOC_FREE(subreq);
 		tstream_smbXcli_np_readv_disconnect_now(req, EIO, __location__);
 		return;
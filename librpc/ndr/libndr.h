@@ -36,14 +36,27 @@
 
 
 /*
-  this is used by the token store/retrieve code
+  this is used by the token store/retrieve code. Tokens are kept in a
+  hash table keyed on the pointer, so that lookup stays O(1) for blobs
+  with thousands of relative pointers; an insertion ordered list is
+  kept alongside for callers that match with a comparison function.
+  An empty token list is represented by a NULL pointer, it is created
+  on first store and freed again when the last token is retrieved.
 */
-struct ndr_token_list {
-	struct ndr_token_list *next, *prev;
+#define NDR_TOKEN_NUM_BUCKETS 64
+
+struct ndr_token {
+	struct ndr_token *next, *prev;
+	struct ndr_token *bucket_next;
 	const void *key;
 	uint32_t value;
 };
 
+struct ndr_token_list {
+	struct ndr_token *tokens;
+	struct ndr_token *buckets[NDR_TOKEN_NUM_BUCKETS];
+};
+
 /* this is the base structure passed to routines that 
    parse MSRPC formatted data 
 
@@ -129,6 +142,14 @@ struct ndr_print {
  *
  * return NDR_ERR_INCOMPLETE_BUFFER instead.
  */
+/*
+ * set by callers who guarantee that the source blob outlives the
+ * pulled result, so that ndr_pull_DATA_BLOB and string pulls which
+ * need no charset conversion reference the wire buffer directly
+ * instead of copying it
+ */
+#define LIBNDR_FLAG_BORROW	(1<<15)
+
 #define LIBNDR_FLAG_INCOMPLETE_BUFFER (1<<16)
 
 /*
@@ -174,6 +195,18 @@ struct ndr_print {
 /* set to avoid recursion in ndr_size_*() calculation */
 #define LIBNDR_FLAG_NO_NDR_SIZE		(1<<31)
 
+/*
+ * flags under which the pidl generated [ndr_flat] fast-path
+ * marshallers are not wire compatible with the generic code and
+ * must fall back to it
+ */
+#define LIBNDR_FLAT_UNSAFE_FLAGS (0		| \
+		LIBNDR_FLAG_BIGENDIAN		| \
+		LIBNDR_FLAG_NOALIGN		| \
+		LIBNDR_FLAG_PAD_CHECK		| \
+		LIBNDR_FLAG_NDR64		| \
+		0)
+
 /* useful macro for debugging */
 #define NDR_PRINT_DEBUG(type, p) ndr_print_debug((ndr_print_fn_t)ndr_print_ ##type, #p, p)
 #define NDR_PRINT_DEBUGC(dbgc_class, type, p) ndr_print_debugc(dbgc_class, (ndr_print_fn_t)ndr_print_ ##type, #p, p)
@@ -482,6 +515,8 @@ enum ndr_err_code ndr_pull_relative_ptr2(struct ndr_pull *ndr, const void *p);
 enum ndr_err_code ndr_pull_relative_ptr_short(struct ndr_pull *ndr, uint16_t *v);
 size_t ndr_align_size(uint32_t offset, size_t n);
 struct ndr_pull *ndr_pull_init_blob(const DATA_BLOB *blob, TALLOC_CTX *mem_ctx);
+struct ndr_pull *ndr_pull_init_blob_pool(const DATA_BLOB *blob, TALLOC_CTX *mem_ctx);
+enum ndr_err_code ndr_pull_set_mem_pool(struct ndr_pull *ndr, TALLOC_CTX *mem_ctx);
 enum ndr_err_code ndr_pull_append(struct ndr_pull *ndr, DATA_BLOB *blob);
 enum ndr_err_code ndr_pull_pop(struct ndr_pull *ndr);
 enum ndr_err_code ndr_pull_advance(struct ndr_pull *ndr, uint32_t size);
@@ -75,6 +75,60 @@ _PUBLIC_ struct ndr_pull *ndr_pull_init_blob(const DATA_BLOB *blob, TALLOC_CTX *
 	return ndr;
 }
 
+/* don't preallocate more than this per PDU, talloc_pool() falls
+   back to malloc once the pool is exhausted */
+#define NDR_PULL_POOL_MAX_SIZE (4*1024*1024)
+
+/*
+  guess a pool size for unmarshalling a blob. The unmarshalled form
+  carries a talloc header per allocation on top of the wire bytes, so
+  leave generous headroom.
+*/
+static size_t ndr_pull_pool_size(uint32_t data_size)
+{
+	if (data_size >= (NDR_PULL_POOL_MAX_SIZE - NDR_BASE_MARSHALL_SIZE)/2) {
+		return NDR_PULL_POOL_MAX_SIZE;
+	}
+	return (size_t)data_size * 2 + NDR_BASE_MARSHALL_SIZE;
+}
+
+/*
+  allocate all unmarshalled data from a talloc pool hanging off mem_ctx.
+  A large PDU then costs one malloc instead of one per field. Everything
+  pulled remains a talloc descendant of mem_ctx, but note that stealing
+  a single object out of the pull result keeps the whole pool alive.
+*/
+_PUBLIC_ enum ndr_err_code ndr_pull_set_mem_pool(struct ndr_pull *ndr, TALLOC_CTX *mem_ctx)
+{
+	TALLOC_CTX *pool;
+
+	pool = talloc_pool(mem_ctx, ndr_pull_pool_size(ndr->data_size));
+	if (pool == NULL) {
+		return ndr_pull_error(ndr, NDR_ERR_ALLOC, "%s", __location__);
+	}
+	ndr->current_mem_ctx = pool;
+	return NDR_ERR_SUCCESS;
+}
+
+/*
+  initialise a ndr parse structure from a data blob, unmarshalling into
+  a talloc pool hanging off mem_ctx
+*/
+_PUBLIC_ struct ndr_pull *ndr_pull_init_blob_pool(const DATA_BLOB *blob, TALLOC_CTX *mem_ctx)
+{
+	struct ndr_pull *ndr;
+
+	ndr = ndr_pull_init_blob(blob, mem_ctx);
+	if (!ndr) return NULL;
+
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_pull_set_mem_pool(ndr, mem_ctx))) {
+		talloc_free(ndr);
+		return NULL;
+	}
+
+	return ndr;
+}
+
 _PUBLIC_ enum ndr_err_code ndr_pull_append(struct ndr_pull *ndr, DATA_BLOB *blob)
 {
 	enum ndr_err_code ndr_err;
@@ -258,7 +312,16 @@ _PUBLIC_ enum ndr_err_code ndr_push_expand(struct ndr_push *ndr, uint32_t extra_
 		return NDR_ERR_SUCCESS;
 	}
 
-	ndr->alloc_size += NDR_BASE_MARSHALL_SIZE;
+	/*
+	 * Grow by half the current size, so that marshalling a large
+	 * response does O(log(n)) reallocs instead of one per
+	 * NDR_BASE_MARSHALL_SIZE, which meant O(n^2) bytes copied.
+	 */
+	if (ndr->alloc_size > UINT32_MAX - ndr->alloc_size/2) {
+		ndr->alloc_size = UINT32_MAX;
+	} else {
+		ndr->alloc_size += ndr->alloc_size/2;
+	}
 	if (size+1 > ndr->alloc_size) {
 		ndr->alloc_size = size+1;
 	}
@@ -903,20 +966,45 @@ _PUBLIC_ enum ndr_err_code ndr_push_subcontext_end(struct ndr_push *ndr,
 	return NDR_ERR_SUCCESS;
 }
 
+/*
+  hash a token key. Keys are object addresses, so the low bits carry
+  no information and are mixed away.
+*/
+static unsigned int ndr_token_hash(const void *key)
+{
+	uintptr_t h = (uintptr_t)key >> 3;
+	h ^= h >> 11;
+	return h & (NDR_TOKEN_NUM_BUCKETS - 1);
+}
+
 /*
   store a token in the ndr context, for later retrieval
 */
 _PUBLIC_ enum ndr_err_code ndr_token_store(TALLOC_CTX *mem_ctx,
-			 struct ndr_token_list **list, 
-			 const void *key, 
+			 struct ndr_token_list **list,
+			 const void *key,
 			 uint32_t value)
 {
-	struct ndr_token_list *tok;
-	tok = talloc(mem_ctx, struct ndr_token_list);
+	struct ndr_token_list *tbl = *list;
+	struct ndr_token *tok;
+	unsigned int bucket;
+
+	if (tbl == NULL) {
+		tbl = talloc_zero(mem_ctx, struct ndr_token_list);
+		NDR_ERR_HAVE_NO_MEMORY(tbl);
+		*list = tbl;
+	}
+
+	tok = talloc(tbl, struct ndr_token);
 	NDR_ERR_HAVE_NO_MEMORY(tok);
 	tok->key = key;
 	tok->value = value;
-	DLIST_ADD((*list), tok);
+
+	/* newest first, so a re-stored key shadows the older token */
+	bucket = ndr_token_hash(key);
+	tok->bucket_next = tbl->buckets[bucket];
+	tbl->buckets[bucket] = tok;
+	DLIST_ADD(tbl->tokens, tok);
 	return NDR_ERR_SUCCESS;
 }
 
@@ -926,17 +1014,45 @@ _PUBLIC_ enum ndr_err_code ndr_token_store(TALLOC_CTX *mem_ctx,
 _PUBLIC_ enum ndr_err_code ndr_token_retrieve_cmp_fn(struct ndr_token_list **list, const void *key, uint32_t *v,
 				   comparison_fn_t _cmp_fn, bool _remove_tok)
 {
-	struct ndr_token_list *tok;
-	for (tok=*list;tok;tok=tok->next) {
-		if (_cmp_fn && _cmp_fn(tok->key,key)==0) goto found;
-		else if (!_cmp_fn && tok->key == key) goto found;
+	struct ndr_token_list *tbl = *list;
+	struct ndr_token *tok;
+	unsigned int bucket;
+
+	if (tbl == NULL) {
+		return NDR_ERR_TOKEN;
+	}
+	if (_cmp_fn) {
+		/*
+		 * an arbitrary comparison can not use the hash, walk
+		 * all tokens newest first
+		 */
+		for (tok=tbl->tokens;tok;tok=tok->next) {
+			if (_cmp_fn(tok->key,key)==0) goto found;
+		}
+		return NDR_ERR_TOKEN;
+	}
+	for (tok=tbl->buckets[ndr_token_hash(key)];tok;tok=tok->bucket_next) {
+		if (tok->key == key) goto found;
 	}
 	return NDR_ERR_TOKEN;
 found:
 	*v = tok->value;
 	if (_remove_tok) {
-		DLIST_REMOVE((*list), tok);
+		struct ndr_token **prev;
+
+		bucket = ndr_token_hash(tok->key);
+		for (prev=&tbl->buckets[bucket];*prev!=tok;prev=&(*prev)->bucket_next) {
+			/* the token is always on its bucket chain */
+		}
+		*prev = tok->bucket_next;
+		DLIST_REMOVE(tbl->tokens, tok);
 		talloc_free(tok);
+
+		if (tbl->tokens == NULL) {
+			/* keep NULL meaning "no outstanding tokens" */
+			talloc_free(tbl);
+			*list = NULL;
+		}
 	}
 	return NDR_ERR_SUCCESS;
 }
@@ -1113,7 +1229,7 @@ _PUBLIC_ enum ndr_err_code ndr_pull_struct_blob(const DATA_BLOB *blob, TALLOC_CT
 			      ndr_pull_flags_fn_t fn)
 {
 	struct ndr_pull *ndr;
-	ndr = ndr_pull_init_blob(blob, mem_ctx);
+	ndr = ndr_pull_init_blob_pool(blob, mem_ctx);
 	NDR_ERR_HAVE_NO_MEMORY(ndr);
 	NDR_CHECK_FREE(fn(ndr, NDR_SCALARS|NDR_BUFFERS, p));
 	talloc_free(ndr);
@@ -1128,7 +1244,7 @@ _PUBLIC_ enum ndr_err_code ndr_pull_struct_blob_all(const DATA_BLOB *blob, TALLO
 {
 	struct ndr_pull *ndr;
 	uint32_t highest_ofs;
-	ndr = ndr_pull_init_blob(blob, mem_ctx);
+	ndr = ndr_pull_init_blob_pool(blob, mem_ctx);
 	NDR_ERR_HAVE_NO_MEMORY(ndr);
 	NDR_CHECK_FREE(fn(ndr, NDR_SCALARS|NDR_BUFFERS, p));
 	if (ndr->offset > ndr->relative_highest_offset) {
@@ -1156,7 +1272,7 @@ _PUBLIC_ enum ndr_err_code ndr_pull_union_blob(const DATA_BLOB *blob, TALLOC_CTX
 			     uint32_t level, ndr_pull_flags_fn_t fn)
 {
 	struct ndr_pull *ndr;
-	ndr = ndr_pull_init_blob(blob, mem_ctx);
+	ndr = ndr_pull_init_blob_pool(blob, mem_ctx);
 	NDR_ERR_HAVE_NO_MEMORY(ndr);
 	NDR_CHECK_FREE(ndr_pull_set_switch_value(ndr, p, level));
 	NDR_CHECK_FREE(fn(ndr, NDR_SCALARS|NDR_BUFFERS, p));
@@ -1174,7 +1290,7 @@ _PUBLIC_ enum ndr_err_code ndr_pull_union_blob_all(const DATA_BLOB *blob, TALLOC
 {
 	struct ndr_pull *ndr;
 	uint32_t highest_ofs;
-	ndr = ndr_pull_init_blob(blob, mem_ctx);
+	ndr = ndr_pull_init_blob_pool(blob, mem_ctx);
 	NDR_ERR_HAVE_NO_MEMORY(ndr);
 	NDR_CHECK_FREE(ndr_pull_set_switch_value(ndr, p, level));
 	NDR_CHECK_FREE(fn(ndr, NDR_SCALARS|NDR_BUFFERS, p));
@@ -1318,7 +1318,12 @@ _PUBLIC_ enum ndr_err_code ndr_pull_DATA_BLOB(struct ndr_pull *ndr, int ndr_flag
 		NDR_CHECK(ndr_pull_uint3264(ndr, NDR_SCALARS, &length));
 	}
 	NDR_PULL_NEED_BYTES(ndr, length);
-	*blob = data_blob_talloc(ndr->current_mem_ctx, ndr->data+ndr->offset, length);
+	if (ndr->flags & LIBNDR_FLAG_BORROW) {
+		/* the caller guarantees the source buffer stays around */
+		*blob = data_blob_const(ndr->data+ndr->offset, length);
+	} else {
+		*blob = data_blob_talloc(ndr->current_mem_ctx, ndr->data+ndr->offset, length);
+	}
 	ndr->offset += length;
 	return NDR_ERR_SUCCESS;
 }
@@ -394,6 +394,18 @@ enum ndr_err_code ndr_pull_compression_start(struct ndr_pull *subndr,
 	ndrpush = ndr_push_init_ctx(subndr);
 	NDR_ERR_HAVE_NO_MEMORY(ndrpush);
 
+	/*
+	 * The decompressed length is known up front, so size the
+	 * output buffer once. Growing it chunk by chunk keeps the old
+	 * and the new allocation alive across every realloc, which
+	 * roughly doubles peak memory on large replication blobs.
+	 * Implausible lengths fall back to incremental growth and are
+	 * caught by the length check below.
+	 */
+	if (decompressed_len > 0 && decompressed_len <= 0x40000000) {
+		NDR_CHECK(ndr_push_expand(ndrpush, decompressed_len));
+	}
+
 	switch (compression_alg) {
 	case NDR_COMPRESSION_MSZIP:
 		ZERO_STRUCT(z);
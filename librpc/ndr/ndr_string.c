@@ -146,14 +146,25 @@ _PUBLIC_ enum ndr_err_code ndr_pull_string(struct ndr_pull *ndr, int ndr_flags,
 		converted_size = 0;
 	} else {
 		if (!do_convert) {
-			as = talloc_strndup(ndr->current_mem_ctx,
-			                    (char *)ndr->data + ndr->offset,
-					    conv_src_len);
-			if (!as) {
-				return ndr_pull_error(ndr, NDR_ERR_ALLOC,
-						      "Failed to talloc_strndup() in RAW8 ndr_string_pull()");
+			const char *src = (const char *)ndr->data + ndr->offset;
+			const char *nul = memchr(src, '\0', conv_src_len);
+
+			if ((ndr->flags & LIBNDR_FLAG_BORROW) && nul != NULL) {
+				/*
+				 * no conversion needed and terminated on
+				 * the wire, reference the source buffer
+				 */
+				as = discard_const_p(char, src);
+				converted_size = (nul - src) + 1;
+			} else {
+				as = talloc_strndup(ndr->current_mem_ctx,
+						    src, conv_src_len);
+				if (!as) {
+					return ndr_pull_error(ndr, NDR_ERR_ALLOC,
+							      "Failed to talloc_strndup() in RAW8 ndr_string_pull()");
+				}
+				converted_size = MIN(strlen(as)+1, conv_src_len);
 			}
-			converted_size = MIN(strlen(as)+1, conv_src_len);
 		} else if (!convert_string_talloc(ndr->current_mem_ctx, chset,
 					   CH_UNIX, ndr->data + ndr->offset,
 					   conv_src_len * byte_mul,
@@ -472,7 +472,13 @@ static void dcerpc_binding_handle_call_done(struct tevent_req *subreq)
 		state->pull->flags &= ~LIBNDR_FLAG_BIGENDIAN;
 	}
 
-	state->pull->current_mem_ctx = state->r_mem;
+	/* unmarshal into a pool, a large response costs one malloc */
+	ndr_err = ndr_pull_set_mem_pool(state->pull, state->r_mem);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		error = ndr_map_error2ntstatus(ndr_err);
+		tevent_req_nterror(req, error);
+		return;
+	}
 
 	/* pull the structure from the blob */
 	ndr_err = state->call->ndr_pull(state->pull, NDR_OUT, state->r_ptr);
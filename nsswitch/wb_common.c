@@ -25,7 +25,12 @@
 
 #include "replace.h"
 #include "system/select.h"
+#include "system/filesys.h"
 #include "winbind_client.h"
+#include "winbind_nss_export.h"
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 /* Global context */
 
@@ -350,6 +355,188 @@ static const char *winbindd_socket_dir(void)
 	return WINBINDD_SOCKET_DIR;
 }
 
+/*
+ * Read-only fast path: winbindd exports its hottest passwd entries
+ * into a flat file in the socket directory (see winbind_nss_export.h)
+ * which we mmap and consult before paying a socket round-trip. The
+ * file is only ever replaced atomically via rename, so an established
+ * mapping is immutable and readers need no locks. These helpers keep
+ * static state and rely on the caller's serialization (the nss module
+ * lock).
+ */
+
+#ifdef HAVE_MMAP
+
+static struct {
+	void *map;
+	size_t maplen;
+	dev_t dev;
+	ino_t ino;
+} winbind_nss_export;
+
+static bool winbind_nss_export_refresh(void)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	struct winbind_nss_export_hdr *hdr;
+	void *map;
+	int fd, len;
+
+	len = snprintf(path, sizeof(path), "%s/%s", winbindd_socket_dir(),
+		       WINBIND_NSS_EXPORT_FILE);
+	if ((len <= 0) || (len >= (int)sizeof(path))) {
+		return false;
+	}
+
+	if (stat(path, &st) != 0) {
+		goto fail;
+	}
+
+	if ((winbind_nss_export.map != NULL) &&
+	    (st.st_dev == winbind_nss_export.dev) &&
+	    (st.st_ino == winbind_nss_export.ino)) {
+		/* the mapping is still current */
+		return true;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		goto fail;
+	}
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		goto fail;
+	}
+	if ((size_t)st.st_size < sizeof(struct winbind_nss_export_hdr)) {
+		close(fd);
+		goto fail;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		goto fail;
+	}
+
+	hdr = (struct winbind_nss_export_hdr *)map;
+	if ((hdr->magic != WINBIND_NSS_EXPORT_MAGIC) ||
+	    (hdr->version != WINBIND_NSS_EXPORT_VERSION) ||
+	    (hdr->num_users > ((size_t)st.st_size /
+			       sizeof(struct winbindd_pw))) ||
+	    ((size_t)st.st_size != (sizeof(*hdr) +
+				    hdr->num_users *
+				    sizeof(struct winbindd_pw)))) {
+		munmap(map, st.st_size);
+		goto fail;
+	}
+
+	if (winbind_nss_export.map != NULL) {
+		munmap(winbind_nss_export.map, winbind_nss_export.maplen);
+	}
+	winbind_nss_export.map = map;
+	winbind_nss_export.maplen = st.st_size;
+	winbind_nss_export.dev = st.st_dev;
+	winbind_nss_export.ino = st.st_ino;
+	return true;
+
+fail:
+	if (winbind_nss_export.map != NULL) {
+		munmap(winbind_nss_export.map, winbind_nss_export.maplen);
+		winbind_nss_export.map = NULL;
+	}
+	return false;
+}
+
+static bool winbind_nss_export_valid(
+	const struct winbind_nss_export_hdr **phdr,
+	const struct winbindd_pw **pusers)
+{
+	const struct winbind_nss_export_hdr *hdr;
+
+	if (!winbind_nss_export_refresh()) {
+		return false;
+	}
+
+	hdr = (const struct winbind_nss_export_hdr *)winbind_nss_export.map;
+
+	if (time(NULL) >= (time_t)hdr->timeout) {
+		/* winbindd stopped refreshing it, don't serve stale data */
+		return false;
+	}
+
+	*phdr = hdr;
+	*pusers = (const struct winbindd_pw *)(const void *)(hdr + 1);
+	return true;
+}
+
+bool winbind_nss_export_lookup_uid(uid_t uid, struct winbindd_pw *pw)
+{
+	const struct winbind_nss_export_hdr *hdr;
+	const struct winbindd_pw *users;
+	uint32_t lo, hi;
+
+	if (!winbind_nss_export_valid(&hdr, &users)) {
+		return false;
+	}
+
+	/* the entries are sorted by uid */
+	lo = 0;
+	hi = hdr->num_users;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (users[mid].pw_uid == uid) {
+			*pw = users[mid];
+			return true;
+		}
+		if (users[mid].pw_uid < uid) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return false;
+}
+
+bool winbind_nss_export_lookup_name(const char *name, struct winbindd_pw *pw)
+{
+	const struct winbind_nss_export_hdr *hdr;
+	const struct winbindd_pw *users;
+	uint32_t i;
+
+	if (name == NULL) {
+		return false;
+	}
+	if (!winbind_nss_export_valid(&hdr, &users)) {
+		return false;
+	}
+
+	for (i=0; i<hdr->num_users; i++) {
+		if (strcasecmp(users[i].pw_name, name) == 0) {
+			*pw = users[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+#else
+
+bool winbind_nss_export_lookup_uid(uid_t uid, struct winbindd_pw *pw)
+{
+	return false;
+}
+
+bool winbind_nss_export_lookup_name(const char *name, struct winbindd_pw *pw)
+{
+	return false;
+}
+
+#endif /* HAVE_MMAP */
+
 /* Connect to winbindd socket */
 
 static int winbind_open_pipe_sock(struct winbindd_context *ctx,
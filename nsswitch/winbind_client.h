@@ -44,6 +44,9 @@ NSS_STATUS winbindd_request_response(struct winbindd_context *ctx,
 				     int req_type,
 				     struct winbindd_request *request,
 				     struct winbindd_response *response);
+bool winbind_nss_export_lookup_uid(uid_t uid, struct winbindd_pw *pw);
+bool winbind_nss_export_lookup_name(const char *name,
+				    struct winbindd_pw *pw);
 NSS_STATUS winbindd_priv_request_response(struct winbindd_context *ctx,
 					  int req_type,
 					  struct winbindd_request *request,
@@ -0,0 +1,53 @@
+/*
+   Unix SMB/CIFS implementation.
+
+   Shared-memory export of hot winbindd passwd entries
+
+   Copyright (C) Volker Lendecke 2015
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WINBIND_NSS_EXPORT_H
+#define _WINBIND_NSS_EXPORT_H
+
+#include "winbind_struct_protocol.h"
+
+/*
+ * winbindd periodically dumps its hottest passwd entries into a flat
+ * file in the winbindd socket directory. The nss_winbind clients mmap
+ * it read-only and consult it before talking to the socket.
+ *
+ * The file is always replaced atomically via rename(2), so a mapped
+ * copy is immutable and readers need no locks at all. Readers detect
+ * replacement by stat()ing the file. The layout is a header followed
+ * by hdr.num_users fixed-size struct winbindd_pw records sorted by
+ * pw_uid; both sides share the struct definition via
+ * winbind_struct_protocol.h, so there are no portability concerns
+ * beyond one machine.
+ */
+
+#define WINBIND_NSS_EXPORT_FILE "nss_passwd_cache"
+
+#define WINBIND_NSS_EXPORT_MAGIC 0x57424e45 /* WBNE */
+#define WINBIND_NSS_EXPORT_VERSION 1
+
+struct winbind_nss_export_hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_users;
+	uint32_t timeout;	/* unix time after which the map is stale */
+};
+
+#endif /* _WINBIND_NSS_EXPORT_H */
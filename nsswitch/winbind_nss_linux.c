@@ -569,7 +569,13 @@ _nss_winbind_getpwuid_r(uid_t uid, struct passwd *result, char *buffer,
 
 		request.data.uid = uid;
 
-		ret = winbindd_request_response(NULL, WINBINDD_GETPWUID, &request, &response);
+		if (winbind_nss_export_lookup_uid(uid, &response.data.pw)) {
+			/* served from winbindd's shared-memory export */
+			ret = NSS_STATUS_SUCCESS;
+		} else {
+			ret = winbindd_request_response(
+				NULL, WINBINDD_GETPWUID, &request, &response);
+		}
 
 		if (ret == NSS_STATUS_SUCCESS) {
 			ret = fill_pwent(result, &response.data.pw,
@@ -645,7 +651,13 @@ _nss_winbind_getpwnam_r(const char *name, struct passwd *result, char *buffer,
 		request.data.username
 			[sizeof(request.data.username) - 1] = '\0';
 
-		ret = winbindd_request_response(NULL, WINBINDD_GETPWNAM, &request, &response);
+		if (winbind_nss_export_lookup_name(name, &response.data.pw)) {
+			/* served from winbindd's shared-memory export */
+			ret = NSS_STATUS_SUCCESS;
+		} else {
+			ret = winbindd_request_response(
+				NULL, WINBINDD_GETPWNAM, &request, &response);
+		}
 
 		if (ret == NSS_STATUS_SUCCESS) {
 			ret = fill_pwent(result, &response.data.pw, &buffer,
@@ -1072,6 +1072,7 @@ my %property_list = (
 	"relative_base"		=> ["TYPEDEF", "STRUCT", "UNION"],
 
 	"gensize"		=> ["TYPEDEF", "STRUCT", "UNION"],
+	"ndr_flat"		=> ["TYPEDEF", "STRUCT"],
 	"value"			=> ["ELEMENT"],
 	"flag"			=> ["ELEMENT", "TYPEDEF", "STRUCT", "UNION", "ENUM", "BITMAP", "PIPE"],
 
@@ -1351,6 +1351,133 @@ sub CheckRefPtrs($$$$)
 	$self->pidl("}");
 }
 
+# scalar types a [ndr_flat] fast path marshaller can handle. The
+# 1632/3264 types are listed with their NDR sizes, which is valid
+# because the fast path is never taken with LIBNDR_FLAG_NDR64 set.
+my %flat_scalar_info = (
+	"int8"		=> { SIZE => 1, SIGNED => 1 },
+	"uint8"		=> { SIZE => 1 },
+	"int16"		=> { SIZE => 2, SIGNED => 1 },
+	"uint16"	=> { SIZE => 2 },
+	"int1632"	=> { SIZE => 2, SIGNED => 1 },
+	"uint1632"	=> { SIZE => 2 },
+	"int32"		=> { SIZE => 4, SIGNED => 1 },
+	"uint32"	=> { SIZE => 4 },
+	"int3264"	=> { SIZE => 4, SIGNED => 1 },
+	"uint3264"	=> { SIZE => 4 },
+	"hyper"		=> { SIZE => 8 },
+	"dlong"		=> { SIZE => 8, SIGNED => 1, ALIGN => 4 },
+	"udlong"	=> { SIZE => 8, ALIGN => 4 },
+);
+
+sub flat_element_info($$)
+{
+	my ($self, $e) = @_;
+	my $name;
+
+	if (defined($e->{PROPERTIES}) and scalar(keys %{$e->{PROPERTIES}}) > 0) {
+		return undef;
+	}
+	return undef unless (scalar(@{$e->{LEVELS}}) == 1);
+	return undef unless ($e->{LEVELS}[0]->{TYPE} eq "DATA");
+
+	$name = Parse::Pidl::Typelist::expandAlias($e->{LEVELS}[0]->{DATA_TYPE});
+	if (not defined($flat_scalar_info{$name}) and hasType($name)) {
+		my $dt = getType($name)->{DATA};
+		if ($dt->{TYPE} eq "ENUM") {
+			$name = Parse::Pidl::Typelist::enum_type_fn($dt);
+		} elsif ($dt->{TYPE} eq "BITMAP") {
+			$name = Parse::Pidl::Typelist::bitmap_type_fn($dt);
+		} else {
+			return undef;
+		}
+	}
+	return $flat_scalar_info{$name};
+}
+
+# work out the fixed wire layout of a [ndr_flat] struct, or undef if
+# the struct does not qualify for a fast path
+sub flat_struct_layout($$)
+{
+	my ($self, $struct) = @_;
+	my $ofs = 0;
+	my @fields = ();
+
+	return undef unless has_property($struct, "ndr_flat");
+
+	if (defined($struct->{SURROUNDING_ELEMENT}) or
+	    defined($struct->{PROPERTIES}{relative_base})) {
+		warning($struct, "[ndr_flat] ignored: struct does not have a fixed flat layout");
+		return undef;
+	}
+
+	foreach my $e (@{$struct->{ELEMENTS}}) {
+		my $info = $self->flat_element_info($e);
+		my $align;
+		my $pad;
+
+		if (not defined($info)) {
+			warning($struct, "[ndr_flat] ignored: element $e->{NAME} is not a fixed-size scalar");
+			return undef;
+		}
+		$align = defined($info->{ALIGN}) ? $info->{ALIGN} : $info->{SIZE};
+		$pad = ($align - ($ofs % $align)) % $align;
+		push(@fields, { E => $e, PAD_OFS => $ofs, PAD => $pad,
+				OFFSET => $ofs + $pad, SIZE => $info->{SIZE},
+				SIGNED => $info->{SIGNED} });
+		$ofs += $pad + $info->{SIZE};
+	}
+	return { FIELDS => \@fields, SIZE => $ofs };
+}
+
+sub ParseStructPushFlat($$$$$)
+{
+	my ($self, $layout, $struct, $ndr, $varname) = @_;
+
+	$self->pidl("NDR_CHECK(ndr_push_align($ndr, $struct->{ALIGN}));");
+	$self->pidl("NDR_PUSH_NEED_BYTES($ndr, $layout->{SIZE});");
+	foreach my $f (@{$layout->{FIELDS}}) {
+		my $val = "$varname->$f->{E}->{NAME}";
+
+		if ($f->{PAD} > 0) {
+			$self->pidl("memset($ndr->data + $ndr->offset + $f->{PAD_OFS}, 0, $f->{PAD});");
+		}
+		if ($f->{SIZE} == 1) {
+			$self->pidl("SCVAL($ndr->data, $ndr->offset + $f->{OFFSET}, $val);");
+		} elsif ($f->{SIZE} == 2) {
+			$self->pidl("SSVAL($ndr->data, $ndr->offset + $f->{OFFSET}, $val);");
+		} elsif ($f->{SIZE} == 4) {
+			$self->pidl("SIVAL($ndr->data, $ndr->offset + $f->{OFFSET}, $val);");
+		} else {
+			$self->pidl("SBVAL($ndr->data, $ndr->offset + $f->{OFFSET}, $val);");
+		}
+	}
+	$self->pidl("$ndr->offset += $layout->{SIZE};");
+}
+
+sub ParseStructPullFlat($$$$$)
+{
+	my ($self, $layout, $struct, $ndr, $varname) = @_;
+
+	$self->pidl("NDR_CHECK(ndr_pull_align($ndr, $struct->{ALIGN}));");
+	$self->pidl("NDR_PULL_NEED_BYTES($ndr, $layout->{SIZE});");
+	foreach my $f (@{$layout->{FIELDS}}) {
+		my $dst = "$varname->$f->{E}->{NAME}";
+		my $src = "$ndr->data, $ndr->offset + $f->{OFFSET}";
+
+		if ($f->{SIZE} == 1) {
+			$self->pidl("$dst = " . ($f->{SIGNED} ? "(int8_t)" : "") . "CVAL($src);");
+		} elsif ($f->{SIZE} == 2) {
+			$self->pidl("$dst = " . ($f->{SIGNED} ? "(int16_t)" : "") . "SVAL($src);");
+		} elsif ($f->{SIZE} == 4) {
+			$self->pidl("$dst = " . ($f->{SIGNED} ? "IVALS($src)" : "IVAL($src)") . ";");
+		} else {
+			$self->pidl("$dst = " . ($f->{SIGNED} ? "(int64_t)" : "") . "BVAL($src);");
+		}
+	}
+	$self->pidl("$ndr->offset += $layout->{SIZE};");
+}
+
 sub ParseStructPushPrimitives($$$$$)
 {
 	my ($self, $struct, $ndr, $varname, $env) = @_;
@@ -1431,7 +1558,20 @@ sub ParseStructPush($$$$)
 	$self->pidl("NDR_PUSH_CHECK_FLAGS(ndr, ndr_flags);");
 	$self->pidl("if (ndr_flags & NDR_SCALARS) {");
 	$self->indent;
-	$self->ParseStructPushPrimitives($struct, $ndr, $varname, $env);
+	my $layout = $self->flat_struct_layout($struct);
+	if (defined($layout)) {
+		$self->pidl("if (likely(!($ndr->flags & LIBNDR_FLAT_UNSAFE_FLAGS))) {");
+		$self->indent;
+		$self->ParseStructPushFlat($layout, $struct, $ndr, $varname);
+		$self->deindent;
+		$self->pidl("} else {");
+		$self->indent;
+		$self->ParseStructPushPrimitives($struct, $ndr, $varname, $env);
+		$self->deindent;
+		$self->pidl("}");
+	} else {
+		$self->ParseStructPushPrimitives($struct, $ndr, $varname, $env);
+	}
 	$self->deindent;
 	$self->pidl("}");
 
@@ -1754,7 +1894,20 @@ sub ParseStructPull($$$$)
 	$self->pidl("NDR_PULL_CHECK_FLAGS(ndr, ndr_flags);");
 	$self->pidl("if (ndr_flags & NDR_SCALARS) {");
 	$self->indent;
-	$self->ParseStructPullPrimitives($struct,$ndr,$varname,$env);
+	my $layout = $self->flat_struct_layout($struct);
+	if (defined($layout)) {
+		$self->pidl("if (likely(!($ndr->flags & LIBNDR_FLAT_UNSAFE_FLAGS))) {");
+		$self->indent;
+		$self->ParseStructPullFlat($layout, $struct, $ndr, $varname);
+		$self->deindent;
+		$self->pidl("} else {");
+		$self->indent;
+		$self->ParseStructPullPrimitives($struct,$ndr,$varname,$env);
+		$self->deindent;
+		$self->pidl("}");
+	} else {
+		$self->ParseStructPullPrimitives($struct,$ndr,$varname,$env);
+	}
 	$self->deindent;
 	$self->pidl("}");
 	$self->pidl("if (ndr_flags & NDR_BUFFERS) {");
@@ -211,6 +211,9 @@ NTSTATUS auth_generic_prepare(TALLOC_CTX *mem_ctx,
 			return nt_status;
 		}
 	} else {
+		static char *dns_name_lower;
+		static char *dns_domain_lower;
+		static struct cli_credentials *server_credentials_cached;
 		const struct gensec_security_ops **backends = NULL;
 		struct gensec_settings *gensec_settings;
 		struct loadparm_context *lp_ctx;
@@ -245,24 +248,43 @@ NTSTATUS auth_generic_prepare(TALLOC_CTX *mem_ctx,
 		 *
 		 * This is used for the NTLMSSP server
 		 *
+		 * The names do not change within the process, so they
+		 * are only derived once and reused for the session
+		 * setups that follow.
 		 */
-		dns_name = get_mydnsfullname();
-		if (dns_name == NULL) {
-			dns_name = "";
+		if (dns_name_lower == NULL) {
+			dns_name = get_mydnsfullname();
+			if (dns_name == NULL) {
+				dns_name = "";
+			}
+			dns_name_lower = strlower_talloc(NULL, dns_name);
+			if (dns_name_lower == NULL) {
+				TALLOC_FREE(tmp_ctx);
+				return NT_STATUS_NO_MEMORY;
+			}
 		}
 
-		dns_domain = get_mydnsdomname(tmp_ctx);
-		if (dns_domain == NULL) {
-			dns_domain = "";
+		if (dns_domain_lower == NULL) {
+			dns_domain = get_mydnsdomname(tmp_ctx);
+			if (dns_domain == NULL) {
+				dns_domain = "";
+			}
+			dns_domain_lower = strlower_talloc(NULL, dns_domain);
+			if (dns_domain_lower == NULL) {
+				TALLOC_FREE(tmp_ctx);
+				return NT_STATUS_NO_MEMORY;
+			}
 		}
 
-		gensec_settings->server_dns_name = strlower_talloc(gensec_settings, dns_name);
+		gensec_settings->server_dns_name =
+			talloc_strdup(gensec_settings, dns_name_lower);
 		if (gensec_settings->server_dns_name == NULL) {
 			TALLOC_FREE(tmp_ctx);
 			return NT_STATUS_NO_MEMORY;
 		}
 
-		gensec_settings->server_dns_domain = strlower_talloc(gensec_settings, dns_domain);
+		gensec_settings->server_dns_domain =
+			talloc_strdup(gensec_settings, dns_domain_lower);
 		if (gensec_settings->server_dns_domain == NULL) {
 			TALLOC_FREE(tmp_ctx);
 			return NT_STATUS_NO_MEMORY;
@@ -293,21 +315,32 @@ NTSTATUS auth_generic_prepare(TALLOC_CTX *mem_ctx,
 
 		/*
 		 * This is anonymous for now, because we just use it
-		 * to set the kerberos state at the moment
+		 * to set the kerberos state at the moment.
+		 *
+		 * It only carries configuration derived state, so it
+		 * is built once and shared by all session setups of
+		 * this process; gensec_set_credentials() merely
+		 * talloc_reference()s it.
 		 */
-		server_credentials = cli_credentials_init_anon(tmp_ctx);
-		if (!server_credentials) {
-			DEBUG(0, ("auth_generic_prepare: Failed to init server credentials\n"));
-			return NT_STATUS_NO_MEMORY;
-		}
-
-		cli_credentials_set_conf(server_credentials, lp_ctx);
-
-		if (lp_security() == SEC_ADS || USE_KERBEROS_KEYTAB) {
-			cli_credentials_set_kerberos_state(server_credentials, CRED_AUTO_USE_KERBEROS);
-		} else {
-			cli_credentials_set_kerberos_state(server_credentials, CRED_DONT_USE_KERBEROS);
+		if (server_credentials_cached == NULL) {
+			server_credentials = cli_credentials_init_anon(NULL);
+			if (!server_credentials) {
+				DEBUG(0, ("auth_generic_prepare: Failed to init server credentials\n"));
+				TALLOC_FREE(tmp_ctx);
+				return NT_STATUS_NO_MEMORY;
+			}
+
+			cli_credentials_set_conf(server_credentials, lp_ctx);
+
+			if (lp_security() == SEC_ADS || USE_KERBEROS_KEYTAB) {
+				cli_credentials_set_kerberos_state(server_credentials, CRED_AUTO_USE_KERBEROS);
+			} else {
+				cli_credentials_set_kerberos_state(server_credentials, CRED_DONT_USE_KERBEROS);
+			}
+
+			server_credentials_cached = server_credentials;
 		}
+		server_credentials = server_credentials_cached;
 
 		nt_status = gensec_server_start(tmp_ctx, gensec_settings,
 						auth4_context, &gensec_security);
@@ -320,7 +353,6 @@ NTSTATUS auth_generic_prepare(TALLOC_CTX *mem_ctx,
 		gensec_set_credentials(gensec_security, server_credentials);
 
 		talloc_unlink(tmp_ctx, lp_ctx);
-		talloc_unlink(tmp_ctx, server_credentials);
 		talloc_unlink(tmp_ctx, gensec_settings);
 		talloc_unlink(tmp_ctx, auth4_context);
 	}
@@ -144,6 +144,9 @@ struct tar {
 	/* nb of bytes received */
 	uint64_t total_size;
 
+	/* time spent downloading file data, in ms */
+	uint64_t total_time_ms;
+
 	/* path to tar archive name */
 	char *tar_path;
 
@@ -433,6 +436,7 @@ int tar_parse_args(struct tar* t,
 	t->mode.dry = false;
 	t->to_process = false;
 	t->total_size = 0;
+	t->total_time_ms = 0;
 
 	while (flag[0] != '\0') {
 		switch(flag[0]) {
@@ -709,7 +713,9 @@ static int tar_create(struct tar* t)
 	}
 
 out_close:
-	DBG(0, ("Total bytes received: %" PRIu64 "\n", t->total_size));
+	DBG(0, ("Total bytes received: %" PRIu64 " (%3.1f KiloBytes/sec)\n",
+		t->total_size,
+		t->total_size / (1.024*t->total_time_ms + 1.0e-4)));
 
 	if (!t->mode.dry) {
 		r = archive_write_close(t->archive);
@@ -872,6 +878,26 @@ out:
 	return status;
 }
 
+/**
+ * tar_get_file_sink - callback of the cli_pull() engine
+ *
+ * Writes a chunk of file data to the archive while cli_pull() keeps
+ * further reads in flight on the wire, so that the network transfer
+ * overlaps the local tar output.
+ */
+static NTSTATUS tar_get_file_sink(char *buf, size_t n, void *priv)
+{
+	struct tar *t = (struct tar *)priv;
+	int r;
+
+	r = archive_write_data(t->archive, buf, n);
+	if (r < 0) {
+		DBG(0, ("Fatal: %s\n", archive_error_string(t->archive)));
+		return NT_STATUS_UNSUCCESSFUL;
+	}
+	return NT_STATUS_OK;
+}
+
 /**
  * tar_get_file - fetch a remote file to the local archive
  * @full_dos_path: path to the file to fetch
@@ -885,9 +911,9 @@ static int tar_get_file(struct tar *t,
 	NTSTATUS status;
 	struct archive_entry *entry;
 	char *full_unix_path;
-	char buf[TAR_CLI_READ_SIZE];
-	size_t len;
-	uint64_t off = 0;
+	struct timespec tp_start, tp_end;
+	uint64_t this_time_ms;
+	off_t nread = 0;
 	uint16_t remote_fd = (uint16_t)-1;
 	int err = 0, r;
 	const bool isdir = finfo->mode & FILE_ATTRIBUTE_DIRECTORY;
@@ -958,25 +984,31 @@ static int tar_get_file(struct tar *t,
 		goto out_entry;
 	}
 
-	do {
-		status = cli_read(cli, remote_fd, buf, off, sizeof(buf), &len);
-		if (!NT_STATUS_IS_OK(status)) {
-			DBG(0,("Error reading file %s : %s\n",
-						full_dos_path, nt_errstr(status)));
-			err = 1;
-			goto out_close;
-		}
+	clock_gettime_mono(&tp_start);
 
-		off += len;
+	/*
+	 * cli_pull() keeps a window of reads outstanding, so the next
+	 * chunks are already on the wire while tar_get_file_sink()
+	 * writes the current one to the archive.
+	 */
+	status = cli_pull(cli, remote_fd, 0, finfo->size, TAR_CLI_READ_SIZE,
+			  tar_get_file_sink, t, &nread);
+	if (!NT_STATUS_IS_OK(status)) {
+		DBG(0,("Error reading file %s : %s\n",
+					full_dos_path, nt_errstr(status)));
+		err = 1;
+		goto out_close;
+	}
 
-		r = archive_write_data(t->archive, buf, len);
-		if (r < 0) {
-			DBG(0, ("Fatal: %s\n", archive_error_string(t->archive)));
-			err = 1;
-			goto out_close;
-		}
+	clock_gettime_mono(&tp_end);
+	this_time_ms = nsec_time_diff(&tp_end, &tp_start)/1000000;
+	t->total_time_ms += this_time_ms;
 
-	} while (off < finfo->size);
+	DBG(2, ("pulled %jd bytes for %s (%3.1f KiloBytes/sec) "
+		"(average %3.1f KiloBytes/sec)\n",
+		(intmax_t)nread, full_dos_path,
+		nread / (1.024*this_time_ms + 1.0e-4),
+		t->total_size / (1.024*t->total_time_ms + 1.0e-4)));
 
 out_close:
 	cli_close(cli, remote_fd);
@@ -1675,6 +1707,7 @@ static void tar_dump(struct tar *t)
 	XBOOL(t->mode.dry);
 	XBOOL(t->mode.verbose);
 	XUINT64(t->total_size);
+	XUINT64(t->total_time_ms);
 	XSTR(t->tar_path);
 	XINT(t->path_list_size);
 
@@ -42,6 +42,7 @@ struct print_job_info {
 
 struct smbXcli_conn;
 struct smbXcli_session;
+struct cli_conn_share;
 
 struct cli_state {
 	/**
@@ -90,6 +91,16 @@ struct cli_state {
 	struct smbXcli_conn *conn;
 	const char *remote_realm;
 
+	/**
+	 * Several cli_states can share one transport and session
+	 * (SMB2 tcon multiplexing). All members of such a group point
+	 * at the same refcounted tracker, the transport and session
+	 * hang off the tracker so that they survive until the last
+	 * member is shut down. NULL if this cli_state owns its
+	 * transport alone. See cli_state_share_conn().
+	 */
+	struct cli_conn_share *conn_share;
+
 	struct {
 		uint16_t pid;
 		uint16_t vc_num;
@@ -112,6 +112,12 @@ struct _SMBCFILE {
 	struct smbc_dir_list *dir_list, *dir_end, *dir_next;
 	int dir_type, dir_error;
 
+	/*
+	 * Optional read-ahead/write-behind cache, NULL unless
+	 * smbc_setOptionFileCacheSize() was used. See libsmb_file.c.
+	 */
+	struct smbc_file_cache *cache;
+
 	SMBCFILE *next, *prev;
 };
 
@@ -187,6 +193,13 @@ struct SMBC_internal_data {
          */
         bool                                    case_sensitive;
 
+        /*
+         * Size in bytes of the per-file read-ahead/write-behind
+         * cache, 0 disables caching.  See
+         * smbc_setOptionFileCacheSize().
+         */
+        size_t                                  file_cache_size;
+
 	/*
 	 * Auth info needed for DFS traversal.
 	 */
@@ -269,6 +282,12 @@ SMBC_get_cached_server(SMBCCTX * context,
                        const char * workgroup,
                        const char * user);
 
+struct cli_state *
+SMBC_get_cached_transport(SMBCCTX * context,
+                          const char * server,
+                          const char * workgroup,
+                          const char * user);
+
 int
 SMBC_remove_cached_server(SMBCCTX * context,
                           SMBCSRV * server);
@@ -419,6 +438,13 @@ SMBC_ftruncate_ctx(SMBCCTX *context,
                    SMBCFILE *file,
                    off_t length);
 
+int
+SMBC_fcache_flush(SMBCCTX *context,
+                  SMBCFILE *file);
+
+void
+SMBC_fcache_free(SMBCFILE *file);
+
 
 /* Functions in libsmb_misc.c */
 int
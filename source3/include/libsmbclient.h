@@ -765,6 +765,25 @@ smbc_getOptionUseNTHash(SMBCCTX *c);
 void
 smbc_setOptionUseNTHash(SMBCCTX *c, smbc_bool b);
 
+/** Get the per-file cache size for read-ahead and write-behind */
+size_t
+smbc_getOptionFileCacheSize(SMBCCTX *c);
+
+/**
+ * Set the per-file cache size for read-ahead and write-behind.
+ *
+ * When set to a non-zero number of bytes, every file opened
+ * afterwards gets a private buffer of that size.  Reads smaller than
+ * the buffer are served from read-ahead data, and small sequential
+ * writes are coalesced into one wire write when the buffer fills up,
+ * when the file is closed, fstat()ed or seeked to its end.  With the
+ * default of 0 every smbc_read()/smbc_write() call is a synchronous
+ * wire round trip, which preserves strict sharing semantics but is
+ * slow for small sequential I/O on high latency links.
+ */
+void
+smbc_setOptionFileCacheSize(SMBCCTX *c, size_t size);
+
 
 
 /*************************************
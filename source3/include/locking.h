@@ -63,6 +63,16 @@ struct lock_struct {
 	enum brl_flavour lock_flav;
 };
 
+/* Optional payload of MSG_SMB_UNLOCK, naming the range that got
+   unlocked. A zero-length message still means "recheck all pending
+   locks". */
+
+struct unlock_msg {
+	struct file_id id;
+	br_off offset;
+	br_off count;
+};
+
 /****************************************************************************
  This is the structure to queue to implement blocking locks.
 *****************************************************************************/
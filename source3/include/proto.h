@@ -143,6 +143,13 @@ char *escape_rdn_val_string_alloc(const char *s);
 
 int ms_fnmatch(const char *pattern, const char *string, bool translate_pattern,
 	       bool is_case_sensitive);
+struct ms_fnmatch_compiled;
+struct ms_fnmatch_compiled *ms_fnmatch_compile(TALLOC_CTX *mem_ctx,
+					       const char *pattern,
+					       bool translate_pattern,
+					       bool is_case_sensitive);
+int ms_fnmatch_compiled(struct ms_fnmatch_compiled *compiled,
+			const char *string);
 
 /* The following definitions come from lib/recvfile.c  */
 
@@ -302,6 +309,14 @@ bool getgroups_unix_user(TALLOC_CTX *mem_ctx, const char *user,
 
 void register_msg_pool_usage(struct messaging_context *msg_ctx);
 
+/* The following definitions come from lib/teventmsg.c  */
+
+void register_msg_event_profile(struct messaging_context *msg_ctx);
+
+/* The following definitions come from lib/memcachemsg.c  */
+
+void register_msg_memcache_stats(struct messaging_context *msg_ctx);
+
 /* The following definitions come from lib/time.c  */
 
 void push_dos_date(uint8_t *buf, int offset, time_t unixdate, int zone_offset);
@@ -425,6 +440,11 @@ bool parent_dirname(TALLOC_CTX *mem_ctx, const char *dir, char **parent,
 bool ms_has_wild(const char *s);
 bool ms_has_wild_w(const smb_ucs2_t *s);
 bool mask_match(const char *string, const char *pattern, bool is_case_sensitive);
+struct ms_fnmatch_compiled *mask_match_compile(TALLOC_CTX *mem_ctx,
+					       const char *pattern,
+					       bool is_case_sensitive);
+bool mask_match_compiled(const char *string,
+			 struct ms_fnmatch_compiled *compiled);
 bool mask_match_search(const char *string, const char *pattern, bool is_case_sensitive);
 bool mask_match_list(const char *string, char **list, int listLen, bool is_case_sensitive);
 bool unix_wild_match(const char *pattern, const char *string);
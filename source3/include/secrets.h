@@ -85,6 +85,9 @@ struct afs_keyfile {
 bool secrets_init_path(const char *private_dir);
 bool secrets_init(void);
 struct db_context *secrets_db_ctx(void);
+int secrets_transaction_start(void);
+int secrets_transaction_commit(void);
+int secrets_transaction_cancel(void);
 void secrets_shutdown(void);
 void *secrets_fetch(const char *key, size_t *size);
 bool secrets_store(const char *key, const void *data, size_t size);
@@ -296,11 +296,31 @@ struct smbprofile_stats_basic_async {
 	struct smbprofile_stats_basic *stats;
 };
 
+/*
+ * log2 latency histogram: bucket i counts operations that took
+ * between 2^i and 2^(i+1) microseconds, the last bucket takes
+ * everything above. 32 buckets cover up to ~71 minutes.
+ */
+#define SMBPROFILE_TIME_HIST_BUCKETS 32
+
+static inline void smbprofile_update_hist(uint64_t *hist, uint64_t elapsed_usec)
+{
+	unsigned int bucket = 0;
+
+	while (elapsed_usec > 1 &&
+	       bucket < (SMBPROFILE_TIME_HIST_BUCKETS - 1)) {
+		elapsed_usec >>= 1;
+		bucket += 1;
+	}
+	hist[bucket] += 1;
+}
+
 struct smbprofile_stats_bytes {
 	uint64_t count;		/* number of events */
 	uint64_t time;		/* microseconds */
 	uint64_t idle;		/* idle time compared to 'time' microseconds */
 	uint64_t bytes;		/* bytes */
+	uint64_t time_hist[SMBPROFILE_TIME_HIST_BUCKETS];
 };
 
 struct smbprofile_stats_bytes_async {
@@ -316,6 +336,7 @@ struct smbprofile_stats_iobytes {
 	uint64_t idle;		/* idle time compared to 'time' microseconds */
 	uint64_t inbytes;	/* bytes read */
 	uint64_t outbytes;	/* bytes written */
+	uint64_t time_hist[SMBPROFILE_TIME_HIST_BUCKETS];
 };
 
 struct smbprofile_stats_iobytes_async {
@@ -428,9 +449,13 @@ struct profile_stats {
 } while(0)
 #define _SMBPROFILE_TIMER_ASYNC_END(_async) do { \
 	if ((_async).start != 0) { \
+		uint64_t __profile_elapsed; \
 		_SMBPROFILE_TIMER_ASYNC_SET_BUSY(_async); \
-		(_async).stats->time += profile_timestamp() - (_async).start; \
+		__profile_elapsed = profile_timestamp() - (_async).start; \
+		(_async).stats->time += __profile_elapsed; \
 		(_async).stats->idle += (_async).idle_time; \
+		smbprofile_update_hist((_async).stats->time_hist, \
+				       __profile_elapsed); \
 	} \
 } while(0)
 
@@ -0,0 +1,54 @@
+/*
+   Unix SMB/CIFS implementation.
+   Shared pool of tldap connections
+   Copyright (C) Volker Lendecke 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TLDAP_POOL_H__
+#define __TLDAP_POOL_H__
+
+#include <talloc.h>
+#include "tldap.h"
+
+struct tldap_pool;
+
+/*
+ * A tldap_pool hands out ready-to-use tldap contexts. Since tldap
+ * demultiplexes replies by message id, several consumers can issue
+ * requests over the same connection concurrently; the pool just makes
+ * sure they spread over a few shared connections instead of each
+ * paying TCP and bind setup per operation.
+ *
+ * "connect_fn" must return a connected socket fd or -1, "bind_fn"
+ * must authenticate the fresh context and return a TLDAP_* code. Both
+ * are called lazily when the pool decides to open a new connection.
+ */
+struct tldap_pool *tldap_pool_create(
+	TALLOC_CTX *mem_ctx, uint8_t max_conns,
+	int (*connect_fn)(void *private_data),
+	int (*bind_fn)(struct tldap_context *ld, void *private_data),
+	void *private_data);
+
+/*
+ * Get a healthy connection for issuing requests. Connections that
+ * went down are discarded and replaced transparently. The returned
+ * context stays owned by the pool, do not talloc_free it.
+ */
+int tldap_pool_get(struct tldap_pool *pool, struct tldap_context **pld);
+
+size_t tldap_pool_num_connections(struct tldap_pool *pool);
+
+#endif
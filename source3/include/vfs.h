@@ -167,6 +167,10 @@
 /* Version 33 - Add snapshot create/delete calls */
 /* Version 33 - Add OS X SMB2 AAPL copyfile extension flag to fsp */
 /* Version 33 - Remove notify_watch_fn */
+/* Leave at 33 - not yet released. Add asynchronous
+		 SMB_VFS_HASH_FILE_SEND/RECV() */
+/* Leave at 33 - not yet released. Add vectored SMB_VFS_STAT_BATCH()
+		 and SMB_VFS_NTIMES_BATCH() */
 
 #define SMB_VFS_INTERFACE_VERSION 33
 
@@ -188,6 +192,7 @@ struct ea_list;
 struct smb_file_time;
 struct blocking_lock_record;
 struct smb_filename;
+struct smb2_query_directory_readahead;
 struct dfs_GetDFSReferral;
 
 typedef union unid_t {
@@ -223,6 +228,13 @@ struct fsp_lease {
 
 typedef struct files_struct {
 	struct files_struct *next, *prev;
+	/*
+	 * Chain of fsps with the same file_id, hanging off the
+	 * per-sconn by-file_id index. Only ever touched via
+	 * fsp_set_file_id() and the helpers in smbd/files.c.
+	 */
+	struct files_struct *fi_next, *fi_prev;
+	bool fi_indexed;
 	uint64_t fnum;
 	struct smbXsrv_open *op;
 	struct connection_struct *conn;
@@ -262,6 +274,16 @@ typedef struct files_struct {
 	bool is_sparse;
 	bool backup_intent; /* Handle was successfully opened with backup intent
 				and opener has privilege to do so. */
+
+	/*
+	 * Cached result of dos_mode() for this handle, managed by
+	 * fsp_dos_mode(). Revalidated against st_ex_ctime (chmod and
+	 * xattr changes bump ctime) and dropped explicitly when we
+	 * change the mode ourselves in file_set_dosmode().
+	 */
+	bool dosmode_valid;
+	uint32_t dosmode;
+	struct timespec dosmode_ctime;
 	bool aapl_copyfile_supported;
 	struct smb_filename *fsp_name;
 	uint32_t name_hash;		/* Jenkins hash of full pathname. */
@@ -284,6 +306,13 @@ typedef struct files_struct {
 
 	struct dptr_struct *dptr;
 
+	/*
+	 * One marshalled QUERY_DIRECTORY response built ahead of the
+	 * next continuation request on this handle, see
+	 * source3/smbd/smb2_query_directory.c.
+	 */
+	struct smb2_query_directory_readahead *dir_readahead;
+
 	/* if not NULL, means this is a print file */
 	struct print_file_data *print_file;
 
@@ -608,6 +637,9 @@ struct vfs_fn_pointers {
 	int (*stat_fn)(struct vfs_handle_struct *handle, struct smb_filename *smb_fname);
 	int (*fstat_fn)(struct vfs_handle_struct *handle, struct files_struct *fsp, SMB_STRUCT_STAT *sbuf);
 	int (*lstat_fn)(struct vfs_handle_struct *handle, struct smb_filename *smb_filename);
+	int (*stat_batch_fn)(struct vfs_handle_struct *handle,
+			     unsigned int num_entries,
+			     struct smb_filename **smb_fnames);
 	uint64_t (*get_alloc_size_fn)(struct vfs_handle_struct *handle, struct files_struct *fsp, const SMB_STRUCT_STAT *sbuf);
 	int (*unlink_fn)(struct vfs_handle_struct *handle,
 			 const struct smb_filename *smb_fname);
@@ -621,6 +653,10 @@ struct vfs_fn_pointers {
 	int (*ntimes_fn)(struct vfs_handle_struct *handle,
 			 const struct smb_filename *smb_fname,
 			 struct smb_file_time *ft);
+	int (*ntimes_batch_fn)(struct vfs_handle_struct *handle,
+			       unsigned int num_entries,
+			       struct smb_filename **smb_fnames,
+			       struct smb_file_time *fts);
 	int (*ftruncate_fn)(struct vfs_handle_struct *handle, struct files_struct *fsp, off_t offset);
 	int (*fallocate_fn)(struct vfs_handle_struct *handle,
 			    struct files_struct *fsp,
@@ -651,6 +687,16 @@ struct vfs_fn_pointers {
 	NTSTATUS (*copy_chunk_recv_fn)(struct vfs_handle_struct *handle,
 				       struct tevent_req *req,
 				       off_t *copied);
+	struct tevent_req *(*hash_file_send_fn)(struct vfs_handle_struct *handle,
+						TALLOC_CTX *mem_ctx,
+						struct tevent_context *ev,
+						struct files_struct *fsp,
+						off_t offset,
+						off_t num);
+	NTSTATUS (*hash_file_recv_fn)(struct vfs_handle_struct *handle,
+				      struct tevent_req *req,
+				      uint8_t digest[64],
+				      off_t *hashed);
 	NTSTATUS (*get_compression_fn)(struct vfs_handle_struct *handle,
 				       TALLOC_CTX *mem_ctx,
 				       struct files_struct *fsp,
@@ -1047,6 +1093,9 @@ int smb_vfs_call_fstat(struct vfs_handle_struct *handle,
 		       struct files_struct *fsp, SMB_STRUCT_STAT *sbuf);
 int smb_vfs_call_lstat(struct vfs_handle_struct *handle,
 		       struct smb_filename *smb_filename);
+int smb_vfs_call_stat_batch(struct vfs_handle_struct *handle,
+			    unsigned int num_entries,
+			    struct smb_filename **smb_fnames);
 uint64_t smb_vfs_call_get_alloc_size(struct vfs_handle_struct *handle,
 				     struct files_struct *fsp,
 				     const SMB_STRUCT_STAT *sbuf);
@@ -1067,6 +1116,10 @@ char *smb_vfs_call_getwd(struct vfs_handle_struct *handle);
 int smb_vfs_call_ntimes(struct vfs_handle_struct *handle,
 			const struct smb_filename *smb_fname,
 			struct smb_file_time *ft);
+int smb_vfs_call_ntimes_batch(struct vfs_handle_struct *handle,
+			      unsigned int num_entries,
+			      struct smb_filename **smb_fnames,
+			      struct smb_file_time *fts);
 int smb_vfs_call_ftruncate(struct vfs_handle_struct *handle,
 			   struct files_struct *fsp, off_t offset);
 int smb_vfs_call_fallocate(struct vfs_handle_struct *handle,
@@ -1152,6 +1205,16 @@ struct tevent_req *smb_vfs_call_copy_chunk_send(struct vfs_handle_struct *handle
 NTSTATUS smb_vfs_call_copy_chunk_recv(struct vfs_handle_struct *handle,
 				      struct tevent_req *req,
 				      off_t *copied);
+struct tevent_req *smb_vfs_call_hash_file_send(struct vfs_handle_struct *handle,
+					       TALLOC_CTX *mem_ctx,
+					       struct tevent_context *ev,
+					       struct files_struct *fsp,
+					       off_t offset,
+					       off_t num);
+NTSTATUS smb_vfs_call_hash_file_recv(struct vfs_handle_struct *handle,
+				     struct tevent_req *req,
+				     uint8_t digest[64],
+				     off_t *hashed);
 NTSTATUS smb_vfs_call_get_compression(struct vfs_handle_struct *handle,
 				      TALLOC_CTX *mem_ctx,
 				      struct files_struct *fsp,
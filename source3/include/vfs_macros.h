@@ -231,6 +231,12 @@
 #define SMB_VFS_NEXT_LSTAT(handle, smb_fname) \
 	smb_vfs_call_lstat((handle)->next, (smb_fname))
 
+#define SMB_VFS_STAT_BATCH(conn, num_entries, smb_fnames) \
+	smb_vfs_call_stat_batch((conn)->vfs_handles, (num_entries), \
+				(smb_fnames))
+#define SMB_VFS_NEXT_STAT_BATCH(handle, num_entries, smb_fnames) \
+	smb_vfs_call_stat_batch((handle)->next, (num_entries), (smb_fnames))
+
 #define SMB_VFS_GET_ALLOC_SIZE(conn, fsp, sbuf) \
 	smb_vfs_call_get_alloc_size((conn)->vfs_handles, (fsp), (sbuf))
 #define SMB_VFS_NEXT_GET_ALLOC_SIZE(conn, fsp, sbuf) \
@@ -281,6 +287,13 @@
 #define SMB_VFS_NEXT_NTIMES(handle, path, ts) \
 	smb_vfs_call_ntimes((handle)->next, (path), (ts))
 
+#define SMB_VFS_NTIMES_BATCH(conn, num_entries, smb_fnames, fts) \
+	smb_vfs_call_ntimes_batch((conn)->vfs_handles, (num_entries), \
+				  (smb_fnames), (fts))
+#define SMB_VFS_NEXT_NTIMES_BATCH(handle, num_entries, smb_fnames, fts) \
+	smb_vfs_call_ntimes_batch((handle)->next, (num_entries), \
+				  (smb_fnames), (fts))
+
 #define SMB_VFS_FTRUNCATE(fsp, offset) \
 	smb_vfs_call_ftruncate((fsp)->conn->vfs_handles, (fsp), (offset))
 #define SMB_VFS_NEXT_FTRUNCATE(handle, fsp, offset) \
@@ -407,6 +420,16 @@
 #define SMB_VFS_NEXT_COPY_CHUNK_RECV(handle, req, copied) \
 	smb_vfs_call_copy_chunk_recv((handle)->next, (req), (copied))
 
+#define SMB_VFS_HASH_FILE_SEND(conn, mem_ctx, ev, fsp, offset, num) \
+	smb_vfs_call_hash_file_send((conn)->vfs_handles, (mem_ctx), (ev), (fsp), (offset), (num))
+#define SMB_VFS_NEXT_HASH_FILE_SEND(handle, mem_ctx, ev, fsp, offset, num) \
+	smb_vfs_call_hash_file_send((handle)->next, (mem_ctx), (ev), (fsp), (offset), (num))
+
+#define SMB_VFS_HASH_FILE_RECV(conn, req, digest, hashed) \
+	smb_vfs_call_hash_file_recv((conn)->vfs_handles, (req), (digest), (hashed))
+#define SMB_VFS_NEXT_HASH_FILE_RECV(handle, req, digest, hashed) \
+	smb_vfs_call_hash_file_recv((handle)->next, (req), (digest), (hashed))
+
 #define SMB_VFS_GET_COMPRESSION(conn, mem_ctx, fsp, smb_fname, _compression_fmt)		\
 	smb_vfs_call_get_compression((conn)->vfs_handles, (mem_ctx), (fsp), (smb_fname), (_compression_fmt))
 #define SMB_VFS_NEXT_GET_COMPRESSION(handle, mem_ctx, fsp, smb_fname, _compression_fmt)		\
@@ -237,6 +237,73 @@ static void asys_pread_do(void *private_data)
 	}
 }
 
+int asys_submit_batch(struct asys_context *ctx, const struct asys_io *ios,
+		      unsigned num_ios)
+{
+	struct pthreadpool_job jobs[num_ios];
+	unsigned i;
+	int ret;
+
+	for (i=0; i<num_ios; i++) {
+		const struct asys_io *io = &ios[i];
+		struct asys_job *job;
+
+		ret = asys_new_job(ctx, &jobs[i].id, &job);
+		if (ret != 0) {
+			goto fail;
+		}
+		job->private_data = io->private_data;
+
+		switch (io->op) {
+		case ASYS_IO_PREAD: {
+			struct asys_pread_args *args = &job->args.pread_args;
+
+			args->fildes = io->fildes;
+			args->buf = io->buf;
+			args->nbyte = io->nbyte;
+			args->offset = io->offset;
+			jobs[i].fn = asys_pread_do;
+			break;
+		}
+		case ASYS_IO_PWRITE: {
+			struct asys_pwrite_args *args = &job->args.pwrite_args;
+
+			args->fildes = io->fildes;
+			args->buf = io->buf;
+			args->nbyte = io->nbyte;
+			args->offset = io->offset;
+			jobs[i].fn = asys_pwrite_do;
+			break;
+		}
+		default:
+			ret = EINVAL;
+			goto fail;
+		}
+		jobs[i].private_data = job;
+
+		/*
+		 * Mark the slot busy right away, asys_new_job() would
+		 * hand it out again for the next entry otherwise.
+		 */
+		job->busy = 1;
+	}
+
+	ret = pthreadpool_add_jobs(ctx->pool, jobs, num_ios);
+	if (ret != 0) {
+		i = num_ios;
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	while (i > 0) {
+		i -= 1;
+		ctx->jobs[jobs[i].id]->busy = 0;
+	}
+	return ret;
+}
+
 static void asys_fsync_do(void *private_data);
 
 int asys_fsync(struct asys_context *ctx, int fildes, void *private_data)
@@ -132,6 +132,37 @@ int asys_pread(struct asys_context *ctx, int fildes, void *buf, size_t nbyte,
 	       off_t offset, void *private_data);
 int asys_pwrite(struct asys_context *ctx, int fildes, const void *buf,
 		size_t nbyte, off_t offset, void *private_data);
+
+enum asys_io_op {
+	ASYS_IO_PREAD,
+	ASYS_IO_PWRITE
+};
+
+struct asys_io {
+	enum asys_io_op op;
+	int fildes;
+	void *buf;
+	size_t nbyte;
+	off_t offset;
+	void *private_data;
+};
+
+/**
+ * @brief Submit several I/Os in one call
+ *
+ * Equivalent to calling asys_pread()/asys_pwrite() once per entry in
+ * "ios", but the whole batch is handed to the underlying threadpool
+ * under one lock acquisition. Either all I/Os are submitted or none.
+ * The results arrive via asys_results() individually, in completion
+ * order.
+ *
+ * @param[in]	ctx	The asys context
+ * @param[in]	ios	Array of I/O descriptions
+ * @param[in]	num_ios	The length of the ios array
+ * @return		success: 0, failure: errno
+ */
+int asys_submit_batch(struct asys_context *ctx, const struct asys_io *ios,
+		      unsigned num_ios);
 int asys_ftruncate(struct asys_context *ctx, int filedes, off_t length,
 		   void *private_data);
 int asys_fsync(struct asys_context *ctx, int fd, void *private_data);
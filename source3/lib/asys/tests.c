@@ -78,6 +78,51 @@ int main(int argc, const char *argv[])
 		printf("%d returned %d\n", *pidx, (int)result.ret);
 	}
 
+	{
+		struct asys_io ios[ntasks];
+		int *readbuf;
+
+		readbuf = calloc(ntasks, sizeof(int));
+		if (readbuf == NULL) {
+			perror("calloc failed");
+			return 1;
+		}
+
+		for (i=0; i<ntasks; i++) {
+			ios[i].op = ASYS_IO_PREAD;
+			ios[i].fildes = fd;
+			ios[i].buf = &readbuf[i];
+			ios[i].nbyte = sizeof(int);
+			ios[i].offset = i * sizeof(int);
+			ios[i].private_data = &readbuf[i];
+		}
+
+		ret = asys_submit_batch(ctx, ios, ntasks);
+		if (ret != 0) {
+			errno = ret;
+			perror("asys_submit_batch failed");
+			return 1;
+		}
+
+		for (i=0; i<ntasks; i++) {
+			struct asys_result result;
+			int *pidx;
+
+			ret = asys_results(ctx, &result, 1);
+			if (ret < 0) {
+				errno = -ret;
+				perror("asys_result failed");
+				return 1;
+			}
+			pidx = (int *)result.private_data;
+
+			printf("batch read %d returned %d\n", *pidx,
+			       (int)result.ret);
+		}
+
+		free(readbuf);
+	}
+
 	ret = asys_context_destroy(ctx);
 	if (ret != 0) {
 		perror("asys_context_delete failed");
@@ -504,8 +504,13 @@ bool gencache_parse(const char *keystr,
 		if (current_seqnum == cache_notrans_seqnum) {
 			/*
 			 * Ok, our memcache is still current, use it without
-			 * going to the tdb files.
+			 * going to the tdb files. A zero-length value is
+			 * our marker for a remembered miss, valid values
+			 * always carry at least the timeout header.
 			 */
+			if (memcache_val.length == 0) {
+				return false;
+			}
 			state.is_memcache = true;
 			gencache_parse_fn(key, make_tdb_data(memcache_val.data,
 							     memcache_val.length),
@@ -524,6 +529,17 @@ bool gencache_parse(const char *keystr,
 		return true;
 	}
 	ret = tdb_parse_record(cache->tdb, key, gencache_parse_fn, &state);
+	if (ret != 0) {
+		/*
+		 * Remember the miss, negative lookups are just as hot
+		 * as hits for the resolver-style callers. Invalidated
+		 * together with the positive entries via the seqnum
+		 * check above.
+		 */
+		memcache_add(NULL, GENCACHE_RAM,
+			     data_blob_const(key.dptr, key.dsize),
+			     data_blob_null);
+	}
 	return (ret == 0);
 }
 
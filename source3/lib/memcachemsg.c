@@ -0,0 +1,88 @@
+/*
+   samba -- Unix SMB/CIFS implementation.
+   Expose in-memory cache usage stats via messaging
+   Copyright (C) Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "messages.h"
+#include "lib/util/memcache.h"
+
+/**
+ * Respond to a MSG_REQ_MEMCACHE_STATS message with the string form of
+ * the per-class counters of the process global memcache.
+ **/
+static void msg_memcache_stats(struct messaging_context *msg_ctx,
+			       void *private_data,
+			       uint32_t msg_type,
+			       struct server_id src,
+			       DATA_BLOB *data)
+{
+	char *report;
+	enum memcache_number n;
+
+	SMB_ASSERT(msg_type == MSG_REQ_MEMCACHE_STATS);
+
+	DEBUG(2,("Got MEMCACHE_STATS\n"));
+
+	report = talloc_asprintf(
+		msg_ctx, "memcache usage: %ju/%ju bytes\n",
+		(uintmax_t)memcache_size(NULL),
+		(uintmax_t)memcache_max_size(NULL));
+
+	for (n = 0; n < MEMCACHE_NUM_CLASSES; n++) {
+		struct memcache_class_stats stats;
+		uint64_t lookups;
+
+		memcache_get_stats(NULL, n, &stats);
+
+		lookups = stats.hits + stats.misses;
+		if ((lookups == 0) && (stats.adds == 0)) {
+			continue;
+		}
+
+		report = talloc_asprintf_append(
+			report,
+			"%s: %ju entries, %ju bytes, "
+			"%ju hits, %ju misses (%ju%%), %ju adds\n",
+			memcache_class_name(n),
+			(uintmax_t)stats.elements,
+			(uintmax_t)stats.bytes,
+			(uintmax_t)stats.hits,
+			(uintmax_t)stats.misses,
+			(uintmax_t)(lookups ?
+				    (stats.hits * 100 / lookups) : 0),
+			(uintmax_t)stats.adds);
+	}
+
+	if (report != NULL) {
+		messaging_send_buf(msg_ctx, src, MSG_MEMCACHE_STATS,
+				   (uint8_t *)report,
+				   talloc_get_size(report)-1);
+	}
+
+	talloc_free(report);
+}
+
+/**
+ * Register handler for MSG_REQ_MEMCACHE_STATS
+ **/
+void register_msg_memcache_stats(struct messaging_context *msg_ctx)
+{
+	messaging_register(msg_ctx, NULL, MSG_REQ_MEMCACHE_STATS,
+			   msg_memcache_stats);
+	DEBUG(2, ("Registered MSG_REQ_MEMCACHE_STATS\n"));
+}
@@ -374,6 +374,8 @@ struct messaging_context *messaging_init(TALLOC_CTX *mem_ctx,
 	/* Register some debugging related messages */
 
 	register_msg_pool_usage(ctx);
+	register_msg_event_profile(ctx);
+	register_msg_memcache_stats(ctx);
 	register_dmalloc_msgs(ctx);
 	debug_register_msgs(ctx);
 
@@ -229,3 +229,122 @@ int ms_fnmatch(const char *pattern, const char *string, bool translate_pattern,
 	TALLOC_FREE(s);
 	return ret;
 }
+
+/*
+  Compiled form of a pattern, for callers that match one mask against
+  many names (directory searches). All the per-pattern work from
+  ms_fnmatch() - the UCS2 conversion, the protocol translation, the
+  wildcard count and the max_n allocation - is done once here instead
+  of once per candidate name.
+*/
+
+struct ms_fnmatch_compiled {
+	smb_ucs2_t *pattern;	/* NULL for a wildcard free mask */
+	char *literal;		/* set instead for a wildcard free mask */
+	struct max_n *max_n;
+	int count;
+	bool is_case_sensitive;
+};
+
+struct ms_fnmatch_compiled *ms_fnmatch_compile(TALLOC_CTX *mem_ctx,
+					       const char *pattern,
+					       bool translate_pattern,
+					       bool is_case_sensitive)
+{
+	struct ms_fnmatch_compiled *compiled;
+	size_t converted_size;
+	int count, i;
+
+	compiled = talloc_zero(mem_ctx, struct ms_fnmatch_compiled);
+	if (compiled == NULL) {
+		return NULL;
+	}
+	compiled->is_case_sensitive = is_case_sensitive;
+
+	if (strpbrk(pattern, "<>*?\"") == NULL) {
+		/* this is not just an optmisation - it is essential
+		   for LANMAN1 correctness */
+		compiled->literal = talloc_strdup(compiled, pattern);
+		if (compiled->literal == NULL) {
+			TALLOC_FREE(compiled);
+			return NULL;
+		}
+		return compiled;
+	}
+
+	if (!push_ucs2_talloc(compiled, &compiled->pattern, pattern,
+			      &converted_size)) {
+		TALLOC_FREE(compiled);
+		return NULL;
+	}
+
+	if (translate_pattern) {
+		smb_ucs2_t *p = compiled->pattern;
+
+		for (i=0;p[i];i++) {
+			if (p[i] == UCS2_CHAR('?')) {
+				p[i] = UCS2_CHAR('>');
+			} else if (p[i] == UCS2_CHAR('.') &&
+				   (p[i+1] == UCS2_CHAR('?') ||
+				    p[i+1] == UCS2_CHAR('*') ||
+				    p[i+1] == 0)) {
+				p[i] = UCS2_CHAR('"');
+			} else if (p[i] == UCS2_CHAR('*') &&
+				   p[i+1] == UCS2_CHAR('.')) {
+				p[i] = UCS2_CHAR('<');
+			}
+		}
+	}
+
+	for (count=i=0;compiled->pattern[i];i++) {
+		if (compiled->pattern[i] == UCS2_CHAR('*') ||
+		    compiled->pattern[i] == UCS2_CHAR('<')) {
+			count++;
+		}
+	}
+	compiled->count = count;
+
+	if (count != 0) {
+		compiled->max_n = talloc_array(compiled, struct max_n, count);
+		if (compiled->max_n == NULL) {
+			TALLOC_FREE(compiled);
+			return NULL;
+		}
+	}
+
+	return compiled;
+}
+
+int ms_fnmatch_compiled(struct ms_fnmatch_compiled *compiled,
+			const char *string)
+{
+	smb_ucs2_t *s = NULL;
+	size_t converted_size;
+	int ret;
+
+	if (ISDOTDOT(string)) {
+		string = ".";
+	}
+
+	if (compiled->literal != NULL) {
+		if (compiled->is_case_sensitive) {
+			return strcmp(compiled->literal, string);
+		}
+		return strcasecmp_m(compiled->literal, string);
+	}
+
+	if (!push_ucs2_talloc(talloc_tos(), &s, string, &converted_size)) {
+		return -1;
+	}
+
+	if (compiled->count != 0) {
+		memset(compiled->max_n, 0,
+		       compiled->count * sizeof(struct max_n));
+	}
+
+	ret = ms_fnmatch_core(compiled->pattern, s, compiled->max_n,
+			      strrchr_w(s, UCS2_CHAR('.')),
+			      compiled->is_case_sensitive);
+	TALLOC_FREE(s);
+	return ret;
+}
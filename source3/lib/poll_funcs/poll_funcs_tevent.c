@@ -220,9 +220,21 @@ static void tevent_watch_update(struct poll_watch *w, short events)
 {
 	struct poll_funcs_state *state = w->state;
 	unsigned slot = w->slot;
+	uint16_t tevent_events = poll_events_to_tevent(events);
 	unsigned i;
 
-	w->events = poll_events_to_tevent(events);
+	if (w->events == tevent_events) {
+		/*
+		 * Nothing changed. Engines like unix_msg update their
+		 * watches on every state transition, don't let the
+		 * redundant ones fan out into a tevent_fd_set_flags()
+		 * per registered context, which on the epoll backend
+		 * means an epoll_ctl() syscall each.
+		 */
+		return;
+	}
+
+	w->events = tevent_events;
 
 	for (i=0; i<state->num_contexts; i++) {
 		struct poll_funcs_tevent_context *c = state->contexts[i];
@@ -71,6 +71,110 @@ static uint64_t map_old_SE_PRIV(unsigned char *dptr)
 }
 
 
+/*
+ * In-memory copy of all privilege assignments.
+ *
+ * The set of SIDs that have privileges assigned is almost always tiny
+ * or empty, yet composing the privileges for a token probes the
+ * database once per SID in the token. Keep the complete set around and
+ * revalidate it against the database sequence number, so the common
+ * case is answered from memory without any negative tdb lookups.
+ */
+
+struct priv_cache_entry {
+	struct dom_sid sid;
+	uint64_t mask;
+};
+
+static struct priv_cache_entry *priv_cache_entries;
+static uint32_t priv_cache_count;
+static int priv_cache_seqnum;
+static bool priv_cache_valid;
+
+static int priv_cache_traverse_fn(struct db_record *rec, void *state)
+{
+	bool *ok = (bool *)state;
+	int prefixlen = strlen(PRIVPREFIX);
+	struct priv_cache_entry *entries, *e;
+	fstring sid_string;
+	TDB_DATA key, value;
+
+	key = dbwrap_record_get_key(rec);
+
+	/* check we have a PRIV_+SID entry */
+
+	if (strncmp((char *)key.dptr, PRIVPREFIX, prefixlen) != 0)
+		return 0;
+
+	fstrcpy(sid_string, (char *)&(key.dptr[prefixlen]));
+
+	entries = talloc_realloc(NULL, priv_cache_entries,
+				 struct priv_cache_entry,
+				 priv_cache_count+1);
+	if (entries == NULL) {
+		*ok = false;
+		return 1;
+	}
+	priv_cache_entries = entries;
+
+	e = &entries[priv_cache_count];
+
+	if (!string_to_sid(&e->sid, sid_string)) {
+		DEBUG(0, ("priv_cache_traverse_fn: Could not convert SID "
+			  "[%s]\n", sid_string));
+		return 0;
+	}
+
+	value = dbwrap_record_get_value(rec);
+
+	if (value.dsize == 4*4) {
+		/* it's an old style SE_PRIV structure. */
+		e->mask = map_old_SE_PRIV(value.dptr);
+	} else {
+		if (value.dsize != sizeof( uint64_t ) ) {
+			DEBUG(3, ("priv_cache_traverse_fn: Invalid privileges "
+				  "record assigned to SID [%s]\n", sid_string));
+			return 0;
+		}
+		e->mask = BVAL(value.dptr, 0);
+	}
+
+	priv_cache_count += 1;
+	return 0;
+}
+
+static bool priv_cache_load(struct db_context *db)
+{
+	int seqnum = dbwrap_get_seqnum(db);
+	NTSTATUS status;
+	bool ok = true;
+
+	if (priv_cache_valid && (seqnum == priv_cache_seqnum)) {
+		return true;
+	}
+
+	TALLOC_FREE(priv_cache_entries);
+	priv_cache_count = 0;
+	priv_cache_valid = false;
+
+	/*
+	 * The seqnum was read before the traverse, so a concurrent
+	 * writer can only make us reload once more, never serve stale
+	 * data.
+	 */
+	priv_cache_seqnum = seqnum;
+
+	status = dbwrap_traverse_read(db, priv_cache_traverse_fn, &ok, NULL);
+	if (!NT_STATUS_IS_OK(status) || !ok) {
+		TALLOC_FREE(priv_cache_entries);
+		priv_cache_count = 0;
+		return false;
+	}
+
+	priv_cache_valid = true;
+	return true;
+}
+
 static bool get_privileges( const struct dom_sid *sid, uint64_t *mask )
 {
 	struct db_context *db = get_account_pol_db();
@@ -87,6 +191,21 @@ static bool get_privileges( const struct dom_sid *sid, uint64_t *mask )
 	if ( db == NULL )
 		return False;
 
+	if (priv_cache_load(db)) {
+		uint32_t i;
+
+		for (i=0; i<priv_cache_count; i++) {
+			if (dom_sid_equal(sid, &priv_cache_entries[i].sid)) {
+				*mask = priv_cache_entries[i].mask;
+				return True;
+			}
+		}
+
+		DEBUG(4, ("get_privileges: No privileges assigned to SID "
+			  "[%s]\n", sid_string_dbg(sid)));
+		return False;
+	}
+
 	/* PRIV_<SID> (NULL terminated) as the key */
 
 	fstr_sprintf(keystr, "%s%s", PRIVPREFIX, sid_to_fstring(tmp, sid));
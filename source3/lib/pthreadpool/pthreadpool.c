@@ -33,12 +33,6 @@
 #include "pthreadpool.h"
 #include "lib/util/dlinklist.h"
 
-struct pthreadpool_job {
-	int id;
-	void (*fn)(void *private_data);
-	void *private_data;
-};
-
 struct pthreadpool {
 	/*
 	 * List pthreadpools for fork safety
@@ -529,7 +523,12 @@ static void *pthreadpool_server(void *arg)
 			int sig_pipe = pool->sig_pipe[1];
 
 			/*
-			 * Do the work with the mutex unlocked
+			 * Do the work and signal completion with the
+			 * mutex unlocked. Writes of up to PIPE_BUF
+			 * bytes are atomic, so concurrent workers
+			 * can't interleave their job ids, and keeping
+			 * the write out of the critical section takes
+			 * a syscall off the mutex hold time.
 			 */
 
 			res = pthread_mutex_unlock(&pool->mutex);
@@ -537,10 +536,11 @@ static void *pthreadpool_server(void *arg)
 
 			job.fn(job.private_data);
 
+			written = write(sig_pipe, &job.id, sizeof(job.id));
+
 			res = pthread_mutex_lock(&pool->mutex);
 			assert(res == 0);
 
-			written = write(sig_pipe, &job.id, sizeof(job.id));
 			if (written != sizeof(int)) {
 				pthreadpool_server_exit(pool);
 				pthread_mutex_unlock(&pool->mutex);
@@ -606,11 +606,15 @@ int pthreadpool_add_job(struct pthreadpool *pool, int job_id,
 
 	if (pool->num_idle > 0) {
 		/*
-		 * We have idle threads, wake one.
+		 * We have idle threads, wake one. Signal after
+		 * unlocking, the woken thread needs the mutex first
+		 * thing and would otherwise immediately block on
+		 * us. The job is already in the queue, so the
+		 * predicate the waiter re-checks holds either way.
 		 */
-		res = pthread_cond_signal(&pool->condvar);
-		pthread_mutex_unlock(&pool->mutex);
-		return res;
+		res = pthread_mutex_unlock(&pool->mutex);
+		assert(res == 0);
+		return pthread_cond_signal(&pool->condvar);
 	}
 
 	if ((pool->max_threads != 0) &&
@@ -645,3 +649,126 @@ int pthreadpool_add_job(struct pthreadpool *pool, int job_id,
 	pthread_mutex_unlock(&pool->mutex);
 	return res;
 }
+
+int pthreadpool_add_jobs(struct pthreadpool *pool,
+			 const struct pthreadpool_job *jobs,
+			 unsigned num_jobs)
+{
+	pthread_t thread_id;
+	unsigned i, num_new_threads;
+	int create_res = 0;
+	int res;
+	bool wake_idle;
+	sigset_t mask, omask;
+
+	if (num_jobs == 0) {
+		return 0;
+	}
+
+	res = pthread_mutex_lock(&pool->mutex);
+	if (res != 0) {
+		return res;
+	}
+
+	if (pool->shutdown) {
+		/*
+		 * Protect against the pool being shut down while
+		 * trying to add jobs
+		 */
+		res = pthread_mutex_unlock(&pool->mutex);
+		assert(res == 0);
+		return EINVAL;
+	}
+
+	/*
+	 * Just some cleanup under the mutex
+	 */
+	pthreadpool_join_children(pool);
+
+	for (i=0; i<num_jobs; i++) {
+		if (!pthreadpool_put_job(pool, jobs[i].id, jobs[i].fn,
+					 jobs[i].private_data)) {
+			/*
+			 * Don't queue the batch partially, the caller
+			 * could not tell which jobs made it into the
+			 * queue. The failed puts appended at the tail,
+			 * so dropping them is just stepping back.
+			 */
+			pool->num_jobs -= i;
+			pthread_mutex_unlock(&pool->mutex);
+			return ENOMEM;
+		}
+	}
+
+	/*
+	 * Create enough new worker threads that the whole batch can
+	 * run in parallel, respecting max_threads. They should not
+	 * receive any signals.
+	 */
+
+	num_new_threads = num_jobs;
+	if (num_new_threads > (unsigned)pool->num_idle) {
+		num_new_threads -= pool->num_idle;
+	} else {
+		num_new_threads = 0;
+	}
+	if (pool->max_threads != 0) {
+		int can_create = pool->max_threads - pool->num_threads;
+
+		if (can_create < 0) {
+			can_create = 0;
+		}
+		if (num_new_threads > (unsigned)can_create) {
+			num_new_threads = can_create;
+		}
+	}
+
+	if (num_new_threads > 0) {
+		sigfillset(&mask);
+
+		res = pthread_sigmask(SIG_BLOCK, &mask, &omask);
+		if (res != 0) {
+			pthread_mutex_unlock(&pool->mutex);
+			return res;
+		}
+
+		for (i=0; i<num_new_threads; i++) {
+			create_res = pthread_create(&thread_id, NULL,
+						    pthreadpool_server,
+						    (void *)pool);
+			if (create_res != 0) {
+				break;
+			}
+			pool->num_threads += 1;
+		}
+
+		assert(pthread_sigmask(SIG_SETMASK, &omask, NULL) == 0);
+	}
+
+	wake_idle = (pool->num_idle > 0);
+
+	/*
+	 * A failure to grow the pool is only fatal if there is no
+	 * thread at all to drain the queue.
+	 */
+	if ((create_res != 0) && (pool->num_threads > 0)) {
+		create_res = 0;
+	}
+
+	res = pthread_mutex_unlock(&pool->mutex);
+	assert(res == 0);
+
+	if (wake_idle) {
+		/*
+		 * Signal after unlocking, see pthreadpool_add_job(). The
+		 * jobs are already in the queue, so the predicate the
+		 * waiters re-check holds either way.
+		 */
+		res = pthread_cond_broadcast(&pool->condvar);
+		if (res != 0) {
+			return res;
+		}
+	}
+
+	return create_res;
+}
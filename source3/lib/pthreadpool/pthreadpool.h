@@ -22,6 +22,19 @@
 
 struct pthreadpool;
 
+/**
+ * @brief A job for pthreadpool_add_jobs
+ *
+ * Describes one job in a batch submission: "fn" will be called with
+ * "private_data" in a helper thread, "id" will be returned by
+ * pthreadpool_finished_jobs() when the job is completed.
+ */
+struct pthreadpool_job {
+	int id;
+	void (*fn)(void *private_data);
+	void *private_data;
+};
+
 /**
  * @defgroup pthreadpool The pthreadpool API
  *
@@ -72,6 +85,23 @@ int pthreadpool_destroy(struct pthreadpool *pool);
 int pthreadpool_add_job(struct pthreadpool *pool, int job_id,
 			void (*fn)(void *private_data), void *private_data);
 
+/**
+ * @brief Add a batch of jobs to a pthreadpool
+ *
+ * Like calling pthreadpool_add_job() once per entry in "jobs", but
+ * the whole batch is queued under a single acquisition of the pool
+ * mutex and the idle threads are woken with one broadcast. Either all
+ * jobs are queued or none.
+ *
+ * @param[in]	pool		The pool to run the jobs on
+ * @param[in]	jobs		Array of job descriptions
+ * @param[in]	num_jobs	The length of the jobs array
+ * @return			success: 0, failure: errno
+ */
+int pthreadpool_add_jobs(struct pthreadpool *pool,
+			 const struct pthreadpool_job *jobs,
+			 unsigned num_jobs);
+
 /**
  * @brief Get the signalling fd from a pthreadpool
  *
@@ -159,7 +159,7 @@ ssize_t sys_recvfile(int fromfd,
 			size_t count)
 {
 	static int pipefd[2] = { -1, -1 };
-	static bool try_splice_call = false;
+	static bool try_splice_call = true;
 	size_t total_written = 0;
 	loff_t splice_offset = offset;
 
@@ -195,7 +195,7 @@ ssize_t sys_recvfile(int fromfd,
 		int nread, to_write;
 
 		nread = splice(fromfd, NULL, pipefd[1], NULL,
-			       MIN(count, 16384), SPLICE_F_MOVE);
+			       MIN(count, 65536), SPLICE_F_MOVE);
 		if (nread == -1) {
 			if (errno == EINTR) {
 				continue;
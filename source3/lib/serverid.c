@@ -27,6 +27,7 @@
 #include "lib/param/param.h"
 #include "ctdbd_conn.h"
 #include "messages.h"
+#include "lib/util/memcache.h"
 
 struct serverid_key {
 	pid_t pid;
@@ -84,6 +85,59 @@ static void serverid_fill_key(const struct server_id *id,
 	key->vnn = id->vnn;
 }
 
+/*
+ * Cache of server_ids we have positively seen dead. A server_id with a
+ * real unique_id can never come back: even if the pid is reused, the
+ * new process draws a fresh random unique_id. So negative results are
+ * stable and save us the kill(2) and serverid.tdb lookups when the
+ * same dead id is checked over and over, as happens when cleaning up
+ * thousands of share mode or brlock entries after a crash. Live
+ * results are never cached, a process can die any time. Ids carrying
+ * SERVERID_UNIQUE_ID_NOT_TO_VERIFY are only checked by pid and thus
+ * not safe to remember.
+ */
+
+struct serverid_dead_key {
+	struct serverid_key key;
+	uint64_t unique_id;
+};
+
+static bool serverid_dead_cache_key(const struct server_id *id,
+				    struct serverid_dead_key *buf,
+				    DATA_BLOB *key)
+{
+	if (id->unique_id == SERVERID_UNIQUE_ID_NOT_TO_VERIFY) {
+		return false;
+	}
+	ZERO_STRUCTP(buf);
+	serverid_fill_key(id, &buf->key);
+	buf->unique_id = id->unique_id;
+	*key = data_blob_const(buf, sizeof(*buf));
+	return true;
+}
+
+static bool serverid_is_cached_dead(const struct server_id *id)
+{
+	struct serverid_dead_key keybuf;
+	DATA_BLOB key, value;
+
+	if (!serverid_dead_cache_key(id, &keybuf, &key)) {
+		return false;
+	}
+	return memcache_lookup(NULL, SERVERID_DEAD_CACHE, key, &value);
+}
+
+static void serverid_cache_dead(const struct server_id *id)
+{
+	struct serverid_dead_key keybuf;
+	DATA_BLOB key;
+
+	if (!serverid_dead_cache_key(id, &keybuf, &key)) {
+		return;
+	}
+	memcache_add(NULL, SERVERID_DEAD_CACHE, key, data_blob_null);
+}
+
 bool serverid_register(const struct server_id id, uint32_t msg_flags)
 {
 	struct db_context *db;
@@ -257,10 +311,15 @@ bool serverids_exist(const struct server_id *ids, int num_ids, bool *results)
 			continue;
 		}
 
+		if (serverid_is_cached_dead(&ids[idx])) {
+			continue;
+		}
+
 		if (procid_is_local(&ids[idx])) {
 			bool exists = process_exists_by_pid(ids[idx].pid);
 
 			if (!exists) {
+				serverid_cache_dead(&ids[idx]);
 				continue;
 			}
 
@@ -324,6 +383,9 @@ bool serverids_exist(const struct server_id *ids, int num_ids, bool *results)
 			idx = todo_idx[t];
 
 			results[idx] = todo_results[t];
+			if (!todo_results[t]) {
+				serverid_cache_dead(&ids[idx]);
+			}
 		}
 	}
 
@@ -376,10 +438,21 @@ bool serverids_exist(const struct server_id *ids, int num_ids, bool *results)
 		state.exists = false;
 		status = dbwrap_parse_record(db, tdbkey, server_exists_parse, &state);
 		if (!NT_STATUS_IS_OK(status)) {
+			if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+				/* Not registered (anymore), gone for good. */
+				serverid_cache_dead(&ids[idx]);
+			}
 			results[idx] = false;
 			continue;
 		}
 		results[idx] = state.exists;
+		if (!state.exists) {
+			/*
+			 * Another process has taken over the pid, the
+			 * id we were asked about cannot come back.
+			 */
+			serverid_cache_dead(&ids[idx]);
+		}
 	}
 
 	result = true;
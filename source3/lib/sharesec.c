@@ -154,7 +154,7 @@ bool share_info_db_init(void)
 	}
 
 	share_db = db_open(NULL, db_path, 0,
-			   TDB_DEFAULT, O_RDWR|O_CREAT, 0600,
+			   TDB_SEQNUM, O_RDWR|O_CREAT, 0600,
 			   DBWRAP_LOCK_ORDER_1, DBWRAP_FLAG_NONE);
 	if (share_db == NULL) {
 		DEBUG(0,("Failed to open share info database %s (%s)\n",
@@ -287,6 +287,111 @@ struct security_descriptor *get_share_security_default( TALLOC_CTX *ctx, size_t
 	return psd;
 }
 
+/*******************************************************************
+ Per-process cache of parsed share security descriptors.
+
+ Tree connects fetch and unmarshall the share SD every time, and for
+ most shares the fetch is a negative probe answered with the default
+ SD. Keep the parsed descriptors (or the fact that none is stored,
+ psd == NULL) in a small MRU list stamped with the database sequence
+ number, so repeat tree connects to the same shares are answered from
+ memory. set_share_security() and delete_share_security() modify the
+ tdb and thereby bump the seqnum, which invalidates stale entries in
+ all processes.
+ ********************************************************************/
+
+#define SHARE_SD_CACHE_MAX_ENTRIES 32
+
+struct share_sd_cache_entry {
+	struct share_sd_cache_entry *prev, *next;
+	char *servicename;
+	int seqnum;
+	struct security_descriptor *psd;
+	size_t sd_size;
+};
+
+static struct share_sd_cache_entry *share_sd_cache;
+static int share_sd_cache_count;
+
+static bool share_sd_cache_lookup(TALLOC_CTX *ctx, const char *servicename,
+				  struct security_descriptor **ppsd,
+				  size_t *psize)
+{
+	struct share_sd_cache_entry *e;
+	int seqnum = dbwrap_get_seqnum(share_db);
+
+	for (e = share_sd_cache; e != NULL; e = e->next) {
+		if (strcmp(e->servicename, servicename) != 0) {
+			continue;
+		}
+		if (e->seqnum != seqnum) {
+			DLIST_REMOVE(share_sd_cache, e);
+			share_sd_cache_count -= 1;
+			TALLOC_FREE(e);
+			return false;
+		}
+		if (e->psd != NULL) {
+			*ppsd = security_descriptor_copy(ctx, e->psd);
+			if (*ppsd == NULL) {
+				return false;
+			}
+			*psize = e->sd_size;
+		} else {
+			/* negative entry: no SD stored for this share */
+			*ppsd = NULL;
+		}
+		DLIST_PROMOTE(share_sd_cache, e);
+		return true;
+	}
+
+	return false;
+}
+
+static void share_sd_cache_store(const char *servicename,
+				 const struct security_descriptor *psd,
+				 size_t sd_size, int seqnum)
+{
+	struct share_sd_cache_entry *e;
+
+	for (e = share_sd_cache; e != NULL; e = e->next) {
+		if (strcmp(e->servicename, servicename) == 0) {
+			DLIST_REMOVE(share_sd_cache, e);
+			share_sd_cache_count -= 1;
+			TALLOC_FREE(e);
+			break;
+		}
+	}
+
+	e = talloc_zero(NULL, struct share_sd_cache_entry);
+	if (e == NULL) {
+		return;
+	}
+	e->servicename = talloc_strdup(e, servicename);
+	if (e->servicename == NULL) {
+		TALLOC_FREE(e);
+		return;
+	}
+	if (psd != NULL) {
+		e->psd = security_descriptor_copy(e, psd);
+		if (e->psd == NULL) {
+			TALLOC_FREE(e);
+			return;
+		}
+	}
+	e->sd_size = sd_size;
+	e->seqnum = seqnum;
+
+	if (share_sd_cache_count >= SHARE_SD_CACHE_MAX_ENTRIES) {
+		struct share_sd_cache_entry *last = DLIST_TAIL(share_sd_cache);
+		DLIST_REMOVE(share_sd_cache, last);
+		share_sd_cache_count -= 1;
+		TALLOC_FREE(last);
+	}
+
+	DLIST_ADD(share_sd_cache, e);
+	share_sd_cache_count += 1;
+}
+
 /*******************************************************************
  Pull a security descriptor from the share tdb.
  ********************************************************************/
@@ -299,6 +404,7 @@ struct security_descriptor *get_share_security( TALLOC_CTX *ctx, const char *ser
 	TDB_DATA data;
 	char *c_servicename = canonicalize_servicename(talloc_tos(), servicename);
 	NTSTATUS status;
+	int seqnum;
 
 	if (!c_servicename) {
 		return NULL;
@@ -309,19 +415,35 @@ struct security_descriptor *get_share_security( TALLOC_CTX *ctx, const char *ser
 		return NULL;
 	}
 
+	if (share_sd_cache_lookup(ctx, c_servicename, &psd, psize)) {
+		TALLOC_FREE(c_servicename);
+		if (psd == NULL) {
+			return get_share_security_default(
+				ctx, psize, SEC_RIGHTS_DIR_ALL);
+		}
+		return psd;
+	}
+
 	if (!(key = talloc_asprintf(ctx, SHARE_SECURITY_DB_KEY_PREFIX_STR "%s", c_servicename))) {
 		TALLOC_FREE(c_servicename);
 		DEBUG(0, ("talloc_asprintf failed\n"));
 		return NULL;
 	}
 
-	TALLOC_FREE(c_servicename);
+	/*
+	 * Read the seqnum before the fetch: if a writer gets in between
+	 * the two, the cached entry is immediately stale and refetched,
+	 * but never wrong.
+	 */
+	seqnum = dbwrap_get_seqnum(share_db);
 
 	status = dbwrap_fetch_bystring(share_db, talloc_tos(), key, &data);
 
 	TALLOC_FREE(key);
 
 	if (!NT_STATUS_IS_OK(status)) {
+		share_sd_cache_store(c_servicename, NULL, 0, seqnum);
+		TALLOC_FREE(c_servicename);
 		return get_share_security_default(ctx, psize,
 						  SEC_RIGHTS_DIR_ALL);
 	}
@@ -331,17 +453,21 @@ struct security_descriptor *get_share_security( TALLOC_CTX *ctx, const char *ser
 	TALLOC_FREE(data.dptr);
 
 	if (!NT_STATUS_IS_OK(status)) {
+		TALLOC_FREE(c_servicename);
 		return get_share_security_default(ctx, psize,
 						  SEC_RIGHTS_DIR_ALL);
 	}
 
 	if (psd) {
 		*psize = ndr_size_security_descriptor(psd, 0);
+		share_sd_cache_store(c_servicename, psd, *psize, seqnum);
 	} else {
+		TALLOC_FREE(c_servicename);
 		return get_share_security_default(ctx, psize,
 						  SEC_RIGHTS_DIR_ALL);
 	}
 
+	TALLOC_FREE(c_servicename);
 	return psd;
 }
 
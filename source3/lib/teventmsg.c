@@ -0,0 +1,95 @@
+/*
+   samba -- Unix SMB/CIFS implementation.
+   Expose tevent handler latency stats via messaging
+   Copyright (C) Volker Lendecke 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "messages.h"
+
+/**
+ * Respond to a MSG_REQ_EVENT_PROFILE message with the string form of
+ * the per-handler dispatch time histogram.
+ *
+ * Collection is off by default to avoid two gettimeofday() calls per
+ * dispatched event. The first query switches it on, so the first reply
+ * is always empty and subsequent ones cover the time since then.
+ **/
+static void msg_event_profile(struct messaging_context *msg_ctx,
+			      void *private_data,
+			      uint32_t msg_type,
+			      struct server_id src,
+			      DATA_BLOB *data)
+{
+	struct tevent_context *ev = messaging_tevent_context(msg_ctx);
+	struct tevent_profile profile;
+	char *report;
+	int i;
+
+	SMB_ASSERT(msg_type == MSG_REQ_EVENT_PROFILE);
+
+	DEBUG(2,("Got EVENT_PROFILE\n"));
+
+	tevent_get_profile(ev, &profile);
+	tevent_set_profiling(ev, true);
+
+	report = talloc_asprintf(
+		msg_ctx, "Events dispatched: %ju\n",
+		(uintmax_t)profile.num_events);
+
+	for (i = 0; i < TEVENT_PROFILE_NUM_BUCKETS; i++) {
+		if (profile.buckets[i] == 0) {
+			continue;
+		}
+		if (i < (TEVENT_PROFILE_NUM_BUCKETS-1)) {
+			report = talloc_asprintf_append(
+				report, "<%juus: %ju\n",
+				(uintmax_t)(UINT64_C(1) << i),
+				(uintmax_t)profile.buckets[i]);
+		} else {
+			report = talloc_asprintf_append(
+				report, ">=%juus: %ju\n",
+				(uintmax_t)(UINT64_C(1) << (i-1)),
+				(uintmax_t)profile.buckets[i]);
+		}
+	}
+
+	if (profile.max_handler_name != NULL) {
+		report = talloc_asprintf_append(
+			report, "Slowest: %s (%s), %juus\n",
+			profile.max_handler_name,
+			profile.max_handler_location,
+			(uintmax_t)profile.max_usec);
+	}
+
+	if (report != NULL) {
+		messaging_send_buf(msg_ctx, src, MSG_EVENT_PROFILE,
+				   (uint8_t *)report,
+				   talloc_get_size(report)-1);
+	}
+
+	talloc_free(report);
+}
+
+/**
+ * Register handler for MSG_REQ_EVENT_PROFILE
+ **/
+void register_msg_event_profile(struct messaging_context *msg_ctx)
+{
+	messaging_register(msg_ctx, NULL, MSG_REQ_EVENT_PROFILE,
+			   msg_event_profile);
+	DEBUG(2, ("Registered MSG_REQ_EVENT_PROFILE\n"));
+}
@@ -168,6 +168,14 @@ bool tldap_connection_ok(struct tldap_context *ld)
 	return !ld->server_down;
 }
 
+size_t tldap_pending_reqs(struct tldap_context *ld)
+{
+	if (ld == NULL) {
+		return 0;
+	}
+	return talloc_array_length(ld->pending);
+}
+
 static struct tldap_ctx_attribute *tldap_context_findattr(
 	struct tldap_context *ld, const char *name)
 {
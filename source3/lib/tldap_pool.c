@@ -0,0 +1,169 @@
+/*
+   Unix SMB/CIFS implementation.
+   Shared pool of tldap connections
+   Copyright (C) Volker Lendecke 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "tldap_pool.h"
+#include "../lib/util/dlinklist.h"
+
+struct tldap_pool_conn {
+	struct tldap_pool_conn *prev, *next;
+	struct tldap_context *ld;
+};
+
+struct tldap_pool {
+	uint8_t max_conns;
+	uint8_t num_conns;
+	int (*connect_fn)(void *private_data);
+	int (*bind_fn)(struct tldap_context *ld, void *private_data);
+	void *private_data;
+	struct tldap_pool_conn *conns;
+};
+
+struct tldap_pool *tldap_pool_create(
+	TALLOC_CTX *mem_ctx, uint8_t max_conns,
+	int (*connect_fn)(void *private_data),
+	int (*bind_fn)(struct tldap_context *ld, void *private_data),
+	void *private_data)
+{
+	struct tldap_pool *pool;
+
+	if ((max_conns == 0) || (connect_fn == NULL)) {
+		return NULL;
+	}
+
+	pool = talloc_zero(mem_ctx, struct tldap_pool);
+	if (pool == NULL) {
+		return NULL;
+	}
+	pool->max_conns = max_conns;
+	pool->connect_fn = connect_fn;
+	pool->bind_fn = bind_fn;
+	pool->private_data = private_data;
+
+	return pool;
+}
+
+/*
+ * Throw away connections the server has dropped. tldap marks them via
+ * tldap_connection_ok() as soon as a request hits the dead stream.
+ */
+static void tldap_pool_prune(struct tldap_pool *pool)
+{
+	struct tldap_pool_conn *conn, *next;
+
+	for (conn = pool->conns; conn != NULL; conn = next) {
+		next = conn->next;
+
+		if (tldap_connection_ok(conn->ld)) {
+			continue;
+		}
+		DLIST_REMOVE(pool->conns, conn);
+		pool->num_conns -= 1;
+		TALLOC_FREE(conn);
+	}
+}
+
+static int tldap_pool_dial(struct tldap_pool *pool,
+			   struct tldap_context **pld)
+{
+	struct tldap_pool_conn *conn;
+	int fd, rc;
+
+	conn = talloc_zero(pool, struct tldap_pool_conn);
+	if (conn == NULL) {
+		return TLDAP_NO_MEMORY;
+	}
+
+	fd = pool->connect_fn(pool->private_data);
+	if (fd == -1) {
+		TALLOC_FREE(conn);
+		return TLDAP_SERVER_DOWN;
+	}
+
+	conn->ld = tldap_context_create(conn, fd);
+	if (conn->ld == NULL) {
+		close(fd);
+		TALLOC_FREE(conn);
+		return TLDAP_NO_MEMORY;
+	}
+
+	if (pool->bind_fn != NULL) {
+		rc = pool->bind_fn(conn->ld, pool->private_data);
+		if (rc != TLDAP_SUCCESS) {
+			TALLOC_FREE(conn);
+			return rc;
+		}
+	}
+
+	DLIST_ADD(pool->conns, conn);
+	pool->num_conns += 1;
+
+	*pld = conn->ld;
+	return TLDAP_SUCCESS;
+}
+
+int tldap_pool_get(struct tldap_pool *pool, struct tldap_context **pld)
+{
+	struct tldap_pool_conn *conn;
+	struct tldap_context *best = NULL;
+	size_t best_pending = 0;
+	int rc;
+
+	tldap_pool_prune(pool);
+
+	for (conn = pool->conns; conn != NULL; conn = conn->next) {
+		size_t pending = tldap_pending_reqs(conn->ld);
+
+		if ((best == NULL) || (pending < best_pending)) {
+			best = conn->ld;
+			best_pending = pending;
+		}
+	}
+
+	if ((best != NULL) && (best_pending == 0)) {
+		/* an idle connection, no point in opening another one */
+		*pld = best;
+		return TLDAP_SUCCESS;
+	}
+
+	if (pool->num_conns < pool->max_conns) {
+		rc = tldap_pool_dial(pool, pld);
+		if (rc == TLDAP_SUCCESS) {
+			return TLDAP_SUCCESS;
+		}
+		/*
+		 * Could not grow the pool. Fall back to the least
+		 * loaded existing connection if we have one, the
+		 * requests multiplex by message id anyway.
+		 */
+	}
+
+	if (best != NULL) {
+		*pld = best;
+		return TLDAP_SUCCESS;
+	}
+
+	return TLDAP_SERVER_DOWN;
+}
+
+size_t tldap_pool_num_connections(struct tldap_pool *pool)
+{
+	tldap_pool_prune(pool);
+	return pool->num_conns;
+}
@@ -0,0 +1,132 @@
+/*
+ * Benchmark the unix_msg send/recv path
+ *
+ * Sends messages to the own socket in batches and reports how many
+ * event loop wakeups the receive side needed. With the datagram
+ * batching in unix_msg this should be well below one wakeup per
+ * message, every wakeup saved is a poll and a recvmsg syscall.
+ */
+
+#include "replace.h"
+#include "unix_msg.h"
+#include "poll_funcs/poll_funcs_tevent.h"
+#include "tevent.h"
+#include "system/time.h"
+
+struct cb_state {
+	unsigned num_received;
+};
+
+static void recv_cb(struct unix_msg_ctx *ctx,
+		    uint8_t *msg, size_t msg_len,
+		    int *fds, size_t num_fds,
+		    void *private_data)
+{
+	struct cb_state *state = (struct cb_state *)private_data;
+
+	state->num_received += 1;
+}
+
+int main(int argc, const char *argv[])
+{
+	struct poll_funcs *funcs;
+	void *tevent_handle;
+	struct sockaddr_un addr;
+	struct unix_msg_ctx *ctx;
+	struct tevent_context *ev;
+	struct iovec iov;
+	struct timeval start, end;
+	struct cb_state state;
+	uint8_t buf[256];
+	double elapsed;
+	unsigned num_msgs = 100000;
+	unsigned batch = 64;
+	unsigned num_wakeups = 0;
+	unsigned i, sent;
+	int ret;
+
+	if (argc > 1) {
+		num_msgs = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		batch = atoi(argv[2]);
+	}
+
+	addr = (struct sockaddr_un) { .sun_family = AF_UNIX };
+	strlcpy(addr.sun_path, "bench_sock", sizeof(addr.sun_path));
+	unlink(addr.sun_path);
+
+	ev = tevent_context_init(NULL);
+	if (ev == NULL) {
+		perror("tevent_context_init failed");
+		return 1;
+	}
+	funcs = poll_funcs_init_tevent(ev);
+	if (funcs == NULL) {
+		fprintf(stderr, "poll_funcs_init_tevent failed\n");
+		return 1;
+	}
+	tevent_handle = poll_funcs_tevent_register(ev, funcs, ev);
+	if (tevent_handle == NULL) {
+		fprintf(stderr, "poll_funcs_tevent_register failed\n");
+		return 1;
+	}
+
+	state.num_received = 0;
+
+	ret = unix_msg_init(&addr, funcs, 256, recv_cb, &state, &ctx);
+	if (ret != 0) {
+		fprintf(stderr, "unix_msg_init failed: %s\n",
+			strerror(ret));
+		return 1;
+	}
+
+	memset(buf, 0, sizeof(buf));
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+
+	gettimeofday(&start, NULL);
+
+	for (sent = 0; sent < num_msgs; sent += batch) {
+		unsigned todo = MIN(batch, num_msgs - sent);
+
+		for (i=0; i<todo; i++) {
+			ret = unix_msg_send(ctx, &addr, &iov, 1, NULL, 0);
+			if (ret != 0) {
+				fprintf(stderr, "unix_msg_send failed: %s\n",
+					strerror(ret));
+				return 1;
+			}
+		}
+
+		while (state.num_received < sent + todo) {
+			ret = tevent_loop_once(ev);
+			if (ret == -1) {
+				fprintf(stderr,
+					"tevent_loop_once failed: %s\n",
+					strerror(errno));
+				return 1;
+			}
+			num_wakeups += 1;
+		}
+	}
+
+	gettimeofday(&end, NULL);
+
+	elapsed = (end.tv_sec - start.tv_sec) +
+		(end.tv_usec - start.tv_usec) / 1000000.0;
+
+	printf("%u msgs of %u bytes in %.3f secs: %.0f msgs/sec\n",
+	       num_msgs, (unsigned)sizeof(buf), elapsed,
+	       num_msgs / elapsed);
+	printf("%u wakeups: %.1f msgs/wakeup\n",
+	       num_wakeups, (double)num_msgs / num_wakeups);
+
+	unix_msg_free(ctx);
+	talloc_free(tevent_handle);
+	talloc_free(funcs);
+	talloc_free(ev);
+	unlink(addr.sun_path);
+
+	return 0;
+}
@@ -73,6 +73,16 @@ struct unix_dgram_ctx {
 	struct poll_watch *pool_read_watch;
 
 	uint8_t *recv_buf;
+
+	/*
+	 * The recv handler drains several datagrams per poll
+	 * wakeup. A recv_callback may trigger unix_dgram_free() on
+	 * this ctx; while draining that free is deferred to the end
+	 * of the batch via these flags.
+	 */
+	bool in_recv;
+	bool free_deferred;
+
 	char path[];
 };
 
@@ -264,69 +274,100 @@ fail_free:
 	return ret;
 }
 
+static void unix_dgram_free_internal(struct unix_dgram_ctx *ctx);
+
+/*
+ * Drain up to this many datagrams per poll wakeup. The socket is
+ * nonblocking, so under a message storm this turns one poll round
+ * trip per datagram into one per batch, while the cap keeps other
+ * event sources from starving.
+ */
+#define UNIX_DGRAM_RECV_BATCH 32
+
 static void unix_dgram_recv_handler(struct poll_watch *w, int fd, short events,
 				    void *private_data)
 {
 	struct unix_dgram_ctx *ctx = (struct unix_dgram_ctx *)private_data;
-	ssize_t received;
-	int flags = 0;
-	struct msghdr msg;
-	struct iovec iov;
-	size_t bufsize = msghdr_prep_recv_fds(NULL, NULL, 0, INT8_MAX);
-	uint8_t buf[bufsize];
-
-	iov = (struct iovec) {
-		.iov_base = (void *)ctx->recv_buf,
-		.iov_len = ctx->max_msg,
-	};
+	size_t round;
+
+	ctx->in_recv = true;
+
+	for (round = 0; round < UNIX_DGRAM_RECV_BATCH; round++) {
+		ssize_t received;
+		int flags = 0;
+		struct msghdr msg;
+		struct iovec iov;
+		size_t bufsize = msghdr_prep_recv_fds(NULL, NULL, 0,
+						      INT8_MAX);
+		uint8_t buf[bufsize];
+
+		iov = (struct iovec) {
+			.iov_base = (void *)ctx->recv_buf,
+			.iov_len = ctx->max_msg,
+		};
 
-	msg = (struct msghdr) {
-		.msg_iov = &iov,
-		.msg_iovlen = 1,
-	};
+		msg = (struct msghdr) {
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+		};
 
-	msghdr_prep_recv_fds(&msg, buf, bufsize, INT8_MAX);
+		msghdr_prep_recv_fds(&msg, buf, bufsize, INT8_MAX);
 
 #ifdef MSG_CMSG_CLOEXEC
-	flags |= MSG_CMSG_CLOEXEC;
+		flags |= MSG_CMSG_CLOEXEC;
 #endif
 
-	received = recvmsg(fd, &msg, flags);
-	if (received == -1) {
-		if ((errno == EAGAIN) ||
-		    (errno == EWOULDBLOCK) ||
-		    (errno == EINTR) || (errno == ENOMEM)) {
-			/* Not really an error - just try again. */
-			return;
+		received = recvmsg(fd, &msg, flags);
+		if (received == -1) {
+			if ((errno == EAGAIN) ||
+			    (errno == EWOULDBLOCK) ||
+			    (errno == EINTR) || (errno == ENOMEM)) {
+				/* Not really an error - just try again. */
+				break;
+			}
+			/* Problem with the socket. Set it unreadable. */
+			ctx->ev_funcs->watch_update(w, 0);
+			break;
+		}
+		if (received > ctx->max_msg) {
+			/* More than we expected, not for us */
+			continue;
 		}
-		/* Problem with the socket. Set it unreadable. */
-		ctx->ev_funcs->watch_update(w, 0);
-		return;
-	}
-	if (received > ctx->max_msg) {
-		/* More than we expected, not for us */
-		return;
-	}
 
-	{
-		size_t num_fds = msghdr_extract_fds(&msg, NULL, 0);
-		int fds[num_fds];
-		int i;
+		{
+			size_t num_fds = msghdr_extract_fds(&msg, NULL, 0);
+			int fds[num_fds];
+			int i;
 
-		msghdr_extract_fds(&msg, fds, num_fds);
+			msghdr_extract_fds(&msg, fds, num_fds);
 
-		for (i = 0; i < num_fds; i++) {
-			int err;
+			for (i = 0; i < num_fds; i++) {
+				int err;
 
-			err = prepare_socket_cloexec(fds[i]);
-			if (err != 0) {
-				close_fd_array(fds, num_fds);
-				num_fds = 0;
+				err = prepare_socket_cloexec(fds[i]);
+				if (err != 0) {
+					close_fd_array(fds, num_fds);
+					num_fds = 0;
+				}
 			}
+
+			ctx->recv_callback(ctx, ctx->recv_buf, received,
+					   fds, num_fds, ctx->private_data);
 		}
 
-		ctx->recv_callback(ctx, ctx->recv_buf, received,
-				   fds, num_fds, ctx->private_data);
+		if (ctx->free_deferred) {
+			/*
+			 * The callback asked to free "ctx", don't
+			 * touch the socket again.
+			 */
+			break;
+		}
+	}
+
+	ctx->in_recv = false;
+
+	if (ctx->free_deferred) {
+		unix_dgram_free_internal(ctx);
 	}
 }
 
@@ -668,17 +709,14 @@ static int unix_dgram_sock(struct unix_dgram_ctx *ctx)
 	return ctx->sock;
 }
 
-static int unix_dgram_free(struct unix_dgram_ctx *ctx)
+static void unix_dgram_free_internal(struct unix_dgram_ctx *ctx)
 {
-	if (ctx->send_queues != NULL) {
-		return EBUSY;
-	}
-
 	if (ctx->send_pool != NULL) {
-		int ret = pthreadpool_destroy(ctx->send_pool);
-		if (ret != 0) {
-			return ret;
-		}
+		/*
+		 * With no send queues left the pool is idle, so this
+		 * cannot fail with EBUSY.
+		 */
+		pthreadpool_destroy(ctx->send_pool);
 		ctx->ev_funcs->watch_free(ctx->pool_read_watch);
 	}
 
@@ -693,6 +731,25 @@ static int unix_dgram_free(struct unix_dgram_ctx *ctx)
 
 	free(ctx->recv_buf);
 	free(ctx);
+}
+
+static int unix_dgram_free(struct unix_dgram_ctx *ctx)
+{
+	if (ctx->send_queues != NULL) {
+		return EBUSY;
+	}
+
+	if (ctx->in_recv) {
+		/*
+		 * Called from a recv_callback while we're draining a
+		 * batch of datagrams. The recv handler finishes the
+		 * free once it is done with "ctx".
+		 */
+		ctx->free_deferred = true;
+		return 0;
+	}
+
+	unix_dgram_free_internal(ctx);
 	return 0;
 }
 
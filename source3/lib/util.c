@@ -1675,6 +1675,32 @@ bool mask_match_search(const char *string, const char *pattern, bool is_case_sen
 	return ms_fnmatch(pattern, string, True, is_case_sensitive) == 0;
 }
 
+/*******************************************************************
+ Compiled variants of mask_match() for callers matching one mask
+ against many names. mask_match_compile() returns NULL if the mask
+ cannot be compiled (or can never match) - callers then fall back to
+ plain mask_match().
+*******************************************************************/
+
+struct ms_fnmatch_compiled *mask_match_compile(TALLOC_CTX *mem_ctx,
+					       const char *pattern,
+					       bool is_case_sensitive)
+{
+	if (ISDOT(pattern)) {
+		return NULL;
+	}
+
+	return ms_fnmatch_compile(mem_ctx, pattern,
+				  Protocol <= PROTOCOL_LANMAN2,
+				  is_case_sensitive);
+}
+
+bool mask_match_compiled(const char *string,
+			 struct ms_fnmatch_compiled *compiled)
+{
+	return ms_fnmatch_compiled(compiled, string) == 0;
+}
+
 /*******************************************************************
  A wrapper that handles a list of patters and calls mask_match()
  on each.  Returns True if any of the patterns match.
@@ -83,15 +83,20 @@ NTSTATUS merge_nt_token(TALLOC_CTX *mem_ctx,
 	token = talloc_zero(mem_ctx, struct security_token);
 	NT_STATUS_HAVE_NO_MEMORY(token);
 
-	for (i=0; i < token_1->num_sids; i++) {
-		status = add_sid_to_array_unique(mem_ctx,
-						 &token_1->sids[i],
-						 &token->sids,
-						 &token->num_sids);
-		if (!NT_STATUS_IS_OK(status)) {
+	/*
+	 * The SIDs within a token are already unique, so the first
+	 * token can be taken over wholesale. Only the second one has
+	 * to be checked for duplicates.
+	 */
+	if (token_1->sids && token_1->num_sids) {
+		token->sids = (struct dom_sid *)talloc_memdup(
+			mem_ctx, token_1->sids,
+			sizeof(struct dom_sid) * token_1->num_sids);
+		if (token->sids == NULL) {
 			TALLOC_FREE(token);
-			return status;
+			return NT_STATUS_NO_MEMORY;
 		}
+		token->num_sids = token_1->num_sids;
 	}
 
 	for (i=0; i < token_2->num_sids; i++) {
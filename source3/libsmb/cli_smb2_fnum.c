@@ -909,6 +909,550 @@ NTSTATUS cli_smb2_qpathinfo_basic(struct cli_state *cli,
 	return NT_STATUS_OK;
 }
 
+/***************************************************************
+ Stat a pathname in one network round trip.
+
+ CREATE, GETINFO(SMB2_FILE_ALL_INFORMATION) and CLOSE are packed
+ as related compound requests into a single network buffer. The
+ GETINFO and CLOSE refer to the handle the server assigns to the
+ preceding CREATE via the compound file id UINT64_MAX.
+
+ We have to marshall the request bodies ourselves with
+ smb2cli_req_create(), the smb2cli_create/query_info/close
+ wrappers submit their request straight away and can't be
+ compounded.
+***************************************************************/
+
+struct cli_smb2_compound_stat_state {
+	uint8_t create_fixed[56];
+	uint8_t getinfo_fixed[0x28];
+	uint8_t getinfo_dyn_pad[1];
+	uint8_t close_fixed[24];
+
+	struct tevent_req *subreqs[3];
+	size_t num_received;
+
+	NTSTATUS create_status;
+	NTSTATUS getinfo_status;
+	NTSTATUS close_status;
+
+	SMB_STRUCT_STAT sbuf;
+	uint32_t attributes;
+};
+
+static void cli_smb2_compound_stat_created(struct tevent_req *subreq);
+static void cli_smb2_compound_stat_queried(struct tevent_req *subreq);
+static void cli_smb2_compound_stat_closed(struct tevent_req *subreq);
+static void cli_smb2_compound_stat_maybe_done(struct tevent_req *req);
+
+struct tevent_req *cli_smb2_compound_stat_send(TALLOC_CTX *mem_ctx,
+					       struct tevent_context *ev,
+					       struct cli_state *cli,
+					       const char *name)
+{
+	struct tevent_req *req;
+	struct cli_smb2_compound_stat_state *state;
+	uint8_t *name_utf16 = NULL;
+	size_t name_utf16_len = 0;
+	uint8_t *fixed;
+	uint8_t *dyn;
+	size_t dyn_len;
+	size_t namelen;
+	uint32_t additional_flags = 0;
+	NTSTATUS status;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct cli_smb2_compound_stat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	if (smbXcli_conn_protocol(cli->conn) < PROTOCOL_SMB2_02) {
+		tevent_req_nterror(req, NT_STATUS_INVALID_PARAMETER);
+		return tevent_req_post(req, ev);
+	}
+
+	/* SMB2 is pickier about pathnames. Ensure it doesn't
+	   start or end in a '\' */
+	if (*name == '\\') {
+		name++;
+	}
+	namelen = strlen(name);
+	if (namelen > 0 && name[namelen-1] == '\\') {
+		char *modname = talloc_strndup(state, name, namelen-1);
+		if (tevent_req_nomem(modname, req)) {
+			return tevent_req_post(req, ev);
+		}
+		name = modname;
+		namelen -= 1;
+	}
+
+	if (namelen > 0) {
+		if (!convert_string_talloc(state, CH_UNIX, CH_UTF16,
+					   name, namelen,
+					   &name_utf16, &name_utf16_len)) {
+			tevent_req_oom(req);
+			return tevent_req_post(req, ev);
+		}
+	}
+
+	/*
+	 * Marshall the CREATE the way smb2cli_create_send() does,
+	 * minus create blobs which a stat does not need. Attributes
+	 * and create options are left at 0 so that both files and
+	 * directories open fine with FILE_READ_ATTRIBUTES.
+	 */
+	fixed = state->create_fixed;
+	SSVAL(fixed, 0, 57);
+	SCVAL(fixed, 3, SMB2_OPLOCK_LEVEL_NONE);
+	SIVAL(fixed, 4, SMB2_IMPERSONATION_IMPERSONATION);
+	SIVAL(fixed, 24, FILE_READ_ATTRIBUTES);
+	SIVAL(fixed, 32,
+	      FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE);
+	SIVAL(fixed, 36, FILE_OPEN);
+	SSVAL(fixed, 44, SMB2_HDR_BODY + 56);
+	SSVAL(fixed, 46, name_utf16_len);
+
+	dyn_len = MAX(1, name_utf16_len);
+	dyn = talloc_zero_array(state, uint8_t, dyn_len);
+	if (tevent_req_nomem(dyn, req)) {
+		return tevent_req_post(req, ev);
+	}
+	if (name_utf16 != NULL) {
+		memcpy(dyn, name_utf16, name_utf16_len);
+		TALLOC_FREE(name_utf16);
+	}
+
+	if (smbXcli_conn_dfs_supported(cli->conn) &&
+	    smbXcli_tcon_is_dfs_share(cli->smb2.tcon)) {
+		additional_flags |= SMB2_HDR_FLAG_DFS;
+	}
+
+	state->subreqs[0] = smb2cli_req_create(state, ev, cli->conn,
+					       SMB2_OP_CREATE,
+					       additional_flags,
+					       0, /* clear_flags */
+					       cli->timeout,
+					       cli->smb2.tcon,
+					       cli->smb2.session,
+					       state->create_fixed,
+					       sizeof(state->create_fixed),
+					       dyn, dyn_len,
+					       0); /* max_dyn_len */
+	if (tevent_req_nomem(state->subreqs[0], req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(state->subreqs[0],
+				cli_smb2_compound_stat_created, req);
+
+	/* getinfo on the compound handle with info_type
+	   SMB2_GETINFO_FILE (1), level 0x12 (SMB2_FILE_ALL_INFORMATION). */
+
+	fixed = state->getinfo_fixed;
+	SSVAL(fixed, 0x00, 0x29);
+	SCVAL(fixed, 0x02, 1); /* in_info_type */
+	SCVAL(fixed, 0x03, (SMB_FILE_ALL_INFORMATION - 1000));
+	SIVAL(fixed, 0x04, 0xFFFF); /* in_max_output_length */
+	SBVAL(fixed, 0x18, UINT64_MAX);
+	SBVAL(fixed, 0x20, UINT64_MAX);
+
+	state->subreqs[1] = smb2cli_req_create(state, ev, cli->conn,
+					       SMB2_OP_GETINFO,
+					       SMB2_HDR_FLAG_CHAINED,
+					       0, /* clear_flags */
+					       cli->timeout,
+					       cli->smb2.tcon,
+					       cli->smb2.session,
+					       state->getinfo_fixed,
+					       sizeof(state->getinfo_fixed),
+					       state->getinfo_dyn_pad,
+					       sizeof(state->getinfo_dyn_pad),
+					       0xFFFF); /* max_dyn_len */
+	if (tevent_req_nomem(state->subreqs[1], req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(state->subreqs[1],
+				cli_smb2_compound_stat_queried, req);
+
+	fixed = state->close_fixed;
+	SSVAL(fixed, 0, 24);
+	SBVAL(fixed, 8, UINT64_MAX);
+	SBVAL(fixed, 16, UINT64_MAX);
+
+	state->subreqs[2] = smb2cli_req_create(state, ev, cli->conn,
+					       SMB2_OP_CLOSE,
+					       SMB2_HDR_FLAG_CHAINED,
+					       0, /* clear_flags */
+					       cli->timeout,
+					       cli->smb2.tcon,
+					       cli->smb2.session,
+					       state->close_fixed,
+					       sizeof(state->close_fixed),
+					       NULL, 0, /* dyn* */
+					       0); /* max_dyn_len */
+	if (tevent_req_nomem(state->subreqs[2], req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(state->subreqs[2],
+				cli_smb2_compound_stat_closed, req);
+
+	status = smb2cli_req_compound_submit(state->subreqs,
+					     ARRAY_SIZE(state->subreqs));
+	if (tevent_req_nterror(req, status)) {
+		return tevent_req_post(req, ev);
+	}
+	return req;
+}
+
+static void cli_smb2_compound_stat_created(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct cli_smb2_compound_stat_state *state = tevent_req_data(
+		req, struct cli_smb2_compound_stat_state);
+	static const struct smb2cli_req_expected_response expected[] = {
+	{
+		.status = NT_STATUS_OK,
+		.body_size = 0x59
+	}
+	};
+
+	/*
+	 * All interesting data comes back in the GETINFO reply, the
+	 * CREATE body is only checked for validity.
+	 */
+	state->create_status = smb2cli_req_recv(subreq, NULL, NULL,
+						expected,
+						ARRAY_SIZE(expected));
+	TALLOC_FREE(subreq);
+	state->subreqs[0] = NULL;
+	cli_smb2_compound_stat_maybe_done(req);
+}
+
+static void cli_smb2_compound_stat_queried(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct cli_smb2_compound_stat_state *state = tevent_req_data(
+		req, struct cli_smb2_compound_stat_state);
+	struct iovec *iov;
+	NTSTATUS status;
+	static const struct smb2cli_req_expected_response expected[] = {
+	{
+		.status = NT_STATUS_OK,
+		.body_size = 0x09
+	}
+	};
+
+	status = smb2cli_req_recv(subreq, state, &iov,
+				  expected, ARRAY_SIZE(expected));
+	TALLOC_FREE(subreq);
+	state->subreqs[1] = NULL;
+	state->getinfo_status = status;
+
+	if (NT_STATUS_IS_OK(status)) {
+		const uint8_t *body = (const uint8_t *)iov[1].iov_base;
+		const uint8_t *dyn = (const uint8_t *)iov[2].iov_base;
+		uint32_t output_buffer_offset = SVAL(body, 0x02);
+		uint32_t output_buffer_length = IVAL(body, 0x04);
+
+		if ((output_buffer_offset != SMB2_HDR_BODY + 0x08) ||
+		    (output_buffer_length > iov[2].iov_len) ||
+		    (output_buffer_length < 0x60)) {
+			state->getinfo_status =
+				NT_STATUS_INVALID_NETWORK_RESPONSE;
+			cli_smb2_compound_stat_maybe_done(req);
+			return;
+		}
+
+		state->sbuf.st_ex_btime =
+			interpret_long_date((const char *)dyn + 0x0);
+		state->sbuf.st_ex_atime =
+			interpret_long_date((const char *)dyn + 0x8);
+		state->sbuf.st_ex_mtime =
+			interpret_long_date((const char *)dyn + 0x10);
+		state->sbuf.st_ex_ctime =
+			interpret_long_date((const char *)dyn + 0x18);
+		state->attributes = IVAL(dyn, 0x20);
+		state->sbuf.st_ex_size = (off_t)BVAL(dyn, 0x30);
+		state->sbuf.st_ex_nlink = IVAL(dyn, 0x38);
+		state->sbuf.st_ex_ino = (SMB_INO_T)BVAL(dyn, 0x40);
+	}
+
+	cli_smb2_compound_stat_maybe_done(req);
+}
+
+static void cli_smb2_compound_stat_closed(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct cli_smb2_compound_stat_state *state = tevent_req_data(
+		req, struct cli_smb2_compound_stat_state);
+	static const struct smb2cli_req_expected_response expected[] = {
+	{
+		.status = NT_STATUS_OK,
+		.body_size = 0x3C
+	}
+	};
+
+	state->close_status = smb2cli_req_recv(subreq, NULL, NULL,
+					       expected,
+					       ARRAY_SIZE(expected));
+	TALLOC_FREE(subreq);
+	state->subreqs[2] = NULL;
+	cli_smb2_compound_stat_maybe_done(req);
+}
+
+static void cli_smb2_compound_stat_maybe_done(struct tevent_req *req)
+{
+	struct cli_smb2_compound_stat_state *state = tevent_req_data(
+		req, struct cli_smb2_compound_stat_state);
+
+	state->num_received += 1;
+	if (state->num_received < ARRAY_SIZE(state->subreqs)) {
+		/*
+		 * Wait for the remaining replies of the compound
+		 */
+		return;
+	}
+
+	if (tevent_req_nterror(req, state->create_status)) {
+		return;
+	}
+	if (tevent_req_nterror(req, state->getinfo_status)) {
+		return;
+	}
+	if (tevent_req_nterror(req, state->close_status)) {
+		return;
+	}
+	tevent_req_done(req);
+}
+
+NTSTATUS cli_smb2_compound_stat_recv(struct tevent_req *req,
+				     SMB_STRUCT_STAT *sbuf,
+				     uint32_t *attributes)
+{
+	struct cli_smb2_compound_stat_state *state = tevent_req_data(
+		req, struct cli_smb2_compound_stat_state);
+	NTSTATUS status;
+
+	if (tevent_req_is_nterror(req, &status)) {
+		return status;
+	}
+	if (sbuf != NULL) {
+		*sbuf = state->sbuf;
+	}
+	if (attributes != NULL) {
+		*attributes = state->attributes;
+	}
+	return NT_STATUS_OK;
+}
+
+/***************************************************************
+ Stat a whole list of pathnames, keeping a window of compound
+ open/query/close requests in flight. Failure to stat one name
+ is reported in its slot of the returned status array and does
+ not abort the others.
+***************************************************************/
+
+struct cli_smb2_stat_many_one {
+	struct tevent_req *req;
+	int idx;
+};
+
+struct cli_smb2_stat_many_state {
+	struct tevent_context *ev;
+	struct cli_state *cli;
+	int num_names;
+	const char **names;
+
+	NTSTATUS *statuses;
+	SMB_STRUCT_STAT *sbufs;
+	uint32_t *attrs;
+
+	int num_sent;
+	int num_received;
+	int max_outstanding;
+};
+
+static void cli_smb2_stat_many_setup(struct tevent_req *req);
+static void cli_smb2_stat_many_done(struct tevent_req *subreq);
+
+struct tevent_req *cli_smb2_stat_many_send(TALLOC_CTX *mem_ctx,
+					   struct tevent_context *ev,
+					   struct cli_state *cli,
+					   int num_names,
+					   const char **names)
+{
+	struct tevent_req *req;
+	struct cli_smb2_stat_many_state *state;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct cli_smb2_stat_many_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	state->ev = ev;
+	state->cli = cli;
+	state->num_names = num_names;
+	state->names = names;
+
+	if (smbXcli_conn_protocol(cli->conn) < PROTOCOL_SMB2_02) {
+		tevent_req_nterror(req, NT_STATUS_INVALID_PARAMETER);
+		return tevent_req_post(req, ev);
+	}
+
+	if (num_names == 0) {
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+
+	state->statuses = talloc_zero_array(state, NTSTATUS, num_names);
+	if (tevent_req_nomem(state->statuses, req)) {
+		return tevent_req_post(req, ev);
+	}
+	state->sbufs = talloc_zero_array(state, SMB_STRUCT_STAT, num_names);
+	if (tevent_req_nomem(state->sbufs, req)) {
+		return tevent_req_post(req, ev);
+	}
+	state->attrs = talloc_zero_array(state, uint32_t, num_names);
+	if (tevent_req_nomem(state->attrs, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	/*
+	 * Each compound costs 3 credits, keep a good deal of the
+	 * default 512 available for others.
+	 */
+	state->max_outstanding = 16;
+
+	cli_smb2_stat_many_setup(req);
+	if (!tevent_req_is_in_progress(req)) {
+		return tevent_req_post(req, ev);
+	}
+	return req;
+}
+
+static void cli_smb2_stat_many_setup(struct tevent_req *req)
+{
+	struct cli_smb2_stat_many_state *state = tevent_req_data(
+		req, struct cli_smb2_stat_many_state);
+
+	while ((state->num_sent < state->num_names) &&
+	       (state->num_sent - state->num_received <
+		state->max_outstanding)) {
+		struct cli_smb2_stat_many_one *one;
+		struct tevent_req *subreq;
+
+		one = talloc(state, struct cli_smb2_stat_many_one);
+		if (tevent_req_nomem(one, req)) {
+			return;
+		}
+		one->req = req;
+		one->idx = state->num_sent;
+
+		subreq = cli_smb2_compound_stat_send(
+			one, state->ev, state->cli,
+			state->names[state->num_sent]);
+		if (tevent_req_nomem(subreq, req)) {
+			return;
+		}
+		tevent_req_set_callback(subreq, cli_smb2_stat_many_done,
+					one);
+		state->num_sent += 1;
+	}
+}
+
+static void cli_smb2_stat_many_done(struct tevent_req *subreq)
+{
+	struct cli_smb2_stat_many_one *one = tevent_req_callback_data(
+		subreq, struct cli_smb2_stat_many_one);
+	struct tevent_req *req = one->req;
+	struct cli_smb2_stat_many_state *state = tevent_req_data(
+		req, struct cli_smb2_stat_many_state);
+	int idx = one->idx;
+
+	state->statuses[idx] = cli_smb2_compound_stat_recv(
+		subreq, &state->sbufs[idx], &state->attrs[idx]);
+	TALLOC_FREE(subreq);
+	TALLOC_FREE(one);
+	state->num_received += 1;
+
+	if (!smbXcli_conn_is_connected(state->cli->conn)) {
+		tevent_req_nterror(req, NT_STATUS_CONNECTION_DISCONNECTED);
+		return;
+	}
+
+	if (state->num_received == state->num_names) {
+		tevent_req_done(req);
+		return;
+	}
+	cli_smb2_stat_many_setup(req);
+}
+
+NTSTATUS cli_smb2_stat_many_recv(struct tevent_req *req,
+				 TALLOC_CTX *mem_ctx,
+				 NTSTATUS **statuses,
+				 SMB_STRUCT_STAT **sbufs,
+				 uint32_t **attrs)
+{
+	struct cli_smb2_stat_many_state *state = tevent_req_data(
+		req, struct cli_smb2_stat_many_state);
+	NTSTATUS status;
+
+	if (tevent_req_is_nterror(req, &status)) {
+		return status;
+	}
+	if (statuses != NULL) {
+		*statuses = talloc_move(mem_ctx, &state->statuses);
+	}
+	if (sbufs != NULL) {
+		*sbufs = talloc_move(mem_ctx, &state->sbufs);
+	}
+	if (attrs != NULL) {
+		*attrs = talloc_move(mem_ctx, &state->attrs);
+	}
+	return NT_STATUS_OK;
+}
+
+NTSTATUS cli_smb2_stat_many(struct cli_state *cli,
+			    int num_names,
+			    const char **names,
+			    TALLOC_CTX *mem_ctx,
+			    NTSTATUS **statuses,
+			    SMB_STRUCT_STAT **sbufs,
+			    uint32_t **attrs)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	struct tevent_context *ev;
+	struct tevent_req *req;
+	NTSTATUS status = NT_STATUS_NO_MEMORY;
+
+	if (smbXcli_conn_has_async_calls(cli->conn)) {
+		/*
+		 * Can't use sync call while an async call is in flight
+		 */
+		status = NT_STATUS_INVALID_PARAMETER;
+		goto fail;
+	}
+	ev = samba_tevent_context_init(frame);
+	if (ev == NULL) {
+		goto fail;
+	}
+	req = cli_smb2_stat_many_send(frame, ev, cli, num_names, names);
+	if (req == NULL) {
+		goto fail;
+	}
+	if (!tevent_req_poll_ntstatus(req, ev, &status)) {
+		goto fail;
+	}
+	status = cli_smb2_stat_many_recv(req, mem_ctx,
+					 statuses, sbufs, attrs);
+ fail:
+	TALLOC_FREE(frame);
+	return status;
+}
+
 /***************************************************************
  Helper function for pathname operations.
 ***************************************************************/
@@ -2429,6 +2973,8 @@ NTSTATUS cli_smb2_write_recv(struct tevent_req *req,
  for free :-).
 ***************************************************************/
 
+struct cli_smb2_writeall_chunk;
+
 struct cli_smb2_writeall_state {
 	struct tevent_context *ev;
 	struct cli_state *cli;
@@ -2438,9 +2984,36 @@ struct cli_smb2_writeall_state {
 	uint64_t offset;
 	uint32_t size;
 	uint32_t written;
+
+	uint32_t chunk_size;
+	uint32_t next_ofs;
+
+	/*
+	 * Outstanding requests
+	 *
+	 * The maximum is 256:
+	 * - which would be a window of 256 MByte
+	 *   with multi-credit
+	 */
+	uint16_t max_chunks;
+	uint16_t num_chunks;
+	uint16_t num_waiting;
+	struct cli_smb2_writeall_chunk *chunks;
+};
+
+struct cli_smb2_writeall_chunk {
+	struct cli_smb2_writeall_chunk *prev, *next;
+	struct tevent_req *req;/* This is the main request! Not the subreq */
+	struct tevent_req *subreq;
+	uint32_t ofs;/* relative to state->buf */
+	uint32_t total_size;
+	uint32_t tmp_size;
+	bool done;
 };
 
-static void cli_smb2_writeall_written(struct tevent_req *req);
+static void cli_smb2_writeall_setup_chunks(struct tevent_req *req);
+static void cli_smb2_writeall_chunk_ship(struct cli_smb2_writeall_chunk *chunk);
+static void cli_smb2_writeall_chunk_done(struct tevent_req *subreq);
 
 struct tevent_req *cli_smb2_writeall_send(TALLOC_CTX *mem_ctx,
 					struct tevent_context *ev,
@@ -2452,11 +3025,11 @@ struct tevent_req *cli_smb2_writeall_send(TALLOC_CTX *mem_ctx,
 					size_t size)
 {
 	NTSTATUS status;
-	struct tevent_req *req, *subreq = NULL;
+	struct tevent_req *req;
 	struct cli_smb2_writeall_state *state = NULL;
-	uint32_t to_write;
-	uint32_t max_size;
-	bool ok;
+	size_t page_size = 1024;
+	uint64_t window_size = 16 * 1024 * 1024;
+	uint64_t tmp64;
 
 	req = tevent_req_create(mem_ctx, &state, struct cli_smb2_writeall_state);
 	if (req == NULL) {
@@ -2470,6 +3043,7 @@ struct tevent_req *cli_smb2_writeall_send(TALLOC_CTX *mem_ctx,
 	state->offset = (uint64_t)offset;
 	state->size = (uint32_t)size;
 	state->written = 0;
+	state->next_ofs = 0;
 
 	status = map_fnum_to_smb2_handle(cli,
 					fnum,
@@ -2478,91 +3052,198 @@ struct tevent_req *cli_smb2_writeall_send(TALLOC_CTX *mem_ctx,
 		return tevent_req_post(req, ev);
 	}
 
-	to_write = state->size;
-	max_size = smb2cli_conn_max_write_size(state->cli->conn);
-	to_write = MIN(max_size, to_write);
-	ok = smb2cli_conn_req_possible(state->cli->conn, &max_size);
-	if (ok) {
-		to_write = MIN(max_size, to_write);
+	if (size == 0) {
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
 	}
 
-	subreq = smb2cli_write_send(state,
-				state->ev,
-				state->cli->conn,
-				state->cli->timeout,
-				state->cli->smb2.session,
-				state->cli->smb2.tcon,
-				to_write,
-				state->offset,
-				state->ph->fid_persistent,
-				state->ph->fid_volatile,
-				0, /* remaining_bytes */
-				state->flags, /* flags */
-				state->buf + state->written);
+	state->chunk_size = smb2cli_conn_max_write_size(cli->conn);
+	if (state->chunk_size > page_size) {
+		state->chunk_size &= ~(page_size - 1);
+	}
 
-	if (tevent_req_nomem(subreq, req)) {
+	tmp64 = window_size/state->chunk_size;
+	if ((window_size % state->chunk_size) > 0) {
+		tmp64 += 1;
+	}
+	tmp64 = MAX(tmp64, 1);
+	tmp64 = MIN(tmp64, 256);
+	state->max_chunks = tmp64;
+
+	/*
+	 * We defer the callback because of the complex
+	 * substate/subfunction logic
+	 */
+	tevent_req_defer_callback(req, ev);
+
+	cli_smb2_writeall_setup_chunks(req);
+	if (!tevent_req_is_in_progress(req)) {
 		return tevent_req_post(req, ev);
 	}
-	tevent_req_set_callback(subreq, cli_smb2_writeall_written, req);
+
 	return req;
 }
 
-static void cli_smb2_writeall_written(struct tevent_req *subreq)
+static void cli_smb2_writeall_setup_chunks(struct tevent_req *req)
 {
-	struct tevent_req *req = tevent_req_callback_data(
-		subreq, struct tevent_req);
 	struct cli_smb2_writeall_state *state = tevent_req_data(
 		req, struct cli_smb2_writeall_state);
-        NTSTATUS status;
-	uint32_t written, to_write;
-	uint32_t max_size;
-	bool ok;
+	struct cli_smb2_writeall_chunk *chunk, *next = NULL;
+	size_t i;
 
-	status = smb2cli_write_recv(subreq, &written);
-	TALLOC_FREE(subreq);
-	if (tevent_req_nterror(req, status)) {
-		return;
+	for (chunk = state->chunks; chunk; chunk = next) {
+		/*
+		 * Note that chunk might be removed from this call.
+		 */
+		next = chunk->next;
+		cli_smb2_writeall_chunk_ship(chunk);
+		if (!tevent_req_is_in_progress(req)) {
+			return;
+		}
 	}
 
-	state->written += written;
+	for (i = state->num_chunks; i < state->max_chunks; i++) {
 
-	if (state->written > state->size) {
-		tevent_req_nterror(req, NT_STATUS_INVALID_NETWORK_RESPONSE);
+		if (state->num_waiting > 0) {
+			return;
+		}
+
+		if (state->next_ofs == state->size) {
+			break;
+		}
+
+		chunk = talloc_zero(state, struct cli_smb2_writeall_chunk);
+		if (tevent_req_nomem(chunk, req)) {
+			return;
+		}
+		chunk->req = req;
+		chunk->ofs = state->next_ofs;
+		chunk->total_size = MIN(state->size - state->next_ofs,
+					state->chunk_size);
+		state->next_ofs += chunk->total_size;
+
+		DLIST_ADD_END(state->chunks, chunk, NULL);
+		state->num_chunks++;
+		state->num_waiting++;
+
+		cli_smb2_writeall_chunk_ship(chunk);
+		if (!tevent_req_is_in_progress(req)) {
+			return;
+		}
+	}
+
+	if (state->next_ofs < state->size) {
 		return;
 	}
 
-	to_write = state->size - state->written;
+	if (state->num_chunks > 0) {
+		return;
+	}
 
-	if (to_write == 0) {
-		tevent_req_done(req);
+	tevent_req_done(req);
+}
+
+static void cli_smb2_writeall_chunk_ship(struct cli_smb2_writeall_chunk *chunk)
+{
+	struct tevent_req *req = chunk->req;
+	struct cli_smb2_writeall_state *state = tevent_req_data(
+		req, struct cli_smb2_writeall_state);
+	bool ok;
+	uint32_t ofs;
+	uint32_t size;
+	uint32_t max_size;
+
+	if (chunk->done) {
+		DLIST_REMOVE(state->chunks, chunk);
+		SMB_ASSERT(state->num_chunks > 0);
+		state->num_chunks--;
+		TALLOC_FREE(chunk);
+
+		return;
+	}
+
+	if (chunk->subreq != NULL) {
 		return;
 	}
 
-	max_size = smb2cli_conn_max_write_size(state->cli->conn);
-	to_write = MIN(max_size, to_write);
+	SMB_ASSERT(state->num_waiting > 0);
+
+	ofs = chunk->ofs + chunk->tmp_size;
+	size = chunk->total_size - chunk->tmp_size;
+
 	ok = smb2cli_conn_req_possible(state->cli->conn, &max_size);
-	if (ok) {
-		to_write = MIN(max_size, to_write);
+	if (!ok) {
+		return;
 	}
 
-	subreq = smb2cli_write_send(state,
+	/*
+	 * downgrade depending on the available credits
+	 */
+	size = MIN(max_size, size);
+
+	chunk->subreq = smb2cli_write_send(chunk,
 				state->ev,
 				state->cli->conn,
 				state->cli->timeout,
 				state->cli->smb2.session,
 				state->cli->smb2.tcon,
-				to_write,
-				state->offset + state->written,
+				size,
+				state->offset + ofs,
 				state->ph->fid_persistent,
 				state->ph->fid_volatile,
 				0, /* remaining_bytes */
 				state->flags, /* flags */
-				state->buf + state->written);
+				state->buf + ofs);
+	if (tevent_req_nomem(chunk->subreq, req)) {
+		return;
+	}
+	tevent_req_set_callback(chunk->subreq,
+				cli_smb2_writeall_chunk_done,
+				chunk);
 
-	if (tevent_req_nomem(subreq, req)) {
+	state->num_waiting--;
+	return;
+}
+
+static void cli_smb2_writeall_chunk_done(struct tevent_req *subreq)
+{
+	struct cli_smb2_writeall_chunk *chunk = tevent_req_callback_data(
+		subreq, struct cli_smb2_writeall_chunk);
+	struct tevent_req *req = chunk->req;
+	struct cli_smb2_writeall_state *state = tevent_req_data(
+		req, struct cli_smb2_writeall_state);
+	NTSTATUS status;
+	uint32_t expected = chunk->total_size - chunk->tmp_size;
+	uint32_t written;
+
+	chunk->subreq = NULL;
+
+	status = smb2cli_write_recv(subreq, &written);
+	TALLOC_FREE(subreq);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+
+	if (written > expected) {
+		tevent_req_nterror(req, NT_STATUS_INVALID_NETWORK_RESPONSE);
 		return;
 	}
-	tevent_req_set_callback(subreq, cli_smb2_writeall_written, req);
+
+	if (written == 0) {
+		tevent_req_nterror(req, NT_STATUS_INVALID_NETWORK_RESPONSE);
+		return;
+	}
+
+	chunk->tmp_size += written;
+	state->written += written;
+
+	if (chunk->tmp_size == chunk->total_size) {
+		chunk->done = true;
+	} else {
+		state->num_waiting++;
+	}
+
+	cli_smb2_writeall_setup_chunks(req);
 }
 
 NTSTATUS cli_smb2_writeall_recv(struct tevent_req *req,
@@ -69,6 +69,30 @@ NTSTATUS cli_smb2_qpathinfo_basic(struct cli_state *cli,
 			const char *name,
 			SMB_STRUCT_STAT *sbuf,
 			uint32_t *attributes);
+struct tevent_req *cli_smb2_compound_stat_send(TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct cli_state *cli,
+			const char *name);
+NTSTATUS cli_smb2_compound_stat_recv(struct tevent_req *req,
+			SMB_STRUCT_STAT *sbuf,
+			uint32_t *attributes);
+struct tevent_req *cli_smb2_stat_many_send(TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct cli_state *cli,
+			int num_names,
+			const char **names);
+NTSTATUS cli_smb2_stat_many_recv(struct tevent_req *req,
+			TALLOC_CTX *mem_ctx,
+			NTSTATUS **statuses,
+			SMB_STRUCT_STAT **sbufs,
+			uint32_t **attrs);
+NTSTATUS cli_smb2_stat_many(struct cli_state *cli,
+			int num_names,
+			const char **names,
+			TALLOC_CTX *mem_ctx,
+			NTSTATUS **statuses,
+			SMB_STRUCT_STAT **sbufs,
+			uint32_t **attrs);
 NTSTATUS cli_smb2_qpathinfo_alt_name(struct cli_state *cli,
 			const char *name,
 			fstring alt_name);
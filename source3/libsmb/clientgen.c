@@ -248,6 +248,124 @@ struct cli_state *cli_state_create(TALLOC_CTX *mem_ctx,
         return NULL;
 }
 
+/*
+ * Tracker for cli_states multiplexing tree connects over one
+ * transport and session. The transport and session are reparented
+ * onto the tracker, which is freed together with them when the last
+ * member is shut down.
+ */
+struct cli_conn_share {
+	size_t refcount;
+};
+
+/****************************************************************************
+ Create a second cli_state sharing the transport and session of an
+ existing one, so that an additional tree connect multiplexes over the
+ same TCP connection instead of paying for a fresh connect, negprot
+ and session setup. Only possible for SMB2 and higher, returns NULL
+ otherwise. The caller owns the new tcon via cli_tree_connect(); the
+ transport stays alive until the last sharing cli_state is shut down.
+****************************************************************************/
+
+struct cli_state *cli_state_share_conn(TALLOC_CTX *mem_ctx,
+				       struct cli_state *cli)
+{
+	struct cli_state *ret = NULL;
+
+	if (smbXcli_conn_protocol(cli->conn) < PROTOCOL_SMB2_02) {
+		/*
+		 * SMB1 vuid/tid multiplexing is not worth the hassle
+		 */
+		return NULL;
+	}
+	if (!smbXcli_conn_is_connected(cli->conn)) {
+		return NULL;
+	}
+	if (cli->smb2.session == NULL) {
+		return NULL;
+	}
+
+	ret = talloc_zero(mem_ctx, struct cli_state);
+	if (ret == NULL) {
+		return NULL;
+	}
+
+	ret->server_domain = talloc_strdup(ret, cli->server_domain);
+	if (ret->server_domain == NULL) {
+		goto error;
+	}
+	ret->server_os = talloc_strdup(ret, cli->server_os);
+	if (ret->server_os == NULL) {
+		goto error;
+	}
+	ret->server_type = talloc_strdup(ret, cli->server_type);
+	if (ret->server_type == NULL) {
+		goto error;
+	}
+	ret->dfs_mountpoint = talloc_strdup(ret, "");
+	if (ret->dfs_mountpoint == NULL) {
+		goto error;
+	}
+	if (cli->remote_realm != NULL) {
+		ret->remote_realm = talloc_strdup(ret, cli->remote_realm);
+		if (ret->remote_realm == NULL) {
+			goto error;
+		}
+	}
+
+	ret->raw_status = NT_STATUS_INTERNAL_ERROR;
+	ret->map_dos_errors = cli->map_dos_errors;
+	ret->timeout = cli->timeout;
+	ret->use_kerberos = cli->use_kerberos;
+	ret->fallback_after_kerberos = cli->fallback_after_kerberos;
+	ret->use_ccache = cli->use_ccache;
+	ret->pw_nt_hash = cli->pw_nt_hash;
+	ret->use_oplocks = cli->use_oplocks;
+
+	/*
+	 * The smb1 substructure is unused on an SMB2 connection, but
+	 * keep it initialised the way cli_state_create() does.
+	 */
+	ret->smb1.pid = (uint16_t)getpid();
+	ret->smb1.vc_num = ret->smb1.pid;
+	ret->smb1.tcon = smbXcli_tcon_create(ret);
+	if (ret->smb1.tcon == NULL) {
+		goto error;
+	}
+	smb1cli_tcon_set_id(ret->smb1.tcon, UINT16_MAX);
+	ret->smb1.session = smbXcli_session_create(ret, cli->conn);
+	if (ret->smb1.session == NULL) {
+		goto error;
+	}
+
+	if (cli->conn_share == NULL) {
+		cli->conn_share = talloc_zero(NULL, struct cli_conn_share);
+		if (cli->conn_share == NULL) {
+			goto error;
+		}
+		cli->conn_share->refcount = 1;
+		/*
+		 * The transport and session must survive whichever
+		 * member of the group is shut down first.
+		 */
+		talloc_steal(cli->conn_share, cli->conn);
+		talloc_steal(cli->conn_share, cli->smb2.session);
+	}
+
+	ret->conn = cli->conn;
+	ret->smb2.session = cli->smb2.session;
+	ret->conn_share = cli->conn_share;
+	ret->conn_share->refcount += 1;
+
+	ret->initialised = 1;
+	return ret;
+
+ error:
+
+	TALLOC_FREE(ret);
+	return NULL;
+}
+
 /****************************************************************************
  Close all pipes open on this session.
 ****************************************************************************/
@@ -282,8 +400,21 @@ static void _cli_shutdown(struct cli_state *cli)
 		cli_tdis(cli);
 	}
 
-	smbXcli_conn_disconnect(cli->conn, NT_STATUS_OK);
+	if (cli->conn_share == NULL) {
+		smbXcli_conn_disconnect(cli->conn, NT_STATUS_OK);
+		TALLOC_FREE(cli);
+		return;
+	}
 
+	cli->conn_share->refcount -= 1;
+	if (cli->conn_share->refcount == 0) {
+		/*
+		 * Last member of the sharing group, now tear down the
+		 * transport and session.
+		 */
+		smbXcli_conn_disconnect(cli->conn, NT_STATUS_OK);
+		TALLOC_FREE(cli->conn_share);
+	}
 	TALLOC_FREE(cli);
 }
 
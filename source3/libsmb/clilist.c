@@ -928,6 +928,214 @@ NTSTATUS cli_list_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
 	return NT_STATUS_OK;
 }
 
+struct cli_list_recursive_dir {
+	struct cli_list_recursive_dir *prev, *next;
+	struct tevent_req *req;/* This is the main request! Not the subreq */
+	struct tevent_req *subreq;
+	char *dirpath;
+};
+
+struct cli_list_recursive_state {
+	struct tevent_context *ev;
+	struct cli_state *cli;
+	uint16_t attribute;
+	uint16_t info_level;
+
+	NTSTATUS (*fn)(const char *mnt, struct file_info *finfo,
+		       const char *mask, void *private_data);
+	void *private_data;
+
+	/*
+	 * Bounded fan-out: up to max_outstanding directories
+	 * are listed in parallel, the rest wait in "pending".
+	 */
+	uint16_t max_outstanding;
+	uint16_t num_outstanding;
+	struct cli_list_recursive_dir *pending;
+};
+
+static void cli_list_recursive_setup(struct tevent_req *req);
+static void cli_list_recursive_done(struct tevent_req *subreq);
+
+/*
+ * Recursively list a directory tree.
+ *
+ * Every entry is passed to "fn" as it comes in, with the directory
+ * being listed as the "mask" argument, so the callback can build the
+ * full path from mask and finfo->name. Entries are not accumulated,
+ * so the memory footprint stays flat for huge trees. The order in
+ * which directories complete depends on the server, only the entries
+ * within one directory arrive in server order.
+ */
+
+struct tevent_req *cli_list_recursive_send(TALLOC_CTX *mem_ctx,
+					   struct tevent_context *ev,
+					   struct cli_state *cli,
+					   const char *base,
+					   uint16_t attribute,
+					   uint16_t info_level,
+					   uint16_t max_outstanding,
+					   NTSTATUS (*fn)(const char *mnt,
+							  struct file_info *finfo,
+							  const char *mask,
+							  void *private_data),
+					   void *private_data)
+{
+	struct tevent_req *req;
+	struct cli_list_recursive_state *state;
+	struct cli_list_recursive_dir *dir;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct cli_list_recursive_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	state->ev = ev;
+	state->cli = cli;
+	/*
+	 * We have to see subdirectories in order
+	 * to descend into them.
+	 */
+	state->attribute = attribute | FILE_ATTRIBUTE_DIRECTORY;
+	state->info_level = info_level;
+	state->fn = fn;
+	state->private_data = private_data;
+
+	if (max_outstanding == 0) {
+		/*
+		 * On a high latency link the fan-out hides the
+		 * round trips, 16 listings in flight is enough
+		 * to saturate typical links without hammering
+		 * the server.
+		 */
+		max_outstanding = 16;
+	}
+	state->max_outstanding = max_outstanding;
+
+	dir = talloc_zero(state, struct cli_list_recursive_dir);
+	if (tevent_req_nomem(dir, req)) {
+		return tevent_req_post(req, ev);
+	}
+	dir->req = req;
+	dir->dirpath = talloc_strdup(dir, base);
+	if (tevent_req_nomem(dir->dirpath, req)) {
+		return tevent_req_post(req, ev);
+	}
+	DLIST_ADD_END(state->pending, dir, NULL);
+
+	/*
+	 * We defer the callback because of the complex
+	 * substate/subfunction logic
+	 */
+	tevent_req_defer_callback(req, ev);
+
+	cli_list_recursive_setup(req);
+	if (!tevent_req_is_in_progress(req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	return req;
+}
+
+static void cli_list_recursive_setup(struct tevent_req *req)
+{
+	struct cli_list_recursive_state *state = tevent_req_data(
+		req, struct cli_list_recursive_state);
+
+	while ((state->num_outstanding < state->max_outstanding) &&
+	       (state->pending != NULL)) {
+		struct cli_list_recursive_dir *dir = state->pending;
+		char *mask;
+
+		DLIST_REMOVE(state->pending, dir);
+
+		mask = talloc_asprintf(dir, "%s\\*", dir->dirpath);
+		if (tevent_req_nomem(mask, req)) {
+			return;
+		}
+
+		dir->subreq = cli_list_send(dir, state->ev, state->cli,
+					    mask, state->attribute,
+					    state->info_level);
+		if (tevent_req_nomem(dir->subreq, req)) {
+			return;
+		}
+		tevent_req_set_callback(dir->subreq,
+					cli_list_recursive_done,
+					dir);
+		state->num_outstanding++;
+	}
+
+	if (state->num_outstanding > 0) {
+		return;
+	}
+
+	tevent_req_done(req);
+}
+
+static void cli_list_recursive_done(struct tevent_req *subreq)
+{
+	struct cli_list_recursive_dir *dir = tevent_req_callback_data(
+		subreq, struct cli_list_recursive_dir);
+	struct tevent_req *req = dir->req;
+	struct cli_list_recursive_state *state = tevent_req_data(
+		req, struct cli_list_recursive_state);
+	struct file_info *finfo = NULL;
+	size_t i, num_finfo = 0;
+	NTSTATUS status;
+
+	dir->subreq = NULL;
+	SMB_ASSERT(state->num_outstanding > 0);
+	state->num_outstanding--;
+
+	status = cli_list_recv(subreq, dir, &finfo, &num_finfo);
+	TALLOC_FREE(subreq);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+
+	for (i=0; i<num_finfo; i++) {
+		struct file_info *f = &finfo[i];
+
+		if (ISDOT(f->name) || ISDOTDOT(f->name)) {
+			continue;
+		}
+
+		status = state->fn(state->cli->dfs_mountpoint, f,
+				   dir->dirpath, state->private_data);
+		if (tevent_req_nterror(req, status)) {
+			return;
+		}
+
+		if (f->mode & FILE_ATTRIBUTE_DIRECTORY) {
+			struct cli_list_recursive_dir *sub;
+
+			sub = talloc_zero(state,
+					  struct cli_list_recursive_dir);
+			if (tevent_req_nomem(sub, req)) {
+				return;
+			}
+			sub->req = req;
+			sub->dirpath = talloc_asprintf(sub, "%s\\%s",
+						       dir->dirpath,
+						       f->name);
+			if (tevent_req_nomem(sub->dirpath, req)) {
+				return;
+			}
+			DLIST_ADD_END(state->pending, sub, NULL);
+		}
+	}
+
+	TALLOC_FREE(dir);
+
+	cli_list_recursive_setup(req);
+}
+
+NTSTATUS cli_list_recursive_recv(struct tevent_req *req)
+{
+	return tevent_req_simple_recv_ntstatus(req);
+}
+
 NTSTATUS cli_list(struct cli_state *cli, const char *mask, uint16_t attribute,
 		  NTSTATUS (*fn)(const char *, struct file_info *, const char *,
 			     void *), void *state)
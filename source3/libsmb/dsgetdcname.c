@@ -30,6 +30,24 @@
 /* 15 minutes */
 #define DSGETDCNAME_CACHE_TTL	60*15
 
+/*
+ * An entry past its nominal TTL is still served for this long while a
+ * refresh is underway, so a DC failover does not stall every caller.
+ */
+#define DSGETDCNAME_CACHE_GRACE	DSGETDCNAME_CACHE_TTL
+
+/* Only one caller per this interval re-resolves a stale entry. */
+#define DSGETDCNAME_REFRESH_INTERVAL	30
+
+/*
+ * Negative cache for unreachable domains: first retry after 5 seconds,
+ * doubling per consecutive failure up to 5 minutes. The failure count
+ * itself is remembered for an hour.
+ */
+#define DSGETDCNAME_NEG_BASE_TTL	5
+#define DSGETDCNAME_NEG_MAX_TTL		(60*5)
+#define DSGETDCNAME_NEG_MEMORY		(60*60)
+
 struct ip_service_name {
 	struct sockaddr_storage ss;
 	const char *hostname;
@@ -132,6 +150,155 @@ static char *dsgetdcname_cache_key(TALLOC_CTX *mem_ctx, const char *domain)
 /****************************************************************
 ****************************************************************/
 
+static char *dsgetdcname_refresh_key(TALLOC_CTX *mem_ctx, const char *domain)
+{
+	if (!domain) {
+		return NULL;
+	}
+
+	return talloc_asprintf_strupper_m(mem_ctx, "DSGETDCNAME/REFRESH/%s",
+					  domain);
+}
+
+/****************************************************************
+****************************************************************/
+
+static char *dsgetdcname_negative_key(TALLOC_CTX *mem_ctx, const char *domain)
+{
+	if (!domain) {
+		return NULL;
+	}
+
+	return talloc_asprintf_strupper_m(mem_ctx, "DSGETDCNAME/NEGATIVE/%s",
+					  domain);
+}
+
+/****************************************************************
+ Try to become the one caller that refreshes a stale cache entry.
+ This is no real lock, two racing processes may both end up
+ refreshing, which is no worse than the old always-refresh behaviour.
+****************************************************************/
+
+static bool dsgetdcname_refresh_claim(TALLOC_CTX *mem_ctx,
+				      const char *domain_name)
+{
+	char *key;
+
+	key = dsgetdcname_refresh_key(mem_ctx, domain_name);
+	if (!key) {
+		return false;
+	}
+
+	if (gencache_get(key, NULL, NULL, NULL)) {
+		/* somebody else is already on it */
+		return false;
+	}
+
+	gencache_set(key, "1", time(NULL) + DSGETDCNAME_REFRESH_INTERVAL);
+
+	return true;
+}
+
+/****************************************************************
+ Check whether a domain is in the negative cache, i.e. a recent
+ discovery attempt failed and the backoff interval has not passed yet.
+****************************************************************/
+
+static bool dsgetdcname_negative_cached(TALLOC_CTX *mem_ctx,
+					const char *domain_name)
+{
+	char *key;
+	char *value = NULL;
+	unsigned int fail_count = 0;
+	unsigned long next_retry = 0;
+	bool ret;
+
+	key = dsgetdcname_negative_key(mem_ctx, domain_name);
+	if (!key) {
+		return false;
+	}
+
+	if (!gencache_get(key, mem_ctx, &value, NULL)) {
+		return false;
+	}
+
+	if (sscanf(value, "%u %lu", &fail_count, &next_retry) != 2) {
+		gencache_del(key);
+		TALLOC_FREE(value);
+		return false;
+	}
+	TALLOC_FREE(value);
+
+	ret = (time(NULL) < (time_t)next_retry);
+
+	return ret;
+}
+
+/****************************************************************
+ Record a failed discovery attempt, doubling the backoff per
+ consecutive failure.
+****************************************************************/
+
+static void dsgetdcname_negative_store(TALLOC_CTX *mem_ctx,
+				       const char *domain_name)
+{
+	char *key;
+	char *value = NULL;
+	unsigned int fail_count = 0;
+	unsigned long dummy = 0;
+	time_t backoff;
+
+	key = dsgetdcname_negative_key(mem_ctx, domain_name);
+	if (!key) {
+		return;
+	}
+
+	if (gencache_get(key, mem_ctx, &value, NULL)) {
+		if (sscanf(value, "%u %lu", &fail_count, &dummy) != 2) {
+			fail_count = 0;
+		}
+		TALLOC_FREE(value);
+	}
+
+	if (fail_count < UINT_MAX) {
+		fail_count++;
+	}
+
+	backoff = MIN(DSGETDCNAME_NEG_BASE_TTL << MIN(fail_count - 1, 10),
+		      DSGETDCNAME_NEG_MAX_TTL);
+
+	value = talloc_asprintf(mem_ctx, "%u %lu", fail_count,
+				(unsigned long)(time(NULL) + backoff));
+	if (!value) {
+		return;
+	}
+
+	gencache_set(key, value, time(NULL) + DSGETDCNAME_NEG_MEMORY);
+
+	DEBUG(10,("dsgetdcname_negative_store: %s unreachable, next retry "
+		  "in %u seconds (failure %u)\n", domain_name,
+		  (unsigned int)backoff, fail_count));
+}
+
+/****************************************************************
+****************************************************************/
+
+static void dsgetdcname_negative_delete(TALLOC_CTX *mem_ctx,
+					const char *domain_name)
+{
+	char *key;
+
+	key = dsgetdcname_negative_key(mem_ctx, domain_name);
+	if (!key) {
+		return;
+	}
+
+	gencache_del(key);
+}
+
+/****************************************************************
+****************************************************************/
+
 static NTSTATUS dsgetdcname_cache_delete(TALLOC_CTX *mem_ctx,
 					const char *domain_name)
 {
@@ -165,7 +332,15 @@ static NTSTATUS dsgetdcname_cache_store(TALLOC_CTX *mem_ctx,
 		return NT_STATUS_NO_MEMORY;
 	}
 
-	expire_time = time(NULL) + DSGETDCNAME_CACHE_TTL;
+	/*
+	 * Store with the grace period on top of the nominal TTL.
+	 * gencache wipes expired entries on first read, so serving
+	 * stale data while a refresh runs only works if the gencache
+	 * timeout covers the grace period as well; the nominal TTL is
+	 * recovered from the timeout in dsgetdcname_cache_fetch().
+	 */
+	expire_time = time(NULL) + DSGETDCNAME_CACHE_TTL +
+		      DSGETDCNAME_CACHE_GRACE;
 
 	ret = gencache_set_data_blob(key, blob, expire_time);
 
@@ -320,6 +495,7 @@ static NTSTATUS dsgetdcname_cache_fetch(TALLOC_CTX *mem_ctx,
 					const char *domain_name,
 					const struct GUID *domain_guid,
 					uint32_t flags,
+					bool *stale,
 					struct netr_DsRGetDCNameInfo **info_p)
 {
 	char *key;
@@ -328,16 +504,26 @@ static NTSTATUS dsgetdcname_cache_fetch(TALLOC_CTX *mem_ctx,
 	struct netr_DsRGetDCNameInfo *info;
 	struct NETLOGON_SAM_LOGON_RESPONSE_EX r;
 	NTSTATUS status;
+	time_t timeout;
 
 	key = dsgetdcname_cache_key(mem_ctx, domain_name);
 	if (!key) {
 		return NT_STATUS_NO_MEMORY;
 	}
 
-	if (!gencache_get_data_blob(key, NULL, &blob, NULL, NULL)) {
+	if (!gencache_get_data_blob(key, NULL, &blob, &timeout, NULL)) {
 		return NT_STATUS_NOT_FOUND;
 	}
 
+	if (stale != NULL) {
+		/*
+		 * Entries are stored with DSGETDCNAME_CACHE_GRACE on top
+		 * of the nominal TTL, so anything within the grace period
+		 * is usable but should trigger a refresh.
+		 */
+		*stale = (timeout < time(NULL) + DSGETDCNAME_CACHE_GRACE);
+	}
+
 	info = talloc_zero(mem_ctx, struct netr_DsRGetDCNameInfo);
 	if (!info) {
 		data_blob_free(&blob);
@@ -391,9 +577,10 @@ static NTSTATUS dsgetdcname_cached(TALLOC_CTX *mem_ctx,
 				   struct netr_DsRGetDCNameInfo **info)
 {
 	NTSTATUS status;
+	bool stale = false;
 
 	status = dsgetdcname_cache_fetch(mem_ctx, domain_name, domain_guid,
-					 flags, info);
+					 flags, &stale, info);
 	if (!NT_STATUS_IS_OK(status)
 	    && !NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
 		DEBUG(10,("dsgetdcname_cached: cache fetch failed with: %s\n",
@@ -405,6 +592,33 @@ static NTSTATUS dsgetdcname_cached(TALLOC_CTX *mem_ctx,
 		return status;
 	}
 
+	if (NT_STATUS_IS_OK(status) && stale) {
+		struct netr_DsRGetDCNameInfo *dc_info = NULL;
+		NTSTATUS refresh;
+
+		/*
+		 * The entry is past its nominal TTL but still within the
+		 * grace period. Serve it right away unless it is our turn
+		 * to do the re-resolve; if that fails we keep handing out
+		 * the stale entry rather than erroring out, a DC that
+		 * worked 15 minutes ago beats no DC at all.
+		 */
+		if (!dsgetdcname_refresh_claim(mem_ctx, domain_name)) {
+			return NT_STATUS_OK;
+		}
+
+		refresh = dsgetdcname(mem_ctx, msg_ctx, domain_name,
+				      domain_guid, site_name,
+				      flags | DS_FORCE_REDISCOVERY,
+				      &dc_info);
+		if (NT_STATUS_IS_OK(refresh)) {
+			TALLOC_FREE(*info);
+			*info = dc_info;
+		}
+
+		return NT_STATUS_OK;
+	}
+
 	if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
 		struct netr_DsRGetDCNameInfo *dc_info;
 
@@ -1149,11 +1363,24 @@ static NTSTATUS dsgetdcname_internal(TALLOC_CTX *mem_ctx,
 		goto done;
 	}
 
+	if (dsgetdcname_negative_cached(mem_ctx, domain_name)) {
+		DEBUG(10,("dsgetdcname_internal: %s found in the negative "
+			  "cache, not retrying yet\n", domain_name));
+		status = NT_STATUS_DOMAIN_CONTROLLER_NOT_FOUND;
+		goto done;
+	}
+
  rediscover:
 	status = dsgetdcname_rediscover(mem_ctx, msg_ctx, domain_name,
 					domain_guid, flags, site_name,
 					&myinfo);
 
+	if (NT_STATUS_IS_OK(status)) {
+		dsgetdcname_negative_delete(mem_ctx, domain_name);
+	} else {
+		dsgetdcname_negative_store(mem_ctx, domain_name);
+	}
+
  done:
 	if (!NT_STATUS_IS_OK(status)) {
 		if (!first) {
@@ -24,6 +24,7 @@
 #include "libsmb/libsmb.h"
 #include "libsmbclient.h"
 #include "libsmb_internal.h"
+#include "../libcli/smb/smbXcli_base.h"
 
 /*
  * Structure we use if internal caching mechanism is used
@@ -191,6 +192,43 @@ SMBC_get_cached_server(SMBCCTX * context,
 }
 
 
+/*
+ * Search the server cache for an established SMB2 connection to the
+ * same server under the same credentials, regardless of the share.
+ * Used for tree connect multiplexing: the returned cli_state can be
+ * handed to cli_state_share_conn() to carry an additional tcon over
+ * the existing transport and session.
+ * This function is only used if the external cache is not enabled.
+ */
+struct cli_state *
+SMBC_get_cached_transport(SMBCCTX * context,
+                          const char * server,
+                          const char * workgroup,
+                          const char * user)
+{
+	struct smbc_server_cache * srv = NULL;
+
+	for (srv = context->internal->server_cache; srv; srv = srv->next) {
+		struct cli_state *cli = srv->server->cli;
+
+		if (strcmp(server, srv->server_name) != 0 ||
+		    strcmp(workgroup, srv->workgroup) != 0 ||
+		    strcmp(user, srv->username) != 0) {
+			continue;
+		}
+		if (cli == NULL || !cli_state_is_connected(cli)) {
+			continue;
+		}
+		if (smbXcli_conn_protocol(cli->conn) < PROTOCOL_SMB2_02) {
+			continue;
+		}
+		return cli;
+	}
+
+	return NULL;
+}
+
+
 /*
  * Search the server cache for a server and remove it
  * returns 0 on success
@@ -177,6 +177,7 @@ smbc_new_context(void)
         smbc_setOptionBrowseMaxLmbCount(context, 3);    /* # LMBs to query */
         smbc_setOptionUrlEncodeReaddirEntries(context, False);
         smbc_setOptionOneSharePerServer(context, False);
+        smbc_setOptionFileCacheSize(context, 0);        /* caching off */
 	if (getenv("LIBSMBCLIENT_NO_CCACHE") == NULL) {
 		smbc_setOptionUseCCache(context, true);
 	}
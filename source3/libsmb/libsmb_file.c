@@ -28,6 +28,63 @@
 #include "libsmb_internal.h"
 #include "../libcli/smb/smbXcli_base.h"
 
+/*
+ * Optional per-file read-ahead/write-behind cache.
+ *
+ * One buffer per file which holds either clean read-ahead data or
+ * dirty write-behind data, never both. Small sequential reads are
+ * served from one wire read per buffer fill, small sequential writes
+ * are coalesced until the buffer overflows, the file is closed,
+ * fstat()ed or seeked to its end. Disabled unless the application
+ * asked for it via smbc_setOptionFileCacheSize().
+ */
+struct smbc_file_cache {
+        uint8_t *buf;
+        size_t size;
+
+        /* file offset of buf[0] */
+        off_t ofs;
+
+        /* bytes of read-ahead data in buf */
+        size_t valid;
+
+        /* bytes of not yet written data in buf */
+        size_t dirty;
+};
+
+int
+SMBC_fcache_flush(SMBCCTX *context,
+                  SMBCFILE *file)
+{
+        struct smbc_file_cache *c = file->cache;
+	NTSTATUS status;
+
+        if ((c == NULL) || (c->dirty == 0)) {
+                return 0;
+        }
+
+	status = cli_writeall(file->targetcli, file->cli_fd,
+			      0, c->buf, c->ofs, c->dirty, NULL);
+	if (!NT_STATUS_IS_OK(status)) {
+		errno = map_errno_from_nt_status(status);
+		return -1;
+	}
+
+        c->dirty = 0;
+        return 0;
+}
+
+void
+SMBC_fcache_free(SMBCFILE *file)
+{
+        if (file->cache == NULL) {
+                return;
+        }
+
+        SAFE_FREE(file->cache->buf);
+        SAFE_FREE(file->cache);
+}
+
 /*
  * Routine to open() a file ...
  */
@@ -153,6 +210,25 @@ SMBC_open_ctx(SMBCCTX *context,
 		 */
 		file->targetcli = targetcli;
 
+                /*
+                 * Optional read-ahead/write-behind cache. Failure to
+                 * allocate it is not fatal, we just run uncached then.
+                 */
+                if (context->internal->file_cache_size > 0) {
+                        file->cache = SMB_MALLOC_P(struct smbc_file_cache);
+                        if (file->cache != NULL) {
+                                ZERO_STRUCTP(file->cache);
+                                file->cache->size =
+                                        context->internal->file_cache_size;
+                                file->cache->buf =
+                                        SMB_MALLOC_ARRAY(uint8_t,
+                                                         file->cache->size);
+                                if (file->cache->buf == NULL) {
+                                        SAFE_FREE(file->cache);
+                                }
+                        }
+                }
+
 		DLIST_ADD(context->internal->files, file);
 
                 /*
@@ -274,6 +350,55 @@ SMBC_read_ctx(SMBCCTX *context,
 		return -1;
 	}
 
+	if (file->cache != NULL) {
+                struct smbc_file_cache *c = file->cache;
+
+                /*
+                 * The read may overlap write-behind data, push
+                 * that out first.
+                 */
+                if (SMBC_fcache_flush(context, file) < 0) {
+                        TALLOC_FREE(frame);
+                        return -1;
+                }
+
+                if (count < c->size) {
+                        if ((offset < c->ofs) ||
+                            (offset >= c->ofs + (off_t)c->valid)) {
+                                /*
+                                 * Miss: read ahead a full buffer at the
+                                 * read pointer, the following sequential
+                                 * reads are served without a round trip.
+                                 */
+                                status = cli_read(file->targetcli,
+                                                  file->cli_fd,
+                                                  (char *)c->buf,
+                                                  offset, c->size, &ret);
+                                if (!NT_STATUS_IS_OK(status)) {
+                                        errno = SMBC_errno(context,
+                                                           file->targetcli);
+                                        TALLOC_FREE(frame);
+                                        return -1;
+                                }
+                                c->ofs = offset;
+                                c->valid = ret;
+                        }
+
+                        ret = MIN(count,
+                                  (size_t)(c->ofs + (off_t)c->valid - offset));
+                        memcpy(buf, c->buf + (offset - c->ofs), ret);
+
+                        file->offset += ret;
+
+                        DEBUG(4, ("  --> %ld (cached)\n", (unsigned long)ret));
+
+                        TALLOC_FREE(frame);
+                        return ret;
+                }
+
+                /* Reads of a full buffer or more bypass the cache. */
+        }
+
 	status = cli_read(file->targetcli, file->cli_fd, (char *)buf, offset,
 			  count, &ret);
 	if (!NT_STATUS_IS_OK(status)) {
@@ -324,6 +449,16 @@ SMBC_splice_ctx(SMBCCTX *context,
 		return -1;
 	}
 
+	if ((SMBC_fcache_flush(context, srcfile) < 0) ||
+	    (SMBC_fcache_flush(context, dstfile) < 0)) {
+		TALLOC_FREE(frame);
+		return -1;
+	}
+	if (dstfile->cache != NULL) {
+		/* the splice writes behind our back */
+		dstfile->cache->valid = 0;
+	}
+
 	status = cli_splice(srcfile->targetcli, dstfile->targetcli,
 			    srcfile->cli_fd, dstfile->cli_fd,
 			    count, srcfile->offset, dstfile->offset, &written,
@@ -379,6 +514,41 @@ SMBC_write_ctx(SMBCCTX *context,
 
         offset = file->offset; /* See "offset" comment in SMBC_read_ctx() */
 
+        if (file->cache != NULL) {
+                struct smbc_file_cache *c = file->cache;
+
+                /* Writes make the read-ahead data stale. */
+                c->valid = 0;
+
+                if ((c->dirty > 0) &&
+                    ((offset != c->ofs + (off_t)c->dirty) ||
+                     ((c->dirty + count) > c->size))) {
+                        /*
+                         * Non-contiguous write or the buffer would
+                         * overflow, push out what we have.
+                         */
+                        if (SMBC_fcache_flush(context, file) < 0) {
+                                TALLOC_FREE(frame);
+                                return -1;
+                        }
+                }
+
+                if (count < c->size) {
+                        if (c->dirty == 0) {
+                                c->ofs = offset;
+                        }
+                        memcpy(c->buf + c->dirty, buf, count);
+                        c->dirty += count;
+
+                        file->offset += count;
+
+                        TALLOC_FREE(frame);
+                        return count;
+                }
+
+                /* Writes of a full buffer or more bypass the cache. */
+        }
+
 	status = cli_writeall(file->targetcli, file->cli_fd,
 			      0, (const uint8_t *)buf, offset, count, NULL);
 	if (!NT_STATUS_IS_OK(status)) {
@@ -421,6 +591,21 @@ SMBC_close_ctx(SMBCCTX *context,
 		return smbc_getFunctionClosedir(context)(context, file);
 	}
 
+        /*
+         * Write-behind data has to go out before the handle
+         * goes away.
+         */
+        if (SMBC_fcache_flush(context, file) < 0) {
+                /* errno is set, still close the handle */
+                cli_close(file->targetcli, file->cli_fd);
+                DLIST_REMOVE(context->internal->files, file);
+                SMBC_fcache_free(file);
+                SAFE_FREE(file->fname);
+                SAFE_FREE(file);
+                TALLOC_FREE(frame);
+                return -1;
+        }
+
 	if (!NT_STATUS_IS_OK(cli_close(file->targetcli, file->cli_fd))) {
 		SMBCSRV *srv;
 		DEBUG(3, ("cli_close failed on %s. purging server.\n",
@@ -430,6 +615,7 @@ SMBC_close_ctx(SMBCCTX *context,
 		errno = SMBC_errno(context, file->targetcli);
 		srv = file->srv;
 		DLIST_REMOVE(context->internal->files, file);
+		SMBC_fcache_free(file);
 		SAFE_FREE(file->fname);
 		SAFE_FREE(file);
 		smbc_getFunctionRemoveUnusedServer(context)(context, srv);
@@ -438,6 +624,7 @@ SMBC_close_ctx(SMBCCTX *context,
 	}
 
 	DLIST_REMOVE(context->internal->files, file);
+	SMBC_fcache_free(file);
 	SAFE_FREE(file->fname);
 	SAFE_FREE(file);
 	TALLOC_FREE(frame);
@@ -691,6 +878,14 @@ SMBC_lseek_ctx(SMBCCTX *context,
 		file->offset += offset;
 		break;
 	case SEEK_END:
+                /*
+                 * The server's idea of the file size must include
+                 * our write-behind data.
+                 */
+                if (SMBC_fcache_flush(context, file) < 0) {
+                        TALLOC_FREE(frame);
+                        return -1;
+                }
 		if (!NT_STATUS_IS_OK(cli_qfileinfo_basic(
 					     file->targetcli, file->cli_fd, NULL,
 					     &size, NULL, NULL, NULL, NULL,
@@ -746,6 +941,15 @@ SMBC_ftruncate_ctx(SMBCCTX *context,
 		return -1;
 	}
 
+        if (SMBC_fcache_flush(context, file) < 0) {
+                TALLOC_FREE(frame);
+                return -1;
+        }
+        if (file->cache != NULL) {
+                /* cached data beyond the new size would be stale */
+                file->cache->valid = 0;
+        }
+
         if (!NT_STATUS_IS_OK(cli_ftruncate(file->targetcli, file->cli_fd, (uint64_t)size))) {
                 errno = EINVAL;
                 TALLOC_FREE(frame);
@@ -444,6 +444,34 @@ SMBC_server_internal(TALLOC_CTX *ctx,
 		signing_state = SMB_SIGNING_REQUIRED;
 	}
 
+        /*
+         * If we already have an SMB2 connection to this server under the
+         * same credentials, multiplex an additional tree connect over the
+         * existing transport and session instead of paying for a fresh
+         * TCP connect, negprot and session setup. Only the internal
+         * server cache records the credentials per connection; with an
+         * external cache SMBC_get_cached_transport() finds nothing and
+         * we fall through to a full connect.
+         */
+	if (context->internal->smb_encryption_level ==
+            SMBC_ENCRYPTLEVEL_NONE) {
+		struct cli_state *shared;
+
+		shared = SMBC_get_cached_transport(context, server,
+                                                   *pp_workgroup,
+                                                   *pp_username);
+		if (shared != NULL) {
+			c = cli_state_share_conn(NULL, shared);
+		}
+		if (c != NULL) {
+			DEBUG(4, ("SMBC_server: multiplexing connection "
+                                  "to //%s/%s\n", server, share));
+			cli_set_timeout(c, smbc_getTimeout(context));
+			username_used = *pp_username;
+			goto session_ready;
+		}
+	}
+
 	if (port == 0) {
 	        if (share == NULL || *share == '\0' || is_ipc) {
 			/*
@@ -511,6 +539,8 @@ SMBC_server_internal(TALLOC_CTX *ctx,
 
 	DEBUG(4,(" session setup ok\n"));
 
+session_ready:
+
 	/* here's the fun part....to support 'msdfs proxy' shares
 	   (on Samba or windows) we have to issues a TRANS_GET_DFS_REFERRAL
 	   here before trying to connect to the original share.
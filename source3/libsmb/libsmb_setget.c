@@ -485,6 +485,20 @@ smbc_setOptionUseCCache(SMBCCTX *c, smbc_bool b)
         }
 }
 
+/** Get the per-file cache size for read-ahead and write-behind */
+size_t
+smbc_getOptionFileCacheSize(SMBCCTX *c)
+{
+        return c->internal->file_cache_size;
+}
+
+/** Set the per-file cache size for read-ahead and write-behind */
+void
+smbc_setOptionFileCacheSize(SMBCCTX *c, size_t size)
+{
+        c->internal->file_cache_size = size;
+}
+
 /** Get indication whether the password supplied is the NT hash */
 smbc_bool
 smbc_getOptionUseNTHash(SMBCCTX *c)
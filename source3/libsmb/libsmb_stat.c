@@ -237,6 +237,15 @@ SMBC_fstat_ctx(SMBCCTX *context,
 		return smbc_getFunctionFstatdir(context)(context, file, st);
 	}
 
+	/*
+	 * The size the server reports must include our
+	 * write-behind data.
+	 */
+	if (SMBC_fcache_flush(context, file) < 0) {
+		TALLOC_FREE(frame);
+		return -1;
+	}
+
 	/*d_printf(">>>fstat: parsing %s\n", file->fname);*/
 	if (SMBC_parse_path(frame,
                             context,
@@ -25,6 +25,14 @@
 
 #define NBTKEY_FMT  "NBT/%s#%02X"
 
+/*
+ * Lifetime of negative entries. Deliberately short: it only has to
+ * absorb the burst of processes all running into the same dead server
+ * (each of which would otherwise repeat the full resolve timeouts),
+ * without delaying the recovery once the server is back.
+ */
+#define NAMECACHE_NEGATIVE_TIMEOUT 60
+
 /**
  * Generates a key for netbios name lookups on basis of
  * netbios name and type.
@@ -51,7 +59,9 @@ static char *namecache_key(const char *name,
  *
  * @param name netbios names array
  * @param name_type integer netbios name type
- * @param num_names number of names being stored
+ * @param num_names number of names being stored; 0 stores a
+ *        short-lived negative entry recording that the name could
+ *        not be resolved
  * @param ip_list array of in_addr structures containing
  *        ip addresses being stored
  **/
@@ -96,6 +106,16 @@ bool namecache_store(const char *name,
 		return False;
 	}
 
+	if (num_names == 0) {
+		/* a negative entry, remembered only briefly */
+		expiry = time(NULL) +
+			MIN(lp_name_cache_timeout(),
+			    NAMECACHE_NEGATIVE_TIMEOUT);
+		ret = gencache_set(key, "", expiry);
+		SAFE_FREE(key);
+		return ret;
+	}
+
 	expiry = time(NULL) + lp_name_cache_timeout();
 
 	/*
@@ -123,9 +143,10 @@ bool namecache_store(const char *name,
  * @param name_type netbios name type of @param name
  * @param ip_list mallocated list of IP addresses if found in the cache,
  *        NULL otherwise
- * @param num_names number of entries found
+ * @param num_names number of entries found; 0 together with a true
+ *        return value means a cached negative result
  *
- * @return true upon successful fetch or
+ * @return true upon successful fetch (including negative entries) or
  *         false if name isn't found in the cache or has expired
  **/
 
@@ -168,11 +189,15 @@ bool namecache_fetch(const char *name,
 	 * Split up the stored value into the list of IP adresses
 	 */
 	*num_names = ipstr_list_parse(value, ip_list);
+	if (*num_names == 0) {
+		SAFE_FREE(*ip_list);
+	}
 
 	SAFE_FREE(key);
 	TALLOC_FREE(value);
 
-	return *num_names > 0; /* true only if some ip has been fetched */
+	/* an existing entry with no addresses is a negative result */
+	return true;
 }
 
 /**
@@ -2017,6 +2017,18 @@ static void query_wins_list_done(struct tevent_req *subreq)
 	wins_srv_died(state->servers[state->num_sent-1],
 		      my_socket_addr_v4());
 
+	/*
+	 * Another process may have found further servers dead while
+	 * we were waiting for our timeout, no need to spend 2 seconds
+	 * on each of them again. The dead marks are in the shared
+	 * gencache, so re-check before every failover hop.
+	 */
+	while (state->num_sent < state->num_servers &&
+	       wins_srv_is_dead(state->servers[state->num_sent],
+				my_socket_addr_v4())) {
+		state->num_sent += 1;
+	}
+
 	if (state->num_sent == state->num_servers) {
 		tevent_req_nterror(req, NT_STATUS_NOT_FOUND);
 		return;
@@ -2274,6 +2286,176 @@ fail:
 	return status;
 }
 
+/********************************************************
+ Race the "wins" and "bcast" methods against each other.
+ Both are UDP based and spend most of their time waiting
+ for timeouts, so running them in parallel costs almost
+ nothing. The first method to come back with an answer
+ wins, the loser is cancelled.
+*********************************************************/
+
+struct name_resolve_netbios_state {
+	struct tevent_req *wins_subreq;
+	struct tevent_req *bcast_subreq;
+
+	struct sockaddr_storage *addrs;
+	int num_addrs;
+};
+
+static void name_resolve_netbios_wins_done(struct tevent_req *subreq);
+static void name_resolve_netbios_bcast_done(struct tevent_req *subreq);
+
+static struct tevent_req *name_resolve_netbios_send(TALLOC_CTX *mem_ctx,
+						    struct tevent_context *ev,
+						    const char *name,
+						    int name_type,
+						    bool try_wins,
+						    bool try_bcast)
+{
+	struct tevent_req *req;
+	struct name_resolve_netbios_state *state;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct name_resolve_netbios_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	if (!try_wins && !try_bcast) {
+		tevent_req_nterror(req, NT_STATUS_INVALID_PARAMETER);
+		return tevent_req_post(req, ev);
+	}
+
+	if (try_wins) {
+		state->wins_subreq = resolve_wins_send(state, ev, name,
+						       name_type);
+		if (tevent_req_nomem(state->wins_subreq, req)) {
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_set_callback(state->wins_subreq,
+					name_resolve_netbios_wins_done, req);
+	}
+	if (try_bcast) {
+		state->bcast_subreq = name_resolve_bcast_send(state, ev, name,
+							      name_type);
+		if (tevent_req_nomem(state->bcast_subreq, req)) {
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_set_callback(state->bcast_subreq,
+					name_resolve_netbios_bcast_done, req);
+	}
+	return req;
+}
+
+static void name_resolve_netbios_wins_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct name_resolve_netbios_state *state = tevent_req_data(
+		req, struct name_resolve_netbios_state);
+	NTSTATUS status;
+
+	status = resolve_wins_recv(subreq, state, &state->addrs,
+				   &state->num_addrs, NULL);
+	TALLOC_FREE(subreq);
+	state->wins_subreq = NULL;
+
+	if (NT_STATUS_IS_OK(status)) {
+		/*
+		 * The first answer wins, drop the broadcast lookup
+		 */
+		TALLOC_FREE(state->bcast_subreq);
+		tevent_req_done(req);
+		return;
+	}
+	if (state->bcast_subreq != NULL) {
+		/*
+		 * Wait for the broadcast lookup
+		 */
+		return;
+	}
+	tevent_req_nterror(req, status);
+}
+
+static void name_resolve_netbios_bcast_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct name_resolve_netbios_state *state = tevent_req_data(
+		req, struct name_resolve_netbios_state);
+	NTSTATUS status;
+
+	status = name_resolve_bcast_recv(subreq, state, &state->addrs,
+					 &state->num_addrs);
+	TALLOC_FREE(subreq);
+	state->bcast_subreq = NULL;
+
+	if (NT_STATUS_IS_OK(status)) {
+		/*
+		 * The first answer wins, drop the WINS lookup
+		 */
+		TALLOC_FREE(state->wins_subreq);
+		tevent_req_done(req);
+		return;
+	}
+	if (state->wins_subreq != NULL) {
+		/*
+		 * Wait for the WINS lookup
+		 */
+		return;
+	}
+	tevent_req_nterror(req, status);
+}
+
+static NTSTATUS name_resolve_netbios_recv(struct tevent_req *req,
+					  TALLOC_CTX *mem_ctx,
+					  struct sockaddr_storage **addrs,
+					  int *num_addrs)
+{
+	struct name_resolve_netbios_state *state = tevent_req_data(
+		req, struct name_resolve_netbios_state);
+	NTSTATUS status;
+
+	if (tevent_req_is_nterror(req, &status)) {
+		return status;
+	}
+	*addrs = talloc_move(mem_ctx, &state->addrs);
+	*num_addrs = state->num_addrs;
+	return NT_STATUS_OK;
+}
+
+static NTSTATUS name_resolve_netbios(const char *name,
+				     int name_type,
+				     bool try_wins,
+				     bool try_bcast,
+				     TALLOC_CTX *mem_ctx,
+				     struct sockaddr_storage **return_iplist,
+				     int *return_count)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	struct tevent_context *ev;
+	struct tevent_req *req;
+	NTSTATUS status = NT_STATUS_NO_MEMORY;
+
+	ev = samba_tevent_context_init(frame);
+	if (ev == NULL) {
+		goto fail;
+	}
+	req = name_resolve_netbios_send(frame, ev, name, name_type,
+					try_wins, try_bcast);
+	if (req == NULL) {
+		goto fail;
+	}
+	if (!tevent_req_poll_ntstatus(req, ev, &status)) {
+		goto fail;
+	}
+	status = name_resolve_netbios_recv(req, mem_ctx, return_iplist,
+					   return_count);
+ fail:
+	TALLOC_FREE(frame);
+	return status;
+}
+
 /********************************************************
  Resolve via "lmhosts" method.
 *********************************************************/
@@ -2634,6 +2816,7 @@ NTSTATUS internal_resolve_name(const char *name,
 {
 	const char *tok;
 	NTSTATUS status = NT_STATUS_UNSUCCESSFUL;
+	bool done_netbios = false;
 	int i;
 	TALLOC_CTX *frame = NULL;
 
@@ -2745,28 +2928,45 @@ NTSTATUS internal_resolve_name(const char *name,
 			if (NT_STATUS_IS_OK(status)) {
 				goto done;
 			}
-		} else if (strequal(tok, "wins")) {
-			/* don't resolve 1D via WINS */
+		} else if (strequal(tok, "wins") || strequal(tok, "bcast")) {
 			struct sockaddr_storage *ss_list;
-			if (name_type != 0x1D) {
-				status = resolve_wins(name, name_type,
-						      talloc_tos(),
-						      &ss_list,
-						      return_count);
-				if (NT_STATUS_IS_OK(status)) {
-					if (!convert_ss2service(return_iplist,
-								ss_list,
-								return_count)) {
-						status = NT_STATUS_NO_MEMORY;
-					}
-					goto done;
+			bool try_wins = false;
+			bool try_bcast = false;
+			int j;
+
+			if (done_netbios) {
+				/* Already raced further up in the order */
+				continue;
+			}
+			done_netbios = true;
+
+			/*
+			 * If both NetBIOS methods are configured, race
+			 * them in parallel at the position of the first
+			 * one. Both mainly wait for UDP timeouts, running
+			 * them sequentially just adds up those timeouts.
+			 */
+			for (j=i; resolve_order[j]; j++) {
+				if (strequal(resolve_order[j], "wins")) {
+					try_wins = true;
+				}
+				if (strequal(resolve_order[j], "bcast")) {
+					try_bcast = true;
 				}
 			}
-		} else if (strequal(tok, "bcast")) {
-			struct sockaddr_storage *ss_list;
-			status = name_resolve_bcast(
-				name, name_type, talloc_tos(),
-				&ss_list, return_count);
+
+			/* don't resolve 1D via WINS */
+			if (name_type == 0x1D) {
+				try_wins = false;
+			}
+			if (!try_wins && !try_bcast) {
+				continue;
+			}
+
+			status = name_resolve_netbios(name, name_type,
+						      try_wins, try_bcast,
+						      talloc_tos(),
+						      &ss_list, return_count);
 			if (NT_STATUS_IS_OK(status)) {
 				if (!convert_ss2service(return_iplist,
 							ss_list,
@@ -2787,6 +2987,13 @@ NTSTATUS internal_resolve_name(const char *name,
 	SAFE_FREE(*return_iplist);
 	*return_count = 0;
 
+	/*
+	 * Remember the failure briefly, so concurrent and immediately
+	 * following callers don't all repeat the full resolve timeouts
+	 * against a dead server.
+	 */
+	namecache_store(name, name_type, 0, NULL);
+
 	return NT_STATUS_UNSUCCESSFUL;
 
   done:
@@ -168,6 +168,8 @@ struct cli_state *cli_state_create(TALLOC_CTX *mem_ctx,
 				   const char *remote_realm,
 				   int signing_state,
 				   int flags);
+struct cli_state *cli_state_share_conn(TALLOC_CTX *mem_ctx,
+				       struct cli_state *cli);
 void cli_nt_pipes_close(struct cli_state *cli);
 void cli_shutdown(struct cli_state *cli);
 const char *cli_state_remote_realm(struct cli_state *cli);
@@ -701,6 +703,19 @@ struct tevent_req *cli_list_send(TALLOC_CTX *mem_ctx,
 				 uint16_t info_level);
 NTSTATUS cli_list_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
 		       struct file_info **finfo, size_t *num_finfo);
+struct tevent_req *cli_list_recursive_send(TALLOC_CTX *mem_ctx,
+					   struct tevent_context *ev,
+					   struct cli_state *cli,
+					   const char *base,
+					   uint16_t attribute,
+					   uint16_t info_level,
+					   uint16_t max_outstanding,
+					   NTSTATUS (*fn)(const char *mnt,
+							  struct file_info *finfo,
+							  const char *mask,
+							  void *private_data),
+					   void *private_data);
+NTSTATUS cli_list_recursive_recv(struct tevent_req *req);
 NTSTATUS cli_list(struct cli_state *cli,const char *Mask,uint16_t attribute,
 		  NTSTATUS (*fn)(const char *, struct file_info *, const char *,
 			     void *), void *state);
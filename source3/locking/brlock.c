@@ -50,6 +50,20 @@ struct byte_range_lock {
 	uint32_t num_read_oplocks;
 	struct lock_struct *lock_data;
 	struct db_record *record;
+
+	/*
+	 * Summary of the region covered by lock_data: the smallest
+	 * start and the largest end (exclusive, saturated at the top
+	 * of 64 bit file space) over all entries. A probe entirely
+	 * outside [extent_start, extent_end) cannot overlap anything,
+	 * which lets the conflict scans bail out early on files
+	 * carrying many locks. The summary is computed lazily and may
+	 * over-estimate after unlocks - that only costs us a scan we
+	 * would have done anyway.
+	 */
+	bool extent_valid;
+	uint64_t extent_start;
+	uint64_t extent_end;
 };
 
 /****************************************************************************
@@ -134,6 +148,70 @@ static bool brl_overlap(const struct lock_struct *lck1,
 	return True;
 }
 
+/****************************************************************************
+ Maintain the [extent_start, extent_end) summary of a lock set.
+****************************************************************************/
+
+static uint64_t brl_lock_end(const struct lock_struct *lck)
+{
+	uint64_t end = lck->start + lck->size;
+
+	if (end < lck->start) {
+		/* Beyond the end of 64 bit file space, saturate. */
+		end = UINT64_MAX;
+	}
+	return end;
+}
+
+static void brl_extent_recompute(struct byte_range_lock *br_lck)
+{
+	unsigned int i;
+
+	br_lck->extent_start = UINT64_MAX;
+	br_lck->extent_end = 0;
+
+	for (i=0; i < br_lck->num_locks; i++) {
+		const struct lock_struct *lck = &br_lck->lock_data[i];
+
+		br_lck->extent_start = MIN(br_lck->extent_start, lck->start);
+		br_lck->extent_end = MAX(br_lck->extent_end,
+					 brl_lock_end(lck));
+	}
+	br_lck->extent_valid = true;
+}
+
+static void brl_extent_extend(struct byte_range_lock *br_lck,
+			      const struct lock_struct *lck)
+{
+	if (!br_lck->extent_valid) {
+		return;
+	}
+	br_lck->extent_start = MIN(br_lck->extent_start, lck->start);
+	br_lck->extent_end = MAX(br_lck->extent_end, brl_lock_end(lck));
+}
+
+/****************************************************************************
+ True if "lck" lies entirely outside the summarized extent and thus cannot
+ overlap any existing lock. A probe whose range wraps 64 bit file space can
+ still match via the same start/size check in brl_overlap(), so we never
+ claim a miss for those.
+****************************************************************************/
+
+static bool brl_extent_miss(struct byte_range_lock *br_lck,
+			    const struct lock_struct *lck)
+{
+	uint64_t end = lck->start + lck->size;
+
+	if (end < lck->start) {
+		return false;
+	}
+	if (!br_lck->extent_valid) {
+		brl_extent_recompute(br_lck);
+	}
+	return ((lck->start >= br_lck->extent_end) ||
+		(end <= br_lck->extent_start));
+}
+
 /****************************************************************************
  See if lock2 can be added when lock1 is in place.
 ****************************************************************************/
@@ -303,6 +381,28 @@ static bool brl_pending_overlap(const struct lock_struct *lock, const struct loc
 	return False;
 }
 
+/****************************************************************************
+ Wake up a pending lock waiter, telling it which range got unlocked so
+ it only rechecks the affected blocked requests.
+****************************************************************************/
+
+static void brl_send_unlock_msg(struct messaging_context *msg_ctx,
+				struct server_id pid,
+				struct byte_range_lock *br_lck,
+				const struct lock_struct *plock)
+{
+	struct unlock_msg msg;
+	DATA_BLOB blob;
+
+	ZERO_STRUCT(msg);
+	msg.id = br_lck->fsp->file_id;
+	msg.offset = plock->start;
+	msg.count = plock->size;
+
+	blob = data_blob_const((uint8_t *)&msg, sizeof(msg));
+	messaging_send(msg_ctx, pid, MSG_SMB_UNLOCK, &blob);
+}
+
 /****************************************************************************
  Amazingly enough, w2k3 "remembers" whether the last lock failure on a fnum
  is the same as this one and changes its error code. I wonder if any
@@ -426,24 +526,28 @@ NTSTATUS brl_lock_windows_default(struct byte_range_lock *br_lck,
 		return NT_STATUS_INVALID_LOCK_RANGE;
 	}
 
-	for (i=0; i < br_lck->num_locks; i++) {
-		/* Do any Windows or POSIX locks conflict ? */
-		if (brl_conflict(&locks[i], plock)) {
-			if (!serverid_exists(&locks[i].context.pid)) {
-				locks[i].context.pid.pid = 0;
-				br_lck->modified = true;
-				continue;
+	if (!brl_extent_miss(br_lck, plock)) {
+		for (i=0; i < br_lck->num_locks; i++) {
+			/* Do any Windows or POSIX locks conflict ? */
+			if (brl_conflict(&locks[i], plock)) {
+				if (!serverid_exists(&locks[i].context.pid)) {
+					locks[i].context.pid.pid = 0;
+					br_lck->modified = true;
+					continue;
+				}
+				/* Remember who blocked us. */
+				plock->context.smblctx =
+					locks[i].context.smblctx;
+				return brl_lock_failed(fsp,plock,
+						       blocking_lock);
 			}
-			/* Remember who blocked us. */
-			plock->context.smblctx = locks[i].context.smblctx;
-			return brl_lock_failed(fsp,plock,blocking_lock);
-		}
 #if ZERO_ZERO
-		if (plock->start == 0 && plock->size == 0 &&
-				locks[i].size == 0) {
-			break;
-		}
+			if (plock->start == 0 && plock->size == 0 &&
+					locks[i].size == 0) {
+				break;
+			}
 #endif
+		}
 	}
 
 	if (!IS_PENDING_LOCK(plock->lock_type)) {
@@ -490,6 +594,7 @@ NTSTATUS brl_lock_windows_default(struct byte_range_lock *br_lck,
 	br_lck->num_locks += 1;
 	br_lck->lock_data = locks;
 	br_lck->modified = True;
+	brl_extent_extend(br_lck, plock);
 
 	return NT_STATUS_OK;
  fail:
@@ -955,6 +1060,7 @@ static NTSTATUS brl_lock_posix(struct messaging_context *msg_ctx,
 	br_lck->lock_data = tp;
 	locks = tp;
 	br_lck->modified = True;
+	brl_extent_extend(br_lck, plock);
 
 	/* A successful downgrade from write to read lock can trigger a lock
 	   re-evalutation where waiting readers can now proceed. */
@@ -978,8 +1084,9 @@ static NTSTATUS brl_lock_posix(struct messaging_context *msg_ctx,
 					   server_id_str_buf(pend_lock->context.pid,
 							     &tmp)));
 
-				messaging_send(msg_ctx, pend_lock->context.pid,
-					       MSG_SMB_UNLOCK, &data_blob_null);
+				brl_send_unlock_msg(msg_ctx,
+						    pend_lock->context.pid,
+						    br_lck, plock);
 			}
 		}
 	}
@@ -1161,7 +1268,6 @@ bool brl_unlock_windows_default(struct messaging_context *msg_ctx,
 			continue;
 		}
 
-		/* We could send specific lock info here... */
 		if (brl_pending_overlap(plock, pend_lock)) {
 			struct server_id_buf tmp;
 
@@ -1170,8 +1276,8 @@ bool brl_unlock_windows_default(struct messaging_context *msg_ctx,
 				   server_id_str_buf(pend_lock->context.pid,
 						     &tmp)));
 
-			messaging_send(msg_ctx, pend_lock->context.pid,
-				       MSG_SMB_UNLOCK, &data_blob_null);
+			brl_send_unlock_msg(msg_ctx, pend_lock->context.pid,
+					    br_lck, plock);
 		}
 	}
 
@@ -1322,7 +1428,6 @@ static bool brl_unlock_posix(struct messaging_context *msg_ctx,
 			continue;
 		}
 
-		/* We could send specific lock info here... */
 		if (brl_pending_overlap(plock, pend_lock)) {
 			struct server_id_buf tmp;
 
@@ -1331,8 +1436,8 @@ static bool brl_unlock_posix(struct messaging_context *msg_ctx,
 				   server_id_str_buf(pend_lock->context.pid,
 						     &tmp)));
 
-			messaging_send(msg_ctx, pend_lock->context.pid,
-				       MSG_SMB_UNLOCK, &data_blob_null);
+			brl_send_unlock_msg(msg_ctx, pend_lock->context.pid,
+					    br_lck, plock);
 		}
 	}
 
@@ -1394,23 +1499,25 @@ bool brl_locktest(struct byte_range_lock *br_lck,
 	files_struct *fsp = br_lck->fsp;
 
 	/* Make sure existing locks don't conflict */
-	for (i=0; i < br_lck->num_locks; i++) {
-		/*
-		 * Our own locks don't conflict.
-		 */
-		if (brl_conflict_other(&locks[i], rw_probe)) {
-			if (br_lck->record == NULL) {
-				/* readonly */
-				return false;
-			}
+	if (!brl_extent_miss(br_lck, rw_probe)) {
+		for (i=0; i < br_lck->num_locks; i++) {
+			/*
+			 * Our own locks don't conflict.
+			 */
+			if (brl_conflict_other(&locks[i], rw_probe)) {
+				if (br_lck->record == NULL) {
+					/* readonly */
+					return false;
+				}
 
-			if (!serverid_exists(&locks[i].context.pid)) {
-				locks[i].context.pid.pid = 0;
-				br_lck->modified = true;
-				continue;
-			}
+				if (!serverid_exists(&locks[i].context.pid)) {
+					locks[i].context.pid.pid = 0;
+					br_lck->modified = true;
+					continue;
+				}
 
-			return False;
+				return False;
+			}
 		}
 	}
 
@@ -1849,7 +1956,13 @@ int brl_forall(void (*fn)(struct file_id id, struct server_id pid,
 	}
 	cb.fn = fn;
 	cb.private_data = private_data;
-	status = dbwrap_traverse(brlock_db, brl_traverse_fn, &cb, &count);
+
+	/*
+	 * All callers only ever read; use a read traverse so we don't
+	 * grab write chainlocks against the smbds actually doing the
+	 * locking.
+	 */
+	status = dbwrap_traverse_read(brlock_db, brl_traverse_fn, &cb, &count);
 
 	if (!NT_STATUS_IS_OK(status)) {
 		return -1;
@@ -2081,6 +2194,7 @@ struct byte_range_lock *brl_get_locks_readonly(files_struct *fsp)
 		br_lock->num_read_oplocks = 0;
 		br_lock->num_locks = 0;
 		br_lock->lock_data = NULL;
+		br_lock->extent_valid = false;
 
 	} else if (!NT_STATUS_IS_OK(status)) {
 		DEBUG(3, ("Could not parse byte range lock record: "
@@ -23,6 +23,7 @@
 #include "locking/leases_db.h"
 #include "dbwrap/dbwrap.h"
 #include "dbwrap/dbwrap_open.h"
+#include "dbwrap/dbwrap_cache.h"
 #include "util_tdb.h"
 #include "ndr.h"
 #include "librpc/gen_ndr/ndr_leases_db.h"
@@ -36,19 +37,30 @@ static struct db_context *leases_db;
 bool leases_db_init(bool read_only)
 {
 	char *db_path;
+	int tdb_flags;
 
 	if (leases_db) {
 		return true;
 	}
 
+	tdb_flags = TDB_DEFAULT|TDB_VOLATILE|TDB_CLEAR_IF_FIRST|
+		TDB_INCOMPATIBLE_HASH;
+
+	if (!lp_clustering()) {
+		/*
+		 * We can't use the SEQNUM trick to cache lease
+		 * entries in the clustering case because ctdb seqnum
+		 * propagation has a delay.
+		 */
+		tdb_flags |= TDB_SEQNUM;
+	}
+
 	db_path = lock_path("leases.tdb");
 	if (db_path == NULL) {
 		return false;
 	}
 
-	leases_db = db_open(NULL, db_path, 0,
-			    TDB_DEFAULT|TDB_VOLATILE|TDB_CLEAR_IF_FIRST|
-			    TDB_INCOMPATIBLE_HASH,
+	leases_db = db_open(NULL, db_path, 0, tdb_flags,
 			    read_only ? O_RDONLY : O_RDWR|O_CREAT, 0644,
 			    DBWRAP_LOCK_ORDER_2, DBWRAP_FLAG_NONE);
 	TALLOC_FREE(db_path);
@@ -57,6 +69,27 @@ bool leases_db_init(bool read_only)
 		return false;
 	}
 
+	if (!lp_clustering()) {
+		/*
+		 * Lease key lookups during open and break processing
+		 * vastly outnumber modifications, and the common
+		 * answer is "no such lease". Keep parse results,
+		 * including negative ones, in an in-process cache
+		 * invalidated via the tdb seqnum whenever any smbd
+		 * writes to the database.
+		 */
+		/*
+		 * db_open_cache() owns the backing db, also on
+		 * failure.
+		 */
+		leases_db = db_open_cache(NULL, leases_db);
+		if (leases_db == NULL) {
+			DEBUG(1, ("ERROR: Failed to cache leases "
+				  "database\n"));
+			return false;
+		}
+	}
+
 	return true;
 }
 
@@ -390,6 +390,18 @@ static int share_mode_data_destructor(struct share_mode_data *d)
 	TDB_DATA data;
 
 	if (!d->modified) {
+		/*
+		 * The data was only read. Release the record lock and
+		 * return the parsed copy to the in-memory cache, so
+		 * the next user of this (hot) record is spared the
+		 * ndr pull. Fresh records have nothing in the
+		 * database to be cached against.
+		 */
+		if (!d->fresh) {
+			TALLOC_FREE(d->record);
+			share_mode_memcache_store(d);
+			return -1;
+		}
 		return 0;
 	}
 
@@ -609,6 +621,23 @@ fail:
 	return NULL;
 }
 
+/*
+ * Destructor for share_mode_data fetched without the record lock. If
+ * the data is still pristine, hand it back to the in-memory cache
+ * instead of freeing it, so we don't rob the next locked user of the
+ * cached copy. Callers can mark entries stale (which sets modified),
+ * and without the record lock there is no way to store that - just
+ * let such a copy go.
+ */
+static int share_mode_data_unlocked_destructor(struct share_mode_data *d)
+{
+	if (d->modified) {
+		return 0;
+	}
+	share_mode_memcache_store(d);
+	return -1;
+}
+
 static void fetch_share_mode_unlocked_parser(
 	TDB_DATA key, TDB_DATA data, void *private_data)
 {
@@ -642,6 +671,8 @@ struct share_mode_lock *fetch_share_mode_unlocked(TALLOC_CTX *mem_ctx,
 		TALLOC_FREE(lck);
 		return NULL;
 	}
+	lck->data->id = id;
+	talloc_set_destructor(lck->data, share_mode_data_unlocked_destructor);
 	return lck;
 }
 
@@ -0,0 +1,171 @@
+/*
+ * Shared memory ring buffer for audit records - producer side.
+ *
+ * Copyright (C) Samba Team 2016
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file is #included into the audit VFS modules, vfs_acl_common.c
+ * style, so everything in here is static. See audit_ringbuf.h for the
+ * record format and the single-producer/single-consumer rules that
+ * make this work without locks. Records are dropped, not blocked on,
+ * when the consumer falls behind; the header keeps a drop count.
+ */
+
+#include "modules/audit_ringbuf.h"
+
+#define AUDIT_RINGBUF_MIN_SIZE		(64 * 1024)
+#define AUDIT_RINGBUF_DEFAULT_SIZE	(1024 * 1024)
+
+struct audit_ringbuf {
+	int fd;
+	struct audit_ringbuf_header *hdr;
+	uint8_t *data;
+	uint32_t size;
+};
+
+static int audit_ringbuf_destructor(struct audit_ringbuf *rb)
+{
+	if (rb->hdr != NULL) {
+		munmap((void *)rb->hdr,
+		       sizeof(struct audit_ringbuf_header) + rb->size);
+	}
+	if (rb->fd != -1) {
+		close(rb->fd);
+	}
+	return 0;
+}
+
+/*******************************************************************
+ Create or re-attach the ring file of this smbd process in dir.
+ smbd is single threaded, so several shares sharing the per process
+ ring file is fine - their writes never interleave.
+*******************************************************************/
+
+static struct audit_ringbuf *audit_ringbuf_open(TALLOC_CTX *mem_ctx,
+						const char *dir,
+						uint32_t size)
+{
+	struct audit_ringbuf *rb;
+	char *path;
+	void *p;
+
+	if (size == 0) {
+		size = AUDIT_RINGBUF_DEFAULT_SIZE;
+	}
+	if (size < AUDIT_RINGBUF_MIN_SIZE) {
+		size = AUDIT_RINGBUF_MIN_SIZE;
+	}
+	/* keep the modulo arithmetic on a 4 byte grid */
+	size &= ~3;
+
+	rb = talloc_zero(mem_ctx, struct audit_ringbuf);
+	if (rb == NULL) {
+		return NULL;
+	}
+	rb->fd = -1;
+	talloc_set_destructor(rb, audit_ringbuf_destructor);
+
+	path = talloc_asprintf(rb, "%s/smbd-%lu.ring", dir,
+			       (unsigned long)getpid());
+	if (path == NULL) {
+		TALLOC_FREE(rb);
+		return NULL;
+	}
+
+	rb->fd = open(path, O_RDWR|O_CREAT, 0600);
+	if (rb->fd == -1) {
+		DEBUG(1, ("audit_ringbuf_open: open %s failed: %s\n",
+			  path, strerror(errno)));
+		TALLOC_FREE(rb);
+		return NULL;
+	}
+
+	if (ftruncate(rb->fd,
+		      sizeof(struct audit_ringbuf_header) + size) == -1) {
+		DEBUG(1, ("audit_ringbuf_open: ftruncate %s failed: %s\n",
+			  path, strerror(errno)));
+		TALLOC_FREE(rb);
+		return NULL;
+	}
+
+	p = mmap(NULL, sizeof(struct audit_ringbuf_header) + size,
+		 PROT_READ|PROT_WRITE, MAP_SHARED, rb->fd, 0);
+	if (p == MAP_FAILED) {
+		DEBUG(1, ("audit_ringbuf_open: mmap %s failed: %s\n",
+			  path, strerror(errno)));
+		TALLOC_FREE(rb);
+		return NULL;
+	}
+
+	rb->hdr = (struct audit_ringbuf_header *)p;
+	rb->data = (uint8_t *)p + sizeof(struct audit_ringbuf_header);
+	rb->size = size;
+
+	if ((rb->hdr->magic != AUDIT_RINGBUF_MAGIC) ||
+	    (rb->hdr->version != AUDIT_RINGBUF_VERSION) ||
+	    (rb->hdr->size != size)) {
+		/* fresh file (or leftover with other geometry) */
+		rb->hdr->head = 0;
+		rb->hdr->tail = 0;
+		rb->hdr->dropped = 0;
+		rb->hdr->size = size;
+		rb->hdr->reserved = 0;
+		rb->hdr->version = AUDIT_RINGBUF_VERSION;
+		__sync_synchronize();
+		rb->hdr->magic = AUDIT_RINGBUF_MAGIC;
+	}
+
+	TALLOC_FREE(path);
+	return rb;
+}
+
+static void audit_ringbuf_copy_in(struct audit_ringbuf *rb, uint64_t pos,
+				  const void *buf, size_t len)
+{
+	uint32_t off = pos % rb->size;
+	size_t part = MIN(len, rb->size - off);
+
+	memcpy(rb->data + off, buf, part);
+	if (part < len) {
+		memcpy(rb->data, (const uint8_t *)buf + part, len - part);
+	}
+}
+
+/*******************************************************************
+ Append one record. On overrun the record is dropped and counted -
+ auditing must never block the smbd event loop.
+*******************************************************************/
+
+static void audit_ringbuf_write(struct audit_ringbuf *rb, const char *msg)
+{
+	uint32_t len = strlen(msg) + 1;
+	uint32_t need = sizeof(uint32_t) + ((len + 3) & ~(uint32_t)3);
+	uint64_t head = rb->hdr->head;
+	uint64_t tail = rb->hdr->tail;
+
+	if ((need > rb->size) || (need > rb->size - (head - tail))) {
+		rb->hdr->dropped += 1;
+		return;
+	}
+
+	audit_ringbuf_copy_in(rb, head, &len, sizeof(len));
+	audit_ringbuf_copy_in(rb, head + sizeof(len), msg, len);
+
+	/* publish the record only after its bytes are visible */
+	__sync_synchronize();
+	rb->hdr->head = head + need;
+}
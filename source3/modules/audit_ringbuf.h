@@ -0,0 +1,51 @@
+/*
+ * Shared memory ring buffer for audit records.
+ *
+ * Copyright (C) Samba Team 2016
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AUDIT_RINGBUF_H__
+#define __AUDIT_RINGBUF_H__
+
+/*
+ * On-disk/in-memory layout of an audit ring file, shared between the
+ * producing smbd (vfs_full_audit, vfs_time_audit) and the draining
+ * consumer (audit_ringbuf_read). One file has exactly one producer -
+ * the smbd process whose pid is in the file name - and at most one
+ * consumer, so no locks are needed: the producer only ever writes
+ * head and record bytes, the consumer only ever writes tail, and both
+ * issue a full barrier between filling/reading a record and
+ * publishing/releasing it.
+ *
+ * head and tail are free-running byte counters taken modulo size.
+ * A record is a uint32 length (of the NUL-terminated text) followed
+ * by the text, padded to a multiple of 4 bytes.
+ */
+
+#define AUDIT_RINGBUF_MAGIC	0x53415231	/* "SAR1" */
+#define AUDIT_RINGBUF_VERSION	1
+
+struct audit_ringbuf_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;		/* size of the data area in bytes */
+	uint32_t reserved;
+	volatile uint64_t head;	/* written by the producer only */
+	volatile uint64_t tail;	/* written by the consumer only */
+	volatile uint64_t dropped;
+};
+
+#endif
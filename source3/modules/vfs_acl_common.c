@@ -45,6 +45,27 @@ static NTSTATUS store_acl_blob_fsp(vfs_handle_struct *handle,
 				SECINFO_DACL | \
 				SECINFO_SACL)
 
+/*
+ * Per file handle cache of the security descriptor that
+ * get_nt_acl_internal() last computed and validated against the hash
+ * stored in the blob. Every access check on the handle fetches the
+ * ACL again, each time paying for the blob fetch and the NDR parse.
+ */
+struct acl_common_fsp_ext {
+	struct security_descriptor *psd;
+};
+
+static void acl_common_invalidate_fsp_cache(vfs_handle_struct *handle,
+					    files_struct *fsp)
+{
+	struct acl_common_fsp_ext *ext = (struct acl_common_fsp_ext *)
+		VFS_FETCH_FSP_EXTENSION(handle, fsp);
+
+	if (ext != NULL) {
+		TALLOC_FREE(ext->psd);
+	}
+}
+
 /*******************************************************************
  Hash a security descriptor.
 *******************************************************************/
@@ -381,6 +402,7 @@ static NTSTATUS get_nt_acl_internal(vfs_handle_struct *handle,
 	uint8_t sys_acl_hash_tmp[XATTR_SD_HASH_SIZE];
 	struct security_descriptor *psd = NULL;
 	struct security_descriptor *pdesc_next = NULL;
+	bool from_cache = false;
 	bool ignore_file_system_acl = lp_parm_bool(SNUM(handle->conn),
 						ACL_MODULE_NAME,
 						"ignore system acls",
@@ -393,6 +415,30 @@ static NTSTATUS get_nt_acl_internal(vfs_handle_struct *handle,
 
 	DEBUG(10, ("get_nt_acl_internal: name=%s\n", name));
 
+	if (fsp != NULL) {
+		struct acl_common_fsp_ext *ext =
+			(struct acl_common_fsp_ext *)
+			VFS_FETCH_FSP_EXTENSION(handle, fsp);
+
+		if ((ext != NULL) && (ext->psd != NULL)) {
+			/*
+			 * The descriptor was validated against the
+			 * stored hash when it went into the cache,
+			 * and every ACL change through this handle
+			 * invalidates it.
+			 */
+			DEBUG(10, ("get_nt_acl_internal: returning cached "
+				   "acl for file %s\n", name));
+			psd = security_descriptor_copy(mem_ctx, ext->psd);
+			if (psd == NULL) {
+				TALLOC_FREE(frame);
+				return NT_STATUS_NO_MEMORY;
+			}
+			from_cache = true;
+			goto out;
+		}
+	}
+
 	status = get_acl_blob(frame, handle, fsp, name, &blob);
 	if (!NT_STATUS_IS_OK(status)) {
 		DEBUG(10, ("get_nt_acl_internal: get_acl_blob returned %s\n",
@@ -679,6 +725,28 @@ static NTSTATUS get_nt_acl_internal(vfs_handle_struct *handle,
 		}
 	}
 
+	if ((fsp != NULL) && !from_cache) {
+		/*
+		 * Remember the full descriptor before it is cut down
+		 * to the requested security_info below.
+		 */
+		struct acl_common_fsp_ext *ext =
+			(struct acl_common_fsp_ext *)
+			VFS_FETCH_FSP_EXTENSION(handle, fsp);
+
+		if (ext == NULL) {
+			ext = (struct acl_common_fsp_ext *)
+				VFS_ADD_FSP_EXTENSION(
+					handle, fsp,
+					struct acl_common_fsp_ext, NULL);
+		}
+		if (ext != NULL) {
+			TALLOC_FREE(ext->psd);
+			ext->psd = security_descriptor_copy(
+				VFS_MEMCTX_FSP_EXTENSION(handle, fsp), psd);
+		}
+	}
+
 	if (!(security_info & SECINFO_OWNER)) {
 		psd->owner_sid = NULL;
 	}
@@ -843,6 +911,9 @@ static NTSTATUS fset_nt_acl_common(vfs_handle_struct *handle, files_struct *fsp,
 		}
 	}
 
+	/* The ACL has changed underneath us. */
+	acl_common_invalidate_fsp_cache(handle, fsp);
+
 	/* Get the full underlying sd, then hash. */
 	status = SMB_VFS_NEXT_FGET_NT_ACL(handle,
 					  fsp,
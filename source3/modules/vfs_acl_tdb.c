@@ -384,6 +384,9 @@ static int sys_acl_set_fd_tdb(vfs_handle_struct *handle,
 	}
 
 	acl_tdb_delete(handle, db, &fsp->fsp_name->st);
+
+	acl_common_invalidate_fsp_cache(handle, fsp);
+
 	return 0;
 }
 
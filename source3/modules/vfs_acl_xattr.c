@@ -172,6 +172,8 @@ static int sys_acl_set_fd_xattr(vfs_handle_struct *handle,
 	SMB_VFS_FREMOVEXATTR(fsp, XATTR_NTACL_NAME);
 	unbecome_root();
 
+	acl_common_invalidate_fsp_cache(handle, fsp);
+
 	return ret;
 }
 
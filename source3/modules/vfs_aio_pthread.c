@@ -488,11 +488,191 @@ static int aio_pthread_open_fn(vfs_handle_struct *handle,
 	/* Ok, it's a create exclusive call - pass it to a thread helper. */
 	return open_async(fsp, flags, mode);
 }
+
+/*
+ * NB. This threadpool is shared over all
+ * instances of this VFS module in this
+ * process, as is the current jobid.
+ */
+
+static struct pthreadpool *close_pool;
+static int aio_pthread_close_jobid;
+
+struct aio_close_private_data {
+	struct aio_close_private_data *prev, *next;
+	/* Inputs. */
+	int jobid;
+	int fd;
+	char *fname;
+	/* Returns. */
+	int ret_ret;
+	int ret_errno;
+};
+
+/* List of outstanding requests we have. */
+static struct aio_close_private_data *close_pd_list;
+
+/************************************************************************
+ Find the close private data by jobid.
+***********************************************************************/
+
+static struct aio_close_private_data *find_close_private_data_by_jobid(int jobid)
+{
+	struct aio_close_private_data *cpd;
+
+	for (cpd = close_pd_list; cpd != NULL; cpd = cpd->next) {
+		if (cpd->jobid == jobid) {
+			return cpd;
+		}
+	}
+
+	return NULL;
+}
+
+/************************************************************************
+ Callback when a close completes. The client already got its reply -
+ all we can do with a failure here is log it.
+***********************************************************************/
+
+static void aio_close_handle_completion(struct tevent_context *event_ctx,
+				struct tevent_fd *event,
+				uint16_t flags,
+				void *p)
+{
+	struct aio_close_private_data *cpd = NULL;
+	int jobid = 0;
+	int ret;
+
+	if ((flags & TEVENT_FD_READ) == 0) {
+		return;
+	}
+
+	ret = pthreadpool_finished_jobs(close_pool, &jobid, 1);
+	if (ret != 1) {
+		smb_panic("aio_close_handle_completion");
+		/* notreached. */
+		return;
+	}
+
+	cpd = find_close_private_data_by_jobid(jobid);
+	if (cpd == NULL) {
+		DEBUG(0, ("aio_close_handle_completion cannot find jobid %d\n",
+			jobid));
+		smb_panic("aio_close_handle_completion - no jobid");
+		/* notreached. */
+		return;
+	}
+
+	if (cpd->ret_ret == -1) {
+		DEBUG(1,("aio_close_handle_completion: jobid %d close of "
+			"file %s failed: %s\n",
+			jobid,
+			cpd->fname ? cpd->fname : "<unknown>",
+			strerror(cpd->ret_errno)));
+	} else {
+		DEBUG(10,("aio_close_handle_completion: jobid %d "
+			"for file %s completed\n",
+			jobid,
+			cpd->fname ? cpd->fname : "<unknown>"));
+	}
+
+	DLIST_REMOVE(close_pd_list, cpd);
+	TALLOC_FREE(cpd);
+}
+
+/*****************************************************************
+ The worker function - just close the fd on the helper thread.
+*****************************************************************/
+
+static void aio_close_worker(void *private_data)
+{
+	struct aio_close_private_data *cpd =
+		(struct aio_close_private_data *)private_data;
+
+	cpd->ret_ret = close(cpd->fd);
+	if (cpd->ret_ret == -1) {
+		cpd->ret_errno = errno;
+	} else {
+		cpd->ret_errno = 0;
+	}
+}
+
+/*****************************************************************
+ The core close function. Hand the fd to a thread helper so a
+ close that flushes on the server file system (common on clustered
+ file systems) doesn't stall the main event loop. We take over
+ the fd and report success - a later failure can only be logged.
+
+ We must leave the close alone if POSIX locking is in use, as
+ fd_close_posix() has to see the real close for its lock
+ reference counting and pending close bookkeeping.
+*****************************************************************/
+
+static int aio_pthread_close_fn(vfs_handle_struct *handle,
+				files_struct *fsp)
+{
+	struct aio_close_private_data *cpd = NULL;
+	int ret;
+	bool aio_allow_close = lp_parm_bool(
+		SNUM(handle->conn), "aio_pthread", "aio close", false);
+
+	if (!aio_allow_close) {
+		/* aio closes turned off. */
+		return SMB_VFS_NEXT_CLOSE(handle, fsp);
+	}
+
+	if (fsp->fh->fd == -1) {
+		return SMB_VFS_NEXT_CLOSE(handle, fsp);
+	}
+
+	if (lp_locking(fsp->conn->params) &&
+	    lp_posix_locking(fsp->conn->params)) {
+		return SMB_VFS_NEXT_CLOSE(handle, fsp);
+	}
+
+	if (!init_aio_threadpool(fsp->conn->sconn->ev_ctx,
+			&close_pool,
+			aio_close_handle_completion)) {
+		return SMB_VFS_NEXT_CLOSE(handle, fsp);
+	}
+
+	cpd = talloc_zero(NULL, struct aio_close_private_data);
+	if (cpd == NULL) {
+		return SMB_VFS_NEXT_CLOSE(handle, fsp);
+	}
+
+	cpd->jobid = aio_pthread_close_jobid++;
+	cpd->fd = fsp->fh->fd;
+	cpd->ret_ret = -1;
+	cpd->ret_errno = EINPROGRESS;
+	/* Only for the logs - a copy, fsp is gone when we complete. */
+	cpd->fname = talloc_strdup(cpd, fsp_str_dbg(fsp));
+
+	DLIST_ADD_END(close_pd_list, cpd, struct aio_close_private_data *);
+
+	ret = pthreadpool_add_job(close_pool,
+				cpd->jobid,
+				aio_close_worker,
+				(void *)cpd);
+	if (ret) {
+		DLIST_REMOVE(close_pd_list, cpd);
+		TALLOC_FREE(cpd);
+		return SMB_VFS_NEXT_CLOSE(handle, fsp);
+	}
+
+	DEBUG(10,("aio_pthread_close_fn: jobid %d created for file %s\n",
+		cpd->jobid,
+		cpd->fname ? cpd->fname : "<unknown>"));
+
+	/* The fd now belongs to the worker thread. */
+	return 0;
+}
 #endif
 
 static struct vfs_fn_pointers vfs_aio_pthread_fns = {
 #if defined(HAVE_OPENAT) && defined(USE_LINUX_THREAD_CREDENTIALS)
 	.open_fn = aio_pthread_open_fn,
+	.close_fn = aio_pthread_close_fn,
 #endif
 };
 
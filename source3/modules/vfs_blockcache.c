@@ -0,0 +1,638 @@
+/*
+ * Cache blocks of slow files on fast local media.
+ *
+ * Copyright (C) Samba Team 2016
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "includes.h"
+#include "smbd/smbd.h"
+#include "system/filesys.h"
+#include "lib/sys_rw.h"
+
+#undef DBGC_CLASS
+#define DBGC_CLASS DBGC_VFS
+
+/* Block cache module.
+ *
+ * This module keeps blocks read from a slow file system (typically an
+ * archive mount) in per-file cache files on a fast local device and
+ * serves repeated reads from there. Unlike vfs_cacheprime, which only
+ * pulls data into the kernel buffer cache, the cached blocks survive
+ * memory pressure and smbd restarts.
+ *
+ * Each source file gets one sparse cache file, named after the source
+ * device and inode number: a fixed header, a block presence bitmap
+ * and a data region mirroring the source file's offsets. The header
+ * records the source's size and mtime; if they do not match at open
+ * time the cache file is started over. The cache directory is kept
+ * below a size budget by evicting the least recently touched cache
+ * files when a new one is created.
+ *
+ * Cache writes are idempotent - every writer puts the same source
+ * data at the same offsets - so concurrent smbds sharing a cache
+ * directory need no locking.
+ *
+ * Tunables.
+ *
+ *      blockcache:cachedir    Directory on the fast device. The module
+ *                             does nothing until this is set.
+ *      blockcache:blocksize   Cache block size in bytes.
+ *      blockcache:maxsize     Size budget for the cache directory.
+ */
+
+#define MODULE "blockcache"
+
+#define BLOCKCACHE_MAGIC	0x53424c43	/* "SBLC" */
+#define BLOCKCACHE_VERSION	1
+
+#define BLOCKCACHE_MIN_BLOCKSIZE	(4 * 1024)
+#define BLOCKCACHE_DEFAULT_BLOCKSIZE	(128 * 1024)
+#define BLOCKCACHE_DEFAULT_MAXSIZE	(1024 * 1024 * 1024)
+
+/* keeps the in-memory bitmap of the largest files below 4 MiB */
+#define BLOCKCACHE_MAX_BITMAP_LEN	(4 * 1024 * 1024)
+
+struct blockcache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t blocksize;
+	uint32_t bitmap_len;
+	uint64_t file_size;
+	uint64_t mtime_sec;
+	uint64_t mtime_nsec;
+};
+
+struct blockcache_config {
+	char *cachedir;
+	uint32_t blocksize;
+	uint64_t maxsize;
+};
+
+struct blockcache_state {
+	int cfd;		/* fd of the cache file */
+	bool enabled;
+	uint32_t blocksize;
+	uint32_t bitmap_len;
+	uint64_t file_size;
+	uint64_t mtime_sec;
+	uint64_t mtime_nsec;
+	off_t data_start;
+	uint8_t *bitmap;
+};
+
+static bool blockcache_bit(const uint8_t *bitmap, uint64_t i)
+{
+	return (bitmap[i/8] >> (i%8)) & 1;
+}
+
+static void blockcache_bit_set(uint8_t *bitmap, uint64_t i)
+{
+	bitmap[i/8] |= (1 << (i%8));
+}
+
+static void blockcache_bit_clear(uint8_t *bitmap, uint64_t i)
+{
+	bitmap[i/8] &= ~(1 << (i%8));
+}
+
+static void blockcache_state_destroy(void *p_data)
+{
+	struct blockcache_state *state = (struct blockcache_state *)p_data;
+
+	if (state->cfd != -1) {
+		close(state->cfd);
+		state->cfd = -1;
+	}
+}
+
+/*******************************************************************
+ Write the validation header. Also serves as the "recently used"
+ touch of the cache file for the eviction scan.
+*******************************************************************/
+
+static bool blockcache_write_header(struct blockcache_state *state)
+{
+	struct blockcache_header hdr;
+
+	ZERO_STRUCT(hdr);
+	hdr.magic = BLOCKCACHE_MAGIC;
+	hdr.version = BLOCKCACHE_VERSION;
+	hdr.blocksize = state->blocksize;
+	hdr.bitmap_len = state->bitmap_len;
+	hdr.file_size = state->file_size;
+	hdr.mtime_sec = state->mtime_sec;
+	hdr.mtime_nsec = state->mtime_nsec;
+
+	return (sys_pwrite(state->cfd, &hdr, sizeof(hdr), 0) ==
+		sizeof(hdr));
+}
+
+/*******************************************************************
+ Make room in the cache directory: while the budget (minus what the
+ caller is about to add) is exceeded, unlink the cache file with the
+ oldest mtime.
+*******************************************************************/
+
+static void blockcache_evict(struct blockcache_config *config,
+			     uint64_t need)
+{
+	int rounds;
+
+	if (need > config->maxsize) {
+		need = config->maxsize;
+	}
+
+	for (rounds = 0; rounds < 100; rounds++) {
+		DIR *dirp;
+		struct dirent *d;
+		uint64_t total = 0;
+		time_t oldest_mtime = 0;
+		char *oldest = NULL;
+
+		dirp = opendir(config->cachedir);
+		if (dirp == NULL) {
+			return;
+		}
+
+		while ((d = readdir(dirp)) != NULL) {
+			struct stat st;
+			char *path;
+			size_t namelen = strlen(d->d_name);
+
+			if ((namelen < 7) ||
+			    (strcmp(d->d_name + namelen - 7, ".bcache") != 0)) {
+				continue;
+			}
+
+			path = talloc_asprintf(talloc_tos(), "%s/%s",
+					       config->cachedir, d->d_name);
+			if (path == NULL) {
+				break;
+			}
+			if (stat(path, &st) != 0) {
+				TALLOC_FREE(path);
+				continue;
+			}
+
+			total += (uint64_t)st.st_blocks * 512;
+
+			if ((oldest == NULL) || (st.st_mtime < oldest_mtime)) {
+				oldest_mtime = st.st_mtime;
+				TALLOC_FREE(oldest);
+				oldest = path;
+			} else {
+				TALLOC_FREE(path);
+			}
+		}
+		closedir(dirp);
+
+		if ((total + need <= config->maxsize) || (oldest == NULL)) {
+			TALLOC_FREE(oldest);
+			return;
+		}
+
+		DEBUG(5, ("%s: evicting %s to stay below the budget\n",
+			  MODULE, oldest));
+		unlink(oldest);
+		TALLOC_FREE(oldest);
+	}
+}
+
+/*******************************************************************
+ Get or set up the per handle cache state. Returns a state with
+ enabled=false if this file is not cached for whatever reason.
+*******************************************************************/
+
+static struct blockcache_state *blockcache_get_state(
+	vfs_handle_struct *handle, files_struct *fsp)
+{
+	struct blockcache_state *state;
+	struct blockcache_config *config;
+	struct blockcache_header hdr;
+	SMB_STRUCT_STAT sbuf;
+	char *path;
+	ssize_t nread;
+	uint64_t nblocks;
+	uint32_t bitmap_len;
+	bool valid = false;
+
+	state = (struct blockcache_state *)
+		VFS_FETCH_FSP_EXTENSION(handle, fsp);
+	if (state != NULL) {
+		return state;
+	}
+
+	state = (struct blockcache_state *)VFS_ADD_FSP_EXTENSION(
+		handle, fsp, struct blockcache_state,
+		blockcache_state_destroy);
+	if (state == NULL) {
+		return NULL;
+	}
+	/* the extension comes zeroed, but 0 is a valid fd */
+	state->cfd = -1;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config, struct blockcache_config,
+				return state);
+
+	if (config->cachedir == NULL) {
+		return state;
+	}
+	if (SMB_VFS_FSTAT(fsp, &sbuf) == -1) {
+		return state;
+	}
+	if (!S_ISREG(sbuf.st_ex_mode)) {
+		return state;
+	}
+	if (sbuf.st_ex_size < config->blocksize) {
+		/* not worth a cache file of its own */
+		return state;
+	}
+
+	nblocks = ((uint64_t)sbuf.st_ex_size + config->blocksize - 1) /
+		config->blocksize;
+	if (((nblocks + 7) / 8) > BLOCKCACHE_MAX_BITMAP_LEN) {
+		return state;
+	}
+	bitmap_len = (nblocks + 7) / 8;
+
+	path = talloc_asprintf(talloc_tos(), "%s/%llx-%llx.bcache",
+			       config->cachedir,
+			       (unsigned long long)sbuf.st_ex_dev,
+			       (unsigned long long)sbuf.st_ex_ino);
+	if (path == NULL) {
+		return state;
+	}
+
+	state->cfd = open(path, O_RDWR|O_CREAT, 0600);
+	if (state->cfd == -1) {
+		DEBUG(2, ("%s: could not open %s: %s\n",
+			  MODULE, path, strerror(errno)));
+		TALLOC_FREE(path);
+		return state;
+	}
+
+	state->blocksize = config->blocksize;
+	state->bitmap_len = bitmap_len;
+	state->file_size = sbuf.st_ex_size;
+	state->mtime_sec = sbuf.st_ex_mtime.tv_sec;
+	state->mtime_nsec = sbuf.st_ex_mtime.tv_nsec;
+	state->data_start = ((sizeof(hdr) + bitmap_len +
+			      config->blocksize - 1) /
+			     config->blocksize) * config->blocksize;
+
+	state->bitmap = talloc_zero_array(
+		VFS_MEMCTX_FSP_EXTENSION(handle, fsp),
+		uint8_t, bitmap_len);
+	if (state->bitmap == NULL) {
+		close(state->cfd);
+		state->cfd = -1;
+		TALLOC_FREE(path);
+		return state;
+	}
+
+	nread = sys_pread(state->cfd, &hdr, sizeof(hdr), 0);
+	if ((nread == sizeof(hdr)) &&
+	    (hdr.magic == BLOCKCACHE_MAGIC) &&
+	    (hdr.version == BLOCKCACHE_VERSION) &&
+	    (hdr.blocksize == state->blocksize) &&
+	    (hdr.bitmap_len == state->bitmap_len) &&
+	    (hdr.file_size == state->file_size) &&
+	    (hdr.mtime_sec == state->mtime_sec) &&
+	    (hdr.mtime_nsec == state->mtime_nsec)) {
+		nread = sys_pread(state->cfd, state->bitmap, bitmap_len,
+				  sizeof(hdr));
+		if (nread == bitmap_len) {
+			valid = true;
+		} else {
+			memset(state->bitmap, 0, bitmap_len);
+		}
+	}
+
+	if (!valid) {
+		/* new cache file, or the source has changed */
+		DEBUG(10, ("%s: (re)initializing %s\n", MODULE, path));
+		blockcache_evict(config, state->file_size);
+		if ((ftruncate(state->cfd, 0) == -1) ||
+		    !blockcache_write_header(state) ||
+		    (sys_pwrite(state->cfd, state->bitmap, bitmap_len,
+				sizeof(hdr)) != bitmap_len)) {
+			close(state->cfd);
+			state->cfd = -1;
+			TALLOC_FREE(path);
+			return state;
+		}
+	} else {
+		/* touch the mtime so the eviction scan sees us as used */
+		blockcache_write_header(state);
+	}
+
+	state->enabled = true;
+	TALLOC_FREE(path);
+	return state;
+}
+
+/*******************************************************************
+ Mark the cache of this handle broken - served no more, repaired at
+ the next open by the header check.
+*******************************************************************/
+
+static void blockcache_disable(struct blockcache_state *state)
+{
+	uint32_t zero = 0;
+
+	DEBUG(2, ("%s: disabling cache for this handle\n", MODULE));
+	sys_pwrite(state->cfd, &zero, sizeof(zero), 0);
+	state->enabled = false;
+}
+
+/*******************************************************************
+ Flush the bitmap bytes covering blocks [first, last] to disk.
+*******************************************************************/
+
+static bool blockcache_sync_bitmap(struct blockcache_state *state,
+				   uint64_t first, uint64_t last)
+{
+	uint64_t byte0 = first / 8;
+	uint64_t nbytes = last / 8 - byte0 + 1;
+
+	return (sys_pwrite(state->cfd, state->bitmap + byte0, nbytes,
+			   sizeof(struct blockcache_header) + byte0) ==
+		nbytes);
+}
+
+static ssize_t blockcache_pread(vfs_handle_struct *handle,
+				files_struct *fsp,
+				void *data, size_t n, off_t offset)
+{
+	struct blockcache_state *state;
+	ssize_t ret;
+	uint64_t first, last, i, end;
+	bool all_cached = true;
+	bool stored = false;
+
+	state = blockcache_get_state(handle, fsp);
+
+	if ((state == NULL) || !state->enabled ||
+	    (n == 0) || (offset < 0) ||
+	    ((uint64_t)offset >= state->file_size)) {
+		return SMB_VFS_NEXT_PREAD(handle, fsp, data, n, offset);
+	}
+
+	end = offset + n;
+	if (end > state->file_size) {
+		end = state->file_size;
+	}
+	first = offset / state->blocksize;
+	last = (end - 1) / state->blocksize;
+
+	for (i = first; i <= last; i++) {
+		if (!blockcache_bit(state->bitmap, i)) {
+			all_cached = false;
+			break;
+		}
+	}
+
+	if (all_cached) {
+		ret = sys_pread(state->cfd, data, end - offset,
+				state->data_start + offset);
+		if (ret == (ssize_t)(end - offset)) {
+			DEBUG(10, ("%s: served %llu bytes at %llu from "
+				   "cache for %s\n", MODULE,
+				   (unsigned long long)(end - offset),
+				   (unsigned long long)offset,
+				   fsp_str_dbg(fsp)));
+			return ret;
+		}
+		/* cache read failed - fall back to the real file */
+		DEBUG(2, ("%s: cache read failed: %s\n",
+			  MODULE, strerror(errno)));
+	}
+
+	ret = SMB_VFS_NEXT_PREAD(handle, fsp, data, n, offset);
+	if (ret <= 0) {
+		return ret;
+	}
+
+	/*
+	 * Store the blocks the read fully covers. The partial block at
+	 * the end of the file counts as fully covered once the data
+	 * reaches the file size recorded at open time.
+	 */
+	for (i = first; i <= last; i++) {
+		uint64_t b_start = i * (uint64_t)state->blocksize;
+		uint64_t b_end = b_start + state->blocksize;
+
+		if (b_end > state->file_size) {
+			b_end = state->file_size;
+		}
+		if (blockcache_bit(state->bitmap, i)) {
+			continue;
+		}
+		if ((b_start < (uint64_t)offset) ||
+		    (b_end > (uint64_t)offset + ret)) {
+			continue;
+		}
+		if (sys_pwrite(state->cfd,
+			       (const char *)data + (b_start - offset),
+			       b_end - b_start,
+			       state->data_start + b_start) !=
+		    (ssize_t)(b_end - b_start)) {
+			blockcache_disable(state);
+			return ret;
+		}
+		blockcache_bit_set(state->bitmap, i);
+		stored = true;
+	}
+
+	if (stored && !blockcache_sync_bitmap(state, first, last)) {
+		blockcache_disable(state);
+	}
+
+	return ret;
+}
+
+static ssize_t blockcache_pwrite(vfs_handle_struct *handle,
+				 files_struct *fsp,
+				 const void *data, size_t n, off_t offset)
+{
+	struct blockcache_state *state;
+	SMB_STRUCT_STAT sbuf;
+	ssize_t ret;
+	uint64_t first, last, i;
+
+	ret = SMB_VFS_NEXT_PWRITE(handle, fsp, data, n, offset);
+
+	state = (struct blockcache_state *)
+		VFS_FETCH_FSP_EXTENSION(handle, fsp);
+	if ((ret <= 0) || (state == NULL) || !state->enabled) {
+		return ret;
+	}
+
+	/* drop the blocks the write touched, including partials */
+	first = offset / state->blocksize;
+	last = (offset + ret - 1) / state->blocksize;
+	if (last >= (uint64_t)state->bitmap_len * 8) {
+		last = (uint64_t)state->bitmap_len * 8 - 1;
+	}
+	for (i = first; i <= last; i++) {
+		blockcache_bit_clear(state->bitmap, i);
+	}
+	if (!blockcache_sync_bitmap(state, first, last)) {
+		blockcache_disable(state);
+		return ret;
+	}
+
+	/*
+	 * Our own write changed the source mtime and may have grown
+	 * the file - refresh the validation header so the cache stays
+	 * usable across opens.
+	 */
+	if (SMB_VFS_FSTAT(fsp, &sbuf) == -1) {
+		blockcache_disable(state);
+		return ret;
+	}
+	if ((uint64_t)sbuf.st_ex_size >
+	    (uint64_t)state->bitmap_len * 8 * state->blocksize) {
+		/* grown beyond what the bitmap can describe */
+		blockcache_disable(state);
+		return ret;
+	}
+	state->file_size = sbuf.st_ex_size;
+	state->mtime_sec = sbuf.st_ex_mtime.tv_sec;
+	state->mtime_nsec = sbuf.st_ex_mtime.tv_nsec;
+	if (!blockcache_write_header(state)) {
+		blockcache_disable(state);
+	}
+
+	return ret;
+}
+
+static int blockcache_ftruncate(vfs_handle_struct *handle,
+				files_struct *fsp, off_t len)
+{
+	struct blockcache_state *state;
+	SMB_STRUCT_STAT sbuf;
+	int ret;
+
+	ret = SMB_VFS_NEXT_FTRUNCATE(handle, fsp, len);
+
+	state = (struct blockcache_state *)
+		VFS_FETCH_FSP_EXTENSION(handle, fsp);
+	if ((ret == -1) || (state == NULL) || !state->enabled) {
+		return ret;
+	}
+
+	/* all cached blocks are suspect now */
+	memset(state->bitmap, 0, state->bitmap_len);
+
+	if ((SMB_VFS_FSTAT(fsp, &sbuf) == -1) ||
+	    ((uint64_t)sbuf.st_ex_size >
+	     (uint64_t)state->bitmap_len * 8 * state->blocksize)) {
+		blockcache_disable(state);
+		return ret;
+	}
+	state->file_size = sbuf.st_ex_size;
+	state->mtime_sec = sbuf.st_ex_mtime.tv_sec;
+	state->mtime_nsec = sbuf.st_ex_mtime.tv_nsec;
+
+	if (!blockcache_write_header(state) ||
+	    !blockcache_sync_bitmap(state, 0,
+				    (uint64_t)state->bitmap_len * 8 - 1)) {
+		blockcache_disable(state);
+	}
+
+	return ret;
+}
+
+static int blockcache_connect(struct vfs_handle_struct *handle,
+			      const char *service, const char *user)
+{
+	struct blockcache_config *config;
+	const char *cachedir;
+	struct stat st;
+	int ret;
+
+	ret = SMB_VFS_NEXT_CONNECT(handle, service, user);
+	if (ret < 0) {
+		return ret;
+	}
+
+	config = talloc_zero(handle->conn, struct blockcache_config);
+	if (config == NULL) {
+		DEBUG(1, ("talloc_zero() failed\n"));
+		errno = ENOMEM;
+		return -1;
+	}
+
+	cachedir = lp_parm_const_string(SNUM(handle->conn), MODULE,
+					"cachedir", NULL);
+	if (cachedir == NULL) {
+		DEBUG(1, ("%s: no cachedir set for service %s, module "
+			  "does nothing\n", MODULE, service));
+	} else if ((stat(cachedir, &st) != 0) || !S_ISDIR(st.st_mode)) {
+		DEBUG(0, ("%s: cachedir %s is not a directory, module "
+			  "does nothing\n", MODULE, cachedir));
+		cachedir = NULL;
+	}
+	if (cachedir != NULL) {
+		config->cachedir = talloc_strdup(config, cachedir);
+		if (config->cachedir == NULL) {
+			DEBUG(1, ("talloc_strdup() failed\n"));
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+
+	config->blocksize = conv_str_size(lp_parm_const_string(
+		SNUM(handle->conn), MODULE, "blocksize", NULL));
+	if (config->blocksize == 0) {
+		config->blocksize = BLOCKCACHE_DEFAULT_BLOCKSIZE;
+	}
+	if (config->blocksize < BLOCKCACHE_MIN_BLOCKSIZE) {
+		config->blocksize = BLOCKCACHE_MIN_BLOCKSIZE;
+	}
+	/* round up to the next power of two */
+	while (config->blocksize & (config->blocksize - 1)) {
+		config->blocksize += config->blocksize &
+			(~config->blocksize + 1);
+	}
+
+	config->maxsize = conv_str_size(lp_parm_const_string(
+		SNUM(handle->conn), MODULE, "maxsize", NULL));
+	if (config->maxsize == 0) {
+		config->maxsize = BLOCKCACHE_DEFAULT_MAXSIZE;
+	}
+
+	SMB_VFS_HANDLE_SET_DATA(handle, config,
+				NULL, struct blockcache_config,
+				return -1);
+
+	return 0;
+}
+
+static struct vfs_fn_pointers vfs_blockcache_fns = {
+	.connect_fn = blockcache_connect,
+	.pread_fn = blockcache_pread,
+	.pwrite_fn = blockcache_pwrite,
+	.ftruncate_fn = blockcache_ftruncate,
+};
+
+NTSTATUS vfs_blockcache_init(void);
+NTSTATUS vfs_blockcache_init(void)
+{
+	return smb_register_vfs(SMB_VFS_INTERFACE_VERSION, MODULE,
+				&vfs_blockcache_fns);
+}
@@ -33,6 +33,7 @@
 #include "lib/asys/asys.h"
 #include "lib/util/tevent_ntstatus.h"
 #include "lib/sys_rw.h"
+#include "lib/crypto/sha512.h"
 
 #undef DBGC_CLASS
 #define DBGC_CLASS DBGC_VFS
@@ -1041,6 +1042,26 @@ static int vfswrap_lstat(vfs_handle_struct *handle,
 	return result;
 }
 
+static int vfswrap_stat_batch(vfs_handle_struct *handle,
+			      unsigned int num_entries,
+			      struct smb_filename **smb_fnames)
+{
+	unsigned int i;
+	int result = 0;
+
+	/* no bulk stat syscall exists - issue the stats in a tight
+	   loop, stopping at the first failure. Backends with native
+	   bulk RPCs override this to save one network round trip per
+	   entry. */
+	for (i = 0; i < num_entries; i++) {
+		result = vfswrap_stat(handle, smb_fnames[i]);
+		if (result == -1) {
+			break;
+		}
+	}
+	return result;
+}
+
 static NTSTATUS vfswrap_translate_name(struct vfs_handle_struct *handle,
 				       const char *name,
 				       enum vfs_translate_direction direction,
@@ -1565,6 +1586,180 @@ static NTSTATUS vfswrap_copy_chunk_recv(struct vfs_handle_struct *handle,
 	return NT_STATUS_OK;
 }
 
+/*
+ * Server side file hashing. The digest is computed on a helper thread
+ * via fncall so that a multi-gigabyte file does not stall the main
+ * event loop; only pread and the SHA512 state are touched from the
+ * worker, both of which are safe off the main thread.
+ */
+
+static struct fncall_context *vfswrap_hash_fncall_ctx;
+
+struct vfs_hash_state {
+	int fd;
+	off_t offset;
+	off_t num;
+	off_t hashed;
+	int err;
+	uint8_t *buf;
+	uint8_t digest[64];
+};
+
+static void vfswrap_hash_file_do(void *private_data);
+static void vfswrap_hash_file_done(struct tevent_req *subreq);
+
+static struct tevent_req *vfswrap_hash_file_send(struct vfs_handle_struct *handle,
+						 TALLOC_CTX *mem_ctx,
+						 struct tevent_context *ev,
+						 struct files_struct *fsp,
+						 off_t offset,
+						 off_t num)
+{
+	struct tevent_req *req, *subreq;
+	struct vfs_hash_state *state;
+	NTSTATUS status;
+
+	DEBUG(10, ("performing server side hash of length %lu\n",
+		   (unsigned long)num));
+
+	req = tevent_req_create(mem_ctx, &state, struct vfs_hash_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	status = vfs_stat_fsp(fsp);
+	if (tevent_req_nterror(req, status)) {
+		return tevent_req_post(req, ev);
+	}
+
+	if (num == 0) {
+		/* hash from offset to the end of the file */
+		if (fsp->fsp_name->st.st_ex_size < offset) {
+			tevent_req_nterror(req, NT_STATUS_INVALID_VIEW_SIZE);
+			return tevent_req_post(req, ev);
+		}
+		num = fsp->fsp_name->st.st_ex_size - offset;
+	} else if (fsp->fsp_name->st.st_ex_size < offset + num) {
+		tevent_req_nterror(req, NT_STATUS_INVALID_VIEW_SIZE);
+		return tevent_req_post(req, ev);
+	}
+
+	state->fd = fsp->fh->fd;
+	state->offset = offset;
+	state->num = num;
+
+	if (num == 0) {
+		/* digest of the empty range, no thread needed */
+		SHA512_CTX ctx;
+		samba_SHA512_Init(&ctx);
+		samba_SHA512_Final(state->digest, &ctx);
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+
+	state->buf = talloc_array(state, uint8_t, MIN(num, 8*1024*1024));
+	if (tevent_req_nomem(state->buf, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	if (vfswrap_hash_fncall_ctx == NULL) {
+		vfswrap_hash_fncall_ctx = fncall_context_init(
+			NULL, lp_parm_int(-1, "smbd", "hash threads", 4));
+		if (vfswrap_hash_fncall_ctx == NULL) {
+			tevent_req_nterror(req, NT_STATUS_NO_MEMORY);
+			return tevent_req_post(req, ev);
+		}
+	}
+
+	subreq = fncall_send(state, ev, vfswrap_hash_fncall_ctx,
+			     vfswrap_hash_file_do, state);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, vfswrap_hash_file_done, req);
+	return req;
+}
+
+static void vfswrap_hash_file_do(void *private_data)
+{
+	struct vfs_hash_state *state = talloc_get_type_abort(
+		private_data, struct vfs_hash_state);
+	SHA512_CTX ctx;
+
+	samba_SHA512_Init(&ctx);
+
+	while (state->hashed < state->num) {
+		off_t this_num = MIN(talloc_array_length(state->buf),
+				     state->num - state->hashed);
+		ssize_t ret;
+
+		ret = sys_pread(state->fd, state->buf, this_num,
+				state->offset + state->hashed);
+		if (ret == -1) {
+			state->err = errno;
+			return;
+		}
+		if (ret != this_num) {
+			/* file shrunk under us, zero tolerance */
+			state->err = EIO;
+			return;
+		}
+
+		samba_SHA512_Update(&ctx, state->buf, this_num);
+		state->hashed += this_num;
+	}
+
+	samba_SHA512_Final(state->digest, &ctx);
+	state->err = 0;
+}
+
+static void vfswrap_hash_file_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct vfs_hash_state *state = tevent_req_data(
+		req, struct vfs_hash_state);
+	int ret, err;
+
+	ret = fncall_recv(subreq, &err);
+	TALLOC_FREE(subreq);
+	if (ret == -1) {
+		tevent_req_nterror(req, map_nt_error_from_unix(err));
+		return;
+	}
+	if (state->err != 0) {
+		tevent_req_nterror(req, map_nt_error_from_unix(state->err));
+		return;
+	}
+	tevent_req_done(req);
+}
+
+static NTSTATUS vfswrap_hash_file_recv(struct vfs_handle_struct *handle,
+				       struct tevent_req *req,
+				       uint8_t digest[64],
+				       off_t *hashed)
+{
+	struct vfs_hash_state *state = tevent_req_data(
+		req, struct vfs_hash_state);
+	NTSTATUS status;
+
+	if (tevent_req_is_nterror(req, &status)) {
+		DEBUG(2, ("server side hash failed: %s\n",
+			  nt_errstr(status)));
+		*hashed = 0;
+		tevent_req_received(req);
+		return status;
+	}
+
+	memcpy(digest, state->digest, sizeof(state->digest));
+	*hashed = state->hashed;
+	DEBUG(10, ("server side hash covered %lu bytes\n",
+		   (unsigned long)*hashed));
+	tevent_req_received(req);
+
+	return NT_STATUS_OK;
+}
+
 static NTSTATUS vfswrap_get_compression(struct vfs_handle_struct *handle,
 					TALLOC_CTX *mem_ctx,
 					struct files_struct *fsp,
@@ -1862,6 +2057,25 @@ static int vfswrap_ntimes(vfs_handle_struct *handle,
 	return result;
 }
 
+static int vfswrap_ntimes_batch(vfs_handle_struct *handle,
+				unsigned int num_entries,
+				struct smb_filename **smb_fnames,
+				struct smb_file_time *fts)
+{
+	unsigned int i;
+	int result = 0;
+
+	/* as with stat_batch, a loop of single calls; smart backends
+	   map this onto one bulk RPC */
+	for (i = 0; i < num_entries; i++) {
+		result = vfswrap_ntimes(handle, smb_fnames[i], &fts[i]);
+		if (result == -1) {
+			break;
+		}
+	}
+	return result;
+}
+
 /*********************************************************************
  A version of ftruncate that will write the space on disk if strict
  allocate is set.
@@ -2584,6 +2798,7 @@ static struct vfs_fn_pointers vfs_default_fns = {
 	.stat_fn = vfswrap_stat,
 	.fstat_fn = vfswrap_fstat,
 	.lstat_fn = vfswrap_lstat,
+	.stat_batch_fn = vfswrap_stat_batch,
 	.get_alloc_size_fn = vfswrap_get_alloc_size,
 	.unlink_fn = vfswrap_unlink,
 	.chmod_fn = vfswrap_chmod,
@@ -2594,6 +2809,7 @@ static struct vfs_fn_pointers vfs_default_fns = {
 	.chdir_fn = vfswrap_chdir,
 	.getwd_fn = vfswrap_getwd,
 	.ntimes_fn = vfswrap_ntimes,
+	.ntimes_batch_fn = vfswrap_ntimes_batch,
 	.ftruncate_fn = vfswrap_ftruncate,
 	.fallocate_fn = vfswrap_fallocate,
 	.lock_fn = vfswrap_lock,
@@ -2619,6 +2835,8 @@ static struct vfs_fn_pointers vfs_default_fns = {
 	.fsctl_fn = vfswrap_fsctl,
 	.copy_chunk_send_fn = vfswrap_copy_chunk_send,
 	.copy_chunk_recv_fn = vfswrap_copy_chunk_recv,
+	.hash_file_send_fn = vfswrap_hash_file_send,
+	.hash_file_recv_fn = vfswrap_hash_file_recv,
 	.get_compression_fn = vfswrap_get_compression,
 	.set_compression_fn = vfswrap_set_compression,
 
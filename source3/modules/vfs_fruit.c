@@ -143,6 +143,15 @@ struct fruit_config_data {
 	bool readdir_attr_rsize;
 	bool readdir_attr_finder_info;
 	bool readdir_attr_max_access;
+
+	/*
+	 * Single slot write-through cache of the most recently parsed
+	 * AppleDouble metadata xattr. Mac clients issue bursts of ops
+	 * against the same path, each of which used to refetch and
+	 * reparse the blob.
+	 */
+	char *ad_cache_path;
+	struct adouble *ad_cache;
 };
 
 static const struct enum_list fruit_rsrc[] = {
@@ -1017,6 +1026,101 @@ static ssize_t ad_read(struct adouble *ad, const char *path)
 	}
 }
 
+/**
+ * Duplicate a parsed struct adouble
+ **/
+static struct adouble *ad_dup(TALLOC_CTX *ctx, const struct adouble *ad)
+{
+	struct adouble *copy;
+
+	copy = talloc_zero(ctx, struct adouble);
+	if (copy == NULL) {
+		return NULL;
+	}
+
+	*copy = *ad;
+	copy->ad_fsp = NULL;
+	copy->ad_data = NULL;
+
+	if (ad->ad_data != NULL) {
+		copy->ad_data = (char *)talloc_memdup(
+			copy, ad->ad_data, talloc_get_size(ad->ad_data));
+		if (copy->ad_data == NULL) {
+			TALLOC_FREE(copy);
+			return NULL;
+		}
+	}
+
+	return copy;
+}
+
+/**
+ * Fetch a parsed metadata blob from the per-handle cache
+ **/
+static struct adouble *ad_cache_fetch(vfs_handle_struct *handle,
+				      TALLOC_CTX *ctx, const char *path)
+{
+	struct fruit_config_data *config;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config,
+				struct fruit_config_data, return NULL);
+
+	if (config->ad_cache == NULL ||
+	    strcmp(config->ad_cache_path, path) != 0) {
+		return NULL;
+	}
+
+	return ad_dup(ctx, config->ad_cache);
+}
+
+/**
+ * Remember a parsed metadata blob, replacing any previous entry
+ **/
+static void ad_cache_store(vfs_handle_struct *handle, const char *path,
+			   const struct adouble *ad)
+{
+	struct fruit_config_data *config;
+	struct adouble *copy;
+	char *cached_path;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config,
+				struct fruit_config_data, return);
+
+	copy = ad_dup(config, ad);
+	cached_path = talloc_strdup(config, path);
+	if (copy == NULL || cached_path == NULL) {
+		TALLOC_FREE(copy);
+		TALLOC_FREE(cached_path);
+		return;
+	}
+
+	TALLOC_FREE(config->ad_cache);
+	TALLOC_FREE(config->ad_cache_path);
+	config->ad_cache = copy;
+	config->ad_cache_path = cached_path;
+}
+
+/**
+ * Drop the cached metadata for path, or for any path if path is NULL
+ **/
+static void ad_cache_invalidate(vfs_handle_struct *handle, const char *path)
+{
+	struct fruit_config_data *config;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config,
+				struct fruit_config_data, return);
+
+	if (config->ad_cache_path == NULL) {
+		return;
+	}
+	if (path != NULL && strcmp(config->ad_cache_path, path) != 0) {
+		return;
+	}
+
+	TALLOC_FREE(config->ad_cache);
+	TALLOC_FREE(config->ad_cache_path);
+}
+
 /**
  * Allocate a struct adouble without initialiing it
  *
@@ -1177,6 +1281,14 @@ static struct adouble *ad_get(TALLOC_CTX *ctx, vfs_handle_struct *handle,
 	DEBUG(10, ("ad_get(%s) called for %s\n",
 		   type == ADOUBLE_META ? "meta" : "rsrc", path));
 
+	if (type == ADOUBLE_META) {
+		ad = ad_cache_fetch(handle, ctx, path);
+		if (ad != NULL) {
+			DEBUG(10, ("ad_get(meta) cache hit for %s\n", path));
+			return ad;
+		}
+	}
+
 	ad = ad_alloc(ctx, handle, type, NULL);
 	if (ad == NULL) {
 		rc = -1;
@@ -1190,6 +1302,10 @@ static struct adouble *ad_get(TALLOC_CTX *ctx, vfs_handle_struct *handle,
 		goto exit;
 	}
 
+	if (type == ADOUBLE_META) {
+		ad_cache_store(handle, path, ad);
+	}
+
 exit:
 	DEBUG(10, ("ad_get(%s) for %s returning %d\n",
 		  type == ADOUBLE_META ? "meta" : "rsrc", path, rc));
@@ -1226,6 +1342,10 @@ static int ad_write(struct adouble *ad, const char *path)
 		rc = SMB_VFS_SETXATTR(ad->ad_handle->conn, path,
 				      AFPINFO_EA_NETATALK, ad->ad_data,
 				      AD_DATASZ_XATTR, 0);
+		if (rc == 0 && path != NULL) {
+			/* keep the cache write-through */
+			ad_cache_store(ad->ad_handle, path, ad);
+		}
 		break;
 	case ADOUBLE_RSRC:
 		if ((ad->ad_fsp == NULL)
@@ -2384,6 +2504,9 @@ static int fruit_rename(struct vfs_handle_struct *handle,
 
 	rc = SMB_VFS_NEXT_RENAME(handle, smb_fname_src, smb_fname_dst);
 
+	/* metadata travels with the file, both names may be stale */
+	ad_cache_invalidate(handle, NULL);
+
 	if (!VALID_STAT(smb_fname_src->st)
 	    || !S_ISREG(smb_fname_src->st.st_ex_mode)) {
 		return rc;
@@ -2431,6 +2554,8 @@ static int fruit_unlink(vfs_handle_struct *handle,
 	SMB_VFS_HANDLE_GET_DATA(handle, config,
 				struct fruit_config_data, return -1);
 
+	ad_cache_invalidate(handle, smb_fname->base_name);
+
 	if (!is_ntfs_stream_smb_fname(smb_fname)) {
 		char *adp = NULL;
 
@@ -2819,6 +2944,7 @@ static ssize_t fruit_pwrite(vfs_handle_struct *handle,
 							 fsp->fsp_name->base_name,
 							 AFPINFO_EA_NETATALK);
 			}
+			ad_cache_invalidate(handle, NULL);
 			if (rc != 0 && errno != ENOENT && errno != ENOATTR) {
 				DBG_WARNING("Can't delete metadata for %s: %s\n",
 					    fsp->fsp_name->base_name, strerror(errno));
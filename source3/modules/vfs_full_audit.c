@@ -72,6 +72,8 @@
 
 static int vfs_full_audit_debug_level = DBGC_VFS;
 
+#include "modules/audit_ringbuf.c"
+
 struct vfs_full_audit_private_data {
 	struct bitmap *success_ops;
 	struct bitmap *failure_ops;
@@ -79,6 +81,7 @@ struct vfs_full_audit_private_data {
 	int syslog_priority;
 	bool log_secdesc;
 	bool do_syslog;
+	struct audit_ringbuf *ringbuf;
 };
 
 #undef DBGC_CLASS
@@ -137,6 +140,7 @@ typedef enum _vfs_op_type {
 	SMB_VFS_OP_STAT,
 	SMB_VFS_OP_FSTAT,
 	SMB_VFS_OP_LSTAT,
+	SMB_VFS_OP_STAT_BATCH,
 	SMB_VFS_OP_GET_ALLOC_SIZE,
 	SMB_VFS_OP_UNLINK,
 	SMB_VFS_OP_CHMOD,
@@ -147,6 +151,7 @@ typedef enum _vfs_op_type {
 	SMB_VFS_OP_CHDIR,
 	SMB_VFS_OP_GETWD,
 	SMB_VFS_OP_NTIMES,
+	SMB_VFS_OP_NTIMES_BATCH,
 	SMB_VFS_OP_FTRUNCATE,
 	SMB_VFS_OP_FALLOCATE,
 	SMB_VFS_OP_LOCK,
@@ -171,6 +176,8 @@ typedef enum _vfs_op_type {
 	SMB_VFS_OP_TRANSLATE_NAME,
 	SMB_VFS_OP_COPY_CHUNK_SEND,
 	SMB_VFS_OP_COPY_CHUNK_RECV,
+	SMB_VFS_OP_HASH_FILE_SEND,
+	SMB_VFS_OP_HASH_FILE_RECV,
 	SMB_VFS_OP_GET_COMPRESSION,
 	SMB_VFS_OP_SET_COMPRESSION,
 	SMB_VFS_OP_READDIR_ATTR,
@@ -264,6 +271,7 @@ static struct {
 	{ SMB_VFS_OP_STAT,	"stat" },
 	{ SMB_VFS_OP_FSTAT,	"fstat" },
 	{ SMB_VFS_OP_LSTAT,	"lstat" },
+	{ SMB_VFS_OP_STAT_BATCH,	"stat_batch" },
 	{ SMB_VFS_OP_GET_ALLOC_SIZE,	"get_alloc_size" },
 	{ SMB_VFS_OP_UNLINK,	"unlink" },
 	{ SMB_VFS_OP_CHMOD,	"chmod" },
@@ -274,6 +282,7 @@ static struct {
 	{ SMB_VFS_OP_CHDIR,	"chdir" },
 	{ SMB_VFS_OP_GETWD,	"getwd" },
 	{ SMB_VFS_OP_NTIMES,	"ntimes" },
+	{ SMB_VFS_OP_NTIMES_BATCH,	"ntimes_batch" },
 	{ SMB_VFS_OP_FTRUNCATE,	"ftruncate" },
 	{ SMB_VFS_OP_FALLOCATE,"fallocate" },
 	{ SMB_VFS_OP_LOCK,	"lock" },
@@ -298,6 +307,8 @@ static struct {
 	{ SMB_VFS_OP_TRANSLATE_NAME,	"translate_name" },
 	{ SMB_VFS_OP_COPY_CHUNK_SEND,	"copy_chunk_send" },
 	{ SMB_VFS_OP_COPY_CHUNK_RECV,	"copy_chunk_recv" },
+	{ SMB_VFS_OP_HASH_FILE_SEND,	"hash_file_send" },
+	{ SMB_VFS_OP_HASH_FILE_RECV,	"hash_file_recv" },
 	{ SMB_VFS_OP_GET_COMPRESSION,	"get_compression" },
 	{ SMB_VFS_OP_SET_COMPRESSION,	"set_compression" },
 	{ SMB_VFS_OP_READDIR_ATTR,      "readdir_attr" },
@@ -529,7 +540,16 @@ static void do_log(vfs_op_type op, bool success, vfs_handle_struct *handle,
 
 	audit_pre = audit_prefix(talloc_tos(), handle->conn);
 
-	if (pd->do_syslog) {
+	if (pd->ringbuf != NULL) {
+		char *line = talloc_asprintf(talloc_tos(), "%s|%s|%s|%s",
+					     audit_pre ? audit_pre : "",
+					     audit_opname(op), err_msg,
+					     op_msg);
+		if (line != NULL) {
+			audit_ringbuf_write(pd->ringbuf, line);
+			TALLOC_FREE(line);
+		}
+	} else if (pd->do_syslog) {
 		int priority;
 
 		/*
@@ -586,6 +606,7 @@ static int smb_full_audit_connect(vfs_handle_struct *handle,
 {
 	int result;
 	struct vfs_full_audit_private_data *pd = NULL;
+	const char *ringbuf_dir = NULL;
 
 	result = SMB_VFS_NEXT_CONNECT(handle, svc, user);
 	if (result < 0) {
@@ -616,6 +637,23 @@ static int smb_full_audit_connect(vfs_handle_struct *handle,
 	pd->do_syslog = lp_parm_bool(SNUM(handle->conn),
 				     "full_audit", "syslog", true);
 
+	ringbuf_dir = lp_parm_const_string(SNUM(handle->conn),
+					   "full_audit", "ringbuf dir",
+					   NULL);
+	if (ringbuf_dir != NULL) {
+		pd->ringbuf = audit_ringbuf_open(
+			pd, ringbuf_dir,
+			lp_parm_int(SNUM(handle->conn), "full_audit",
+				    "ringbuf size",
+				    AUDIT_RINGBUF_DEFAULT_SIZE));
+		if (pd->ringbuf == NULL) {
+			DEBUG(1, ("%s: cannot set up audit ring buffer "
+				  "in %s, falling back to %s\n", __func__,
+				  ringbuf_dir,
+				  pd->do_syslog ? "syslog" : "debug log"));
+		}
+	}
+
 #ifdef WITH_SYSLOG
 	if (pd->do_syslog) {
 		openlog("smbd_audit", 0, pd->syslog_facility);
@@ -1359,6 +1397,20 @@ static int smb_full_audit_lstat(vfs_handle_struct *handle,
 	return result;    
 }
 
+static int smb_full_audit_stat_batch(vfs_handle_struct *handle,
+				     unsigned int num_entries,
+				     struct smb_filename **smb_fnames)
+{
+	int result;
+
+	result = SMB_VFS_NEXT_STAT_BATCH(handle, num_entries, smb_fnames);
+
+	do_log(SMB_VFS_OP_STAT_BATCH, (result >= 0), handle, "%u",
+	       num_entries);
+
+	return result;
+}
+
 static uint64_t smb_full_audit_get_alloc_size(vfs_handle_struct *handle,
 		       files_struct *fsp, const SMB_STRUCT_STAT *sbuf)
 {
@@ -1487,6 +1539,22 @@ static int smb_full_audit_ntimes(vfs_handle_struct *handle,
 	return result;
 }
 
+static int smb_full_audit_ntimes_batch(vfs_handle_struct *handle,
+				       unsigned int num_entries,
+				       struct smb_filename **smb_fnames,
+				       struct smb_file_time *fts)
+{
+	int result;
+
+	result = SMB_VFS_NEXT_NTIMES_BATCH(handle, num_entries,
+					   smb_fnames, fts);
+
+	do_log(SMB_VFS_OP_NTIMES_BATCH, (result >= 0), handle, "%u",
+	       num_entries);
+
+	return result;
+}
+
 static int smb_full_audit_ftruncate(vfs_handle_struct *handle, files_struct *fsp,
 			   off_t len)
 {
@@ -1831,6 +1899,37 @@ static NTSTATUS smb_full_audit_copy_chunk_recv(struct vfs_handle_struct *handle,
 	return result;
 }
 
+static struct tevent_req *smb_full_audit_hash_file_send(struct vfs_handle_struct *handle,
+							TALLOC_CTX *mem_ctx,
+							struct tevent_context *ev,
+							struct files_struct *fsp,
+							off_t offset,
+							off_t num)
+{
+	struct tevent_req *req;
+
+	req = SMB_VFS_NEXT_HASH_FILE_SEND(handle, mem_ctx, ev, fsp,
+					  offset, num);
+
+	do_log(SMB_VFS_OP_HASH_FILE_SEND, req, handle, "");
+
+	return req;
+}
+
+static NTSTATUS smb_full_audit_hash_file_recv(struct vfs_handle_struct *handle,
+					      struct tevent_req *req,
+					      uint8_t digest[64],
+					      off_t *hashed)
+{
+	NTSTATUS result;
+
+	result = SMB_VFS_NEXT_HASH_FILE_RECV(handle, req, digest, hashed);
+
+	do_log(SMB_VFS_OP_HASH_FILE_RECV, NT_STATUS_IS_OK(result), handle, "");
+
+	return result;
+}
+
 static NTSTATUS smb_full_audit_get_compression(vfs_handle_struct *handle,
 					       TALLOC_CTX *mem_ctx,
 					       struct files_struct *fsp,
@@ -2261,6 +2360,7 @@ static struct vfs_fn_pointers vfs_full_audit_fns = {
 	.stat_fn = smb_full_audit_stat,
 	.fstat_fn = smb_full_audit_fstat,
 	.lstat_fn = smb_full_audit_lstat,
+	.stat_batch_fn = smb_full_audit_stat_batch,
 	.get_alloc_size_fn = smb_full_audit_get_alloc_size,
 	.unlink_fn = smb_full_audit_unlink,
 	.chmod_fn = smb_full_audit_chmod,
@@ -2271,6 +2371,7 @@ static struct vfs_fn_pointers vfs_full_audit_fns = {
 	.chdir_fn = smb_full_audit_chdir,
 	.getwd_fn = smb_full_audit_getwd,
 	.ntimes_fn = smb_full_audit_ntimes,
+	.ntimes_batch_fn = smb_full_audit_ntimes_batch,
 	.ftruncate_fn = smb_full_audit_ftruncate,
 	.fallocate_fn = smb_full_audit_fallocate,
 	.lock_fn = smb_full_audit_lock,
@@ -2295,6 +2396,8 @@ static struct vfs_fn_pointers vfs_full_audit_fns = {
 	.translate_name_fn = smb_full_audit_translate_name,
 	.copy_chunk_send_fn = smb_full_audit_copy_chunk_send,
 	.copy_chunk_recv_fn = smb_full_audit_copy_chunk_recv,
+	.hash_file_send_fn = smb_full_audit_hash_file_send,
+	.hash_file_recv_fn = smb_full_audit_hash_file_recv,
 	.get_compression_fn = smb_full_audit_get_compression,
 	.set_compression_fn = smb_full_audit_set_compression,
 	.readdir_attr_fn = smb_full_audit_readdir_attr,
@@ -52,6 +52,7 @@ struct gpfs_config_data {
 	bool acl;
 	bool settimes;
 	bool recalls;
+	bool statlite;
 };
 
 static inline unsigned int gpfs_acl_flags(gpfs_acl_t *gacl)
@@ -1632,20 +1633,86 @@ static int stat_with_capability(struct vfs_handle_struct *handle,
 }
 #endif
 
+/*
+ * Reduced consistency stat through gpfs_statlite()/gpfs_lstatlite().
+ * These only require a token for the attributes the caller insists
+ * on being exact; with an empty litemask GPFS may answer from
+ * whatever this node has cached, which avoids most of the cross-node
+ * token traffic a full stat storm during large directory listings
+ * causes. The price is that attributes can be slightly stale when
+ * another node is writing the file.
+ */
+
+static void vfs_gpfs_stat_from_stat64(struct stat *dst,
+				      const struct stat64 *src)
+{
+	ZERO_STRUCTP(dst);
+	dst->st_dev = src->st_dev;
+	dst->st_ino = src->st_ino;
+	dst->st_mode = src->st_mode;
+	dst->st_nlink = src->st_nlink;
+	dst->st_uid = src->st_uid;
+	dst->st_gid = src->st_gid;
+	dst->st_rdev = src->st_rdev;
+	dst->st_size = src->st_size;
+	dst->st_blksize = src->st_blksize;
+	dst->st_blocks = src->st_blocks;
+	dst->st_atime = src->st_atime;
+	dst->st_mtime = src->st_mtime;
+	dst->st_ctime = src->st_ctime;
+#if defined(HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC)
+	dst->st_atim.tv_nsec = src->st_atim.tv_nsec;
+	dst->st_mtim.tv_nsec = src->st_mtim.tv_nsec;
+	dst->st_ctim.tv_nsec = src->st_ctim.tv_nsec;
+#endif
+}
+
+static int vfs_gpfs_statlite(struct vfs_handle_struct *handle,
+			     struct smb_filename *smb_fname,
+			     bool follow)
+{
+	unsigned int litemask = 0;
+	struct stat64 st64;
+	struct stat st;
+	int ret;
+
+	if (follow) {
+		ret = gpfswrap_statlite(smb_fname->base_name,
+					&litemask, &st64);
+	} else {
+		ret = gpfswrap_lstatlite(smb_fname->base_name,
+					 &litemask, &st64);
+	}
+	if (ret == -1) {
+		return -1;
+	}
+
+	vfs_gpfs_stat_from_stat64(&st, &st64);
+	init_stat_ex_from_stat(
+		&smb_fname->st, &st,
+		lp_fake_directory_create_times(SNUM(handle->conn)));
+	return 0;
+}
+
 static int vfs_gpfs_stat(struct vfs_handle_struct *handle,
 			 struct smb_filename *smb_fname)
 {
 	struct gpfs_winattr attrs;
 	char *fname = NULL;
 	NTSTATUS status;
-	int ret;
+	int ret = -1;
 	struct gpfs_config_data *config;
 
 	SMB_VFS_HANDLE_GET_DATA(handle, config,
 				struct gpfs_config_data,
 				return -1);
 
-	ret = SMB_VFS_NEXT_STAT(handle, smb_fname);
+	if (config->statlite) {
+		ret = vfs_gpfs_statlite(handle, smb_fname, true);
+	}
+	if (ret == -1) {
+		ret = SMB_VFS_NEXT_STAT(handle, smb_fname);
+	}
 #if defined(HAVE_FSTATAT)
 	if (ret == -1 && errno == EACCES) {
 		DEBUG(10, ("Trying stat with capability for %s\n",
@@ -1713,14 +1780,19 @@ static int vfs_gpfs_lstat(struct vfs_handle_struct *handle,
 	struct gpfs_winattr attrs;
 	char *path = NULL;
 	NTSTATUS status;
-	int ret;
+	int ret = -1;
 	struct gpfs_config_data *config;
 
 	SMB_VFS_HANDLE_GET_DATA(handle, config,
 				struct gpfs_config_data,
 				return -1);
 
-	ret = SMB_VFS_NEXT_LSTAT(handle, smb_fname);
+	if (config->statlite) {
+		ret = vfs_gpfs_statlite(handle, smb_fname, false);
+	}
+	if (ret == -1) {
+		ret = SMB_VFS_NEXT_LSTAT(handle, smb_fname);
+	}
 #if defined(HAVE_FSTATAT)
 	if (ret == -1 && errno == EACCES) {
 		DEBUG(10, ("Trying lstat with capability for %s\n",
@@ -2028,6 +2100,9 @@ static int vfs_gpfs_connect(struct vfs_handle_struct *handle,
 	config->recalls = lp_parm_bool(SNUM(handle->conn), "gpfs",
 				       "recalls", true);
 
+	config->statlite = lp_parm_bool(SNUM(handle->conn), "gpfs",
+					"statlite", false);
+
 	SMB_VFS_HANDLE_SET_DATA(handle, config,
 				NULL, struct gpfs_config_data,
 				return -1);
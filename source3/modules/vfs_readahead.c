@@ -23,18 +23,180 @@
 ssize_t readahead(int fd, off_t offset, size_t count);
 #endif
 
+/* consecutive reads continuing a pattern before we trust it */
+#define READAHEAD_MIN_PATTERN 2
+/* consecutive pattern misses before we treat the handle as random */
+#define READAHEAD_RANDOM_LIMIT 4
+
 struct readahead_data {
 	off_t off_bound;
 	off_t len;
+	off_t max;
 	bool didmsg;
 };
 
-/* 
- * This module copes with Vista AIO read requests on Linux
+/*
+ * Per file handle pattern detector. Reads that either continue where
+ * the last one ended or repeat a constant start-to-start stride
+ * (forward or reverse) grow the readahead window; runs of reads that
+ * do neither shrink it and eventually mark the handle as random so we
+ * stop polluting the page cache with speculative data.
+ */
+struct readahead_fsp_state {
+	off_t last_start;	/* offset of the previous read */
+	off_t last_end;		/* end of the previous read */
+	off_t last_stride;	/* start-to-start delta of the last two reads */
+	off_t window;		/* current readahead window size */
+	off_t ra_end;		/* offset we have already read ahead to */
+	unsigned int seq_count;	/* reads continuing the current pattern */
+	unsigned int rand_count; /* reads breaking the current pattern */
+	bool advise_random;	/* we have told the kernel to stop readahead */
+};
+
+/*
+ * This module used to cope with Vista AIO read requests on Linux
  * by detecting the initial 0x80000 boundary reads and causing
- * the buffer cache to be filled in advance.
+ * the buffer cache to be filled in advance. The boundary reads are
+ * still used to seed the detector, but window size and direction now
+ * adapt to the access pattern seen on each file handle.
  */
 
+/*******************************************************************
+ Issue the actual readahead/posix_fadvise hint.
+*******************************************************************/
+
+static void readahead_issue(struct readahead_data *rhd,
+				files_struct *fsp,
+				off_t offset,
+				off_t len)
+{
+#if defined(HAVE_LINUX_READAHEAD)
+	int err = readahead(fsp->fh->fd, offset, (size_t)len);
+	DEBUG(10,("readahead_issue: readahead on fd %u, offset %llu, len %u returned %d\n",
+		(unsigned int)fsp->fh->fd,
+		(unsigned long long)offset,
+		(unsigned int)len,
+		err ));
+#elif defined(HAVE_POSIX_FADVISE)
+	int err = posix_fadvise(fsp->fh->fd, offset, len, POSIX_FADV_WILLNEED);
+	DEBUG(10,("readahead_issue: posix_fadvise on fd %u, offset %llu, len %u returned %d\n",
+		(unsigned int)fsp->fh->fd,
+		(unsigned long long)offset,
+		(unsigned int)len,
+		err ));
+#else
+	if (!rhd->didmsg) {
+		DEBUG(0,("readahead_issue: no readahead on this platform\n"));
+		rhd->didmsg = True;
+	}
+#endif
+}
+
+/*******************************************************************
+ Track the access pattern on this handle and hint accordingly.
+*******************************************************************/
+
+static void readahead_update(vfs_handle_struct *handle,
+				files_struct *fsp,
+				off_t offset,
+				size_t count)
+{
+	struct readahead_data *rhd = (struct readahead_data *)handle->data;
+	struct readahead_fsp_state *state;
+	off_t stride;
+	bool pattern;
+
+	state = (struct readahead_fsp_state *)
+		VFS_FETCH_FSP_EXTENSION(handle, fsp);
+	if (state == NULL) {
+		state = (struct readahead_fsp_state *)VFS_ADD_FSP_EXTENSION(
+			handle, fsp, struct readahead_fsp_state, NULL);
+		if (state == NULL) {
+			return;
+		}
+		state->window = rhd->len;
+		/* seed with the old boundary heuristic so the Vista
+		   AIO pattern gets its first window immediately */
+		if (offset % rhd->off_bound == 0) {
+			readahead_issue(rhd, fsp, offset, state->window);
+			state->ra_end = offset + state->window;
+		}
+		state->last_start = offset;
+		state->last_end = offset + count;
+		return;
+	}
+
+	stride = offset - state->last_start;
+
+	/* sequential continuation, or a repeated nonzero stride -
+	   the latter also covers reverse readers and the out of
+	   order boundary reads of the Vista AIO pattern */
+	pattern = (offset == state->last_end ||
+		   (stride != 0 && stride == state->last_stride));
+
+	if (pattern) {
+		state->rand_count = 0;
+		if (state->seq_count < READAHEAD_MIN_PATTERN) {
+			state->seq_count++;
+		}
+		if (state->seq_count >= READAHEAD_MIN_PATTERN) {
+			off_t ra_off, ra_len;
+
+#if defined(HAVE_POSIX_FADVISE)
+			if (state->advise_random) {
+				posix_fadvise(fsp->fh->fd, 0, 0,
+					      POSIX_FADV_NORMAL);
+				state->advise_random = false;
+			}
+#endif
+			/* widen the window while the pattern holds */
+			if (state->window < rhd->max) {
+				state->window = MIN(state->window * 2,
+						    rhd->max);
+			}
+
+			ra_len = state->window;
+			if (stride < 0) {
+				/* reverse reader - fill the cache
+				   below the current read */
+				ra_off = offset > ra_len ?
+					offset - ra_len : 0;
+			} else {
+				ra_off = offset + count;
+			}
+			if (ra_off + ra_len > state->ra_end ||
+			    ra_off < state->last_start) {
+				readahead_issue(rhd, fsp, ra_off, ra_len);
+				state->ra_end = ra_off + ra_len;
+			}
+		}
+	} else {
+		state->seq_count = 0;
+		state->ra_end = 0;
+		if (state->rand_count < READAHEAD_RANDOM_LIMIT) {
+			state->rand_count++;
+		}
+		if (state->rand_count >= READAHEAD_RANDOM_LIMIT) {
+			/* back off - halve the window and tell the
+			   kernel to stop its own speculation too */
+			if (state->window > rhd->len) {
+				state->window /= 2;
+			}
+#if defined(HAVE_POSIX_FADVISE)
+			if (!state->advise_random) {
+				posix_fadvise(fsp->fh->fd, 0, 0,
+					      POSIX_FADV_RANDOM);
+				state->advise_random = true;
+			}
+#endif
+		}
+	}
+
+	state->last_stride = stride;
+	state->last_start = offset;
+	state->last_end = offset + count;
+}
+
 /*******************************************************************
  sendfile wrapper that does readahead/posix_fadvise.
 *******************************************************************/
@@ -46,30 +208,8 @@ static ssize_t readahead_sendfile(struct vfs_handle_struct *handle,
 					off_t offset,
 					size_t count)
 {
-	struct readahead_data *rhd = (struct readahead_data *)handle->data;
+	readahead_update(handle, fromfsp, offset, count);
 
-	if ( offset % rhd->off_bound == 0) {
-#if defined(HAVE_LINUX_READAHEAD)
-		int err = readahead(fromfsp->fh->fd, offset, (size_t)rhd->len);
-		DEBUG(10,("readahead_sendfile: readahead on fd %u, offset %llu, len %u returned %d\n",
-			(unsigned int)fromfsp->fh->fd,
-			(unsigned long long)offset,
-			(unsigned int)rhd->len,
-		        err ));
-#elif defined(HAVE_POSIX_FADVISE)
-		int err = posix_fadvise(fromfsp->fh->fd, offset, (off_t)rhd->len, POSIX_FADV_WILLNEED);
-		DEBUG(10,("readahead_sendfile: posix_fadvise on fd %u, offset %llu, len %u returned %d\n",
-			(unsigned int)fromfsp->fh->fd,
-			(unsigned long long)offset,
-			(unsigned int)rhd->len,
-			err ));
-#else
-		if (!rhd->didmsg) {
-			DEBUG(0,("readahead_sendfile: no readahead on this platform\n"));
-			rhd->didmsg = True;
-		}
-#endif
-	}
 	return SMB_VFS_NEXT_SENDFILE(handle,
 					tofd,
 					fromfsp,
@@ -88,31 +228,9 @@ static ssize_t readahead_pread(vfs_handle_struct *handle,
 				size_t count,
 				off_t offset)
 {
-	struct readahead_data *rhd = (struct readahead_data *)handle->data;
+	readahead_update(handle, fsp, offset, count);
 
-	if ( offset % rhd->off_bound == 0) {
-#if defined(HAVE_LINUX_READAHEAD)
-		int err = readahead(fsp->fh->fd, offset, (size_t)rhd->len);
-		DEBUG(10,("readahead_pread: readahead on fd %u, offset %llu, len %u returned %d\n",
-			(unsigned int)fsp->fh->fd,
-			(unsigned long long)offset,
-			(unsigned int)rhd->len,
-			err ));
-#elif defined(HAVE_POSIX_FADVISE)
-		int err = posix_fadvise(fsp->fh->fd, offset, (off_t)rhd->len, POSIX_FADV_WILLNEED);
-		DEBUG(10,("readahead_pread: posix_fadvise on fd %u, offset %llu, len %u returned %d\n",
-			(unsigned int)fsp->fh->fd,
-			(unsigned long long)offset,
-			(unsigned int)rhd->len,
-			err ));
-#else
-		if (!rhd->didmsg) {
-			DEBUG(0,("readahead_pread: no readahead on this platform\n"));
-			rhd->didmsg = True;
-		}
-#endif
-        }
-        return SMB_VFS_NEXT_PREAD(handle, fsp, data, count, offset);
+	return SMB_VFS_NEXT_PREAD(handle, fsp, data, count, offset);
 }
 
 /*******************************************************************
@@ -162,6 +280,13 @@ static int readahead_connect(struct vfs_handle_struct *handle,
 	if (rhd->len == 0) {
 		rhd->len = rhd->off_bound;
 	}
+	rhd->max = conv_str_size(lp_parm_const_string(SNUM(handle->conn),
+						"readahead",
+						"maximum",
+						NULL));
+	if (rhd->max == 0) {
+		rhd->max = rhd->len * 8;
+	}
 
 	handle->data = (void *)rhd;
 	handle->free_data = free_readahead_data;
@@ -35,6 +35,15 @@
 #include "include/ntioctl.h"
 #include "util_tdb.h"
 
+/*
+ * How long a cached snapshot listing stays valid without
+ * revalidation. The snapdir mtime check below catches snapshot
+ * creation and deletion; the timeout is a safety net for file
+ * systems that update the mtime of the snapshot directory lazily
+ * or not at all.
+ */
+#define SHADOW_COPY2_SNAPLIST_CACHE_TIME 60
+
 struct shadow_copy2_config {
 	char *gmt_format;
 	bool use_sscanf;
@@ -49,6 +58,24 @@ struct shadow_copy2_config {
 	char *mount_point;
 	char *rel_connectpath; /* share root, relative to the basedir */
 	char *snapshot_basepath; /* the absolute version of snapdir */
+	/*
+	 * The directory last verified to exist in a snapshot, along
+	 * with the snapshot's timestamp. Previous Versions browsing
+	 * converts every entry of a directory with the same @GMT
+	 * token, and each conversion used to lstat the snapshot tree
+	 * again.
+	 */
+	time_t conv_cache_timestamp;
+	char *conv_cache_dir;
+	/*
+	 * Cached listing of the snapshot directory, revalidated via
+	 * its mtime and a timeout.
+	 */
+	char *snaplist_dir;
+	struct timespec snaplist_mtime;
+	time_t snaplist_time;
+	unsigned snaplist_count;
+	SHADOW_COPY_LABEL *snaplist_labels;
 };
 
 static bool shadow_copy2_find_slashes(TALLOC_CTX *mem_ctx, const char *str,
@@ -430,6 +457,70 @@ static char *shadow_copy2_find_mount_point(TALLOC_CTX *mem_ctx,
 	return path;
 }
 
+/**
+ * Return the length of the directory part of a stripped name,
+ * i.e. everything up to (not including) the last slash. A name
+ * without a slash lives directly in the share root.
+ */
+static size_t shadow_copy2_dirname_len(const char *name)
+{
+	const char *p = strrchr(name, '/');
+	if (p == NULL) {
+		return 0;
+	}
+	return p - name;
+}
+
+/**
+ * Check whether the directory around a name has already been
+ * verified to exist in the snapshot with the given timestamp.
+ */
+static bool shadow_copy2_conv_cache_check(struct vfs_handle_struct *handle,
+					  const char *name, time_t timestamp)
+{
+	size_t dirlen;
+	struct shadow_copy2_config *config;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config, struct shadow_copy2_config,
+				return false);
+
+	if (config->conv_cache_dir == NULL) {
+		return false;
+	}
+	if (config->conv_cache_timestamp != timestamp) {
+		return false;
+	}
+
+	dirlen = shadow_copy2_dirname_len(name);
+
+	if (strlen(config->conv_cache_dir) != dirlen) {
+		return false;
+	}
+	return (strncmp(config->conv_cache_dir, name, dirlen) == 0);
+}
+
+/**
+ * Remember that the directory around a name exists in the snapshot
+ * with the given timestamp.
+ */
+static void shadow_copy2_conv_cache_store(struct vfs_handle_struct *handle,
+					  const char *name, time_t timestamp)
+{
+	char *dir;
+	struct shadow_copy2_config *config;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config, struct shadow_copy2_config,
+				return);
+
+	dir = talloc_strndup(config, name, shadow_copy2_dirname_len(name));
+	if (dir == NULL) {
+		return;
+	}
+	TALLOC_FREE(config->conv_cache_dir);
+	config->conv_cache_dir = dir;
+	config->conv_cache_timestamp = timestamp;
+}
+
 /**
  * Convert from a name as handed in via the SMB layer
  * and a timestamp into the local path of the snapshot
@@ -485,13 +576,32 @@ static char *shadow_copy2_do_convert(TALLOC_CTX *mem_ctx,
 			goto fail;
 		}
 
-		ZERO_STRUCT(converted_fname);
-		converted_fname.base_name = converted;
-
-		ret = SMB_VFS_NEXT_LSTAT(handle, &converted_fname);
-		DEBUG(10, ("Trying[not snapdirseverywhere] %s: %d (%s)\n",
-			   converted,
-			   ret, ret == 0 ? "ok" : strerror(errno)));
+		/*
+		 * If the directory around this name was already
+		 * verified to exist in this snapshot, skip the lstat
+		 * probe. Each probe into the snapshot tree has a cost
+		 * (on some file systems it even triggers a snapshot
+		 * automount), and the actual operation on the
+		 * returned path reports ENOENT just as the probe
+		 * would.
+		 */
+		if (shadow_copy2_conv_cache_check(handle, name, timestamp)) {
+			DEBUG(10, ("Using cached conversion for %s\n",
+				   converted));
+			ret = 0;
+		} else {
+			ZERO_STRUCT(converted_fname);
+			converted_fname.base_name = converted;
+
+			ret = SMB_VFS_NEXT_LSTAT(handle, &converted_fname);
+			DEBUG(10, ("Trying[not snapdirseverywhere] %s: %d (%s)\n",
+				   converted,
+				   ret, ret == 0 ? "ok" : strerror(errno)));
+			if (ret == 0) {
+				shadow_copy2_conv_cache_store(handle, name,
+							      timestamp);
+			}
+		}
 		if (ret == 0) {
 			DEBUG(10, ("Found %s\n", converted));
 			result = converted;
@@ -1366,6 +1476,37 @@ static void shadow_copy2_sort_data(vfs_handle_struct *handle,
 	}
 }
 
+/**
+ * Check whether the cached listing of the given snapshot directory
+ * is still valid. The mtime of the snapshot directory changes when
+ * snapshots are created or removed; the timeout catches file systems
+ * where it does not.
+ */
+static bool shadow_copy2_snaplist_cache_valid(
+	struct shadow_copy2_config *config, const char *snapdir,
+	const struct timespec *mtime, bool labels)
+{
+	if (config->snaplist_dir == NULL) {
+		return false;
+	}
+	if (strcmp(config->snaplist_dir, snapdir) != 0) {
+		return false;
+	}
+	if (timespec_compare(&config->snaplist_mtime, mtime) != 0) {
+		return false;
+	}
+	if ((time(NULL) - config->snaplist_time) >
+	    SHADOW_COPY2_SNAPLIST_CACHE_TIME) {
+		return false;
+	}
+	if (labels && (config->snaplist_count > 0) &&
+	    (config->snaplist_labels == NULL)) {
+		/* only the count was cached */
+		return false;
+	}
+	return true;
+}
+
 static int shadow_copy2_get_shadow_copy_data(
 	vfs_handle_struct *handle, files_struct *fsp,
 	struct shadow_copy_data *shadow_copy2_data,
@@ -1376,6 +1517,14 @@ static int shadow_copy2_get_shadow_copy_data(
 	struct dirent *d;
 	TALLOC_CTX *tmp_ctx = talloc_stackframe();
 	bool ret;
+	struct smb_filename snapdir_fname;
+	bool have_mtime = false;
+	struct timespec mtime = { 0, };
+	struct shadow_copy2_config *config;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config, struct shadow_copy2_config,
+				talloc_free(tmp_ctx); errno = EINVAL;
+				return -1);
 
 	snapdir = shadow_copy2_find_snapdir(tmp_ctx, handle, fsp->fsp_name);
 	if (snapdir == NULL) {
@@ -1393,6 +1542,40 @@ static int shadow_copy2_get_shadow_copy_data(
 		return -1;
 	}
 
+	ZERO_STRUCT(snapdir_fname);
+	snapdir_fname.base_name = talloc_strdup(tmp_ctx, snapdir);
+	if (snapdir_fname.base_name != NULL &&
+	    SMB_VFS_NEXT_STAT(handle, &snapdir_fname) == 0) {
+		have_mtime = true;
+		mtime = snapdir_fname.st.st_ex_mtime;
+	}
+
+	if (have_mtime &&
+	    shadow_copy2_snaplist_cache_valid(config, snapdir, &mtime,
+					      labels)) {
+		DEBUG(10, ("using cached snapshot list for %s "
+			   "(%u snapshots)\n",
+			   snapdir, config->snaplist_count));
+
+		shadow_copy2_data->num_volumes = config->snaplist_count;
+		shadow_copy2_data->labels = NULL;
+
+		if (labels && (config->snaplist_count > 0)) {
+			shadow_copy2_data->labels = talloc_memdup(
+				shadow_copy2_data, config->snaplist_labels,
+				config->snaplist_count *
+				sizeof(SHADOW_COPY_LABEL));
+			if (shadow_copy2_data->labels == NULL) {
+				DEBUG(0,("shadow_copy2: out of memory\n"));
+				talloc_free(tmp_ctx);
+				return -1;
+			}
+		}
+
+		talloc_free(tmp_ctx);
+		return 0;
+	}
+
 	p = SMB_VFS_NEXT_OPENDIR(handle, snapdir, NULL, 0);
 
 	if (!p) {
@@ -1453,6 +1636,31 @@ static int shadow_copy2_get_shadow_copy_data(
 
 	shadow_copy2_sort_data(handle, shadow_copy2_data);
 
+	if (have_mtime) {
+		TALLOC_FREE(config->snaplist_dir);
+		TALLOC_FREE(config->snaplist_labels);
+		config->snaplist_count = 0;
+
+		config->snaplist_dir = talloc_strdup(config, snapdir);
+		if (config->snaplist_dir != NULL) {
+			config->snaplist_mtime = mtime;
+			config->snaplist_time = time(NULL);
+			config->snaplist_count =
+				shadow_copy2_data->num_volumes;
+			if (labels && (shadow_copy2_data->num_volumes > 0)) {
+				config->snaplist_labels = talloc_memdup(
+					config, shadow_copy2_data->labels,
+					shadow_copy2_data->num_volumes *
+					sizeof(SHADOW_COPY_LABEL));
+				if (config->snaplist_labels == NULL) {
+					/* run without the cache */
+					TALLOC_FREE(config->snaplist_dir);
+					config->snaplist_count = 0;
+				}
+			}
+		}
+	}
+
 	talloc_free(tmp_ctx);
 	return 0;
 }
@@ -33,8 +33,24 @@ struct streams_xattr_config {
 	const char *prefix;
 	size_t prefix_len;
 	bool store_stream_type;
+	bool use_index;
 };
 
+/*
+ * Optional index of the stream xattrs on a file, stored in one xattr
+ * as a concatenation of null-terminated xattr names. With it,
+ * streaminfo fetches a single key instead of listing and
+ * string-matching every xattr on the file, which gets expensive once
+ * other software (backup or scanner state, for example) piles dozens
+ * of unrelated xattrs onto the files.
+ *
+ * The name starts with the default stream prefix so that
+ * samba_private_attr_name() hides it from EA listings. A stream can
+ * never map onto this name: the trailing colon would have been
+ * parsed as an (invalid) stream type suffix.
+ */
+#define SAMBA_XATTR_STREAM_INDEX SAMBA_XATTR_DOSSTREAM_PREFIX ":index:"
+
 struct stream_io {
 	char *base;
 	char *xattr_name;
@@ -163,6 +179,257 @@ static NTSTATUS streams_xattr_get_name(vfs_handle_struct *handle,
 	return NT_STATUS_OK;
 }
 
+/**
+ * Read and parse the stream index xattr. Returns a talloc'ed array of
+ * xattr names, NT_STATUS_NOT_FOUND if the file has no index.
+ */
+static NTSTATUS streams_xattr_load_index(vfs_handle_struct *handle,
+					 TALLOC_CTX *mem_ctx,
+					 files_struct *fsp,
+					 const char *fname,
+					 char ***pnames,
+					 size_t *pnum_names)
+{
+	NTSTATUS status;
+	struct ea_struct ea;
+	char **names = NULL;
+	size_t num_names = 0;
+	const char *p, *end;
+
+	status = get_ea_value(talloc_tos(), handle->conn, fsp, fname,
+			      SAMBA_XATTR_STREAM_INDEX, &ea);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	if ((ea.value.length == 0) ||
+	    (ea.value.data[ea.value.length-1] != '\0')) {
+		DEBUG(1, ("stream index on file %s is corrupt\n", fname));
+		TALLOC_FREE(ea.value.data);
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	end = (char *)ea.value.data + ea.value.length;
+
+	for (p = (char *)ea.value.data; p < end; p += strlen(p) + 1) {
+		char **tmp;
+
+		if (*p == '\0') {
+			/* an empty index is a single null byte */
+			continue;
+		}
+
+		tmp = talloc_realloc(mem_ctx, names, char *, num_names+1);
+		if (tmp == NULL) {
+			goto nomem;
+		}
+		names = tmp;
+
+		names[num_names] = talloc_strdup(names, p);
+		if (names[num_names] == NULL) {
+			goto nomem;
+		}
+		num_names += 1;
+	}
+
+	TALLOC_FREE(ea.value.data);
+	*pnames = names;
+	*pnum_names = num_names;
+	return NT_STATUS_OK;
+
+ nomem:
+	TALLOC_FREE(ea.value.data);
+	TALLOC_FREE(names);
+	return NT_STATUS_NO_MEMORY;
+}
+
+/**
+ * Write the stream index xattr from an array of xattr names.
+ */
+static NTSTATUS streams_xattr_save_index(vfs_handle_struct *handle,
+					 files_struct *fsp,
+					 const char *fname,
+					 char **names,
+					 size_t num_names)
+{
+	char *blob;
+	size_t i, len = 0;
+	int ret;
+
+	for (i=0; i<num_names; i++) {
+		len += strlen(names[i]) + 1;
+	}
+
+	if (len == 0) {
+		/* Darn, xattrs need at least 1 byte */
+		len = 1;
+	}
+
+	blob = talloc_zero_array(talloc_tos(), char, len);
+	if (blob == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	len = 0;
+	for (i=0; i<num_names; i++) {
+		size_t thislen = strlen(names[i]) + 1;
+		memcpy(blob + len, names[i], thislen);
+		len += thislen;
+	}
+	if (len == 0) {
+		len = 1;
+	}
+
+	if (fsp != NULL && fsp->fh->fd != -1) {
+		ret = SMB_VFS_FSETXATTR(fsp, SAMBA_XATTR_STREAM_INDEX,
+					blob, len, 0);
+	} else {
+		ret = SMB_VFS_SETXATTR(handle->conn, fname,
+				       SAMBA_XATTR_STREAM_INDEX,
+				       blob, len, 0);
+	}
+
+	TALLOC_FREE(blob);
+
+	if (ret == -1) {
+		return map_nt_error_from_unix(errno);
+	}
+	return NT_STATUS_OK;
+}
+
+/**
+ * Throw away the index of a file. Harmless - the next streaminfo
+ * rebuilds it from a full xattr listing.
+ */
+static void streams_xattr_drop_index(vfs_handle_struct *handle,
+				     const char *fname)
+{
+	SMB_VFS_REMOVEXATTR(handle->conn, fname, SAMBA_XATTR_STREAM_INDEX);
+}
+
+/**
+ * Enter a new stream xattr name into the index. Called *before* the
+ * stream xattr is created, so that a failure in between leaves at
+ * worst a stale entry, which the read side weeds out, and never a
+ * missing one.
+ */
+static void streams_xattr_index_add(vfs_handle_struct *handle,
+				    files_struct *fsp,
+				    const char *fname,
+				    const char *xattr_name)
+{
+	NTSTATUS status;
+	struct streams_xattr_config *config;
+	char **names = NULL;
+	char **tmp;
+	size_t i, num_names = 0;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config, struct streams_xattr_config,
+				return);
+
+	if (!config->use_index) {
+		return;
+	}
+
+	status = streams_xattr_load_index(handle, talloc_tos(), fsp, fname,
+					  &names, &num_names);
+	if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+		/*
+		 * Not indexed yet. Don't create a partial index here,
+		 * the file may carry streams from before the index
+		 * was switched on. streaminfo builds the full one.
+		 */
+		return;
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		streams_xattr_drop_index(handle, fname);
+		return;
+	}
+
+	for (i=0; i<num_names; i++) {
+		if (strcmp(names[i], xattr_name) == 0) {
+			TALLOC_FREE(names);
+			return;
+		}
+	}
+
+	tmp = talloc_realloc(talloc_tos(), names, char *, num_names+1);
+	if (tmp == NULL) {
+		TALLOC_FREE(names);
+		streams_xattr_drop_index(handle, fname);
+		return;
+	}
+	names = tmp;
+
+	names[num_names] = talloc_strdup(names, xattr_name);
+	if (names[num_names] == NULL) {
+		TALLOC_FREE(names);
+		streams_xattr_drop_index(handle, fname);
+		return;
+	}
+	num_names += 1;
+
+	status = streams_xattr_save_index(handle, fsp, fname, names,
+					  num_names);
+	if (!NT_STATUS_IS_OK(status)) {
+		streams_xattr_drop_index(handle, fname);
+	}
+	TALLOC_FREE(names);
+}
+
+/**
+ * Remove a stream xattr name from the index, after the stream xattr
+ * itself is gone.
+ */
+static void streams_xattr_index_remove(vfs_handle_struct *handle,
+				       const char *fname,
+				       const char *xattr_name)
+{
+	NTSTATUS status;
+	struct streams_xattr_config *config;
+	char **names = NULL;
+	size_t i, num_names = 0;
+	bool found = false;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config, struct streams_xattr_config,
+				return);
+
+	if (!config->use_index) {
+		return;
+	}
+
+	status = streams_xattr_load_index(handle, talloc_tos(), NULL, fname,
+					  &names, &num_names);
+	if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+		return;
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		streams_xattr_drop_index(handle, fname);
+		return;
+	}
+
+	for (i=0; i<num_names; i++) {
+		if (strcmp(names[i], xattr_name) == 0) {
+			names[i] = names[num_names-1];
+			num_names -= 1;
+			found = true;
+			break;
+		}
+	}
+
+	if (!found) {
+		TALLOC_FREE(names);
+		return;
+	}
+
+	status = streams_xattr_save_index(handle, NULL, fname, names,
+					  num_names);
+	if (!NT_STATUS_IS_OK(status)) {
+		streams_xattr_drop_index(handle, fname);
+	}
+	TALLOC_FREE(names);
+}
+
 static bool streams_xattr_recheck(struct stream_io *sio)
 {
 	NTSTATUS status;
@@ -494,6 +761,13 @@ static int streams_xattr_open(vfs_handle_struct *handle,
 		DEBUG(10, ("creating or truncating attribute %s on file %s\n",
 			   xattr_name, smb_fname->base_name));
 
+		if (!NT_STATUS_IS_OK(status)) {
+			/* About to create a new stream, index it first. */
+			streams_xattr_index_add(handle, fsp->base_fsp,
+						smb_fname->base_name,
+						xattr_name);
+		}
+
 		if (fsp->base_fsp->fh->fd != -1) {
 			if (SMB_VFS_FSETXATTR(
 					fsp->base_fsp, xattr_name,
@@ -588,6 +862,8 @@ static int streams_xattr_unlink(vfs_handle_struct *handle,
 		goto fail;
 	}
 
+	streams_xattr_index_remove(handle, smb_fname->base_name, xattr_name);
+
 	ret = 0;
 
  fail:
@@ -653,6 +929,10 @@ static int streams_xattr_rename(vfs_handle_struct *handle,
 		goto fail;
 	}
 
+	/* the new name goes into the index before the stream appears */
+	streams_xattr_index_add(handle, NULL, smb_fname_src->base_name,
+				dst_xattr_name);
+
 	/* (over)write the new stream */
 	nret = SMB_VFS_SETXATTR(handle->conn, smb_fname_src->base_name,
 				dst_xattr_name, ea.value.data, ea.value.length,
@@ -674,6 +954,9 @@ static int streams_xattr_rename(vfs_handle_struct *handle,
 		goto fail;
 	}
 
+	streams_xattr_index_remove(handle, smb_fname_src->base_name,
+				   src_xattr_name);
+
  done:
 	errno = 0;
 	ret = 0;
@@ -706,6 +989,10 @@ static NTSTATUS walk_xattr_streams(vfs_handle_struct *handle, files_struct *fsp,
 	for (i=0; i<num_names; i++) {
 		struct ea_struct ea;
 
+		if (strcmp(names[i], SAMBA_XATTR_STREAM_INDEX) == 0) {
+			continue;
+		}
+
 		/*
 		 * We want to check with samba_private_attr_name()
 		 * whether the xattr name is a private one,
@@ -758,6 +1045,159 @@ static NTSTATUS walk_xattr_streams(vfs_handle_struct *handle, files_struct *fsp,
 	return NT_STATUS_OK;
 }
 
+/**
+ * Like walk_xattr_streams, but driven by the stream index instead of
+ * a full xattr listing. Entries whose xattr has vanished are skipped
+ * and compacted away. Returns NT_STATUS_NOT_FOUND if the file has no
+ * usable index, the caller then has to do the full walk.
+ */
+static NTSTATUS walk_stream_index(vfs_handle_struct *handle,
+				  files_struct *fsp,
+				  const char *fname,
+				  bool (*fn)(struct ea_struct *ea,
+					     void *private_data),
+				  void *private_data)
+{
+	NTSTATUS status;
+	char **names = NULL;
+	size_t i, num_names = 0;
+	size_t kept = 0;
+	struct streams_xattr_config *config;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config, struct streams_xattr_config,
+				return NT_STATUS_UNSUCCESSFUL);
+
+	status = streams_xattr_load_index(handle, talloc_tos(), fsp, fname,
+					  &names, &num_names);
+	if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+		return status;
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		streams_xattr_drop_index(handle, fname);
+		return NT_STATUS_NOT_FOUND;
+	}
+
+	for (i=0; i<num_names; i++) {
+		struct ea_struct ea;
+
+		if (strncmp(names[i], config->prefix,
+			    config->prefix_len) != 0) {
+			/* stale entry from another prefix setting */
+			continue;
+		}
+
+		status = get_ea_value(names, handle->conn, fsp, fname,
+				      names[i], &ea);
+		if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+			/* the stream is gone, compact the index */
+			continue;
+		}
+		if (!NT_STATUS_IS_OK(status)) {
+			DEBUG(10, ("Could not get ea %s for file %s: %s\n",
+				   names[i], fname, nt_errstr(status)));
+			names[kept++] = names[i];
+			continue;
+		}
+
+		names[kept++] = names[i];
+
+		ea.name = talloc_asprintf(
+			ea.value.data, ":%s%s",
+			names[i] + config->prefix_len,
+			config->store_stream_type ? "" : ":$DATA");
+		if (ea.name == NULL) {
+			DEBUG(0, ("talloc failed\n"));
+			continue;
+		}
+
+		if (!fn(&ea, private_data)) {
+			TALLOC_FREE(ea.value.data);
+			TALLOC_FREE(names);
+			return NT_STATUS_OK;
+		}
+
+		TALLOC_FREE(ea.value.data);
+	}
+
+	if (kept != num_names) {
+		status = streams_xattr_save_index(handle, fsp, fname,
+						  names, kept);
+		if (!NT_STATUS_IS_OK(status)) {
+			streams_xattr_drop_index(handle, fname);
+		}
+	}
+
+	TALLOC_FREE(names);
+	return NT_STATUS_OK;
+}
+
+/**
+ * Build the stream index of a file from a full xattr listing. This is
+ * how files predating the index get migrated: the first streaminfo
+ * falls back to the listing and leaves an index behind.
+ */
+static void streams_xattr_rebuild_index(vfs_handle_struct *handle,
+					files_struct *fsp,
+					const char *fname)
+{
+	NTSTATUS status;
+	char **names;
+	char **index_names = NULL;
+	size_t i, num_names = 0;
+	size_t num_index_names = 0;
+	struct streams_xattr_config *config;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config, struct streams_xattr_config,
+				return);
+
+	status = get_ea_names_from_file(talloc_tos(), handle->conn, fsp, fname,
+					&names, &num_names);
+	if (!NT_STATUS_IS_OK(status)) {
+		return;
+	}
+
+	for (i=0; i<num_names; i++) {
+		char **tmp;
+
+		if (strcmp(names[i], SAMBA_XATTR_STREAM_INDEX) == 0) {
+			continue;
+		}
+
+		/* same filter as walk_xattr_streams */
+		if (strncasecmp_m(names[i], SAMBA_XATTR_DOSSTREAM_PREFIX,
+				  strlen(SAMBA_XATTR_DOSSTREAM_PREFIX)) != 0) {
+			if (samba_private_attr_name(names[i])) {
+				continue;
+			}
+		}
+
+		if (strncmp(names[i], config->prefix,
+			    config->prefix_len) != 0) {
+			continue;
+		}
+
+		tmp = talloc_realloc(talloc_tos(), index_names, char *,
+				     num_index_names+1);
+		if (tmp == NULL) {
+			goto out;
+		}
+		index_names = tmp;
+		index_names[num_index_names] = names[i];
+		num_index_names += 1;
+	}
+
+	status = streams_xattr_save_index(handle, fsp, fname, index_names,
+					  num_index_names);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(10, ("could not write stream index on %s: %s\n",
+			   fname, nt_errstr(status)));
+	}
+
+ out:
+	TALLOC_FREE(index_names);
+	TALLOC_FREE(names);
+}
+
 static bool add_one_stream(TALLOC_CTX *mem_ctx, unsigned int *num_streams,
 			   struct stream_struct **streams,
 			   const char *name, off_t size,
@@ -820,6 +1260,10 @@ static NTSTATUS streams_xattr_streaminfo(vfs_handle_struct *handle,
 	int ret;
 	NTSTATUS status;
 	struct streaminfo_state state;
+	struct streams_xattr_config *config;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config, struct streams_xattr_config,
+				return NT_STATUS_UNSUCCESSFUL);
 
 	if ((fsp != NULL) && (fsp->fh->fd != -1)) {
 		ret = SMB_VFS_FSTAT(fsp, &sbuf);
@@ -860,8 +1304,19 @@ static NTSTATUS streams_xattr_streaminfo(vfs_handle_struct *handle,
 		 */
 		status = NT_STATUS_OK;
 	} else {
-		status = walk_xattr_streams(handle, fsp, fname,
-				    collect_one_stream, &state);
+		status = NT_STATUS_NOT_FOUND;
+		if (config->use_index) {
+			status = walk_stream_index(handle, fsp, fname,
+					    collect_one_stream, &state);
+		}
+		if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+			status = walk_xattr_streams(handle, fsp, fname,
+					    collect_one_stream, &state);
+			if (config->use_index && NT_STATUS_IS_OK(status)) {
+				streams_xattr_rebuild_index(handle, fsp,
+							    fname);
+			}
+		}
 	}
 
 	if (!NT_STATUS_IS_OK(status)) {
@@ -923,6 +1378,16 @@ static int streams_xattr_connect(vfs_handle_struct *handle,
 						 "store_stream_type",
 						 true);
 
+	/*
+	 * Off by default: writers not maintaining the index (older
+	 * smbds, local tools) would make it lie about the streams on
+	 * a file.
+	 */
+	config->use_index = lp_parm_bool(SNUM(handle->conn),
+					 "streams_xattr",
+					 "index",
+					 false);
+
 	SMB_VFS_HANDLE_SET_DATA(handle, config,
 				NULL, struct stream_xattr_config,
 				return -1);
@@ -27,6 +27,7 @@
 
 #include "includes.h"
 #include "smbd/smbd.h"
+#include "system/filesys.h"
 #include "ntioctl.h"
 #include "lib/util/tevent_unix.h"
 #include "lib/util/tevent_ntstatus.h"
@@ -34,11 +35,26 @@
 #undef DBGC_CLASS
 #define DBGC_CLASS DBGC_VFS
 
+#include "modules/audit_ringbuf.c"
+
 static double audit_timeout;
+static struct audit_ringbuf *audit_ringbuf;
 
 static void smb_time_audit_log_msg(const char *syscallname, double elapsed,
 				    const char *msg)
 {
+	if (audit_ringbuf != NULL) {
+		char *line = talloc_asprintf(talloc_tos(),
+					     "%s|%.9f|%s",
+					     syscallname, elapsed,
+					     (msg != NULL) ? msg : "");
+		if (line != NULL) {
+			audit_ringbuf_write(audit_ringbuf, line);
+			TALLOC_FREE(line);
+			return;
+		}
+	}
+
 	DEBUG(0, ("WARNING: VFS call \"%s\" took unexpectedly long "
 		  "(%.2f seconds) %s%s-- Validate that file and storage "
 		  "subsystems are operating normally\n", syscallname,
@@ -126,11 +142,28 @@ static int smb_time_audit_connect(vfs_handle_struct *handle,
 	int result;
 	struct timespec ts1,ts2;
 	double timediff;
+	const char *ringbuf_dir = NULL;
 
 	if (!handle) {
 		return -1;
 	}
 
+	ringbuf_dir = lp_parm_const_string(SNUM(handle->conn), "time_audit",
+					   "ringbuf dir", NULL);
+	if ((ringbuf_dir != NULL) && (audit_ringbuf == NULL)) {
+		/* one ring per smbd process, kept for its lifetime */
+		audit_ringbuf = audit_ringbuf_open(
+			NULL, ringbuf_dir,
+			lp_parm_int(SNUM(handle->conn), "time_audit",
+				    "ringbuf size",
+				    AUDIT_RINGBUF_DEFAULT_SIZE));
+		if (audit_ringbuf == NULL) {
+			DEBUG(1, ("%s: cannot set up audit ring buffer "
+				  "in %s, falling back to the debug log\n",
+				  __func__, ringbuf_dir));
+		}
+	}
+
 	clock_gettime_mono(&ts1);
 	result = SMB_VFS_NEXT_CONNECT(handle, svc, user);
 	clock_gettime_mono(&ts2);
@@ -1066,6 +1099,26 @@ static int smb_time_audit_lstat(vfs_handle_struct *handle,
 	return result;
 }
 
+static int smb_time_audit_stat_batch(vfs_handle_struct *handle,
+				     unsigned int num_entries,
+				     struct smb_filename **smb_fnames)
+{
+	int result;
+	struct timespec ts1,ts2;
+	double timediff;
+
+	clock_gettime_mono(&ts1);
+	result = SMB_VFS_NEXT_STAT_BATCH(handle, num_entries, smb_fnames);
+	clock_gettime_mono(&ts2);
+	timediff = nsec_time_diff(&ts2,&ts1)*1.0e-9;
+
+	if (timediff > audit_timeout) {
+		smb_time_audit_log("stat_batch", timediff);
+	}
+
+	return result;
+}
+
 static uint64_t smb_time_audit_get_alloc_size(vfs_handle_struct *handle,
 					      files_struct *fsp,
 					      const SMB_STRUCT_STAT *sbuf)
@@ -1256,6 +1309,28 @@ static int smb_time_audit_ntimes(vfs_handle_struct *handle,
 	return result;
 }
 
+static int smb_time_audit_ntimes_batch(vfs_handle_struct *handle,
+				       unsigned int num_entries,
+				       struct smb_filename **smb_fnames,
+				       struct smb_file_time *fts)
+{
+	int result;
+	struct timespec ts1,ts2;
+	double timediff;
+
+	clock_gettime_mono(&ts1);
+	result = SMB_VFS_NEXT_NTIMES_BATCH(handle, num_entries,
+					   smb_fnames, fts);
+	clock_gettime_mono(&ts2);
+	timediff = nsec_time_diff(&ts2,&ts1)*1.0e-9;
+
+	if (timediff > audit_timeout) {
+		smb_time_audit_log("ntimes_batch", timediff);
+	}
+
+	return result;
+}
+
 static int smb_time_audit_ftruncate(vfs_handle_struct *handle,
 				    files_struct *fsp,
 				    off_t len)
@@ -1799,6 +1874,90 @@ static NTSTATUS smb_time_audit_copy_chunk_recv(struct vfs_handle_struct *handle,
 	return NT_STATUS_OK;
 }
 
+struct time_audit_hash_state {
+	struct timespec ts_send;
+	struct vfs_handle_struct *handle;
+	uint8_t digest[64];
+	off_t hashed;
+};
+static void smb_time_audit_hash_file_done(struct tevent_req *subreq);
+
+static struct tevent_req *smb_time_audit_hash_file_send(struct vfs_handle_struct *handle,
+							TALLOC_CTX *mem_ctx,
+							struct tevent_context *ev,
+							struct files_struct *fsp,
+							off_t offset,
+							off_t num)
+{
+	struct tevent_req *req;
+	struct tevent_req *subreq;
+	struct time_audit_hash_state *hash_state;
+
+	req = tevent_req_create(mem_ctx, &hash_state,
+				struct time_audit_hash_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	hash_state->handle = handle;
+	clock_gettime_mono(&hash_state->ts_send);
+	subreq = SMB_VFS_NEXT_HASH_FILE_SEND(handle, hash_state, ev,
+					     fsp, offset, num);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	tevent_req_set_callback(subreq, smb_time_audit_hash_file_done, req);
+	return req;
+}
+
+static void smb_time_audit_hash_file_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct time_audit_hash_state *hash_state
+			= tevent_req_data(req, struct time_audit_hash_state);
+	NTSTATUS status;
+
+	status = SMB_VFS_NEXT_HASH_FILE_RECV(hash_state->handle,
+					     subreq,
+					     hash_state->digest,
+					     &hash_state->hashed);
+	TALLOC_FREE(subreq);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+	tevent_req_done(req);
+}
+
+static NTSTATUS smb_time_audit_hash_file_recv(struct vfs_handle_struct *handle,
+					      struct tevent_req *req,
+					      uint8_t digest[64],
+					      off_t *hashed)
+{
+	struct time_audit_hash_state *hash_state
+			= tevent_req_data(req, struct time_audit_hash_state);
+	struct timespec ts_recv;
+	double timediff;
+	NTSTATUS status;
+
+	clock_gettime_mono(&ts_recv);
+	timediff = nsec_time_diff(&ts_recv, &hash_state->ts_send)*1.0e-9;
+	if (timediff > audit_timeout) {
+		smb_time_audit_log("hash_file", timediff);
+	}
+
+	memcpy(digest, hash_state->digest, sizeof(hash_state->digest));
+	*hashed = hash_state->hashed;
+	if (tevent_req_is_nterror(req, &status)) {
+		tevent_req_received(req);
+		return status;
+	}
+
+	tevent_req_received(req);
+	return NT_STATUS_OK;
+}
+
 static NTSTATUS smb_time_audit_get_compression(vfs_handle_struct *handle,
 					       TALLOC_CTX *mem_ctx,
 					       struct files_struct *fsp,
@@ -2458,6 +2617,7 @@ static struct vfs_fn_pointers vfs_time_audit_fns = {
 	.stat_fn = smb_time_audit_stat,
 	.fstat_fn = smb_time_audit_fstat,
 	.lstat_fn = smb_time_audit_lstat,
+	.stat_batch_fn = smb_time_audit_stat_batch,
 	.get_alloc_size_fn = smb_time_audit_get_alloc_size,
 	.unlink_fn = smb_time_audit_unlink,
 	.chmod_fn = smb_time_audit_chmod,
@@ -2468,6 +2628,7 @@ static struct vfs_fn_pointers vfs_time_audit_fns = {
 	.chdir_fn = smb_time_audit_chdir,
 	.getwd_fn = smb_time_audit_getwd,
 	.ntimes_fn = smb_time_audit_ntimes,
+	.ntimes_batch_fn = smb_time_audit_ntimes_batch,
 	.ftruncate_fn = smb_time_audit_ftruncate,
 	.fallocate_fn = smb_time_audit_fallocate,
 	.lock_fn = smb_time_audit_lock,
@@ -2492,6 +2653,8 @@ static struct vfs_fn_pointers vfs_time_audit_fns = {
 	.translate_name_fn = smb_time_audit_translate_name,
 	.copy_chunk_send_fn = smb_time_audit_copy_chunk_send,
 	.copy_chunk_recv_fn = smb_time_audit_copy_chunk_recv,
+	.hash_file_send_fn = smb_time_audit_hash_file_send,
+	.hash_file_recv_fn = smb_time_audit_hash_file_recv,
 	.get_compression_fn = smb_time_audit_get_compression,
 	.set_compression_fn = smb_time_audit_set_compression,
 	.readdir_attr_fn = smb_time_audit_readdir_attr,
@@ -594,22 +594,24 @@ bool initialise_wins(void)
 	time_t time_now = time(NULL);
 	XFILE *fp;
 	char line[1024];
-	char *db_path;
 	char *list_path;
 
 	if(!lp_we_are_a_wins_server()) {
 		return True;
 	}
 
-	db_path = state_path("wins.tdb");
-	if (db_path == NULL) {
-		return false;
-	}
-
-	/* Open the wins.tdb. */
-	wins_tdb = tdb_open_log(db_path, 0, TDB_DEFAULT|TDB_CLEAR_IF_FIRST|TDB_INCOMPATIBLE_HASH,
+	/*
+	 * The name index is kept fully in memory: it was opened with
+	 * TDB_CLEAR_IF_FIRST anyway and is rebuilt from the wins.dat
+	 * list below on every start, so an on-disk tdb bought no
+	 * durability, just page cache traffic during registration
+	 * storms. Persistence stays with wins.dat, which
+	 * wins_write_database() dumps from a forked child (fork gives
+	 * that child a consistent copy-on-write snapshot of this tdb).
+	 */
+	wins_tdb = tdb_open_log("wins.tdb", 0,
+			TDB_INTERNAL|TDB_INCOMPATIBLE_HASH,
 			O_CREAT|O_RDWR, 0600);
-	TALLOC_FREE(db_path);
 	if (!wins_tdb) {
 		DEBUG(0,("initialise_wins: failed to open wins.tdb. Error was %s\n",
 			strerror(errno) ));
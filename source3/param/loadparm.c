@@ -801,6 +801,7 @@ static void init_globals(struct loadparm_context *lp_ctx, bool reinit_globals)
 	Globals.ctdb_locktime_warn_threshold = 0;
 
 	Globals.winbind_cache_time = 300;	/* 5 minutes */
+	Globals.winbind_cache_stale_time = 0;	/* no serving of expired entries */
 	Globals.winbind_reconnect_delay = 30;	/* 30 seconds */
 	Globals.winbind_request_timeout = 60;   /* 60 seconds */
 	Globals.winbind_max_clients = 200;
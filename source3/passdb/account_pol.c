@@ -1,7 +1,7 @@
 /*
  *  Unix SMB/CIFS implementation.
  *  account policy storage
- *  Copyright (C) Jean Fran�ois Micouleau      1998-2001.
+ *  Copyright (C) Jean Fran�ois Micouleau      1998-2001.
  *  Copyright (C) Andrew Bartlett              2002
  *  Copyright (C) Guenther Deschner            2004-2005
  *
@@ -225,13 +225,13 @@ bool init_account_policy(void)
 		return false;
 	}
 
-	db = db_open(NULL, db_path, 0, TDB_DEFAULT,
+	db = db_open(NULL, db_path, 0, TDB_SEQNUM,
 		     O_RDWR, 0600, DBWRAP_LOCK_ORDER_1, DBWRAP_FLAG_NONE);
 
 	if (db == NULL) { /* the account policies files does not exist or open
 			   * failed, try to create a new one */
 		db = db_open(NULL, db_path, 0,
-			     TDB_DEFAULT, O_RDWR|O_CREAT, 0600,
+			     TDB_SEQNUM, O_RDWR|O_CREAT, 0600,
 			     DBWRAP_LOCK_ORDER_1, DBWRAP_FLAG_NONE);
 		if (db == NULL) {
 			DEBUG(0,("Failed to open account policy database\n"));
@@ -185,8 +185,6 @@ static struct dom_sid *pdb_generate_sam_sid(void)
 /* return our global_sam_sid */
 struct dom_sid *get_global_sam_sid(void)
 {
-	struct db_context *db;
-
 	if (global_sam_sid != NULL)
 		return global_sam_sid;
 
@@ -199,21 +197,16 @@ struct dom_sid *get_global_sam_sid(void)
 	 *       can happen with some dbwrap backends
 	 */
 
-	db = secrets_db_ctx();
-	if (!db) {
-		smb_panic("could not open secrets db");
-	}
-
-	if (dbwrap_transaction_start(db) != 0) {
+	if (secrets_transaction_start() != 0) {
 		smb_panic("could not start transaction on secrets db");
 	}
 
 	if (!(global_sam_sid = pdb_generate_sam_sid())) {
-		dbwrap_transaction_cancel(db);
+		secrets_transaction_cancel();
 		smb_panic("could not generate a machine SID");
 	}
 
-	if (dbwrap_transaction_commit(db) != 0) {
+	if (secrets_transaction_commit() != 0) {
 		smb_panic("could not start commit secrets db");
 	}
 
@@ -323,14 +323,64 @@ static bool pdb_try_account_unlock(struct samu *sampass)
  *
  * @return               True on success, false on error.
  */
-bool pdb_getsampwnam(struct samu *sam_acct, const char *username) 
+bool pdb_getsampwnam(struct samu *sam_acct, const char *username)
 {
 	struct pdb_methods *pdb = pdb_get_methods();
 	struct samu *for_cache;
 	const struct dom_sid *user_sid;
+	struct dom_sid mapped_sid;
+	fstring name_key;
+	DATA_BLOB cache_blob;
 	NTSTATUS status;
 	bool ok;
 
+	fstrcpy(name_key, username);
+	if (!strlower_m(name_key)) {
+		return false;
+	}
+
+	/*
+	 * A cached name->SID mapping lets us serve the lookup from the
+	 * account cache instead of unpacking the full record in the
+	 * backend again.
+	 */
+	if (memcache_lookup(NULL, PDB_GETPWNAM_CACHE,
+			    data_blob_const(name_key, strlen(name_key)),
+			    &cache_blob) &&
+	    (cache_blob.length == sizeof(mapped_sid))) {
+		void *cache_data;
+
+		memcpy(&mapped_sid, cache_blob.data, sizeof(mapped_sid));
+
+		cache_data = memcache_lookup_talloc(
+			NULL, PDB_GETPWSID_CACHE,
+			data_blob_const(&mapped_sid, sizeof(mapped_sid)));
+
+		if (cache_data != NULL) {
+			struct samu *cache_copy = talloc_get_type_abort(
+				cache_data, struct samu);
+
+			/*
+			 * Make sure the mapping did not survive a
+			 * rename that recycled the SID cache entry.
+			 */
+			if (strequal(pdb_get_username(cache_copy),
+				     name_key) &&
+			    pdb_copy_sam_account(sam_acct, cache_copy)) {
+				ok = pdb_try_account_unlock(sam_acct);
+				if (!ok) {
+					DEBUG(1, ("pdb_getsampwnam: Failed "
+						  "to unlock account %s\n",
+						  username));
+				}
+				return true;
+			}
+		}
+
+		memcache_delete(NULL, PDB_GETPWNAM_CACHE,
+				data_blob_const(name_key, strlen(name_key)));
+	}
+
 	status = pdb->getsampwnam(pdb, sam_acct, username);
 	if (!NT_STATUS_IS_OK(status)) {
 		return false;
@@ -358,6 +408,10 @@ bool pdb_getsampwnam(struct samu *sam_acct, const char *username)
 			    data_blob_const(user_sid, sizeof(*user_sid)),
 			    &for_cache);
 
+	memcache_add(NULL, PDB_GETPWNAM_CACHE,
+		     data_blob_const(name_key, strlen(name_key)),
+		     data_blob_const(user_sid, sizeof(*user_sid)));
+
 	return True;
 }
 
@@ -611,6 +665,18 @@ static NTSTATUS pdb_default_delete_user(struct pdb_methods *methods,
 	return status;
 }
 
+static void pdb_delete_getpwnam_cache_entry(const char *username)
+{
+	fstring name_key;
+
+	fstrcpy(name_key, username);
+	if (!strlower_m(name_key)) {
+		return;
+	}
+	memcache_delete(NULL, PDB_GETPWNAM_CACHE,
+			data_blob_const(name_key, strlen(name_key)));
+}
+
 NTSTATUS pdb_delete_user(TALLOC_CTX *mem_ctx, struct samu *sam_acct)
 {
 	struct pdb_methods *pdb = pdb_get_methods();
@@ -634,6 +700,7 @@ NTSTATUS pdb_delete_user(TALLOC_CTX *mem_ctx, struct samu *sam_acct)
 	memcache_delete(NULL,
 			PDB_GETPWSID_CACHE,
 			data_blob_const(user_sid, sizeof(*user_sid)));
+	pdb_delete_getpwnam_cache_entry(pdb_get_username(sam_acct));
 
 	status = pdb->delete_user(pdb, mem_ctx, sam_acct);
 	if (!NT_STATUS_IS_OK(status)) {
@@ -668,6 +735,7 @@ NTSTATUS pdb_update_sam_account(struct samu *sam_acct)
 	struct pdb_methods *pdb = pdb_get_methods();
 
 	memcache_flush(NULL, PDB_GETPWSID_CACHE);
+	memcache_flush(NULL, PDB_GETPWNAM_CACHE);
 
 	return pdb->update_sam_account(pdb, sam_acct);
 }
@@ -680,6 +748,7 @@ NTSTATUS pdb_delete_sam_account(struct samu *sam_acct)
 	memcache_delete(NULL,
 			PDB_GETPWSID_CACHE,
 			data_blob_const(user_sid, sizeof(*user_sid)));
+	pdb_delete_getpwnam_cache_entry(pdb_get_username(sam_acct));
 
 	return pdb->delete_sam_account(pdb, sam_acct);
 }
@@ -691,6 +760,7 @@ NTSTATUS pdb_rename_sam_account(struct samu *oldname, const char *newname)
 	NTSTATUS status;
 
 	memcache_flush(NULL, PDB_GETPWSID_CACHE);
+	memcache_flush(NULL, PDB_GETPWNAM_CACHE);
 
 	/* sanity check to make sure we don't rename root */
 
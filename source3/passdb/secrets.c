@@ -77,7 +77,7 @@ bool secrets_init_path(const char *private_dir)
 	}
 
 	db_ctx = db_open(NULL, fname, 0,
-			 TDB_DEFAULT, O_RDWR|O_CREAT, 0600,
+			 TDB_SEQNUM, O_RDWR|O_CREAT, 0600,
 			 DBWRAP_LOCK_ORDER_1, DBWRAP_FLAG_NONE);
 
 	if (db_ctx == NULL) {
@@ -116,11 +116,147 @@ struct db_context *secrets_db_ctx(void)
 	return db_ctx;
 }
 
+/*
+ * Count of open transactions on secrets.tdb. While a transaction is
+ * running the fetch cache below stands aside: reads inside the
+ * transaction have to see uncommitted changes, and entries read there
+ * must not survive a possible transaction cancel.
+ */
+static int secrets_transactions_active;
+
+int secrets_transaction_start(void)
+{
+	int ret;
+
+	if (!secrets_init()) {
+		return -1;
+	}
+
+	ret = dbwrap_transaction_start(db_ctx);
+	if (ret == 0) {
+		secrets_transactions_active++;
+	}
+	return ret;
+}
+
+int secrets_transaction_commit(void)
+{
+	secrets_transactions_active--;
+	return dbwrap_transaction_commit(db_ctx);
+}
+
+int secrets_transaction_cancel(void)
+{
+	secrets_transactions_active--;
+	return dbwrap_transaction_cancel(db_ctx);
+}
+
+/*
+ * Process-local cache of secrets.tdb records, stamped with the tdb
+ * sequence number they were read under. Every write to secrets.tdb
+ * bumps the seqnum, so a matching stamp proves an entry is still
+ * current no matter which process wrote last. Machine account
+ * credentials get fetched for every netlogon setup, so this keeps the
+ * hot auth path off the tdb. Entries with a NULL value remember that
+ * a key does not exist.
+ */
+
+#define SECRETS_FETCH_CACHE_MAX_ENTRIES 32
+
+struct secrets_fetch_cache_entry {
+	struct secrets_fetch_cache_entry *prev, *next;
+	char *key;
+	int seqnum;
+	TDB_DATA value;
+};
+
+static struct secrets_fetch_cache_entry *secrets_fetch_cache;
+static int secrets_fetch_cache_count;
+
+static void secrets_fetch_cache_zap(struct secrets_fetch_cache_entry *e)
+{
+	DLIST_REMOVE(secrets_fetch_cache, e);
+	secrets_fetch_cache_count--;
+	if (e->value.dptr != NULL) {
+		memset(e->value.dptr, '\0', e->value.dsize);
+	}
+	TALLOC_FREE(e);
+}
+
+static bool secrets_fetch_cache_lookup(const char *key, TDB_DATA *value)
+{
+	struct secrets_fetch_cache_entry *e;
+
+	if (secrets_transactions_active != 0) {
+		return false;
+	}
+
+	for (e = secrets_fetch_cache; e != NULL; e = e->next) {
+		if (strcmp(e->key, key) == 0) {
+			break;
+		}
+	}
+	if (e == NULL) {
+		return false;
+	}
+
+	if (e->seqnum != dbwrap_get_seqnum(db_ctx)) {
+		secrets_fetch_cache_zap(e);
+		return false;
+	}
+
+	*value = e->value;
+	DLIST_PROMOTE(secrets_fetch_cache, e);
+	return true;
+}
+
+static void secrets_fetch_cache_store(const char *key, TDB_DATA value,
+				      int seqnum)
+{
+	struct secrets_fetch_cache_entry *e;
+
+	if (secrets_transactions_active != 0) {
+		return;
+	}
+
+	e = talloc_zero(NULL, struct secrets_fetch_cache_entry);
+	if (e == NULL) {
+		return;
+	}
+
+	e->key = talloc_strdup(e, key);
+	if (e->key == NULL) {
+		TALLOC_FREE(e);
+		return;
+	}
+	e->seqnum = seqnum;
+
+	if (value.dptr != NULL) {
+		e->value.dptr = (uint8_t *)talloc_memdup(e, value.dptr,
+							 value.dsize);
+		if (e->value.dptr == NULL) {
+			TALLOC_FREE(e);
+			return;
+		}
+		e->value.dsize = value.dsize;
+	}
+
+	while (secrets_fetch_cache_count >= SECRETS_FETCH_CACHE_MAX_ENTRIES) {
+		secrets_fetch_cache_zap(DLIST_TAIL(secrets_fetch_cache));
+	}
+
+	DLIST_ADD(secrets_fetch_cache, e);
+	secrets_fetch_cache_count++;
+}
+
 /*
  * close secrets.tdb
  */
 void secrets_shutdown(void)
 {
+	while (secrets_fetch_cache != NULL) {
+		secrets_fetch_cache_zap(secrets_fetch_cache);
+	}
 	TALLOC_FREE(db_ctx);
 }
 
@@ -132,17 +268,41 @@ void *secrets_fetch(const char *key, size_t *size)
 	TDB_DATA dbuf;
 	void *result;
 	NTSTATUS status;
+	int seqnum;
 
 	if (!secrets_init()) {
 		return NULL;
 	}
 
+	if (secrets_fetch_cache_lookup(key, &dbuf)) {
+		if (dbuf.dptr == NULL) {
+			/* cached negative result */
+			return NULL;
+		}
+		result = smb_memdup(dbuf.dptr, dbuf.dsize);
+		if (result == NULL) {
+			return NULL;
+		}
+		if (size) {
+			*size = dbuf.dsize;
+		}
+		return result;
+	}
+
+	seqnum = dbwrap_get_seqnum(db_ctx);
+
 	status = dbwrap_fetch(db_ctx, talloc_tos(), string_tdb_data(key),
 			      &dbuf);
+	if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+		secrets_fetch_cache_store(key, tdb_null, seqnum);
+		return NULL;
+	}
 	if (!NT_STATUS_IS_OK(status)) {
 		return NULL;
 	}
 
+	secrets_fetch_cache_store(key, dbuf, seqnum);
+
 	result = smb_memdup(dbuf.dptr, dbuf.dsize);
 	if (result == NULL) {
 		return NULL;
@@ -58,6 +58,9 @@ static bool remove_from_jobs_added(const char* sharename, uint32_t jobid);
    jobids are assigned when a job starts spooling.
 */
 
+/* How many spooled bytes between printdb job record updates. */
+#define PRINT_JOB_WRITE_BATCH_SIZE (1024*1024)
+
 static TDB_CONTEXT *rap_tdb;
 static uint16_t next_rap_jobid;
 struct rap_jobid_key {
@@ -2492,8 +2495,26 @@ ssize_t print_job_write(struct tevent_context *ev,
 
 	return_code = write_data(pjob->fd, buf, size);
 	if (return_code > 0) {
-		pjob->size += size;
-		pjob_store(ev, msg_ctx, sharename, jobid, pjob);
+		off_t new_size;
+
+		/*
+		 * Storing the job record on every single write
+		 * serializes large spool bursts on printdb. The size
+		 * field is only advisory while spooling (print_job_end
+		 * resets it from fstat), so batch the updates: take
+		 * the real size from the spool fd and only hit the
+		 * tdb once per megabyte written. A skipped store loses
+		 * nothing, the next write recomputes from the file
+		 * offset again.
+		 */
+		new_size = lseek(pjob->fd, 0, SEEK_CUR);
+		if (new_size == (off_t)-1) {
+			new_size = pjob->size + size;
+		}
+		if (new_size - pjob->size >= PRINT_JOB_WRITE_BATCH_SIZE) {
+			pjob->size = new_size;
+			pjob_store(ev, msg_ctx, sharename, jobid, pjob);
+		}
 	}
 err_out:
 	talloc_free(tmp_ctx);
@@ -177,6 +177,7 @@ bool profile_setup(struct messaging_context *msg_ctx, bool rdonly)
 	__UPDATE(#name "+time"); \
 	__UPDATE(#name "+idle"); \
 	__UPDATE(#name "+bytes"); \
+	__UPDATE(#name "+time_hist"); \
 } while(0);
 #define SMBPROFILE_STATS_IOBYTES(name) do { \
 	__UPDATE(#name "+count"); \
@@ -184,6 +185,7 @@ bool profile_setup(struct messaging_context *msg_ctx, bool rdonly)
 	__UPDATE(#name "+idle"); \
 	__UPDATE(#name "+inbytes"); \
 	__UPDATE(#name "+outbytes"); \
+	__UPDATE(#name "+time_hist"); \
 } while(0);
 #define SMBPROFILE_STATS_SECTION_END
 #define SMBPROFILE_STATS_END
@@ -378,11 +380,19 @@ void smbprofile_stats_accumulate(struct profile_stats *acc,
 	acc->values.name##_stats.count += add->values.name##_stats.count; \
 	acc->values.name##_stats.time += add->values.name##_stats.time; \
 } while(0);
+#define __ACC_TIME_HIST(name) do { \
+	unsigned int __i; \
+	for (__i = 0; __i < SMBPROFILE_TIME_HIST_BUCKETS; __i++) { \
+		acc->values.name##_stats.time_hist[__i] += \
+			add->values.name##_stats.time_hist[__i]; \
+	} \
+} while(0);
 #define SMBPROFILE_STATS_BYTES(name) do { \
 	acc->values.name##_stats.count += add->values.name##_stats.count; \
 	acc->values.name##_stats.time += add->values.name##_stats.time; \
 	acc->values.name##_stats.idle += add->values.name##_stats.idle; \
 	acc->values.name##_stats.bytes += add->values.name##_stats.bytes; \
+	__ACC_TIME_HIST(name); \
 } while(0);
 #define SMBPROFILE_STATS_IOBYTES(name) do { \
 	acc->values.name##_stats.count += add->values.name##_stats.count; \
@@ -390,10 +400,12 @@ void smbprofile_stats_accumulate(struct profile_stats *acc,
 	acc->values.name##_stats.idle += add->values.name##_stats.idle; \
 	acc->values.name##_stats.inbytes += add->values.name##_stats.inbytes; \
 	acc->values.name##_stats.outbytes += add->values.name##_stats.outbytes; \
+	__ACC_TIME_HIST(name); \
 } while(0);
 #define SMBPROFILE_STATS_SECTION_END
 #define SMBPROFILE_STATS_END
 	SMBPROFILE_STATS_ALL_SECTIONS
+#undef __ACC_TIME_HIST
 #undef SMBPROFILE_STATS_START
 #undef SMBPROFILE_STATS_SECTION_START
 #undef SMBPROFILE_STATS_COUNT
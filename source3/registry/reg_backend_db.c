@@ -43,6 +43,15 @@
 static struct db_context *regdb = NULL;
 static int regdb_refcount;
 
+/*
+ * Count of open transactions on regdb. While a transaction is
+ * running, the raw record cache below must not be consulted or
+ * filled: reads inside the transaction have to see uncommitted
+ * changes, and records read there must not survive a possible
+ * transaction cancel.
+ */
+static int regdb_transactions_active;
+
 static bool regdb_key_exists(struct db_context *db, const char *key);
 static WERROR regdb_fetch_keys_internal(struct db_context *db, const char *key,
 					struct regsubkey_ctr *ctr);
@@ -104,7 +113,9 @@ static WERROR regdb_trans_do(struct db_context *db,
 	ctx.action = action;
 	ctx.private_data = private_data;
 
+	regdb_transactions_active++;
 	status = dbwrap_trans_do(db, regdb_trans_do_action, &ctx);
+	regdb_transactions_active--;
 
 	return ntstatus_to_werror(status);
 }
@@ -806,6 +817,7 @@ WERROR regdb_init(void)
 	if (dbwrap_transaction_start(regdb) != 0) {
 		return WERR_REG_IO_FAILURE;
 	}
+	regdb_transactions_active++;
 
 	if (vers_id == REGDB_VERSION_V1) {
 		DEBUG(10, ("regdb_init: upgrading registry from version %d "
@@ -814,6 +826,7 @@ WERROR regdb_init(void)
 		werr = regdb_upgrade_v1_to_v2(regdb);
 		if (!W_ERROR_IS_OK(werr)) {
 			dbwrap_transaction_cancel(regdb);
+			regdb_transactions_active--;
 			return werr;
 		}
 
@@ -827,6 +840,7 @@ WERROR regdb_init(void)
 		werr = regdb_upgrade_v2_to_v3(regdb);
 		if (!W_ERROR_IS_OK(werr)) {
 			dbwrap_transaction_cancel(regdb);
+			regdb_transactions_active--;
 			return werr;
 		}
 
@@ -835,6 +849,7 @@ WERROR regdb_init(void)
 
 	/* future upgrade code should go here */
 
+	regdb_transactions_active--;
 	if (dbwrap_transaction_commit(regdb) != 0) {
 		return WERR_REG_IO_FAILURE;
 	}
@@ -912,18 +927,23 @@ int regdb_close( void )
 
 WERROR regdb_transaction_start(void)
 {
-	return (dbwrap_transaction_start(regdb) == 0) ?
-		WERR_OK : WERR_REG_IO_FAILURE;
+	if (dbwrap_transaction_start(regdb) != 0) {
+		return WERR_REG_IO_FAILURE;
+	}
+	regdb_transactions_active++;
+	return WERR_OK;
 }
 
 WERROR regdb_transaction_commit(void)
 {
+	regdb_transactions_active--;
 	return (dbwrap_transaction_commit(regdb) == 0) ?
 		WERR_OK : WERR_REG_IO_FAILURE;
 }
 
 WERROR regdb_transaction_cancel(void)
 {
+	regdb_transactions_active--;
 	return (dbwrap_transaction_cancel(regdb) == 0) ?
 		WERR_OK : WERR_REG_IO_FAILURE;
 }
@@ -1590,6 +1610,129 @@ done:
 	return werr;
 }
 
+/*
+ * Process-local cache of raw registry.tdb records, stamped with the
+ * tdb sequence number they were read under. Since every write to the
+ * registry bumps the seqnum, a matching stamp proves the record is
+ * still current, no matter which process did the last write. This
+ * keeps repeated reg_openkey/queryvalue traffic (smbconf-in-registry
+ * touches the same few keys on every connection setup) off the tdb
+ * fetch and validation paths.
+ */
+
+#define REGDB_FETCH_CACHE_MAX_ENTRIES 64
+
+struct regdb_fetch_cache_entry {
+	struct regdb_fetch_cache_entry *prev, *next;
+	char *path;
+	int seqnum;
+	TDB_DATA value;
+};
+
+static struct regdb_fetch_cache_entry *regdb_fetch_cache;
+static int regdb_fetch_cache_count;
+
+static bool regdb_fetch_cache_lookup(struct db_context *db,
+				     TALLOC_CTX *mem_ctx, const char *key,
+				     TDB_DATA *value, int *seqnum)
+{
+	struct regdb_fetch_cache_entry *e;
+	char *path;
+
+	if ((db != regdb) || (regdb_transactions_active != 0)) {
+		return false;
+	}
+
+	path = normalize_reg_path(talloc_tos(), key);
+	if (path == NULL) {
+		return false;
+	}
+
+	for (e = regdb_fetch_cache; e != NULL; e = e->next) {
+		if (strcmp(e->path, path) == 0) {
+			break;
+		}
+	}
+	TALLOC_FREE(path);
+
+	if (e == NULL) {
+		return false;
+	}
+
+	if (e->seqnum != dbwrap_get_seqnum(db)) {
+		DLIST_REMOVE(regdb_fetch_cache, e);
+		regdb_fetch_cache_count--;
+		TALLOC_FREE(e);
+		return false;
+	}
+
+	if (e->value.dptr == NULL) {
+		*value = tdb_null;
+	} else {
+		value->dptr = (uint8_t *)talloc_memdup(mem_ctx, e->value.dptr,
+						       e->value.dsize);
+		if (value->dptr == NULL) {
+			return false;
+		}
+		value->dsize = e->value.dsize;
+	}
+	*seqnum = e->seqnum;
+
+	DLIST_PROMOTE(regdb_fetch_cache, e);
+	return true;
+}
+
+static void regdb_fetch_cache_store(struct db_context *db, const char *key,
+				    TDB_DATA value, int seqnum)
+{
+	struct regdb_fetch_cache_entry *e, *old;
+
+	if ((db != regdb) || (regdb_transactions_active != 0)) {
+		return;
+	}
+
+	e = talloc_zero(NULL, struct regdb_fetch_cache_entry);
+	if (e == NULL) {
+		return;
+	}
+
+	e->path = normalize_reg_path(e, key);
+	if (e->path == NULL) {
+		TALLOC_FREE(e);
+		return;
+	}
+	e->seqnum = seqnum;
+
+	if (value.dptr != NULL) {
+		e->value.dptr = (uint8_t *)talloc_memdup(e, value.dptr,
+							 value.dsize);
+		if (e->value.dptr == NULL) {
+			TALLOC_FREE(e);
+			return;
+		}
+		e->value.dsize = value.dsize;
+	}
+
+	for (old = regdb_fetch_cache; old != NULL; old = old->next) {
+		if (strcmp(old->path, e->path) == 0) {
+			DLIST_REMOVE(regdb_fetch_cache, old);
+			regdb_fetch_cache_count--;
+			TALLOC_FREE(old);
+			break;
+		}
+	}
+
+	while (regdb_fetch_cache_count >= REGDB_FETCH_CACHE_MAX_ENTRIES) {
+		old = DLIST_TAIL(regdb_fetch_cache);
+		DLIST_REMOVE(regdb_fetch_cache, old);
+		regdb_fetch_cache_count--;
+		TALLOC_FREE(old);
+	}
+
+	DLIST_ADD(regdb_fetch_cache, e);
+	regdb_fetch_cache_count++;
+}
+
 static TDB_DATA regdb_fetch_key_internal(struct db_context *db,
 					 TALLOC_CTX *mem_ctx, const char *key)
 {
@@ -1737,10 +1880,15 @@ static WERROR regdb_fetch_keys_internal(struct db_context *db, const char *key,
 	TALLOC_CTX *frame = talloc_stackframe();
 	TDB_DATA value;
 	int seqnum[2], count;
+	bool from_cache;
 
 	DEBUG(11,("regdb_fetch_keys: Enter key => [%s]\n", key ? key : "NULL"));
 
-	if (!regdb_key_exists(db, key)) {
+	ZERO_STRUCT(value);
+	from_cache = regdb_fetch_cache_lookup(db, frame, key, &value,
+					      &seqnum[0]);
+
+	if (!from_cache && !regdb_key_exists(db, key)) {
 		DEBUG(10, ("key [%s] not found\n", key));
 		werr = WERR_NOT_FOUND;
 		goto done;
@@ -1749,22 +1897,25 @@ static WERROR regdb_fetch_keys_internal(struct db_context *db, const char *key,
 	werr = regsubkey_ctr_reinit(ctr);
 	W_ERROR_NOT_OK_GOTO_DONE(werr);
 
-	count = 0;
-	ZERO_STRUCT(value);
-	seqnum[0] = dbwrap_get_seqnum(db);
+	if (!from_cache) {
+		count = 0;
+		seqnum[0] = dbwrap_get_seqnum(db);
+
+		do {
+			count++;
+			TALLOC_FREE(value.dptr);
+			value = regdb_fetch_key_internal(db, frame, key);
+			seqnum[count % 2] = dbwrap_get_seqnum(db);
 
-	do {
-		count++;
-		TALLOC_FREE(value.dptr);
-		value = regdb_fetch_key_internal(db, frame, key);
-		seqnum[count % 2] = dbwrap_get_seqnum(db);
+		} while (seqnum[0] != seqnum[1]);
 
-	} while (seqnum[0] != seqnum[1]);
+		if (count > 1) {
+			DEBUG(5, ("regdb_fetch_keys_internal: it took %d "
+				  "attempts to fetch key '%s' with constant "
+				  "seqnum\n", count, key));
+		}
 
-	if (count > 1) {
-		DEBUG(5, ("regdb_fetch_keys_internal: it took %d attempts to "
-			  "fetch key '%s' with constant seqnum\n",
-			  count, key));
+		regdb_fetch_cache_store(db, key, value, seqnum[0]);
 	}
 
 	werr = regsubkey_ctr_set_seqnum(ctr, seqnum[0]);
@@ -1906,36 +2057,44 @@ static int regdb_fetch_values_internal(struct db_context *db, const char* key,
 	TDB_DATA value;
 	WERROR werr;
 	int seqnum[2], count;
+	bool from_cache;
 
 	DEBUG(10,("regdb_fetch_values: Looking for values of key [%s]\n", key));
 
-	if (!regdb_key_exists(db, key)) {
-		DEBUG(10, ("regb_fetch_values: key [%s] does not exist\n",
-			   key));
-		ret = -1;
-		goto done;
-	}
-
 	keystr = talloc_asprintf(ctx, "%s\\%s", REG_VALUE_PREFIX, key);
 	if (!keystr) {
 		goto done;
 	}
 
 	ZERO_STRUCT(value);
-	count = 0;
-	seqnum[0] = dbwrap_get_seqnum(db);
-
-	do {
-		count++;
-		TALLOC_FREE(value.dptr);
-		value = regdb_fetch_key_internal(db, ctx, keystr);
-		seqnum[count % 2] = dbwrap_get_seqnum(db);
-	} while (seqnum[0] != seqnum[1]);
-
-	if (count > 1) {
-		DEBUG(5, ("regdb_fetch_values_internal: it took %d attempts "
-			  "to fetch key '%s' with constant seqnum\n",
-			  count, key));
+	from_cache = regdb_fetch_cache_lookup(db, ctx, keystr, &value,
+					      &seqnum[0]);
+
+	if (!from_cache) {
+		if (!regdb_key_exists(db, key)) {
+			DEBUG(10, ("regb_fetch_values: key [%s] does not "
+				   "exist\n", key));
+			ret = -1;
+			goto done;
+		}
+
+		count = 0;
+		seqnum[0] = dbwrap_get_seqnum(db);
+
+		do {
+			count++;
+			TALLOC_FREE(value.dptr);
+			value = regdb_fetch_key_internal(db, ctx, keystr);
+			seqnum[count % 2] = dbwrap_get_seqnum(db);
+		} while (seqnum[0] != seqnum[1]);
+
+		if (count > 1) {
+			DEBUG(5, ("regdb_fetch_values_internal: it took %d "
+				  "attempts to fetch key '%s' with constant "
+				  "seqnum\n", count, key));
+		}
+
+		regdb_fetch_cache_store(db, keystr, value, seqnum[0]);
 	}
 
 	werr = regval_ctr_set_seqnum(values, seqnum[0]);
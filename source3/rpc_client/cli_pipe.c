@@ -2694,6 +2694,89 @@ static NTSTATUS rpc_pipe_open_tcp_port(TALLOC_CTX *mem_ctx, const char *host,
 	return status;
 }
 
+/*
+ * Endpoint mapper results are stable for as long as the server keeps
+ * its listeners, so cache them in gencache and skip the extra epm
+ * round trip on reconnect. A stale entry is dropped when connecting
+ * to the cached port fails.
+ */
+#define EPM_PORT_CACHE_TTL 900
+
+static char *epm_port_cache_key(TALLOC_CTX *mem_ctx,
+				const char *host,
+				const struct ndr_interface_table *table)
+{
+	char *guid_str;
+	char *key;
+
+	guid_str = GUID_string(mem_ctx, &table->syntax_id.uuid);
+	if (guid_str == NULL) {
+		return NULL;
+	}
+	key = talloc_asprintf(mem_ctx, "EPM_PORT/%s/%s.%u/ncacn_ip_tcp",
+			      host, guid_str, table->syntax_id.if_version);
+	TALLOC_FREE(guid_str);
+	return key;
+}
+
+static bool epm_port_cache_fetch(const char *host,
+				 const struct ndr_interface_table *table,
+				 uint16_t *pport)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	char *key;
+	char *value = NULL;
+	int port;
+	bool ok = false;
+
+	key = epm_port_cache_key(frame, host, table);
+	if (key == NULL) {
+		goto done;
+	}
+	if (!gencache_get(key, frame, &value, NULL)) {
+		goto done;
+	}
+	port = atoi(value);
+	if (port <= 0 || port > 65535) {
+		goto done;
+	}
+	DEBUG(10, ("epm_port_cache_fetch: %s => port %d\n", key, port));
+	*pport = (uint16_t)port;
+	ok = true;
+done:
+	TALLOC_FREE(frame);
+	return ok;
+}
+
+static void epm_port_cache_store(const char *host,
+				 const struct ndr_interface_table *table,
+				 uint16_t port)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	char *key;
+	char *value;
+
+	key = epm_port_cache_key(frame, host, table);
+	value = talloc_asprintf(frame, "%u", (unsigned int)port);
+	if (key != NULL && value != NULL) {
+		gencache_set(key, value, time(NULL) + EPM_PORT_CACHE_TTL);
+	}
+	TALLOC_FREE(frame);
+}
+
+static void epm_port_cache_delete(const char *host,
+				  const struct ndr_interface_table *table)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	char *key;
+
+	key = epm_port_cache_key(frame, host, table);
+	if (key != NULL) {
+		gencache_del(key);
+	}
+	TALLOC_FREE(frame);
+}
+
 /**
  * Determine the tcp port on which a dcerpc interface is listening
  * for the ncacn_ip_tcp transport via the endpoint mapper of the
@@ -2702,7 +2785,8 @@ static NTSTATUS rpc_pipe_open_tcp_port(TALLOC_CTX *mem_ctx, const char *host,
 static NTSTATUS rpc_pipe_get_tcp_port(const char *host,
 				      const struct sockaddr_storage *addr,
 				      const struct ndr_interface_table *table,
-				      uint16_t *pport)
+				      uint16_t *pport,
+				      bool *pfrom_cache)
 {
 	NTSTATUS status;
 	struct rpc_pipe_client *epm_pipe = NULL;
@@ -2726,6 +2810,8 @@ static NTSTATUS rpc_pipe_get_tcp_port(const char *host,
 		goto done;
 	}
 
+	*pfrom_cache = false;
+
 	if (ndr_syntax_id_equal(&table->syntax_id,
 				&ndr_table_epmapper.syntax_id)) {
 		*pport = 135;
@@ -2733,6 +2819,12 @@ static NTSTATUS rpc_pipe_get_tcp_port(const char *host,
 		goto done;
 	}
 
+	if (epm_port_cache_fetch(host, table, pport)) {
+		*pfrom_cache = true;
+		status = NT_STATUS_OK;
+		goto done;
+	}
+
 	/* open the connection to the endpoint mapper */
 	status = rpc_pipe_open_tcp_port(tmp_ctx, host, addr, 135,
 					&ndr_table_epmapper,
@@ -2846,6 +2938,8 @@ static NTSTATUS rpc_pipe_get_tcp_port(const char *host,
 
 	*pport = (uint16_t)atoi(endpoint);
 
+	epm_port_cache_store(host, table, *pport);
+
 done:
 	TALLOC_FREE(tmp_ctx);
 	return status;
@@ -2863,8 +2957,26 @@ NTSTATUS rpc_pipe_open_tcp(TALLOC_CTX *mem_ctx, const char *host,
 {
 	NTSTATUS status;
 	uint16_t port = 0;
+	bool from_cache = false;
+
+	status = rpc_pipe_get_tcp_port(host, addr, table, &port, &from_cache);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	status = rpc_pipe_open_tcp_port(mem_ctx, host, addr, port,
+					table, presult);
+	if (NT_STATUS_IS_OK(status) || !from_cache) {
+		return status;
+	}
+
+	/*
+	 * The cached endpoint is gone, drop it and ask the endpoint
+	 * mapper again.
+	 */
+	epm_port_cache_delete(host, table);
 
-	status = rpc_pipe_get_tcp_port(host, addr, table, &port);
+	status = rpc_pipe_get_tcp_port(host, addr, table, &port, &from_cache);
 	if (!NT_STATUS_IS_OK(status)) {
 		return status;
 	}
@@ -149,6 +149,113 @@ WERROR winreg_printer_get_changeid_internal(TALLOC_CTX *mem_ctx,
 	return result;
 }
 
+/*
+ * In-memory cache of assembled printer objects, keyed by sharename and
+ * versioned by the printer's changeid, which every configuration write
+ * bumps through winreg_printer_update_changeid(). Idle GetPrinter
+ * polling then costs one changeid read instead of reassembling the
+ * whole object (devmode, secdesc and a few dozen values) from the
+ * registry. Entries are stored as NDR blobs so every consumer gets a
+ * private deep copy on its own talloc context.
+ */
+
+struct winreg_printer_cache_entry {
+	struct winreg_printer_cache_entry *prev, *next;
+	char *sharename;
+	uint32_t changeid;
+	DATA_BLOB blob;
+};
+
+static struct winreg_printer_cache_entry *winreg_printer_cache;
+
+static struct winreg_printer_cache_entry *winreg_printer_cache_find(
+	const char *printer)
+{
+	struct winreg_printer_cache_entry *e;
+
+	for (e = winreg_printer_cache; e != NULL; e = e->next) {
+		if (strequal(e->sharename, printer)) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+static bool winreg_printer_cache_get(TALLOC_CTX *mem_ctx,
+				     const char *printer,
+				     uint32_t changeid,
+				     struct spoolss_PrinterInfo2 **pinfo2)
+{
+	struct winreg_printer_cache_entry *e;
+	struct spoolss_PrinterInfo2 *info2;
+	enum ndr_err_code ndr_err;
+
+	e = winreg_printer_cache_find(printer);
+	if (e == NULL) {
+		return false;
+	}
+
+	if (e->changeid != changeid) {
+		DLIST_REMOVE(winreg_printer_cache, e);
+		TALLOC_FREE(e);
+		return false;
+	}
+
+	info2 = talloc_zero(mem_ctx, struct spoolss_PrinterInfo2);
+	if (info2 == NULL) {
+		return false;
+	}
+
+	ndr_err = ndr_pull_struct_blob(
+		&e->blob, info2, info2,
+		(ndr_pull_flags_fn_t)ndr_pull_spoolss_PrinterInfo2);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		TALLOC_FREE(info2);
+		DLIST_REMOVE(winreg_printer_cache, e);
+		TALLOC_FREE(e);
+		return false;
+	}
+
+	*pinfo2 = info2;
+	return true;
+}
+
+static void winreg_printer_cache_store(const char *printer,
+				       uint32_t changeid,
+				       const struct spoolss_PrinterInfo2 *info2)
+{
+	struct winreg_printer_cache_entry *e;
+	enum ndr_err_code ndr_err;
+
+	e = winreg_printer_cache_find(printer);
+	if (e != NULL) {
+		DLIST_REMOVE(winreg_printer_cache, e);
+		TALLOC_FREE(e);
+	}
+
+	e = talloc_zero(NULL, struct winreg_printer_cache_entry);
+	if (e == NULL) {
+		return;
+	}
+
+	e->sharename = talloc_strdup(e, printer);
+	if (e->sharename == NULL) {
+		TALLOC_FREE(e);
+		return;
+	}
+	e->changeid = changeid;
+
+	ndr_err = ndr_push_struct_blob(
+		&e->blob, e, info2,
+		(ndr_push_flags_fn_t)ndr_push_spoolss_PrinterInfo2);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		TALLOC_FREE(e);
+		return;
+	}
+
+	DLIST_ADD(winreg_printer_cache, e);
+}
+
 WERROR winreg_get_printer_internal(TALLOC_CTX *mem_ctx,
 				   const struct auth_session_info *session_info,
 				   struct messaging_context *msg_ctx,
@@ -158,6 +265,8 @@ WERROR winreg_get_printer_internal(TALLOC_CTX *mem_ctx,
 	WERROR result;
 	struct dcerpc_binding_handle *b;
 	TALLOC_CTX *tmp_ctx;
+	uint32_t changeid = 0;
+	bool have_changeid = false;
 
 	tmp_ctx = talloc_stackframe();
 	if (tmp_ctx == NULL) {
@@ -170,11 +279,34 @@ WERROR winreg_get_printer_internal(TALLOC_CTX *mem_ctx,
 		return result;
 	}
 
+	/*
+	 * Read the changeid before the object: if a write slips in
+	 * between, the cache entry carries the old changeid and the
+	 * next lookup refetches, which is the safe direction.
+	 */
+	result = winreg_printer_get_changeid(tmp_ctx,
+					     b,
+					     printer,
+					     &changeid);
+	if (W_ERROR_IS_OK(result)) {
+		have_changeid = true;
+
+		if (winreg_printer_cache_get(mem_ctx, printer,
+					     changeid, pinfo2)) {
+			talloc_free(tmp_ctx);
+			return WERR_OK;
+		}
+	}
+
 	result = winreg_get_printer(mem_ctx,
 				    b,
 				    printer,
 				    pinfo2);
 
+	if (W_ERROR_IS_OK(result) && have_changeid) {
+		winreg_printer_cache_store(printer, changeid, *pinfo2);
+	}
+
 	talloc_free(tmp_ctx);
 	return result;
 }
@@ -56,6 +56,138 @@
 
 static NTSTATUS pipe_auth_verify_final(struct pipes_struct *p);
 
+/*
+ * Per-opnum call statistics, kept per process and dumped via
+ * MSG_REQ_RPC_STATS (smbcontrol <pid> rpc-stats). Latencies land in
+ * decimal buckets so a slow operation stands out without strace.
+ */
+
+#define RPC_STATS_NUM_BUCKETS 6
+
+static const uint64_t rpc_stats_bucket_limit[RPC_STATS_NUM_BUCKETS-1] = {
+	100,		/* 100us */
+	1000,		/* 1ms */
+	10000,		/* 10ms */
+	100000,		/* 100ms */
+	1000000,	/* 1s */
+};
+
+struct rpc_op_stats {
+	const char *name;
+	uint64_t count;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t time_total;	/* microseconds */
+	uint64_t time_max;
+	uint64_t buckets[RPC_STATS_NUM_BUCKETS];
+};
+
+struct rpc_iface_stats {
+	struct rpc_iface_stats *next, *prev;
+	struct ndr_syntax_id syntax;
+	const char *name;
+	struct rpc_op_stats ops[256];
+};
+
+static struct rpc_iface_stats *rpc_stats_list;
+
+static void rpc_stats_record(const struct ndr_syntax_id *syntax,
+			     uint16_t opnum,
+			     const char *op_name,
+			     size_t bytes_in,
+			     size_t bytes_out,
+			     const struct timeval *start)
+{
+	struct timeval now = timeval_current();
+	struct rpc_iface_stats *iface;
+	struct rpc_op_stats *op;
+	uint64_t usecs;
+	int i;
+
+	for (iface = rpc_stats_list; iface != NULL; iface = iface->next) {
+		if (ndr_syntax_id_equal(&iface->syntax, syntax)) {
+			break;
+		}
+	}
+	if (iface == NULL) {
+		iface = talloc_zero(NULL, struct rpc_iface_stats);
+		if (iface == NULL) {
+			return;
+		}
+		iface->syntax = *syntax;
+		iface->name = ndr_interface_name(&syntax->uuid,
+						 syntax->if_version);
+		DLIST_ADD(rpc_stats_list, iface);
+	}
+
+	if (opnum > 255) {
+		return;
+	}
+	op = &iface->ops[opnum];
+	op->name = op_name;
+
+	usecs = usec_time_diff(&now, start);
+
+	op->count += 1;
+	op->bytes_in += bytes_in;
+	op->bytes_out += bytes_out;
+	op->time_total += usecs;
+	op->time_max = MAX(op->time_max, usecs);
+
+	for (i = 0; i < RPC_STATS_NUM_BUCKETS-1; i++) {
+		if (usecs < rpc_stats_bucket_limit[i]) {
+			break;
+		}
+	}
+	op->buckets[i] += 1;
+}
+
+char *rpc_stats_report(TALLOC_CTX *mem_ctx)
+{
+	struct rpc_iface_stats *iface;
+	char *report;
+	int i;
+
+	report = talloc_strdup(mem_ctx, "");
+	if (report == NULL) {
+		return NULL;
+	}
+
+	for (iface = rpc_stats_list; iface != NULL; iface = iface->next) {
+		for (i = 0; i < 256; i++) {
+			struct rpc_op_stats *op = &iface->ops[i];
+
+			if (op->count == 0) {
+				continue;
+			}
+			report = talloc_asprintf_append_buffer(
+				report,
+				"%s %s(0x%02x): %ju calls, "
+				"%ju bytes in, %ju bytes out, "
+				"avg %ju us, max %ju us, "
+				"hist [%ju,%ju,%ju,%ju,%ju,%ju]\n",
+				iface->name,
+				op->name != NULL ? op->name : "",
+				(unsigned int)i,
+				(uintmax_t)op->count,
+				(uintmax_t)op->bytes_in,
+				(uintmax_t)op->bytes_out,
+				(uintmax_t)(op->time_total / op->count),
+				(uintmax_t)op->time_max,
+				(uintmax_t)op->buckets[0],
+				(uintmax_t)op->buckets[1],
+				(uintmax_t)op->buckets[2],
+				(uintmax_t)op->buckets[3],
+				(uintmax_t)op->buckets[4],
+				(uintmax_t)op->buckets[5]);
+			if (report == NULL) {
+				return NULL;
+			}
+		}
+	}
+	return report;
+}
+
 /**
  * Dump everything from the start of the end up of the provided data
  * into a file, but only at debug level >= 50
@@ -1421,6 +1553,7 @@ static bool api_rpcTNP(struct pipes_struct *p, struct ncacn_packet *pkt,
 {
 	int fn_num;
 	uint32_t offset1;
+	struct timeval start;
 	const struct ndr_interface_table *table;
 
 	/* interpret the command */
@@ -1465,7 +1598,9 @@ static bool api_rpcTNP(struct pipes_struct *p, struct ncacn_packet *pkt,
 
 	offset1 = p->out_data.rdata.length;
 
-        DEBUG(6, ("api_rpc_cmds[%d].fn == %p\n", 
+	start = timeval_current();
+
+        DEBUG(6, ("api_rpc_cmds[%d].fn == %p\n",
                 fn_num, api_rpc_cmds[fn_num].fn));
 	/* do the actual command */
 	if(!api_rpc_cmds[fn_num].fn(p)) {
@@ -1476,6 +1611,12 @@ static bool api_rpcTNP(struct pipes_struct *p, struct ncacn_packet *pkt,
 		return False;
 	}
 
+	rpc_stats_record(syntax, pkt->u.request.opnum,
+			 api_rpc_cmds[fn_num].name,
+			 p->in_data.data.length,
+			 p->out_data.rdata.length - offset1,
+			 &start);
+
 	if (p->fault_state) {
 		DEBUG(4,("api_rpcTNP: fault(%d) return.\n", p->fault_state));
 		setup_fault_pdu(p, NT_STATUS(p->fault_state));
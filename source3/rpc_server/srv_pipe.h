@@ -26,6 +26,7 @@ struct pipes_struct;
 /* The following definitions come from rpc_server/srv_pipe.c  */
 
 bool create_next_pdu(struct pipes_struct *p);
+char *rpc_stats_report(TALLOC_CTX *mem_ctx);
 bool api_pipe_bind_auth3(struct pipes_struct *p, struct ncacn_packet *pkt);
 bool setup_fault_pdu(struct pipes_struct *p, NTSTATUS status);
 bool is_known_pipename(const char *cli_filename, struct ndr_syntax_id *syntax);
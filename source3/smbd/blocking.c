@@ -30,6 +30,8 @@ static void received_unlock_msg(struct messaging_context *msg,
 				uint32_t msg_type,
 				struct server_id server_id,
 				DATA_BLOB *data);
+static void process_blocking_lock_queue_range(
+	struct smbd_server_connection *sconn, const struct unlock_msg *msg);
 
 void brl_timeout_fn(struct tevent_context *event_ctx,
 			   struct tevent_timer *te,
@@ -807,16 +809,49 @@ static void received_unlock_msg(struct messaging_context *msg,
 	struct smbd_server_connection *sconn =
 		talloc_get_type_abort(private_data,
 		struct smbd_server_connection);
+	struct unlock_msg msg;
+	struct unlock_msg *pmsg = NULL;
 
 	DEBUG(10,("received_unlock_msg\n"));
-	process_blocking_lock_queue(sconn);
+
+	/*
+	 * If the sender told us which range got unlocked we only
+	 * recheck the pending locks it can affect. Zero-length
+	 * messages (smbcontrol, brl_revalidate) recheck everything.
+	 */
+	if (data->length == sizeof(msg)) {
+		memcpy(&msg, data->data, sizeof(msg));
+		pmsg = &msg;
+	}
+
+	process_blocking_lock_queue_range(sconn, pmsg);
+}
+
+/****************************************************************************
+ Does the unlocked range described by msg overlap the lock blr is
+ waiting for? Same test as brl_pending_overlap().
+*****************************************************************************/
+
+static bool blr_unlock_overlap(const struct blocking_lock_record *blr,
+			       const struct unlock_msg *msg)
+{
+	if ((msg->offset <= blr->offset) &&
+	    (msg->offset + msg->count > blr->offset)) {
+		return true;
+	}
+	if ((msg->offset >= blr->offset) &&
+	    (msg->offset < blr->offset + blr->count)) {
+		return true;
+	}
+	return false;
 }
 
 /****************************************************************************
  Process the blocking lock queue. Note that this is only called as root.
 *****************************************************************************/
 
-void process_blocking_lock_queue(struct smbd_server_connection *sconn)
+static void process_blocking_lock_queue_range(
+	struct smbd_server_connection *sconn, const struct unlock_msg *msg)
 {
 	struct blocking_lock_record *blr, *next = NULL;
 
@@ -834,6 +869,15 @@ void process_blocking_lock_queue(struct smbd_server_connection *sconn)
 
 		next = blr->next;
 
+		if (msg != NULL) {
+			if (!file_id_equal(&blr->fsp->file_id, &msg->id)) {
+				continue;
+			}
+			if (!blr_unlock_overlap(blr, msg)) {
+				continue;
+			}
+		}
+
 		/*
 		 * Go through the remaining locks and try and obtain them.
 		 * The call returns True if all locks were obtained successfully
@@ -882,6 +926,11 @@ void process_blocking_lock_queue(struct smbd_server_connection *sconn)
 	recalc_brl_timeout(sconn);
 }
 
+void process_blocking_lock_queue(struct smbd_server_connection *sconn)
+{
+	process_blocking_lock_queue_range(sconn, NULL);
+}
+
 /****************************************************************************
  Handle a cancel message. Lock already moved onto the cancel queue.
 *****************************************************************************/
@@ -559,13 +559,23 @@ static NTSTATUS update_write_time_on_close(struct files_struct *fsp)
 	lck = get_existing_share_mode_lock(talloc_tos(), fsp->file_id);
 	if (lck) {
 		/* On close if we're changing the real file time we
-		 * must update it in the open file db too. */
-		(void)set_write_time(fsp->file_id, fsp->close_write_time);
+		 * must update it in the open file db too. We already
+		 * hold the share mode lock, so update the fields
+		 * directly instead of going through set_write_time()
+		 * and re-acquiring it. */
+		if (timespec_compare(&lck->data->old_write_time,
+				     &fsp->close_write_time) != 0) {
+			lck->data->modified = true;
+			lck->data->old_write_time = fsp->close_write_time;
+		}
 
 		/* Close write times overwrite sticky write times
 		   so we must replace any sticky write time here. */
-		if (!null_timespec(lck->data->changed_write_time)) {
-			(void)set_sticky_write_time(fsp->file_id, fsp->close_write_time);
+		if (!null_timespec(lck->data->changed_write_time) &&
+		    (timespec_compare(&lck->data->changed_write_time,
+				      &fsp->close_write_time) != 0)) {
+			lck->data->modified = true;
+			lck->data->changed_write_time = fsp->close_write_time;
 		}
 		TALLOC_FREE(lck);
 	}
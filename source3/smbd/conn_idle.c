@@ -49,6 +49,7 @@ bool conn_idle_all(struct smbd_server_connection *sconn, time_t t)
 {
 	int deadtime = lp_deadtime()*60;
 	struct connection_struct *conn;
+	bool all_idle = true;
 
 	conn_lastused_update(sconn, t);
 
@@ -59,16 +60,25 @@ bool conn_idle_all(struct smbd_server_connection *sconn, time_t t)
 	for (conn=sconn->connections;conn;conn=conn->next) {
 		time_t age = t - conn->lastused;
 
-		/* close dirptrs on connections that are idle */
+		/*
+		 * Close dirptrs on connections that are idle. Do this
+		 * for every connection, a busy one earlier in the
+		 * list must not keep cached directory handles alive
+		 * on the idle ones behind it.
+		 */
 		if (age > DPTR_IDLE_TIMEOUT) {
 			dptr_idlecnum(conn);
 		}
 
 		if (conn->num_files_open > 0 || age < deadtime) {
-			return false;
+			all_idle = false;
 		}
 	}
 
+	if (!all_idle) {
+		return false;
+	}
+
 	/*
 	 * Check all pipes for any open handles. We cannot
 	 * idle with a handle open.
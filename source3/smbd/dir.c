@@ -59,6 +59,11 @@ struct smb_Dir {
 	unsigned int file_number;
 	files_struct *fsp; /* Back pointer to containing fsp, only
 			      set from OpenDir_fsp(). */
+	bool snapshot;	   /* Whole directory drained at open time,
+			      reads are served from the arrays below. */
+	size_t snap_count;
+	size_t *snap_entries;	/* Offsets into snap_pool. */
+	char *snap_pool;	/* Packed NUL-terminated names. */
 };
 
 struct dptr_struct {
@@ -76,6 +81,9 @@ struct dptr_struct {
 	bool priv;     /* Directory handle opened with privilege. */
 	uint32_t counter;
 	struct memcache *dptr_cache;
+	struct ms_fnmatch_compiled *compiled_wcard;
+	char *compiled_wcard_str;
+	bool compiled_wcard_cs;
 };
 
 static struct smb_Dir *OpenDir_fsp(TALLOC_CTX *mem_ctx, connection_struct *conn,
@@ -665,6 +673,32 @@ bool dptr_has_wild(struct dptr_struct *dptr)
 	return dptr->has_wild;
 }
 
+/****************************************************************************
+ Return the compiled form of the search mask, building it on first use
+ and reusing it for every entry of the search. Returns NULL if the mask
+ cannot be compiled - callers then fall back to plain mask_match().
+****************************************************************************/
+
+struct ms_fnmatch_compiled *dptr_get_compiled_wcard(struct dptr_struct *dptr,
+						    const char *mask,
+						    bool is_case_sensitive)
+{
+	if ((dptr->compiled_wcard_str == NULL) ||
+	    (strcmp(dptr->compiled_wcard_str, mask) != 0) ||
+	    (dptr->compiled_wcard_cs != is_case_sensitive)) {
+		TALLOC_FREE(dptr->compiled_wcard);
+		TALLOC_FREE(dptr->compiled_wcard_str);
+		dptr->compiled_wcard_str = talloc_strdup(dptr, mask);
+		if (dptr->compiled_wcard_str == NULL) {
+			return NULL;
+		}
+		dptr->compiled_wcard = mask_match_compile(dptr, mask,
+							  is_case_sensitive);
+		dptr->compiled_wcard_cs = is_case_sensitive;
+	}
+	return dptr->compiled_wcard;
+}
+
 int dptr_dnum(struct dptr_struct *dptr)
 {
 	return dptr->dnum;
@@ -1584,6 +1618,76 @@ static int smb_Dir_destructor(struct smb_Dir *dirp)
 	return 0;
 }
 
+/*******************************************************************
+ Drain the whole directory into a compact in-memory snapshot.
+
+ The OS readdir layer already fetches entries in large batches;
+ what hurts restart-heavy enumerations is re-seeking and re-walking
+ the kernel directory stream on every continuation. Once a snapshot
+ is loaded, SeekDir and ReadDirName become array lookups and the
+ kernel is only asked once per open. The snapshot is a point in
+ time view - entries created or removed after the open are not
+ seen, which is what clients of an in-progress enumeration get
+ anyway. On failure we rewind and leave the handle in normal mode.
+********************************************************************/
+
+static void dir_snapshot_load(struct smb_Dir *dirp)
+{
+	connection_struct *conn = dirp->conn;
+	const char *n;
+	char *talloced = NULL;
+	size_t pool_used = 0;
+	size_t pool_size = 0;
+	size_t alloc_count = 0;
+
+	while ((n = vfs_readdirname(conn, dirp->dir, NULL, &talloced))) {
+		size_t len;
+
+		/* Ignore . and .. - ReadDirName synthesizes them. */
+		if (*n == '.') {
+			if ((n[1] == '\0') || (n[1] == '.' && n[2] == '\0')) {
+				TALLOC_FREE(talloced);
+				continue;
+			}
+		}
+
+		len = strlen(n) + 1;
+
+		if (pool_used + len > pool_size) {
+			pool_size = MAX(pool_size * 2, (size_t)4096);
+			dirp->snap_pool = talloc_realloc(dirp,
+				dirp->snap_pool, char, pool_size);
+			if (dirp->snap_pool == NULL) {
+				goto fail;
+			}
+		}
+		if (dirp->snap_count == alloc_count) {
+			alloc_count = MAX(alloc_count * 2, (size_t)256);
+			dirp->snap_entries = talloc_realloc(dirp,
+				dirp->snap_entries, size_t, alloc_count);
+			if (dirp->snap_entries == NULL) {
+				goto fail;
+			}
+		}
+
+		memcpy(dirp->snap_pool + pool_used, n, len);
+		dirp->snap_entries[dirp->snap_count] = pool_used;
+		pool_used += len;
+		dirp->snap_count++;
+		TALLOC_FREE(talloced);
+	}
+
+	dirp->snapshot = true;
+	return;
+
+  fail:
+	TALLOC_FREE(talloced);
+	TALLOC_FREE(dirp->snap_entries);
+	TALLOC_FREE(dirp->snap_pool);
+	dirp->snap_count = 0;
+	SMB_VFS_REWINDDIR(conn, dirp->dir);
+}
+
 /*******************************************************************
  Open a directory.
 ********************************************************************/
@@ -1621,6 +1725,10 @@ struct smb_Dir *OpenDir(TALLOC_CTX *mem_ctx, connection_struct *conn,
 		goto fail;
 	}
 
+	if (lp_parm_bool(SNUM(conn), "smbd", "directory snapshot", false)) {
+		dir_snapshot_load(dirp);
+	}
+
 	return dirp;
 
   fail:
@@ -1684,6 +1792,10 @@ static struct smb_Dir *OpenDir_fsp(TALLOC_CTX *mem_ctx, connection_struct *conn,
 		goto fail;
 	}
 
+	if (lp_parm_bool(SNUM(conn), "smbd", "directory snapshot", false)) {
+		dir_snapshot_load(dirp);
+	}
+
 	return dirp;
 
   fail:
@@ -1726,6 +1838,37 @@ const char *ReadDirName(struct smb_Dir *dirp, long *poffset,
 		return NULL;
 	}
 
+	if (dirp->snapshot) {
+		size_t idx;
+
+		/*
+		 * Snapshot offsets encode the index of the next entry
+		 * plus one, so they never collide with
+		 * START_OF_DIRECTORY_OFFSET.
+		 */
+		if ((*poffset == START_OF_DIRECTORY_OFFSET) ||
+		    (*poffset == DOT_DOT_DIRECTORY_OFFSET)) {
+			idx = 0;
+		} else {
+			idx = (size_t)(*poffset - 1);
+		}
+
+		if (idx >= dirp->snap_count) {
+			*poffset = dirp->offset = END_OF_DIRECTORY_OFFSET;
+			*ptalloced = NULL;
+			return NULL;
+		}
+
+		n = dirp->snap_pool + dirp->snap_entries[idx];
+		if (sbuf != NULL) {
+			SET_STAT_INVALID(*sbuf);
+		}
+		*poffset = dirp->offset = (long)(idx + 2);
+		*ptalloced = NULL;
+		dirp->file_number++;
+		return n;
+	}
+
 	/* A real offset, seek to it. */
 	SeekDir(dirp, *poffset);
 
@@ -1753,7 +1896,9 @@ const char *ReadDirName(struct smb_Dir *dirp, long *poffset,
 
 void RewindDir(struct smb_Dir *dirp, long *poffset)
 {
-	SMB_VFS_REWINDDIR(dirp->conn, dirp->dir);
+	if (!dirp->snapshot) {
+		SMB_VFS_REWINDDIR(dirp->conn, dirp->dir);
+	}
 	dirp->file_number = 0;
 	dirp->offset = START_OF_DIRECTORY_OFFSET;
 	*poffset = START_OF_DIRECTORY_OFFSET;
@@ -1785,7 +1930,8 @@ void SeekDir(struct smb_Dir *dirp, long offset)
 			dirp->file_number = 2;
 		} else if (offset == END_OF_DIRECTORY_OFFSET) {
 			; /* Don't seek in this case. */
-		} else {
+		} else if (!dirp->snapshot) {
+			/* Snapshot reads decode the offset themselves. */
 			SMB_VFS_SEEKDIR(dirp->conn, dirp->dir, offset);
 		}
 		dirp->offset = offset;
@@ -1863,7 +2009,9 @@ bool SearchDir(struct smb_Dir *dirp, const char *name, long *poffset)
 	}
 
 	/* Not found in the name cache. Rewind directory and start from scratch. */
-	SMB_VFS_REWINDDIR(conn, dirp->dir);
+	if (!dirp->snapshot) {
+		SMB_VFS_REWINDDIR(conn, dirp->dir);
+	}
 	dirp->file_number = 0;
 	*poffset = START_OF_DIRECTORY_OFFSET;
 	while ((entry = ReadDirName(dirp, poffset, NULL, &talloced))) {
@@ -640,6 +640,57 @@ uint32_t dos_mode(connection_struct *conn, struct smb_filename *smb_fname)
 	return result;
 }
 
+/****************************************************************************
+ dos_mode() through the per-handle cache. Attributes rarely change,
+ but Explorer asks for them over and over - a whole window refresh
+ comes down to hundreds of QUERY_INFO calls on open handles. The
+ cache is revalidated against st_ex_ctime, which chmod and xattr
+ updates bump, so the caller must have a fresh stat in
+ fsp->fsp_name->st (the getinfo paths always do).
+****************************************************************************/
+
+uint32_t fsp_dos_mode(files_struct *fsp)
+{
+	uint32_t mode;
+
+	if (fsp->dosmode_valid &&
+	    (timespec_compare(&fsp->dosmode_ctime,
+			      &fsp->fsp_name->st.st_ex_ctime) == 0)) {
+		return fsp->dosmode;
+	}
+
+	mode = dos_mode(fsp->conn, fsp->fsp_name);
+
+	fsp->dosmode = mode;
+	fsp->dosmode_ctime = fsp->fsp_name->st.st_ex_ctime;
+	fsp->dosmode_valid = true;
+
+	return mode;
+}
+
+/****************************************************************************
+ Drop the cached dos mode on every open handle for a file we've just
+ changed the attributes of.
+****************************************************************************/
+
+static void dosmode_invalidate_cache(connection_struct *conn,
+				     const struct smb_filename *smb_fname)
+{
+	struct file_id id;
+	files_struct *fsp;
+
+	if (!VALID_STAT(smb_fname->st)) {
+		return;
+	}
+
+	id = vfs_file_id_from_sbuf(conn, &smb_fname->st);
+
+	for (fsp = file_find_di_first(conn->sconn, id); fsp;
+	     fsp = file_find_di_next(fsp)) {
+		fsp->dosmode_valid = false;
+	}
+}
+
 /*******************************************************************
  chmod a file - but preserve some bits.
  If "store dos attributes" is also set it will store the create time
@@ -724,6 +775,7 @@ int file_set_dosmode(connection_struct *conn, struct smb_filename *smb_fname,
 				     smb_fname->base_name);
 		}
 		smb_fname->st.st_ex_mode = unixmode;
+		dosmode_invalidate_cache(conn, smb_fname);
 		return 0;
 	}
 
@@ -791,6 +843,7 @@ int file_set_dosmode(connection_struct *conn, struct smb_filename *smb_fname,
 				     smb_fname->base_name);
 		}
 		smb_fname->st.st_ex_mode = unixmode;
+		dosmode_invalidate_cache(conn, smb_fname);
 		return 0;
 	}
 
@@ -836,6 +889,7 @@ int file_set_dosmode(connection_struct *conn, struct smb_filename *smb_fname,
 	}
 	if (ret == 0) {
 		smb_fname->st.st_ex_mode = unixmode;
+		dosmode_invalidate_cache(conn, smb_fname);
 	}
 
 	return( ret );
@@ -695,7 +695,7 @@ NTSTATUS vfs_default_durable_reconnect(struct connection_struct *conn,
 
 	fsp->fh->private_options = e->private_options;
 	fsp->fh->gen_id = smbXsrv_open_hash(op);
-	fsp->file_id = file_id;
+	fsp_set_file_id(fsp, file_id);
 	fsp->file_pid = smb1req->smbpid;
 	fsp->vuid = smb1req->vuid;
 	fsp->open_time = e->time;
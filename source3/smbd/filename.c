@@ -29,6 +29,7 @@
 #include "fake_file.h"
 #include "smbd/smbd.h"
 #include "smbd/globals.h"
+#include "../lib/util/memcache.h"
 
 static NTSTATUS build_stream_path(TALLOC_CTX *mem_ctx,
 				  connection_struct *conn,
@@ -467,7 +468,7 @@ NTSTATUS unix_convert(TALLOC_CTX *ctx,
 			}
 			/* Add the path (not including the stream) to the cache. */
 			stat_cache_add(orig_path, smb_fname->base_name,
-				       conn->case_sensitive);
+				       conn);
 			DEBUG(5,("conversion of base_name finished %s -> %s\n",
 				 orig_path, smb_fname->base_name));
 			goto done;
@@ -975,7 +976,7 @@ NTSTATUS unix_convert(TALLOC_CTX *ctx,
 		 */
 		if(!component_was_mangled && !name_has_wildcard) {
 			stat_cache_add(orig_path, dirpath,
-					conn->case_sensitive);
+					conn);
 		}
 
 		/*
@@ -993,7 +994,7 @@ NTSTATUS unix_convert(TALLOC_CTX *ctx,
 
 	if(!component_was_mangled && !name_has_wildcard) {
 		stat_cache_add(orig_path, smb_fname->base_name,
-			       conn->case_sensitive);
+			       conn);
 	}
 
 	/*
@@ -1224,6 +1225,82 @@ static int get_real_filename_full_scan(connection_struct *conn,
 	return -1;
 }
 
+/****************************************************************************
+ Per-directory component case mapping cache used by get_real_filename().
+
+ Maps (service, directory, upper-cased component) to the on-disk
+ spelling of the component, so repeated walks below the same
+ directories don't re-scan them for every request. A hit is verified
+ with a stat before it is used; a stale mapping therefore costs one
+ extra stat and is dropped, to be refreshed by the next scan.
+****************************************************************************/
+
+static DATA_BLOB get_real_filename_cache_key(TALLOC_CTX *mem_ctx,
+					     connection_struct *conn,
+					     const char *path,
+					     const char *name)
+{
+	char *upper;
+	char *key;
+
+	upper = talloc_strdup_upper(mem_ctx, name);
+	if (upper == NULL) {
+		return data_blob_null;
+	}
+	key = talloc_asprintf(mem_ctx, "%d/%s/%s", SNUM(conn), path, upper);
+	TALLOC_FREE(upper);
+	if (key == NULL) {
+		return data_blob_null;
+	}
+	return data_blob_const(key, strlen(key));
+}
+
+static bool get_real_filename_cache_lookup(connection_struct *conn,
+					   const char *path,
+					   DATA_BLOB key,
+					   TALLOC_CTX *mem_ctx,
+					   char **found_name)
+{
+	DATA_BLOB value = data_blob_null;
+	struct smb_filename smb_fname;
+	char *candidate;
+	int ret;
+
+	if (!memcache_lookup(smbd_memcache(), GETREALFILENAME_CACHE,
+			     key, &value)) {
+		return false;
+	}
+
+	if (*path != '\0') {
+		candidate = talloc_asprintf(talloc_tos(), "%s/%s",
+					    path, (const char *)value.data);
+	} else {
+		candidate = talloc_strdup(talloc_tos(),
+					  (const char *)value.data);
+	}
+	if (candidate == NULL) {
+		return false;
+	}
+
+	ZERO_STRUCT(smb_fname);
+	smb_fname.base_name = candidate;
+
+	ret = SMB_VFS_LSTAT(conn, &smb_fname);
+	if (ret != 0) {
+		/* Stale mapping, drop it. */
+		memcache_delete(smbd_memcache(), GETREALFILENAME_CACHE, key);
+		TALLOC_FREE(candidate);
+		return false;
+	}
+	TALLOC_FREE(candidate);
+
+	*found_name = talloc_strdup(mem_ctx, (const char *)value.data);
+	if (*found_name == NULL) {
+		return false;
+	}
+	return true;
+}
+
 /****************************************************************************
  Wrapper around the vfs get_real_filename and the full directory scan
  fallback.
@@ -1235,6 +1312,7 @@ int get_real_filename(connection_struct *conn, const char *path,
 {
 	int ret;
 	bool mangled;
+	DATA_BLOB key = data_blob_null;
 
 	mangled = mangle_is_mangled(name, conn->params);
 
@@ -1243,6 +1321,14 @@ int get_real_filename(connection_struct *conn, const char *path,
 						   mem_ctx, found_name);
 	}
 
+	key = get_real_filename_cache_key(talloc_tos(), conn, path, name);
+	if (key.data != NULL &&
+	    get_real_filename_cache_lookup(conn, path, key, mem_ctx,
+					   found_name)) {
+		TALLOC_FREE(key.data);
+		return 0;
+	}
+
 	/* Try the vfs first to take advantage of case-insensitive stat. */
 	ret = SMB_VFS_GET_REAL_FILENAME(conn, path, name, mem_ctx, found_name);
 
@@ -1251,12 +1337,27 @@ int get_real_filename(connection_struct *conn, const char *path,
 	 * other than EOPNOTSUPP then there is no need to fall back on the
 	 * full directory scan.
 	 */
-	if (ret == 0 || (ret == -1 && errno != EOPNOTSUPP)) {
+	if (ret == -1 && errno == EOPNOTSUPP) {
+		ret = get_real_filename_full_scan(conn, path, name, mangled,
+						  mem_ctx, found_name);
+	}
+
+	if (ret != 0) {
+		/* The callers inspect errno, keep it intact. */
+		int saved_errno = errno;
+		TALLOC_FREE(key.data);
+		errno = saved_errno;
 		return ret;
 	}
 
-	return get_real_filename_full_scan(conn, path, name, mangled, mem_ctx,
-					   found_name);
+	if (key.data != NULL) {
+		memcache_add(smbd_memcache(), GETREALFILENAME_CACHE, key,
+			     data_blob_const(*found_name,
+					     strlen(*found_name) + 1));
+	}
+	TALLOC_FREE(key.data);
+
+	return 0;
 }
 
 static NTSTATUS build_stream_path(TALLOC_CTX *mem_ctx,
@@ -23,9 +23,121 @@
 #include "libcli/security/security.h"
 #include "util_tdb.h"
 #include "lib/util/bitmap.h"
+#include "dbwrap/dbwrap.h"
+#include "dbwrap/dbwrap_rbt.h"
 
 #define FILE_HANDLE_OFFSET 0x1000
 
+/****************************************************************************
+ In-memory index of open files by file_id.
+
+ sconn->files_by_id maps a file_id to the head of a chain of fsps
+ (linked via fsp->fi_next/fi_prev) open on that file, so the
+ file_find_di/file_find_dif lookups done for every oplock break
+ don't walk the whole open file list.
+****************************************************************************/
+
+static TDB_DATA fsp_fi_key(const struct file_id *id)
+{
+	return make_tdb_data((const uint8_t *)id, sizeof(*id));
+}
+
+static void fsp_fi_chain_parser(TDB_DATA key, TDB_DATA data,
+				void *private_data)
+{
+	struct files_struct **head = (struct files_struct **)private_data;
+
+	if (data.dsize == sizeof(*head)) {
+		memcpy(head, data.dptr, sizeof(*head));
+	}
+}
+
+static struct files_struct *fsp_fi_chain_head(
+	struct smbd_server_connection *sconn, const struct file_id *id)
+{
+	struct files_struct *head = NULL;
+
+	if (sconn->files_by_id == NULL) {
+		return NULL;
+	}
+	dbwrap_parse_record(sconn->files_by_id, fsp_fi_key(id),
+			    fsp_fi_chain_parser, &head);
+	return head;
+}
+
+static void fsp_fi_chain_store(struct smbd_server_connection *sconn,
+			       const struct file_id *id,
+			       struct files_struct *head)
+{
+	NTSTATUS status;
+
+	if (head != NULL) {
+		status = dbwrap_store(
+			sconn->files_by_id, fsp_fi_key(id),
+			make_tdb_data((uint8_t *)&head, sizeof(head)),
+			TDB_REPLACE);
+	} else {
+		status = dbwrap_delete(sconn->files_by_id, fsp_fi_key(id));
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		smb_panic("fsp_fi_chain_store failed");
+	}
+}
+
+static void fsp_fi_index_unlink(struct files_struct *fsp)
+{
+	if (!fsp->fi_indexed) {
+		return;
+	}
+
+	if (fsp->fi_prev != NULL) {
+		fsp->fi_prev->fi_next = fsp->fi_next;
+	} else {
+		fsp_fi_chain_store(fsp->conn->sconn, &fsp->file_id,
+				   fsp->fi_next);
+	}
+	if (fsp->fi_next != NULL) {
+		fsp->fi_next->fi_prev = fsp->fi_prev;
+	}
+	fsp->fi_next = NULL;
+	fsp->fi_prev = NULL;
+	fsp->fi_indexed = false;
+}
+
+static void fsp_fi_index_link(struct files_struct *fsp)
+{
+	struct smbd_server_connection *sconn = fsp->conn->sconn;
+	struct files_struct *head;
+
+	/*
+	 * Synthetic fsps (e.g. from pysmbd) have no server
+	 * connection and don't take part in the index.
+	 */
+	if (sconn == NULL || sconn->files_by_id == NULL) {
+		return;
+	}
+
+	head = fsp_fi_chain_head(sconn, &fsp->file_id);
+	fsp->fi_next = head;
+	fsp->fi_prev = NULL;
+	if (head != NULL) {
+		head->fi_prev = fsp;
+	}
+	fsp_fi_chain_store(sconn, &fsp->file_id, fsp);
+	fsp->fi_indexed = true;
+}
+
+/**
+ * The only way fsp->file_id should ever be set: keeps the
+ * by-file_id index in sync.
+ */
+void fsp_set_file_id(struct files_struct *fsp, struct file_id id)
+{
+	fsp_fi_index_unlink(fsp);
+	fsp->file_id = id;
+	fsp_fi_index_link(fsp);
+}
+
 /**
  * create new fsp to be used for file_new or a durable handle reconnect
  */
@@ -41,6 +153,13 @@ NTSTATUS fsp_new(struct connection_struct *conn, TALLOC_CTX *mem_ctx,
 		goto fail;
 	}
 
+	if (sconn->files_by_id == NULL) {
+		sconn->files_by_id = db_open_rbt(sconn);
+		if (sconn->files_by_id == NULL) {
+			goto fail;
+		}
+	}
+
 	/*
 	 * This can't be a child of fsp because the file_handle can be ref'd
 	 * when doing a dos/fcb open, which will then share the file_handle
@@ -132,13 +251,6 @@ NTSTATUS file_new(struct smb_request *req, connection_struct *conn,
 		req->chain_fsp = fsp;
 	}
 
-	/* A new fsp invalidates the positive and
-	  negative fsp_fi_cache as the new fsp is pushed
-	  at the start of the list and we search from
-	  a cache hit to the *end* of the list. */
-
-	ZERO_STRUCT(sconn->fsp_fi_cache);
-
 	*result = fsp;
 	return NT_STATUS_OK;
 }
@@ -305,20 +417,15 @@ files_struct *file_find_fd(struct smbd_server_connection *sconn, int fd)
 files_struct *file_find_dif(struct smbd_server_connection *sconn,
 			    struct file_id id, unsigned long gen_id)
 {
-	int count=0;
 	files_struct *fsp;
 
 	if (gen_id == 0) {
 		return NULL;
 	}
 
-	for (fsp=sconn->files; fsp; fsp=fsp->next,count++) {
+	for (fsp = fsp_fi_chain_head(sconn, &id); fsp; fsp = fsp->fi_next) {
 		/* We can have a fsp->fh->fd == -1 here as it could be a stat open. */
-		if (file_id_equal(&fsp->file_id, &id) &&
-		    fsp->fh->gen_id == gen_id ) {
-			if (count > 10) {
-				DLIST_PROMOTE(sconn->files, fsp);
-			}
+		if (fsp->fh->gen_id == gen_id) {
 			/* Paranoia check. */
 			if ((fsp->fh->fd == -1) &&
 			    (fsp->oplock_type != NO_OPLOCK &&
@@ -341,33 +448,12 @@ files_struct *file_find_dif(struct smbd_server_connection *sconn,
 
 /****************************************************************************
  Find the first fsp given a device and inode.
- We use a singleton cache here to speed up searching from getfilepathinfo
- calls.
 ****************************************************************************/
 
 files_struct *file_find_di_first(struct smbd_server_connection *sconn,
 				 struct file_id id)
 {
-	files_struct *fsp;
-
-	if (file_id_equal(&sconn->fsp_fi_cache.id, &id)) {
-		/* Positive or negative cache hit. */
-		return sconn->fsp_fi_cache.fsp;
-	}
-
-	sconn->fsp_fi_cache.id = id;
-
-	for (fsp=sconn->files;fsp;fsp=fsp->next) {
-		if (file_id_equal(&fsp->file_id, &id)) {
-			/* Setup positive cache. */
-			sconn->fsp_fi_cache.fsp = fsp;
-			return fsp;
-		}
-	}
-
-	/* Setup negative cache. */
-	sconn->fsp_fi_cache.fsp = NULL;
-	return NULL;
+	return fsp_fi_chain_head(sconn, &id);
 }
 
 /****************************************************************************
@@ -376,15 +462,7 @@ files_struct *file_find_di_first(struct smbd_server_connection *sconn,
 
 files_struct *file_find_di_next(files_struct *start_fsp)
 {
-	files_struct *fsp;
-
-	for (fsp = start_fsp->next;fsp;fsp=fsp->next) {
-		if (file_id_equal(&fsp->file_id, &start_fsp->file_id)) {
-			return fsp;
-		}
-	}
-
-	return NULL;
+	return start_fsp->fi_next;
 }
 
 struct files_struct *file_find_one_fsp_from_lease_key(
@@ -478,6 +556,8 @@ void fsp_free(files_struct *fsp)
 {
 	struct smbd_server_connection *sconn = fsp->conn->sconn;
 
+	fsp_fi_index_unlink(fsp);
+
 	DLIST_REMOVE(sconn->files, fsp);
 	SMB_ASSERT(sconn->num_files > 0);
 	sconn->num_files--;
@@ -540,11 +620,6 @@ void file_free(struct smb_request *req, files_struct *fsp)
 		remove_smb2_chained_fsp(fsp);
 	}
 
-	/* Closing a file can invalidate the positive cache. */
-	if (fsp == sconn->fsp_fi_cache.fsp) {
-		ZERO_STRUCT(sconn->fsp_fi_cache);
-	}
-
 	/* Drop all remaining extensions. */
 	vfs_remove_all_fsp_extensions(fsp);
 
@@ -698,7 +773,7 @@ NTSTATUS dup_file_fsp(struct smb_request *req, files_struct *from,
 	to->fh = from->fh;
 	to->fh->ref_count++;
 
-	to->file_id = from->file_id;
+	fsp_set_file_id(to, from->file_id);
 	to->initial_allocation_size = from->initial_allocation_size;
 	to->file_pid = from->file_pid;
 	to->vuid = from->vuid;
@@ -33,12 +33,6 @@ extern struct smbd_dmapi_context *dmapi_ctx;
 /* how many write cache buffers have been allocated */
 extern unsigned int allocated_write_caches;
 
-/* A singleton cache to speed up searching by dev/inode. */
-struct fsp_singleton_cache {
-	files_struct *fsp;
-	struct file_id id;
-};
-
 extern const struct mangle_fns *mangle_fns;
 
 extern unsigned char *chartest;
@@ -109,6 +103,7 @@ extern bool exit_firsttime;
 
 struct tstream_context;
 struct smbd_smb2_request;
+struct pthreadpool;
 
 DATA_BLOB negprot_spnego(TALLOC_CTX *ctx, struct smbXsrv_connection *xconn);
 
@@ -452,6 +447,37 @@ struct smbXsrv_connection {
 		} request_read_state;
 		struct smbd_smb2_send_queue *send_queue;
 		size_t send_queue_len;
+		size_t send_queue_bytes;
+		/*
+		 * Used to coalesce the socket flush of responses
+		 * which complete within the same event loop wakeup
+		 * (e.g. a batch of finished aio reads) into one
+		 * pass over the send queue.
+		 */
+		struct tevent_immediate *flush_im;
+		bool flush_pending;
+		/*
+		 * How well the send queue flush manages to batch
+		 * responses into single writev calls on this
+		 * connection.
+		 */
+		struct {
+			uint64_t writev_calls;
+			uint64_t responses;
+			uint64_t max_batch;
+		} send_stats;
+		/*
+		 * Worker pool offloading the SMB3 transform
+		 * encryption of outgoing responses, created on first
+		 * use when "smbd:encryption threads" is non-zero.
+		 * See smbd_smb2_encrypt_pdu().
+		 */
+		struct {
+			struct pthreadpool *pool;
+			struct tevent_fd *fde;
+			int job_id;
+			bool init_failed;
+		} encrypt;
 
 		struct {
 			/*
@@ -497,6 +523,23 @@ struct smbXsrv_connection {
 			 */
 			struct bitmap *bitmap;
 			bool multicredit;
+			/*
+			 * The currently active credit window.
+			 *
+			 * Starts at 1/16th of max and is grown
+			 * or shrunk based on the measured request
+			 * service latency of this connection, so
+			 * fast clients get deep pipelines while
+			 * a connection we service slowly can't
+			 * queue up to the hard maximum.
+			 */
+			uint16_t window;
+			/*
+			 * Exponentially weighted moving average
+			 * of the request service time in
+			 * microseconds, feeding the window above.
+			 */
+			uint64_t avg_latency_usec;
 		} credits;
 
 		bool allow_2ff;
@@ -631,6 +674,25 @@ struct smbd_smb2_send_queue {
 	struct iovec *vector;
 	int count;
 
+	/*
+	 * While a pthreadpool worker runs the transform encryption
+	 * for this entry, "pending" is true and the send queue flush
+	 * must not touch the vectors of this entry or anything queued
+	 * behind it, see smbd_smb2_encrypt_pdu(). The worker only
+	 * writes "status"; the main thread reads it after the job
+	 * completion arrived on the pool's signal fd.
+	 */
+	struct {
+		int job_id;
+		bool pending;
+		uint16_t cipher;
+		uint8_t key_buf[16];
+		DATA_BLOB key;
+		struct iovec *vector;
+		int count;
+		NTSTATUS status;
+	} encrypt;
+
 	TALLOC_CTX *mem_ctx;
 };
 
@@ -658,6 +720,12 @@ struct smbd_smb2_request {
 	bool do_encryption;
 	struct tevent_timer *async_te;
 	bool compound_related;
+	/*
+	 * the number of related requests of the current
+	 * compound chain we already dispatched inline,
+	 * without going through the event loop.
+	 */
+	unsigned int pipeline_depth;
 
 	/*
 	 * the encryption key for the whole
@@ -819,9 +887,13 @@ struct smbd_server_connection {
 
 	size_t num_files;
 	struct files_struct *files;
+	/*
+	 * In-memory index mapping file_id to the chain of fsps
+	 * open on that file, see file_find_di_first().
+	 */
+	struct db_context *files_by_id;
 
 	int real_max_open_files;
-	struct fsp_singleton_cache fsp_fi_cache;
 
 	struct pending_message_list *deferred_open_queue;
 
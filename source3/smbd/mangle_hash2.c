@@ -94,6 +94,23 @@
 #define MANGLE_CACHE_SIZE 4096
 #endif
 
+/*
+ * The prefix cache is also mirrored into gencache, so a hash to
+ * prefix mapping computed by one smbd survives process restarts and
+ * is visible to every other smbd. Without it a fresh smbd cannot
+ * reverse an 8.3 name a client remembered from an earlier session
+ * and the caller has to fall back to scanning the directory.
+ *
+ * Writing to gencache costs a tdb store per new prefix, so we only
+ * start mirroring once a client has actually presented a mangled
+ * name - servers that never see a short name client never pay for
+ * the persistent store.
+ */
+#define MANGLE_PERSISTENT_PREFIX "MANGLEHASH2/"
+#define MANGLE_PERSISTENT_TIMEOUT (60*60*24*7)
+
+static bool seen_mangled_lookup;
+
 #define FNV1_PRIME 0x01000193
 /*the following number is a fnv1 of the string: idra@samba.org 2002 */
 #define FNV1_INIT  0xa6b93095
@@ -321,6 +338,16 @@ static void cache_insert(const char *prefix, int length, unsigned int hash)
 	memcache_add(smbd_memcache(), MANGLE_HASH2_CACHE,
 		     data_blob_const(&hash, sizeof(hash)),
 		     data_blob_const(str, length+1));
+
+	if (seen_mangled_lookup) {
+		char keystr[sizeof(MANGLE_PERSISTENT_PREFIX)+8];
+
+		snprintf(keystr, sizeof(keystr),
+			 MANGLE_PERSISTENT_PREFIX "%08X", hash);
+		gencache_set(keystr, str,
+			     time(NULL) + MANGLE_PERSISTENT_TIMEOUT);
+	}
+
 	SAFE_FREE(str);
 }
 
@@ -330,16 +357,30 @@ static void cache_insert(const char *prefix, int length, unsigned int hash)
 static char *cache_lookup(TALLOC_CTX *mem_ctx, unsigned int hash)
 {
 	DATA_BLOB value;
+	char keystr[sizeof(MANGLE_PERSISTENT_PREFIX)+8];
+	char *prefix = NULL;
+
+	if (memcache_lookup(smbd_memcache(), MANGLE_HASH2_CACHE,
+			    data_blob_const(&hash, sizeof(hash)), &value)) {
+		SMB_ASSERT((value.length > 0)
+			   && (value.data[value.length-1] == '\0'));
+
+		return talloc_strdup(mem_ctx, (char *)value.data);
+	}
 
-	if (!memcache_lookup(smbd_memcache(), MANGLE_HASH2_CACHE,
-			     data_blob_const(&hash, sizeof(hash)), &value)) {
+	/* Now try the persistent store another smbd may have filled. */
+	snprintf(keystr, sizeof(keystr),
+		 MANGLE_PERSISTENT_PREFIX "%08X", hash);
+	if (!gencache_get(keystr, mem_ctx, &prefix, NULL)) {
 		return NULL;
 	}
 
-	SMB_ASSERT((value.length > 0)
-		   && (value.data[value.length-1] == '\0'));
+	/* Re-prime the in-memory front. */
+	memcache_add(smbd_memcache(), MANGLE_HASH2_CACHE,
+		     data_blob_const(&hash, sizeof(hash)),
+		     data_blob_const(prefix, strlen(prefix)+1));
 
-	return talloc_strdup(mem_ctx, (char *)value.data);
+	return prefix;
 }
 
 
@@ -544,6 +585,10 @@ static bool lookup_name_from_8_3(TALLOC_CTX *ctx,
 		return False;
 	}
 
+	/* this client does use short names, start mirroring new
+	   prefixes into the persistent store */
+	seen_mangled_lookup = true;
+
 	/* we need to extract the hash from the 8.3 name */
 	hash = base_reverse[(unsigned char)name[7]];
 	for (multiplier=36, i=5;i>=mangle_prefix;i--) {
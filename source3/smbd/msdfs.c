@@ -1096,6 +1096,70 @@ NTSTATUS get_referred_path(TALLOC_CTX *ctx,
 	return status;
 }
 
+/******************************************************************
+ Cache of fully built referral response blobs.
+
+ DFS root servers answer thousands of identical referral requests
+ at login time, and each one re-reads the msdfs symlink and
+ re-builds and re-pushes the whole response. Cache the final wire
+ blob in gencache keyed by the (lowercased) requested path and the
+ referral level, with a configurable TTL
+ ("msdfs:referral cache timeout", seconds, default off).
+
+ Local junction changes through create_msdfs_link() and
+ remove_msdfs_link() bump a shared sequence number that is part of
+ every cache key, so all cached blobs go stale immediately.
+ Symlinks edited directly on the filesystem only age out via the
+ TTL.
+******************************************************************/
+
+#define MSDFS_REFERRAL_CACHE_PREFIX "MSDFS_REFERRAL_BLOB"
+#define MSDFS_REFERRAL_CACHE_SEQNUM MSDFS_REFERRAL_CACHE_PREFIX "/SEQNUM"
+
+static unsigned long msdfs_referral_cache_seqnum(void)
+{
+	char *value = NULL;
+	unsigned long seq = 0;
+
+	if (gencache_get(MSDFS_REFERRAL_CACHE_SEQNUM, talloc_tos(),
+			 &value, NULL)) {
+		seq = strtoul(value, NULL, 10);
+		TALLOC_FREE(value);
+	}
+	return seq;
+}
+
+static void msdfs_referral_cache_bump(void)
+{
+	char seqstr[32];
+
+	snprintf(seqstr, sizeof(seqstr), "%lu",
+		 msdfs_referral_cache_seqnum() + 1);
+	gencache_set(MSDFS_REFERRAL_CACHE_SEQNUM, seqstr,
+		     time(NULL) + 60*60*24*30);
+}
+
+static char *msdfs_referral_cache_key(TALLOC_CTX *ctx,
+				      const char *dfs_path,
+				      int max_referral_level)
+{
+	char *lowered = NULL;
+	char *key = NULL;
+
+	/* DFS paths are case-insensitive. */
+	lowered = strlower_talloc(ctx, dfs_path);
+	if (lowered == NULL) {
+		return NULL;
+	}
+	key = talloc_asprintf(ctx, "%s/%lu/%d/%s",
+			      MSDFS_REFERRAL_CACHE_PREFIX,
+			      msdfs_referral_cache_seqnum(),
+			      max_referral_level,
+			      lowered);
+	TALLOC_FREE(lowered);
+	return key;
+}
+
 /******************************************************************
  Set up the DFS referral for the dfs pathname. This call returns
  the amount of the path covered by this server, and where the
@@ -1114,6 +1178,35 @@ int setup_dfs_referral(connection_struct *orig_conn,
 	DATA_BLOB blob = data_blob_null;
 	NTSTATUS status;
 	enum ndr_err_code ndr_err;
+	int cache_timeout = lp_parm_int(SNUM(orig_conn), "msdfs",
+					"referral cache timeout", 0);
+	char *cache_key = NULL;
+
+	if (cache_timeout > 0) {
+		cache_key = msdfs_referral_cache_key(talloc_tos(), dfs_path,
+						     max_referral_level);
+	}
+	if (cache_key != NULL) {
+		DATA_BLOB cached = data_blob_null;
+
+		if (gencache_get_data_blob(cache_key, talloc_tos(),
+					   &cached, NULL, NULL)) {
+			pdata = (char *)SMB_REALLOC(pdata, cached.length);
+			if (pdata == NULL) {
+				data_blob_free(&cached);
+				TALLOC_FREE(cache_key);
+				*pstatus = NT_STATUS_NO_MEMORY;
+				return -1;
+			}
+			*ppdata = pdata;
+			reply_size = cached.length;
+			memcpy(pdata, cached.data, cached.length);
+			data_blob_free(&cached);
+			TALLOC_FREE(cache_key);
+			*pstatus = NT_STATUS_OK;
+			return reply_size;
+		}
+	}
 
 	r = talloc_zero(talloc_tos(), struct dfs_GetDFSReferral);
 	if (r == NULL) {
@@ -1155,6 +1248,13 @@ int setup_dfs_referral(connection_struct *orig_conn,
 	*ppdata = pdata;
 	reply_size = blob.length;
 	memcpy(pdata, blob.data, blob.length);
+
+	if (cache_key != NULL) {
+		gencache_set_data_blob(cache_key, &blob,
+				       time(NULL) + cache_timeout);
+		TALLOC_FREE(cache_key);
+	}
+
 	TALLOC_FREE(r);
 
 	*pstatus = NT_STATUS_OK;
@@ -1333,6 +1433,7 @@ bool create_msdfs_link(const struct junction_map *jucn)
 	}
 
 	ret = True;
+	msdfs_referral_cache_bump();
 
 out:
 	vfs_ChDir(conn, cwd);
@@ -1361,6 +1462,7 @@ bool remove_msdfs_link(const struct junction_map *jucn)
 
 	if( SMB_VFS_UNLINK(conn, smb_fname) == 0 ) {
 		ret = True;
+		msdfs_referral_cache_bump();
 	}
 
 	TALLOC_FREE(smb_fname);
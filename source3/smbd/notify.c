@@ -49,6 +49,12 @@ struct notify_change_buf {
 	 * list, because we have to append at the end and delete from the top.
 	 */
 	struct notify_change_request *requests;
+
+	/*
+	 * Pending flush timer when "smbd:notify batch time" holds
+	 * replies back to pack more events into one response.
+	 */
+	struct tevent_timer *flush_te;
 };
 
 struct notify_change_request {
@@ -504,11 +510,38 @@ void notify_fname(connection_struct *conn, uint32_t action, uint32_t filter,
 	notify_trigger(notify_ctx, action, filter, conn->connectpath, path);
 }
 
+static void notify_flush_handler(struct tevent_context *ev,
+				 struct tevent_timer *te,
+				 struct timeval now,
+				 void *private_data)
+{
+	files_struct *fsp = talloc_get_type_abort(private_data,
+						  struct files_struct);
+
+	fsp->notify->flush_te = NULL;
+
+	if (fsp->notify->requests == NULL) {
+		return;
+	}
+	if (fsp->notify->num_changes == 0) {
+		return;
+	}
+
+	change_notify_reply(fsp->notify->requests->req,
+			    NT_STATUS_OK,
+			    fsp->notify->requests->max_param,
+			    fsp->notify,
+			    fsp->notify->requests->reply_fn);
+
+	change_notify_remove_request(fsp->conn->sconn, fsp->notify->requests);
+}
+
 static void notify_fsp(files_struct *fsp, struct timespec when,
 		       uint32_t action, const char *name)
 {
 	struct notify_change_event *change, *changes;
 	char *tmp;
+	int batch_msecs;
 
 	if (fsp->notify == NULL) {
 		/*
@@ -582,6 +615,32 @@ static void notify_fsp(files_struct *fsp, struct timespec when,
 		return;
 	}
 
+	/*
+	 * A batch window packs all events arriving within it into one
+	 * response instead of completing the pending request with the
+	 * first event and having the client re-arm per file. Off by
+	 * default, the added latency is only worth it for workloads
+	 * generating notify storms.
+	 */
+	batch_msecs = lp_parm_int(SNUM(fsp->conn), "smbd",
+				  "notify batch time", 0);
+	if (batch_msecs > 0) {
+		if (fsp->notify->flush_te == NULL) {
+			fsp->notify->flush_te = tevent_add_timer(
+				fsp->conn->sconn->ev_ctx,
+				fsp->notify,
+				timeval_current_ofs_msec(batch_msecs),
+				notify_flush_handler,
+				fsp);
+			if (fsp->notify->flush_te == NULL) {
+				DEBUG(0, ("tevent_add_timer failed\n"));
+				goto reply_now;
+			}
+		}
+		return;
+	}
+
+reply_now:
 	if (action == NOTIFY_ACTION_OLD_NAME) {
 		/*
 		 * We have to send the two rename events in one reply. So hold
@@ -109,16 +109,44 @@ static bool filter_match(struct inotify_watch_context *w,
 
 
 
+/*
+  look for the IN_MOVED_TO half of a rename later in the same read
+  buffer. Unrelated events can be interleaved between the two halves
+  of a rename when the directory is busy, so an adjacency check is
+  not enough.
+*/
+static bool inotify_find_moved_to(struct inotify_event *e,
+				  struct inotify_event *first,
+				  int remaining)
+{
+	struct inotify_event *e2 = first;
+
+	while (e2 && (remaining >= sizeof(*e2))) {
+		if ((e2->mask & IN_MOVED_TO) &&
+		    (e2->cookie == e->cookie) &&
+		    (e2->wd == e->wd)) {
+			return true;
+		}
+		remaining -= e2->len + sizeof(*e2);
+		if (remaining < sizeof(*e2)) {
+			break;
+		}
+		e2 = (struct inotify_event *)(e2->len + sizeof(*e2) +
+					      (char *)e2);
+	}
+	return false;
+}
+
 /*
   dispatch one inotify event
 
-  the cookies are used to correctly handle renames
+  the handler has already paired up the two halves of a rename via
+  the cookies, we only get told the outcome here
 */
-static void inotify_dispatch(struct inotify_private *in, 
-			     struct inotify_event *e, 
-			     int prev_wd,
-			     uint32_t prev_cookie,
-			     struct inotify_event *e2)
+static void inotify_dispatch(struct inotify_private *in,
+			     struct inotify_event *e,
+			     bool moved_from_paired,
+			     bool moved_to_paired)
 {
 	struct inotify_watch_context *w, *next;
 	struct notify_event ne;
@@ -139,14 +167,13 @@ static void inotify_dispatch(struct inotify_private *in,
 	} else if (e->mask & IN_DELETE) {
 		ne.action = NOTIFY_ACTION_REMOVED;
 	} else if (e->mask & IN_MOVED_FROM) {
-		if (e2 != NULL && e2->cookie == e->cookie &&
-		    e2->wd == e->wd) {
+		if (moved_from_paired) {
 			ne.action = NOTIFY_ACTION_OLD_NAME;
 		} else {
 			ne.action = NOTIFY_ACTION_REMOVED;
 		}
 	} else if (e->mask & IN_MOVED_TO) {
-		if ((e->cookie == prev_cookie) && (e->wd == prev_wd)) {
+		if (moved_to_paired) {
 			ne.action = NOTIFY_ACTION_NEW_NAME;
 		} else {
 			ne.action = NOTIFY_ACTION_ADDED;
@@ -201,8 +228,9 @@ static void inotify_handler(struct tevent_context *ev, struct tevent_fd *fde,
 						     struct inotify_private);
 	int bufsize = 0;
 	struct inotify_event *e0, *e;
-	uint32_t prev_cookie=0;
-	int prev_wd = -1;
+	struct inotify_event *prev_e = NULL;
+	uint32_t *from_cookies = NULL;
+	size_t num_from_cookies = 0;
 	ssize_t ret;
 
 	/*
@@ -235,13 +263,68 @@ static void inotify_handler(struct tevent_context *ev, struct tevent_fd *fde,
 	/* we can get more than one event in the buffer */
 	while (e && (bufsize >= sizeof(*e))) {
 		struct inotify_event *e2 = NULL;
+		bool moved_from_paired = false;
+		bool moved_to_paired = false;
+
 		bufsize -= e->len + sizeof(*e);
 		if (bufsize >= sizeof(*e)) {
 			e2 = (struct inotify_event *)(e->len + sizeof(*e) + (char *)e);
 		}
-		inotify_dispatch(in, e, prev_wd, prev_cookie, e2);
-		prev_wd = e->wd;
-		prev_cookie = e->cookie;
+
+		if (e->mask & IN_MOVED_FROM) {
+			moved_from_paired = inotify_find_moved_to(e, e2,
+								  bufsize);
+			if (moved_from_paired) {
+				uint32_t *tmp = talloc_realloc(
+					e0, from_cookies, uint32_t,
+					num_from_cookies + 1);
+				if (tmp == NULL) {
+					/*
+					 * Degrade to the unpaired
+					 * REMOVED/ADDED pair
+					 */
+					moved_from_paired = false;
+				} else {
+					from_cookies = tmp;
+					from_cookies[num_from_cookies] =
+						e->cookie;
+					num_from_cookies += 1;
+				}
+			}
+		}
+		if (e->mask & IN_MOVED_TO) {
+			size_t i;
+
+			for (i=0; i<num_from_cookies; i++) {
+				if (from_cookies[i] == e->cookie) {
+					break;
+				}
+			}
+			if (i < num_from_cookies) {
+				moved_to_paired = true;
+				from_cookies[i] =
+					from_cookies[num_from_cookies-1];
+				num_from_cookies -= 1;
+			}
+		}
+
+		if ((prev_e != NULL) &&
+		    ((e->mask & (IN_ATTRIB|IN_MODIFY)) != 0) &&
+		    (e->mask == prev_e->mask) &&
+		    (e->wd == prev_e->wd) &&
+		    (e->len != 0) && (prev_e->len != 0) &&
+		    (strcmp(e->name, prev_e->name) == 0)) {
+			/*
+			 * Identical modify event on the file we just
+			 * delivered one for, as streaming writes
+			 * produce in bulk. Coalesce.
+			 */
+			e = e2;
+			continue;
+		}
+
+		inotify_dispatch(in, e, moved_from_paired, moved_to_paired);
+		prev_e = e;
 		e = e2;
 	}
 
@@ -40,6 +40,20 @@
 
 struct notifyd_peer;
 
+/*
+ * The entry and peer dbs can hold entries for every watched path of
+ * every client. Allocate their rbt nodes from a pool to avoid heap
+ * fragmentation from millions of small tallocs; overflow beyond the
+ * pool falls back to the heap.
+ */
+#define NOTIFYD_DB_POOL_SIZE (1024*1024)
+
+/*
+ * Watched paths deeper than this share the last slot of the fan-out
+ * index below.
+ */
+#define NOTIFYD_MAX_DEPTH 32
+
 /*
  * All of notifyd's state
  */
@@ -92,6 +106,17 @@ struct notifyd_state {
 
 	sys_notify_watch_fn sys_notify_watch;
 	struct sys_notify_context *sys_notify_ctx;
+
+	/*
+	 * Fan-out index: count of watched paths per path depth
+	 * (number of '/'-separated components), summed over our own
+	 * entries database and all peer databases. notifyd_trigger
+	 * walks every prefix of an event path; the index lets it
+	 * skip the database lookups for depths nobody watches at
+	 * all, which is most prefixes during bulk operations deep in
+	 * unwatched trees.
+	 */
+	uint32_t watched_depths[NOTIFYD_MAX_DEPTH];
 };
 
 /*
@@ -199,7 +224,7 @@ struct tevent_req *notifyd_send(TALLOC_CTX *mem_ctx, struct tevent_context *ev,
 	state->sys_notify_watch = sys_notify_watch;
 	state->sys_notify_ctx = sys_notify_ctx;
 
-	state->entries = db_open_rbt(state);
+	state->entries = db_open_rbt_pool(state, NOTIFYD_DB_POOL_SIZE);
 	if (tevent_req_nomem(state->entries, req)) {
 		return tevent_req_post(req, ev);
 	}
@@ -346,18 +371,46 @@ static bool notifyd_parse_entry(uint8_t *buf, size_t buflen,
 	return true;
 }
 
+static size_t notifyd_path_depth(const char *path, size_t pathlen)
+{
+	size_t i, depth = 0;
+
+	for (i=0; i<pathlen; i++) {
+		if (path[i] == '/') {
+			depth += 1;
+		}
+	}
+	if (depth >= NOTIFYD_MAX_DEPTH) {
+		depth = NOTIFYD_MAX_DEPTH - 1;
+	}
+	return depth;
+}
+
+static void notifyd_watched_depth_add(struct notifyd_state *state,
+				      const char *path, size_t pathlen,
+				      int delta)
+{
+	size_t depth = notifyd_path_depth(path, pathlen);
+
+	if ((delta < 0) && (state->watched_depths[depth] == 0)) {
+		DEBUG(1, ("%s: depth index underflow for %.*s\n",
+			  __func__, (int)pathlen, path));
+		return;
+	}
+	state->watched_depths[depth] += delta;
+}
+
 static bool notifyd_apply_rec_change(
 	const struct server_id *client,
 	const char *path, size_t pathlen,
 	const struct notify_instance *chg,
 	struct db_context *entries,
-	sys_notify_watch_fn sys_notify_watch,
-	struct sys_notify_context *sys_notify_ctx,
-	struct messaging_context *msg_ctx)
+	struct notifyd_state *state)
 {
 	struct db_record *rec;
 	struct notifyd_instance *instances;
 	size_t num_instances;
+	size_t orig_num_instances;
 	size_t i;
 	struct notifyd_instance *instance;
 	TDB_DATA value;
@@ -396,6 +449,7 @@ static bool notifyd_apply_rec_change(
 			goto fail;
 		}
 	}
+	orig_num_instances = num_instances;
 
 	/*
 	 * Overallocate by one instance to avoid a realloc when adding
@@ -444,10 +498,11 @@ static bool notifyd_apply_rec_change(
 
 		TALLOC_FREE(instance->sys_watch);
 
-		ret = sys_notify_watch(entries, sys_notify_ctx, path,
+		ret = state->sys_notify_watch(entries, state->sys_notify_ctx,
+				       path,
 				       &instance->internal_filter,
 				       &instance->internal_subdir_filter,
-				       notifyd_sys_callback, msg_ctx,
+				       notifyd_sys_callback, state->msg_ctx,
 				       &instance->sys_watch);
 		if (ret != 0) {
 			DEBUG(1, ("%s: inotify_watch returned %s\n",
@@ -486,6 +541,12 @@ static bool notifyd_apply_rec_change(
 		}
 	}
 
+	if ((orig_num_instances == 0) && (num_instances != 0)) {
+		notifyd_watched_depth_add(state, path, pathlen-1, 1);
+	} else if ((orig_num_instances != 0) && (num_instances == 0)) {
+		notifyd_watched_depth_add(state, path, pathlen-1, -1);
+	}
+
 	ok = true;
 fail:
 	TALLOC_FREE(rec);
@@ -571,8 +632,7 @@ static bool notifyd_rec_change(struct messaging_context *msg_ctx,
 
 	ok = notifyd_apply_rec_change(
 		&rec->src, msg->path, pathlen, &msg->instance,
-		state->entries, state->sys_notify_watch, state->sys_notify_ctx,
-		state->msg_ctx);
+		state->entries, state);
 	if (!ok) {
 		DEBUG(1, ("%s: notifyd_apply_rec_change failed, ignoring\n",
 			  __func__));
@@ -664,6 +724,15 @@ static bool notifyd_trigger(struct messaging_context *msg_ctx,
 		next_p = strchr(p+1, '/');
 		tstate.recursive = (next_p != NULL);
 
+		if (state->watched_depths[
+			    notifyd_path_depth(path, path_len)] == 0) {
+			/*
+			 * Nothing watched anywhere at this depth, no
+			 * point in doing the db lookups.
+			 */
+			continue;
+		}
+
 		DEBUG(10, ("%s: Trying path %.*s\n", __func__,
 			   (int)path_len, path));
 
@@ -913,9 +982,9 @@ static bool notifyd_got_db(struct messaging_context *msg_ctx,
 
 	p->rec_index = BVAL(rec->buf.data, 0);
 
-	p->db = db_open_rbt(p);
+	p->db = db_open_rbt_pool(p, NOTIFYD_DB_POOL_SIZE);
 	if (p->db == NULL) {
-		DEBUG(10, ("%s: db_open_rbt failed\n", __func__));
+		DEBUG(10, ("%s: db_open_rbt_pool failed\n", __func__));
 		TALLOC_FREE(p);
 		return true;
 	}
@@ -1182,11 +1251,15 @@ static int notifyd_add_proxy_syswatches(struct db_record *rec,
 		}
 	}
 
+	notifyd_watched_depth_add(state, path, key.dsize, 1);
+
 	return 0;
 }
 
 static int notifyd_db_del_syswatches(struct db_record *rec, void *private_data)
 {
+	struct notifyd_state *state = talloc_get_type_abort(
+		private_data, struct notifyd_state);
 	TDB_DATA key = dbwrap_record_get_key(rec);
 	TDB_DATA value = dbwrap_record_get_value(rec);
 	struct notifyd_instance *instances = NULL;
@@ -1204,6 +1277,10 @@ static int notifyd_db_del_syswatches(struct db_record *rec, void *private_data)
 	for (i=0; i<num_instances; i++) {
 		TALLOC_FREE(instances[i].sys_watch);
 	}
+
+	notifyd_watched_depth_add(state, (const char *)key.dptr,
+				  key.dsize, -1);
+
 	return 0;
 }
 
@@ -1212,7 +1289,7 @@ static int notifyd_peer_destructor(struct notifyd_peer *p)
 	struct notifyd_state *state = p->state;
 	size_t i;
 
-	dbwrap_traverse_read(p->db, notifyd_db_del_syswatches, NULL, NULL);
+	dbwrap_traverse_read(p->db, notifyd_db_del_syswatches, state, NULL);
 
 	for (i = 0; i<state->num_peers; i++) {
 		if (p == state->peers[i]) {
@@ -1312,9 +1389,7 @@ static void notifyd_apply_reclog(struct notifyd_peer *peer,
 
 		ok = notifyd_apply_rec_change(&r->src, chg->path, pathlen,
 					      &chg->instance, peer->db,
-					      state->sys_notify_watch,
-					      state->sys_notify_ctx,
-					      state->msg_ctx);
+					      state);
 		if (!ok) {
 			DEBUG(3, ("%s: notifyd_apply_rec_change failed\n",
 				  __func__));
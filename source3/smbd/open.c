@@ -978,7 +978,7 @@ static NTSTATUS open_file(files_struct *fsp,
 		return NT_STATUS_FILE_IS_A_DIRECTORY;
 	}
 
-	fsp->file_id = vfs_file_id_from_sbuf(conn, &smb_fname->st);
+	fsp_set_file_id(fsp, vfs_file_id_from_sbuf(conn, &smb_fname->st));
 	fsp->vuid = req ? req->vuid : UID_FIELD_INVALID;
 	fsp->file_pid = req ? req->smbpid : 0;
 	fsp->can_lock = True;
@@ -1769,13 +1769,20 @@ static NTSTATUS grant_fsp_oplock_type(struct smb_request *req,
 			oplock_request & ~SAMBA_PRIVATE_OPLOCK_MASK);
 	}
 
-	if (lp_locking(fsp->conn->params) && file_has_brlocks(fsp)) {
+	if ((granted & SMB2_LEASE_READ) &&
+	    lp_locking(fsp->conn->params) && file_has_brlocks(fsp)) {
 		DEBUG(10,("grant_fsp_oplock_type: file %s has byte range locks\n",
 			fsp_str_dbg(fsp)));
 		granted &= ~SMB2_LEASE_READ;
 	}
 
-	for (i=0; i<d->num_share_modes; i++) {
+	/*
+	 * If nothing is being granted, the walk over the existing
+	 * entries can only confirm that. Skip it: got_handle_lease
+	 * and got_oplock exist solely to downgrade a grant, and
+	 * create-heavy workloads open with NO_OPLOCK on every handle.
+	 */
+	for (i=0; (granted != SMB2_LEASE_NONE) && i<d->num_share_modes; i++) {
 		struct share_mode_entry *e = &d->share_modes[i];
 		uint32_t e_lease_type;
 
@@ -2699,7 +2706,7 @@ static NTSTATUS open_file_ntcreate(connection_struct *conn,
 		return NT_STATUS_ACCESS_DENIED;
 	}
 
-	fsp->file_id = vfs_file_id_from_sbuf(conn, &smb_fname->st);
+	fsp_set_file_id(fsp, vfs_file_id_from_sbuf(conn, &smb_fname->st));
 	fsp->share_access = share_access;
 	fsp->fh->private_options = private_flags;
 	fsp->access_mask = open_access_mask; /* We change this to the
@@ -3553,7 +3560,7 @@ static NTSTATUS open_directory(connection_struct *conn,
 	 * Setup the files_struct for it.
 	 */
 
-	fsp->file_id = vfs_file_id_from_sbuf(conn, &smb_dname->st);
+	fsp_set_file_id(fsp, vfs_file_id_from_sbuf(conn, &smb_dname->st));
 	fsp->vuid = req ? req->vuid : UID_FIELD_INVALID;
 	fsp->file_pid = req ? req->smbpid : 0;
 	fsp->can_lock = False;
@@ -524,6 +524,12 @@ NTSTATUS downgrade_lease(struct smbXsrv_connection *xconn,
 			TALLOC_FREE(lck);
 			return NT_STATUS_NO_MEMORY;
 		}
+		/*
+		 * Don't let the break notification queue behind bulk
+		 * work, clients time out on unanswered breaks.
+		 */
+		tevent_immediate_set_priority(state->im,
+					      TEVENT_PRIORITY_HIGH);
 
 		state->xconn = xconn;
 		if (l->current_state & (~SMB2_LEASE_READ)) {
@@ -1099,6 +1105,8 @@ static void contend_level2_oplocks_begin_default(files_struct *fsp,
 		TALLOC_FREE(state);
 		return;
 	}
+	/* oplock breaks must not wait behind bulk work */
+	tevent_immediate_set_priority(im, TEVENT_PRIORITY_HIGH);
 	tevent_schedule_immediate(im, sconn->ev_ctx, do_break_to_none, state);
 }
 
@@ -1124,6 +1132,7 @@ static void do_break_to_none(struct tevent_context *ctx,
 	uint32_t i;
 	struct share_mode_lock *lck;
 	struct share_mode_data *d;
+	bool *lease_visited = NULL;
 
 	lck = get_existing_share_mode_lock(talloc_tos(), state->id);
 	if (lck == NULL) {
@@ -1134,48 +1143,21 @@ static void do_break_to_none(struct tevent_context *ctx,
 	d = lck->data;
 
 	/*
-	 * Walk leases and oplocks separately: We have to send one break per
-	 * lease. If we have multiple share_mode_entry having a common lease,
-	 * we would break the lease twice if we don't walk the leases list
-	 * separately.
+	 * We have to send one break per lease, not one per share mode
+	 * entry: multiple entries can hold a common lease and we'd
+	 * break it twice. Mark the leases we've handled in a bitmap
+	 * instead of rescanning the whole entry array per lease - with
+	 * hundreds of level2 holders on a hot file that rescan turned
+	 * this walk quadratic.
 	 */
 
-	for (i=0; i<d->num_leases; i++) {
-		struct share_mode_lease *l = &d->leases[i];
-		struct share_mode_entry *e;
-		uint32_t j;
-
-		if ((l->current_state & SMB2_LEASE_READ) == 0) {
-			continue;
-		}
-		if (smb2_lease_equal(&state->client_guid,
-				     &state->lease_key,
-				     &l->client_guid,
-				     &l->lease_key)) {
-			DEBUG(10, ("Don't break our own lease\n"));
-			continue;
-		}
-
-		for (j=0; j<d->num_share_modes; j++) {
-			e = &d->share_modes[j];
-
-			if (!is_valid_share_mode_entry(e)) {
-				continue;
-			}
-			if (e->lease_idx == i) {
-				break;
-			}
-		}
-		if (j == d->num_share_modes) {
-			DEBUG(0, ("leases[%"PRIu32"] has no share mode\n",
-				  i));
-			continue;
+	if (d->num_leases != 0) {
+		lease_visited = talloc_zero_array(lck, bool, d->num_leases);
+		if (lease_visited == NULL) {
+			DEBUG(1, ("talloc failed\n"));
+			TALLOC_FREE(lck);
+			goto done;
 		}
-
-		DEBUG(10, ("Breaking lease# %"PRIu32" with share_entry# "
-			   "%"PRIu32"\n", i, j));
-
-		send_break_to_none(state->sconn->msg_ctx, e);
 	}
 
 	for(i = 0; i < d->num_share_modes; i++) {
@@ -1185,9 +1167,29 @@ static void do_break_to_none(struct tevent_context *ctx,
 			continue;
 		}
 		if (e->op_type == LEASE_OPLOCK) {
-			/*
-			 * Took care of those in the loop above
-			 */
+			struct share_mode_lease *l = &d->leases[e->lease_idx];
+
+			if (lease_visited[e->lease_idx]) {
+				continue;
+			}
+			lease_visited[e->lease_idx] = true;
+
+			if ((l->current_state & SMB2_LEASE_READ) == 0) {
+				continue;
+			}
+			if (smb2_lease_equal(&state->client_guid,
+					     &state->lease_key,
+					     &l->client_guid,
+					     &l->lease_key)) {
+				DEBUG(10, ("Don't break our own lease\n"));
+				continue;
+			}
+
+			DEBUG(10, ("Breaking lease# %"PRIu32" with "
+				   "share_entry# %"PRIu32"\n",
+				   e->lease_idx, i));
+
+			send_break_to_none(state->sconn->msg_ctx, e);
 			continue;
 		}
 
@@ -219,12 +219,19 @@ bool srv_send_smb(struct smbXsrv_connection *xconn, char *buffer,
 {
 	size_t len = 0;
 	ssize_t ret;
-	char *buf_out = buffer;
+	TALLOC_CTX *frame = talloc_stackframe();
+	struct iovec iov[2];
+	int iov_count = 1;
+	int i;
+
+	iov[0].iov_base = buffer;
+	iov[0].iov_len = smb_len_large(buffer) + 4;
 
 	if (!NT_STATUS_IS_OK(xconn->transport.status)) {
 		/*
 		 * we're not supposed to do any io
 		 */
+		TALLOC_FREE(frame);
 		return true;
 	}
 
@@ -232,11 +239,17 @@ bool srv_send_smb(struct smbXsrv_connection *xconn, char *buffer,
 
 	if (do_signing) {
 		/* Sign the outgoing packet if required. */
-		srv_calculate_sign_mac(xconn, buf_out, seqnum);
+		srv_calculate_sign_mac(xconn, buffer, seqnum);
 	}
 
 	if (do_encrypt) {
-		NTSTATUS status = srv_encrypt_buffer(xconn, buffer, &buf_out);
+		/*
+		 * The encrypted packet is written as a gather of the
+		 * 8 byte header and the wrapped payload, no copy of
+		 * the whole PDU into a fresh buffer needed.
+		 */
+		NTSTATUS status = srv_encrypt_buffer(xconn, buffer, frame,
+						     iov, &iov_count);
 		if (!NT_STATUS_IS_OK(status)) {
 			DEBUG(0, ("send_smb: SMB encryption failed "
 				"on outgoing packet! Error %s\n",
@@ -246,9 +259,11 @@ bool srv_send_smb(struct smbXsrv_connection *xconn, char *buffer,
 		}
 	}
 
-	len = smb_len_large(buf_out) + 4;
+	for (i = 0; i < iov_count; i++) {
+		len += iov[i].iov_len;
+	}
 
-	ret = write_data(xconn->transport.sock, buf_out, len);
+	ret = write_data_iov(xconn->transport.sock, iov, iov_count);
 	if (ret <= 0) {
 		int saved_errno = errno;
 		/*
@@ -260,17 +275,15 @@ bool srv_send_smb(struct smbXsrv_connection *xconn, char *buffer,
 			 smbXsrv_connection_dbg(xconn),
 			 (int)ret, strerror(saved_errno)));
 		errno = saved_errno;
-
-		srv_free_enc_buffer(xconn, buf_out);
 		goto out;
 	}
 
 	SMB_PERFCOUNT_SET_MSGLEN_OUT(pcd, len);
-	srv_free_enc_buffer(xconn, buf_out);
 out:
 	SMB_PERFCOUNT_END(pcd);
 
 	smbd_unlock_socket(xconn);
+	TALLOC_FREE(frame);
 	return (ret > 0);
 }
 
@@ -3794,6 +3807,45 @@ NTSTATUS smbd_add_connection(struct smbXsrv_client *client, int sock_fd,
 	return NT_STATUS_OK;
 }
 
+/*
+ * Optional instrumentation of the per-connection child startup cost.
+ * At debug level 6 every major init phase of smbd_process() is timed,
+ * so that during a connection storm it is easy to see where a child
+ * spends its time before it can serve the first SMB request.
+ */
+struct smbd_startup_profile {
+	bool enabled;
+	struct timeval start;
+	struct timeval last;
+};
+
+static void smbd_startup_profile_start(struct smbd_startup_profile *sp)
+{
+	sp->enabled = CHECK_DEBUGLVL(6);
+	if (!sp->enabled) {
+		return;
+	}
+	sp->start = timeval_current();
+	sp->last = sp->start;
+}
+
+static void smbd_startup_profile_phase(struct smbd_startup_profile *sp,
+				       const char *phase)
+{
+	struct timeval now;
+
+	if (!sp->enabled) {
+		return;
+	}
+	now = timeval_current();
+	DEBUG(6, ("smbd_process: init phase '%s' took %.3f msec "
+		  "(%.3f msec since start)\n",
+		  phase,
+		  timeval_elapsed2(&sp->last, &now) * 1000.0,
+		  timeval_elapsed2(&sp->start, &now) * 1000.0));
+	sp->last = now;
+}
+
 /****************************************************************************
  Process commands from the client
 ****************************************************************************/
@@ -3814,6 +3866,9 @@ void smbd_process(struct tevent_context *ev_ctx,
 	const char *remaddr = NULL;
 	int ret;
 	NTSTATUS status;
+	struct smbd_startup_profile sprof;
+
+	smbd_startup_profile_start(&sprof);
 
 	client = talloc_zero(ev_ctx, struct smbXsrv_client);
 	if (client == NULL) {
@@ -3923,14 +3978,21 @@ void smbd_process(struct tevent_context *ev_ctx,
 	/* this is needed so that we get decent entries
 	   in smbstatus for port 445 connects */
 	set_remote_machine_name(remaddr, false);
+
+	smbd_startup_profile_phase(&sprof, "connection setup");
+
 	reload_services(sconn, conn_snum_used, true);
 	sub_set_socket_ids(remaddr,
 			   sconn->remote_hostname,
 			   locaddr);
 
-	if (lp_preload_modules()) {
-		smb_load_modules(lp_preload_modules());
-	}
+	smbd_startup_profile_phase(&sprof, "service reload");
+
+	/*
+	 * Note: "preload modules" are loaded in the parent before the
+	 * fork, so that every child inherits them instead of paying
+	 * for dlopen() and module init on each connection.
+	 */
 
 	smb_perfcount_init();
 
@@ -3938,6 +4000,8 @@ void smbd_process(struct tevent_context *ev_ctx,
 		exit_server("Could not open account policy tdb.\n");
 	}
 
+	smbd_startup_profile_phase(&sprof, "account policy");
+
 	if (*lp_root_directory(talloc_tos())) {
 		if (chroot(lp_root_directory(talloc_tos())) != 0) {
 			DEBUG(0,("Failed to change root to %s\n",
@@ -3959,6 +4023,8 @@ void smbd_process(struct tevent_context *ev_ctx,
 	if (!init_oplocks(sconn))
 		exit_server("Failed to init oplocks");
 
+	smbd_startup_profile_phase(&sprof, "file/oplock init");
+
 	/* register our message handlers */
 	messaging_register(sconn->msg_ctx, sconn,
 			   MSG_SMB_FORCE_TDIS, msg_force_tdis);
@@ -3994,6 +4060,8 @@ void smbd_process(struct tevent_context *ev_ctx,
 	messaging_register(sconn->msg_ctx, NULL,
 			   MSG_DEBUG, debug_message);
 
+	smbd_startup_profile_phase(&sprof, "message handlers");
+
 	if ((lp_keepalive() != 0)
 	    && !(event_add_idle(ev_ctx, NULL,
 				timeval_set(lp_keepalive(), 0),
@@ -4023,6 +4091,8 @@ void smbd_process(struct tevent_context *ev_ctx,
 		exit_server("init_dptrs() failed");
 	}
 
+	smbd_startup_profile_phase(&sprof, "event/dirptr setup");
+
 	TALLOC_FREE(trace_state.frame);
 
 	tevent_set_trace_callback(ev_ctx, smbd_tevent_trace_callback,
@@ -197,6 +197,9 @@ void dptr_CloseDir(files_struct *fsp);
 void dptr_SeekDir(struct dptr_struct *dptr, long offset);
 long dptr_TellDir(struct dptr_struct *dptr);
 bool dptr_has_wild(struct dptr_struct *dptr);
+struct ms_fnmatch_compiled *dptr_get_compiled_wcard(struct dptr_struct *dptr,
+						    const char *mask,
+						    bool is_case_sensitive);
 int dptr_dnum(struct dptr_struct *dptr);
 bool dptr_get_priv(struct dptr_struct *dptr);
 void dptr_set_priv(struct dptr_struct *dptr);
@@ -253,6 +256,7 @@ uint32_t dos_mode_msdfs(connection_struct *conn,
 		      const struct smb_filename *smb_fname);
 int dos_attributes_to_stat_dos_flags(uint32_t dosmode);
 uint32_t dos_mode(connection_struct *conn, struct smb_filename *smb_fname);
+uint32_t fsp_dos_mode(struct files_struct *fsp);
 int file_set_dosmode(connection_struct *conn, struct smb_filename *smb_fname,
 		     uint32_t dosmode, const char *parent_dir, bool newfile);
 NTSTATUS file_set_sparse(connection_struct *conn,
@@ -389,6 +393,7 @@ NTSTATUS file_name_hash(connection_struct *conn,
 			const char *name, uint32_t *p_name_hash);
 NTSTATUS fsp_set_smb_fname(struct files_struct *fsp,
 			   const struct smb_filename *smb_fname_in);
+void fsp_set_file_id(struct files_struct *fsp, struct file_id id);
 const struct GUID *fsp_client_guid(const files_struct *fsp);
 uint32_t fsp_lease_type(struct files_struct *fsp);
 
@@ -958,10 +963,11 @@ void reply_getattrE(struct smb_request *req);
 /* The following definitions come from smbd/seal.c  */
 
 bool is_encrypted_packet(const uint8_t *inbuf);
-void srv_free_enc_buffer(struct smbXsrv_connection *xconn, char *buf);
 NTSTATUS srv_decrypt_buffer(struct smbXsrv_connection *xconn, char *buf);
 NTSTATUS srv_encrypt_buffer(struct smbXsrv_connection *xconn, char *buf,
-			    char **buf_out);
+			    TALLOC_CTX *mem_ctx,
+			    struct iovec iov_out[2],
+			    int *iov_count);
 NTSTATUS srv_request_encryption_setup(connection_struct *conn,
 					unsigned char **ppdata,
 					size_t *p_data_size,
@@ -1054,7 +1060,7 @@ ssize_t message_push_string(uint8_t **outbuf, const char *str, int flags);
 
 void stat_cache_add( const char *full_orig_name,
 		char *translated_path,
-		bool case_sensitive);
+		connection_struct *conn);
 bool stat_cache_lookup(connection_struct *conn,
 			bool posix_paths,
 			char **pp_name,
@@ -163,7 +163,7 @@ static NTSTATUS set_nt_acl_conn(const char *fname,
 		return map_nt_error_from_unix(errno);
 	}
 
-	fsp->file_id = vfs_file_id_from_sbuf(conn, &smb_fname->st);
+	fsp_set_file_id(fsp, vfs_file_id_from_sbuf(conn, &smb_fname->st));
 	fsp->vuid = UID_FIELD_INVALID;
 	fsp->file_pid = 0;
 	fsp->can_lock = True;
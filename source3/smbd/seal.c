@@ -130,25 +130,6 @@ static NTSTATUS make_srv_encryption_context(const struct tsocket_address *remote
 	return NT_STATUS_OK;
 }
 
-/******************************************************************************
- Free an encryption-allocated buffer.
-******************************************************************************/
-
-void srv_free_enc_buffer(struct smbXsrv_connection *xconn, char *buf)
-{
-	/* We know this is an smb buffer, and we
-	 * didn't malloc, only copy, for a keepalive,
-	 * so ignore non-session messages. */
-
-	if(CVAL(buf,0)) {
-		return;
-	}
-
-	if (srv_trans_enc_ctx) {
-		common_free_enc_buffer(srv_trans_enc_ctx, buf);
-	}
-}
-
 /******************************************************************************
  Decrypt an incoming buffer.
 ******************************************************************************/
@@ -168,24 +149,26 @@ NTSTATUS srv_decrypt_buffer(struct smbXsrv_connection *xconn, char *buf)
 }
 
 /******************************************************************************
- Encrypt an outgoing buffer. Return the encrypted pointer in buf_out.
+ Encrypt an outgoing buffer. On return iov_out holds *iov_count entries
+ making up the wire packet; any memory they need is allocated off mem_ctx.
 ******************************************************************************/
 
 NTSTATUS srv_encrypt_buffer(struct smbXsrv_connection *xconn, char *buf,
-			    char **buf_out)
+			    TALLOC_CTX *mem_ctx,
+			    struct iovec iov_out[2],
+			    int *iov_count)
 {
-	*buf_out = buf;
-
 	/* Ignore non-session messages. */
-	if(CVAL(buf,0)) {
+	if (CVAL(buf,0) || srv_trans_enc_ctx == NULL) {
+		/* Not encrypting. */
+		iov_out[0].iov_base = buf;
+		iov_out[0].iov_len = smb_len_large(buf) + 4;
+		*iov_count = 1;
 		return NT_STATUS_OK;
 	}
 
-	if (srv_trans_enc_ctx) {
-		return common_encrypt_buffer(srv_trans_enc_ctx, buf, buf_out);
-	}
-	/* Not encrypting. */
-	return NT_STATUS_OK;
+	return common_encrypt_buffer(srv_trans_enc_ctx, mem_ctx, buf,
+				     iov_out, iov_count);
 }
 
 /******************************************************************************
@@ -35,6 +35,7 @@
 #include "printing/queue_process.h"
 #include "rpc_server/rpc_service_setup.h"
 #include "rpc_server/rpc_config.h"
+#include "rpc_server/srv_pipe.h"
 #include "serverid.h"
 #include "passdb.h"
 #include "auth.h"
@@ -234,6 +235,57 @@ static void smbd_msg_debug(struct messaging_context *msg_ctx,
 	messaging_send_to_children(msg_ctx, MSG_DEBUG, data);
 }
 
+/*
+ * Report the schannel session store cache counters of this process.
+ * Queried via "smbcontrol <dest> schannel-stats".
+ */
+
+static void smbd_msg_schannel_stats(struct messaging_context *msg_ctx,
+				    void *private_data,
+				    uint32_t msg_type,
+				    struct server_id server_id,
+				    DATA_BLOB *data)
+{
+	uint64_t hits, misses;
+	char *report;
+
+	schannel_store_cache_stats(&hits, &misses);
+
+	report = talloc_asprintf(msg_ctx,
+				 "schannel store cache: %ju hits, %ju misses\n",
+				 (uintmax_t)hits, (uintmax_t)misses);
+	if (report != NULL) {
+		messaging_send_buf(msg_ctx, server_id, MSG_SCHANNEL_STATS,
+				   (uint8_t *)report,
+				   talloc_get_size(report)-1);
+	}
+
+	talloc_free(report);
+}
+
+/*
+ * Report the per-opnum RPC call statistics of this process.
+ * Queried via "smbcontrol <dest> rpc-stats".
+ */
+
+static void smbd_msg_rpc_stats(struct messaging_context *msg_ctx,
+			       void *private_data,
+			       uint32_t msg_type,
+			       struct server_id server_id,
+			       DATA_BLOB *data)
+{
+	char *report;
+
+	report = rpc_stats_report(msg_ctx);
+	if (report != NULL) {
+		messaging_send_buf(msg_ctx, server_id, MSG_RPC_STATS,
+				   (uint8_t *)report,
+				   talloc_get_size(report)-1);
+	}
+
+	talloc_free(report);
+}
+
 static void smbd_parent_id_cache_kill(struct messaging_context *msg_ctx,
 				      void *private_data,
 				      uint32_t msg_type,
@@ -909,6 +961,10 @@ static bool open_sockets_smbd(struct smbd_parent_context *parent,
 			   smb_parent_send_to_children);
 	messaging_register(msg_ctx, NULL, MSG_SMB_TELL_NUM_CHILDREN,
 			   smb_tell_num_children);
+	messaging_register(msg_ctx, NULL, MSG_REQ_SCHANNEL_STATS,
+			   smbd_msg_schannel_stats);
+	messaging_register(msg_ctx, NULL, MSG_REQ_RPC_STATS,
+			   smbd_msg_rpc_stats);
 
 	messaging_register(msg_ctx, NULL,
 			   ID_CACHE_DELETE, smbd_parent_id_cache_delete);
@@ -1508,6 +1564,14 @@ extern void build_options(bool screen);
 		exit_daemon("ERROR: failed to load share info db.", EACCES);
 	}
 
+	/* Load the "preload modules" here in the parent, so that the
+	   forked children inherit the already mapped and initialized
+	   modules instead of doing dlopen() and module init on every
+	   single connection. */
+	if (lp_preload_modules()) {
+		smb_load_modules(lp_preload_modules());
+	}
+
 	status = init_system_session_info();
 	if (!NT_STATUS_IS_OK(status)) {
 		DEBUG(1, ("ERROR: failed to setup system user info: %s.\n",
@@ -431,6 +431,44 @@ static NTSTATUS fsctl_qar(TALLOC_CTX *mem_ctx,
 	return NT_STATUS_OK;
 }
 
+/*
+ * FSCTL_SAMBA_FILE_SHA512: server side hashing for dedup and audit
+ * tools, saves copying the file over the wire just to checksum it.
+ *
+ * Input is either empty (hash the whole file) or 16 bytes: the start
+ * offset and the number of bytes to hash, both uint64 little endian.
+ * A length of zero means "from offset to end of file". Output is 8
+ * bytes with the number of bytes hashed followed by the 64 byte
+ * SHA-512 of that range. The digest is computed by the VFS on a
+ * helper thread, see SMB_VFS_HASH_FILE_SEND().
+ */
+static void smb2_ioctl_file_sha512_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smbd_smb2_ioctl_state *state = tevent_req_data(
+		req, struct smbd_smb2_ioctl_state);
+	uint8_t digest[64];
+	off_t hashed = 0;
+	NTSTATUS status;
+
+	status = SMB_VFS_HASH_FILE_RECV(state->fsp->conn, subreq,
+					digest, &hashed);
+	TALLOC_FREE(subreq);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+
+	state->out_output = data_blob_talloc(state, NULL, 8 + 64);
+	if (tevent_req_nomem(state->out_output.data, req)) {
+		return;
+	}
+	SBVAL(state->out_output.data, 0, hashed);
+	memcpy(state->out_output.data + 8, digest, sizeof(digest));
+
+	tevent_req_done(req);
+}
+
 struct tevent_req *smb2_ioctl_filesys(uint32_t ctl_code,
 				      struct tevent_context *ev,
 				      struct tevent_req *req,
@@ -474,6 +512,45 @@ struct tevent_req *smb2_ioctl_filesys(uint32_t ctl_code,
 		}
 		return tevent_req_post(req, ev);
 		break;
+	case FSCTL_SAMBA_FILE_SHA512: {
+		struct tevent_req *subreq;
+		off_t offset = 0;
+		off_t num = 0;
+
+		if (state->fsp == NULL) {
+			tevent_req_nterror(req, NT_STATUS_FILE_CLOSED);
+			return tevent_req_post(req, ev);
+		}
+
+		/* READ_DATA permission is required */
+		status = check_access(state->fsp->conn, state->fsp, NULL,
+				      FILE_READ_DATA);
+		if (tevent_req_nterror(req, status)) {
+			return tevent_req_post(req, ev);
+		}
+
+		if (state->in_input.length == 16) {
+			offset = BVAL(state->in_input.data, 0);
+			num = BVAL(state->in_input.data, 8);
+		} else if (state->in_input.length != 0) {
+			tevent_req_nterror(req, NT_STATUS_INVALID_PARAMETER);
+			return tevent_req_post(req, ev);
+		}
+
+		if (state->in_max_output < 8 + 64) {
+			tevent_req_nterror(req, NT_STATUS_INVALID_USER_BUFFER);
+			return tevent_req_post(req, ev);
+		}
+
+		subreq = SMB_VFS_HASH_FILE_SEND(state->fsp->conn, state, ev,
+						state->fsp, offset, num);
+		if (tevent_req_nomem(subreq, req)) {
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_set_callback(subreq, smb2_ioctl_file_sha512_done,
+					req);
+		return req;
+	}
 	default: {
 		uint8_t *out_data = NULL;
 		uint32_t out_data_len = 0;
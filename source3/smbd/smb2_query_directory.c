@@ -197,6 +197,219 @@ struct smbd_smb2_query_directory_state {
 	DATA_BLOB out_output_buffer;
 };
 
+#define DIR_ENTRY_SAFETY_MARGIN 4096
+
+/*
+ * One marshalled QUERY_DIRECTORY response built ahead of the next
+ * continuation request on a directory handle. Filled after a reply
+ * has been generated, so the directory scan and the per-entry stat
+ * calls for the following buffer overlap with the network round
+ * trip to the client.
+ */
+struct smb2_query_directory_readahead {
+	bool valid;
+	uint8_t info_class;
+	uint32_t buffer_length;
+	char *wcard;
+	/*
+	 * The dptr offset before the readahead scan, so we can
+	 * rewind if the next request doesn't match the cached
+	 * buffer.
+	 */
+	long rewind_offset;
+	NTSTATUS status;
+	DATA_BLOB buf;
+};
+
+/*
+ * Marshall one QUERY_DIRECTORY result buffer from the current dptr
+ * position. Returns NT_STATUS_OK with at least one entry in *_out,
+ * NT_STATUS_INFO_LENGTH_MISMATCH if not even one entry fit, or the
+ * dirptr status (e.g. NT_STATUS_NO_SUCH_FILE) on an empty result.
+ */
+static NTSTATUS smb2_query_directory_fill(TALLOC_CTX *mem_ctx,
+					  connection_struct *conn,
+					  struct smb_request *smbreq,
+					  struct files_struct *fsp,
+					  const char *in_file_name,
+					  uint32_t dirtype,
+					  int info_level,
+					  bool dont_descend,
+					  bool ask_sharemode,
+					  uint32_t in_output_buffer_length,
+					  uint32_t max_count,
+					  DATA_BLOB *_out)
+{
+	DATA_BLOB out;
+	char *pdata;
+	char *base_data;
+	char *end_data;
+	int last_entry_off = 0;
+	int off = 0;
+	uint32_t num = 0;
+	NTSTATUS status;
+
+	out = data_blob_talloc(mem_ctx, NULL,
+			in_output_buffer_length + DIR_ENTRY_SAFETY_MARGIN);
+	if (out.data == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	out.length = 0;
+
+	pdata = (char *)out.data;
+	base_data = pdata;
+	/*
+	 * end_data must include the safety margin as it's what is
+	 * used to determine if pushed strings have been truncated.
+	 */
+	end_data = pdata + in_output_buffer_length + DIR_ENTRY_SAFETY_MARGIN - 1;
+
+	while (true) {
+		bool got_exact_match = false;
+		int space_remaining = in_output_buffer_length - off;
+
+		SMB_ASSERT(space_remaining >= 0);
+
+		status = smbd_dirptr_lanman2_entry(mem_ctx,
+					       conn,
+					       fsp->dptr,
+					       smbreq->flags2,
+					       in_file_name,
+					       dirtype,
+					       info_level,
+					       false, /* requires_resume_key */
+					       dont_descend,
+					       ask_sharemode,
+					       8, /* align to 8 bytes */
+					       false, /* no padding */
+					       &pdata,
+					       base_data,
+					       end_data,
+					       space_remaining,
+					       &got_exact_match,
+					       &last_entry_off,
+					       NULL);
+
+		off = (int)PTR_DIFF(pdata, base_data);
+
+		if (!NT_STATUS_IS_OK(status)) {
+			if (NT_STATUS_EQUAL(status, NT_STATUS_ILLEGAL_CHARACTER)) {
+				/*
+				 * Bad character conversion on name. Ignore this
+				 * entry.
+				 */
+				continue;
+			}
+			if (num > 0) {
+				break;
+			}
+			data_blob_free(&out);
+			if (NT_STATUS_EQUAL(status, STATUS_MORE_ENTRIES)) {
+				return NT_STATUS_INFO_LENGTH_MISMATCH;
+			}
+			return status;
+		}
+
+		num++;
+		out.length = off;
+
+		if (num < max_count) {
+			continue;
+		}
+		break;
+	}
+
+	SIVAL(out.data, last_entry_off, 0);
+	*_out = out;
+	return NT_STATUS_OK;
+}
+
+/*
+ * Drop a pending readahead buffer and rewind the dptr to where it
+ * was before the readahead scan, so a non-matching request starts
+ * enumerating from the correct position.
+ */
+static void smb2_query_directory_readahead_reset(struct files_struct *fsp)
+{
+	struct smb2_query_directory_readahead *ra = fsp->dir_readahead;
+
+	if (ra == NULL || !ra->valid) {
+		return;
+	}
+
+	ra->valid = false;
+	data_blob_free(&ra->buf);
+	TALLOC_FREE(ra->wcard);
+
+	if (fsp->dptr != NULL) {
+		dptr_SeekDir(fsp->dptr, ra->rewind_offset);
+	}
+}
+
+/*
+ * Build the response for the expected next continuation request
+ * while the current reply is in flight.
+ */
+static void smb2_query_directory_readahead_fill(connection_struct *conn,
+						struct smb_request *smbreq,
+						struct files_struct *fsp,
+						const char *in_file_name,
+						uint32_t dirtype,
+						int info_level,
+						uint8_t in_file_info_class,
+						bool dont_descend,
+						bool ask_sharemode,
+						uint32_t in_output_buffer_length)
+{
+	struct smb2_query_directory_readahead *ra = fsp->dir_readahead;
+	NTSTATUS status;
+
+	if (!lp_parm_bool(SNUM(conn), "smbd",
+			  "query directory readahead", true)) {
+		return;
+	}
+
+	if (ra == NULL) {
+		ra = talloc_zero(fsp, struct smb2_query_directory_readahead);
+		if (ra == NULL) {
+			return;
+		}
+		fsp->dir_readahead = ra;
+	} else {
+		ra->valid = false;
+		data_blob_free(&ra->buf);
+		TALLOC_FREE(ra->wcard);
+	}
+
+	ra->wcard = talloc_strdup(ra, in_file_name);
+	if (ra->wcard == NULL) {
+		return;
+	}
+
+	ra->rewind_offset = dptr_TellDir(fsp->dptr);
+
+	status = smb2_query_directory_fill(ra,
+					   conn,
+					   smbreq,
+					   fsp,
+					   in_file_name,
+					   dirtype,
+					   info_level,
+					   dont_descend,
+					   ask_sharemode,
+					   in_output_buffer_length,
+					   UINT16_MAX,
+					   &ra->buf);
+	if (NT_STATUS_EQUAL(status, NT_STATUS_NO_MEMORY)) {
+		return;
+	}
+
+	ra->info_class = in_file_info_class;
+	ra->buffer_length = in_output_buffer_length;
+	ra->status = status;
+	ra->valid = true;
+}
+
 static struct tevent_req *smbd_smb2_query_directory_send(TALLOC_CTX *mem_ctx,
 					      struct tevent_context *ev,
 					      struct smbd_smb2_request *smb2req,
@@ -216,12 +429,7 @@ static struct tevent_req *smbd_smb2_query_directory_send(TALLOC_CTX *mem_ctx,
 	NTSTATUS empty_status;
 	uint32_t info_level;
 	uint32_t max_count;
-	char *pdata;
-	char *base_data;
-	char *end_data;
-	int last_entry_off = 0;
-	int off = 0;
-	uint32_t num = 0;
+	struct smb2_query_directory_readahead *ra = NULL;
 	uint32_t dirtype = FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_DIRECTORY;
 	bool dont_descend = false;
 	bool ask_sharemode = true;
@@ -322,6 +530,7 @@ static struct tevent_req *smbd_smb2_query_directory_send(TALLOC_CTX *mem_ctx,
 	}
 
 	if (in_flags & SMB2_CONTINUE_FLAG_REOPEN) {
+		smb2_query_directory_readahead_reset(fsp);
 		dptr_CloseDir(fsp);
 	}
 
@@ -389,6 +598,7 @@ static struct tevent_req *smbd_smb2_query_directory_send(TALLOC_CTX *mem_ctx,
 	}
 
 	if (in_flags & SMB2_CONTINUE_FLAG_RESTART) {
+		smb2_query_directory_readahead_reset(fsp);
 		dptr_SeekDir(fsp->dptr, 0);
 	}
 
@@ -398,26 +608,6 @@ static struct tevent_req *smbd_smb2_query_directory_send(TALLOC_CTX *mem_ctx,
 		max_count = UINT16_MAX;
 	}
 
-#define DIR_ENTRY_SAFETY_MARGIN 4096
-
-	state->out_output_buffer = data_blob_talloc(state, NULL,
-			in_output_buffer_length + DIR_ENTRY_SAFETY_MARGIN);
-	if (tevent_req_nomem(state->out_output_buffer.data, req)) {
-		return tevent_req_post(req, ev);
-	}
-
-	state->out_output_buffer.length = 0;
-	pdata = (char *)state->out_output_buffer.data;
-	base_data = pdata;
-	/*
-	 * end_data must include the safety margin as it's what is
-	 * used to determine if pushed strings have been truncated.
-	 */
-	end_data = pdata + in_output_buffer_length + DIR_ENTRY_SAFETY_MARGIN - 1;
-	last_entry_off = 0;
-	off = 0;
-	num = 0;
-
 	DEBUG(8,("smbd_smb2_query_directory_send: dirpath=<%s> dontdescend=<%s>, "
 		"in_output_buffer_length = %u\n",
 		fsp->fsp_name->base_name, lp_dont_descend(talloc_tos(), SNUM(conn)),
@@ -431,67 +621,98 @@ static struct tevent_req *smbd_smb2_query_directory_send(TALLOC_CTX *mem_ctx,
 				     "smbd", "search ask sharemode",
 				     true);
 
-	while (true) {
-		bool got_exact_match = false;
-		int space_remaining = in_output_buffer_length - off;
-
-		SMB_ASSERT(space_remaining >= 0);
-
-		status = smbd_dirptr_lanman2_entry(state,
-					       conn,
-					       fsp->dptr,
-					       smbreq->flags2,
-					       in_file_name,
-					       dirtype,
-					       info_level,
-					       false, /* requires_resume_key */
-					       dont_descend,
-					       ask_sharemode,
-					       8, /* align to 8 bytes */
-					       false, /* no padding */
-					       &pdata,
-					       base_data,
-					       end_data,
-					       space_remaining,
-					       &got_exact_match,
-					       &last_entry_off,
-					       NULL);
+	ra = fsp->dir_readahead;
+	if (ra != NULL && ra->valid &&
+	    (in_flags & (SMB2_CONTINUE_FLAG_RESTART |
+			 SMB2_CONTINUE_FLAG_REOPEN |
+			 SMB2_CONTINUE_FLAG_SINGLE)) == 0 &&
+	    ra->info_class == in_file_info_class &&
+	    ra->buffer_length == in_output_buffer_length &&
+	    strequal(ra->wcard, in_file_name)) {
+		NTSTATUS ra_status = ra->status;
 
-		off = (int)PTR_DIFF(pdata, base_data);
+		/*
+		 * Serve this continuation request from the buffer we
+		 * marshalled while the previous reply was in flight.
+		 */
+		ra->valid = false;
 
-		if (!NT_STATUS_IS_OK(status)) {
-			if (NT_STATUS_EQUAL(status, NT_STATUS_ILLEGAL_CHARACTER)) {
-				/*
-				 * Bad character conversion on name. Ignore this
-				 * entry.
-				 */
-				continue;
-			} else if (num > 0) {
-				SIVAL(state->out_output_buffer.data, last_entry_off, 0);
-				tevent_req_done(req);
-				return tevent_req_post(req, ev);
-			} else if (NT_STATUS_EQUAL(status, STATUS_MORE_ENTRIES)) {
-				tevent_req_nterror(req, NT_STATUS_INFO_LENGTH_MISMATCH);
-				return tevent_req_post(req, ev);
-			} else {
-				tevent_req_nterror(req, empty_status);
-				return tevent_req_post(req, ev);
-			}
+		if (NT_STATUS_EQUAL(ra_status, NT_STATUS_INFO_LENGTH_MISMATCH)) {
+			tevent_req_nterror(req, ra_status);
+			return tevent_req_post(req, ev);
 		}
-
-		num++;
-		state->out_output_buffer.length = off;
-
-		if (num < max_count) {
-			continue;
+		if (!NT_STATUS_IS_OK(ra_status)) {
+			tevent_req_nterror(req, empty_status);
+			return tevent_req_post(req, ev);
 		}
 
-		SIVAL(state->out_output_buffer.data, last_entry_off, 0);
+		state->out_output_buffer = ra->buf;
+		talloc_steal(state, state->out_output_buffer.data);
+		ra->buf = data_blob_null;
+
+		smb2_query_directory_readahead_fill(conn,
+						    smbreq,
+						    fsp,
+						    in_file_name,
+						    dirtype,
+						    info_level,
+						    in_file_info_class,
+						    dont_descend,
+						    ask_sharemode,
+						    in_output_buffer_length);
+
 		tevent_req_done(req);
 		return tevent_req_post(req, ev);
 	}
 
-	tevent_req_nterror(req, NT_STATUS_INTERNAL_ERROR);
+	/*
+	 * A stale readahead buffer (different info class, buffer
+	 * size or search pattern) has to be thrown away and the
+	 * dptr rewound before we enumerate.
+	 */
+	smb2_query_directory_readahead_reset(fsp);
+
+	status = smb2_query_directory_fill(state,
+					   conn,
+					   smbreq,
+					   fsp,
+					   in_file_name,
+					   dirtype,
+					   info_level,
+					   dont_descend,
+					   ask_sharemode,
+					   in_output_buffer_length,
+					   max_count,
+					   &state->out_output_buffer);
+	if (NT_STATUS_EQUAL(status, NT_STATUS_NO_MEMORY) ||
+	    NT_STATUS_EQUAL(status, NT_STATUS_INFO_LENGTH_MISMATCH)) {
+		tevent_req_nterror(req, status);
+		return tevent_req_post(req, ev);
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		tevent_req_nterror(req, empty_status);
+		return tevent_req_post(req, ev);
+	}
+
+	/*
+	 * Marshall the next buffer while this reply travels to the
+	 * client, except for single-entry requests which would
+	 * never use it.
+	 */
+	if (max_count != 1) {
+		smb2_query_directory_readahead_fill(conn,
+						    smbreq,
+						    fsp,
+						    in_file_name,
+						    dirtype,
+						    info_level,
+						    in_file_info_class,
+						    dont_descend,
+						    ask_sharemode,
+						    in_output_buffer_length);
+	}
+
+	tevent_req_done(req);
 	return tevent_req_post(req, ev);
 }
 
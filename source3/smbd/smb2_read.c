@@ -28,6 +28,12 @@
 #include "rpc_server/srv_pipe_hnd.h"
 #include "lib/sys_rw_data.h"
 
+/*
+ * Reads of at least this size try the zero-copy sendfile
+ * response path before falling back to a buffered read.
+ */
+#define SMB2_READ_SENDFILE_MIN_SIZE (64*1024)
+
 static struct tevent_req *smbd_smb2_read_send(TALLOC_CTX *mem_ctx,
 					      struct tevent_context *ev,
 					      struct smbd_smb2_request *smb2req,
@@ -506,6 +512,40 @@ static struct tevent_req *smbd_smb2_read_send(TALLOC_CTX *mem_ctx,
 		return tevent_req_post(req, ev);
 	}
 
+	/*
+	 * For large reads try a zero-copy sendfile response first.
+	 * The aio read path below bounces the data through a talloc'd
+	 * buffer, which dominates smbd cpu time on streaming
+	 * workloads. schedule_smb2_sendfile_read() checks all the
+	 * conditions (signing, encryption, compound chains, streams,
+	 * ...) under which we must not do this and returns
+	 * NT_STATUS_RETRY to fall back to the copying paths.
+	 */
+	if (in_length >= SMB2_READ_SENDFILE_MIN_SIZE) {
+		init_strict_lock_struct(fsp,
+					fsp->op->global->open_persistent_id,
+					in_offset,
+					in_length,
+					READ_LOCK,
+					&lock);
+
+		if (!SMB_VFS_STRICT_LOCK(conn, fsp, &lock)) {
+			tevent_req_nterror(req, NT_STATUS_FILE_LOCK_CONFLICT);
+			return tevent_req_post(req, ev);
+		}
+
+		status = schedule_smb2_sendfile_read(smb2req, state);
+		if (NT_STATUS_IS_OK(status)) {
+			tevent_req_done(req);
+			return tevent_req_post(req, ev);
+		}
+		SMB_VFS_STRICT_UNLOCK(conn, fsp, &lock);
+		if (!NT_STATUS_EQUAL(status, NT_STATUS_RETRY)) {
+			tevent_req_nterror(req, status);
+			return tevent_req_post(req, ev);
+		}
+	}
+
 	status = schedule_smb2_aio_read(fsp->conn,
 				smbreq,
 				fsp,
@@ -31,12 +31,35 @@
 #include "lib/util/iov_buf.h"
 #include "auth.h"
 #include "lib/crypto/sha512.h"
+#include "lib/pthreadpool/pthreadpool.h"
+
+/*
+ * Maximum number of related compound requests we dispatch
+ * back to back without returning to the event loop.
+ */
+#define SMBD_SMB2_MAX_PIPELINE_DEPTH 16
+
+/*
+ * Maximum number of iovecs we coalesce across queued responses
+ * into a single writev. Kept well below IOV_MAX as it lives on
+ * the stack of smbd_smb2_flush_send_queue().
+ */
+#define SMBD_SMB2_FLUSH_IOV_MAX 64
+
+/*
+ * Stop reading new requests from a connection while this many
+ * response bytes are waiting for a stalled client, independent of
+ * the response count limit in smbd_smb2_request_next_incoming().
+ */
+#define SMBD_SMB2_SEND_QUEUE_MAX_BYTES (16*1024*1024)
 
 static void smbd_smb2_connection_handler(struct tevent_context *ev,
 					 struct tevent_fd *fde,
 					 uint16_t flags,
 					 void *private_data);
 static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn);
+static NTSTATUS smbd_smb2_schedule_flush_send_queue(
+	struct smbXsrv_connection *xconn);
 
 static const struct smbd_smb2_dispatch_table {
 	uint16_t opcode;
@@ -208,6 +231,8 @@ static NTSTATUS smbd_initialize_smb2(struct smbXsrv_connection *xconn)
 	xconn->smb2.credits.seq_range = 1;
 	xconn->smb2.credits.granted = 1;
 	xconn->smb2.credits.max = lp_smb2_max_credits();
+	xconn->smb2.credits.window = MAX(xconn->smb2.credits.max / 16, 1);
+	xconn->smb2.credits.avg_latency_usec = 0;
 	xconn->smb2.credits.bitmap = bitmap_talloc(xconn,
 						   xconn->smb2.credits.max);
 	if (xconn->smb2.credits.bitmap == NULL) {
@@ -269,15 +294,13 @@ static int smbd_smb2_request_destructor(struct smbd_smb2_request *req)
 
 static struct smbd_smb2_request *smbd_smb2_request_allocate(TALLOC_CTX *mem_ctx)
 {
-	TALLOC_CTX *mem_pool;
 	struct smbd_smb2_request *req;
 
 #if 0
 	/* Enable this to find subtle valgrind errors. */
+	TALLOC_CTX *mem_pool;
+
 	mem_pool = talloc_init("smbd_smb2_request_allocate");
-#else
-	mem_pool = talloc_tos();
-#endif
 	if (mem_pool == NULL) {
 		return NULL;
 	}
@@ -288,8 +311,22 @@ static struct smbd_smb2_request *smbd_smb2_request_allocate(TALLOC_CTX *mem_ctx)
 		return NULL;
 	}
 	talloc_reparent(mem_pool, mem_ctx, req);
-#if 0
 	TALLOC_FREE(mem_pool);
+#else
+	/*
+	 * The request and the small talloc children hanging off it
+	 * (compound iovec arrays, reply bodies, handler states) come
+	 * out of one pool allocation and go away wholesale with the
+	 * request, keeping the steady-state request cycle down to a
+	 * single allocation. Oversized children transparently fall
+	 * back to the heap.
+	 */
+	req = talloc_pooled_object(mem_ctx, struct smbd_smb2_request,
+				   32, 8192);
+	if (req == NULL) {
+		return NULL;
+	}
+	ZERO_STRUCTP(req);
 #endif
 
 	req->last_session_id = UINT64_MAX;
@@ -771,6 +808,63 @@ static NTSTATUS smbd_smb2_request_validate(struct smbd_smb2_request *req)
 	return NT_STATUS_OK;
 }
 
+/*
+ * Grow or shrink the credit window of a connection based on the
+ * time we needed to service the request we're about to answer.
+ *
+ * A connection we answer quickly gets its window grown in chunks
+ * of 32 credits up to "smb2 max credits", so well behaved clients
+ * can build deep pipelines. Once the average service time degrades
+ * the window is halved down to the initial 1/16th of the maximum,
+ * which stops a single aggressive client from queueing thousands
+ * of requests while we're already falling behind.
+ */
+static void smb2_credits_update_window(struct smbXsrv_connection *xconn,
+				       struct smbd_smb2_request *req)
+{
+	uint16_t min_window = MAX(xconn->smb2.credits.max / 16, 1);
+	uint64_t lat_usec;
+	uint64_t avg;
+
+	lat_usec = (uint64_t)(timeval_elapsed(&req->request_time) * 1000000.0);
+
+	/*
+	 * EWMA with 1/8 weight for the latest sample, cheap and
+	 * smooth enough over the request rates we care about.
+	 */
+	avg = xconn->smb2.credits.avg_latency_usec;
+	avg = ((avg * 7) + lat_usec) / 8;
+	xconn->smb2.credits.avg_latency_usec = avg;
+
+	if (avg < 2000) {
+		uint32_t window = xconn->smb2.credits.window;
+
+		window = MIN(window + 32, xconn->smb2.credits.max);
+		if (window != xconn->smb2.credits.window) {
+			DEBUG(10,("%s: grow credit window %u => %u "
+				  "(avg latency %llu usec)\n",
+				  __func__,
+				  (unsigned int)xconn->smb2.credits.window,
+				  (unsigned int)window,
+				  (unsigned long long)avg));
+			xconn->smb2.credits.window = window;
+		}
+	} else if (avg > 20000) {
+		uint16_t window = xconn->smb2.credits.window;
+
+		window = MAX(window / 2, min_window);
+		if (window != xconn->smb2.credits.window) {
+			DEBUG(10,("%s: shrink credit window %u => %u "
+				  "(avg latency %llu usec)\n",
+				  __func__,
+				  (unsigned int)xconn->smb2.credits.window,
+				  (unsigned int)window,
+				  (unsigned long long)avg));
+			xconn->smb2.credits.window = window;
+		}
+	}
+}
+
 static void smb2_set_operation_credit(struct smbXsrv_connection *xconn,
 				      const struct iovec *in_vector,
 				      struct iovec *out_vector)
@@ -787,20 +881,12 @@ static void smb2_set_operation_credit(struct smbXsrv_connection *xconn,
 	uint16_t current_max_credits;
 
 	/*
-	 * first we grant only 1/16th of the max range.
-	 *
-	 * Windows also starts with the 1/16th and then grants
-	 * more later. I was only able to trigger higher
-	 * values, when using a very high credit charge.
-	 *
-	 * TODO: scale up depending on load, free memory
-	 *       or other stuff.
-	 *       Maybe also on the relationship between number
-	 *       of requests and the used sequence number.
-	 *       Which means we would grant more credits
-	 *       for client which use multi credit requests.
+	 * The credit window starts at 1/16th of the max range,
+	 * like Windows, and is then grown or shrunk by
+	 * smb2_credits_update_window() based on the measured
+	 * service latency of this connection.
 	 */
-	current_max_credits = xconn->smb2.credits.max / 16;
+	current_max_credits = xconn->smb2.credits.window;
 	current_max_credits = MAX(current_max_credits, 1);
 
 	if (xconn->smb2.credits.multicredit) {
@@ -1217,6 +1303,193 @@ static struct smbd_smb2_request *dup_smb2_req(const struct smbd_smb2_request *re
 	return newreq;
 }
 
+static void smbd_smb2_send_queue_push(struct smbXsrv_connection *xconn,
+				      struct smbd_smb2_send_queue *e)
+{
+	ssize_t bytes;
+
+	bytes = iov_buflen(e->vector, e->count);
+	if (bytes > 0) {
+		xconn->smb2.send_queue_bytes += bytes;
+	}
+
+	DLIST_ADD_END(xconn->smb2.send_queue, e, NULL);
+	xconn->smb2.send_queue_len++;
+}
+
+/*
+ * Offload the SMB3 transform encryption of outgoing responses to a
+ * pthreadpool.
+ *
+ * With encryption enabled the AES pass over every response runs on
+ * the single event loop thread and becomes the throughput ceiling of
+ * the whole connection on multi-core machines. When
+ * "smbd:encryption threads" is non-zero, smbd_smb2_encrypt_pdu()
+ * instead copies the key into the queue entry and hands the transform
+ * to a worker. The entry is pushed onto the send queue as usual with
+ * encrypt.pending set, which makes smbd_smb2_flush_send_queue() stop
+ * in front of it, so responses still hit the wire in the order they
+ * were queued no matter in which order the workers finish. Job
+ * completions arrive on the pool's signal fd and re-trigger the
+ * flush.
+ *
+ * Inbound transform decryption stays on the main thread: an incoming
+ * PDU has to be decrypted before we can even look at the SMB2 header
+ * to dispatch it, and PDUs arrive serially from the socket, so there
+ * is nothing to overlap it with short of buffering multiple
+ * transformed PDUs ahead of dispatch.
+ *
+ * The pool and its signal fde live as long as the connection; as
+ * smbd forks per connection they die with the process.
+ */
+
+static void smbd_smb2_encrypt_worker(void *private_data)
+{
+	struct smbd_smb2_send_queue *e =
+		(struct smbd_smb2_send_queue *)private_data;
+
+	e->encrypt.status = smb2_signing_encrypt_pdu(e->encrypt.key,
+						     e->encrypt.cipher,
+						     e->encrypt.vector,
+						     e->encrypt.count);
+}
+
+static void smbd_smb2_encrypt_done(struct tevent_context *ev,
+				   struct tevent_fd *fde,
+				   uint16_t flags,
+				   void *private_data)
+{
+	struct smbXsrv_connection *xconn =
+		talloc_get_type_abort(private_data,
+		struct smbXsrv_connection);
+	int jobids[8];
+	int num_jobs;
+	int i;
+	NTSTATUS status;
+
+	num_jobs = pthreadpool_finished_jobs(xconn->smb2.encrypt.pool,
+					     jobids, ARRAY_SIZE(jobids));
+	if (num_jobs <= 0) {
+		smbd_server_connection_terminate(
+			xconn, nt_errstr(NT_STATUS_INTERNAL_ERROR));
+		return;
+	}
+
+	for (i = 0; i < num_jobs; i++) {
+		struct smbd_smb2_send_queue *e;
+
+		for (e = xconn->smb2.send_queue; e != NULL; e = e->next) {
+			if (e->encrypt.pending &&
+			    e->encrypt.job_id == jobids[i]) {
+				break;
+			}
+		}
+		if (e == NULL) {
+			smbd_server_connection_terminate(
+				xconn, nt_errstr(NT_STATUS_INTERNAL_ERROR));
+			return;
+		}
+
+		e->encrypt.pending = false;
+		ZERO_STRUCT(e->encrypt.key_buf);
+
+		if (!NT_STATUS_IS_OK(e->encrypt.status)) {
+			smbd_server_connection_terminate(
+				xconn, nt_errstr(e->encrypt.status));
+			return;
+		}
+	}
+
+	status = smbd_smb2_flush_send_queue(xconn);
+	if (!NT_STATUS_IS_OK(status)) {
+		smbd_server_connection_terminate(xconn, nt_errstr(status));
+	}
+}
+
+static NTSTATUS smbd_smb2_encrypt_pdu(struct smbXsrv_connection *xconn,
+				      struct smbd_smb2_send_queue *e,
+				      DATA_BLOB encryption_key,
+				      struct iovec *vector,
+				      int count)
+{
+	int ret;
+
+	if (xconn->smb2.encrypt.pool == NULL &&
+	    !xconn->smb2.encrypt.init_failed) {
+		int threads = lp_parm_int(-1, "smbd",
+					  "encryption threads", 0);
+
+		if (threads <= 0) {
+			xconn->smb2.encrypt.init_failed = true;
+		} else {
+			ret = pthreadpool_init(threads,
+					       &xconn->smb2.encrypt.pool);
+			if (ret != 0) {
+				DEBUG(1, ("%s: pthreadpool_init failed: %s, "
+					  "encrypting inline\n",
+					  __func__, strerror(ret)));
+				xconn->smb2.encrypt.init_failed = true;
+			}
+		}
+
+		if (xconn->smb2.encrypt.pool != NULL) {
+			xconn->smb2.encrypt.fde = tevent_add_fd(
+				xconn->ev_ctx,
+				xconn,
+				pthreadpool_signal_fd(
+					xconn->smb2.encrypt.pool),
+				TEVENT_FD_READ,
+				smbd_smb2_encrypt_done,
+				xconn);
+			if (xconn->smb2.encrypt.fde == NULL) {
+				pthreadpool_destroy(
+					xconn->smb2.encrypt.pool);
+				xconn->smb2.encrypt.pool = NULL;
+				xconn->smb2.encrypt.init_failed = true;
+			}
+		}
+	}
+
+	if (xconn->smb2.encrypt.pool == NULL ||
+	    encryption_key.length > sizeof(e->encrypt.key_buf)) {
+		return smb2_signing_encrypt_pdu(encryption_key,
+						xconn->smb2.server.cipher,
+						vector,
+						count);
+	}
+
+	/*
+	 * Callers may clear or reuse their key blob right after we
+	 * return (see req->first_key), so the entry keeps its own
+	 * copy until the worker is done with it.
+	 */
+	memcpy(e->encrypt.key_buf, encryption_key.data,
+	       encryption_key.length);
+	e->encrypt.key = data_blob_const(e->encrypt.key_buf,
+					 encryption_key.length);
+	e->encrypt.cipher = xconn->smb2.server.cipher;
+	e->encrypt.vector = vector;
+	e->encrypt.count = count;
+	e->encrypt.status = NT_STATUS_INTERNAL_ERROR;
+	e->encrypt.job_id = ++xconn->smb2.encrypt.job_id;
+
+	ret = pthreadpool_add_job(xconn->smb2.encrypt.pool,
+				  e->encrypt.job_id,
+				  smbd_smb2_encrypt_worker,
+				  e);
+	if (ret != 0) {
+		ZERO_STRUCT(e->encrypt.key_buf);
+		return smb2_signing_encrypt_pdu(encryption_key,
+						xconn->smb2.server.cipher,
+						vector,
+						count);
+	}
+
+	e->encrypt.pending = true;
+
+	return NT_STATUS_OK;
+}
+
 static NTSTATUS smb2_send_async_interim_response(const struct smbd_smb2_request *req)
 {
 	struct smbXsrv_connection *xconn = req->xconn;
@@ -1269,8 +1542,9 @@ static NTSTATUS smb2_send_async_interim_response(const struct smbd_smb2_request
 	 * we need to sign/encrypt here with the last/first key we remembered
 	 */
 	if (firsttf->iov_len == SMB2_TF_HDR_SIZE) {
-		status = smb2_signing_encrypt_pdu(req->first_key,
-					xconn->smb2.server.cipher,
+		status = smbd_smb2_encrypt_pdu(xconn,
+					&nreq->queue_entry,
+					req->first_key,
 					firsttf,
 					nreq->out.vector_count - first_idx);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -1289,8 +1563,7 @@ static NTSTATUS smb2_send_async_interim_response(const struct smbd_smb2_request
 	nreq->queue_entry.mem_ctx = nreq;
 	nreq->queue_entry.vector = nreq->out.vector;
 	nreq->queue_entry.count = nreq->out.vector_count;
-	DLIST_ADD_END(xconn->smb2.send_queue, &nreq->queue_entry, NULL);
-	xconn->smb2.send_queue_len++;
+	smbd_smb2_send_queue_push(xconn, &nreq->queue_entry);
 
 	status = smbd_smb2_flush_send_queue(xconn);
 	if (!NT_STATUS_IS_OK(status)) {
@@ -1649,8 +1922,9 @@ static void smbd_smb2_request_pending_timer(struct tevent_context *ev,
 		struct smbXsrv_session *x = req->session;
 		DATA_BLOB encryption_key = x->global->encryption_key;
 
-		status = smb2_signing_encrypt_pdu(encryption_key,
-					xconn->smb2.server.cipher,
+		status = smbd_smb2_encrypt_pdu(xconn,
+					&state->queue_entry,
+					encryption_key,
 					&state->vector[1+SMBD_SMB2_TF_IOV_OFS],
 					SMBD_SMB2_NUM_IOV_PER_REQ);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -1676,8 +1950,7 @@ static void smbd_smb2_request_pending_timer(struct tevent_context *ev,
 	state->queue_entry.mem_ctx = state;
 	state->queue_entry.vector = state->vector;
 	state->queue_entry.count = ARRAY_SIZE(state->vector);
-	DLIST_ADD_END(xconn->smb2.send_queue, &state->queue_entry, NULL);
-	xconn->smb2.send_queue_len++;
+	smbd_smb2_send_queue_push(xconn, &state->queue_entry);
 
 	status = smbd_smb2_flush_send_queue(xconn);
 	if (!NT_STATUS_IS_OK(status)) {
@@ -2419,6 +2692,8 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 	req->subreq = NULL;
 	TALLOC_FREE(req->async_te);
 
+	smb2_credits_update_window(xconn, req);
+
 	if (req->do_encryption &&
 	    (firsttf->iov_len == 0) &&
 	    (req->first_key.length == 0) &&
@@ -2507,10 +2782,7 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 		 * compound request we haven't processed
 		 * yet.
 		 */
-		struct tevent_immediate *im = tevent_create_immediate(req);
-		if (!im) {
-			return NT_STATUS_NO_MEMORY;
-		}
+		struct tevent_immediate *im;
 
 		if (req->do_signing && firsttf->iov_len == 0) {
 			struct smbXsrv_session *x = req->session;
@@ -2528,6 +2800,34 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 			}
 		}
 
+		if (req->compound_related &&
+		    req->pipeline_depth < SMBD_SMB2_MAX_PIPELINE_DEPTH &&
+		    lp_parm_bool(-1, "smbd", "compound pipeline", true)) {
+			/*
+			 * Dispatch the next related request of the
+			 * compound chain directly, instead of taking
+			 * a full round trip through the event loop.
+			 * This keeps the chain fsp and the cwd of the
+			 * tcon hot for the following operations.
+			 *
+			 * New incoming pdus can't overtake us, as we
+			 * haven't called smbd_smb2_request_next_incoming()
+			 * yet, and cancels for elements of a related
+			 * chain are ignored anyway.
+			 *
+			 * The depth limit avoids unbounded recursion
+			 * on pathological chains; once we hit it we
+			 * fall back to the event loop below.
+			 */
+			req->pipeline_depth++;
+			return smbd_smb2_request_dispatch(req);
+		}
+
+		im = tevent_create_immediate(req);
+		if (!im) {
+			return NT_STATUS_NO_MEMORY;
+		}
+
 		tevent_schedule_immediate(im,
 					req->sconn->ev_ctx,
 					smbd_smb2_request_dispatch_immediate,
@@ -2552,10 +2852,25 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 	 * now check if we need to sign the current response
 	 */
 	if (firsttf->iov_len == SMB2_TF_HDR_SIZE) {
-		status = smb2_signing_encrypt_pdu(req->first_key,
+		if (req->preauth == NULL) {
+			status = smbd_smb2_encrypt_pdu(xconn,
+					&req->queue_entry,
+					req->first_key,
+					firsttf,
+					req->out.vector_count - first_idx);
+		} else {
+			/*
+			 * The preauth hash below has to see the
+			 * response exactly as it goes over the wire,
+			 * so it must not run while a worker is still
+			 * transforming the vectors. This only happens
+			 * during session setup, encrypt inline.
+			 */
+			status = smb2_signing_encrypt_pdu(req->first_key,
 					xconn->smb2.server.cipher,
 					firsttf,
 					req->out.vector_count - first_idx);
+		}
 		if (!NT_STATUS_IS_OK(status)) {
 			return status;
 		}
@@ -2619,10 +2934,19 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 	req->queue_entry.mem_ctx = req;
 	req->queue_entry.vector = req->out.vector;
 	req->queue_entry.count = req->out.vector_count;
-	DLIST_ADD_END(xconn->smb2.send_queue, &req->queue_entry, NULL);
-	xconn->smb2.send_queue_len++;
+	smbd_smb2_send_queue_push(xconn, &req->queue_entry);
 
-	status = smbd_smb2_flush_send_queue(xconn);
+	/*
+	 * Don't flush the send queue right away. The aio
+	 * completion handlers drain all finished jobs from the
+	 * threadpool in a single wakeup and deliver the
+	 * callbacks via deferred immediates, so when a batch of
+	 * reads finishes together we get called here once per
+	 * response. Scheduling the flush as an immediate makes
+	 * it run after all of those callbacks and sends the
+	 * whole batch in one pass over the queue.
+	 */
+	status = smbd_smb2_schedule_flush_send_queue(xconn);
 	if (!NT_STATUS_IS_OK(status)) {
 		return status;
 	}
@@ -2719,7 +3043,21 @@ NTSTATUS smbd_smb2_request_done_ex(struct smbd_smb2_request *req,
 
 	if ((next_command_ofs % 8) != 0) {
 		size_t pad_size = 8 - (next_command_ofs % 8);
-		if (SMBD_SMB2_OUT_DYN_LEN(req) == 0) {
+		if (SMBD_SMB2_OUT_DYN_LEN(req) == 0 && !req->do_encryption) {
+			/*
+			 * If the dyn buffer is empty we can use it to
+			 * add padding. The padding is never written
+			 * to, so all unencrypted responses can share
+			 * one static buffer. The transform encrypts
+			 * the vectors in place, so encrypted
+			 * responses fall through to the allocating
+			 * path below.
+			 */
+			static const uint8_t pad[7];
+
+			outdyn_v->iov_base = discard_const_p(void, pad);
+			outdyn_v->iov_len = pad_size;
+		} else if (SMBD_SMB2_OUT_DYN_LEN(req) == 0) {
 			/*
 			 * if the dyn buffer is empty
 			 * we can use it to add padding
@@ -2949,8 +3287,9 @@ static NTSTATUS smbd_smb2_send_break(struct smbXsrv_connection *xconn,
 	if (do_encryption) {
 		DATA_BLOB encryption_key = session->global->encryption_key;
 
-		status = smb2_signing_encrypt_pdu(encryption_key,
-					xconn->smb2.server.cipher,
+		status = smbd_smb2_encrypt_pdu(xconn,
+					&state->queue_entry,
+					encryption_key,
 					&state->vector[1+SMBD_SMB2_TF_IOV_OFS],
 					SMBD_SMB2_NUM_IOV_PER_REQ);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -2961,8 +3300,7 @@ static NTSTATUS smbd_smb2_send_break(struct smbXsrv_connection *xconn,
 	state->queue_entry.mem_ctx = state;
 	state->queue_entry.vector = state->vector;
 	state->queue_entry.count = ARRAY_SIZE(state->vector);
-	DLIST_ADD_END(xconn->smb2.send_queue, &state->queue_entry, NULL);
-	xconn->smb2.send_queue_len++;
+	smbd_smb2_send_queue_push(xconn, &state->queue_entry);
 
 	status = smbd_smb2_flush_send_queue(xconn);
 	if (!NT_STATUS_IS_OK(status)) {
@@ -3128,6 +3466,17 @@ static NTSTATUS smbd_smb2_request_next_incoming(struct smbXsrv_connection *xconn
 		return NT_STATUS_OK;
 	}
 
+	if (xconn->smb2.send_queue_bytes > SMBD_SMB2_SEND_QUEUE_MAX_BYTES) {
+		/*
+		 * The response count check above does not protect
+		 * against a few huge responses, e.g. large reads,
+		 * piling up for a client that stopped reading. Hold
+		 * off further requests until the queue has drained,
+		 * the flush path re-triggers us.
+		 */
+		return NT_STATUS_OK;
+	}
+
 	/* ask for the next request */
 	ZERO_STRUCTP(state);
 	state->req = smbd_smb2_request_allocate(xconn);
@@ -3252,6 +3601,46 @@ static int socket_error_from_errno(int ret,
 	return sys_errno;
 }
 
+static void smbd_smb2_flush_send_queue_im(struct tevent_context *ctx,
+					  struct tevent_immediate *im,
+					  void *private_data)
+{
+	struct smbXsrv_connection *xconn =
+		talloc_get_type_abort(private_data,
+		struct smbXsrv_connection);
+	NTSTATUS status;
+
+	xconn->smb2.flush_pending = false;
+
+	status = smbd_smb2_flush_send_queue(xconn);
+	if (!NT_STATUS_IS_OK(status)) {
+		smbd_server_connection_terminate(xconn, nt_errstr(status));
+	}
+}
+
+static NTSTATUS smbd_smb2_schedule_flush_send_queue(
+	struct smbXsrv_connection *xconn)
+{
+	if (xconn->smb2.flush_pending) {
+		return NT_STATUS_OK;
+	}
+
+	if (xconn->smb2.flush_im == NULL) {
+		xconn->smb2.flush_im = tevent_create_immediate(xconn);
+		if (xconn->smb2.flush_im == NULL) {
+			return NT_STATUS_NO_MEMORY;
+		}
+	}
+
+	tevent_schedule_immediate(xconn->smb2.flush_im,
+				  xconn->ev_ctx,
+				  smbd_smb2_flush_send_queue_im,
+				  xconn);
+	xconn->smb2.flush_pending = true;
+
+	return NT_STATUS_OK;
+}
+
 static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn)
 {
 	int ret;
@@ -3267,6 +3656,18 @@ static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn)
 		struct smbd_smb2_send_queue *e = xconn->smb2.send_queue;
 		bool ok;
 
+		if (e->encrypt.pending) {
+			/*
+			 * The head entry is still being encrypted on
+			 * a worker thread; everything behind it has
+			 * to wait to keep the wire order. The job
+			 * completion flushes again, so don't spin on
+			 * a writable socket in the meantime.
+			 */
+			TEVENT_FD_NOT_WRITEABLE(xconn->transport.fde);
+			return NT_STATUS_OK;
+		}
+
 		if (e->sendfile_header != NULL) {
 			NTSTATUS status = NT_STATUS_INTERNAL_ERROR;
 			size_t size = 0;
@@ -3299,6 +3700,7 @@ static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn)
 			e->sendfile_status = &status;
 			e->count = 0;
 
+			xconn->smb2.send_queue_bytes -= size;
 			xconn->smb2.send_queue_len--;
 			DLIST_REMOVE(xconn->smb2.send_queue, e);
 			/*
@@ -3313,7 +3715,58 @@ static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn)
 			continue;
 		}
 
-		ret = writev(xconn->transport.sock, e->vector, e->count);
+		/*
+		 * Coalesce the iovecs of as many queued responses as
+		 * fit into a single writev. Entries taking the
+		 * sendfile path above have to keep their position in
+		 * the queue, so they terminate a batch.
+		 */
+		{
+			struct iovec vector[SMBD_SMB2_FLUSH_IOV_MAX];
+			const struct iovec *iov = e->vector;
+			struct smbd_smb2_send_queue *n = NULL;
+			unsigned int count = 0;
+			unsigned int entries = 0;
+
+			for (n = e; n != NULL; n = n->next) {
+				if (n->sendfile_header != NULL) {
+					break;
+				}
+				if (n->encrypt.pending) {
+					break;
+				}
+				if (count + n->count > ARRAY_SIZE(vector)) {
+					break;
+				}
+				memcpy(&vector[count], n->vector,
+				       n->count * sizeof(struct iovec));
+				count += n->count;
+				entries += 1;
+			}
+
+			if (entries > 1) {
+				iov = vector;
+			} else {
+				/*
+				 * Only one entry (or a single response
+				 * with more iovecs than our batch
+				 * array), write it directly.
+				 */
+				count = e->count;
+			}
+
+			ret = writev(xconn->transport.sock, iov, count);
+
+			xconn->smb2.send_stats.writev_calls += 1;
+			xconn->smb2.send_stats.responses += MAX(entries, 1);
+			xconn->smb2.send_stats.max_batch =
+				MAX(xconn->smb2.send_stats.max_batch,
+				    MAX(entries, 1));
+
+			DEBUG(10,("%s: writev of %u iovecs covering %u "
+				  "responses returned %d\n",
+				  __func__, count, MAX(entries, 1), ret));
+		}
 		if (ret == 0) {
 			/* propagate end of file */
 			return NT_STATUS_INTERNAL_ERROR;
@@ -3328,20 +3781,42 @@ static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn)
 			return map_nt_error_from_unix_common(err);
 		}
 
-		ok = iov_advance(&e->vector, &e->count, ret);
-		if (!ok) {
-			return NT_STATUS_INTERNAL_ERROR;
-		}
+		/*
+		 * Consume what the batched writev managed to get
+		 * onto the wire, dropping fully sent entries and
+		 * advancing into a partially sent one.
+		 */
+		while (ret > 0 && xconn->smb2.send_queue != NULL) {
+			ssize_t e_len;
 
-		if (e->count > 0) {
-			/* we have more to write */
-			TEVENT_FD_WRITEABLE(xconn->transport.fde);
-			return NT_STATUS_OK;
-		}
+			e = xconn->smb2.send_queue;
+			e_len = iov_buflen(e->vector, e->count);
+			if (e_len < 0) {
+				return NT_STATUS_INTERNAL_ERROR;
+			}
 
-		xconn->smb2.send_queue_len--;
-		DLIST_REMOVE(xconn->smb2.send_queue, e);
-		talloc_free(e->mem_ctx);
+			if (ret < e_len) {
+				/*
+				 * Short write into this entry, the
+				 * socket is full. Keep the rest
+				 * queued and wait for it to drain.
+				 */
+				ok = iov_advance(&e->vector, &e->count,
+						 ret);
+				if (!ok) {
+					return NT_STATUS_INTERNAL_ERROR;
+				}
+				xconn->smb2.send_queue_bytes -= ret;
+				TEVENT_FD_WRITEABLE(xconn->transport.fde);
+				return NT_STATUS_OK;
+			}
+
+			ret -= e_len;
+			xconn->smb2.send_queue_bytes -= e_len;
+			xconn->smb2.send_queue_len--;
+			DLIST_REMOVE(xconn->smb2.send_queue, e);
+			talloc_free(e->mem_ctx);
+		}
 	}
 
 	return NT_STATUS_OK;
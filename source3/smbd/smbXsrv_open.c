@@ -1210,6 +1210,21 @@ NTSTATUS smb2srv_open_recreate(struct smbXsrv_connection *conn,
 		return NT_STATUS_OBJECT_NAME_NOT_FOUND;
 	}
 
+	if (global_id == 0) {
+		DEBUG(10, ("global_id=0\n"));
+		return NT_STATUS_OBJECT_NAME_NOT_FOUND;
+	}
+
+	/*
+	 * Check the cheap local conditions before taking the
+	 * chainlock on the global record. In a reconnect storm after
+	 * a failover this keeps trivially doomed requests away from
+	 * the global tdb.
+	 */
+	if (table->local.num_opens >= table->local.max_opens) {
+		return NT_STATUS_INSUFFICIENT_RESOURCES;
+	}
+
 	op = talloc_zero(table, struct smbXsrv_open);
 	if (op == NULL) {
 		return NT_STATUS_NO_MEMORY;
@@ -1247,11 +1262,6 @@ NTSTATUS smb2srv_open_recreate(struct smbXsrv_connection *conn,
 		return NT_STATUS_OBJECT_NAME_NOT_FOUND;
 	}
 
-	if (table->local.num_opens >= table->local.max_opens) {
-		TALLOC_FREE(op);
-		return NT_STATUS_INSUFFICIENT_RESOURCES;
-	}
-
 	status = smbXsrv_open_local_allocate_id(table->local.db_ctx,
 						table->local.lowest_id,
 						table->local.highest_id,
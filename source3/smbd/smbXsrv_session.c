@@ -45,6 +45,13 @@ struct smbXsrv_session_table {
 		uint32_t highest_id;
 		uint32_t max_sessions;
 		uint32_t num_sessions;
+		/*
+		 * One-entry MRU cache for the per-PDU lookup, most
+		 * PDUs on a connection carry the same session id.
+		 * Invalidated in smbXsrv_session_logoff().
+		 */
+		uint32_t cache_id;
+		struct smbXsrv_session *cache_session;
 	} local;
 	struct {
 		struct db_context *db_ctx;
@@ -611,18 +618,29 @@ static NTSTATUS smbXsrv_session_local_lookup(struct smbXsrv_session_table *table
 		return NT_STATUS_INTERNAL_ERROR;
 	}
 
-	key = smbXsrv_session_local_id_to_key(session_local_id, key_buf);
+	if ((table->local.cache_session != NULL) &&
+	    (table->local.cache_id == session_local_id))
+	{
+		state.session = table->local.cache_session;
+		state.status = NT_STATUS_OK;
+	} else {
+		key = smbXsrv_session_local_id_to_key(session_local_id,
+						      key_buf);
 
-	status = dbwrap_parse_record(table->local.db_ctx, key,
-				     smbXsrv_session_local_fetch_parser,
-				     &state);
-	if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
-		return NT_STATUS_USER_SESSION_DELETED;
-	} else if (!NT_STATUS_IS_OK(status)) {
-		return status;
-	}
-	if (!NT_STATUS_IS_OK(state.status)) {
-		return state.status;
+		status = dbwrap_parse_record(table->local.db_ctx, key,
+					     smbXsrv_session_local_fetch_parser,
+					     &state);
+		if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+			return NT_STATUS_USER_SESSION_DELETED;
+		} else if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+		if (!NT_STATUS_IS_OK(state.status)) {
+			return state.status;
+		}
+
+		table->local.cache_id = session_local_id;
+		table->local.cache_session = state.session;
 	}
 
 	if (NT_STATUS_EQUAL(state.session->status, NT_STATUS_USER_SESSION_DELETED)) {
@@ -1514,6 +1532,11 @@ NTSTATUS smbXsrv_session_logoff(struct smbXsrv_session *session)
 	table = session->table;
 	session->table = NULL;
 
+	if (table->local.cache_session == session) {
+		table->local.cache_session = NULL;
+		table->local.cache_id = 0;
+	}
+
 	sconn = session->client->sconn;
 	session->client = NULL;
 	session->status = NT_STATUS_USER_SESSION_DELETED;
@@ -31,6 +31,25 @@
  Stat cache code used in unix_convert.
 *****************************************************************************/
 
+/*
+ * Build the cache key for a (case-folded) client path. The key is
+ * scoped by the service number, so the same client-relative path on
+ * different shares can't alias to each other's translations and
+ * evict entries of unrelated shares.
+ */
+static DATA_BLOB stat_cache_key(TALLOC_CTX *ctx,
+				connection_struct *conn,
+				const char *name)
+{
+	char *key;
+
+	key = talloc_asprintf(ctx, "%d/%s", SNUM(conn), name);
+	if (key == NULL) {
+		return data_blob_null;
+	}
+	return data_blob_const(key, strlen(key));
+}
+
 /**
  * Add an entry into the stat cache.
  *
@@ -45,12 +64,14 @@
 
 void stat_cache_add( const char *full_orig_name,
 		char *translated_path,
-		bool case_sensitive)
+		connection_struct *conn)
 {
+	bool case_sensitive = conn->case_sensitive;
 	size_t translated_path_length;
 	char *original_path;
 	size_t original_path_length;
 	char saved_char;
+	DATA_BLOB key;
 	TALLOC_CTX *ctx = talloc_tos();
 
 	if (!lp_stat_cache()) {
@@ -131,9 +152,15 @@ void stat_cache_add( const char *full_orig_name,
 	 * New entry or replace old entry.
 	 */
 
+	key = stat_cache_key(ctx, conn, original_path);
+	if (key.data == NULL) {
+		TALLOC_FREE(original_path);
+		translated_path[translated_path_length] = saved_char;
+		return;
+	}
+
 	memcache_add(
-		smbd_memcache(), STAT_CACHE,
-		data_blob_const(original_path, original_path_length),
+		smbd_memcache(), STAT_CACHE, key,
 		data_blob_const(translated_path, translated_path_length + 1));
 
 	DEBUG(5,("stat_cache_add: Added entry (%lx:size %x) %s -> %s\n",
@@ -230,15 +257,36 @@ bool stat_cache_lookup(connection_struct *conn,
 
 	while (1) {
 		char *sp;
+		DATA_BLOB key;
 
 		data_val = data_blob_null;
 
+		key = stat_cache_key(ctx, conn, chk_name);
+		if (key.data == NULL) {
+			TALLOC_FREE(chk_name);
+			return False;
+		}
+
 		if (memcache_lookup(
 			    smbd_memcache(), STAT_CACHE,
-			    data_blob_const(chk_name, strlen(chk_name)),
-			    &data_val)) {
+			    key, &data_val)) {
+			TALLOC_FREE(key.data);
+			if (data_val.length == 0) {
+				/*
+				 * Negative entry: we recently
+				 * discovered this translation to be
+				 * stale. Don't bother verifying it
+				 * again, treat the lookup as a miss.
+				 */
+				DEBUG(10,("stat_cache_lookup: negative hit "
+					  "for name [%s]\n", chk_name));
+				DO_PROFILE_INC(statcache_misses);
+				TALLOC_FREE(chk_name);
+				return False;
+			}
 			break;
 		}
+		TALLOC_FREE(key.data);
 
 		DEBUG(10,("stat_cache_lookup: lookup failed for name [%s]\n",
 				chk_name ));
@@ -293,9 +341,21 @@ bool stat_cache_lookup(connection_struct *conn,
 	}
 
 	if (ret != 0) {
-		/* Discard this entry - it doesn't exist in the filesystem. */
-		memcache_delete(smbd_memcache(), STAT_CACHE,
-				data_blob_const(chk_name, strlen(chk_name)));
+		DATA_BLOB key = stat_cache_key(ctx, conn, chk_name);
+
+		/*
+		 * The translation doesn't exist in the filesystem
+		 * anymore. Turn the entry into a negative one
+		 * instead of deleting it, so hot lookups of a
+		 * removed path skip the verification stat above
+		 * until the path resolves again (a successful
+		 * stat_cache_add() overwrites the marker).
+		 */
+		if (key.data != NULL) {
+			memcache_add(smbd_memcache(), STAT_CACHE, key,
+				     data_blob_null);
+			TALLOC_FREE(key.data);
+		}
 		TALLOC_FREE(chk_name);
 		TALLOC_FREE(translated_path);
 		return False;
@@ -368,6 +428,7 @@ void smbd_send_stat_cache_delete_message(struct messaging_context *msg_ctx,
 void stat_cache_delete(const char *name)
 {
 	char *lname = talloc_strdup_upper(talloc_tos(), name);
+	int snum;
 
 	if (!lname) {
 		return;
@@ -375,8 +436,22 @@ void stat_cache_delete(const char *name)
 	DEBUG(10,("stat_cache_delete: deleting name [%s] -> %s\n",
 			lname, name ));
 
-	memcache_delete(smbd_memcache(), STAT_CACHE,
-			data_blob_const(lname, talloc_get_size(lname)-1));
+	/*
+	 * The cache keys are scoped by service number and we only
+	 * get the path here, so drop the name in every service's
+	 * scope.
+	 */
+	for (snum = 0; snum < lp_numservices(); snum++) {
+		char *key;
+
+		key = talloc_asprintf(talloc_tos(), "%d/%s", snum, lname);
+		if (key == NULL) {
+			break;
+		}
+		memcache_delete(smbd_memcache(), STAT_CACHE,
+				data_blob_const(key, strlen(key)));
+		TALLOC_FREE(key);
+	}
 	TALLOC_FREE(lname);
 }
 
@@ -578,6 +578,126 @@ static NTSTATUS fill_ea_chained_buffer(TALLOC_CTX *mem_ctx,
 	return NT_STATUS_OK;
 }
 
+/****************************************************************************
+ Get the size of one EA value without transferring the value itself.
+ On backends where xattrs are remote this saves shipping the data
+ just to measure it.
+****************************************************************************/
+
+static NTSTATUS get_ea_value_size(connection_struct *conn,
+				  files_struct *fsp, const char *fname,
+				  const char *ea_name, size_t *psize)
+{
+	ssize_t sizeret;
+
+	if (fsp && fsp->fh->fd != -1) {
+		sizeret = SMB_VFS_FGETXATTR(fsp, ea_name, NULL, 0);
+	} else {
+		sizeret = SMB_VFS_GETXATTR(conn, fname, ea_name, NULL, 0);
+	}
+	if (sizeret == -1) {
+		return map_nt_error_from_unix(errno);
+	}
+	*psize = sizeret;
+	return NT_STATUS_OK;
+}
+
+/****************************************************************************
+ Return a linked list of EA names and value sizes only, plus the
+ total size. The returned ea_structs carry no value data, so the
+ list is only good for size calculations like estimate_ea_size().
+****************************************************************************/
+
+static NTSTATUS get_ea_sizes_from_file_path(TALLOC_CTX *mem_ctx,
+					    connection_struct *conn,
+					    files_struct *fsp,
+					    const char *fname,
+					    size_t *pea_total_len,
+					    struct ea_list **ea_list)
+{
+	size_t i, num_names;
+	char **names;
+	struct ea_list *ea_list_head = NULL;
+	NTSTATUS status;
+
+	*pea_total_len = 0;
+	*ea_list = NULL;
+
+	status = get_ea_names_from_file(talloc_tos(), conn, fsp, fname,
+					&names, &num_names);
+
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	if (num_names == 0) {
+		return NT_STATUS_OK;
+	}
+
+	for (i=0; i<num_names; i++) {
+		struct ea_list *listp;
+		fstring dos_ea_name;
+		size_t val_len = 0;
+
+		if (strnequal(names[i], "system.", 7)
+		    || samba_private_attr_name(names[i]))
+			continue;
+
+		/*
+		 * Filter out any underlying POSIX EA names
+		 * that a Windows client can't handle.
+		 */
+		if (!lp_posix_pathnames() &&
+				is_invalid_windows_ea_name(names[i])) {
+			continue;
+		}
+
+		status = get_ea_value_size(conn, fsp, fname, names[i],
+					   &val_len);
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+
+		if (val_len == 0) {
+			/* Zero length EA's are never returned. */
+			continue;
+		}
+
+		listp = talloc(mem_ctx, struct ea_list);
+		if (listp == NULL) {
+			return NT_STATUS_NO_MEMORY;
+		}
+
+		listp->ea.flags = 0;
+		if (strnequal(names[i], "user.", 5)) {
+			listp->ea.name = talloc_strdup(listp, &names[i][5]);
+		} else {
+			listp->ea.name = talloc_strdup(listp, names[i]);
+		}
+		if (listp->ea.name == NULL) {
+			TALLOC_FREE(listp);
+			return NT_STATUS_NO_MEMORY;
+		}
+		listp->ea.value = data_blob_null;
+		listp->ea.value.length = val_len;
+
+		push_ascii_fstring(dos_ea_name, listp->ea.name);
+
+		*pea_total_len +=
+			4 + strlen(dos_ea_name) + 1 + val_len;
+
+		DLIST_ADD_END(ea_list_head, listp, struct ea_list *);
+	}
+
+	/* Add on 4 for total length. */
+	if (*pea_total_len) {
+		*pea_total_len += 4;
+	}
+
+	*ea_list = ea_list_head;
+	return NT_STATUS_OK;
+}
+
 static unsigned int estimate_ea_size(connection_struct *conn, files_struct *fsp, const struct smb_filename *smb_fname)
 {
 	size_t total_ea_len = 0;
@@ -596,7 +716,7 @@ static unsigned int estimate_ea_size(connection_struct *conn, files_struct *fsp,
 	if (is_ntfs_stream_smb_fname(smb_fname)) {
 		fsp = NULL;
 	}
-	(void)get_ea_list_from_file_path(mem_ctx, conn, fsp, smb_fname->base_name, &total_ea_len, &ea_list);
+	(void)get_ea_sizes_from_file_path(mem_ctx, conn, fsp, smb_fname->base_name, &total_ea_len, &ea_list);
 	if(conn->sconn->using_smb2) {
 		NTSTATUS status;
 		unsigned int ret_data_size;
@@ -1492,6 +1612,7 @@ struct smbd_dirptr_lanman2_state {
 	bool check_mangled_names;
 	bool has_wild;
 	bool got_exact_match;
+	struct ms_fnmatch_compiled *compiled_mask;
 };
 
 static bool smbd_dirptr_lanman2_match_fn(TALLOC_CTX *ctx,
@@ -1549,8 +1670,13 @@ static bool smbd_dirptr_lanman2_match_fn(TALLOC_CTX *ctx,
 				fname, mask);
 	state->got_exact_match = got_match;
 	if (!got_match) {
-		got_match = mask_match(fname, mask,
-				       state->conn->case_sensitive);
+		if (state->compiled_mask != NULL) {
+			got_match = mask_match_compiled(fname,
+						state->compiled_mask);
+		} else {
+			got_match = mask_match(fname, mask,
+					       state->conn->case_sensitive);
+		}
 	}
 
 	if(!got_match && state->check_mangled_names &&
@@ -1573,8 +1699,13 @@ static bool smbd_dirptr_lanman2_match_fn(TALLOC_CTX *ctx,
 					mangled_name, mask);
 		state->got_exact_match = got_match;
 		if (!got_match) {
-			got_match = mask_match(mangled_name, mask,
-					       state->conn->case_sensitive);
+			if (state->compiled_mask != NULL) {
+				got_match = mask_match_compiled(mangled_name,
+							state->compiled_mask);
+			} else {
+				got_match = mask_match(mangled_name, mask,
+						state->conn->case_sensitive);
+			}
 		}
 	}
 
@@ -2377,6 +2508,9 @@ NTSTATUS smbd_dirptr_lanman2_entry(TALLOC_CTX *ctx,
 		mask = path_mask;
 	}
 
+	state.compiled_mask = dptr_get_compiled_wcard(dirptr, mask,
+						conn->case_sensitive);
+
 	ok = smbd_dirptr_get_entry(ctx,
 				   dirptr,
 				   mask,
@@ -4665,7 +4799,11 @@ NTSTATUS smbd_do_qfilepathinfo(connection_struct *conn,
 		 fsp_fnum_dbg(fsp),
 		 info_level, max_data_bytes));
 
-	mode = dos_mode(conn, smb_fname);
+	if ((fsp != NULL) && (fsp->fsp_name == smb_fname)) {
+		mode = fsp_dos_mode(fsp);
+	} else {
+		mode = dos_mode(conn, smb_fname);
+	}
 	nlink = psbuf->st_ex_nlink;
 
 	if (nlink && (mode&FILE_ATTRIBUTE_DIRECTORY)) {
@@ -1850,6 +1850,14 @@ int smb_vfs_call_lstat(struct vfs_handle_struct *handle,
 	return handle->fns->lstat_fn(handle, smb_filename);
 }
 
+int smb_vfs_call_stat_batch(struct vfs_handle_struct *handle,
+			    unsigned int num_entries,
+			    struct smb_filename **smb_fnames)
+{
+	VFS_FIND(stat_batch);
+	return handle->fns->stat_batch_fn(handle, num_entries, smb_fnames);
+}
+
 uint64_t smb_vfs_call_get_alloc_size(struct vfs_handle_struct *handle,
 				     struct files_struct *fsp,
 				     const SMB_STRUCT_STAT *sbuf)
@@ -2020,6 +2028,16 @@ int smb_vfs_call_ntimes(struct vfs_handle_struct *handle,
 	return handle->fns->ntimes_fn(handle, smb_fname, ft);
 }
 
+int smb_vfs_call_ntimes_batch(struct vfs_handle_struct *handle,
+			      unsigned int num_entries,
+			      struct smb_filename **smb_fnames,
+			      struct smb_file_time *fts)
+{
+	VFS_FIND(ntimes_batch);
+	return handle->fns->ntimes_batch_fn(handle, num_entries,
+					    smb_fnames, fts);
+}
+
 int smb_vfs_call_ftruncate(struct vfs_handle_struct *handle,
 			   struct files_struct *fsp, off_t offset)
 {
@@ -2195,6 +2213,27 @@ NTSTATUS smb_vfs_call_copy_chunk_recv(struct vfs_handle_struct *handle,
 	return handle->fns->copy_chunk_recv_fn(handle, req, copied);
 }
 
+struct tevent_req *smb_vfs_call_hash_file_send(struct vfs_handle_struct *handle,
+					       TALLOC_CTX *mem_ctx,
+					       struct tevent_context *ev,
+					       struct files_struct *fsp,
+					       off_t offset,
+					       off_t num)
+{
+	VFS_FIND(hash_file_send);
+	return handle->fns->hash_file_send_fn(handle, mem_ctx, ev, fsp,
+					      offset, num);
+}
+
+NTSTATUS smb_vfs_call_hash_file_recv(struct vfs_handle_struct *handle,
+				     struct tevent_req *req,
+				     uint8_t digest[64],
+				     off_t *hashed)
+{
+	VFS_FIND(hash_file_recv);
+	return handle->fns->hash_file_recv_fn(handle, req, digest, hashed);
+}
+
 NTSTATUS smb_vfs_call_get_compression(vfs_handle_struct *handle,
 				      TALLOC_CTX *mem_ctx,
 				      struct files_struct *fsp,
@@ -0,0 +1,118 @@
+/*
+ * Unix SMB/CIFS implementation.
+ * Little dbwrap_rbt benchmark
+ *
+ * Copyright (C) Volker Lendecke 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "includes.h"
+#include "lib/dbwrap/dbwrap.h"
+#include "lib/dbwrap/dbwrap_rbt.h"
+#include "util_tdb.h"
+#include "proto.h"
+
+extern int torture_numops;
+
+static int bench_rbt_traverse_fn(struct db_record *rec, void *private_data)
+{
+	size_t *sum = (size_t *)private_data;
+	TDB_DATA value = dbwrap_record_get_value(rec);
+	*sum += value.dsize;
+	return 0;
+}
+
+static bool bench_rbt_run(struct db_context *db, const char *name)
+{
+	struct timeval start;
+	double fill_secs, walk_secs;
+	size_t sum = 0;
+	NTSTATUS status;
+	int i, ret;
+
+	start = timeval_current();
+
+	for (i=0; i<torture_numops; i++) {
+		char keystr[32], valuestr[64];
+		TDB_DATA value;
+
+		snprintf(keystr, sizeof(keystr), "key-%10d", i);
+		snprintf(valuestr, sizeof(valuestr),
+			 "value-%10d-abcdefghijklmnopqrstuvwxyz", i);
+		value = string_term_tdb_data(valuestr);
+
+		status = dbwrap_store(db, string_term_tdb_data(keystr),
+				      value, 0);
+		if (!NT_STATUS_IS_OK(status)) {
+			d_fprintf(stderr, "dbwrap_store failed: %s\n",
+				  nt_errstr(status));
+			return false;
+		}
+	}
+
+	fill_secs = timeval_elapsed(&start);
+
+	start = timeval_current();
+
+	for (i=0; i<10; i++) {
+		status = dbwrap_traverse_read(db, bench_rbt_traverse_fn,
+					      &sum, &ret);
+		if (!NT_STATUS_IS_OK(status)) {
+			d_fprintf(stderr, "dbwrap_traverse_read failed: %s\n",
+				  nt_errstr(status));
+			return false;
+		}
+		if (ret != torture_numops) {
+			d_fprintf(stderr, "traverse saw %d records, "
+				  "expected %d\n", ret, torture_numops);
+			return false;
+		}
+	}
+
+	walk_secs = timeval_elapsed(&start);
+
+	d_printf("%-10s %10d stores: %g secs, 10 traverses: %g secs "
+		 "(sum %zu)\n",
+		 name, torture_numops, fill_secs, walk_secs, sum);
+
+	return true;
+}
+
+bool run_bench_dbwrap_rbt(int dummy)
+{
+	struct db_context *db;
+	bool ok;
+
+	db = db_open_rbt(talloc_tos());
+	if (db == NULL) {
+		d_fprintf(stderr, "db_open_rbt failed\n");
+		return false;
+	}
+	ok = bench_rbt_run(db, "heap");
+	TALLOC_FREE(db);
+	if (!ok) {
+		return false;
+	}
+
+	db = db_open_rbt_pool(talloc_tos(), 16*1024*1024);
+	if (db == NULL) {
+		d_fprintf(stderr, "db_open_rbt_pool failed\n");
+		return false;
+	}
+	ok = bench_rbt_run(db, "pool");
+	TALLOC_FREE(db);
+
+	return ok;
+}
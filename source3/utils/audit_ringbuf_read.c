@@ -0,0 +1,179 @@
+/*
+ * Drain the audit ring buffers written by vfs_full_audit and
+ * vfs_time_audit (see source3/modules/audit_ringbuf.h) to stdout.
+ *
+ * Copyright (C) Samba Team 2016
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replace.h"
+#include "system/filesys.h"
+#include "modules/audit_ringbuf.h"
+
+struct ring {
+	const char *path;
+	struct audit_ringbuf_header *hdr;
+	uint8_t *data;
+	uint32_t size;
+	uint64_t dropped_seen;
+};
+
+static int ring_attach(struct ring *r, const char *path)
+{
+	struct stat st;
+	void *p;
+	int fd;
+
+	fd = open(path, O_RDWR);
+	if (fd == -1) {
+		fprintf(stderr, "open %s failed: %s\n", path,
+			strerror(errno));
+		return -1;
+	}
+	if (fstat(fd, &st) == -1 ||
+	    (size_t)st.st_size < sizeof(struct audit_ringbuf_header)) {
+		fprintf(stderr, "%s is not an audit ring file\n", path);
+		close(fd);
+		return -1;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		fprintf(stderr, "mmap %s failed: %s\n", path,
+			strerror(errno));
+		return -1;
+	}
+
+	r->path = path;
+	r->hdr = (struct audit_ringbuf_header *)p;
+	r->data = (uint8_t *)p + sizeof(struct audit_ringbuf_header);
+	r->size = r->hdr->size;
+	r->dropped_seen = r->hdr->dropped;
+
+	if ((r->hdr->magic != AUDIT_RINGBUF_MAGIC) ||
+	    (r->hdr->version != AUDIT_RINGBUF_VERSION) ||
+	    (r->size == 0) ||
+	    ((size_t)st.st_size <
+	     sizeof(struct audit_ringbuf_header) + r->size)) {
+		fprintf(stderr, "%s is not an audit ring file\n", path);
+		munmap(p, st.st_size);
+		return -1;
+	}
+	return 0;
+}
+
+static void ring_copy_out(struct ring *r, uint64_t pos, void *buf,
+			  size_t len)
+{
+	uint32_t off = pos % r->size;
+	size_t part = MIN(len, (size_t)(r->size - off));
+
+	memcpy(buf, r->data + off, part);
+	if (part < len) {
+		memcpy((uint8_t *)buf + part, r->data, len - part);
+	}
+}
+
+static void ring_drain(struct ring *r)
+{
+	uint64_t head = r->hdr->head;
+	uint64_t tail = r->hdr->tail;
+	uint64_t dropped = r->hdr->dropped;
+
+	/* the producer published head after the record bytes */
+	__sync_synchronize();
+
+	while (tail != head) {
+		uint32_t len;
+		char *buf;
+
+		ring_copy_out(r, tail, &len, sizeof(len));
+		if ((len == 0) || (len > r->size)) {
+			fprintf(stderr, "%s: corrupt record at %llu, "
+				"skipping to head\n", r->path,
+				(unsigned long long)tail);
+			tail = head;
+			break;
+		}
+		buf = malloc(len);
+		if (buf == NULL) {
+			break;
+		}
+		ring_copy_out(r, tail + sizeof(len), buf, len);
+		buf[len - 1] = '\0';
+		printf("%s\n", buf);
+		free(buf);
+
+		tail += sizeof(len) + ((len + 3) & ~(uint32_t)3);
+	}
+
+	if (dropped != r->dropped_seen) {
+		fprintf(stderr, "%s: %llu records dropped\n", r->path,
+			(unsigned long long)(dropped - r->dropped_seen));
+		r->dropped_seen = dropped;
+	}
+
+	/* release the space only after the record bytes are read */
+	__sync_synchronize();
+	r->hdr->tail = tail;
+}
+
+static void usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [-f] <ringfile> [<ringfile> ...]\n",
+		progname);
+	fprintf(stderr, "  -f   keep polling the ring files "
+		"(tail -f style)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct ring *rings;
+	bool follow = false;
+	int first_arg = 1;
+	int num_rings, i;
+
+	if ((argc > 1) && (strcmp(argv[1], "-f") == 0)) {
+		follow = true;
+		first_arg = 2;
+	}
+	if (first_arg >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	num_rings = argc - first_arg;
+	rings = calloc(num_rings, sizeof(struct ring));
+	if (rings == NULL) {
+		return 1;
+	}
+	for (i = 0; i < num_rings; i++) {
+		if (ring_attach(&rings[i], argv[first_arg + i]) == -1) {
+			return 1;
+		}
+	}
+
+	do {
+		for (i = 0; i < num_rings; i++) {
+			ring_drain(&rings[i]);
+		}
+		fflush(stdout);
+		if (follow) {
+			usleep(100000);
+		}
+	} while (follow);
+
+	return 0;
+}
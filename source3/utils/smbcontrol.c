@@ -886,6 +886,130 @@ static bool do_poolusage(struct tevent_context *ev_ctx,
 	return num_replies;
 }
 
+/* Fetch the tevent handler latency histogram */
+
+static bool do_event_profile(struct tevent_context *ev_ctx,
+			     struct messaging_context *msg_ctx,
+			     const struct server_id pid,
+			     const int argc, const char **argv)
+{
+	if (argc != 1) {
+		fprintf(stderr, "Usage: smbcontrol <dest> event-profile\n");
+		return False;
+	}
+
+	messaging_register(msg_ctx, NULL, MSG_EVENT_PROFILE, print_string_cb);
+
+	/* Send a message and register our interest in a reply */
+
+	if (!send_message(msg_ctx, pid, MSG_REQ_EVENT_PROFILE, NULL, 0))
+		return False;
+
+	wait_replies(ev_ctx, msg_ctx, procid_to_pid(&pid) == 0);
+
+	/* No replies were received within the timeout period */
+
+	if (num_replies == 0)
+		printf("No replies received\n");
+
+	messaging_deregister(msg_ctx, MSG_EVENT_PROFILE, NULL);
+
+	return num_replies;
+}
+
+/* Fetch the schannel session store cache counters */
+
+static bool do_schannel_stats(struct tevent_context *ev_ctx,
+			      struct messaging_context *msg_ctx,
+			      const struct server_id pid,
+			      const int argc, const char **argv)
+{
+	if (argc != 1) {
+		fprintf(stderr, "Usage: smbcontrol <dest> schannel-stats\n");
+		return False;
+	}
+
+	messaging_register(msg_ctx, NULL, MSG_SCHANNEL_STATS, print_string_cb);
+
+	/* Send a message and register our interest in a reply */
+
+	if (!send_message(msg_ctx, pid, MSG_REQ_SCHANNEL_STATS, NULL, 0))
+		return False;
+
+	wait_replies(ev_ctx, msg_ctx, procid_to_pid(&pid) == 0);
+
+	/* No replies were received within the timeout period */
+
+	if (num_replies == 0)
+		printf("No replies received\n");
+
+	messaging_deregister(msg_ctx, MSG_SCHANNEL_STATS, NULL);
+
+	return num_replies;
+}
+
+/* Fetch the in-memory cache usage counters */
+
+static bool do_memcache_stats(struct tevent_context *ev_ctx,
+			      struct messaging_context *msg_ctx,
+			      const struct server_id pid,
+			      const int argc, const char **argv)
+{
+	if (argc != 1) {
+		fprintf(stderr, "Usage: smbcontrol <dest> memcache-stats\n");
+		return False;
+	}
+
+	messaging_register(msg_ctx, NULL, MSG_MEMCACHE_STATS, print_string_cb);
+
+	/* Send a message and register our interest in a reply */
+
+	if (!send_message(msg_ctx, pid, MSG_REQ_MEMCACHE_STATS, NULL, 0))
+		return False;
+
+	wait_replies(ev_ctx, msg_ctx, procid_to_pid(&pid) == 0);
+
+	/* No replies were received within the timeout period */
+
+	if (num_replies == 0)
+		printf("No replies received\n");
+
+	messaging_deregister(msg_ctx, MSG_MEMCACHE_STATS, NULL);
+
+	return num_replies;
+}
+
+/* Fetch the per-opnum RPC call statistics */
+
+static bool do_rpc_stats(struct tevent_context *ev_ctx,
+			 struct messaging_context *msg_ctx,
+			 const struct server_id pid,
+			 const int argc, const char **argv)
+{
+	if (argc != 1) {
+		fprintf(stderr, "Usage: smbcontrol <dest> rpc-stats\n");
+		return False;
+	}
+
+	messaging_register(msg_ctx, NULL, MSG_RPC_STATS, print_string_cb);
+
+	/* Send a message and register our interest in a reply */
+
+	if (!send_message(msg_ctx, pid, MSG_REQ_RPC_STATS, NULL, 0))
+		return False;
+
+	wait_replies(ev_ctx, msg_ctx, procid_to_pid(&pid) == 0);
+
+	/* No replies were received within the timeout period */
+
+	if (num_replies == 0)
+		printf("No replies received\n");
+
+	messaging_deregister(msg_ctx, MSG_RPC_STATS, NULL);
+
+	return num_replies;
+}
+
 /* Perform a dmalloc mark */
 
 static bool do_dmalloc_mark(struct tevent_context *ev_ctx,
@@ -1385,6 +1509,14 @@ static const struct {
 	{ "lockretry", do_lockretry, "Force a blocking lock retry" },
 	{ "brl-revalidate", do_brl_revalidate, "Revalidate all brl entries" },
 	{ "pool-usage", do_poolusage, "Display talloc memory usage" },
+	{ "event-profile", do_event_profile,
+	  "Display tevent handler latency histogram" },
+	{ "schannel-stats", do_schannel_stats,
+	  "Display schannel store cache counters" },
+	{ "rpc-stats", do_rpc_stats,
+	  "Display per-opnum RPC call statistics" },
+	{ "memcache-stats", do_memcache_stats,
+	  "Display in-memory cache usage counters" },
 	{ "dmalloc-mark", do_dmalloc_mark, "" },
 	{ "dmalloc-log-changed", do_dmalloc_changed, "" },
 	{ "shutdown", do_shutdown, "Shut down daemon" },
@@ -37,6 +37,46 @@ static void profile_separator(const char * title)
     d_printf("%s\n", line);
 }
 
+/*
+ * Estimate a percentile from a log2 latency histogram. The value
+ * returned is the upper bound of the bucket the percentile falls
+ * into, in microseconds.
+ */
+static uint64_t profile_hist_percentile(const uint64_t *hist,
+					uint64_t total,
+					unsigned int p)
+{
+	uint64_t target = (total * p + 99) / 100;
+	uint64_t seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < SMBPROFILE_TIME_HIST_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen >= target) {
+			return (uint64_t)2 << i;
+		}
+	}
+	return 0;
+}
+
+static void profile_print_percentiles(const char *name,
+				      const uint64_t *hist,
+				      uint64_t count)
+{
+	char label[60];
+
+	if (count == 0) {
+		return;
+	}
+
+	snprintf(label, sizeof(label), "%s_latency:", name);
+	d_printf("%-39s p50=%10juus p95=%10juus p99=%10juus\n",
+		 label,
+		 (uintmax_t)profile_hist_percentile(hist, count, 50),
+		 (uintmax_t)profile_hist_percentile(hist, count, 95),
+		 (uintmax_t)profile_hist_percentile(hist, count, 99));
+}
+
 /*******************************************************************
  dump the elements of the profile structure
   ******************************************************************/
@@ -73,6 +113,9 @@ bool status_profile_dump(bool verbose)
 	__PRINT_FIELD_LINE(#name, name##_stats,  time); \
 	__PRINT_FIELD_LINE(#name, name##_stats,  idle); \
 	__PRINT_FIELD_LINE(#name, name##_stats,  bytes); \
+	profile_print_percentiles(#name, \
+				  stats.values.name##_stats.time_hist, \
+				  stats.values.name##_stats.count); \
 } while(0);
 #define SMBPROFILE_STATS_IOBYTES(name) do { \
 	__PRINT_FIELD_LINE(#name, name##_stats,  count); \
@@ -80,6 +123,9 @@ bool status_profile_dump(bool verbose)
 	__PRINT_FIELD_LINE(#name, name##_stats,  idle); \
 	__PRINT_FIELD_LINE(#name, name##_stats,  inbytes); \
 	__PRINT_FIELD_LINE(#name, name##_stats,  outbytes); \
+	profile_print_percentiles(#name, \
+				  stats.values.name##_stats.time_hist, \
+				  stats.values.name##_stats.count); \
 } while(0);
 #define SMBPROFILE_STATS_SECTION_END
 #define SMBPROFILE_STATS_END
@@ -89,6 +89,140 @@ static struct db_context *autorid_db;
 
 static bool ignore_builtin = false;
 
+/*
+ * Range mappings are effectively append-only, so keep an in-memory
+ * copy of all domain <-> range assignments. The copy is validated
+ * against the database with a single lock-free sequence number read
+ * and rebuilt from scratch whenever the sequence number has changed,
+ * e.g. because a new range was allocated or "net idmap" modified the
+ * database. The hot sid->xid and xid->sid calculations thus take no
+ * tdb locks and fetch no records at all.
+ */
+
+struct autorid_cached_range {
+	fstring domsid;
+	uint32_t domain_range_index;
+	uint32_t rangenum;
+};
+
+struct autorid_range_cache {
+	int seqnum;
+	uint32_t num_ranges;
+	struct autorid_cached_range *ranges;
+};
+
+static struct autorid_range_cache *autorid_cache;
+
+static NTSTATUS idmap_autorid_cache_fill_visitor(struct db_context *db,
+						 const char *domsid,
+						 uint32_t domain_range_index,
+						 uint32_t rangenum,
+						 void *private_data)
+{
+	struct autorid_range_cache *cache =
+		(struct autorid_range_cache *)private_data;
+	struct autorid_cached_range *tmp;
+
+	tmp = talloc_realloc(cache, cache->ranges,
+			     struct autorid_cached_range,
+			     cache->num_ranges + 1);
+	if (tmp == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	cache->ranges = tmp;
+
+	fstrcpy(cache->ranges[cache->num_ranges].domsid, domsid);
+	cache->ranges[cache->num_ranges].domain_range_index =
+		domain_range_index;
+	cache->ranges[cache->num_ranges].rangenum = rangenum;
+	cache->num_ranges += 1;
+
+	return NT_STATUS_OK;
+}
+
+static bool idmap_autorid_cache_update(void)
+{
+	struct autorid_range_cache *cache;
+	NTSTATUS status;
+	int seqnum;
+
+	seqnum = dbwrap_get_seqnum(autorid_db);
+
+	if ((autorid_cache != NULL) && (autorid_cache->seqnum == seqnum)) {
+		return true;
+	}
+
+	cache = talloc_zero(NULL, struct autorid_range_cache);
+	if (cache == NULL) {
+		return false;
+	}
+	cache->seqnum = seqnum;
+
+	status = idmap_autorid_iterate_domain_ranges_read(
+		autorid_db, NULL, idmap_autorid_cache_fill_visitor,
+		cache, NULL);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(3, ("Could not rebuild the range cache: %s\n",
+			  nt_errstr(status)));
+		talloc_free(cache);
+		return false;
+	}
+
+	DEBUG(10, ("Rebuilt range cache with %"PRIu32" ranges at "
+		   "sequence number %d\n", cache->num_ranges, seqnum));
+
+	TALLOC_FREE(autorid_cache);
+	autorid_cache = cache;
+
+	return true;
+}
+
+static bool idmap_autorid_cache_getrange(const char *domsid,
+					 uint32_t domain_range_index,
+					 uint32_t *rangenum)
+{
+	uint32_t i;
+
+	if (!idmap_autorid_cache_update()) {
+		return false;
+	}
+
+	for (i = 0; i < autorid_cache->num_ranges; i++) {
+		struct autorid_cached_range *r = &autorid_cache->ranges[i];
+
+		if ((r->domain_range_index == domain_range_index) &&
+		    strequal(r->domsid, domsid)) {
+			*rangenum = r->rangenum;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool idmap_autorid_cache_getdomain(uint32_t rangenum,
+					  const char **domsid,
+					  uint32_t *domain_range_index)
+{
+	uint32_t i;
+
+	if (!idmap_autorid_cache_update()) {
+		return false;
+	}
+
+	for (i = 0; i < autorid_cache->num_ranges; i++) {
+		struct autorid_cached_range *r = &autorid_cache->ranges[i];
+
+		if (r->rangenum == rangenum) {
+			*domsid = r->domsid;
+			*domain_range_index = r->domain_range_index;
+			return true;
+		}
+	}
+
+	return false;
+}
+
 static NTSTATUS idmap_autorid_get_alloc_range(struct idmap_domain *dom,
 					struct autorid_range_config *range)
 {
@@ -179,6 +313,7 @@ static NTSTATUS idmap_autorid_id_to_sid(struct autorid_global_config *cfg,
 	NTSTATUS status;
 	bool ok;
 	const char *q = NULL;
+	const char *cached_domsid = NULL;
 
 	/* can this be one of our ids? */
 	if (map->xid.id < cfg->minvalue) {
@@ -200,6 +335,25 @@ static NTSTATUS idmap_autorid_id_to_sid(struct autorid_global_config *cfg,
 	normalized_id = map->xid.id - cfg->minvalue;
 	range_number = normalized_id / cfg->rangesize;
 
+	if (idmap_autorid_cache_getdomain(range_number, &cached_domsid,
+					  &domain_range_index)) {
+		if (strncmp(cached_domsid, ALLOC_RANGE,
+			    strlen(ALLOC_RANGE)) == 0) {
+			DEBUG(5, ("id %d belongs to allocation range, "
+				  "checking for mapping\n",
+				  map->xid.id));
+			return idmap_autorid_id_to_sid_alloc(dom, map);
+		}
+
+		ok = dom_sid_parse(cached_domsid, &domsid);
+		if (!ok) {
+			map->status = ID_UNKNOWN;
+			return NT_STATUS_OK;
+		}
+
+		goto calc;
+	}
+
 	keystr = talloc_asprintf(talloc_tos(), "%u", range_number);
 	if (!keystr) {
 		return NT_STATUS_NO_MEMORY;
@@ -244,6 +398,7 @@ static NTSTATUS idmap_autorid_id_to_sid(struct autorid_global_config *cfg,
 			return NT_STATUS_OK;
 		}
 
+calc:
 	reduced_rid = normalized_id % cfg->rangesize;
 	rid = reduced_rid + domain_range_index * cfg->rangesize;
 
@@ -564,6 +719,15 @@ static NTSTATUS idmap_autorid_sid_to_id(struct idmap_tdb_common_context *common,
 
 	range.domain_range_index = rid / (global->rangesize);
 
+	if (idmap_autorid_cache_getrange(range.domsid,
+					 range.domain_range_index,
+					 &range.rangenum)) {
+		range.low_id = global->minvalue
+			     + range.rangenum * global->rangesize;
+
+		return idmap_autorid_sid_to_id_rid(global, &range, map);
+	}
+
 	ret = idmap_autorid_get_domainrange(autorid_db, &range, dom->read_only);
 	if (NT_STATUS_EQUAL(ret, NT_STATUS_NOT_FOUND) && dom->read_only) {
 		DEBUG(10, ("read-only is enabled, did not allocate "
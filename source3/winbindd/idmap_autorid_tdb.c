@@ -717,8 +717,12 @@ NTSTATUS idmap_autorid_db_open(const char *path,
 		return NT_STATUS_OK;
 	}
 
-	/* Open idmap repository */
-	*db = db_open(mem_ctx, path, 0, TDB_DEFAULT, O_RDWR | O_CREAT, 0644,
+	/*
+	 * Open idmap repository. TDB_SEQNUM lets readers cheaply
+	 * detect modifications and cache range mappings in memory.
+	 */
+	*db = db_open(mem_ctx, path, 0, TDB_DEFAULT | TDB_SEQNUM,
+		      O_RDWR | O_CREAT, 0644,
 		      DBWRAP_LOCK_ORDER_1, DBWRAP_FLAG_NONE);
 
 	if (*db == NULL) {
@@ -38,6 +38,130 @@
  * TODO: fill_grent_mem_domusers must be re-added
  */
 
+/*
+ * Memoized group->members edges. Building a token for a user in many
+ * nested groups re-expands largely the same subtrees over and over, so
+ * remember each group's direct member list for a while. An entry is
+ * dropped when its TTL has expired or when the owning domain's
+ * sequence number has moved on.
+ */
+
+#define WB_GROUPMEM_CACHE_MAX_ENTRIES 1000
+
+struct wb_groupmem_cache_entry {
+	struct wb_groupmem_cache_entry *prev, *next;
+	struct dom_sid sid;
+	uint32_t sequence_number;
+	time_t timeout;
+	int num_members;
+	struct wbint_Principal *members;
+};
+
+static struct wb_groupmem_cache_entry *wb_groupmem_cache;
+static int wb_groupmem_cache_size;
+
+static struct wbint_Principal *wb_groupmem_copy_principals(
+	TALLOC_CTX *mem_ctx, int num_members, struct wbint_Principal *src)
+{
+	struct wbint_Principal *dst;
+	int i;
+
+	dst = talloc_array(mem_ctx, struct wbint_Principal, num_members);
+	if (dst == NULL) {
+		return NULL;
+	}
+
+	for (i=0; i<num_members; i++) {
+		sid_copy(&dst[i].sid, &src[i].sid);
+		dst[i].type = src[i].type;
+		dst[i].name = NULL;
+		if (src[i].name != NULL) {
+			dst[i].name = talloc_strdup(dst, src[i].name);
+			if (dst[i].name == NULL) {
+				talloc_free(dst);
+				return NULL;
+			}
+		}
+	}
+
+	return dst;
+}
+
+static struct wb_groupmem_cache_entry *wb_groupmem_cache_fetch(
+	struct winbindd_domain *domain, const struct dom_sid *sid)
+{
+	struct wb_groupmem_cache_entry *entry;
+	time_t now = time(NULL);
+
+	for (entry = wb_groupmem_cache; entry != NULL; entry = entry->next) {
+		if (!dom_sid_equal(&entry->sid, sid)) {
+			continue;
+		}
+		if ((entry->timeout <= now) ||
+		    (entry->sequence_number != domain->sequence_number)) {
+			DLIST_REMOVE(wb_groupmem_cache, entry);
+			wb_groupmem_cache_size -= 1;
+			TALLOC_FREE(entry);
+			return NULL;
+		}
+		/* keep hot edges at the front */
+		DLIST_PROMOTE(wb_groupmem_cache, entry);
+		return entry;
+	}
+
+	return NULL;
+}
+
+static void wb_groupmem_cache_store(struct winbindd_domain *domain,
+				    const struct dom_sid *sid,
+				    int num_members,
+				    struct wbint_Principal *members)
+{
+	struct wb_groupmem_cache_entry *entry;
+
+	if (lp_winbind_cache_time() == 0) {
+		return;
+	}
+
+	/* a parallel expansion might have stored this edge already */
+	entry = wb_groupmem_cache_fetch(domain, sid);
+	if (entry != NULL) {
+		DLIST_REMOVE(wb_groupmem_cache, entry);
+		wb_groupmem_cache_size -= 1;
+		TALLOC_FREE(entry);
+	}
+
+	entry = talloc_zero(NULL, struct wb_groupmem_cache_entry);
+	if (entry == NULL) {
+		return;
+	}
+	sid_copy(&entry->sid, sid);
+	entry->sequence_number = domain->sequence_number;
+	entry->timeout = time(NULL) + lp_winbind_cache_time();
+	entry->num_members = num_members;
+
+	if (num_members != 0) {
+		entry->members = wb_groupmem_copy_principals(
+			entry, num_members, members);
+		if (entry->members == NULL) {
+			talloc_free(entry);
+			return;
+		}
+	}
+
+	while (wb_groupmem_cache_size >= WB_GROUPMEM_CACHE_MAX_ENTRIES) {
+		struct wb_groupmem_cache_entry *last =
+			DLIST_TAIL(wb_groupmem_cache);
+
+		DLIST_REMOVE(wb_groupmem_cache, last);
+		wb_groupmem_cache_size -= 1;
+		TALLOC_FREE(last);
+	}
+
+	DLIST_ADD(wb_groupmem_cache, entry);
+	wb_groupmem_cache_size += 1;
+}
+
 /*
  * Look up members of a single group. Essentially a wrapper around the
  * lookup_groupmem winbindd_methods routine.
@@ -45,6 +169,7 @@
 
 struct wb_lookupgroupmem_state {
 	struct dom_sid sid;
+	struct winbindd_domain *domain;
 	struct wbint_Principals members;
 };
 
@@ -58,6 +183,7 @@ static struct tevent_req *wb_lookupgroupmem_send(TALLOC_CTX *mem_ctx,
 	struct tevent_req *req, *subreq;
 	struct wb_lookupgroupmem_state *state;
 	struct winbindd_domain *domain;
+	struct wb_groupmem_cache_entry *entry;
 
 	req = tevent_req_create(mem_ctx, &state,
 				struct wb_lookupgroupmem_state);
@@ -71,6 +197,20 @@ static struct tevent_req *wb_lookupgroupmem_send(TALLOC_CTX *mem_ctx,
 		tevent_req_nterror(req, NT_STATUS_NO_SUCH_GROUP);
 		return tevent_req_post(req, ev);
 	}
+	state->domain = domain;
+
+	entry = wb_groupmem_cache_fetch(domain, group_sid);
+	if (entry != NULL) {
+		state->members.num_principals = entry->num_members;
+		state->members.principals = wb_groupmem_copy_principals(
+			state, entry->num_members, entry->members);
+		if ((entry->num_members != 0) &&
+		    tevent_req_nomem(state->members.principals, req)) {
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
 
 	subreq = dcerpc_wbint_LookupGroupMembers_send(
 		state, ev, dom_child_handle(domain), &state->sid, type,
@@ -96,6 +236,11 @@ static void wb_lookupgroupmem_done(struct tevent_req *subreq)
 		tevent_req_nterror(req, status);
 		return;
 	}
+
+	wb_groupmem_cache_store(state->domain, &state->sid,
+				state->members.num_principals,
+				state->members.principals);
+
 	tevent_req_done(req);
 }
 
@@ -22,6 +22,38 @@
 #include "librpc/gen_ndr/ndr_winbind_c.h"
 #include "../libcli/security/security.h"
 
+/*
+ * Individual lookupsid calls against the same domain are coalesced
+ * into one wbint_LookupSids call per domain: the first request for a
+ * domain fires on the next event loop round, and everything that
+ * arrives while that call is on the wire piles up into the next
+ * batch. During a login storm this turns thousands of single-SID
+ * round trips to the DC into a few lsa_LookupSids calls, without
+ * adding latency when winbindd is idle.
+ */
+
+#define WB_LOOKUPSID_MAX_BATCH 500
+
+struct wb_lookupsid_batch {
+	struct wb_lookupsid_batch *prev, *next;
+	struct tevent_context *ev;
+	struct winbindd_domain *domain;
+	bool in_flight;
+
+	/*
+	 * Pending requests. Entries are NULLed by the state
+	 * destructor when a caller gives up on a request.
+	 */
+	struct tevent_req **reqs;
+	uint32_t num_reqs;
+
+	struct lsa_SidArray sids;
+	struct lsa_RefDomainList domains;
+	struct lsa_TransNameArray names;
+};
+
+static struct wb_lookupsid_batch *wb_lookupsid_batches;
+
 struct wb_lookupsid_state {
 	struct tevent_context *ev;
 	struct winbindd_domain *lookup_domain;
@@ -29,15 +61,44 @@ struct wb_lookupsid_state {
 	enum lsa_SidType type;
 	const char *domname;
 	const char *name;
+
+	/* the batch this request is queued on, NULL once dispatched */
+	struct wb_lookupsid_batch *batch;
 };
 
+static bool wb_lookupsid_batch_join(struct tevent_req *req);
+static void wb_lookupsid_batch_trigger(struct tevent_context *ev,
+				       struct tevent_immediate *im,
+				       void *private_data);
+static void wb_lookupsid_batch_fire(struct wb_lookupsid_batch *batch);
+static void wb_lookupsid_batch_done(struct tevent_req *subreq);
+static bool wb_lookupsid_single(struct tevent_req *req);
 static void wb_lookupsid_done(struct tevent_req *subreq);
 
+static int wb_lookupsid_state_destructor(struct wb_lookupsid_state *state)
+{
+	struct wb_lookupsid_batch *batch = state->batch;
+	uint32_t i;
+
+	if (batch == NULL) {
+		return 0;
+	}
+	for (i=0; i<batch->num_reqs; i++) {
+		if ((batch->reqs[i] != NULL) &&
+		    (tevent_req_data(batch->reqs[i],
+				     struct wb_lookupsid_state) == state)) {
+			batch->reqs[i] = NULL;
+			break;
+		}
+	}
+	return 0;
+}
+
 struct tevent_req *wb_lookupsid_send(TALLOC_CTX *mem_ctx,
 				     struct tevent_context *ev,
 				     const struct dom_sid *sid)
 {
-	struct tevent_req *req, *subreq;
+	struct tevent_req *req;
 	struct wb_lookupsid_state *state;
 
 	req = tevent_req_create(mem_ctx, &state, struct wb_lookupsid_state);
@@ -55,14 +116,274 @@ struct tevent_req *wb_lookupsid_send(TALLOC_CTX *mem_ctx,
 		return tevent_req_post(req, ev);
 	}
 
+	if (!wb_lookupsid_batch_join(req)) {
+		return tevent_req_post(req, ev);
+	}
+	return req;
+}
+
+/*
+  queue a request on the pending batch for its lookup domain,
+  creating the batch if required
+*/
+static bool wb_lookupsid_batch_join(struct tevent_req *req)
+{
+	struct wb_lookupsid_state *state = tevent_req_data(
+		req, struct wb_lookupsid_state);
+	struct wb_lookupsid_batch *batch;
+	bool have_in_flight = false;
+	struct tevent_req **reqs;
+
+	for (batch = wb_lookupsid_batches; batch != NULL;
+	     batch = batch->next) {
+		if ((batch->domain != state->lookup_domain) ||
+		    (batch->ev != state->ev)) {
+			continue;
+		}
+		if (batch->in_flight) {
+			have_in_flight = true;
+			continue;
+		}
+		if (batch->num_reqs >= WB_LOOKUPSID_MAX_BATCH) {
+			continue;
+		}
+		break;
+	}
+
+	if (batch == NULL) {
+		batch = talloc_zero(NULL, struct wb_lookupsid_batch);
+		if (tevent_req_nomem(batch, req)) {
+			return false;
+		}
+		batch->ev = state->ev;
+		batch->domain = state->lookup_domain;
+
+		/*
+		 * With a batch for this domain already on the wire no
+		 * immediate is scheduled: the new batch is fired when
+		 * the in-flight one completes, so everything arriving
+		 * during the round trip goes out in one call.
+		 */
+		if (!have_in_flight) {
+			struct tevent_immediate *im;
+
+			im = tevent_create_immediate(batch);
+			if (im == NULL) {
+				TALLOC_FREE(batch);
+				tevent_req_oom(req);
+				return false;
+			}
+			tevent_schedule_immediate(
+				im, batch->ev, wb_lookupsid_batch_trigger,
+				batch);
+		}
+
+		DLIST_ADD_END(wb_lookupsid_batches, batch,
+			      struct wb_lookupsid_batch *);
+	}
+
+	reqs = talloc_realloc(batch, batch->reqs, struct tevent_req *,
+			      batch->num_reqs + 1);
+	if (tevent_req_nomem(reqs, req)) {
+		return false;
+	}
+	batch->reqs = reqs;
+	batch->reqs[batch->num_reqs] = req;
+	batch->num_reqs += 1;
+
+	state->batch = batch;
+	talloc_set_destructor(state, wb_lookupsid_state_destructor);
+	return true;
+}
+
+static void wb_lookupsid_batch_trigger(struct tevent_context *ev,
+				       struct tevent_immediate *im,
+				       void *private_data)
+{
+	struct wb_lookupsid_batch *batch = talloc_get_type_abort(
+		private_data, struct wb_lookupsid_batch);
+
+	wb_lookupsid_batch_fire(batch);
+}
+
+/*
+  send the collected sids of a batch to the domain child in one
+  wbint_LookupSids call
+*/
+static void wb_lookupsid_batch_fire(struct wb_lookupsid_batch *batch)
+{
+	struct tevent_req *subreq;
+	uint32_t i, num_live;
+
+	/*
+	 * compact away requests the callers have abandoned, so that
+	 * reqs and the sid array line up index for index
+	 */
+	num_live = 0;
+	for (i=0; i<batch->num_reqs; i++) {
+		if (batch->reqs[i] != NULL) {
+			batch->reqs[num_live] = batch->reqs[i];
+			num_live += 1;
+		}
+	}
+	batch->num_reqs = num_live;
+
+	if (num_live == 0) {
+		DLIST_REMOVE(wb_lookupsid_batches, batch);
+		TALLOC_FREE(batch);
+		return;
+	}
+
+	batch->sids.sids = talloc_array(batch, struct lsa_SidPtr, num_live);
+	if (batch->sids.sids == NULL) {
+		goto nomem;
+	}
+	for (i=0; i<num_live; i++) {
+		struct wb_lookupsid_state *state = tevent_req_data(
+			batch->reqs[i], struct wb_lookupsid_state);
+		batch->sids.sids[i].sid = dom_sid_dup(batch->sids.sids,
+						      &state->sid);
+		if (batch->sids.sids[i].sid == NULL) {
+			goto nomem;
+		}
+	}
+	batch->sids.num_sids = num_live;
+
+	subreq = dcerpc_wbint_LookupSids_send(
+		batch, batch->ev, dom_child_handle(batch->domain),
+		&batch->sids, &batch->domains, &batch->names);
+	if (subreq == NULL) {
+		goto nomem;
+	}
+	tevent_req_set_callback(subreq, wb_lookupsid_batch_done, batch);
+	batch->in_flight = true;
+	return;
+
+nomem:
+	DLIST_REMOVE(wb_lookupsid_batches, batch);
+	for (i=0; i<batch->num_reqs; i++) {
+		struct tevent_req *req = batch->reqs[i];
+		struct wb_lookupsid_state *state;
+
+		if (req == NULL) {
+			continue;
+		}
+		state = tevent_req_data(req, struct wb_lookupsid_state);
+		state->batch = NULL;
+		tevent_req_oom(req);
+	}
+	TALLOC_FREE(batch);
+}
+
+static void wb_lookupsid_batch_done(struct tevent_req *subreq)
+{
+	struct wb_lookupsid_batch *batch = tevent_req_callback_data(
+		subreq, struct wb_lookupsid_batch);
+	struct wb_lookupsid_batch *pending;
+	struct winbindd_domain *domain = batch->domain;
+	struct tevent_context *ev = batch->ev;
+	bool fallback = false;
+	NTSTATUS status, result;
+	uint32_t i;
+
+	/*
+	 * unlink first - requests re-issued below must go onto a
+	 * fresh batch, not onto the one being completed
+	 */
+	DLIST_REMOVE(wb_lookupsid_batches, batch);
+
+	status = dcerpc_wbint_LookupSids_recv(subreq, batch, &result);
+	TALLOC_FREE(subreq);
+
+	if (!NT_STATUS_IS_OK(status) || NT_STATUS_IS_ERR(result)) {
+		fallback = true;
+	} else if (batch->names.count != batch->sids.num_sids) {
+		fallback = true;
+	}
+
+	for (i=0; i<batch->num_reqs; i++) {
+		struct tevent_req *req = batch->reqs[i];
+		struct wb_lookupsid_state *state;
+		struct lsa_TranslatedName *n;
+
+		if (req == NULL) {
+			continue;
+		}
+		state = tevent_req_data(req, struct wb_lookupsid_state);
+		state->batch = NULL;
+
+		if (fallback) {
+			/*
+			 * Let the whole batch go through the original
+			 * single-sid path
+			 */
+			wb_lookupsid_single(req);
+			continue;
+		}
+
+		n = &batch->names.names[i];
+		if ((n->sid_type == SID_NAME_UNKNOWN) ||
+		    (n->sid_index >= batch->domains.count)) {
+			/*
+			 * Retry unknown SIDs individually, this also
+			 * tries the forest root
+			 */
+			wb_lookupsid_single(req);
+			continue;
+		}
+
+		state->type = n->sid_type;
+		state->domname = talloc_strdup(
+			state,
+			batch->domains.domains[n->sid_index].name.string);
+		if (tevent_req_nomem(state->domname, req)) {
+			continue;
+		}
+		if (n->name.string != NULL) {
+			state->name = talloc_move(state, &n->name.string);
+		} else {
+			state->name = talloc_strdup(state, "");
+			if (tevent_req_nomem(state->name, req)) {
+				continue;
+			}
+		}
+		tevent_req_done(req);
+	}
+
+	TALLOC_FREE(batch);
+
+	/*
+	 * fire the batch that collected requests while we were on the
+	 * wire, if any
+	 */
+	for (pending = wb_lookupsid_batches; pending != NULL;
+	     pending = pending->next) {
+		if ((pending->domain == domain) && (pending->ev == ev) &&
+		    !pending->in_flight) {
+			wb_lookupsid_batch_fire(pending);
+			break;
+		}
+	}
+}
+
+/*
+  the original unbatched path, used as fallback and for the forest
+  root retry
+*/
+static bool wb_lookupsid_single(struct tevent_req *req)
+{
+	struct wb_lookupsid_state *state = tevent_req_data(
+		req, struct wb_lookupsid_state);
+	struct tevent_req *subreq;
+
 	subreq = dcerpc_wbint_LookupSid_send(
-		state, ev, dom_child_handle(state->lookup_domain),
+		state, state->ev, dom_child_handle(state->lookup_domain),
 		&state->sid, &state->type, &state->domname, &state->name);
 	if (tevent_req_nomem(subreq, req)) {
-		return tevent_req_post(req, ev);
+		return false;
 	}
 	tevent_req_set_callback(subreq, wb_lookupsid_done, req);
-	return req;
+	return true;
 }
 
 static void wb_lookupsid_done(struct tevent_req *subreq)
@@ -22,36 +22,148 @@
 #include "librpc/gen_ndr/ndr_winbind_c.h"
 #include "passdb/machine_sid.h"
 
+/*
+ * Users are enumerated page-wise, so a getpwent cursor only ever holds
+ * one page of a domain's user list in the parent. While a page drains
+ * to the NSS client the next one is prefetched in the background.
+ */
+#define WB_NEXT_PWENT_PAGE_SIZE 500
+
 struct wb_next_pwent_state {
 	struct tevent_context *ev;
 	struct getpwent_state *gstate;
 	struct winbindd_pw *pw;
 };
 
+/* an in-flight or completed background fetch of the next page */
+struct getpwent_prefetch {
+	struct tevent_req *subreq;
+	bool valid;
+	NTSTATUS status;
+	int num_users;
+	struct wbint_userinfo *users;
+	uint32_t next_index;
+};
+
+static void wb_next_pwent_send_do(struct tevent_req *req,
+				  struct wb_next_pwent_state *state);
 static void wb_next_pwent_fetch_done(struct tevent_req *subreq);
 static void wb_next_pwent_fill_done(struct tevent_req *subreq);
+static void wb_next_pwent_prefetch_done(struct tevent_req *subreq);
+
+static void wb_next_pwent_install_page(struct getpwent_state *gstate,
+				       struct getpwent_prefetch *pf)
+{
+	if (!NT_STATUS_IS_OK(pf->status)) {
+		/* Ignore errors here, just log it */
+		DEBUG(10, ("query_user_list for domain %s returned %s\n",
+			   gstate->domain->name, nt_errstr(pf->status)));
+		pf->num_users = 0;
+	}
+
+	gstate->users = talloc_move(gstate, &pf->users);
+	gstate->num_users = pf->num_users;
+	gstate->next_user = 0;
+	gstate->resume_index = pf->next_index;
+
+	/* a short page means the domain is exhausted */
+	if (gstate->num_users < WB_NEXT_PWENT_PAGE_SIZE) {
+		gstate->got_last_page = true;
+	}
+}
+
+static void wb_next_pwent_prefetch(struct getpwent_state *gstate,
+				   struct tevent_context *ev)
+{
+	struct getpwent_prefetch *pf;
+
+	if ((gstate->prefetch != NULL) || gstate->got_last_page ||
+	    (gstate->domain == NULL)) {
+		return;
+	}
+
+	pf = talloc_zero(gstate, struct getpwent_prefetch);
+	if (pf == NULL) {
+		/* degrade to fetching pages on demand */
+		return;
+	}
+
+	pf->subreq = wb_query_user_list_send(pf, ev, gstate->domain,
+					     gstate->resume_index,
+					     WB_NEXT_PWENT_PAGE_SIZE);
+	if (pf->subreq == NULL) {
+		TALLOC_FREE(pf);
+		return;
+	}
+	tevent_req_set_callback(pf->subreq, wb_next_pwent_prefetch_done, pf);
+	gstate->prefetch = pf;
+}
+
+static void wb_next_pwent_prefetch_done(struct tevent_req *subreq)
+{
+	struct getpwent_prefetch *pf = tevent_req_callback_data(
+		subreq, struct getpwent_prefetch);
+
+	pf->status = wb_query_user_list_recv(subreq, pf, &pf->num_users,
+					     &pf->users, &pf->next_index);
+	TALLOC_FREE(subreq);
+	pf->subreq = NULL;
+	pf->valid = true;
+}
 
 static void wb_next_pwent_send_do(struct tevent_req *req,
 				  struct wb_next_pwent_state *state)
 {
+	struct getpwent_state *gstate = state->gstate;
 	struct tevent_req *subreq;
 
-	if (state->gstate->next_user >= state->gstate->num_users) {
-		TALLOC_FREE(state->gstate->users);
+	while (gstate->next_user >= gstate->num_users) {
+		struct getpwent_prefetch *pf;
 
-		state->gstate->domain = wb_next_domain(state->gstate->domain);
-		if (state->gstate->domain == NULL) {
-			tevent_req_nterror(req, NT_STATUS_NO_MORE_ENTRIES);
-			return;
+		TALLOC_FREE(gstate->users);
+		gstate->num_users = 0;
+		gstate->next_user = 0;
+
+		if ((gstate->domain == NULL) || gstate->got_last_page) {
+			TALLOC_FREE(gstate->prefetch);
+
+			gstate->domain = wb_next_domain(gstate->domain);
+			gstate->resume_index = 0;
+			gstate->got_last_page = false;
+
+			if (gstate->domain == NULL) {
+				tevent_req_nterror(
+					req, NT_STATUS_NO_MORE_ENTRIES);
+				return;
+			}
+		}
+
+		pf = gstate->prefetch;
+
+		if ((pf != NULL) && pf->valid) {
+			/* adopt the prefetched page */
+			wb_next_pwent_install_page(gstate, pf);
+			TALLOC_FREE(gstate->prefetch);
+			wb_next_pwent_prefetch(gstate, state->ev);
+			continue;
 		}
 
-		subreq = wb_query_user_list_send(state, state->ev,
-						 state->gstate->domain);
-		if (tevent_req_nomem(subreq, req)) {
-			return;
+		if (pf != NULL) {
+			/* take over the page fetch still in flight */
+			subreq = talloc_move(state, &pf->subreq);
+			TALLOC_FREE(gstate->prefetch);
+		} else {
+			subreq = wb_query_user_list_send(
+				state, state->ev, gstate->domain,
+				gstate->resume_index,
+				WB_NEXT_PWENT_PAGE_SIZE);
+			if (tevent_req_nomem(subreq, req)) {
+				return;
+			}
 		}
 
-		tevent_req_set_callback(subreq, wb_next_pwent_fetch_done, req);
+		tevent_req_set_callback(subreq, wb_next_pwent_fetch_done,
+					req);
 		return;
 	}
 
@@ -95,21 +207,18 @@ static void wb_next_pwent_fetch_done(struct tevent_req *subreq)
 		subreq, struct tevent_req);
 	struct wb_next_pwent_state *state = tevent_req_data(
 		req, struct wb_next_pwent_state);
-	NTSTATUS status;
+	struct getpwent_prefetch pf;
 
-	status = wb_query_user_list_recv(subreq, state->gstate,
-					 &state->gstate->num_users,
-					 &state->gstate->users);
+	ZERO_STRUCT(pf);
+	pf.status = wb_query_user_list_recv(subreq, state->gstate,
+					    &pf.num_users, &pf.users,
+					    &pf.next_index);
 	TALLOC_FREE(subreq);
-	if (!NT_STATUS_IS_OK(status)) {
-		/* Ignore errors here, just log it */
-		DEBUG(10, ("query_user_list for domain %s returned %s\n",
-			   state->gstate->domain->name,
-			   nt_errstr(status)));
-		state->gstate->num_users = 0;
-	}
 
-	state->gstate->next_user = 0;
+	wb_next_pwent_install_page(state->gstate, &pf);
+
+	/* overlap fetching the next page with draining this one */
+	wb_next_pwent_prefetch(state->gstate, state->ev);
 
 	wb_next_pwent_send_do(req, state);
 }
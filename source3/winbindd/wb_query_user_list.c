@@ -23,13 +23,16 @@
 
 struct wb_query_user_list_state {
 	struct wbint_userinfos users;
+	uint32_t next_index;
 };
 
 static void wb_query_user_list_done(struct tevent_req *subreq);
 
 struct tevent_req *wb_query_user_list_send(TALLOC_CTX *mem_ctx,
 					   struct tevent_context *ev,
-					   struct winbindd_domain *domain)
+					   struct winbindd_domain *domain,
+					   uint32_t resume_index,
+					   uint32_t max_users)
 {
 	struct tevent_req *req, *subreq;
 	struct wb_query_user_list_state *state;
@@ -42,6 +45,8 @@ struct tevent_req *wb_query_user_list_send(TALLOC_CTX *mem_ctx,
 
 	subreq = dcerpc_wbint_QueryUserList_send(state, ev,
 						 dom_child_handle(domain),
+						 resume_index, max_users,
+						 &state->next_index,
 						 &state->users);
 	if (tevent_req_nomem(subreq, req)) {
 		return tevent_req_post(req, ev);
@@ -72,7 +77,8 @@ static void wb_query_user_list_done(struct tevent_req *subreq)
 }
 
 NTSTATUS wb_query_user_list_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
-				 int *num_users, struct wbint_userinfo **users)
+				 int *num_users, struct wbint_userinfo **users,
+				 uint32_t *next_index)
 {
 	struct wb_query_user_list_state *state = tevent_req_data(
 		req, struct wb_query_user_list_state);
@@ -84,5 +90,8 @@ NTSTATUS wb_query_user_list_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
 
 	*num_users = state->users.num_userinfos;
 	*users = talloc_move(mem_ctx, &state->users.userinfos);
+	if (next_index != NULL) {
+		*next_index = state->next_index;
+	}
 	return NT_STATUS_OK;
 }
@@ -189,6 +189,7 @@ static void flush_caches(void)
 			exit(1);
 		}
 	}
+	winbindd_nss_export_flush();
 }
 
 static void flush_caches_noinit(void)
@@ -73,11 +73,16 @@ struct winbindd_cli_state {
 	struct getgrent_state *grent_state; /* State for getgrent() */
 };
 
+struct getpwent_prefetch;
+
 struct getpwent_state {
 	struct winbindd_domain *domain;
 	int next_user;
 	int num_users;
 	struct wbint_userinfo *users;
+	uint32_t resume_index;		 /* cursor for the next page */
+	bool got_last_page;
+	struct getpwent_prefetch *prefetch;
 };
 
 struct getgrent_state {
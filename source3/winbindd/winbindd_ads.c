@@ -31,6 +31,9 @@
 #include "../libcli/security/security.h"
 #include "../libds/common/flag_mapping.h"
 #include "passdb.h"
+#include "../librpc/gen_ndr/krb5pac.h"
+#include "auth.h"
+#include "secrets.h"
 
 #ifdef HAVE_ADS
 
@@ -985,6 +988,136 @@ done:
 }
 
 
+/*
+ * Get the group memberships from the PAC of a Kerberos S4U2Self
+ * ticket for the user, obtained with our machine credentials. The DC
+ * does the complete transitive expansion (including nested and
+ * resource groups) in a single AS + TGS exchange, which is a lot
+ * cheaper than the LDAP/RPC fan-out, in particular over a WAN link.
+ * The info3 from the PAC goes into the netsamlogon cache, so repeat
+ * lookups are served locally.
+ */
+static NTSTATUS lookup_usergroups_pac(struct winbindd_domain *domain,
+				      TALLOC_CTX *mem_ctx,
+				      const struct dom_sid *sid,
+				      uint32_t *p_num_groups,
+				      struct dom_sid **user_sids)
+{
+	ADS_STRUCT *ads;
+	struct PAC_DATA_CTR *pac_data_ctr = NULL;
+	struct PAC_DATA *pac_data = NULL;
+	struct PAC_LOGON_INFO *logon_info = NULL;
+	struct netr_SamInfo3 *info3 = NULL;
+	char *machine_principal = NULL;
+	char *machine_password = NULL;
+	char *user_principal = NULL;
+	char *realm = NULL;
+	char *domain_name = NULL;
+	char *name = NULL;
+	enum lsa_SidType type;
+	time_t time_offset = 0;
+	uint32_t num_groups = 0;
+	int i;
+	NTSTATUS status;
+
+	if (!domain->primary || (domain->alt_name == NULL)) {
+		/* we can only ask our own KDC to impersonate */
+		return NT_STATUS_NOT_SUPPORTED;
+	}
+
+	status = domain->methods->sid_to_name(domain, mem_ctx, sid,
+					      &domain_name, &name, &type);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+	if ((type != SID_NAME_USER) && (type != SID_NAME_COMPUTER)) {
+		return NT_STATUS_NO_SUCH_USER;
+	}
+
+	realm = talloc_strdup_upper(mem_ctx, domain->alt_name);
+	if (realm == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	user_principal = talloc_asprintf(mem_ctx, "%s@%s", name, realm);
+	if (user_principal == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	machine_principal = talloc_asprintf(mem_ctx, "%s$@%s",
+					    lp_netbios_name(), lp_realm());
+	if (machine_principal == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	machine_password = secrets_fetch_machine_password(lp_workgroup(),
+							  NULL, NULL);
+	if (machine_password == NULL) {
+		return NT_STATUS_CANT_ACCESS_DOMAIN_INFO;
+	}
+
+	if (domain->private_data) {
+		ads = (ADS_STRUCT *)domain->private_data;
+		time_offset = ads->auth.time_offset;
+	}
+
+	status = kerberos_return_pac(mem_ctx,
+				     machine_principal,
+				     machine_password,
+				     time_offset,
+				     NULL,
+				     NULL,
+				     NULL,	/* throwaway MEMORY ccache */
+				     true,
+				     true,
+				     0,		/* no renewable tgt needed */
+				     user_principal,
+				     machine_principal,
+				     &pac_data_ctr);
+	SAFE_FREE(machine_password);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(5, ("S4U2Self for %s failed: %s\n", user_principal,
+			  nt_errstr(status)));
+		return status;
+	}
+
+	if (pac_data_ctr != NULL) {
+		pac_data = pac_data_ctr->pac_data;
+	}
+	if (pac_data == NULL) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	for (i=0; i < pac_data->num_buffers; i++) {
+		if (pac_data->buffers[i].type != PAC_TYPE_LOGON_INFO) {
+			continue;
+		}
+		logon_info = pac_data->buffers[i].info->logon_info.info;
+		break;
+	}
+	if (logon_info == NULL) {
+		DEBUG(10, ("Missing logon_info in ticket of %s\n",
+			   user_principal));
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	status = create_info3_from_pac_logon_info(mem_ctx, logon_info,
+						  &info3);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	netsamlogon_cache_store(name, info3);
+
+	status = sid_array_from_info3(mem_ctx, info3, user_sids,
+				      &num_groups, false);
+	TALLOC_FREE(info3);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	*p_num_groups = num_groups;
+	return NT_STATUS_OK;
+}
+
 /* Lookup groups a user is a member of. */
 static NTSTATUS lookup_usergroups(struct winbindd_domain *domain,
 				  TALLOC_CTX *mem_ctx,
@@ -1022,6 +1155,16 @@ static NTSTATUS lookup_usergroups(struct winbindd_domain *domain,
 		return NT_STATUS_SYNCHRONIZATION_REQUIRED;
 	}
 
+	status = lookup_usergroups_pac(domain, mem_ctx, sid,
+				       p_num_groups, user_sids);
+	if (NT_STATUS_IS_OK(status)) {
+		DEBUG(3,("ads lookup_usergroups (pac) succeeded for sid=%s\n",
+			 sid_string_dbg(sid)));
+		return NT_STATUS_OK;
+	}
+
+	/* fall back to the LDAP fan-out */
+
 	ads = ads_cached_connection(domain);
 
 	if (!ads) {
@@ -103,6 +103,9 @@ struct cache_entry {
 	uint64_t timeout;
 	uint8_t *data;
 	uint32_t len, ofs;
+	/* the entry is expired but served within the stale window; the
+	   caller is expected to schedule a background refresh */
+	bool stale;
 };
 
 void (*smb_panic_fn)(const char *const why) = smb_panic;
@@ -653,6 +656,7 @@ static struct cache_entry *wcache_fetch_raw(char *kstr)
 	centry->data = (unsigned char *)data.dptr;
 	centry->len = data.dsize;
 	centry->ofs = 0;
+	centry->stale = false;
 
 	if (centry->len < 16) {
 		/* huh? corrupt cache? */
@@ -689,18 +693,484 @@ static bool is_builtin_domain(struct winbindd_domain *domain)
 	return false;
 }
 
+/*
+ * Stale-while-revalidate support. With a nonzero "winbind cache stale
+ * time" the name/SID/userinfo lookups keep answering from an expired
+ * cache entry for that many extra seconds, and the entry is refreshed
+ * from the DC in the background instead of making the client wait for
+ * the round trip. Refreshes run off a timer in the domain child, one
+ * at a time, by re-driving the normal cache-miss path.
+ */
+
+struct wcache_stale_refresh {
+	struct wcache_stale_refresh *prev, *next;
+	struct winbindd_domain *domain;
+	enum wcache_stale_refresh_op {
+		WCACHE_REFRESH_NAME_TO_SID,
+		WCACHE_REFRESH_SID_TO_NAME,
+		WCACHE_REFRESH_QUERY_USER
+	} op;
+	struct dom_sid sid;
+	char *domain_name;
+	char *name;
+};
+
+#define WCACHE_STALE_REFRESH_MAX 100
+
+static struct wcache_stale_refresh *wcache_stale_refreshes;
+static struct tevent_timer *wcache_stale_refresh_te;
+
+/* true while a queued refresh is being re-driven through the cache
+   methods, to keep it from being served the stale entry again */
+static bool wcache_stale_refresh_active;
+
+/* forward declarations of the cache methods re-driven by the
+   background refresh */
+static NTSTATUS name_to_sid(struct winbindd_domain *domain,
+			    TALLOC_CTX *mem_ctx,
+			    const char *domain_name,
+			    const char *name,
+			    uint32_t flags,
+			    struct dom_sid *sid,
+			    enum lsa_SidType *type);
+static NTSTATUS sid_to_name(struct winbindd_domain *domain,
+			    TALLOC_CTX *mem_ctx,
+			    const struct dom_sid *sid,
+			    char **domain_name,
+			    char **name,
+			    enum lsa_SidType *type);
+static NTSTATUS query_user(struct winbindd_domain *domain,
+			   TALLOC_CTX *mem_ctx,
+			   const struct dom_sid *user_sid,
+			   struct wbint_userinfo *info);
+
+static void wcache_stale_refresh_handler(struct tevent_context *ev,
+					 struct tevent_timer *te,
+					 struct timeval now,
+					 void *private_data)
+{
+	struct wcache_stale_refresh *item = wcache_stale_refreshes;
+	TALLOC_CTX *tmp_ctx;
+
+	wcache_stale_refresh_te = NULL;
+
+	if (item == NULL) {
+		return;
+	}
+	DLIST_REMOVE(wcache_stale_refreshes, item);
+
+	tmp_ctx = talloc_stackframe();
+	wcache_stale_refresh_active = true;
+
+	switch (item->op) {
+	case WCACHE_REFRESH_NAME_TO_SID: {
+		struct dom_sid sid;
+		enum lsa_SidType type;
+		name_to_sid(item->domain, tmp_ctx, item->domain_name,
+			    item->name, 0, &sid, &type);
+		break;
+	}
+	case WCACHE_REFRESH_SID_TO_NAME: {
+		char *domain_name = NULL;
+		char *name = NULL;
+		enum lsa_SidType type;
+		sid_to_name(item->domain, tmp_ctx, &item->sid,
+			    &domain_name, &name, &type);
+		break;
+	}
+	case WCACHE_REFRESH_QUERY_USER: {
+		struct wbint_userinfo info;
+		query_user(item->domain, tmp_ctx, &item->sid, &info);
+		break;
+	}
+	}
+
+	wcache_stale_refresh_active = false;
+	TALLOC_FREE(tmp_ctx);
+	TALLOC_FREE(item);
+
+	if (wcache_stale_refreshes != NULL) {
+		/* space the refreshes out a bit, so that the child
+		   stays responsive for new client requests */
+		wcache_stale_refresh_te = tevent_add_timer(
+			winbind_event_context(), NULL,
+			timeval_current_ofs(0, 500000),
+			wcache_stale_refresh_handler, NULL);
+	}
+}
+
+/*
+  remember that a cache entry was served stale and needs a background
+  refresh. Only domain children can refresh; in the parent the entry
+  simply stays stale until the window ends
+*/
+static void wcache_stale_refresh_queue(struct winbindd_domain *domain,
+				       enum wcache_stale_refresh_op op,
+				       const struct dom_sid *sid,
+				       const char *domain_name,
+				       const char *name)
+{
+	struct wcache_stale_refresh *item;
+	size_t num_queued = 0;
+
+	if (wb_child_domain() == NULL) {
+		return;
+	}
+
+	for (item = wcache_stale_refreshes; item != NULL; item = item->next) {
+		if ((item->op == op) && (item->domain == domain)) {
+			if (sid != NULL) {
+				if (dom_sid_equal(&item->sid, sid)) {
+					return;
+				}
+			} else if (strequal(item->domain_name, domain_name) &&
+				   strequal(item->name, name)) {
+				return;
+			}
+		}
+		num_queued += 1;
+	}
+	if (num_queued >= WCACHE_STALE_REFRESH_MAX) {
+		return;
+	}
+
+	item = talloc_zero(NULL, struct wcache_stale_refresh);
+	if (item == NULL) {
+		return;
+	}
+	item->domain = domain;
+	item->op = op;
+	if (sid != NULL) {
+		sid_copy(&item->sid, sid);
+	}
+	if (domain_name != NULL) {
+		item->domain_name = talloc_strdup(item, domain_name);
+		if (item->domain_name == NULL) {
+			TALLOC_FREE(item);
+			return;
+		}
+	}
+	if (name != NULL) {
+		item->name = talloc_strdup(item, name);
+		if (item->name == NULL) {
+			TALLOC_FREE(item);
+			return;
+		}
+	}
+
+	DLIST_ADD_END(wcache_stale_refreshes, item,
+		      struct wcache_stale_refresh *);
+
+	if (wcache_stale_refresh_te == NULL) {
+		/* a short delay lets the burst of stale hits that
+		   typically comes with cache expiry dedup into the
+		   queue first */
+		wcache_stale_refresh_te = tevent_add_timer(
+			winbind_event_context(), NULL,
+			timeval_current_ofs(1, 0),
+			wcache_stale_refresh_handler, NULL);
+	}
+}
+
+/*
+ * Cache prewarming: each domain child keeps an LRU list of the keys it
+ * has recently served from the cache and periodically saves it to a
+ * flat file in the cache directory. When the child starts up again --
+ * in particular right after a failover takeover, when everything is
+ * cold at once -- the saved keys are fed through the stale-refresh
+ * queue above, which refills them one at a time in the background
+ * instead of letting the first wave of clients stampede the DC.
+ *
+ * Only the keys are saved; the entry bodies already live in
+ * winbindd_cache.tdb.
+ */
+
+struct wcache_prewarm_key {
+	struct wcache_prewarm_key *prev, *next;
+	enum wcache_stale_refresh_op op;
+	struct dom_sid sid;
+	char *domain_name;
+	char *name;
+};
+
+#define WCACHE_PREWARM_MAX_KEYS 500
+#define WCACHE_PREWARM_WRITE_SECS 60
+
+static struct wcache_prewarm_key *wcache_prewarm_keys;
+static size_t wcache_prewarm_num_keys;
+static struct tevent_timer *wcache_prewarm_te;
+
+static char *wcache_prewarm_path(TALLOC_CTX *mem_ctx,
+				 const struct winbindd_domain *domain)
+{
+	char *fname, *path;
+
+	fname = talloc_asprintf(mem_ctx, "winbindd_prewarm_%s",
+				domain->name);
+	if (fname == NULL) {
+		return NULL;
+	}
+	path = cache_path(fname);
+	TALLOC_FREE(fname);
+	return path;
+}
+
+static void wcache_prewarm_write(void)
+{
+	struct winbindd_domain *domain = wb_child_domain();
+	struct wcache_prewarm_key *key;
+	char *path = NULL;
+	char *tmppath = NULL;
+	FILE *f = NULL;
+	TALLOC_CTX *frame = talloc_stackframe();
+
+	if (domain == NULL) {
+		goto done;
+	}
+
+	path = wcache_prewarm_path(frame, domain);
+	if (path == NULL) {
+		goto done;
+	}
+	tmppath = talloc_asprintf(frame, "%s.new", path);
+	if (tmppath == NULL) {
+		goto done;
+	}
+
+	f = fopen(tmppath, "w");
+	if (f == NULL) {
+		DEBUG(5, ("Could not create %s: %s\n", tmppath,
+			  strerror(errno)));
+		goto done;
+	}
+
+	for (key = wcache_prewarm_keys; key != NULL; key = key->next) {
+		fstring sidstr;
+
+		switch (key->op) {
+		case WCACHE_REFRESH_NAME_TO_SID:
+			fprintf(f, "NS\t%s\t%s\n", key->domain_name,
+				key->name);
+			break;
+		case WCACHE_REFRESH_SID_TO_NAME:
+			sid_to_fstring(sidstr, &key->sid);
+			fprintf(f, "SN\t%s\n", sidstr);
+			break;
+		case WCACHE_REFRESH_QUERY_USER:
+			sid_to_fstring(sidstr, &key->sid);
+			fprintf(f, "U\t%s\n", sidstr);
+			break;
+		}
+	}
+
+	if (fclose(f) != 0) {
+		f = NULL;
+		unlink(tmppath);
+		goto done;
+	}
+	f = NULL;
+
+	if (rename(tmppath, path) != 0) {
+		DEBUG(5, ("Could not rename %s to %s: %s\n", tmppath, path,
+			  strerror(errno)));
+		unlink(tmppath);
+		goto done;
+	}
+
+	DEBUG(10, ("Saved %u prewarm keys to %s\n",
+		   (unsigned)wcache_prewarm_num_keys, path));
+
+done:
+	if (f != NULL) {
+		fclose(f);
+		unlink(tmppath);
+	}
+	TALLOC_FREE(frame);
+}
+
+static void wcache_prewarm_write_handler(struct tevent_context *ev,
+					 struct tevent_timer *te,
+					 struct timeval now,
+					 void *private_data)
+{
+	wcache_prewarm_te = NULL;
+	wcache_prewarm_write();
+}
+
+/*
+  remember that a key was served from the cache, so that it can be
+  prewarmed after the next restart. Keys are kept in LRU order; the
+  coldest ones fall off the end
+*/
+static void wcache_prewarm_record(struct winbindd_domain *domain,
+				  enum wcache_stale_refresh_op op,
+				  const struct dom_sid *sid,
+				  const char *domain_name,
+				  const char *name)
+{
+	struct wcache_prewarm_key *key;
+
+	if (wb_child_domain() != domain) {
+		return;
+	}
+
+	for (key = wcache_prewarm_keys; key != NULL; key = key->next) {
+		if (key->op != op) {
+			continue;
+		}
+		if (sid != NULL) {
+			if (dom_sid_equal(&key->sid, sid)) {
+				break;
+			}
+		} else if (strequal(key->domain_name, domain_name) &&
+			   strequal(key->name, name)) {
+			break;
+		}
+	}
+
+	if (key != NULL) {
+		DLIST_PROMOTE(wcache_prewarm_keys, key);
+		return;
+	}
+
+	key = talloc_zero(NULL, struct wcache_prewarm_key);
+	if (key == NULL) {
+		return;
+	}
+	key->op = op;
+	if (sid != NULL) {
+		sid_copy(&key->sid, sid);
+	}
+	if (domain_name != NULL) {
+		key->domain_name = talloc_strdup(key, domain_name);
+		if (key->domain_name == NULL) {
+			TALLOC_FREE(key);
+			return;
+		}
+	}
+	if (name != NULL) {
+		key->name = talloc_strdup(key, name);
+		if (key->name == NULL) {
+			TALLOC_FREE(key);
+			return;
+		}
+	}
+
+	DLIST_ADD(wcache_prewarm_keys, key);
+	wcache_prewarm_num_keys += 1;
+
+	while (wcache_prewarm_num_keys > WCACHE_PREWARM_MAX_KEYS) {
+		struct wcache_prewarm_key *last =
+			DLIST_TAIL(wcache_prewarm_keys);
+
+		DLIST_REMOVE(wcache_prewarm_keys, last);
+		wcache_prewarm_num_keys -= 1;
+		TALLOC_FREE(last);
+	}
+
+	if (wcache_prewarm_te == NULL) {
+		wcache_prewarm_te = tevent_add_timer(
+			winbind_event_context(), NULL,
+			timeval_current_ofs(WCACHE_PREWARM_WRITE_SECS, 0),
+			wcache_prewarm_write_handler, NULL);
+	}
+}
+
+/*
+  load the working set saved by the previous incarnation of this domain
+  child and feed it through the stale-refresh queue. Called once at
+  child startup
+*/
+void wcache_prewarm_load(struct winbindd_domain *domain)
+{
+	char line[1024];
+	char *path;
+	FILE *f;
+	size_t num_loaded = 0;
+	TALLOC_CTX *frame = talloc_stackframe();
+
+	if (wb_child_domain() != domain) {
+		TALLOC_FREE(frame);
+		return;
+	}
+
+	path = wcache_prewarm_path(frame, domain);
+	if (path == NULL) {
+		TALLOC_FREE(frame);
+		return;
+	}
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		TALLOC_FREE(frame);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		struct dom_sid sid;
+		char *p;
+
+		p = strchr(line, '\n');
+		if (p != NULL) {
+			*p = '\0';
+		}
+
+		if (strncmp(line, "NS\t", 3) == 0) {
+			char *domain_name = line + 3;
+			char *name = strchr(domain_name, '\t');
+
+			if (name == NULL) {
+				continue;
+			}
+			*name++ = '\0';
+			wcache_prewarm_record(
+				domain, WCACHE_REFRESH_NAME_TO_SID,
+				NULL, domain_name, name);
+			wcache_stale_refresh_queue(
+				domain, WCACHE_REFRESH_NAME_TO_SID,
+				NULL, domain_name, name);
+		} else if (strncmp(line, "SN\t", 3) == 0) {
+			if (!string_to_sid(&sid, line + 3)) {
+				continue;
+			}
+			wcache_prewarm_record(
+				domain, WCACHE_REFRESH_SID_TO_NAME,
+				&sid, NULL, NULL);
+			wcache_stale_refresh_queue(
+				domain, WCACHE_REFRESH_SID_TO_NAME,
+				&sid, NULL, NULL);
+		} else if (strncmp(line, "U\t", 2) == 0) {
+			if (!string_to_sid(&sid, line + 2)) {
+				continue;
+			}
+			wcache_prewarm_record(
+				domain, WCACHE_REFRESH_QUERY_USER,
+				&sid, NULL, NULL);
+			wcache_stale_refresh_queue(
+				domain, WCACHE_REFRESH_QUERY_USER,
+				&sid, NULL, NULL);
+		}
+
+		num_loaded += 1;
+	}
+
+	fclose(f);
+	TALLOC_FREE(frame);
+
+	DEBUG(5, ("Prewarming %u cache entries for domain %s\n",
+		  (unsigned)num_loaded, domain->name));
+}
+
 /*
   fetch an entry from the cache, with a varargs key. auto-fetch the sequence
   number and return status
 */
-static struct cache_entry *wcache_fetch(struct winbind_cache *cache, 
-					struct winbindd_domain *domain,
-					const char *format, ...) PRINTF_ATTRIBUTE(3,4);
-static struct cache_entry *wcache_fetch(struct winbind_cache *cache, 
-					struct winbindd_domain *domain,
-					const char *format, ...)
+static struct cache_entry *wcache_fetch_internal(struct winbind_cache *cache,
+						 struct winbindd_domain *domain,
+						 bool allow_stale,
+						 const char *format,
+						 va_list ap)
 {
-	va_list ap;
 	char *kstr;
 	struct cache_entry *centry;
 
@@ -712,9 +1182,7 @@ static struct cache_entry *wcache_fetch(struct winbind_cache *cache,
 
 	refresh_sequence_number(domain, false);
 
-	va_start(ap, format);
 	smb_xvasprintf(&kstr, format, ap);
-	va_end(ap);
 
 	centry = wcache_fetch_raw(kstr);
 	if (centry == NULL) {
@@ -724,6 +1192,29 @@ static struct cache_entry *wcache_fetch(struct winbind_cache *cache,
 
 	if (centry_expired(domain, kstr, centry)) {
 
+		/*
+		 * Within the stale window hand out the expired entry
+		 * anyway and let the caller schedule a refresh. Only
+		 * positive entries qualify, and only while the domain
+		 * is online - offline handling has its own rules in
+		 * centry_expired().
+		 */
+		if (allow_stale &&
+		    !wcache_stale_refresh_active &&
+		    (lp_winbind_cache_stale_time() > 0) &&
+		    domain->online &&
+		    NT_STATUS_IS_OK(centry->status) &&
+		    (time(NULL) < centry->timeout +
+		     lp_winbind_cache_stale_time())) {
+
+			DEBUG(10,("wcache_fetch: serving stale entry %s for "
+				  "domain %s\n", kstr, domain->name ));
+
+			centry->stale = true;
+			free(kstr);
+			return centry;
+		}
+
 		DEBUG(10,("wcache_fetch: entry %s expired for domain %s\n",
 			 kstr, domain->name ));
 
@@ -739,6 +1230,44 @@ static struct cache_entry *wcache_fetch(struct winbind_cache *cache,
 	return centry;
 }
 
+static struct cache_entry *wcache_fetch(struct winbind_cache *cache,
+					struct winbindd_domain *domain,
+					const char *format, ...) PRINTF_ATTRIBUTE(3,4);
+static struct cache_entry *wcache_fetch(struct winbind_cache *cache,
+					struct winbindd_domain *domain,
+					const char *format, ...)
+{
+	va_list ap;
+	struct cache_entry *centry;
+
+	va_start(ap, format);
+	centry = wcache_fetch_internal(cache, domain, false, format, ap);
+	va_end(ap);
+
+	return centry;
+}
+
+/*
+  as wcache_fetch(), but expired entries may be returned within the
+  stale window, marked with centry->stale
+*/
+static struct cache_entry *wcache_fetch_stale(struct winbind_cache *cache,
+					      struct winbindd_domain *domain,
+					      const char *format, ...) PRINTF_ATTRIBUTE(3,4);
+static struct cache_entry *wcache_fetch_stale(struct winbind_cache *cache,
+					      struct winbindd_domain *domain,
+					      const char *format, ...)
+{
+	va_list ap;
+	struct cache_entry *centry;
+
+	va_start(ap, format);
+	centry = wcache_fetch_internal(cache, domain, true, format, ap);
+	va_end(ap);
+
+	return centry;
+}
+
 static void wcache_delete(const char *format, ...) PRINTF_ATTRIBUTE(1,2);
 static void wcache_delete(const char *format, ...)
 {
@@ -1819,12 +2348,21 @@ NTSTATUS wcache_name_to_sid(struct winbindd_domain *domain,
 		domain_name = domain->name;
 	}
 
-	centry = wcache_fetch(cache, domain, "NS/%s/%s", domain_name, uname);
+	centry = wcache_fetch_stale(cache, domain, "NS/%s/%s", domain_name,
+				    uname);
 	TALLOC_FREE(uname);
 	if (centry == NULL) {
 		return NT_STATUS_NOT_FOUND;
 	}
 
+	wcache_prewarm_record(domain, WCACHE_REFRESH_NAME_TO_SID,
+			      NULL, domain_name, name);
+
+	if (centry->stale) {
+		wcache_stale_refresh_queue(domain, WCACHE_REFRESH_NAME_TO_SID,
+					   NULL, domain_name, name);
+	}
+
 	status = centry->status;
 	if (NT_STATUS_IS_OK(status)) {
 		*type = (enum lsa_SidType)centry_uint32(centry);
@@ -1930,12 +2468,20 @@ static NTSTATUS wcache_sid_to_name(struct winbindd_domain *domain,
 		return NT_STATUS_NO_MEMORY;
 	}
 
-	centry = wcache_fetch(cache, domain, "SN/%s", sid_string);
+	centry = wcache_fetch_stale(cache, domain, "SN/%s", sid_string);
 	TALLOC_FREE(sid_string);
 	if (centry == NULL) {
 		return NT_STATUS_NOT_FOUND;
 	}
 
+	wcache_prewarm_record(domain, WCACHE_REFRESH_SID_TO_NAME,
+			      sid, NULL, NULL);
+
+	if (centry->stale) {
+		wcache_stale_refresh_queue(domain, WCACHE_REFRESH_SID_TO_NAME,
+					   sid, NULL, NULL);
+	}
+
 	if (NT_STATUS_IS_OK(centry->status)) {
 		*type = (enum lsa_SidType)centry_uint32(centry);
 		*domain_name = centry_string(centry, mem_ctx);
@@ -2274,12 +2820,20 @@ NTSTATUS wcache_query_user(struct winbindd_domain *domain,
 		return NT_STATUS_NO_MEMORY;
 	}
 
-	centry = wcache_fetch(cache, domain, "U/%s", sid_string);
+	centry = wcache_fetch_stale(cache, domain, "U/%s", sid_string);
 	TALLOC_FREE(sid_string);
 	if (centry == NULL) {
 		return NT_STATUS_NOT_FOUND;
 	}
 
+	wcache_prewarm_record(domain, WCACHE_REFRESH_QUERY_USER,
+			      user_sid, NULL, NULL);
+
+	if (centry->stale) {
+		wcache_stale_refresh_queue(domain, WCACHE_REFRESH_QUERY_USER,
+					   user_sid, NULL, NULL);
+	}
+
 	/*
 	 * If we have an access denied cache entry and a cached info3
 	 * in the samlogon cache then do a query.  This will force the
@@ -248,33 +248,29 @@ static void wb_child_request_cleanup(struct tevent_req *req,
 	DLIST_REMOVE(winbindd_children, state->child);
 }
 
-static bool winbindd_child_busy(struct winbindd_child *child)
-{
-	return tevent_queue_length(child->queue) > 0;
-}
-
-static struct winbindd_child *find_idle_child(struct winbindd_domain *domain)
+/*
+ * Pick the child with the shortest request queue. An idle child wins
+ * by definition, and when all children are busy this spreads the
+ * waiting requests evenly instead of randomly piling them up behind
+ * one slow request.
+ */
+struct winbindd_child *choose_domain_child(struct winbindd_domain *domain)
 {
+	struct winbindd_child *result = &domain->children[0];
+	size_t min_len = tevent_queue_length(result->queue);
 	int i;
 
-	for (i=0; i<lp_winbind_max_domain_connections(); i++) {
-		if (!winbindd_child_busy(&domain->children[i])) {
-			return &domain->children[i];
+	for (i=1; i<lp_winbind_max_domain_connections(); i++) {
+		struct winbindd_child *child = &domain->children[i];
+		size_t len = tevent_queue_length(child->queue);
+
+		if (len < min_len) {
+			result = child;
+			min_len = len;
 		}
 	}
 
-	return NULL;
-}
-
-struct winbindd_child *choose_domain_child(struct winbindd_domain *domain)
-{
-	struct winbindd_child *result;
-
-	result = find_idle_child(domain);
-	if (result != NULL) {
-		return result;
-	}
-	return &domain->children[rand() % lp_winbind_max_domain_connections()];
+	return result;
 }
 
 struct dcerpc_binding_handle *dom_child_handle(struct winbindd_domain *domain)
@@ -1578,6 +1574,12 @@ static bool fork_domain_child(struct winbindd_child *child)
 		}
 	}
 
+	if (child->domain && !child->domain->internal) {
+		/* refill the cache entries the previous incarnation of
+		   this child was serving, before the clients ask */
+		wcache_prewarm_load(child->domain);
+	}
+
 	fde = tevent_add_fd(winbind_event_context(), NULL, state.cli.sock,
 			    TEVENT_FD_READ, child_handler, &state);
 	if (fde == NULL) {
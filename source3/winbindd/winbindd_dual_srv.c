@@ -360,21 +360,90 @@ NTSTATUS _wbint_LookupGroupMembers(struct pipes_struct *p,
 	return NT_STATUS_OK;
 }
 
+/*
+ * For paged enumeration the backend user list is fetched once when a
+ * cursor starts and kept as a snapshot, so the domain is not
+ * re-enumerated for every page. Only one page at a time is pushed
+ * through ndr to the parent. The snapshot is dropped as soon as the
+ * last page has been handed out.
+ */
+struct wbint_query_user_list_snapshot {
+	uint32_t num_userinfos;
+	struct wbint_userinfo *userinfos;
+};
+
+static struct wbint_query_user_list_snapshot *query_user_list_snapshot;
+
 NTSTATUS _wbint_QueryUserList(struct pipes_struct *p,
 			      struct wbint_QueryUserList *r)
 {
 	struct winbindd_domain *domain = wb_child_domain();
+	struct wbint_query_user_list_snapshot *snap;
+	uint32_t resume = r->in.resume_index;
+	uint32_t num, i;
 	NTSTATUS status;
 
 	if (domain == NULL) {
 		return NT_STATUS_REQUEST_NOT_ACCEPTED;
 	}
 
-	status = domain->methods->query_user_list(
-		domain, p->mem_ctx, &r->out.users->num_userinfos,
-		&r->out.users->userinfos);
-	reset_cm_connection_on_error(domain, status);
-	return status;
+	if (r->in.max_users == 0) {
+		/* the caller wants the complete list in one go */
+		status = domain->methods->query_user_list(
+			domain, p->mem_ctx, &r->out.users->num_userinfos,
+			&r->out.users->userinfos);
+		reset_cm_connection_on_error(domain, status);
+		*r->out.next_index = r->out.users->num_userinfos;
+		return status;
+	}
+
+	if ((resume == 0) || (query_user_list_snapshot == NULL)) {
+		snap = talloc_zero(NULL,
+				   struct wbint_query_user_list_snapshot);
+		if (snap == NULL) {
+			return NT_STATUS_NO_MEMORY;
+		}
+
+		status = domain->methods->query_user_list(
+			domain, snap, &snap->num_userinfos,
+			&snap->userinfos);
+		if (!NT_STATUS_IS_OK(status)) {
+			reset_cm_connection_on_error(domain, status);
+			talloc_free(snap);
+			return status;
+		}
+
+		TALLOC_FREE(query_user_list_snapshot);
+		query_user_list_snapshot = snap;
+	}
+
+	snap = query_user_list_snapshot;
+
+	num = 0;
+	if (resume < snap->num_userinfos) {
+		num = MIN(r->in.max_users, snap->num_userinfos - resume);
+	}
+
+	r->out.users->num_userinfos = num;
+	r->out.users->userinfos = talloc_array(p->mem_ctx,
+					       struct wbint_userinfo, num);
+	if ((num != 0) && (r->out.users->userinfos == NULL)) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	for (i = 0; i < num; i++) {
+		/* the string pointers stay owned by the snapshot */
+		r->out.users->userinfos[i] = snap->userinfos[resume + i];
+	}
+
+	*r->out.next_index = resume + num;
+
+	if (resume + num >= snap->num_userinfos) {
+		/* cursor exhausted, drop the snapshot */
+		TALLOC_FREE(query_user_list_snapshot);
+	}
+
+	return NT_STATUS_OK;
 }
 
 NTSTATUS _wbint_QueryGroupList(struct pipes_struct *p,
@@ -138,5 +138,6 @@ NTSTATUS winbindd_getpwnam_recv(struct tevent_req *req,
 		return status;
 	}
 	response->data.pw = state->pw;
+	winbindd_nss_export_pwent(&state->pw);
 	return NT_STATUS_OK;
 }
@@ -103,5 +103,6 @@ NTSTATUS winbindd_getpwuid_recv(struct tevent_req *req,
 		return status;
 	}
 	response->data.pw = state->pw;
+	winbindd_nss_export_pwent(&state->pw);
 	return NT_STATUS_OK;
 }
@@ -25,6 +25,7 @@ struct winbindd_list_users_domstate {
 	struct tevent_req *subreq;
 	struct winbindd_domain *domain;
 	struct wbint_userinfos users;
+	uint32_t next_index;
 };
 
 struct winbindd_list_users_state {
@@ -92,7 +93,8 @@ struct tevent_req *winbindd_list_users_send(TALLOC_CTX *mem_ctx,
 
 		d->subreq = dcerpc_wbint_QueryUserList_send(
 			state->domains, ev, dom_child_handle(d->domain),
-			&d->users);
+			0, 0, /* complete list, no paging */
+			&d->next_index, &d->users);
 		if (tevent_req_nomem(d->subreq, req)) {
 			TALLOC_FREE(state->domains);
 			return tevent_req_post(req, ev);
@@ -0,0 +1,229 @@
+/*
+   Unix SMB/CIFS implementation.
+
+   Shared-memory export of hot winbindd passwd entries
+
+   Copyright (C) Volker Lendecke 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Every getpwnam/getpwuid answer the parent hands out is also
+ * recorded here. The hottest entries are periodically dumped into a
+ * world-readable flat file in the socket directory which the
+ * nss_winbind clients mmap and consult before doing a socket
+ * round-trip (see nsswitch/winbind_nss_export.h for the format).
+ *
+ * The file is written to a temporary name and rename()d into place,
+ * so clients always see a complete, immutable map. Its header carries
+ * a timeout; as long as winbindd keeps serving lookups the map keeps
+ * being refreshed, and once winbindd stops doing so clients fall back
+ * to the socket. A cache flush (e.g. SIGHUP) truncates the map
+ * immediately.
+ */
+
+#include "includes.h"
+#include "winbindd.h"
+#include "nsswitch/winbind_nss_export.h"
+#include "lib/sys_rw_data.h"
+
+#define WINBIND_NSS_EXPORT_MAX_USERS 2048
+#define WINBIND_NSS_EXPORT_FLUSH_SECS 2
+
+struct nss_export_user {
+	struct nss_export_user *prev, *next;
+	struct winbindd_pw pw;
+};
+
+static struct nss_export_user *nss_export_users;
+static uint32_t nss_export_num_users;
+static struct tevent_timer *nss_export_timer;
+
+static int winbindd_nss_export_cmp(const void *p1, const void *p2)
+{
+	const struct winbindd_pw *pw1 = (const struct winbindd_pw *)p1;
+	const struct winbindd_pw *pw2 = (const struct winbindd_pw *)p2;
+
+	if (pw1->pw_uid < pw2->pw_uid) {
+		return -1;
+	}
+	if (pw1->pw_uid > pw2->pw_uid) {
+		return 1;
+	}
+	return 0;
+}
+
+static void winbindd_nss_export_write(void)
+{
+	struct winbind_nss_export_hdr hdr;
+	struct winbindd_pw *users = NULL;
+	struct nss_export_user *u;
+	char *path = NULL;
+	char *tmppath = NULL;
+	uint32_t i;
+	ssize_t written;
+	int fd = -1;
+	TALLOC_CTX *frame = talloc_stackframe();
+
+	path = talloc_asprintf(frame, "%s/%s",
+			       lp_winbindd_socket_directory(),
+			       WINBIND_NSS_EXPORT_FILE);
+	if (path == NULL) {
+		goto done;
+	}
+	tmppath = talloc_asprintf(frame, "%s.new", path);
+	if (tmppath == NULL) {
+		goto done;
+	}
+
+	users = talloc_array(frame, struct winbindd_pw,
+			     nss_export_num_users);
+	if ((nss_export_num_users != 0) && (users == NULL)) {
+		goto done;
+	}
+
+	i = 0;
+	for (u = nss_export_users; u != NULL; u = u->next) {
+		users[i++] = u->pw;
+	}
+
+	qsort(users, nss_export_num_users, sizeof(struct winbindd_pw),
+	      winbindd_nss_export_cmp);
+
+	ZERO_STRUCT(hdr);
+	hdr.magic = WINBIND_NSS_EXPORT_MAGIC;
+	hdr.version = WINBIND_NSS_EXPORT_VERSION;
+	hdr.num_users = nss_export_num_users;
+	hdr.timeout = time(NULL) + lp_winbind_cache_time();
+
+	fd = open(tmppath, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (fd == -1) {
+		DEBUG(5, ("Could not create %s: %s\n", tmppath,
+			  strerror(errno)));
+		goto done;
+	}
+	/* the whole point is that everybody can read it */
+	if (fchmod(fd, 0644) != 0) {
+		goto done;
+	}
+
+	written = write_data(fd, (const char *)&hdr, sizeof(hdr));
+	if (written != sizeof(hdr)) {
+		goto done;
+	}
+	written = write_data(
+		fd, (const char *)users,
+		nss_export_num_users * sizeof(struct winbindd_pw));
+	if (written != (ssize_t)(nss_export_num_users *
+				 sizeof(struct winbindd_pw))) {
+		goto done;
+	}
+
+	close(fd);
+	fd = -1;
+
+	if (rename(tmppath, path) != 0) {
+		DEBUG(5, ("Could not rename %s to %s: %s\n", tmppath, path,
+			  strerror(errno)));
+		goto done;
+	}
+
+	DEBUG(10, ("Wrote %u passwd entries to %s\n",
+		   (unsigned)nss_export_num_users, path));
+
+done:
+	if (fd != -1) {
+		close(fd);
+		unlink(tmppath);
+	}
+	TALLOC_FREE(frame);
+}
+
+static void winbindd_nss_export_timer_handler(struct tevent_context *ev,
+					      struct tevent_timer *te,
+					      struct timeval now,
+					      void *private_data)
+{
+	TALLOC_FREE(nss_export_timer);
+	winbindd_nss_export_write();
+}
+
+static void winbindd_nss_export_schedule(struct tevent_context *ev)
+{
+	if (nss_export_timer != NULL) {
+		return;
+	}
+	nss_export_timer = tevent_add_timer(
+		ev, NULL,
+		timeval_current_ofs(WINBIND_NSS_EXPORT_FLUSH_SECS, 0),
+		winbindd_nss_export_timer_handler, NULL);
+}
+
+void winbindd_nss_export_pwent(const struct winbindd_pw *pw)
+{
+	struct nss_export_user *u;
+
+	if (lp_winbind_cache_time() == 0) {
+		return;
+	}
+
+	for (u = nss_export_users; u != NULL; u = u->next) {
+		if (u->pw.pw_uid == pw->pw_uid) {
+			break;
+		}
+	}
+
+	if (u == NULL) {
+		u = talloc_zero(NULL, struct nss_export_user);
+		if (u == NULL) {
+			return;
+		}
+		nss_export_num_users += 1;
+	} else {
+		DLIST_REMOVE(nss_export_users, u);
+	}
+
+	u->pw = *pw;
+	DLIST_ADD(nss_export_users, u);
+
+	while (nss_export_num_users > WINBIND_NSS_EXPORT_MAX_USERS) {
+		struct nss_export_user *last = DLIST_TAIL(nss_export_users);
+
+		DLIST_REMOVE(nss_export_users, last);
+		nss_export_num_users -= 1;
+		TALLOC_FREE(last);
+	}
+
+	winbindd_nss_export_schedule(winbind_event_context());
+}
+
+/*
+ * Throw away everything we have handed out, e.g. on SIGHUP. The empty
+ * map is written out right away so that clients stop using their
+ * copies.
+ */
+void winbindd_nss_export_flush(void)
+{
+	while (nss_export_users != NULL) {
+		struct nss_export_user *u = nss_export_users;
+
+		DLIST_REMOVE(nss_export_users, u);
+		TALLOC_FREE(u);
+	}
+	nss_export_num_users = 0;
+
+	TALLOC_FREE(nss_export_timer);
+	winbindd_nss_export_write();
+}
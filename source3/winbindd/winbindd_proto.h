@@ -70,6 +70,7 @@ void wcache_invalidate_samlogon(struct winbindd_domain *domain,
 				const struct dom_sid *user_sid);
 bool wcache_invalidate_cache(void);
 bool wcache_invalidate_cache_noinit(void);
+void wcache_prewarm_load(struct winbindd_domain *domain);
 bool init_wcache(void);
 bool initialize_winbindd_cache(void);
 void close_winbindd_cache(void);
@@ -607,6 +608,12 @@ struct tevent_req *winbindd_getpwuid_send(TALLOC_CTX *mem_ctx,
 					  struct winbindd_request *request);
 NTSTATUS winbindd_getpwuid_recv(struct tevent_req *req,
 				struct winbindd_response *response);
+
+/* The following definitions come from winbindd/winbindd_nss_export.c */
+
+void winbindd_nss_export_pwent(const struct winbindd_pw *pw);
+void winbindd_nss_export_flush(void);
+
 struct tevent_req *wb_lookupuseraliases_send(TALLOC_CTX *mem_ctx,
 					     struct tevent_context *ev,
 					     struct winbindd_domain *domain,
@@ -714,10 +721,13 @@ NTSTATUS winbindd_lookuprids_recv(struct tevent_req *req,
 
 struct tevent_req *wb_query_user_list_send(TALLOC_CTX *mem_ctx,
 					   struct tevent_context *ev,
-					   struct winbindd_domain *domain);
+					   struct winbindd_domain *domain,
+					   uint32_t resume_index,
+					   uint32_t max_users);
 NTSTATUS wb_query_user_list_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
 				 int *num_users,
-				 struct wbint_userinfo **users);
+				 struct wbint_userinfo **users,
+				 uint32_t *next_index);
 
 struct tevent_req *wb_query_group_list_send(TALLOC_CTX *mem_ctx,
 					    struct tevent_context *ev,
@@ -30,6 +30,7 @@
 #include "dsdb/samdb/samdb.h"
 #include "dsdb/common/util.h"
 #include "dns_server/dnsserver_common.h"
+#include "util/dlinklist.h"
 
 #undef DBGC_CLASS
 #define DBGC_CLASS DBGC_DNS
@@ -100,6 +101,146 @@ WERROR dns_common_extract(const struct ldb_message_element *el,
 	return WERR_OK;
 }
 
+/*
+ * Short lived cache of dnsNode lookups.
+ *
+ * Monitoring setups resolve against the DC at high rates, and every
+ * query was a samdb search plus an NDR pull per record although the
+ * records for a name change rarely. Keep the raw dnsRecord values (or
+ * a negative result) for a few seconds, keyed by the node DN. Only
+ * plain queries (tombstoned == NULL) are served from the cache; the
+ * read-modify-write paths of dynamic updates all pass a tombstoned
+ * pointer and always read fresh data. Local updates through
+ * dns_common_replace() invalidate the entry immediately; changes
+ * arriving from other processes (RPC management, bind9 DLZ,
+ * replication) become visible when the entry expires.
+ */
+#define DNS_LOOKUP_CACHE_MAX_ENTRIES 512
+#define DNS_LOOKUP_CACHE_TIMEOUT 10 /* seconds */
+
+struct dns_lookup_cache_entry {
+	struct dns_lookup_cache_entry *prev, *next;
+	char *key;
+	struct timeval expiry;
+	WERROR werr;
+	struct ldb_val *values;
+	unsigned int num_values;
+};
+
+static struct dns_lookup_cache_entry *dns_lookup_cache;
+static unsigned int dns_lookup_cache_count;
+
+static char *dns_lookup_cache_key(TALLOC_CTX *mem_ctx, struct ldb_dn *dn)
+{
+	const char *dn_str = ldb_dn_get_linearized(dn);
+
+	if (dn_str == NULL) {
+		return NULL;
+	}
+	return talloc_strdup(mem_ctx, dn_str);
+}
+
+static void dns_lookup_cache_zap(struct dns_lookup_cache_entry *e)
+{
+	DLIST_REMOVE(dns_lookup_cache, e);
+	dns_lookup_cache_count -= 1;
+	TALLOC_FREE(e);
+}
+
+static struct dns_lookup_cache_entry *dns_lookup_cache_find(const char *key)
+{
+	struct dns_lookup_cache_entry *e;
+
+	for (e = dns_lookup_cache; e != NULL; e = e->next) {
+		if (strcmp(e->key, key) != 0) {
+			continue;
+		}
+		if (timeval_expired(&e->expiry)) {
+			dns_lookup_cache_zap(e);
+			return NULL;
+		}
+		DLIST_PROMOTE(dns_lookup_cache, e);
+		return e;
+	}
+
+	return NULL;
+}
+
+static void dns_lookup_cache_store(const char *key,
+				   WERROR werr,
+				   const struct ldb_message_element *el)
+{
+	struct dns_lookup_cache_entry *e;
+
+	e = dns_lookup_cache_find(key);
+	if (e != NULL) {
+		dns_lookup_cache_zap(e);
+	}
+
+	e = talloc_zero(NULL, struct dns_lookup_cache_entry);
+	if (e == NULL) {
+		return;
+	}
+	e->key = talloc_strdup(e, key);
+	if (e->key == NULL) {
+		TALLOC_FREE(e);
+		return;
+	}
+	e->werr = werr;
+
+	if (el != NULL) {
+		unsigned int i;
+
+		e->values = talloc_zero_array(e, struct ldb_val,
+					      el->num_values);
+		if (e->values == NULL) {
+			TALLOC_FREE(e);
+			return;
+		}
+		for (i = 0; i < el->num_values; i++) {
+			e->values[i].data = talloc_memdup(
+				e->values, el->values[i].data,
+				el->values[i].length);
+			if (e->values[i].data == NULL) {
+				TALLOC_FREE(e);
+				return;
+			}
+			e->values[i].length = el->values[i].length;
+		}
+		e->num_values = el->num_values;
+	}
+
+	e->expiry = timeval_current_ofs(DNS_LOOKUP_CACHE_TIMEOUT, 0);
+
+	if (dns_lookup_cache_count >= DNS_LOOKUP_CACHE_MAX_ENTRIES) {
+		dns_lookup_cache_zap(DLIST_TAIL(dns_lookup_cache));
+	}
+
+	DLIST_ADD(dns_lookup_cache, e);
+	dns_lookup_cache_count += 1;
+}
+
+static void dns_lookup_cache_invalidate(struct ldb_dn *dn)
+{
+	TALLOC_CTX *tmp_ctx = talloc_new(NULL);
+	struct dns_lookup_cache_entry *e;
+	char *key;
+
+	if (tmp_ctx == NULL) {
+		return;
+	}
+
+	key = dns_lookup_cache_key(tmp_ctx, dn);
+	if (key != NULL) {
+		e = dns_lookup_cache_find(key);
+		if (e != NULL) {
+			dns_lookup_cache_zap(e);
+		}
+	}
+
+	talloc_free(tmp_ctx);
+}
+
 WERROR dns_common_lookup(struct ldb_context *samdb,
 			 TALLOC_CTX *mem_ctx,
 			 struct ldb_dn *dn,
@@ -116,10 +257,37 @@ WERROR dns_common_lookup(struct ldb_context *samdb,
 	WERROR werr;
 	struct ldb_message *msg = NULL;
 	struct ldb_message_element *el;
+	char *cache_key = NULL;
+	struct dns_lookup_cache_entry *cache_entry = NULL;
 
 	*records = NULL;
 	*num_records = 0;
 
+	if (tombstoned == NULL) {
+		cache_key = dns_lookup_cache_key(mem_ctx, dn);
+	}
+	if (cache_key != NULL) {
+		cache_entry = dns_lookup_cache_find(cache_key);
+	}
+	if (cache_entry != NULL) {
+		if (!W_ERROR_IS_OK(cache_entry->werr)) {
+			werr = cache_entry->werr;
+			TALLOC_FREE(cache_key);
+			return werr;
+		}
+		el = talloc_zero(mem_ctx, struct ldb_message_element);
+		if (el != NULL) {
+			el->values = cache_entry->values;
+			el->num_values = cache_entry->num_values;
+			werr = dns_common_extract(el, mem_ctx,
+						  records, num_records);
+			TALLOC_FREE(el);
+			TALLOC_FREE(cache_key);
+			return werr;
+		}
+		/* fall back to the database on talloc failure */
+	}
+
 	if (tombstoned != NULL) {
 		*tombstoned = false;
 		ret = dsdb_search_one(samdb, mem_ctx, &msg, dn,
@@ -131,6 +299,12 @@ WERROR dns_common_lookup(struct ldb_context *samdb,
 			"(&(objectClass=dnsNode)(!(dNSTombstoned=TRUE)))");
 	}
 	if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+		if (cache_key != NULL) {
+			dns_lookup_cache_store(
+				cache_key, WERR_DNS_ERROR_NAME_DOES_NOT_EXIST,
+				NULL);
+			TALLOC_FREE(cache_key);
+		}
 		return WERR_DNS_ERROR_NAME_DOES_NOT_EXIST;
 	}
 	if (ret != LDB_SUCCESS) {
@@ -145,6 +319,10 @@ WERROR dns_common_lookup(struct ldb_context *samdb,
 	}
 
 	el = ldb_msg_find_element(msg, "dnsRecord");
+	if ((el != NULL) && (cache_key != NULL)) {
+		dns_lookup_cache_store(cache_key, WERR_OK, el);
+	}
+	TALLOC_FREE(cache_key);
 	if (el == NULL) {
 		TALLOC_FREE(msg);
 		if (tombstoned != NULL) {
@@ -221,6 +399,12 @@ WERROR dns_common_replace(struct ldb_context *samdb,
 	bool was_tombstoned = false;
 	bool become_tombstoned = false;
 
+	/*
+	 * Invalidate before touching the database, so no return path
+	 * can leave a stale entry behind.
+	 */
+	dns_lookup_cache_invalidate(dn);
+
 	msg = ldb_msg_new(mem_ctx);
 	W_ERROR_HAVE_NO_MEMORY(msg);
 
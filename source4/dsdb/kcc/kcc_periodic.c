@@ -535,6 +535,40 @@ NTSTATUS kccsrv_simple_update(struct kccsrv_service *s, TALLOC_CTX *mem_ctx)
 }
 
 
+/*
+ * The topology we generate is derived purely from the configuration
+ * partition (the sites, nTDSDSA and crossRef objects), so as long as
+ * its highest committed USN has not moved since the last run the
+ * result cannot change and the recalculation can be skipped. A full
+ * run is still forced every KCC_MAX_UNCHANGED_RUNS runs to recover
+ * local state, like manually wiped repsFrom values, that does not
+ * bump the configuration USN.
+ */
+#define KCC_MAX_UNCHANGED_RUNS 10
+
+static bool kccsrv_topology_needs_update(struct kccsrv_service *s)
+{
+	uint64_t config_usn = 0;
+	int ret;
+
+	ret = dsdb_load_partition_usn(s->samdb, s->config_dn,
+				      &config_usn, NULL);
+	if (ret != LDB_SUCCESS) {
+		/* be safe and recalculate */
+		return true;
+	}
+
+	if (config_usn != s->last_config_usn ||
+	    s->unchanged_runs >= KCC_MAX_UNCHANGED_RUNS) {
+		s->last_config_usn = config_usn;
+		s->unchanged_runs = 0;
+		return true;
+	}
+
+	s->unchanged_runs++;
+	return false;
+}
+
 static void kccsrv_periodic_run(struct kccsrv_service *service);
 
 static void kccsrv_periodic_handler_te(struct tevent_context *ev, struct tevent_timer *te,
@@ -607,11 +641,17 @@ static void kccsrv_periodic_run(struct kccsrv_service *service)
 
         if (service->samba_kcc_code)
 		status = kccsrv_samba_kcc(service);
-	else {
+	else if (kccsrv_topology_needs_update(service)) {
 		status = kccsrv_simple_update(service, mem_ctx);
-		if (!NT_STATUS_IS_OK(status))
+		if (!NT_STATUS_IS_OK(status)) {
 			DEBUG(0,("kccsrv_simple_update failed - %s\n",
 				nt_errstr(status)));
+			/* retry on the next run */
+			service->last_config_usn = 0;
+		}
+	} else {
+		DEBUG(4,("kccsrv_periodic_run(): configuration unchanged, "
+			 "topology update skipped\n"));
 	}
 
 	status = kccsrv_check_deleted(service, mem_ctx);
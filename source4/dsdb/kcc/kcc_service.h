@@ -90,6 +90,16 @@ struct kccsrv_service {
 
 	time_t last_full_scan_deleted_check;
 
+	/*
+	 * highest USN of the configuration partition as of the last
+	 * topology run, used to skip the recalculation when nothing
+	 * that feeds the topology has changed
+	 */
+	uint64_t last_config_usn;
+
+	/* periodic runs skipped since the last full recalculation */
+	uint32_t unchanged_runs;
+
 	bool am_rodc;
 
 	/* run new samba_kcc topology generator code */
@@ -89,6 +89,11 @@ struct replmd_replicated_request {
 	uint32_t index_current;
 	struct dsdb_extended_replicated_objects *objs;
 
+	/* a single prefetch search proved that no object of this
+	   chunk exists locally, so the per-object lookups in
+	   replmd_replicated_apply_next() can be skipped */
+	bool all_objects_new;
+
 	struct ldb_message *search_msg;
 
 	uint64_t seq_num;
@@ -4769,6 +4774,85 @@ static int replmd_replicated_apply_search_callback(struct ldb_request *req,
 
 static int replmd_replicated_uptodate_vector(struct replmd_replicated_request *ar);
 
+/*
+ * Work out with one search whether any object of this chunk already
+ * exists locally. During an initial sync (the common bulk case) none
+ * do, and replmd_replicated_apply_next() can then go straight to the
+ * ADD codepath instead of searching for every single object.
+ *
+ * This is only an optimisation, any failure just leaves the
+ * per-object searches in place.
+ */
+static void replmd_replicated_chunk_prefetch(struct replmd_replicated_request *ar)
+{
+	TALLOC_CTX *tmp_ctx;
+	struct ldb_result *res;
+	char *filter;
+	uint32_t i, j;
+	int ret;
+	static const char *attrs[] = { "objectGUID", NULL };
+
+	if (ar->objs->num_objects == 0) {
+		return;
+	}
+
+	/*
+	 * If the same object appears twice in one chunk the second
+	 * instance must see the copy created by the first, so we
+	 * can't skip its lookup
+	 */
+	for (i = 0; i < ar->objs->num_objects; i++) {
+		const struct ldb_val *v1 = &ar->objs->objects[i].guid_value;
+		for (j = i + 1; j < ar->objs->num_objects; j++) {
+			const struct ldb_val *v2 = &ar->objs->objects[j].guid_value;
+			if (ldb_val_equal_exact(v1, v2)) {
+				return;
+			}
+		}
+	}
+
+	tmp_ctx = talloc_new(ar);
+	if (tmp_ctx == NULL) {
+		return;
+	}
+
+	filter = talloc_strdup(tmp_ctx, "(|");
+	for (i = 0; filter && i < ar->objs->num_objects; i++) {
+		char *tmp_str;
+
+		tmp_str = ldb_binary_encode(tmp_ctx,
+					    ar->objs->objects[i].guid_value);
+		if (tmp_str == NULL) {
+			talloc_free(tmp_ctx);
+			return;
+		}
+		filter = talloc_asprintf_append_buffer(filter,
+						       "(objectGUID=%s)",
+						       tmp_str);
+		talloc_free(tmp_str);
+	}
+	if (filter != NULL) {
+		filter = talloc_asprintf_append_buffer(filter, ")");
+	}
+	if (filter == NULL) {
+		talloc_free(tmp_ctx);
+		return;
+	}
+
+	ret = dsdb_module_search(ar->module, tmp_ctx, &res,
+				 NULL, LDB_SCOPE_SUBTREE, attrs,
+				 DSDB_FLAG_NEXT_MODULE |
+				 DSDB_SEARCH_SEARCH_ALL_PARTITIONS |
+				 DSDB_SEARCH_SHOW_RECYCLED,
+				 ar->req,
+				 "%s", filter);
+	if (ret == LDB_SUCCESS && res->count == 0) {
+		ar->all_objects_new = true;
+	}
+
+	talloc_free(tmp_ctx);
+}
+
 static int replmd_replicated_apply_next(struct replmd_replicated_request *ar)
 {
 	struct ldb_context *ldb;
@@ -4786,6 +4870,16 @@ static int replmd_replicated_apply_next(struct replmd_replicated_request *ar)
 	ar->search_msg = NULL;
 	ar->isDeleted = false;
 
+	/*
+	 * the prefetch proved there is no local copy of any chunk
+	 * object, so behave as the search callback would for an
+	 * empty result and go straight to the ADD codepath
+	 */
+	if (ar->all_objects_new) {
+		ar->objs->objects[ar->index_current].last_known_parent = NULL;
+		return replmd_replicated_apply_search_for_parent(ar);
+	}
+
 	tmp_str = ldb_binary_encode(ar, ar->objs->objects[ar->index_current].guid_value);
 	if (!tmp_str) return replmd_replicated_request_werror(ar, WERR_NOMEM);
 
@@ -5358,6 +5452,8 @@ static int replmd_extended_replicated_objects(struct ldb_module *module, struct
 		DLIST_ADD(replmd_private->la_list, la_entry);
 	}
 
+	replmd_replicated_chunk_prefetch(ar);
+
 	return replmd_replicated_apply_next(ar);
 }
 
@@ -37,6 +37,27 @@
 #include "lib/tsocket/tsocket.h"
 #include "cldap_server/cldap_server.h"
 #include "lib/events/events.h"
+#include "util/dlinklist.h"
+
+/*
+ * Cache of marshalled CLDAP netlogon responses.
+ *
+ * During login storms a DC gets hammered with netlogon pings, and the
+ * answer for a given (filter, source address) pair is rebuilt from
+ * several ldb searches plus an NDR push every time although it hardly
+ * ever changes. Identical pings within the timeout are answered with
+ * the cached blob. The timeout bounds how long site, subnet or account
+ * changes can be served with a stale answer.
+ */
+#define ROOTDSE_NETLOGON_CACHE_MAX_ENTRIES 256
+#define ROOTDSE_NETLOGON_CACHE_TIMEOUT 10 /* seconds */
+
+struct rootdse_netlogon_cache_entry {
+	struct rootdse_netlogon_cache_entry *prev, *next;
+	char *key;
+	struct timeval expiry;
+	struct ldb_val blob;
+};
 
 struct rootdse_private_data {
 	unsigned int num_controls;
@@ -46,6 +67,8 @@ struct rootdse_private_data {
 	bool block_anonymous;
 	struct tevent_context *saved_ev;
 	struct tevent_context *private_ev;
+	struct rootdse_netlogon_cache_entry *netlogon_cache;
+	unsigned int netlogon_cache_count;
 };
 
 struct rootdse_context {
@@ -743,6 +766,70 @@ static int rootdse_filter_operations(struct ldb_module *module, struct ldb_reque
 	return LDB_ERR_OPERATIONS_ERROR;
 }
 
+static bool rootdse_netlogon_cache_lookup(struct rootdse_private_data *priv,
+					  struct rootdse_context *ac,
+					  const char *key)
+{
+	struct rootdse_netlogon_cache_entry *e;
+
+	for (e = priv->netlogon_cache; e != NULL; e = e->next) {
+		if (strcmp(e->key, key) != 0) {
+			continue;
+		}
+		if (timeval_expired(&e->expiry)) {
+			DLIST_REMOVE(priv->netlogon_cache, e);
+			priv->netlogon_cache_count -= 1;
+			talloc_free(e);
+			return false;
+		}
+		ac->netlogon.data = talloc_memdup(ac, e->blob.data,
+						  e->blob.length);
+		if (ac->netlogon.data == NULL) {
+			return false;
+		}
+		ac->netlogon.length = e->blob.length;
+		DLIST_PROMOTE(priv->netlogon_cache, e);
+		return true;
+	}
+
+	return false;
+}
+
+static void rootdse_netlogon_cache_store(struct rootdse_private_data *priv,
+					 const char *key,
+					 const struct ldb_val *blob)
+{
+	struct rootdse_netlogon_cache_entry *e;
+
+	e = talloc_zero(priv, struct rootdse_netlogon_cache_entry);
+	if (e == NULL) {
+		return;
+	}
+	e->key = talloc_strdup(e, key);
+	if (e->key == NULL) {
+		talloc_free(e);
+		return;
+	}
+	e->blob.data = talloc_memdup(e, blob->data, blob->length);
+	if (e->blob.data == NULL) {
+		talloc_free(e);
+		return;
+	}
+	e->blob.length = blob->length;
+	e->expiry = timeval_current_ofs(ROOTDSE_NETLOGON_CACHE_TIMEOUT, 0);
+
+	if (priv->netlogon_cache_count >= ROOTDSE_NETLOGON_CACHE_MAX_ENTRIES) {
+		struct rootdse_netlogon_cache_entry *last =
+			DLIST_TAIL(priv->netlogon_cache);
+		DLIST_REMOVE(priv->netlogon_cache, last);
+		priv->netlogon_cache_count -= 1;
+		talloc_free(last);
+	}
+
+	DLIST_ADD(priv->netlogon_cache, e);
+	priv->netlogon_cache_count += 1;
+}
+
 static int rootdse_handle_netlogon(struct rootdse_context *ac)
 {
 	struct ldb_context *ldb;
@@ -750,8 +837,12 @@ static int rootdse_handle_netlogon(struct rootdse_context *ac)
 	struct loadparm_context *lp_ctx;
 	struct tsocket_address *src_addr;
 	TALLOC_CTX *tmp_ctx = talloc_new(ac->req);
+	struct rootdse_private_data *priv =
+		talloc_get_type(ldb_module_get_private(ac->module),
+				struct rootdse_private_data);
 	const char *domain, *host, *user, *domain_guid;
 	char *src_addr_s = NULL;
+	char *cache_key = NULL;
 	struct dom_sid *domain_sid;
 	int acct_control = -1;
 	int version = -1;
@@ -770,6 +861,27 @@ static int rootdse_handle_netlogon(struct rootdse_context *ac)
 							      tmp_ctx);
 	}
 
+	if (priv != NULL) {
+		char *filter_s = ldb_filter_from_tree(tmp_ctx, tree);
+
+		/*
+		 * The response is fully determined by the filter and
+		 * the source address (which selects the client site
+		 * and the returned DC address).
+		 */
+		if (filter_s != NULL) {
+			cache_key = talloc_asprintf(tmp_ctx, "%s/%s",
+						    src_addr_s ? src_addr_s : "",
+						    filter_s);
+		}
+	}
+
+	if (cache_key != NULL &&
+	    rootdse_netlogon_cache_lookup(priv, ac, cache_key)) {
+		talloc_free(tmp_ctx);
+		return LDB_SUCCESS;
+	}
+
 	status = parse_netlogon_request(tree, lp_ctx, tmp_ctx,
 					&domain, &host, &user, &domain_guid,
 					&domain_sid, &acct_control, &version);
@@ -793,6 +905,10 @@ static int rootdse_handle_netlogon(struct rootdse_context *ac)
 		goto failed;
 	}
 
+	if (cache_key != NULL) {
+		rootdse_netlogon_cache_store(priv, cache_key, &ac->netlogon);
+	}
+
 	ret = LDB_SUCCESS;
 failed:
 	talloc_free(tmp_ctx);
@@ -158,6 +158,337 @@ static int schema_metadata_get_uint64(struct ldb_module *module,
 	return LDB_SUCCESS;
 }
 
+/*
+ * The schema cache keeps the raw results of the two schema searches
+ * (the schema head and the attributeSchema/classSchema objects) in a
+ * plain helper ldb next to metadata.tdb, so a restart can load the
+ * schema with a single unindexed traverse instead of the expensive
+ * indexed searches over the schema partition. The cache is validated
+ * against the schema partition USN, and rebuilt whenever the schema
+ * was loaded from the database.
+ */
+#define DSDB_SCHEMA_CACHE_VERSION 1
+
+/* the cached records carry their real DN in this attribute, as the
+ * cache ldb would not preserve the storage format DNs */
+#define DSDB_SCHEMA_CACHE_DN_ATTR "dsdbStorageDn"
+
+static char *schema_cache_filename(struct ldb_module *module, TALLOC_CTX *mem_ctx)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	const char *sam_name;
+
+	sam_name = (const char *)ldb_get_opaque(ldb, "ldb_url");
+	if (!sam_name) {
+		return NULL;
+	}
+	if (strncmp("tdb://", sam_name, 6) == 0) {
+		sam_name += 6;
+	}
+	return talloc_asprintf(mem_ctx, "%s.d/schema_cache.ldb", sam_name);
+}
+
+/*
+ * Load the cached schema search results, verifying them against the
+ * current schema partition USN and sequence number. On success the
+ * two results look exactly like those of dsdb_schema_from_db()'s
+ * searches, DNs in storage format included.
+ */
+static int schema_cache_load(struct ldb_module *module,
+			     TALLOC_CTX *mem_ctx,
+			     uint64_t current_usn,
+			     uint64_t schema_seq_num,
+			     struct ldb_result **schema_res_out,
+			     struct ldb_result **res_out)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	struct ldb_dn *schema_dn = ldb_get_schema_basedn(ldb);
+	TALLOC_CTX *tmp_ctx;
+	struct ldb_context *cache_ldb;
+	struct ldb_dn *hdr_dn;
+	struct ldb_result *hdr_res, *cres;
+	struct ldb_result *schema_res, *res;
+	char *filename, *url;
+	unsigned int i;
+	int ret;
+	static const char *hdr_attrs[] = {
+		"version",
+		"partitionUsn",
+		"schemaSequenceNumber",
+		NULL
+	};
+
+	if (current_usn == 0 || schema_dn == NULL) {
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	tmp_ctx = talloc_new(mem_ctx);
+	if (tmp_ctx == NULL) {
+		return ldb_module_oom(module);
+	}
+
+	filename = schema_cache_filename(module, tmp_ctx);
+	if (filename == NULL) {
+		talloc_free(tmp_ctx);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+	url = talloc_asprintf(tmp_ctx, "tdb://%s", filename);
+	if (url == NULL) {
+		talloc_free(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+
+	cache_ldb = ldb_init(tmp_ctx, ldb_get_event_context(ldb));
+	if (cache_ldb == NULL) {
+		talloc_free(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+
+	ret = ldb_connect(cache_ldb, url, LDB_FLG_RDONLY, NULL);
+	if (ret != LDB_SUCCESS) {
+		talloc_free(tmp_ctx);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	hdr_dn = ldb_dn_new(tmp_ctx, cache_ldb, "@SCHEMA_CACHE");
+	if (hdr_dn == NULL) {
+		talloc_free(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+
+	ret = ldb_search(cache_ldb, tmp_ctx, &hdr_res, hdr_dn,
+			 LDB_SCOPE_BASE, hdr_attrs, NULL);
+	if (ret != LDB_SUCCESS || hdr_res->count != 1) {
+		talloc_free(tmp_ctx);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	if (ldb_msg_find_attr_as_uint64(hdr_res->msgs[0], "version", 0) !=
+	    DSDB_SCHEMA_CACHE_VERSION) {
+		talloc_free(tmp_ctx);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+	if (ldb_msg_find_attr_as_uint64(hdr_res->msgs[0], "partitionUsn", 0) !=
+	    current_usn) {
+		talloc_free(tmp_ctx);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+	if (schema_seq_num != 0 &&
+	    ldb_msg_find_attr_as_uint64(hdr_res->msgs[0],
+					"schemaSequenceNumber", 0) !=
+	    schema_seq_num) {
+		talloc_free(tmp_ctx);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	ret = ldb_search(cache_ldb, tmp_ctx, &cres, NULL, LDB_SCOPE_SUBTREE,
+			 NULL, "(%s=*)", DSDB_SCHEMA_CACHE_DN_ATTR);
+	if (ret != LDB_SUCCESS || cres->count < 2) {
+		talloc_free(tmp_ctx);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	schema_res = talloc_zero(tmp_ctx, struct ldb_result);
+	res = talloc_zero(tmp_ctx, struct ldb_result);
+	if (schema_res == NULL || res == NULL) {
+		talloc_free(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+	schema_res->msgs = talloc_array(schema_res, struct ldb_message *, 1);
+	res->msgs = talloc_array(res, struct ldb_message *, cres->count);
+	if (schema_res->msgs == NULL || res->msgs == NULL) {
+		talloc_free(tmp_ctx);
+		return ldb_module_oom(module);
+	}
+
+	for (i = 0; i < cres->count; i++) {
+		struct ldb_message *msg = cres->msgs[i];
+		const char *dn_str;
+
+		dn_str = ldb_msg_find_attr_as_string(msg,
+						     DSDB_SCHEMA_CACHE_DN_ATTR,
+						     NULL);
+		if (dn_str == NULL) {
+			talloc_free(tmp_ctx);
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+		/* the DN has to live on the main ldb context, in the
+		 * storage format it was cached in */
+		msg->dn = ldb_dn_new(msg, ldb, dn_str);
+		if (msg->dn == NULL) {
+			talloc_free(tmp_ctx);
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+		ldb_msg_remove_attr(msg, DSDB_SCHEMA_CACHE_DN_ATTR);
+
+		if (ldb_dn_compare(schema_dn, msg->dn) == 0) {
+			if (schema_res->count != 0) {
+				talloc_free(tmp_ctx);
+				return LDB_ERR_OPERATIONS_ERROR;
+			}
+			schema_res->msgs[0] = talloc_steal(schema_res->msgs,
+							   msg);
+			schema_res->count = 1;
+		} else {
+			res->msgs[res->count] = talloc_steal(res->msgs, msg);
+			res->count++;
+		}
+	}
+
+	if (schema_res->count != 1 || res->count == 0) {
+		talloc_free(tmp_ctx);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	*schema_res_out = talloc_steal(mem_ctx, schema_res);
+	*res_out = talloc_steal(mem_ctx, res);
+	talloc_free(tmp_ctx);
+	return LDB_SUCCESS;
+}
+
+/*
+ * Write the schema search results into a fresh cache file and rename
+ * it into place. Failures only cost the next restart a full load, so
+ * they are logged and swallowed.
+ */
+static void schema_cache_store(struct ldb_module *module,
+			       struct ldb_result *schema_res,
+			       struct ldb_result *res,
+			       uint64_t current_usn,
+			       uint64_t schema_seq_num)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	TALLOC_CTX *tmp_ctx;
+	struct ldb_context *cache_ldb;
+	struct ldb_message *hdr_msg;
+	char *filename, *tmp_name, *url;
+	unsigned int i;
+	bool in_transaction = false;
+	int ret;
+
+	if (current_usn == 0) {
+		return;
+	}
+
+	tmp_ctx = talloc_new(module);
+	if (tmp_ctx == NULL) {
+		return;
+	}
+
+	filename = schema_cache_filename(module, tmp_ctx);
+	if (filename == NULL) {
+		talloc_free(tmp_ctx);
+		return;
+	}
+	tmp_name = talloc_asprintf(tmp_ctx, "%s.tmp%u", filename,
+				   (unsigned)getpid());
+	url = talloc_asprintf(tmp_ctx, "tdb://%s", tmp_name);
+	if (tmp_name == NULL || url == NULL) {
+		talloc_free(tmp_ctx);
+		return;
+	}
+	unlink(tmp_name);
+
+	cache_ldb = ldb_init(tmp_ctx, ldb_get_event_context(ldb));
+	if (cache_ldb == NULL) {
+		talloc_free(tmp_ctx);
+		return;
+	}
+	ret = ldb_connect(cache_ldb, url, 0, NULL);
+	if (ret != LDB_SUCCESS) {
+		goto failed;
+	}
+
+	ret = ldb_transaction_start(cache_ldb);
+	if (ret != LDB_SUCCESS) {
+		goto failed;
+	}
+	in_transaction = true;
+
+	hdr_msg = ldb_msg_new(tmp_ctx);
+	if (hdr_msg == NULL) {
+		goto failed;
+	}
+	hdr_msg->dn = ldb_dn_new(hdr_msg, cache_ldb, "@SCHEMA_CACHE");
+	if (hdr_msg->dn == NULL) {
+		goto failed;
+	}
+	if (ldb_msg_add_fmt(hdr_msg, "version", "%u",
+			    DSDB_SCHEMA_CACHE_VERSION) != LDB_SUCCESS ||
+	    ldb_msg_add_fmt(hdr_msg, "partitionUsn", "%llu",
+			    (unsigned long long)current_usn) != LDB_SUCCESS ||
+	    ldb_msg_add_fmt(hdr_msg, "schemaSequenceNumber", "%llu",
+			    (unsigned long long)schema_seq_num) != LDB_SUCCESS) {
+		goto failed;
+	}
+	ret = ldb_add(cache_ldb, hdr_msg);
+	if (ret != LDB_SUCCESS) {
+		goto failed;
+	}
+
+	for (i = 0; i < schema_res->count + res->count; i++) {
+		struct ldb_message *msg;
+		struct ldb_message *copy;
+		char *dn_str;
+
+		if (i < schema_res->count) {
+			msg = schema_res->msgs[i];
+		} else {
+			msg = res->msgs[i - schema_res->count];
+		}
+
+		copy = ldb_msg_copy_shallow(tmp_ctx, msg);
+		if (copy == NULL) {
+			goto failed;
+		}
+		/* the cache key is synthetic, the real DN is kept in
+		 * storage format in an attribute */
+		copy->dn = ldb_dn_new_fmt(copy, cache_ldb, "CN=%u", i);
+		if (copy->dn == NULL) {
+			goto failed;
+		}
+		dn_str = ldb_dn_get_extended_linearized(copy, msg->dn, 1);
+		if (dn_str == NULL) {
+			goto failed;
+		}
+		if (ldb_msg_add_steal_string(copy, DSDB_SCHEMA_CACHE_DN_ATTR,
+					     dn_str) != LDB_SUCCESS) {
+			goto failed;
+		}
+		ret = ldb_add(cache_ldb, copy);
+		if (ret != LDB_SUCCESS) {
+			goto failed;
+		}
+		talloc_free(copy);
+	}
+
+	ret = ldb_transaction_commit(cache_ldb);
+	in_transaction = false;
+	if (ret != LDB_SUCCESS) {
+		goto failed;
+	}
+
+	/* close the tdb before renaming it into place */
+	talloc_free(cache_ldb);
+	cache_ldb = NULL;
+
+	if (rename(tmp_name, filename) != 0) {
+		goto failed;
+	}
+
+	talloc_free(tmp_ctx);
+	return;
+
+failed:
+	DEBUG(1, ("schema_load: failed to store the schema cache in %s\n",
+		  tmp_name));
+	if (in_transaction) {
+		ldb_transaction_cancel(cache_ldb);
+	}
+	unlink(tmp_name);
+	talloc_free(tmp_ctx);
+}
+
 static struct dsdb_schema *dsdb_schema_refresh(struct ldb_module *module, struct tevent_context *ev,
 					       struct dsdb_schema *schema, bool is_global_schema)
 {
@@ -269,6 +600,7 @@ static int dsdb_schema_from_db(struct ldb_module *module,
 	struct ldb_dn *schema_dn = ldb_get_schema_basedn(ldb);
 	struct ldb_result *schema_res;
 	struct ldb_result *res;
+	char *cache_filename;
 	static const char *schema_attrs[] = {
 		"prefixMap",
 		"schemaInfo",
@@ -286,6 +618,29 @@ static int dsdb_schema_from_db(struct ldb_module *module,
 	flags = ldb_get_flags(ldb);
 	ldb_set_flags(ldb, flags & ~LDB_FLG_ENABLE_TRACING);
 
+	/*
+	 * try the precomputed schema cache first, any mismatch or
+	 * corruption just falls back to the real searches below
+	 */
+	ret = schema_cache_load(module, tmp_ctx, current_usn, schema_seq_num,
+				&schema_res, &res);
+	if (ret == LDB_SUCCESS) {
+		ret = dsdb_schema_from_ldb_results(tmp_ctx, ldb,
+						   schema_res, res, schema, &error_string);
+		if (ret == LDB_SUCCESS) {
+			goto loaded;
+		}
+		cache_filename = schema_cache_filename(module, tmp_ctx);
+		ldb_debug(ldb, LDB_DEBUG_WARNING,
+			  "schema_load: ignoring unusable schema cache: %s\n",
+			  error_string);
+		if (cache_filename != NULL) {
+			unlink(cache_filename);
+		}
+		talloc_free(schema_res);
+		talloc_free(res);
+	}
+
 	/*
 	 * setup the prefix mappings and schema info
 	 */
@@ -323,12 +678,16 @@ static int dsdb_schema_from_db(struct ldb_module *module,
 	ret = dsdb_schema_from_ldb_results(tmp_ctx, ldb,
 					   schema_res, res, schema, &error_string);
 	if (ret != LDB_SUCCESS) {
-		ldb_asprintf_errstring(ldb, 
+		ldb_asprintf_errstring(ldb,
 				       "dsdb_schema load failed: %s",
 				       error_string);
 		goto failed;
 	}
 
+	/* leave an up to date cache behind for the next startup */
+	schema_cache_store(module, schema_res, res, current_usn, schema_seq_num);
+
+loaded:
 	(*schema)->loaded_usn = current_usn;
 	(*schema)->metadata_usn = schema_seq_num;
 	(*schema)->last_refresh = time(NULL);
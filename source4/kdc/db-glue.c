@@ -1647,10 +1647,42 @@ static krb5_error_code samba_kdc_fetch_krbtgt(krb5_context context,
 		}
 
 		if (krbtgt_number == kdc_db_ctx->my_krbtgt_number) {
-			lret = dsdb_search_one(kdc_db_ctx->samdb, mem_ctx,
-					       &msg, kdc_db_ctx->krbtgt_dn, LDB_SCOPE_BASE,
-					       krbtgt_attrs, DSDB_SEARCH_NO_GLOBAL_CATALOG,
-					       "(objectClass=user)");
+			/*
+			 * Our own krbtgt account is needed for every
+			 * TGS request and changes only on the rare
+			 * password rollover, so keep a short lived
+			 * copy instead of searching the database each
+			 * time. The copy handed out is stolen into
+			 * the resulting entry by
+			 * samba_kdc_message2entry().
+			 */
+			if (kdc_db_ctx->krbtgt_msg_cache != NULL &&
+			    timeval_expired(&kdc_db_ctx->krbtgt_msg_cache_expiry)) {
+				TALLOC_FREE(kdc_db_ctx->krbtgt_msg_cache);
+			}
+			if (kdc_db_ctx->krbtgt_msg_cache == NULL) {
+				lret = dsdb_search_one(kdc_db_ctx->samdb,
+						       kdc_db_ctx,
+						       &kdc_db_ctx->krbtgt_msg_cache,
+						       kdc_db_ctx->krbtgt_dn, LDB_SCOPE_BASE,
+						       krbtgt_attrs, DSDB_SEARCH_NO_GLOBAL_CATALOG,
+						       "(objectClass=user)");
+				if (lret == LDB_SUCCESS) {
+					kdc_db_ctx->krbtgt_msg_cache_expiry =
+						timeval_current_ofs(60, 0);
+				} else {
+					kdc_db_ctx->krbtgt_msg_cache = NULL;
+				}
+			} else {
+				lret = LDB_SUCCESS;
+			}
+			if (lret == LDB_SUCCESS) {
+				msg = ldb_msg_copy(mem_ctx,
+						   kdc_db_ctx->krbtgt_msg_cache);
+				if (msg == NULL) {
+					lret = LDB_ERR_OPERATIONS_ERROR;
+				}
+			}
 		} else {
 			/* We need to look up an RODC krbtgt (perhaps
 			 * ours, if we are an RODC, perhaps another
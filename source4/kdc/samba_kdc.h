@@ -46,6 +46,9 @@ struct samba_kdc_db_context {
 	unsigned int my_krbtgt_number;
 	struct ldb_dn *krbtgt_dn;
 	struct samba_kdc_policy policy;
+	/* short lived copy of our own krbtgt account, see db-glue.c */
+	struct ldb_message *krbtgt_msg_cache;
+	struct timeval krbtgt_msg_cache_expiry;
 };
 
 struct samba_kdc_entry {
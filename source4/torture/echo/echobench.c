@@ -0,0 +1,581 @@
+/*
+   Unix SMB/CIFS implementation.
+
+   ECHO server benchmark
+
+   Measures raw tevent/tsocket round-trip latency and throughput
+   against the example echo server, without any SMB stack on top.
+   Useful to spot event-loop and socket-layer regressions between
+   releases.
+
+   Copyright (C) Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "torture/smbtorture.h"
+#include "libcli/resolve/resolve.h"
+#include "param/param.h"
+#include "system/network.h"
+#include "lib/tsocket/tsocket.h"
+#include "echo_server/echo_server.h"
+#include "torture/echo/proto.h"
+
+struct echo_bench_state;
+
+/* one socket/connection towards the server */
+struct echo_bench_conn {
+	struct echo_bench_state *state;
+
+	/* only one of these is used, depending on the transport */
+	struct tdgram_context *dgram;
+	struct tstream_context *stream;
+
+	struct tevent_queue *send_queue;
+	struct tsocket_address *remote;
+
+	uint8_t *recv_buf;
+	struct iovec recv_iov;
+
+	/*
+	 * ring of send timestamps for the requests in flight, the
+	 * replies come back in order on a single socket so the oldest
+	 * entry always belongs to the next reply
+	 */
+	struct timeval *sent_times;
+	unsigned int send_idx;
+	unsigned int recv_idx;
+	unsigned int in_flight;
+};
+
+struct echo_bench_state {
+	struct torture_context *tctx;
+
+	size_t payload;
+	unsigned int pipeline;
+	unsigned int nconns;
+
+	uint8_t *payload_buf;
+
+	uint64_t replies;
+	uint64_t errors;
+	uint64_t bytes;
+	double rtt_total;
+
+	/* used while setting up the tcp connections */
+	unsigned int pending_connects;
+	bool connect_failed;
+};
+
+/* payload owned per send request, the queue helpers require the
+ * buffer to stay around until the request is done */
+struct echo_bench_send {
+	struct echo_bench_conn *conn;
+	struct iovec iov;
+};
+
+static void echo_bench_account_reply(struct echo_bench_conn *conn,
+				     ssize_t len)
+{
+	struct echo_bench_state *state = conn->state;
+
+	if (len == -1) {
+		state->errors++;
+	} else {
+		state->replies++;
+		state->bytes += len;
+		state->rtt_total += timeval_elapsed(
+			&conn->sent_times[conn->recv_idx]);
+	}
+	conn->recv_idx = (conn->recv_idx + 1) % state->pipeline;
+	conn->in_flight--;
+}
+
+static void echo_bench_report(struct echo_bench_state *state,
+			      struct timeval *tv,
+			      bool final)
+{
+	double elapsed = timeval_elapsed(tv);
+	double rtt_avg = 0.0;
+
+	if (state->replies != 0) {
+		rtt_avg = (state->rtt_total / state->replies) * 1000.0;
+	}
+
+	printf("%.1f msgs/sec, %.3f ms avg rtt, %.3f MByte/sec "
+	       "(%llu errors)  %s",
+	       state->replies / elapsed,
+	       rtt_avg,
+	       (state->bytes / elapsed) / (1024.0 * 1024.0),
+	       (unsigned long long)state->errors,
+	       final ? "\n" : "\r");
+	fflush(stdout);
+}
+
+/*
+ * UDP transport
+ */
+
+static void echo_bench_udp_recv_handler(struct tevent_req *subreq);
+
+static void echo_bench_udp_send_handler(struct tevent_req *subreq)
+{
+	struct echo_bench_send *send_state = tevent_req_callback_data(
+		subreq, struct echo_bench_send);
+	struct echo_bench_conn *conn = send_state->conn;
+	ssize_t len;
+	int sys_errno;
+
+	len = tdgram_sendto_queue_recv(subreq, &sys_errno);
+	talloc_free(subreq);
+	if (len == -1) {
+		/* no reply will ever come for this one */
+		conn->state->errors++;
+		conn->in_flight--;
+	}
+	talloc_free(send_state);
+}
+
+static bool echo_bench_udp_recv_submit(struct echo_bench_conn *conn)
+{
+	struct tevent_req *subreq;
+
+	subreq = tdgram_recvfrom_send(conn, conn->state->tctx->ev,
+				      conn->dgram);
+	if (subreq == NULL) {
+		return false;
+	}
+	tevent_req_set_callback(subreq, echo_bench_udp_recv_handler, conn);
+	return true;
+}
+
+static void echo_bench_udp_recv_handler(struct tevent_req *subreq)
+{
+	struct echo_bench_conn *conn = tevent_req_callback_data(
+		subreq, struct echo_bench_conn);
+	struct tsocket_address *src = NULL;
+	uint8_t *buf = NULL;
+	ssize_t len;
+	int sys_errno;
+
+	len = tdgram_recvfrom_recv(subreq, &sys_errno, conn, &buf, &src);
+	talloc_free(subreq);
+
+	echo_bench_account_reply(conn, len);
+	talloc_free(buf);
+	talloc_free(src);
+
+	echo_bench_udp_recv_submit(conn);
+}
+
+static bool echo_bench_udp_send_submit(struct echo_bench_conn *conn)
+{
+	struct echo_bench_state *state = conn->state;
+	struct echo_bench_send *send_state;
+	struct tevent_req *subreq;
+
+	send_state = talloc(conn, struct echo_bench_send);
+	if (send_state == NULL) {
+		return false;
+	}
+	send_state->conn = conn;
+
+	subreq = tdgram_sendto_queue_send(send_state, state->tctx->ev,
+					  conn->dgram, conn->send_queue,
+					  state->payload_buf,
+					  state->payload, NULL);
+	if (subreq == NULL) {
+		talloc_free(send_state);
+		return false;
+	}
+	tevent_req_set_callback(subreq, echo_bench_udp_send_handler,
+				send_state);
+
+	conn->sent_times[conn->send_idx] = timeval_current();
+	conn->send_idx = (conn->send_idx + 1) % state->pipeline;
+	conn->in_flight++;
+	return true;
+}
+
+/*
+ * TCP transport
+ */
+
+static void echo_bench_tcp_recv_handler(struct tevent_req *subreq);
+
+static void echo_bench_tcp_send_handler(struct tevent_req *subreq)
+{
+	struct echo_bench_send *send_state = tevent_req_callback_data(
+		subreq, struct echo_bench_send);
+	struct echo_bench_conn *conn = send_state->conn;
+	int len;
+	int sys_errno;
+
+	len = tstream_writev_queue_recv(subreq, &sys_errno);
+	talloc_free(subreq);
+	if (len == -1) {
+		conn->state->errors++;
+		conn->in_flight--;
+	}
+	talloc_free(send_state);
+}
+
+static bool echo_bench_tcp_recv_submit(struct echo_bench_conn *conn)
+{
+	struct tevent_req *subreq;
+
+	/* read back exactly one echoed payload */
+	conn->recv_iov.iov_base = conn->recv_buf;
+	conn->recv_iov.iov_len = conn->state->payload;
+
+	subreq = tstream_readv_send(conn, conn->state->tctx->ev,
+				    conn->stream, &conn->recv_iov, 1);
+	if (subreq == NULL) {
+		return false;
+	}
+	tevent_req_set_callback(subreq, echo_bench_tcp_recv_handler, conn);
+	return true;
+}
+
+static void echo_bench_tcp_recv_handler(struct tevent_req *subreq)
+{
+	struct echo_bench_conn *conn = tevent_req_callback_data(
+		subreq, struct echo_bench_conn);
+	int len;
+	int sys_errno;
+
+	len = tstream_readv_recv(subreq, &sys_errno);
+	talloc_free(subreq);
+
+	echo_bench_account_reply(conn, len);
+
+	echo_bench_tcp_recv_submit(conn);
+}
+
+static bool echo_bench_tcp_send_submit(struct echo_bench_conn *conn)
+{
+	struct echo_bench_state *state = conn->state;
+	struct echo_bench_send *send_state;
+	struct tevent_req *subreq;
+
+	send_state = talloc(conn, struct echo_bench_send);
+	if (send_state == NULL) {
+		return false;
+	}
+	send_state->conn = conn;
+	send_state->iov.iov_base = state->payload_buf;
+	send_state->iov.iov_len = state->payload;
+
+	subreq = tstream_writev_queue_send(send_state, state->tctx->ev,
+					   conn->stream, conn->send_queue,
+					   &send_state->iov, 1);
+	if (subreq == NULL) {
+		talloc_free(send_state);
+		return false;
+	}
+	tevent_req_set_callback(subreq, echo_bench_tcp_send_handler,
+				send_state);
+
+	conn->sent_times[conn->send_idx] = timeval_current();
+	conn->send_idx = (conn->send_idx + 1) % state->pipeline;
+	conn->in_flight++;
+	return true;
+}
+
+static void echo_bench_tcp_connect_handler(struct tevent_req *subreq)
+{
+	struct echo_bench_conn *conn = tevent_req_callback_data(
+		subreq, struct echo_bench_conn);
+	int ret;
+	int sys_errno;
+
+	ret = tstream_inet_tcp_connect_recv(subreq, &sys_errno, conn,
+					    &conn->stream, NULL);
+	talloc_free(subreq);
+	if (ret != 0) {
+		conn->state->connect_failed = true;
+	}
+	conn->state->pending_connects--;
+}
+
+/*
+ * common driver
+ */
+
+static struct echo_bench_state *echo_bench_state_init(
+	struct torture_context *tctx)
+{
+	struct echo_bench_state *state;
+	size_t i;
+
+	state = talloc_zero(tctx, struct echo_bench_state);
+	if (state == NULL) {
+		return NULL;
+	}
+
+	state->tctx = tctx;
+	state->payload = torture_setting_int(tctx, "payload", 64);
+	state->pipeline = torture_setting_int(tctx, "pipeline", 10);
+	state->nconns = torture_setting_int(tctx, "nconns", 1);
+
+	if (state->payload == 0 || state->pipeline == 0 ||
+	    state->nconns == 0) {
+		talloc_free(state);
+		return NULL;
+	}
+
+	state->payload_buf = talloc_array(state, uint8_t, state->payload);
+	if (state->payload_buf == NULL) {
+		talloc_free(state);
+		return NULL;
+	}
+	for (i = 0; i < state->payload; i++) {
+		state->payload_buf[i] = (uint8_t)i;
+	}
+
+	return state;
+}
+
+static struct echo_bench_conn *echo_bench_conn_init(
+	struct echo_bench_state *state, const char *address)
+{
+	struct echo_bench_conn *conn;
+	int ret;
+
+	conn = talloc_zero(state, struct echo_bench_conn);
+	if (conn == NULL) {
+		return NULL;
+	}
+	conn->state = state;
+
+	ret = tsocket_address_inet_from_strings(conn, "ip", address,
+						ECHO_SERVICE_PORT,
+						&conn->remote);
+	if (ret != 0) {
+		talloc_free(conn);
+		return NULL;
+	}
+
+	conn->send_queue = tevent_queue_create(conn, "echo_bench_send");
+	if (conn->send_queue == NULL) {
+		talloc_free(conn);
+		return NULL;
+	}
+
+	conn->sent_times = talloc_array(conn, struct timeval,
+					state->pipeline);
+	conn->recv_buf = talloc_array(conn, uint8_t, state->payload);
+	if (conn->sent_times == NULL || conn->recv_buf == NULL) {
+		talloc_free(conn);
+		return NULL;
+	}
+
+	return conn;
+}
+
+static bool echo_bench_run(struct echo_bench_state *state,
+			   struct echo_bench_conn **conns,
+			   bool (*send_submit)(struct echo_bench_conn *))
+{
+	struct torture_context *tctx = state->tctx;
+	int timelimit = torture_setting_int(tctx, "timelimit", 10);
+	struct timeval tv = timeval_current();
+	struct timeval drain;
+	uint64_t reported = 0;
+	unsigned int i;
+
+	while (timeval_elapsed(&tv) < timelimit) {
+		for (i = 0; i < state->nconns; i++) {
+			while (conns[i]->in_flight < state->pipeline) {
+				if (!send_submit(conns[i])) {
+					return false;
+				}
+			}
+		}
+
+		tevent_loop_once(tctx->ev);
+
+		if (state->replies - reported >= 1000) {
+			reported = state->replies;
+			if (torture_setting_bool(tctx, "progress", true)) {
+				echo_bench_report(state, &tv, false);
+			}
+		}
+	}
+
+	/* wait briefly for the replies still in flight */
+	drain = timeval_current();
+	for (;;) {
+		unsigned int in_flight = 0;
+
+		for (i = 0; i < state->nconns; i++) {
+			in_flight += conns[i]->in_flight;
+		}
+		if (in_flight == 0 || timeval_elapsed(&drain) > 2) {
+			break;
+		}
+		tevent_loop_once(tctx->ev);
+	}
+
+	echo_bench_report(state, &tv, true);
+	return true;
+}
+
+static bool echo_bench_resolve(struct torture_context *tctx,
+			       const char **address)
+{
+	struct nbt_name name;
+	NTSTATUS status;
+
+	make_nbt_name_server(&name,
+			     torture_setting_string(tctx, "host", NULL));
+
+	status = resolve_name_ex(lpcfg_resolve_context(tctx->lp_ctx),
+				 0, 0, &name, tctx, address, tctx->ev);
+	if (!NT_STATUS_IS_OK(status)) {
+		printf("Failed to resolve %s - %s\n",
+		       name.name, nt_errstr(status));
+		return false;
+	}
+	return true;
+}
+
+/*
+  benchmark the echo server over udp
+*/
+bool torture_bench_echo_udp(struct torture_context *tctx)
+{
+	struct echo_bench_state *state;
+	struct echo_bench_conn **conns;
+	const char *address;
+	unsigned int i;
+	bool ret;
+
+	if (!echo_bench_resolve(tctx, &address)) {
+		return false;
+	}
+
+	state = echo_bench_state_init(tctx);
+	torture_assert(tctx, state != NULL, "bench setup failed");
+
+	conns = talloc_array(state, struct echo_bench_conn *,
+			     state->nconns);
+	torture_assert(tctx, conns != NULL, "no memory for connections");
+
+	for (i = 0; i < state->nconns; i++) {
+		int sret;
+
+		conns[i] = echo_bench_conn_init(state, address);
+		torture_assert(tctx, conns[i] != NULL,
+			       "socket setup failed");
+
+		sret = tdgram_inet_udp_socket(NULL, conns[i]->remote,
+					      conns[i], &conns[i]->dgram);
+		torture_assert(tctx, sret == 0, "udp socket failed");
+
+		torture_assert(tctx, echo_bench_udp_recv_submit(conns[i]),
+			       "recvfrom setup failed");
+	}
+
+	printf("Running ECHO/udp bench for %d seconds "
+	       "(%u conns, %u deep, %u byte payload)\n",
+	       torture_setting_int(tctx, "timelimit", 10),
+	       state->nconns, state->pipeline,
+	       (unsigned int)state->payload);
+
+	ret = echo_bench_run(state, conns, echo_bench_udp_send_submit);
+
+	talloc_free(state);
+	return ret;
+}
+
+/*
+  benchmark the echo server over tcp
+*/
+bool torture_bench_echo_tcp(struct torture_context *tctx)
+{
+	struct echo_bench_state *state;
+	struct echo_bench_conn **conns;
+	const char *address;
+	unsigned int i;
+	bool ret;
+
+	if (!echo_bench_resolve(tctx, &address)) {
+		return false;
+	}
+
+	state = echo_bench_state_init(tctx);
+	torture_assert(tctx, state != NULL, "bench setup failed");
+
+	conns = talloc_array(state, struct echo_bench_conn *,
+			     state->nconns);
+	torture_assert(tctx, conns != NULL, "no memory for connections");
+
+	state->pending_connects = state->nconns;
+
+	for (i = 0; i < state->nconns; i++) {
+		struct tevent_req *subreq;
+
+		conns[i] = echo_bench_conn_init(state, address);
+		torture_assert(tctx, conns[i] != NULL,
+			       "socket setup failed");
+
+		subreq = tstream_inet_tcp_connect_send(conns[i], tctx->ev,
+						       NULL,
+						       conns[i]->remote);
+		torture_assert(tctx, subreq != NULL, "connect failed");
+		tevent_req_set_callback(subreq,
+					echo_bench_tcp_connect_handler,
+					conns[i]);
+	}
+
+	while (state->pending_connects != 0) {
+		tevent_loop_once(tctx->ev);
+	}
+	torture_assert(tctx, !state->connect_failed,
+		       "tcp connect to echo server failed");
+
+	for (i = 0; i < state->nconns; i++) {
+		torture_assert(tctx, echo_bench_tcp_recv_submit(conns[i]),
+			       "readv setup failed");
+	}
+
+	printf("Running ECHO/tcp bench for %d seconds "
+	       "(%u conns, %u deep, %u byte payload)\n",
+	       torture_setting_int(tctx, "timelimit", 10),
+	       state->nconns, state->pipeline,
+	       (unsigned int)state->payload);
+
+	ret = echo_bench_run(state, conns, echo_bench_tcp_send_submit);
+
+	talloc_free(state);
+	return ret;
+}
+
+NTSTATUS torture_echo_init(void)
+{
+	struct torture_suite *suite = torture_suite_create(
+		talloc_autofree_context(), "echo");
+
+	torture_suite_add_simple_test(suite, "udp", torture_bench_echo_udp);
+	torture_suite_add_simple_test(suite, "tcp", torture_bench_echo_tcp);
+
+	suite->description = talloc_strdup(suite,
+		"ECHO server benchmarks, raw tevent/tsocket round-trips");
+
+	torture_register_suite(suite);
+
+	return NT_STATUS_OK;
+}
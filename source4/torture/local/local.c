@@ -95,6 +95,8 @@ NTSTATUS torture_local_init(void)
 				      torture_local_crypto_aes_ccm_128);
 	torture_suite_add_simple_test(suite, "crypto.aes_gcm_128",
 				      torture_local_crypto_aes_gcm_128);
+	torture_suite_add_simple_test(suite, "crypto.aes_gcm_128_bench",
+				      torture_local_crypto_aes_gcm_128_bench);
 
 	for (i = 0; suite_generators[i]; i++)
 		torture_suite_add_suite(suite,
@@ -0,0 +1,397 @@
+/*
+   Unix SMB/CIFS implementation.
+
+   SMB2 open-loop load generator
+
+   Unlike the closed-loop BENCH-* tests, which issue the next request
+   only after the previous one completed and therefore slow down with
+   the server, this test issues requests at a fixed configured arrival
+   rate regardless of completions, the way production clients do. That
+   makes queueing delay visible: a server that keeps up shows flat
+   latency percentiles, a server that falls behind shows them explode.
+
+   Copyright (C) Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "libcli/smb2/smb2.h"
+#include "libcli/smb2/smb2_calls.h"
+#include "torture/torture.h"
+#include "torture/smb2/proto.h"
+
+#define BASEDIR "benchload"
+
+/* log2 microsecond latency buckets */
+#define BENCH_LOAD_HIST_BUCKETS 32
+
+struct bench_load_state;
+
+struct bench_load_conn {
+	struct smb2_tree *tree;
+	struct smb2_handle handle;
+};
+
+struct bench_load_state {
+	struct torture_context *tctx;
+
+	struct bench_load_conn **conns;
+	unsigned int nconns;
+	unsigned int next_conn;
+
+	size_t payload;
+	uint8_t *payload_buf;
+
+	unsigned int ratio_read;
+	unsigned int ratio_write;
+	unsigned int ratio_total;
+
+	uint64_t rate;		/* target ops/sec over all connections */
+	struct timeval start;
+
+	uint64_t issued;
+	uint64_t completed;
+	uint64_t errors;
+	uint64_t in_flight;
+	uint64_t max_in_flight;
+
+	uint64_t hist[BENCH_LOAD_HIST_BUCKETS];
+};
+
+/* per request state, carries the send timestamp */
+struct bench_load_op {
+	struct bench_load_state *state;
+	struct timeval start;
+};
+
+static void bench_load_op_done(struct bench_load_op *op, NTSTATUS status)
+{
+	struct bench_load_state *state = op->state;
+	uint64_t elapsed_usec =
+		(uint64_t)(timeval_elapsed(&op->start) * 1000000);
+	unsigned int bucket = 0;
+
+	while (elapsed_usec > 1 &&
+	       bucket < (BENCH_LOAD_HIST_BUCKETS - 1)) {
+		elapsed_usec >>= 1;
+		bucket += 1;
+	}
+	state->hist[bucket] += 1;
+
+	if (NT_STATUS_IS_OK(status)) {
+		state->completed += 1;
+	} else {
+		state->errors += 1;
+	}
+	state->in_flight -= 1;
+	talloc_free(op);
+}
+
+static void bench_load_read_done(struct smb2_request *subreq)
+{
+	struct bench_load_op *op = talloc_get_type_abort(
+		subreq->async.private_data, struct bench_load_op);
+	struct smb2_read rd;
+	NTSTATUS status;
+
+	ZERO_STRUCT(rd);
+	status = smb2_read_recv(subreq, op, &rd);
+	bench_load_op_done(op, status);
+}
+
+static void bench_load_write_done(struct smb2_request *subreq)
+{
+	struct bench_load_op *op = talloc_get_type_abort(
+		subreq->async.private_data, struct bench_load_op);
+	struct smb2_write wr;
+	NTSTATUS status;
+
+	ZERO_STRUCT(wr);
+	status = smb2_write_recv(subreq, &wr);
+	bench_load_op_done(op, status);
+}
+
+static void bench_load_getinfo_done(struct smb2_request *subreq)
+{
+	struct bench_load_op *op = talloc_get_type_abort(
+		subreq->async.private_data, struct bench_load_op);
+	struct smb2_getinfo gi;
+	NTSTATUS status;
+
+	ZERO_STRUCT(gi);
+	status = smb2_getinfo_recv(subreq, op, &gi);
+	bench_load_op_done(op, status);
+}
+
+static bool bench_load_issue_one(struct bench_load_state *state)
+{
+	struct bench_load_conn *conn = state->conns[state->next_conn];
+	struct bench_load_op *op;
+	struct smb2_request *subreq;
+	unsigned int dice;
+
+	state->next_conn = (state->next_conn + 1) % state->nconns;
+
+	op = talloc_zero(state, struct bench_load_op);
+	if (op == NULL) {
+		return false;
+	}
+	op->state = state;
+	op->start = timeval_current();
+
+	dice = random() % state->ratio_total;
+
+	if (dice < state->ratio_read) {
+		struct smb2_read rd;
+
+		ZERO_STRUCT(rd);
+		rd.in.file.handle = conn->handle;
+		rd.in.length = state->payload;
+		rd.in.offset = 0;
+
+		subreq = smb2_read_send(conn->tree, &rd);
+		if (subreq == NULL) {
+			talloc_free(op);
+			return false;
+		}
+		subreq->async.fn = bench_load_read_done;
+	} else if (dice < state->ratio_read + state->ratio_write) {
+		struct smb2_write wr;
+
+		ZERO_STRUCT(wr);
+		wr.in.file.handle = conn->handle;
+		wr.in.offset = 0;
+		wr.in.data = data_blob_const(state->payload_buf,
+					     state->payload);
+
+		subreq = smb2_write_send(conn->tree, &wr);
+		if (subreq == NULL) {
+			talloc_free(op);
+			return false;
+		}
+		subreq->async.fn = bench_load_write_done;
+	} else {
+		struct smb2_getinfo gi;
+
+		ZERO_STRUCT(gi);
+		gi.in.info_type = SMB2_GETINFO_FILE;
+		gi.in.info_class = 0x12; /* SMB2_ALL_INFORMATION */
+		gi.in.output_buffer_length = 0x10000;
+		gi.in.file.handle = conn->handle;
+
+		subreq = smb2_getinfo_send(conn->tree, &gi);
+		if (subreq == NULL) {
+			talloc_free(op);
+			return false;
+		}
+		subreq->async.fn = bench_load_getinfo_done;
+	}
+
+	subreq->async.private_data = op;
+
+	state->issued += 1;
+	state->in_flight += 1;
+	if (state->in_flight > state->max_in_flight) {
+		state->max_in_flight = state->in_flight;
+	}
+	return true;
+}
+
+static uint64_t bench_load_percentile(struct bench_load_state *state,
+				      unsigned int p)
+{
+	uint64_t total = state->completed + state->errors;
+	uint64_t target = (total * p + 99) / 100;
+	uint64_t seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < BENCH_LOAD_HIST_BUCKETS; i++) {
+		seen += state->hist[i];
+		if (seen >= target) {
+			/* upper bound of the bucket, in usec */
+			return (uint64_t)2 << i;
+		}
+	}
+	return 0;
+}
+
+static void bench_load_wakeup(struct tevent_context *ev,
+			      struct tevent_timer *te,
+			      struct timeval t, void *private_data)
+{
+	/* nothing to do, we just need the loop to return */
+}
+
+/*
+   open-loop mixed workload against the server
+*/
+bool test_smb2_bench_load(struct torture_context *tctx,
+			  struct smb2_tree *tree)
+{
+	struct bench_load_state *state;
+	struct smb2_handle dh;
+	struct timeval drain;
+	NTSTATUS status;
+	TALLOC_CTX *mem_ctx = talloc_new(tctx);
+	int timelimit = torture_setting_int(tctx, "timelimit", 10);
+	double elapsed;
+	unsigned int i;
+
+	state = talloc_zero(mem_ctx, struct bench_load_state);
+	torture_assert(tctx, state != NULL, "no memory");
+
+	state->tctx = tctx;
+	state->rate = torture_setting_int(tctx, "rate", 1000);
+	state->nconns = torture_setting_int(tctx, "nconns", 4);
+	state->payload = torture_setting_int(tctx, "payload", 8192);
+	state->ratio_read = torture_setting_int(tctx, "ratio_read", 30);
+	state->ratio_write = torture_setting_int(tctx, "ratio_write", 20);
+	state->ratio_total = state->ratio_read + state->ratio_write +
+		torture_setting_int(tctx, "ratio_meta", 50);
+
+	torture_assert(tctx, state->rate > 0, "invalid rate");
+	torture_assert(tctx, state->nconns > 0, "invalid nconns");
+	torture_assert(tctx, state->payload > 0, "invalid payload");
+	torture_assert(tctx, state->ratio_total > 0, "invalid op ratios");
+
+	state->payload_buf = talloc_array(state, uint8_t, state->payload);
+	torture_assert(tctx, state->payload_buf != NULL, "no memory");
+	for (i = 0; i < state->payload; i++) {
+		state->payload_buf[i] = (uint8_t)i;
+	}
+
+	state->conns = talloc_array(state, struct bench_load_conn *,
+				    state->nconns);
+	torture_assert(tctx, state->conns != NULL, "no memory");
+
+	status = torture_smb2_testdir(tree, BASEDIR, &dh);
+	torture_assert_ntstatus_ok(tctx, status, "creating base directory");
+	smb2_util_close(tree, dh);
+
+	torture_comment(tctx, "Opening %u connections\n", state->nconns);
+	for (i = 0; i < state->nconns; i++) {
+		struct bench_load_conn *conn;
+		char *fname;
+
+		conn = talloc_zero(state, struct bench_load_conn);
+		torture_assert(tctx, conn != NULL, "no memory");
+
+		if (!torture_smb2_connection(tctx, &conn->tree)) {
+			return false;
+		}
+		talloc_steal(conn, conn->tree);
+
+		fname = talloc_asprintf(conn, "%s\\load%u.dat",
+					BASEDIR, i);
+		torture_assert(tctx, fname != NULL, "no memory");
+
+		status = torture_smb2_testfile(conn->tree, fname,
+					       &conn->handle);
+		torture_assert_ntstatus_ok(tctx, status, "creating file");
+
+		/* make sure the reads have something to read */
+		status = smb2_util_write(conn->tree, conn->handle,
+					 state->payload_buf, 0,
+					 state->payload);
+		torture_assert_ntstatus_ok(tctx, status, "priming file");
+
+		state->conns[i] = conn;
+	}
+
+	torture_comment(tctx, "Running %ju ops/sec for %d seconds "
+			"(%u conns, %u%% read/%u%% write/%u%% meta, "
+			"%u byte payload)\n",
+			(uintmax_t)state->rate, timelimit, state->nconns,
+			state->ratio_read * 100 / state->ratio_total,
+			state->ratio_write * 100 / state->ratio_total,
+			(state->ratio_total - state->ratio_read -
+			 state->ratio_write) * 100 / state->ratio_total,
+			(unsigned int)state->payload);
+
+	state->start = timeval_current();
+
+	while (timeval_elapsed(&state->start) < timelimit) {
+		uint64_t target;
+		uint64_t due_usec;
+		struct tevent_timer *te;
+		struct timeval next;
+
+		/*
+		 * issue whatever the arrival process says should have
+		 * been issued by now, no matter how many replies are
+		 * outstanding
+		 */
+		target = (uint64_t)(timeval_elapsed(&state->start) *
+				    state->rate);
+		while (state->issued < target) {
+			torture_assert(tctx, bench_load_issue_one(state),
+				       "failed to issue request");
+		}
+
+		/* wake up when the next request is due */
+		due_usec = (state->issued + 1) * 1000000 / state->rate;
+		next = timeval_add(&state->start,
+				   due_usec / 1000000,
+				   due_usec % 1000000);
+		te = tevent_add_timer(tctx->ev, mem_ctx, next,
+				      bench_load_wakeup, NULL);
+		torture_assert(tctx, te != NULL, "no memory");
+
+		tevent_loop_once(tctx->ev);
+		talloc_free(te);
+	}
+
+	elapsed = timeval_elapsed(&state->start);
+
+	/* wait for the stragglers, but not forever */
+	drain = timeval_current();
+	while (state->in_flight > 0 && timeval_elapsed(&drain) < 10) {
+		struct tevent_timer *te;
+		struct timeval next = timeval_current_ofs(0, 100000);
+
+		te = tevent_add_timer(tctx->ev, mem_ctx, next,
+				      bench_load_wakeup, NULL);
+		if (te == NULL) {
+			break;
+		}
+		tevent_loop_once(tctx->ev);
+		talloc_free(te);
+	}
+
+	torture_comment(tctx, "issued %ju, completed %ju (%.1f/sec), "
+			"%ju errors, %ju still in flight, "
+			"max %ju in flight\n",
+			(uintmax_t)state->issued,
+			(uintmax_t)state->completed,
+			state->completed / elapsed,
+			(uintmax_t)state->errors,
+			(uintmax_t)state->in_flight,
+			(uintmax_t)state->max_in_flight);
+	torture_comment(tctx, "latency: p50=%juus p95=%juus p99=%juus\n",
+			(uintmax_t)bench_load_percentile(state, 50),
+			(uintmax_t)bench_load_percentile(state, 95),
+			(uintmax_t)bench_load_percentile(state, 99));
+
+	for (i = 0; i < state->nconns; i++) {
+		smb2_util_close(state->conns[i]->tree,
+				state->conns[i]->handle);
+	}
+	smb2_deltree(tree, BASEDIR);
+
+	torture_assert(tctx, state->errors == 0, "load run saw errors");
+
+	talloc_free(mem_ctx);
+	return true;
+}